@@ -0,0 +1,50 @@
+#ifndef T_O_INTERNAL_H
+#define T_O_INTERNAL_H
+
+#include "t_o.h"
+
+/* Entry points of t_o.c that are not part of the public interface in t_o.h.
+ * They are exposed only so that test_panama and the bench programs can step
+ * the pieces of t_o_timestep separately and check old and new versions of the
+ * same code against each other.  Simulations should not call them.  The
+ * parameters are documented in t_o.c.
+ */
+
+// Values for the kernel parameter of infiltrate_distance_with_kernel and groundwater_distances.
+#define SIMD_KERNEL_SCALAR (0)
+#define SIMD_KERNEL_AVX2   (1)
+#define SIMD_KERNEL_AVX512 (2)
+
+// Domain state.
+int t_o_domains_equal(t_o_domain* domain1, t_o_domain* domain2);
+int create_slug_after(t_o_domain* domain, int bin, slug* prev_slug, double top, double bot);
+int find_first_bin(t_o_domain* domain, int start_search);
+int has_water_at_depth(t_o_domain* domain, int bin, double top, double bot);
+#ifdef SLUG_SPANS
+int slug_spans_match_lists(t_o_domain* domain);
+#endif // SLUG_SPANS
+
+// The steps of t_o_timestep.
+int  t_o_satisfy_saturated_bins(t_o_domain* domain, double dt, int first_bin, double* surfacewater_depth, int* ponded_water,
+                                double* groundwater_recharge, double water_table);
+int  t_o_infiltrate(t_o_domain* domain, double dt, int* first_bin, double surfacewater_head, double* surfacewater_depth,
+                    double* groundwater_recharge, int ponded_water, int update_dry_depth);
+int  t_o_falling_slugs(t_o_domain* domain, double dt, int first_bin, double* groundwater_recharge);
+int  t_o_groundwater(t_o_domain* domain, double dt, int* first_bin, double water_table, int ponded_water, double* groundwater_recharge,
+                     double inflow_rate);
+void t_o_handle_sliver_slugs(t_o_domain* domain);
+int  t_o_redistribute(t_o_domain* domain, int first_bin);
+
+// SIMD kernels.
+int  best_simd_kernel(void);
+int  infiltrate_distance_with_kernel(t_o_domain* domain, double dt, int first_bin, double surfacewater_head, double* distance,
+                                     int update_dry_depth, int kernel);
+int  groundwater_distances(t_o_domain* domain, int first_bin, double dt, double water_table, double inflow_rate, double* distance,
+                           int kernel);
+
+// Old versions kept to check the new ones against.
+int t_o_falling_slugs_slow(t_o_domain* domain, double dt, int first_bin, double* groundwater_recharge);
+int t_o_redistribute_list_sort(t_o_domain* domain, int first_bin);
+int redistribute_slow(t_o_domain* domain);
+
+#endif // T_O_INTERNAL_H
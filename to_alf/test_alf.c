@@ -4,12 +4,12 @@
 #include <math.h>
 #include <string.h>
 #include <X11/Xlib.h>
-#include "t_o.h"
+#include "t_o_internal.h"
 #include "epsilon.h"
 #include "all.h"
 #include "memfunc.h"
-
-extern int t_o_domains_equal(t_o_domain* domain1, t_o_domain* domain2);
+#include "forcing.h"
+#include "output_writer.h"
 
 #define MARGIN        (30)
 #define FRAME_WIDTH   (600)
@@ -25,187 +25,6 @@ extern int t_o_domains_equal(t_o_domain* domain1, t_o_domain* domain2);
 #define ONE_HOUR      (60.0 * ONE_MINUTE)
 #define ONE_DAY       (24.0 * ONE_HOUR)
 
-/* A link list struct stores depth, theta with depth increasing order. */
-struct t_o_profile_link
-{
-  double depth;
-  double theta;
-  double pressure;
-  struct t_o_profile_link *next;
-};
-typedef struct t_o_profile_link t_o_profile_link;
-
-/* Insert a node with (depth, theta) into link list (head_pt), return error = TRUE if error occurs. */
-int insert_t_o_profile_link(t_o_profile_link** head_pt, double depth, double theta, double pressure, int yes_groundater)
-{
-  int error = FALSE;
-  assert(NULL != *head_pt);
-  
-  t_o_profile_link* pt_insert;
-  t_o_profile_link* pt_rear;
-  t_o_profile_link* pt_front;
-  
-  if (NULL == (pt_insert = (t_o_profile_link*)malloc(sizeof(t_o_profile_link))))
-    {
-      printf("malloc failed in creating t_o_profile_link node in function insert_t_o_profile_link(), exit.\n");
-      error = TRUE;
-      return error;
-    }
-  pt_insert->depth    = depth;
-  pt_insert->theta    = theta;
-  pt_insert->pressure = pressure;
-  pt_insert->next     = NULL;
-  
-  pt_rear  = *head_pt;
-  pt_front = (*head_pt)->next;
-  // Head pointer *head_pt is initialized with domain->top_depth, and pass in value (depth) is larger than domain->top_depth.
-  while (NULL != pt_front)
-    {
-      if (pt_insert->depth >= pt_front->depth)
-        {
-          pt_rear  = pt_front;
-          pt_front = pt_front->next;     
-        }
-      else
-        {
-          break;
-        }
-    }
-  
-  // Insert pt_insert only when depth is strictly larger than pt_rear->depth, so that depth in link is increasing without same value.
-  if (epsilon_greater(pt_insert->depth, pt_rear->depth))
-    {
-      pt_rear->next   = pt_insert;
-      pt_insert->next = pt_front;
-    }
-  else if (!yes_groundater && epsilon_equal(pt_insert->depth, pt_rear->depth) && pt_rear->theta < pt_insert->theta)
-    { // Add 10/09/14, to handle no groundwate cases,
-     //printf("theta = %lf \n", pt_insert->theta); getchar();
-      pt_rear->theta    = pt_insert->theta;
-      pt_rear->pressure = pt_insert->pressure;
-    }
-  return error;
-}
-
-/* Map t_o domain into water content in 1D space discretization, water_content[num_elements] and effective_porosity are output values.
- *
- * Parameters:
- * domain             - A pointer to the t_o_domain struct.
- * num_elements       - Number of element in 1d soil column.
- * soil_depth_z       - A pointer to 1d array of size num_elements contains depth of each element's lower bound, in unit of [meters], positive downward.
- *
- * Output:
- * water_content      - A pointer to 1d array of size num_elements contains water content of each element.
- * pressure_head      - A pointer to 1d array of size num_elements contains pressure head of each element.
- * effective_porosity - Scalar passed by reference, unitless.
- */
-int get_t_o_domain_profile(t_o_domain* domain, int num_elements, double* soil_depth_z, 
-                           double* water_content,  double* pressure_head, double* effective_porosity)
-{
-  int error = FALSE;
-  int ii, jj, jj_start;
-  t_o_profile_link *head_pt = NULL, *tmp_pt = NULL, tmp;
-  
-  // Initialize head pointer node, fake node.
-  tmp.depth    = domain->layer_top_depth;
-  tmp.theta    = domain->parameters->bin_water_content[domain->parameters->num_bins];
-  tmp.pressure = 0.0;
-  tmp.next     = NULL;
-  head_pt      = &tmp;
-  
-  assert(NULL != domain);
-  
-  // Find effective porosity.
-  *effective_porosity = domain->parameters->bin_water_content[domain->parameters->num_bins];
-  
-  // Step 1, map the to_domain water content into link list t_o_profile_link_link.
-  // Loop over bins, start from bin 2, since bin 1 is always saturated.
-  for (ii = 2; ii <= domain->parameters->num_bins; ii++)
-     {
-       // Surface front.
-       if (domain->surface_front[ii] > domain->layer_top_depth && domain->surface_front[ii] <= domain->layer_bottom_depth) // Add "<=" 10/09/14.
-         {
-           error = insert_t_o_profile_link(&head_pt, domain->surface_front[ii], domain->parameters->bin_water_content[ii], 
-                                                                               -domain->parameters->bin_capillary_suction[ii], domain->yes_groundwater);
-         }
-        
-       // Slug.
-       slug* temp_slug = domain->top_slug[ii];
-       while (NULL != temp_slug)
-         {
-           // slug top.
-           error = insert_t_o_profile_link(&head_pt, temp_slug->top, domain->parameters->bin_water_content[ii - 1], 
-                                                                    -domain->parameters->bin_capillary_suction[ii - 1], domain->yes_groundwater);
-           
-           // slug bottom.
-           error = insert_t_o_profile_link(&head_pt, temp_slug->bot, domain->parameters->bin_water_content[ii], 
-                                                                   -domain->parameters->bin_capillary_suction[ii], domain->yes_groundwater);
-           
-           temp_slug = temp_slug->next;
-         }
-        
-       // groundwater front. 
-       if (domain->yes_groundwater)
-         {
-           if (domain->groundwater_front[ii] > domain->layer_top_depth)
-             {
-              error = insert_t_o_profile_link(&head_pt, domain->groundwater_front[ii], domain->parameters->bin_water_content[ii - 1], 
-                                                                                 -domain->parameters->bin_capillary_suction[ii - 1], domain->yes_groundwater);
-             }
-         }
-     } // End of bin loop.
-  
-  // Insert fully saturated bin;
-  if (domain->yes_groundwater)
-    {
-      error = insert_t_o_profile_link(&head_pt, domain->layer_bottom_depth, domain->parameters->bin_water_content[domain->parameters->num_bins], 
-                                                          0.0, domain->yes_groundwater);
-    }
-  else
-    {
-      int first_bin = 2; // The leftmost bin that is not completely full of water.
- 
-      while (first_bin <= domain->parameters->num_bins && domain->parameters->bin_water_content[first_bin] <= domain->initial_water_content)
-       {
-         first_bin++;
-       }
-      error = insert_t_o_profile_link(&head_pt, domain->layer_bottom_depth, domain->parameters->bin_water_content[first_bin - 1], 
-                                                                         -domain->parameters->bin_capillary_suction[first_bin - 1], domain->yes_groundwater);
-    }
-
-  // Step 2, fill 1D array water content using t_o_profile_link_link.
-  tmp_pt   = head_pt;
-  jj_start = 1;
-  while (NULL != tmp_pt)
-    {
-      for (jj = jj_start; jj <= num_elements; jj++)
-         {
-           if (soil_depth_z[jj] <= tmp_pt->depth)
-             {
-               water_content[jj] = tmp_pt->theta;
-               pressure_head[jj] = tmp_pt->pressure;
-             }
-           else
-             {
-               jj_start = jj;
-               break;
-             }
-         }
-      tmp_pt = tmp_pt->next;
-    } 
-    
-  // Set head_pt to head_pt->next, as the first node is not malloc. Then free link-list.
-  head_pt = head_pt->next;
-  while (NULL != head_pt)
-    {
-       tmp_pt  = head_pt;
-       head_pt = head_pt->next;
-       free(tmp_pt);
-    }
-  
-  return error;
-} // End of get_t_o_domain_profile().
-
 int main(void)
 {
   t_o_parameters* parameters;
@@ -240,9 +59,9 @@ int main(void)
       
       double infiltration_rate     = 0.0;
       double groundwater_inf_rate = 0.0;
-      double rainfall_input_time[buf_alloc];
-      double rainfall_input_intensity[buf_alloc];
-      double potential_ET[buf_alloc];
+      forcing_file*  rain_file = NULL;              // The rainfall and PET file.
+      forcing_cursor rain_cursor;                   // The position in rain_file.
+      double         rain_mean[FORCING_MAX_VALUES]; // Rainfall and PET averaged over a timestep in mm / 15 min.
       char string[buf_alloc];
 	  double params[buf_alloc];
       
@@ -312,48 +131,36 @@ double initial_water_content = pow(1/pow((vg_alpha*initial_tension_top/100),vg_n
   /***********************/
   if (1 == test_id)
     {
-      // Read input rainfall file.
-      FILE*  rain_fptr      = NULL;
-  
-      if (NULL == (rain_fptr = fopen("SURFACE_BC.IN", "r")))
+      // Open input rainfall file.  It is read a record at a time as the simulation goes.
+      if (forcing_open(&rain_file, "SURFACE_BC.IN") || 2 > forcing_num_values(rain_file) ||
+          forcing_cursor_init(&rain_cursor, rain_file, FORCING_STEP))
         {
           printf("Error reading SURFACE_BC.IN \n");
           exit(1);
         }
-        
-      fgets(string, 100, rain_fptr);      // Ignore header.
-      for (ii = 1; ii <= buf_alloc; ii++)
-         {
-           fscanf(rain_fptr, "%*d %lf %lf", &rainfall_input_intensity[ii], &potential_ET[ii]);  // Original data in mm /15 min.
-           rainfall_input_time[ii]       = (ii - 1) * 15.0 * 60.0;  // In s.
-           rainfall_input_intensity[ii] /= 900000.0;     // In m/s. 
-           //rainfall_input_intensity[ii] *= 5.0;           // convert back to real values.
-           potential_ET[ii]             /= 900000.0;     // In m/s.
-      	   //printf("IN: %lf",rainfall_input_intensity[ii]);
-	  }
-      fclose(rain_fptr);
     }
 
   FILE*  f_fptr;                                                                          // File output of infiltration rate.
-  FILE*  acc_depth_fptr;
-  FILE* fptr_obsnode_60;
-  FILE* fptr_obsnode_150;
-  FILE* fptr_surfbc;
+  output_writer* acc_depth_writer;
+  output_writer* obsnode_60_writer;
+  output_writer* obsnode_150_writer;
+  output_writer* surfbc_writer;
   //double acc_depth = 0.0;
   
-  if (NULL == (fptr_obsnode_60 = fopen("alf_obsnode_60.txt", "w")) )
+  // Per timestep outputs are written by background threads in text so the layouts are unchanged.
+  if (output_writer_alloc(&obsnode_60_writer, "alf_obsnode_60.txt", 6, "%lf %lf %lf %lf %lf %lf\n", FALSE))
   {
 	printf("ERROR: Could not open observation node output file.\n");
 	exit(1);
   }  
 
-  if (NULL == (fptr_obsnode_150 = fopen("alf_obsnode_150.txt", "w")) )
+  if (output_writer_alloc(&obsnode_150_writer, "alf_obsnode_150.txt", 4, "%lf %lf %lf %lf\n", FALSE))
   {
 	printf("ERROR: Could not open observation node output file.\n");
 	exit(1);	
   }
 
-  if (NULL == (fptr_surfbc = fopen("surfbc.out", "w")) )
+  if (output_writer_alloc(&surfbc_writer, "surfbc.out", 1, "%lf\n", FALSE))
   {
 	printf("ERROR: Could not open observation node output file.\n");
 	exit(1);	
@@ -364,7 +171,7 @@ double initial_water_content = pow(1/pow((vg_alpha*initial_tension_top/100),vg_n
      fprintf(stderr, "ERROR: Could not open infiltration output file.\n");
      exit(1);
     }
-  if ((acc_depth_fptr = fopen("accum_depth.out", "w")) == NULL)
+  if (output_writer_alloc(&acc_depth_writer, "accum_depth.out", 2, "%lf %lf\n", FALSE))
     {
      fprintf(stderr, "ERROR: Could not open accumulate depth output file.\n");
      exit(1);
@@ -375,7 +182,6 @@ double initial_water_content = pow(1/pow((vg_alpha*initial_tension_top/100),vg_n
   double** soil_depth_z;   
   double** water_content;   
   double** pressure_head;   
-  double effective_porosity;
   
   error =  dtwo_alloc(&soil_depth_z,  num_layers, num_elements);
   error =  dtwo_alloc(&water_content, num_layers, num_elements);
@@ -406,13 +212,13 @@ double initial_water_content = pow(1/pow((vg_alpha*initial_tension_top/100),vg_n
       // Rainfall.  ###########################################################
       if (1 == test_id)
         {
-          ii = 1;
-          while (ii < buf_alloc && current_time >= rainfall_input_time[ii + 1])
+          // Original data in mm /15 min.  A timestep that spans two records gets the right amount of each.
+          if (forcing_cursor_mean(&rain_cursor, current_time, current_time + delta_time, rain_mean))
             {
-             ii++;
+              exit(1);
             }
-          PET           = potential_ET[ii];                  // m/s.      ##################################### Set no PET.
-          rainfall_rate = rainfall_input_intensity[ii];      // m/s.
+          PET           = rain_mean[1] / 900000.0;           // m/s.      ##################################### Set no PET.
+          rainfall_rate = rain_mean[0] / 900000.0;           // m/s.
           rainfall      = rainfall_rate * delta_time;        // Meters of water.
       	  //printf("Rainfall %lf\n",rainfall);
 	  }
@@ -467,16 +273,16 @@ double initial_water_content = pow(1/pow((vg_alpha*initial_tension_top/100),vg_n
      
      assert(epsilon_equal(total_water, evaporated_water + surfacewater_depth + groundwater_recharge + t_o_total_water_in_domain(domain) + runoff));
       
-      fprintf(acc_depth_fptr, "%lf %lf\n", current_time, runoff * 100.0); // Time in s, runoff in cm.
+      output_writer_row(acc_depth_writer, (double[]){current_time, runoff * 100.0}); // Time in s, runoff in cm.
       //fprintf(acc_depth_fptr,"%lf %lf\n",current_time/86400.0, t_o_total_water_in_domain(domain)); 
-     fprintf(fptr_surfbc,"%lf\n",surfacewater_depth);
+     output_writer_row(surfbc_writer, &surfacewater_depth);
 	  // obsERVATION NODE OUTPUT - AB
-      get_t_o_domain_profile(domain, num_elements, soil_depth_z[1], water_content[1], pressure_head[1], &effective_porosity);
+      t_o_profile(domain, num_elements, soil_depth_z[1], water_content[1], pressure_head[1]);
       for (jj = 1; jj <= num_elements; jj++) {
       	if(floor(soil_depth_z[1][jj]==0.6)) {
-			fprintf(fptr_obsnode_60, "%lf %lf %lf %lf %lf %lf\n", current_time, soil_depth_z[1][jj], water_content[1][jj], pressure_head[1][jj],water_content[1][1],pressure_head[1][1]);
+			output_writer_row(obsnode_60_writer, (double[]){current_time, soil_depth_z[1][jj], water_content[1][jj], pressure_head[1][jj],water_content[1][1],pressure_head[1][1]});
         } else if (floor(soil_depth_z[1][jj]==1.5))  {
-			fprintf(fptr_obsnode_150, "%lf %lf %lf %lf\n", current_time, soil_depth_z[1][jj], water_content[1][jj], pressure_head[1][jj]);		    	
+			output_writer_row(obsnode_150_writer, (double[]){current_time, soil_depth_z[1][jj], water_content[1][jj], pressure_head[1][jj]});		    	
 		}
 	  }
 	        
@@ -528,13 +334,20 @@ double initial_water_content = pow(1/pow((vg_alpha*initial_tension_top/100),vg_n
     /*************
    /* Clean up. */
   /*************/
+  if (NULL != rain_file)
+    {
+      forcing_close(&rain_file);
+    }
   t_o_domain_dealloc(&domain);
   t_o_parameters_dealloc(&parameters);
-  fclose(fptr_obsnode_60);
-  fclose(fptr_obsnode_150);
+  error = output_writer_dealloc(&obsnode_60_writer);
+  error = output_writer_dealloc(&obsnode_150_writer) || error;
+  error = output_writer_dealloc(&surfbc_writer)      || error;
+  if (output_writer_dealloc(&acc_depth_writer) || error)
+    {
+      fprintf(stderr, "ERROR: Could not write output files.\n");
+    }
   fclose(f_fptr);
-  fclose(acc_depth_fptr);
   fclose(fptr_simout);
-  fclose(fptr_surfbc);
   return 0;
 }
@@ -0,0 +1,146 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "t_o_internal.h"
+#include "bench_util.h"
+#include "all.h"
+
+/* Benchmark t_o_timestep_batch against calling t_o_timestep on each column in
+ * a loop.  Both sets of columns are stepped with identical forcing and must
+ * end up bit for bit identical.  Every other column has no groundwater so
+ * that both ways t_o_timestep_batch finds first_bin are timed.
+ *
+ * Usage: bench_batch [num_columns [simulation_hours]]
+ */
+
+int main(int argc, char** argv)
+{
+  int             ii, jj;                                // Loop counters.
+  int             error               = FALSE;           // Error flag.
+  int             num_columns         = 64;              // Number of columns to simulate.
+  double          max_time            = 24.0 * ONE_HOUR; // How long to run the simulation in seconds.
+  double          delta_time          = 10.0;            // The duration of the timestep in seconds.
+  int             num_bins            = 300;             // Number of bins.
+  double          conductivity        = 1.0 / 360000.0;  // Meters per second.
+  double          porosity            = 0.4;             // Unitless fraction.
+  double          residual_saturation = 0.027;           // Unitless fraction.
+  double          layer_top_depth     = 0.0;             // Meters.
+  double          layer_bottom_depth  = 1.0;             // Meters.
+  double          current_time;                          // Current time in seconds.
+  double          scalar_seconds, batch_seconds;         // Wall clock time of each method.
+  t_o_parameters* parameters;
+
+  if (1 < argc)
+    {
+      num_columns = atoi(argv[1]);
+    }
+
+  if (2 < argc)
+    {
+      max_time = atof(argv[2]) * ONE_HOUR;
+    }
+
+  if (0 >= num_columns || 0.0 >= max_time)
+    {
+      fprintf(stderr, "Usage: %s [num_columns [simulation_hours]]\n", argv[0]);
+      exit(1);
+    }
+
+  t_o_domain* scalar_domains[num_columns];
+  t_o_domain* batch_domains[num_columns];
+  double      scalar_surfacewater_depth[num_columns];
+  double      scalar_groundwater_recharge[num_columns];
+  double      batch_surfacewater_head[num_columns];
+  double      batch_surfacewater_depth[num_columns];
+  double      batch_water_table[num_columns];
+  double      batch_groundwater_recharge[num_columns];
+
+  if (t_o_parameters_alloc(&parameters, num_bins, conductivity, porosity, residual_saturation, TRUE, 3.6, 1.56, 5.5, 0.37))
+    {
+      fprintf(stderr, "ERROR: Could not allocate t_o_parameters.\n");
+      exit(1);
+    }
+
+  for (ii = 0; ii < num_columns; ii++)
+    {
+      if (t_o_domain_alloc(&scalar_domains[ii], parameters, layer_top_depth, layer_bottom_depth, 0 == ii % 2, 0.08, TRUE, layer_bottom_depth) ||
+          t_o_domain_alloc(&batch_domains[ii],  parameters, layer_top_depth, layer_bottom_depth, 0 == ii % 2, 0.08, TRUE, layer_bottom_depth))
+        {
+          fprintf(stderr, "ERROR: Could not allocate t_o_domain.\n");
+          exit(1);
+        }
+
+      scalar_surfacewater_depth[ii]   = 0.0;
+      scalar_groundwater_recharge[ii] = 0.0;
+      batch_surfacewater_depth[ii]    = 0.0;
+      batch_water_table[ii]           = layer_bottom_depth;
+      batch_groundwater_recharge[ii]  = 0.0;
+    }
+
+  scalar_seconds = 0.0;
+  batch_seconds  = 0.0;
+
+  // The two methods take turns each timestep so that they both see the same load on the machine.
+  for (current_time = 0.0; !error && current_time < max_time; current_time += delta_time)
+    {
+      double start_time; // Seconds.
+
+      for (ii = 0; ii < num_columns; ii++)
+        {
+          scalar_surfacewater_depth[ii] += column_rainfall_rate(ii, current_time) * delta_time;
+          batch_surfacewater_depth[ii]  += column_rainfall_rate(ii, current_time) * delta_time;
+          batch_surfacewater_head[ii]    = batch_surfacewater_depth[ii];
+        }
+
+      // Scalar loop.
+      start_time = wall_time();
+
+      for (ii = 0; !error && ii < num_columns; ii++)
+        {
+          error = t_o_timestep(scalar_domains[ii], delta_time, scalar_surfacewater_depth[ii], &scalar_surfacewater_depth[ii], layer_bottom_depth,
+                               &scalar_groundwater_recharge[ii]);
+        }
+
+      scalar_seconds += wall_time() - start_time;
+
+      // Batch.
+      start_time = wall_time();
+      error      = error || t_o_timestep_batch(batch_domains, num_columns, delta_time, batch_surfacewater_head, batch_surfacewater_depth,
+                                               batch_water_table, batch_groundwater_recharge);
+      batch_seconds += wall_time() - start_time;
+    }
+
+  if (error)
+    {
+      fprintf(stderr, "ERROR: Timestep returned error.\n");
+      exit(1);
+    }
+
+  for (ii = 0; ii < num_columns; ii++)
+    {
+      if (!t_o_domains_equal(scalar_domains[ii], batch_domains[ii]) || scalar_surfacewater_depth[ii] != batch_surfacewater_depth[ii] ||
+          scalar_groundwater_recharge[ii] != batch_groundwater_recharge[ii])
+        {
+          fprintf(stderr, "ERROR: Column %d differs between scalar and batch stepping.\n", ii);
+          error = TRUE;
+        }
+    }
+
+  jj = (int)(max_time / delta_time + 0.5);
+
+  printf("Columns                 = %d\n", num_columns);
+  printf("Timesteps               = %d\n", jj);
+  printf("Scalar loop             = %lf seconds, %lf columns per second\n", scalar_seconds, num_columns * (double)jj / scalar_seconds);
+  printf("t_o_timestep_batch      = %lf seconds, %lf columns per second\n", batch_seconds,  num_columns * (double)jj / batch_seconds);
+  printf("Speedup                 = %lf\n", scalar_seconds / batch_seconds);
+  printf("Results bit identical   = %s\n", error ? "NO" : "YES");
+
+  for (ii = 0; ii < num_columns; ii++)
+    {
+      t_o_domain_dealloc(&scalar_domains[ii]);
+      t_o_domain_dealloc(&batch_domains[ii]);
+    }
+
+  t_o_parameters_dealloc(&parameters);
+
+  return error;
+}
@@ -0,0 +1,218 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "t_o_internal.h"
+#include "bench_util.h"
+#include "all.h"
+
+/* Benchmark t_o_domain_checkpoint and t_o_domain_restore.  An ensemble of
+ * domains, half with groundwater and half without, is spun up through a
+ * series of short storms that leave many slugs behind and saved to one
+ * checkpoint file.  The file is restored and each restored domain must be
+ * equal to the one that was saved.  Then the saved and restored domains are
+ * stepped forward side by side and must stay bit for bit identical.  The time
+ * to save and restore is compared with the time to spin up.
+ *
+ * Usage: bench_checkpoint [num_domains [num_bins [spin_up_hours]]]
+ *
+ * By default 16 domains of 1000 bins are spun up for 12 hours.
+ */
+
+/* Step every domain in an ensemble forward.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * domains              - 1D array of pointers to the domains.
+ * num_domains          - The number of domains.
+ * current_time         - The time at the start of the timestep in seconds.
+ * delta_time           - The duration of the timestep in seconds.
+ * water_table          - Meters.
+ * surfacewater_depth   - 1D array of the surface water depth of each domain in meters.
+ * groundwater_recharge - 1D array of the groundwater recharge of each domain in meters.
+ */
+int step_ensemble(t_o_domain** domains, int num_domains, double current_time, double delta_time, double water_table, double* surfacewater_depth,
+                  double* groundwater_recharge)
+{
+  int error = FALSE; // Error flag.
+  int kk;            // Loop counter.
+
+  for (kk = 0; !error && kk < num_domains; kk++)
+    {
+      surfacewater_depth[kk] += burst_rainfall_rate(current_time, (0.005 + 0.001 * (kk % 8)) / ONE_HOUR) * delta_time;
+      error                   = t_o_timestep(domains[kk], delta_time, surfacewater_depth[kk], &surfacewater_depth[kk], water_table,
+                                             &groundwater_recharge[kk]);
+    }
+
+  return error;
+}
+
+int main(int argc, char** argv)
+{
+  int              ii, kk;                        // Loop counters.
+  int              error           = FALSE;       // Error flag.
+  int              num_domains     = 16;
+  int              num_bins        = 1000;
+  double           spin_up_time    = 12.0 * ONE_HOUR; // Seconds.
+  double           continue_time   = 6.0 * ONE_HOUR;  // Seconds to step the saved and restored domains side by side.
+  double           delta_time      = 60.0;        // The duration of the timestep in seconds.
+  double           water_table     = 1.0;         // Meters.
+  double           current_time;                  // Seconds.
+  double           start_time;
+  double           checkpoint_seconds;
+  double           restore_seconds;
+  double           spin_up_seconds;
+  int              file_num_domains;
+  long long        num_slugs       = 0;           // The total number of slugs in the ensemble when it is saved.
+  int              identical       = TRUE;        // Whether the restored domains are equal to the saved ones.
+  const char*      path            = "bench_checkpoint.chk";
+  FILE*            fptr;
+  long             file_size;
+  t_o_parameters*  parameters;
+  t_o_domain**     domains;                       // The spun up ensemble.
+  t_o_domain**     restored;                      // The ensemble restored from the checkpoint.
+  t_o_parameters** domain_parameters;             // The parameters of each domain.
+  double*          surfacewater_depth;            // Meters of water for each domain, then each restored domain.
+  double*          groundwater_recharge;          // Meters of water for each domain, then each restored domain.
+  slug*            temp_slug;
+
+  if (1 < argc)
+    {
+      num_domains = atoi(argv[1]);
+    }
+
+  if (2 < argc)
+    {
+      num_bins = atoi(argv[2]);
+    }
+
+  if (3 < argc)
+    {
+      spin_up_time = atof(argv[3]) * ONE_HOUR;
+    }
+
+  if (1 > num_domains || 2 > num_bins || 0.0 > spin_up_time)
+    {
+      fprintf(stderr, "Usage: %s [num_domains [num_bins [spin_up_hours]]]\n", argv[0]);
+      exit(1);
+    }
+
+  if (NULL == (domains              = (t_o_domain**)malloc(num_domains * sizeof(t_o_domain*)))     ||
+      NULL == (restored             = (t_o_domain**)malloc(num_domains * sizeof(t_o_domain*)))     ||
+      NULL == (domain_parameters    = (t_o_parameters**)malloc(num_domains * sizeof(t_o_parameters*))) ||
+      NULL == (surfacewater_depth   = (double*)calloc(2 * num_domains, sizeof(double)))           ||
+      NULL == (groundwater_recharge = (double*)calloc(2 * num_domains, sizeof(double))))
+    {
+      fprintf(stderr, "ERROR: Could not allocate ensemble arrays.\n");
+      exit(1);
+    }
+
+  if (t_o_parameters_alloc(&parameters, num_bins, 1.0 / 360000.0, 0.4, 0.027, TRUE, 3.6, 1.56, 5.5, 0.37))
+    {
+      fprintf(stderr, "ERROR: Could not allocate t_o_parameters.\n");
+      exit(1);
+    }
+
+  for (kk = 0; !error && kk < num_domains; kk++)
+    {
+      domain_parameters[kk] = parameters;
+      error                 = t_o_domain_alloc(&domains[kk], parameters, 0.0, 2.0, 0 == kk % 2, 0.08, TRUE, water_table);
+    }
+
+  if (error)
+    {
+      fprintf(stderr, "ERROR: Could not allocate t_o_domain.\n");
+      exit(1);
+    }
+
+  // Spin up.
+  start_time = wall_time();
+
+  for (current_time = 0.0; !error && current_time < spin_up_time; current_time += delta_time)
+    {
+      error = step_ensemble(domains, num_domains, current_time, delta_time, water_table, surfacewater_depth, groundwater_recharge);
+    }
+
+  spin_up_seconds = wall_time() - start_time;
+
+  for (kk = 0; kk < num_domains; kk++)
+    {
+      for (ii = 1; ii <= num_bins; ii++)
+        {
+          for (temp_slug = domains[kk]->top_slug[ii]; NULL != temp_slug; temp_slug = temp_slug->next)
+            {
+              num_slugs++;
+            }
+        }
+    }
+
+  // Save and restore.
+  start_time         = wall_time();
+  error              = error || t_o_domain_checkpoint(domains, num_domains, path);
+  checkpoint_seconds = wall_time() - start_time;
+
+  error = error || t_o_checkpoint_num_domains(path, &file_num_domains) || file_num_domains != num_domains;
+
+  start_time      = wall_time();
+  error           = error || t_o_domain_restore(restored, num_domains, domain_parameters, path);
+  restore_seconds = wall_time() - start_time;
+
+  if (error)
+    {
+      fprintf(stderr, "ERROR: Could not save or restore the ensemble.\n");
+      exit(1);
+    }
+
+  for (kk = 0; kk < num_domains; kk++)
+    {
+      identical = identical && t_o_domains_equal(domains[kk], restored[kk]);
+      surfacewater_depth[num_domains + kk]   = surfacewater_depth[kk];
+      groundwater_recharge[num_domains + kk] = groundwater_recharge[kk];
+    }
+
+  // Step the saved and restored ensembles side by side.
+  for (; !error && identical && current_time < spin_up_time + continue_time; current_time += delta_time)
+    {
+      error = step_ensemble(domains, num_domains, current_time, delta_time, water_table, surfacewater_depth, groundwater_recharge) ||
+          step_ensemble(restored, num_domains, current_time, delta_time, water_table, surfacewater_depth + num_domains,
+                        groundwater_recharge + num_domains);
+
+      for (kk = 0; kk < num_domains; kk++)
+        {
+          identical = identical && t_o_domains_equal(domains[kk], restored[kk]) &&
+              surfacewater_depth[kk] == surfacewater_depth[num_domains + kk] && groundwater_recharge[kk] == groundwater_recharge[num_domains + kk];
+        }
+    }
+
+  if (NULL != (fptr = fopen(path, "rb")))
+    {
+      fseek(fptr, 0, SEEK_END);
+      file_size = ftell(fptr);
+      fclose(fptr);
+    }
+  else
+    {
+      file_size = -1;
+    }
+
+  remove(path);
+
+  printf("%8s %8s %10s %12s %15s %13s %16s %10s\n", "domains", "bins", "slugs", "file bytes", "spin up seconds", "save seconds",
+         "restore seconds", "identical");
+  printf("%8d %8d %10lld %12ld %15lf %13lf %16lf %10s\n", num_domains, num_bins, num_slugs, file_size, spin_up_seconds, checkpoint_seconds,
+         restore_seconds, identical ? "YES" : "NO");
+
+  for (kk = 0; kk < num_domains; kk++)
+    {
+      t_o_domain_dealloc(&domains[kk]);
+      t_o_domain_dealloc(&restored[kk]);
+    }
+
+  t_o_parameters_dealloc(&parameters);
+  free(domains);
+  free(restored);
+  free(domain_parameters);
+  free(surfacewater_depth);
+  free(groundwater_recharge);
+
+  return error || !identical;
+}
@@ -0,0 +1,161 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "t_o_internal.h"
+#include "bench_util.h"
+#include "all.h"
+
+/* Benchmark the slug_index connected slug search in t_o_falling_slugs
+ * against the old search in t_o_falling_slugs_slow that walks the slug list
+ * of every bin to the right of each falling slug.  Two identical domains
+ * with slugs_per_bin slugs in every bin are stepped with each version and
+ * must end up bit for bit identical.
+ *
+ * Usage: bench_falling_slugs [num_bins [slugs_per_bin [timesteps]]]
+ *
+ * If num_bins is not given 1000, 2000, and 5000 bins are run.
+ */
+
+/* Allocate two identical domains with slugs_per_bin rain pulses worth of
+ * slugs.  Each pulse left a thin slug in every bin from the first bin that
+ * is not full of water to how far it wetted the domain, deeper in bins with higher conductivity like a detached
+ * surface front.  Bins to the right of the wetted extent have no slug from
+ * that pulse, so the rightmost connected slug is often far from the right
+ * side of the domain or does not exist.
+ * Return TRUE if there is an error, FALSE otherwise.
+ */
+int populate_domains(t_o_parameters* parameters, int slugs_per_bin, t_o_domain** domain1, t_o_domain** domain2)
+{
+  int    ii, jj;                     // Loop counters.
+  int    error              = FALSE; // Error flag.
+  double layer_bottom_depth = 2.0;   // Meters.
+  double spacing            = 0.8 * layer_bottom_depth / slugs_per_bin; // Meters between pulses.
+  int    first_bin;                  // The leftmost bin that is not completely full of water.
+  int    extent[slugs_per_bin];      // The rightmost bin wetted by each pulse.
+
+  error = t_o_domain_alloc(domain1, parameters, 0.0, layer_bottom_depth, FALSE, 0.08, FALSE, 0.0) ||
+      t_o_domain_alloc(domain2, parameters, 0.0, layer_bottom_depth, FALSE, 0.08, FALSE, 0.0);
+
+  if (!error)
+    {
+      first_bin = find_first_bin(*domain1, 2);
+    }
+
+  srand(1);
+
+  for (jj = 0; !error && jj < slugs_per_bin; jj++)
+    {
+      extent[jj] = first_bin + rand() % (parameters->num_bins - first_bin + 1);
+    }
+
+  for (ii = first_bin; !error && ii <= parameters->num_bins; ii++)
+    {
+      for (jj = 0; !error && jj < slugs_per_bin; jj++)
+        {
+          if (ii <= extent[jj])
+            {
+              double center = spacing * (jj + 0.5 + 0.2 * ii / parameters->num_bins); // Meters.
+              double top    = center - 0.15 * spacing;
+              double bot    = center + 0.15 * spacing;
+
+              error = create_slug_after(*domain1, ii, (*domain1)->bot_slug[ii], top, bot) ||
+                  create_slug_after(*domain2, ii, (*domain2)->bot_slug[ii], top, bot);
+            }
+        }
+    }
+
+  return error;
+}
+
+int main(int argc, char** argv)
+{
+  int             ii, jj;                       // Loop counters.
+  int             error          = FALSE;       // Error flag.
+  int             bin_counts[]   = {1000, 2000, 5000};
+  int             num_runs       = 3;           // Number of elements of bin_counts to run.
+  int             slugs_per_bin  = 8;           // Number of rain pulses that left slugs.
+  int             num_timesteps  = 5;           // Number of calls to each version of t_o_falling_slugs.
+  double          delta_time     = 60.0;        // The duration of the timestep in seconds.
+  t_o_parameters* parameters;
+  t_o_domain*     slow_domain;
+  t_o_domain*     fast_domain;
+
+  if (1 < argc)
+    {
+      bin_counts[0] = atoi(argv[1]);
+      num_runs      = 1;
+    }
+
+  if (2 < argc)
+    {
+      slugs_per_bin = atoi(argv[2]);
+    }
+
+  if (3 < argc)
+    {
+      num_timesteps = atoi(argv[3]);
+    }
+
+  if (2 > bin_counts[0] || 0 >= slugs_per_bin || 0 >= num_timesteps)
+    {
+      fprintf(stderr, "Usage: %s [num_bins [slugs_per_bin [timesteps]]]\n", argv[0]);
+      exit(1);
+    }
+
+  printf("%8s %8s %10s %12s %12s %10s %10s\n", "bins", "slugs", "timesteps", "old seconds", "new seconds", "speedup", "identical");
+
+  for (ii = 0; !error && ii < num_runs; ii++)
+    {
+      double slow_recharge = 0.0; // Meters of water.
+      double fast_recharge = 0.0; // Meters of water.
+      double slow_seconds  = 0.0; // Wall clock time of t_o_falling_slugs_slow.
+      double fast_seconds  = 0.0; // Wall clock time of t_o_falling_slugs.
+      double start_time;
+      int    identical;
+      int    num_slugs     = 0;   // The number of slugs at the start.
+
+      if (t_o_parameters_alloc(&parameters, bin_counts[ii], 1.0 / 360000.0, 0.4, 0.027, TRUE, 3.6, 1.56, 5.5, 0.37))
+        {
+          fprintf(stderr, "ERROR: Could not allocate t_o_parameters.\n");
+          exit(1);
+        }
+
+      if (populate_domains(parameters, slugs_per_bin, &slow_domain, &fast_domain))
+        {
+          fprintf(stderr, "ERROR: Could not allocate t_o_domain.\n");
+          exit(1);
+        }
+
+      for (jj = 1; jj <= bin_counts[ii]; jj++)
+        {
+          slug* temp_slug;
+
+          for (temp_slug = slow_domain->top_slug[jj]; NULL != temp_slug; temp_slug = temp_slug->next)
+            {
+              num_slugs++;
+            }
+        }
+
+      for (jj = 0; !error && jj < num_timesteps; jj++)
+        {
+          start_time    = wall_time();
+          error         = t_o_falling_slugs_slow(slow_domain, delta_time, find_first_bin(slow_domain, 2), &slow_recharge);
+          slow_seconds += wall_time() - start_time;
+
+          start_time    = wall_time();
+          error         = error || t_o_falling_slugs(fast_domain, delta_time, find_first_bin(fast_domain, 2), &fast_recharge);
+          fast_seconds += wall_time() - start_time;
+        }
+
+      identical = t_o_domains_equal(slow_domain, fast_domain) && slow_recharge == fast_recharge;
+      error     = error || !identical;
+
+      printf("%8d %8d %10d %12lf %12lf %10lf %10s\n", bin_counts[ii], num_slugs, num_timesteps, slow_seconds, fast_seconds,
+             slow_seconds / fast_seconds, identical ? "YES" : "NO");
+
+      t_o_domain_dealloc(&slow_domain);
+      t_o_domain_dealloc(&fast_domain);
+      t_o_parameters_dealloc(&parameters);
+    }
+
+  return error;
+}
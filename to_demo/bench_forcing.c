@@ -0,0 +1,302 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "forcing.h"
+#include "memfunc.h"
+#include "bench_util.h"
+#include "all.h"
+
+#define BINARY_FILE "bench_forcing.bin" // Scratch file for the binary conversion.  Removed at the end.
+
+/* Benchmark and equivalence check for the forcing reader.  A text forcing
+ * file is read the old way with fgets and fscanf, read by streaming the
+ * memory mapped text, converted to a binary forcing file, and read by
+ * streaming the memory mapped binary file.  The times and values of every
+ * record must be bit for bit identical.  The old way assumes 15 minute
+ * records like test_panama did.
+ *
+ * Then a simulation's lookup of the forcing each timestep is timed: the old
+ * linear rescan from the first record against a forcing_cursor.  With a
+ * timestep that divides the record interval they must give identical values.
+ * With timesteps that do not, the total of each value summed over the
+ * timesteps must match the total over the records to rounding error, for
+ * both step and linear interpolation.
+ *
+ * Usage: bench_forcing [forcing_file [repetitions]]
+ */
+
+/* Read every record of a forcing file through a forcing_stream into time and
+ * value.  Return TRUE if there is an error, FALSE otherwise.
+ */
+int read_forcing(const char* path, int num_records, double* time, double* value)
+{
+  int            error       = FALSE; // Error flag.
+  int            end_of_file = FALSE;
+  int            ii;                  // Loop counter.
+  forcing_file*  file;
+  forcing_stream stream;
+  forcing_record record;
+
+  error = forcing_open(&file, path);
+
+  if (!error)
+    {
+      forcing_stream_init(&stream, file);
+
+      for (ii = 1; !error && ii <= num_records; ii++)
+        {
+          error = forcing_read(&stream, &record, &end_of_file) || end_of_file;
+
+          if (!error)
+            {
+              time[ii]              = record.time;
+              value[2 * ii]         = record.value[0];
+              value[2 * ii + 1]     = record.value[1];
+            }
+        }
+
+      forcing_close(&file);
+    }
+
+  return error;
+}
+
+/* Time the old linear rescan against a forcing_cursor and check that the
+ * cursor splits timesteps across records correctly.  time and value are the
+ * records read with fscanf.  Return TRUE if there is an error or a check
+ * fails, FALSE otherwise.
+ */
+int check_cursor(const char* path, int num_records, double* time, double* value)
+{
+  int            error          = FALSE;             // Error flag.
+  int            ii, jj, kk;                         // Loop counters.
+  int            identical      = TRUE;              // Whether the rescan and the cursor give the same values.
+  double         dts[]          = {10.0, 7.0, 1234.5}; // Seconds.  The first divides the record interval.
+  double         max_time       = time[num_records] + time[2]; // The end of the last record.
+  double         current_time;                       // Seconds.
+  double         rescan_sum     = 0.0;               // The sum of the values looked up each timestep so the loops are not optimized away.
+  double         cursor_sum     = 0.0;
+  double         rescan_seconds = 0.0;
+  double         cursor_seconds = 0.0;
+  double         start_time;
+  double         mean[FORCING_MAX_VALUES];
+  double         total[2];                           // The sum of each value times the timestep.
+  double         expected[2]    = {0.0, 0.0};        // The sum of each value times the record interval.
+  double         relative_error = 0.0;               // The largest relative difference between total and expected.
+  forcing_file*  file;
+  forcing_cursor cursor;
+
+  error = forcing_open(&file, path);
+
+  // The old way.
+  start_time = wall_time();
+
+  for (current_time = 0.0; !error && current_time < max_time; current_time += dts[0])
+    {
+      ii = 1;
+
+      while (ii < num_records && current_time >= time[ii + 1])
+        {
+          ii++;
+        }
+
+      rescan_sum += value[2 * ii] + value[2 * ii + 1];
+    }
+
+  rescan_seconds = wall_time() - start_time;
+  start_time     = wall_time();
+  error          = error || forcing_cursor_init(&cursor, file, FORCING_STEP);
+
+  for (current_time = 0.0; !error && current_time < max_time; current_time += dts[0])
+    {
+      error       = forcing_cursor_mean(&cursor, current_time, current_time + dts[0], mean);
+      cursor_sum += mean[0] + mean[1];
+    }
+
+  cursor_seconds = wall_time() - start_time;
+
+  // Check the values separately so that the check is not timed.
+  error = error || forcing_cursor_init(&cursor, file, FORCING_STEP);
+
+  for (current_time = 0.0; !error && current_time < max_time; current_time += dts[0])
+    {
+      ii = 1;
+
+      while (ii < num_records && current_time >= time[ii + 1])
+        {
+          ii++;
+        }
+
+      error     = forcing_cursor_mean(&cursor, current_time, current_time + dts[0], mean);
+      identical = identical && mean[0] == value[2 * ii] && mean[1] == value[2 * ii + 1];
+    }
+
+  for (ii = 1; ii <= num_records; ii++)
+    {
+      expected[0] += value[2 * ii] * (time[2] - time[1]);
+      expected[1] += value[2 * ii + 1] * (time[2] - time[1]);
+    }
+
+  // Step and linear interpolation with timesteps that do not line up with the records.  Linear interpolation is only summed to the time of the
+  // last record because there is no record after it to interpolate to.
+  for (kk = FORCING_STEP; !error && kk <= FORCING_LINEAR; kk++)
+    {
+      for (jj = 1; !error && jj < (int)(sizeof(dts) / sizeof(dts[0])); jj++)
+        {
+          double sum_end  = (FORCING_LINEAR == kk) ? time[num_records] : max_time; // Seconds.  Where to stop summing.
+          double check[2] = {expected[0], expected[1]};                             // The exact integral of each value.
+
+          if (FORCING_LINEAR == kk)
+            {
+              // The integral of the piecewise linear function over [time[1], time[num_records]] is the trapezoid rule.
+              check[0] = check[1] = 0.0;
+
+              for (ii = 1; ii < num_records; ii++)
+                {
+                  check[0] += 0.5 * (value[2 * ii] + value[2 * ii + 2]) * (time[ii + 1] - time[ii]);
+                  check[1] += 0.5 * (value[2 * ii + 1] + value[2 * ii + 3]) * (time[ii + 1] - time[ii]);
+                }
+            }
+
+          total[0] = total[1] = 0.0;
+          error    = forcing_cursor_init(&cursor, file, kk);
+
+          for (current_time = 0.0; !error && current_time < sum_end; current_time += dts[jj])
+            {
+              double dt = min(dts[jj], sum_end - current_time);
+
+              error     = forcing_cursor_mean(&cursor, current_time, current_time + dt, mean);
+              total[0] += mean[0] * dt;
+              total[1] += mean[1] * dt;
+            }
+
+          for (ii = 0; ii < 2; ii++)
+            {
+              relative_error = max(relative_error, (total[ii] - check[ii]) / check[ii]);
+              relative_error = max(relative_error, (check[ii] - total[ii]) / check[ii]);
+            }
+        }
+    }
+
+  if (NULL != file)
+    {
+      forcing_close(&file);
+    }
+
+  if (!error)
+    {
+      printf("Lookup for %d timesteps of %.0lf seconds\n", (int)(max_time / dts[0]), dts[0]);
+      printf("%14s %14s %10s %10s %16s\n", "rescan", "cursor", "speedup", "identical", "split rel error");
+      identical = identical && rescan_sum == cursor_sum;
+
+      printf("%14lf %14lf %10.1lf %10s %16.3le\n", rescan_seconds, cursor_seconds, rescan_seconds / cursor_seconds, identical ? "YES" : "NO",
+             relative_error);
+    }
+
+  return error || !identical || 1.0e-9 < relative_error;
+}
+
+int main(int argc, char** argv)
+{
+  int           ii, jj;                                // Loop counters.
+  int           error       = FALSE;                   // Error flag.
+  const char*   path        = "example_rainfall_PET.txt";
+  int           repetitions = 20;                      // Number of times to read the file each way.
+  int           num_records = 0;
+  int           identical   = TRUE;                    // Whether every way gives the same result.
+  double        seconds[3]  = {0.0, 0.0, 0.0};         // Wall clock time of fscanf, mapped text, and mapped binary.
+  double        start_time;
+  double*       time[3];                               // The time of each record read each way.
+  double*       value[3];                              // The two values of each record read each way.
+  char          string[1000];
+  FILE*         fptr;
+  forcing_file* file;
+
+  if (1 < argc)
+    {
+      path = argv[1];
+    }
+
+  if (2 < argc)
+    {
+      repetitions = atoi(argv[2]);
+    }
+
+  if (0 >= repetitions || forcing_open(&file, path) || 2 > forcing_num_values(file))
+    {
+      fprintf(stderr, "Usage: %s [forcing_file [repetitions]]\nThe forcing file must have at least two values per record.\n", argv[0]);
+      exit(1);
+    }
+
+  num_records = forcing_num_records(file);
+  error       = forcing_write_binary(file, BINARY_FILE);
+
+  forcing_close(&file);
+
+  for (ii = 0; !error && ii < 3; ii++)
+    {
+      error = d_alloc(&time[ii], num_records) || d_alloc(&value[ii], 2 * num_records + 1);
+    }
+
+  for (jj = 0; !error && jj < repetitions; jj++)
+    {
+      // The old way.
+      start_time = wall_time();
+
+      if (NULL == (fptr = fopen(path, "r")))
+        {
+          fprintf(stderr, "ERROR: Could not open %s\n", path);
+          error = TRUE;
+        }
+      else
+        {
+          fgets(string, 1000, fptr); // Ignore header.
+
+          for (ii = 1; ii <= num_records; ii++)
+            {
+              error = error || 2 != fscanf(fptr, "%*d %*d %*d %*d %*d %lf %lf", &value[0][2 * ii], &value[0][2 * ii + 1]);
+              time[0][ii] = (ii - 1) * 15.0 * 60.0;
+            }
+
+          fclose(fptr);
+        }
+
+      seconds[0] += wall_time() - start_time;
+
+      // Streaming the mapped text and binary files.
+      start_time  = wall_time();
+      error       = error || read_forcing(path, num_records, time[1], value[1]);
+      seconds[1] += wall_time() - start_time;
+      start_time  = wall_time();
+      error       = error || read_forcing(BINARY_FILE, num_records, time[2], value[2]);
+      seconds[2] += wall_time() - start_time;
+    }
+
+  for (jj = 1; !error && jj < 3; jj++)
+    {
+      identical = identical && 0 == memcmp(time[0], time[jj], (num_records + 1) * sizeof(double)) &&
+          0 == memcmp(value[0], value[jj], (2 * num_records + 2) * sizeof(double));
+    }
+
+  if (!error)
+    {
+      printf("Records = %d, repetitions = %d\n", num_records, repetitions);
+      printf("%14s %14s %14s %10s\n", "fscanf", "mapped text", "mapped binary", "identical");
+      printf("%14lf %14lf %14lf %10s\n", seconds[0], seconds[1], seconds[2], identical ? "YES" : "NO");
+    }
+
+  if (!error && identical)
+    {
+      error = check_cursor(path, num_records, time[0], value[0]);
+    }
+
+  for (ii = 0; ii < 3; ii++)
+    {
+      d_dealloc(&time[ii], num_records);
+      d_dealloc(&value[ii], 2 * num_records + 1);
+    }
+
+  remove(BINARY_FILE);
+
+  return error || !identical;
+}
@@ -0,0 +1,168 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "t_o_internal.h"
+#include "bench_util.h"
+#include "all.h"
+
+#define MAX_THREADS (64)
+
+/* Scaling benchmark for t_o_timestep_parallel.  The same set of columns is
+ * stepped serially with t_o_timestep_batch and then with a thread pool of 1,
+ * 2, 4, ... MAX_THREADS threads.  Every parallel run must be bit for bit
+ * identical to the serial run.
+ *
+ * Usage: bench_parallel [num_columns [simulation_hours [max_threads]]]
+ */
+
+/* Allocate num_columns columns, step them for max_time seconds, and return
+ * the wall clock time in seconds or a negative number if there is an error.
+ * If pool is NULL step them serially with t_o_timestep_batch.
+ */
+double run_columns(t_o_parameters* parameters, t_o_thread_pool* pool, int num_columns, double max_time, double delta_time, t_o_domain** domains,
+                   double* surfacewater_depth, double* groundwater_recharge)
+{
+  int    ii;                   // Loop counter.
+  int    error = FALSE;        // Error flag.
+  double current_time;         // Current time in seconds.
+  double elapsed;              // Wall clock time in seconds.
+  double surfacewater_head[num_columns];
+  double water_table[num_columns];
+
+  for (ii = 0; !error && ii < num_columns; ii++)
+    {
+      error                    = t_o_domain_alloc(&domains[ii], parameters, 0.0, 1.0, TRUE, 0.08, TRUE, 1.0);
+      surfacewater_depth[ii]   = 0.0;
+      groundwater_recharge[ii] = 0.0;
+      water_table[ii]          = 1.0;
+    }
+
+  elapsed = wall_time();
+
+  for (current_time = 0.0; !error && current_time < max_time; current_time += delta_time)
+    {
+      for (ii = 0; ii < num_columns; ii++)
+        {
+          surfacewater_depth[ii] += column_rainfall_rate(ii, current_time) * delta_time;
+          surfacewater_head[ii]   = surfacewater_depth[ii];
+        }
+
+      if (NULL == pool)
+        {
+          error = t_o_timestep_batch(domains, num_columns, delta_time, surfacewater_head, surfacewater_depth, water_table, groundwater_recharge);
+        }
+      else
+        {
+          error = t_o_timestep_parallel(pool, domains, num_columns, delta_time, surfacewater_head, surfacewater_depth, water_table,
+                                        groundwater_recharge);
+        }
+    }
+
+  elapsed = wall_time() - elapsed;
+
+  return error ? -1.0 : elapsed;
+}
+
+int main(int argc, char** argv)
+{
+  int             ii, jj;                                // Loop counters.
+  int             error               = FALSE;           // Error flag.
+  int             num_columns         = 256;             // Number of columns to simulate.
+  double          max_time            = 6.0 * ONE_HOUR;  // How long to run the simulation in seconds.
+  int             max_threads         = MAX_THREADS;     // Largest thread count to try.
+  double          delta_time          = 10.0;            // The duration of the timestep in seconds.
+  double          serial_seconds;                        // Wall clock time of the serial run.
+  double          parallel_seconds;                      // Wall clock time of a parallel run.
+  int             num_threads;
+  t_o_parameters* parameters;
+  t_o_thread_pool* pool;
+
+  if (1 < argc)
+    {
+      num_columns = atoi(argv[1]);
+    }
+
+  if (2 < argc)
+    {
+      max_time = atof(argv[2]) * ONE_HOUR;
+    }
+
+  if (3 < argc)
+    {
+      max_threads = atoi(argv[3]);
+    }
+
+  if (0 >= num_columns || 0.0 >= max_time || 0 >= max_threads)
+    {
+      fprintf(stderr, "Usage: %s [num_columns [simulation_hours [max_threads]]]\n", argv[0]);
+      exit(1);
+    }
+
+  t_o_domain* serial_domains[num_columns];
+  t_o_domain* parallel_domains[num_columns];
+  double      serial_surfacewater_depth[num_columns];
+  double      serial_groundwater_recharge[num_columns];
+  double      parallel_surfacewater_depth[num_columns];
+  double      parallel_groundwater_recharge[num_columns];
+
+  if (t_o_parameters_alloc(&parameters, 300, 1.0 / 360000.0, 0.4, 0.027, TRUE, 3.6, 1.56, 5.5, 0.37))
+    {
+      fprintf(stderr, "ERROR: Could not allocate t_o_parameters.\n");
+      exit(1);
+    }
+
+  serial_seconds = run_columns(parameters, NULL, num_columns, max_time, delta_time, serial_domains, serial_surfacewater_depth,
+                               serial_groundwater_recharge);
+
+  if (0.0 > serial_seconds)
+    {
+      fprintf(stderr, "ERROR: Serial run failed.\n");
+      exit(1);
+    }
+
+  printf("Columns = %d, timesteps = %d\n", num_columns, (int)(max_time / delta_time + 0.5));
+  printf("%8s %12s %16s %10s %10s %10s\n", "threads", "seconds", "columns/second", "speedup", "efficiency", "identical");
+  printf("%8s %12lf %16lf %10lf %10s %10s\n", "serial", serial_seconds, num_columns * (max_time / delta_time) / serial_seconds, 1.0, "", "");
+
+  for (num_threads = 1; !error && num_threads <= max_threads; num_threads *= 2)
+    {
+      int identical = TRUE; // Whether the parallel run matches the serial run.
+
+      if (t_o_thread_pool_alloc(&pool, num_threads))
+        {
+          fprintf(stderr, "ERROR: Could not allocate t_o_thread_pool.\n");
+          exit(1);
+        }
+
+      parallel_seconds = run_columns(parameters, pool, num_columns, max_time, delta_time, parallel_domains, parallel_surfacewater_depth,
+                                     parallel_groundwater_recharge);
+      error            = 0.0 > parallel_seconds;
+
+      for (ii = 0; ii < num_columns; ii++)
+        {
+          identical = identical && t_o_domains_equal(serial_domains[ii], parallel_domains[ii]) &&
+              serial_surfacewater_depth[ii]   == parallel_surfacewater_depth[ii] &&
+              serial_groundwater_recharge[ii] == parallel_groundwater_recharge[ii];
+        }
+
+      error = error || !identical;
+
+      printf("%8d %12lf %16lf %10lf %10lf %10s\n", num_threads, parallel_seconds, num_columns * (max_time / delta_time) / parallel_seconds,
+             serial_seconds / parallel_seconds, serial_seconds / parallel_seconds / num_threads, identical ? "YES" : "NO");
+
+      for (jj = 0; jj < num_columns; jj++)
+        {
+          t_o_domain_dealloc(&parallel_domains[jj]);
+        }
+
+      t_o_thread_pool_dealloc(&pool);
+    }
+
+  for (ii = 0; ii < num_columns; ii++)
+    {
+      t_o_domain_dealloc(&serial_domains[ii]);
+    }
+
+  t_o_parameters_dealloc(&parameters);
+
+  return error;
+}
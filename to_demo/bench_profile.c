@@ -0,0 +1,344 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include "t_o.h"
+#include "epsilon.h"
+#include "bench_util.h"
+#include "all.h"
+
+/* Benchmark t_o_profile against the linked list get_t_o_domain_profile that
+ * test_panama and test_alf used to have.  A domain is stepped through a
+ * series of short storms that leave many slugs behind, and after every
+ * timestep the profile is sampled with both versions on the same grid of
+ * elements.  Only the time spent sampling is counted.  Both versions must
+ * give bit for bit identical profiles.  Domains with and without groundwater
+ * are both run.
+ *
+ * Usage: bench_profile [num_bins [num_elements [simulation_hours]]]
+ *
+ * By default 1000 bins and 1000 elements are run.
+ */
+
+/* A link list struct stores depth, theta with depth increasing order. */
+struct t_o_profile_link
+{
+  double depth;
+  double theta;
+  double pressure;
+  struct t_o_profile_link *next;
+};
+typedef struct t_o_profile_link t_o_profile_link;
+
+/* Insert a node with (depth, theta) into link list (head_pt), return error = TRUE if error occurs. */
+int insert_t_o_profile_link(t_o_profile_link** head_pt, double depth, double theta, double pressure, int yes_groundater)
+{
+  int error = FALSE;
+  assert(NULL != *head_pt);
+  
+  t_o_profile_link* pt_insert;
+  t_o_profile_link* pt_rear;
+  t_o_profile_link* pt_front;
+  
+  if (NULL == (pt_insert = (t_o_profile_link*)malloc(sizeof(t_o_profile_link))))
+    {
+      printf("malloc failed in creating t_o_profile_link node in function insert_t_o_profile_link(), exit.\n");
+      error = TRUE;
+      return error;
+    }
+  pt_insert->depth    = depth;
+  pt_insert->theta    = theta;
+  pt_insert->pressure = pressure;
+  pt_insert->next     = NULL;
+  
+  pt_rear  = *head_pt;
+  pt_front = (*head_pt)->next;
+  // Head pointer *head_pt is initialized with domain->top_depth, and pass in value (depth) is larger than domain->top_depth.
+  while (NULL != pt_front)
+    {
+      if (pt_insert->depth >= pt_front->depth)
+        {
+          pt_rear  = pt_front;
+          pt_front = pt_front->next;     
+        }
+      else
+        {
+          break;
+        }
+    }
+  
+  // Insert pt_insert only when depth is strictly larger than pt_rear->depth, so that depth in link is increasing without same value.
+  if (epsilon_greater(pt_insert->depth, pt_rear->depth))
+    {
+      pt_rear->next   = pt_insert;
+      pt_insert->next = pt_front;
+    }
+  else if (!yes_groundater && epsilon_equal(pt_insert->depth, pt_rear->depth) && pt_rear->theta < pt_insert->theta)
+    { // Add 10/09/14, to handle no groundwate cases,
+      pt_rear->theta    = pt_insert->theta;
+      pt_rear->pressure = pt_insert->pressure;
+    }
+  else
+    {
+      // Not inserted.
+      free(pt_insert);
+    }
+  return error;
+}
+
+/* Map t_o domain into water content in 1D space discretization, water_content[num_elements] and effective_porosity are output values.
+ *
+ * Parameters:
+ * domain             - A pointer to the t_o_domain struct.
+ * num_elements       - Number of element in 1d soil column.
+ * soil_depth_z       - A pointer to 1d array of size num_elements contains depth of each element's lower bound, in unit of [meters], positive downward.
+ *
+ * Output:
+ * water_content      - A pointer to 1d array of size num_elements contains water content of each element.
+ * pressure_head      - A pointer to 1d array of size num_elements contains pressure head of each element.
+ * effective_porosity - Scalar passed by reference, unitless.
+ */
+int get_t_o_domain_profile(t_o_domain* domain, int num_elements, double* soil_depth_z, 
+                           double* water_content,  double* pressure_head, double* effective_porosity)
+{
+  int error = FALSE;
+  int ii, jj, jj_start;
+  t_o_profile_link *head_pt = NULL, *tmp_pt = NULL, tmp;
+  
+  // Initialize head pointer node, fake node.
+  tmp.depth    = domain->layer_top_depth;
+  tmp.theta    = domain->parameters->bin_water_content[domain->parameters->num_bins];
+  tmp.pressure = 0.0;
+  tmp.next     = NULL;
+  head_pt      = &tmp;
+  
+  assert(NULL != domain);
+  
+  // Find effective porosity.
+  *effective_porosity = domain->parameters->bin_water_content[domain->parameters->num_bins];
+  
+  // Step 1, map the to_domain water content into link list t_o_profile_link_link.
+  // Loop over bins, start from bin 2, since bin 1 is always saturated.
+  for (ii = 2; ii <= domain->parameters->num_bins; ii++)
+     {
+       // Surface front.
+       if (domain->surface_front[ii] > domain->layer_top_depth && domain->surface_front[ii] <= domain->layer_bottom_depth) // Add "<=" 10/09/14.
+         {
+           error = insert_t_o_profile_link(&head_pt, domain->surface_front[ii], domain->parameters->bin_water_content[ii], 
+                                                                               -domain->parameters->bin_capillary_suction[ii], domain->yes_groundwater);
+         }
+        
+       // Slug.
+       slug* temp_slug = domain->top_slug[ii];
+       while (NULL != temp_slug)
+         {
+           // slug top.
+           error = insert_t_o_profile_link(&head_pt, temp_slug->top, domain->parameters->bin_water_content[ii - 1], 
+                                                                    -domain->parameters->bin_capillary_suction[ii - 1], domain->yes_groundwater);
+           
+           // slug bottom.
+           error = insert_t_o_profile_link(&head_pt, temp_slug->bot, domain->parameters->bin_water_content[ii], 
+                                                                   -domain->parameters->bin_capillary_suction[ii], domain->yes_groundwater);
+           
+           temp_slug = temp_slug->next;
+         }
+        
+       // groundwater front. 
+       if (domain->yes_groundwater)
+         {
+           if (domain->groundwater_front[ii] > domain->layer_top_depth)
+             {
+              error = insert_t_o_profile_link(&head_pt, domain->groundwater_front[ii], domain->parameters->bin_water_content[ii - 1], 
+                                                                                 -domain->parameters->bin_capillary_suction[ii - 1], domain->yes_groundwater);
+             }
+         }
+     } // End of bin loop.
+  
+  // Insert fully saturated bin;
+  if (domain->yes_groundwater)
+    {
+      error = insert_t_o_profile_link(&head_pt, domain->layer_bottom_depth, domain->parameters->bin_water_content[domain->parameters->num_bins], 
+                                                          0.0, domain->yes_groundwater);
+    }
+  else
+    {
+      int first_bin = 2; // The leftmost bin that is not completely full of water.
+ 
+      while (first_bin <= domain->parameters->num_bins && domain->parameters->bin_water_content[first_bin] <= domain->initial_water_content)
+       {
+         first_bin++;
+       }
+      error = insert_t_o_profile_link(&head_pt, domain->layer_bottom_depth, domain->parameters->bin_water_content[first_bin - 1], 
+                                                                         -domain->parameters->bin_capillary_suction[first_bin - 1], domain->yes_groundwater);
+    }
+
+  // Step 2, fill 1D array water content using t_o_profile_link_link.
+  tmp_pt   = head_pt;
+  jj_start = 1;
+  while (NULL != tmp_pt)
+    {
+      for (jj = jj_start; jj <= num_elements; jj++)
+         {
+           if (soil_depth_z[jj] <= tmp_pt->depth)
+             {
+               water_content[jj] = tmp_pt->theta;
+               pressure_head[jj] = tmp_pt->pressure;
+             }
+           else
+             {
+               jj_start = jj;
+               break;
+             }
+         }
+      tmp_pt = tmp_pt->next;
+    } 
+    
+  // Set head_pt to head_pt->next, as the first node is not malloc. Then free link-list.
+  head_pt = head_pt->next;
+  while (NULL != head_pt)
+    {
+       tmp_pt  = head_pt;
+       head_pt = head_pt->next;
+       free(tmp_pt);
+    }
+  
+  return error;
+} // End of get_t_o_domain_profile().
+
+int main(int argc, char** argv)
+{
+  int             jj;                             // Loop counter.
+  int             error           = FALSE;        // Error flag.
+  int             num_bins        = 1000;
+  int             num_elements    = 1000;
+  double          max_time        = 6.0 * ONE_HOUR; // How long to run the simulation in seconds.
+  double          delta_time      = 60.0;         // The duration of the timestep in seconds.
+  double          water_table     = 1.0;          // Meters.
+  double          effective_porosity;
+  int             yes_groundwater;
+  t_o_parameters* parameters;
+  t_o_domain*     domain;
+  double*         soil_depth_z;                   // 1D array of the depth of the lower bound of each element.
+  double*         water_content[2];               // 1D arrays of the water content of each element from each version.
+  double*         pressure_head[2];               // 1D arrays of the pressure head of each element from each version.
+
+  if (1 < argc)
+    {
+      num_bins = atoi(argv[1]);
+    }
+
+  if (2 < argc)
+    {
+      num_elements = atoi(argv[2]);
+    }
+
+  if (3 < argc)
+    {
+      max_time = atof(argv[3]) * ONE_HOUR;
+    }
+
+  if (2 > num_bins || 1 > num_elements || 0.0 >= max_time)
+    {
+      fprintf(stderr, "Usage: %s [num_bins [num_elements [simulation_hours]]]\n", argv[0]);
+      exit(1);
+    }
+
+  if (NULL == (soil_depth_z     = (double*)malloc((num_elements + 1) * sizeof(double))) ||
+      NULL == (water_content[0] = (double*)malloc((num_elements + 1) * sizeof(double))) ||
+      NULL == (water_content[1] = (double*)malloc((num_elements + 1) * sizeof(double))) ||
+      NULL == (pressure_head[0] = (double*)malloc((num_elements + 1) * sizeof(double))) ||
+      NULL == (pressure_head[1] = (double*)malloc((num_elements + 1) * sizeof(double))))
+    {
+      fprintf(stderr, "ERROR: Could not allocate element arrays.\n");
+      exit(1);
+    }
+
+  if (t_o_parameters_alloc(&parameters, num_bins, 1.0 / 360000.0, 0.4, 0.027, TRUE, 3.6, 1.56, 5.5, 0.37))
+    {
+      fprintf(stderr, "ERROR: Could not allocate t_o_parameters.\n");
+      exit(1);
+    }
+
+  printf("%8s %9s %12s %10s %10s %12s %12s %10s %10s\n", "bins", "elements", "groundwater", "max slugs", "samples", "list seconds",
+         "new seconds", "speedup", "identical");
+
+  for (yes_groundwater = TRUE; !error && yes_groundwater >= FALSE; yes_groundwater--)
+    {
+      double seconds[2]           = {0.0, 0.0}; // Wall clock time of each version.
+      double surfacewater_depth   = 0.0;        // Meters of water.
+      double groundwater_recharge = 0.0;        // Meters of water.
+      double current_time;                      // Seconds.
+      double start_time;
+      int    identical            = TRUE;       // Whether both versions give the same profile.
+      int    max_slugs            = 0;          // The largest number of slugs in the domain after a timestep.
+      int    num_samples          = 0;          // The number of times the profile was sampled.
+
+      if (t_o_domain_alloc(&domain, parameters, 0.0, 2.0, yes_groundwater, 0.08, TRUE, water_table))
+        {
+          fprintf(stderr, "ERROR: Could not allocate t_o_domain.\n");
+          exit(1);
+        }
+
+      for (jj = 0; jj <= num_elements; jj++)
+        {
+          soil_depth_z[jj] = domain->layer_top_depth + jj * (domain->layer_bottom_depth - domain->layer_top_depth) / num_elements;
+        }
+
+      for (current_time = 0.0; !error && current_time < max_time; current_time += delta_time)
+        {
+          int num_slugs = 0; // The number of slugs in the domain.
+
+          surfacewater_depth += burst_rainfall_rate(current_time, 0.01 / ONE_HOUR) * delta_time;
+          error               = t_o_timestep(domain, delta_time, surfacewater_depth, &surfacewater_depth, water_table, &groundwater_recharge);
+
+          for (jj = 2; jj <= num_bins; jj++)
+            {
+              slug* temp_slug;
+
+              for (temp_slug = domain->top_slug[jj]; NULL != temp_slug; temp_slug = temp_slug->next)
+                {
+                  num_slugs++;
+                }
+            }
+
+          max_slugs = max(max_slugs, num_slugs);
+
+          // Start both versions from the same values so that any element one of them does not fill in is caught.
+          for (jj = 1; jj <= num_elements; jj++)
+            {
+              water_content[0][jj] = water_content[1][jj] = -1.0;
+              pressure_head[0][jj] = pressure_head[1][jj] = -1.0;
+            }
+
+          start_time  = wall_time();
+          error       = get_t_o_domain_profile(domain, num_elements, soil_depth_z, water_content[0], pressure_head[0], &effective_porosity) || error;
+          seconds[0] += wall_time() - start_time;
+
+          start_time  = wall_time();
+          error       = t_o_profile(domain, num_elements, soil_depth_z, water_content[1], pressure_head[1]) || error;
+          seconds[1] += wall_time() - start_time;
+
+          num_samples++;
+
+          for (jj = 1; jj <= num_elements; jj++)
+            {
+              identical = identical && water_content[0][jj] == water_content[1][jj] && pressure_head[0][jj] == pressure_head[1][jj];
+            }
+        }
+
+      t_o_domain_dealloc(&domain);
+
+      error = error || !identical;
+
+      printf("%8d %9d %12s %10d %10d %12lf %12lf %10lf %10s\n", num_bins, num_elements, yes_groundwater ? "yes" : "no", max_slugs, num_samples,
+             seconds[0], seconds[1], seconds[0] / seconds[1], identical ? "YES" : "NO");
+    }
+
+  t_o_parameters_dealloc(&parameters);
+  free(soil_depth_z);
+  free(water_content[0]);
+  free(water_content[1]);
+  free(pressure_head[0]);
+  free(pressure_head[1]);
+
+  return error;
+}
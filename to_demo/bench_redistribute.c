@@ -0,0 +1,202 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "t_o_internal.h"
+#include "bench_util.h"
+#include "all.h"
+
+#define NUM_VERSIONS (3) // t_o_redistribute, t_o_redistribute_list_sort, and redistribute_slow.
+
+/* Benchmark the merge sort version of t_o_redistribute against the linked
+ * list insertion sort version in t_o_redistribute_list_sort and against
+ * redistribute_slow.  Identical domains are stepped through a series of short
+ * storms that leave many slugs behind, redistributing with a different
+ * version in each domain.  Only the time spent in redistribution is counted.
+ * The domains must end up bit for bit identical.  Domains with and without
+ * groundwater are both run.  The average number of front elements that the
+ * new version moved each time it re-sorted the fronts is also printed.
+ *
+ * Usage: bench_redistribute [num_bins [simulation_hours]]
+ *
+ * If num_bins is not given 1000, 2000, and 5000 bins are run.
+ */
+
+/* Do the same thing as t_o_timestep except that version selects the
+ * redistribution code, and add the time spent in it to seconds.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * domain               - A pointer to the t_o_domain struct.
+ * version              - 0 for t_o_redistribute, 1 for
+ *                        t_o_redistribute_list_sort, 2 for redistribute_slow.
+ * seconds              - Scalar passed by reference.  Time spent in
+ *                        redistribution is added to it.
+ * The other parameters are the same as t_o_timestep.
+ */
+int timestep_with_version(t_o_domain* domain, int version, double* seconds, double dt, double surfacewater_head, double* surfacewater_depth,
+                          double water_table, double* groundwater_recharge)
+{
+  int    error        = FALSE;                     // Error flag.
+  int    ponded_water = 0;                         // Flag set by t_o_satisfy_saturated_bins that must be passed to t_o_groundwater.
+  int    first_bin    = find_first_bin(domain, 2); // The leftmost bin that is not completely full of water.
+  double recharge_old = *groundwater_recharge;
+  double inflow_rate;                              // Flow rate through fully saturated bins in unit of meters per second.
+  double start_time;
+
+  error       = t_o_satisfy_saturated_bins(domain, dt, first_bin, surfacewater_depth, &ponded_water, groundwater_recharge, water_table);
+  inflow_rate = (*groundwater_recharge - recharge_old) / dt;
+
+  if (!error)
+    {
+      error = t_o_infiltrate(domain, dt, &first_bin, surfacewater_head, surfacewater_depth, groundwater_recharge, ponded_water, TRUE);
+    }
+
+  if (!error)
+    {
+      error = t_o_falling_slugs(domain, dt, first_bin, groundwater_recharge);
+    }
+
+  if (!error)
+    {
+      error = t_o_groundwater(domain, dt, &first_bin, water_table, ponded_water, groundwater_recharge, inflow_rate);
+    }
+
+  if (!error)
+    {
+      t_o_handle_sliver_slugs(domain);
+
+      start_time = wall_time();
+
+      switch (version)
+        {
+        case 0:
+          error = t_o_redistribute(domain, first_bin);
+          break;
+        case 1:
+          error = t_o_redistribute_list_sort(domain, first_bin);
+          break;
+        default:
+          error = redistribute_slow(domain);
+          break;
+        }
+
+      *seconds += wall_time() - start_time;
+    }
+
+  return error;
+}
+
+int main(int argc, char** argv)
+{
+  int             ii, jj, kk;                     // Loop counters.
+  int             error           = FALSE;        // Error flag.
+  int             bin_counts[]    = {1000, 2000, 5000};
+  int             num_runs        = 3;            // Number of elements of bin_counts to run.
+  double          max_time        = 6.0 * ONE_HOUR; // How long to run the simulation in seconds.
+  double          delta_time      = 60.0;         // The duration of the timestep in seconds.
+  double          water_table     = 1.0;          // Meters.
+  int             yes_groundwater;
+  t_o_parameters* parameters;
+  t_o_domain*     domains[NUM_VERSIONS];
+
+  if (1 < argc)
+    {
+      bin_counts[0] = atoi(argv[1]);
+      num_runs      = 1;
+    }
+
+  if (2 < argc)
+    {
+      max_time = atof(argv[2]) * ONE_HOUR;
+    }
+
+  if (2 > bin_counts[0] || 0.0 >= max_time)
+    {
+      fprintf(stderr, "Usage: %s [num_bins [simulation_hours]]\n", argv[0]);
+      exit(1);
+    }
+
+  printf("%8s %12s %10s %12s %12s %12s %10s %12s %10s\n", "bins", "groundwater", "max slugs", "new seconds", "list seconds", "slow seconds",
+         "speedup", "front moves", "identical");
+
+  for (ii = 0; !error && ii < num_runs; ii++)
+    {
+      if (t_o_parameters_alloc(&parameters, bin_counts[ii], 1.0 / 360000.0, 0.4, 0.027, TRUE, 3.6, 1.56, 5.5, 0.37))
+        {
+          fprintf(stderr, "ERROR: Could not allocate t_o_parameters.\n");
+          exit(1);
+        }
+
+      for (yes_groundwater = TRUE; !error && yes_groundwater >= FALSE; yes_groundwater--)
+        {
+          double seconds[NUM_VERSIONS]              = {0.0, 0.0, 0.0}; // Wall clock time of each version.
+          double surfacewater_depth[NUM_VERSIONS]   = {0.0, 0.0, 0.0}; // Meters of water.
+          double groundwater_recharge[NUM_VERSIONS] = {0.0, 0.0, 0.0}; // Meters of water.
+          double current_time;                                         // Seconds.
+          int    identical                          = TRUE;            // Whether all versions give the same result.
+          int    max_slugs                          = 0;               // The largest number of slugs in the domain after a timestep.
+          double front_moves                        = 0.0;             // The average number of front elements moved per re-sort.
+
+          for (kk = 0; !error && kk < NUM_VERSIONS; kk++)
+            {
+              error = t_o_domain_alloc(&domains[kk], parameters, 0.0, 2.0, yes_groundwater, 0.08, TRUE, water_table);
+            }
+
+          if (error)
+            {
+              fprintf(stderr, "ERROR: Could not allocate t_o_domain.\n");
+              exit(1);
+            }
+
+          for (current_time = 0.0; !error && current_time < max_time; current_time += delta_time)
+            {
+              int num_slugs = 0; // The number of slugs in the domain.
+
+              for (kk = 0; !error && kk < NUM_VERSIONS; kk++)
+                {
+                  surfacewater_depth[kk] += burst_rainfall_rate(current_time, 0.01 / ONE_HOUR) * delta_time;
+                  error                   = timestep_with_version(domains[kk], kk, &seconds[kk], delta_time, surfacewater_depth[kk],
+                                                                  &surfacewater_depth[kk], water_table, &groundwater_recharge[kk]);
+                }
+
+              for (jj = 1; jj <= bin_counts[ii]; jj++)
+                {
+                  slug* temp_slug;
+
+                  for (temp_slug = domains[0]->top_slug[jj]; NULL != temp_slug; temp_slug = temp_slug->next)
+                    {
+                      num_slugs++;
+                    }
+                }
+
+              max_slugs = max(max_slugs, num_slugs);
+            }
+
+          for (kk = 1; kk < NUM_VERSIONS; kk++)
+            {
+              identical = identical && t_o_domains_equal(domains[0], domains[kk]) && surfacewater_depth[0] == surfacewater_depth[kk] &&
+                  groundwater_recharge[0] == groundwater_recharge[kk];
+            }
+
+          if (0 < domains[0]->statistics.num_front_sorts)
+            {
+              front_moves = (double)(domains[0]->statistics.surface_front_moved + domains[0]->statistics.groundwater_front_moved) /
+                  domains[0]->statistics.num_front_sorts;
+            }
+
+          for (kk = 0; kk < NUM_VERSIONS; kk++)
+            {
+              t_o_domain_dealloc(&domains[kk]);
+            }
+
+          error = error || !identical;
+
+          printf("%8d %12s %10d %12lf %12lf %12lf %10lf %12.1lf %10s\n", bin_counts[ii], yes_groundwater ? "yes" : "no", max_slugs, seconds[0],
+                 seconds[1], seconds[2], seconds[1] / seconds[0], front_moves, identical ? "YES" : "NO");
+        }
+
+      t_o_parameters_dealloc(&parameters);
+    }
+
+  return error;
+}
@@ -0,0 +1,192 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "t_o_internal.h"
+#include "bench_util.h"
+#include "all.h"
+
+#define NUM_KERNELS (3) // Scalar, AVX2, and AVX-512.  See the SIMD_KERNEL values in t_o_internal.h.
+
+/* Microbenchmark and equivalence check for the infiltrate_distance and
+ * groundwater_distances kernels.  A domain is stepped through a storm so that
+ * its fronts are spread out.  Then every kernel the CPU supports fills in the
+ * distance arrays for several timesteps, surface water heads, water tables,
+ * and inflow rates, covering the cached dry depth, interpolated dry depth,
+ * zero suction, steady rainfall suction, and hydrostatic clamp cases.  The
+ * results are compared to the scalar kernel in units in the last place and
+ * must be bit for bit identical.
+ *
+ * Usage: bench_simd [num_bins [repetitions]]
+ */
+
+static const char* kernel_names[NUM_KERNELS] = {"scalar", "avx2", "avx512"};
+
+// Return the distance between a and b in units in the last place.  Doubles of the same sign are ordered like their bit patterns.
+long long ulps(double a, double b)
+{
+  long long bits_a;
+  long long bits_b;
+  long long difference;
+
+  memcpy(&bits_a, &a, sizeof(double));
+  memcpy(&bits_b, &b, sizeof(double));
+
+  if (0 > bits_a)
+    {
+      bits_a = (long long)0x8000000000000000ULL - bits_a;
+    }
+
+  if (0 > bits_b)
+    {
+      bits_b = (long long)0x8000000000000000ULL - bits_b;
+    }
+
+  difference = bits_a - bits_b;
+
+  return (0 > difference) ? -difference : difference;
+}
+
+int main(int argc, char** argv)
+{
+  int             ii, jj, kk, mm;                 // Loop counters.
+  int             error           = FALSE;        // Error flag.
+  int             num_bins        = 1000;         // Number of bins in the domain.
+  int             repetitions     = 2000;         // Number of times to call each kernel for each case.
+  int             best_kernel     = best_simd_kernel();
+  int             first_bin;                      // The leftmost bin that is not completely full of water.
+  double          current_time;                   // Seconds.
+  double          surfacewater_depth   = 0.0;     // Meters.
+  double          groundwater_recharge = 0.0;     // Meters.
+  double          dts[]           = {60.0, 7.0, 1.0e-3};  // Seconds.  The cached timestep, one in the dry depth table, and one below it.
+  double          heads[]         = {0.0, 0.05, -0.5};    // Meters.  The last one has more suction than some bins.
+  double          water_tables[]  = {1.0, 3.0};           // Meters.
+  double          seconds[2][NUM_KERNELS];                // Wall clock time of each kernel for infiltration and groundwater.
+  long long       max_ulps[2][NUM_KERNELS];               // Largest difference from the scalar kernel.
+  t_o_parameters* parameters;
+  t_o_domain*     domain;
+
+  if (1 < argc)
+    {
+      num_bins = atoi(argv[1]);
+    }
+
+  if (2 < argc)
+    {
+      repetitions = atoi(argv[2]);
+    }
+
+  if (2 > num_bins || 0 >= repetitions)
+    {
+      fprintf(stderr, "Usage: %s [num_bins [repetitions]]\n", argv[0]);
+      exit(1);
+    }
+
+  double distance[NUM_KERNELS][num_bins + 1];
+
+  if (t_o_parameters_alloc(&parameters, num_bins, 1.0 / 360000.0, 0.4, 0.027, TRUE, 3.6, 1.56, 5.5, 0.37) ||
+      t_o_domain_alloc(&domain, parameters, 0.0, 2.0, TRUE, 0.08, TRUE, 1.0))
+    {
+      fprintf(stderr, "ERROR: Could not allocate t_o_domain.\n");
+      exit(1);
+    }
+
+  // Rain for half an hour and let it soak in for half an hour.
+  for (current_time = 0.0; !error && current_time < ONE_HOUR; current_time += ONE_MINUTE)
+    {
+      if (current_time < 0.5 * ONE_HOUR)
+        {
+          surfacewater_depth += 0.02 / ONE_HOUR * ONE_MINUTE;
+        }
+
+      error = t_o_timestep(domain, ONE_MINUTE, surfacewater_depth, &surfacewater_depth, 1.0, &groundwater_recharge);
+    }
+
+  // Leave some water on the surface so that the surface fronts are spread out.
+  for (ii = 2; ii <= num_bins; ii++)
+    {
+      domain->surface_front[ii] = max(domain->surface_front[ii], 1.0e-2 * (num_bins - ii) / num_bins);
+    }
+
+  first_bin = find_first_bin(domain, 2);
+
+  for (kk = 0; kk < NUM_KERNELS; kk++)
+    {
+      seconds[0][kk]  = seconds[1][kk]  = 0.0;
+      max_ulps[0][kk] = max_ulps[1][kk] = 0;
+    }
+
+  // Infiltration.
+  for (ii = 0; !error && ii < (int)(sizeof(dts) / sizeof(dts[0])); ii++)
+    {
+      for (jj = 0; !error && jj < (int)(sizeof(heads) / sizeof(heads[0])); jj++)
+        {
+          for (kk = 0; !error && kk <= best_kernel; kk++)
+            {
+              double start_time = wall_time();
+
+              // Below the dry depth table grid every kernel falls back to the scalar root finding so only check it once and do not time it.
+              for (mm = 0; !error && mm < ((1.0e-2 > dts[ii]) ? 1 : repetitions); mm++)
+                {
+                  error = infiltrate_distance_with_kernel(domain, dts[ii], first_bin, heads[jj], distance[kk], TRUE, kk);
+                }
+
+              if (1.0e-2 <= dts[ii])
+                {
+                  seconds[0][kk] += wall_time() - start_time;
+                }
+
+              for (mm = first_bin; mm <= num_bins; mm++)
+                {
+                  max_ulps[0][kk] = max(max_ulps[0][kk], ulps(distance[0][mm], distance[kk][mm]));
+                }
+            }
+        }
+    }
+
+  // Groundwater.  The second inflow rate is between the conductivity of the first and last bins to use the steady rainfall suction.
+  for (ii = 0; !error && ii < (int)(sizeof(water_tables) / sizeof(water_tables[0])); ii++)
+    {
+      for (jj = 0; !error && jj < 2; jj++)
+        {
+          double inflow_rate = (0 == jj) ? 0.0 : 0.5 * (parameters->cumulative_conductivity[1] + parameters->cumulative_conductivity[num_bins]);
+
+          for (kk = 0; !error && kk <= best_kernel; kk++)
+            {
+              double start_time = wall_time();
+
+              for (mm = 0; !error && mm < repetitions; mm++)
+                {
+                  error = groundwater_distances(domain, first_bin, ONE_MINUTE, water_tables[ii], inflow_rate, distance[kk], kk);
+                }
+
+              seconds[1][kk] += wall_time() - start_time;
+
+              for (mm = first_bin; mm <= num_bins; mm++)
+                {
+                  max_ulps[1][kk] = max(max_ulps[1][kk], ulps(distance[0][mm], distance[kk][mm]));
+                }
+            }
+        }
+    }
+
+  if (!error)
+    {
+      printf("Bins = %d, first_bin = %d, repetitions = %d\n", num_bins, first_bin, repetitions);
+      printf("%12s %8s %12s %10s %10s %10s\n", "kernel", "", "seconds", "speedup", "max ulps", "identical");
+
+      for (ii = 0; ii < 2; ii++)
+        {
+          for (kk = 0; kk <= best_kernel; kk++)
+            {
+              printf("%12s %8s %12lf %10lf %10lld %10s\n", (0 == ii) ? "infiltrate" : "groundwater", kernel_names[kk], seconds[ii][kk],
+                     seconds[ii][0] / seconds[ii][kk], max_ulps[ii][kk], (0 == max_ulps[ii][kk]) ? "YES" : "NO");
+              error = error || 0 != max_ulps[ii][kk];
+            }
+        }
+    }
+
+  t_o_domain_dealloc(&domain);
+  t_o_parameters_dealloc(&parameters);
+
+  return error;
+}
@@ -0,0 +1,188 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "t_o_internal.h"
+#include "bench_util.h"
+#include "all.h"
+
+/* Benchmark the per-bin slug spans selected by SLUG_SPANS against the plain
+ * linked lists.  The makefile builds this file twice: bench_slug_spans
+ * without SLUG_SPANS and bench_slug_spans_on with it.  Both step the same
+ * columns with the same forcing and print a checksum of the bits of every
+ * front, slug, and total water value after every timestep.  The checksums
+ * of the two programs must be identical.  bench_slug_spans_on also checks
+ * after every timestep that the span of every bin holds exactly the depths
+ * of its linked list.
+ *
+ * Usage: bench_slug_spans [num_columns [simulation_hours]]
+ */
+
+// Mix the bits of value into checksum.
+void checksum_add(unsigned long long* checksum, double value)
+{
+  unsigned long long bits; // The bits of value.
+
+  memcpy(&bits, &value, sizeof(bits));
+
+  *checksum = (*checksum ^ bits) * 1099511628211ULL;
+}
+
+// Mix the fronts and slugs of domain into checksum.  The slugs are read from the linked lists in both builds.
+void checksum_domain(unsigned long long* checksum, t_o_domain* domain)
+{
+  int   ii; // Loop counter.
+  slug* temp_slug;
+
+  for (ii = 1; ii <= domain->parameters->num_bins; ii++)
+    {
+      checksum_add(checksum, domain->surface_front[ii]);
+
+      if (domain->yes_groundwater)
+        {
+          checksum_add(checksum, domain->groundwater_front[ii]);
+        }
+
+      for (temp_slug = domain->top_slug[ii]; NULL != temp_slug; temp_slug = temp_slug->next)
+        {
+          checksum_add(checksum, temp_slug->top);
+          checksum_add(checksum, temp_slug->bot);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+  int                ii, jj;                                 // Loop counters.
+  int                error                = FALSE;           // Error flag.
+  int                num_columns          = 16;              // Number of columns to simulate.
+  double             max_time             = 24.0 * ONE_HOUR; // How long to run the simulation in seconds.
+  double             delta_time           = 10.0;            // The duration of the timestep in seconds.
+  int                num_bins             = 300;             // Number of bins.
+  double             conductivity         = 1.0 / 360000.0;  // Meters per second.
+  double             porosity             = 0.4;             // Unitless fraction.
+  double             residual_saturation  = 0.027;           // Unitless fraction.
+  double             layer_top_depth      = 0.0;             // Meters.
+  double             layer_bottom_depth   = 1.0;             // Meters.
+  int                num_total_water_reps = 20;              // How many times to call t_o_total_water_in_domain per column per timestep.
+  double             current_time;                           // Current time in seconds.
+  double             timestep_seconds, total_water_seconds;  // Wall clock time of each part.
+  double             total_water          = 0.0;             // The sum of t_o_total_water_in_domain over all calls.
+  unsigned long long checksum             = 14695981039346656037ULL;
+  t_o_parameters*    parameters;
+
+  if (1 < argc)
+    {
+      num_columns = atoi(argv[1]);
+    }
+
+  if (2 < argc)
+    {
+      max_time = atof(argv[2]) * ONE_HOUR;
+    }
+
+  if (0 >= num_columns || 0.0 >= max_time)
+    {
+      fprintf(stderr, "Usage: %s [num_columns [simulation_hours]]\n", argv[0]);
+      exit(1);
+    }
+
+  t_o_domain* domains[num_columns];
+  double      surfacewater_depth[num_columns];
+  double      groundwater_recharge[num_columns];
+
+  if (t_o_parameters_alloc(&parameters, num_bins, conductivity, porosity, residual_saturation, TRUE, 3.6, 1.56, 5.5, 0.37))
+    {
+      fprintf(stderr, "ERROR: Could not allocate t_o_parameters.\n");
+      exit(1);
+    }
+
+  for (ii = 0; ii < num_columns; ii++)
+    {
+      if (t_o_domain_alloc(&domains[ii], parameters, layer_top_depth, layer_bottom_depth, 0 == ii % 2, 0.08, TRUE, layer_bottom_depth))
+        {
+          fprintf(stderr, "ERROR: Could not allocate t_o_domain.\n");
+          exit(1);
+        }
+
+      surfacewater_depth[ii]   = 0.0;
+      groundwater_recharge[ii] = 0.0;
+    }
+
+  timestep_seconds    = 0.0;
+  total_water_seconds = 0.0;
+
+  for (current_time = 0.0; !error && current_time < max_time; current_time += delta_time)
+    {
+      double start_time; // Seconds.
+
+      start_time = wall_time();
+
+      for (ii = 0; !error && ii < num_columns; ii++)
+        {
+          surfacewater_depth[ii] += column_rainfall_rate(ii, current_time) * delta_time;
+          error = t_o_timestep(domains[ii], delta_time, surfacewater_depth[ii], &surfacewater_depth[ii], layer_bottom_depth,
+                               &groundwater_recharge[ii]);
+        }
+
+      timestep_seconds += wall_time() - start_time;
+
+      // t_o_total_water_in_domain is the walk over every slug that reads the spans when SLUG_SPANS is defined.
+      start_time = wall_time();
+
+      for (ii = 0; !error && ii < num_columns; ii++)
+        {
+          for (jj = 0; jj < num_total_water_reps; jj++)
+            {
+              total_water += t_o_total_water_in_domain(domains[ii]);
+            }
+        }
+
+      total_water_seconds += wall_time() - start_time;
+
+      for (ii = 0; !error && ii < num_columns; ii++)
+        {
+#ifdef SLUG_SPANS
+          if (!slug_spans_match_lists(domains[ii]))
+            {
+              fprintf(stderr, "ERROR: The slug spans of column %d do not match its slug lists at time %lf.\n", ii, current_time);
+              error = TRUE;
+            }
+#endif // SLUG_SPANS
+
+          checksum_domain(&checksum, domains[ii]);
+          checksum_add(&checksum, t_o_total_water_in_domain(domains[ii]));
+          checksum_add(&checksum, surfacewater_depth[ii]);
+          checksum_add(&checksum, groundwater_recharge[ii]);
+        }
+    }
+
+  if (error)
+    {
+      fprintf(stderr, "ERROR: Timestep returned error.\n");
+      exit(1);
+    }
+
+  jj = (int)(max_time / delta_time + 0.5);
+
+#ifdef SLUG_SPANS
+  printf("SLUG_SPANS              = defined, spans checked against lists every timestep\n");
+#else // SLUG_SPANS
+  printf("SLUG_SPANS              = not defined\n");
+#endif // SLUG_SPANS
+  printf("Columns                 = %d\n", num_columns);
+  printf("Timesteps               = %d\n", jj);
+  printf("t_o_timestep            = %lf seconds, %lf columns per second\n", timestep_seconds, num_columns * (double)jj / timestep_seconds);
+  printf("Total water             = %lf seconds, %lf calls per second\n", total_water_seconds,
+         num_columns * (double)jj * num_total_water_reps / total_water_seconds);
+  printf("Total water sum         = %.17g\n", total_water);
+  printf("Checksum                = %016llx\n", checksum);
+
+  for (ii = 0; ii < num_columns; ii++)
+    {
+      t_o_domain_dealloc(&domains[ii]);
+    }
+
+  t_o_parameters_dealloc(&parameters);
+
+  return error;
+}
@@ -0,0 +1,296 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "t_o_internal.h"
+#include "bench_util.h"
+#include "all.h"
+
+/* Check and benchmark the staircase representation of t_o_domain state.  An
+ * ensemble of domains, half with groundwater and half without, is stepped
+ * through a series of short storms that leave many slugs behind.  Every
+ * check_minutes each domain is converted to a staircase and
+ *
+ *   - converted back to a second domain, which must be equal to it,
+ *   - its total water must match t_o_total_water_in_domain,
+ *   - its profile must match t_o_profile, and
+ *   - has_water_at_depth must agree at random bins and depths.
+ *
+ * The time to convert and to answer each query from the staircase is
+ * compared with answering it from the domain.
+ *
+ * A second ensemble is stepped the same way with T_O_REDISTRIBUTE_STAIRCASE.
+ * At every check it must be equal to the first, which redistributes with
+ * T_O_REDISTRIBUTE_SLUGS.  The time each ensemble spends in t_o_timestep is
+ * compared.
+ *
+ * Usage: bench_staircase [num_domains [num_bins [hours [check_minutes]]]]
+ *
+ * By default 8 domains of 1000 bins are stepped for 12 hours and checked
+ * every 10 minutes.
+ */
+
+int main(int argc, char** argv)
+{
+  int              ii, jj, kk;                     // Loop counters.
+  int              error            = FALSE;       // Error flag.
+  int              num_domains      = 8;
+  int              num_bins         = 1000;
+  int              num_elements     = 200;         // The number of profile depths.
+  int              num_probes       = 1000;        // The number of has_water_at_depth queries per check.
+  double           max_time         = 12.0 * ONE_HOUR; // Seconds.
+  double           check_interval   = 10.0 * ONE_MINUTE; // Seconds.
+  double           delta_time       = 60.0;        // The duration of the timestep in seconds.
+  double           water_table      = 1.0;         // Meters.
+  double           layer_depth      = 2.0;         // Meters.
+  double           current_time;                   // Seconds.
+  double           start_time;
+  double           from_seconds     = 0.0;         // Time in t_o_staircase_from_domain.
+  double           to_seconds       = 0.0;         // Time in t_o_staircase_to_domain.
+  double           domain_water_seconds    = 0.0;  // Time in t_o_total_water_in_domain.
+  double           staircase_water_seconds = 0.0;  // Time in t_o_staircase_total_water.
+  double           domain_profile_seconds    = 0.0; // Time in t_o_profile.
+  double           staircase_profile_seconds = 0.0; // Time in t_o_staircase_profile.
+  double           slugs_step_seconds     = 0.0;   // Time in t_o_timestep with T_O_REDISTRIBUTE_SLUGS.
+  double           staircase_step_seconds = 0.0;   // Time in t_o_timestep with T_O_REDISTRIBUTE_STAIRCASE.
+  double           max_water_error  = 0.0;         // The largest difference in total water in meters.
+  double           water;
+  long long        num_checks       = 0;           // The number of domain states checked.
+  long long        num_slugs        = 0;           // The total number of slugs in the checked states.
+  long long        num_steps        = 0;           // The total number of steps in the checked staircases.
+  long long        round_trip_fail  = 0;           // The number of round trips that did not give an equal domain.
+  long long        profile_fail     = 0;           // The number of profile elements that did not match.
+  long long        probe_fail       = 0;           // The number of has_water_at_depth queries that did not match.
+  long long        redistribute_fail = 0;          // The number of checks where the two ensembles were not equal.
+  t_o_parameters*  parameters;
+  t_o_domain**     domains;                        // The stepped ensemble.
+  t_o_domain**     copies;                         // Domains converted back from staircases.
+  t_o_domain**     redistributed;                  // The ensemble stepped with T_O_REDISTRIBUTE_STAIRCASE.
+  t_o_staircase**  staircases;                     // The staircase of each domain.
+  double*          surfacewater_depth;             // Meters of water for each domain.
+  double*          groundwater_recharge;           // Meters of water for each domain.
+  double*          redistributed_surfacewater;     // Meters of water for each domain of redistributed.
+  double*          redistributed_recharge;         // Meters of water for each domain of redistributed.
+  double*          element_depth;                  // 1D array of profile depths with one based indexing.
+  double*          domain_theta;                   // 1D array of the profile from t_o_profile.
+  double*          domain_pressure;
+  double*          staircase_theta;                // 1D array of the profile from t_o_staircase_profile.
+  double*          staircase_pressure;
+  slug*            temp_slug;
+
+  if (1 < argc)
+    {
+      num_domains = atoi(argv[1]);
+    }
+
+  if (2 < argc)
+    {
+      num_bins = atoi(argv[2]);
+    }
+
+  if (3 < argc)
+    {
+      max_time = atof(argv[3]) * ONE_HOUR;
+    }
+
+  if (4 < argc)
+    {
+      check_interval = atof(argv[4]) * ONE_MINUTE;
+    }
+
+  if (1 > num_domains || 2 > num_bins || 0.0 > max_time || delta_time > check_interval)
+    {
+      fprintf(stderr, "Usage: %s [num_domains [num_bins [hours [check_minutes]]]]\n", argv[0]);
+      exit(1);
+    }
+
+  if (NULL == (domains              = (t_o_domain**)malloc(num_domains * sizeof(t_o_domain*)))       ||
+      NULL == (copies               = (t_o_domain**)malloc(num_domains * sizeof(t_o_domain*)))       ||
+      NULL == (redistributed        = (t_o_domain**)malloc(num_domains * sizeof(t_o_domain*)))       ||
+      NULL == (staircases           = (t_o_staircase**)malloc(num_domains * sizeof(t_o_staircase*))) ||
+      NULL == (surfacewater_depth   = (double*)calloc(num_domains, sizeof(double)))                  ||
+      NULL == (groundwater_recharge = (double*)calloc(num_domains, sizeof(double)))                  ||
+      NULL == (redistributed_surfacewater = (double*)calloc(num_domains, sizeof(double)))            ||
+      NULL == (redistributed_recharge     = (double*)calloc(num_domains, sizeof(double)))            ||
+      NULL == (element_depth        = (double*)malloc((num_elements + 1) * sizeof(double)))          ||
+      NULL == (domain_theta         = (double*)malloc((num_elements + 1) * sizeof(double)))          ||
+      NULL == (domain_pressure      = (double*)malloc((num_elements + 1) * sizeof(double)))          ||
+      NULL == (staircase_theta      = (double*)malloc((num_elements + 1) * sizeof(double)))          ||
+      NULL == (staircase_pressure   = (double*)malloc((num_elements + 1) * sizeof(double))))
+    {
+      fprintf(stderr, "ERROR: Could not allocate ensemble arrays.\n");
+      exit(1);
+    }
+
+  for (jj = 1; jj <= num_elements; jj++)
+    {
+      element_depth[jj] = layer_depth * (jj - 0.5) / num_elements;
+    }
+
+  if (t_o_parameters_alloc(&parameters, num_bins, 1.0 / 360000.0, 0.4, 0.027, TRUE, 3.6, 1.56, 5.5, 0.37))
+    {
+      fprintf(stderr, "ERROR: Could not allocate t_o_parameters.\n");
+      exit(1);
+    }
+
+  for (kk = 0; !error && kk < num_domains; kk++)
+    {
+      error = t_o_domain_alloc(&domains[kk], parameters, 0.0, layer_depth, 0 == kk % 2, 0.08, TRUE, water_table) ||
+          t_o_domain_alloc(&copies[kk], parameters, 0.0, layer_depth, 0 == kk % 2, 0.08, TRUE, water_table) ||
+          t_o_domain_alloc(&redistributed[kk], parameters, 0.0, layer_depth, 0 == kk % 2, 0.08, TRUE, water_table) ||
+          t_o_set_redistribution(redistributed[kk], T_O_REDISTRIBUTE_STAIRCASE) ||
+          t_o_staircase_alloc(&staircases[kk], domains[kk]);
+    }
+
+  if (error)
+    {
+      fprintf(stderr, "ERROR: Could not allocate t_o_domain.\n");
+      exit(1);
+    }
+
+  srand(1);
+
+  for (current_time = 0.0; !error && current_time < max_time; current_time += delta_time)
+    {
+      start_time = wall_time();
+
+      for (kk = 0; !error && kk < num_domains; kk++)
+        {
+          surfacewater_depth[kk] += burst_rainfall_rate(current_time, (0.005 + 0.001 * (kk % 8)) / ONE_HOUR) * delta_time;
+          error                   = t_o_timestep(domains[kk], delta_time, surfacewater_depth[kk], &surfacewater_depth[kk], water_table,
+                                                 &groundwater_recharge[kk]);
+        }
+
+      slugs_step_seconds += wall_time() - start_time;
+      start_time          = wall_time();
+
+      for (kk = 0; !error && kk < num_domains; kk++)
+        {
+          redistributed_surfacewater[kk] += burst_rainfall_rate(current_time, (0.005 + 0.001 * (kk % 8)) / ONE_HOUR) * delta_time;
+          error                           = t_o_timestep(redistributed[kk], delta_time, redistributed_surfacewater[kk],
+                                                         &redistributed_surfacewater[kk], water_table, &redistributed_recharge[kk]);
+        }
+
+      staircase_step_seconds += wall_time() - start_time;
+
+      if (error || delta_time <= fmod(current_time + delta_time, check_interval))
+        {
+          continue;
+        }
+
+      for (kk = 0; !error && kk < num_domains; kk++)
+        {
+          num_checks++;
+
+          for (ii = 1; ii <= num_bins; ii++)
+            {
+              for (temp_slug = domains[kk]->top_slug[ii]; NULL != temp_slug; temp_slug = temp_slug->next)
+                {
+                  num_slugs++;
+                }
+            }
+
+          start_time    = wall_time();
+          error         = t_o_staircase_from_domain(staircases[kk], domains[kk]);
+          from_seconds += wall_time() - start_time;
+          num_steps    += staircases[kk]->num_steps;
+
+          start_time  = wall_time();
+          error       = error || t_o_staircase_to_domain(staircases[kk], copies[kk]);
+          to_seconds += wall_time() - start_time;
+
+          if (!error && !t_o_domains_equal(domains[kk], copies[kk]))
+            {
+              round_trip_fail++;
+            }
+
+          if (!t_o_domains_equal(domains[kk], redistributed[kk]) || surfacewater_depth[kk] != redistributed_surfacewater[kk] ||
+              groundwater_recharge[kk] != redistributed_recharge[kk])
+            {
+              redistribute_fail++;
+            }
+
+          start_time               = wall_time();
+          water                    = t_o_total_water_in_domain(domains[kk]);
+          domain_water_seconds    += wall_time() - start_time;
+          start_time               = wall_time();
+          water                   -= t_o_staircase_total_water(staircases[kk]);
+          staircase_water_seconds += wall_time() - start_time;
+
+          if (max_water_error < fabs(water))
+            {
+              max_water_error = fabs(water);
+            }
+
+          start_time                 = wall_time();
+          error                      = error || t_o_profile(domains[kk], num_elements, element_depth, domain_theta, domain_pressure);
+          domain_profile_seconds    += wall_time() - start_time;
+          start_time                 = wall_time();
+          error                      = error || t_o_staircase_profile(staircases[kk], num_elements, element_depth, staircase_theta,
+                                                                      staircase_pressure);
+          staircase_profile_seconds += wall_time() - start_time;
+
+          for (jj = 1; !error && jj <= num_elements; jj++)
+            {
+              if (domain_theta[jj] != staircase_theta[jj] || domain_pressure[jj] != staircase_pressure[jj])
+                {
+                  profile_fail++;
+                }
+            }
+
+          for (jj = 0; !error && jj < num_probes; jj++)
+            {
+              int    bin = 1 + rand() % num_bins;
+              double top = layer_depth * rand() / RAND_MAX;
+              double bot = top + (layer_depth - top) * (jj % 2) * rand() / RAND_MAX; // Half of the queries are points.
+
+              if (has_water_at_depth(domains[kk], bin, top, bot) != t_o_staircase_has_water_at_depth(staircases[kk], bin, top, bot))
+                {
+                  probe_fail++;
+                }
+            }
+        }
+    }
+
+  if (error)
+    {
+      fprintf(stderr, "ERROR: Could not step or convert the ensemble.\n");
+      exit(1);
+    }
+
+  printf("%8s %8s %8s %12s %12s %16s %16s %14s %14s\n", "domains", "bins", "checks", "mean slugs", "mean steps", "round trip fails",
+         "max water error", "profile fails", "probe fails");
+  printf("%8d %8d %8lld %12.1lf %12.1lf %16lld %16.3le %14lld %14lld\n", num_domains, num_bins, num_checks, (double)num_slugs / num_checks,
+         (double)num_steps / num_checks, round_trip_fail, max_water_error, profile_fail, probe_fail);
+  printf("Microseconds per call: from domain %.2lf, to domain %.2lf, total water domain %.2lf staircase %.2lf, "
+         "profile domain %.2lf staircase %.2lf\n", 1.0e6 * from_seconds / num_checks, 1.0e6 * to_seconds / num_checks,
+         1.0e6 * domain_water_seconds / num_checks, 1.0e6 * staircase_water_seconds / num_checks, 1.0e6 * domain_profile_seconds / num_checks,
+         1.0e6 * staircase_profile_seconds / num_checks);
+  printf("Redistributing on the staircase: %lld checks not equal, t_o_timestep %.2lf microseconds per call with slugs and %.2lf with the "
+         "staircase\n", redistribute_fail, 1.0e6 * slugs_step_seconds / (num_domains * (max_time / delta_time)),
+         1.0e6 * staircase_step_seconds / (num_domains * (max_time / delta_time)));
+
+  for (kk = 0; kk < num_domains; kk++)
+    {
+      t_o_staircase_dealloc(&staircases[kk]);
+      t_o_domain_dealloc(&domains[kk]);
+      t_o_domain_dealloc(&copies[kk]);
+      t_o_domain_dealloc(&redistributed[kk]);
+    }
+
+  t_o_parameters_dealloc(&parameters);
+  free(domains);
+  free(copies);
+  free(redistributed);
+  free(staircases);
+  free(surfacewater_depth);
+  free(groundwater_recharge);
+  free(redistributed_surfacewater);
+  free(redistributed_recharge);
+  free(element_depth);
+  free(domain_theta);
+  free(domain_pressure);
+  free(staircase_theta);
+  free(staircase_pressure);
+
+  return error || 0 != round_trip_fail || 0 != probe_fail || 0 != redistribute_fail;
+}
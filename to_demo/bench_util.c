@@ -0,0 +1,33 @@
+#include <time.h>
+#include "bench_util.h"
+
+/* Comment in .h file. */
+double wall_time(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return now.tv_sec + now.tv_nsec * 1.0e-9;
+}
+
+/* Comment in .h file. */
+double burst_rainfall_rate(double current_time, double rate)
+{
+  return (current_time - 30.0 * ONE_MINUTE * (int)(current_time / (30.0 * ONE_MINUTE)) < 5.0 * ONE_MINUTE) ? rate : 0.0;
+}
+
+/* Comment in .h file. */
+double column_rainfall_rate(int column, double current_time)
+{
+  double period = (6.0 + column % 5) * ONE_HOUR; // Seconds between the start of each storm.
+  double phase  = current_time - (column % 3) * ONE_HOUR;
+  double rate   = 0.0;
+
+  if (0.0 <= phase && phase - period * (int)(phase / period) < ONE_HOUR)
+    {
+      rate = (1.0 + column % 7) * 0.01 / ONE_HOUR;
+    }
+
+  return rate;
+}
@@ -0,0 +1,20 @@
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+// Helpers shared by the bench programs.
+
+#define ONE_MINUTE (60.0)
+#define ONE_HOUR   (60.0 * ONE_MINUTE)
+
+// Return the wall clock time in seconds.
+double wall_time(void);
+
+// Return rate in meters per second during the first five minutes of every half hour and zero otherwise.  Each burst leaves a new set of slugs
+// behind.
+double burst_rainfall_rate(double current_time, double rate);
+
+// Return the rainfall rate in meters per second for column at current_time.  Each column gets storms of a different intensity and phase so that
+// the columns do not all have the same state and take different amounts of work to step.
+double column_rainfall_rate(int column, double current_time);
+
+#endif // BENCH_UTIL_H
@@ -0,0 +1,20 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "output_writer.h"
+
+/* Convert a binary output file written by an output_writer, such as f.bin or
+ * accum_depth.bin from test_panama built with BINARY_OUTPUT, to the text
+ * layout it would have been written in so that plot_f can load it.
+ *
+ * Usage: output_to_text binary_file text_file
+ */
+int main(int argc, char** argv)
+{
+  if (3 != argc)
+    {
+      fprintf(stderr, "Usage: %s binary_file text_file\n", argv[0]);
+      exit(1);
+    }
+
+  return output_convert_to_text(argv[1], argv[2]);
+}
@@ -0,0 +1,1422 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <ctype.h>
+#include <stddef.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "t_o.h"
+#include "epsilon.h"
+#include "all.h"
+#include "memfunc.h"
+#include "forcing.h"
+#include "output_writer.h"
+
+#define ONE_MINUTE            (60.0)
+#define ONE_HOUR              (60.0 * ONE_MINUTE)
+#define ONE_DAY               (24.0 * ONE_HOUR)
+#define SCENARIO_MAX_NAME     (64)   // The longest scenario name including the NUL.
+#define SCENARIO_MAX_PATH     (256)  // The longest file name including the NUL.
+#define SCENARIO_MAX_PULSES   (16)   // The most rain_pulse lines in one scenario.
+#define SCENARIO_MAX_PROFILES (16)   // The most profile_days in one scenario.
+#define MANIFEST_MAX_LINE     (1024) // The longest manifest line.
+
+/* Run Talbot-Ogden scenarios listed in a manifest file without a display.
+ * Scenarios run concurrently, one per worker thread, and each one writes its
+ * own output files.  This replaces editing test_id in test_panama.c and
+ * recompiling for each scenario.  scenarios.txt has every scenario that
+ * test_panama.c has.
+ *
+ * Usage: run_scenarios [-b] [-s prefix] [-t table] manifest [num_threads]
+ *
+ * If num_threads is not given one thread per processor is used.
+ *
+ * -b        - Run the scenarios one at a time on one thread first as a
+ *             serial baseline, then run them again concurrently, and report
+ *             the wall clock time of both and whether the results match.
+ * -s prefix - Only run the scenarios whose names start with prefix.  For
+ *             example -s usda_ runs the ensemble of the twelve USDA soil
+ *             textures in scenarios.txt.
+ * -t table  - Also write the table of results to the file table.
+ *
+ * Each forcing file is opened once and shared read only by every scenario
+ * that uses it, so an ensemble of soil parameter sets all run against one
+ * copy of the forcing series in memory.
+ *
+ * A manifest is a list of sections.  Each section starts with its name in
+ * square brackets on a line by itself and is followed by key = value lines.
+ * Everything after # on a line is a comment.  The keys in a section named
+ * defaults are applied to every scenario after it.  Every other section is a
+ * scenario, starting from the defaults and then applying its own keys.
+ *
+ * [defaults]
+ * num_bins = 300
+ * forcing_file = example_rainfall_PET.txt
+ *
+ * [sand]
+ * conductivity_cm_per_hour = 29.7
+ *
+ * Keys:
+ *
+ * num_bins                  - The number of bins.
+ * conductivity_cm_per_hour  - Saturated hydraulic conductivity in cm/hr.
+ * porosity                  - Unitless fraction.
+ * residual_saturation       - Unitless fraction.
+ * van_genutchen             - 1 to use the Van Genutchen parameters, 0 for
+ *                             Brook-Corey.
+ * vg_alpha                  - Van Genutchen parameter in one over meters.
+ * vg_n                      - Van Genutchen parameter, unitless.
+ * bc_lambda                 - Brook-Corey parameter, unitless.
+ * bc_psib                   - Brook-Corey parameter in meters.
+ * layer_top_depth           - Meters.
+ * layer_bottom_depth        - Meters.
+ * yes_groundwater           - 1 to simulate groundwater, 0 not to.
+ * yes_runoff                - 1 to remove surface water after each timestep.
+ * initial_water_content     - Unitless fraction.
+ * water_table               - Meters.  Defaults to layer_bottom_depth.
+ * delta_time                - The duration of the timestep in seconds.
+ * max_time_hours            - How long to run the simulation in hours.
+ * forcing_file              - Rainfall and PET file like example_rainfall_PET.txt
+ *                             in mm per 15 minutes.  Leave empty for none.
+ * rainfall_scale            - Factor to multiply the forcing file rainfall by.
+ * rain_pulse                - start_hours end_hours rate_cm_per_hour.  Rain
+ *                             falls at rate from start to before end.  Can be
+ *                             given more than once.  Adds to forcing_file.
+ *                             Leave empty to clear the pulses.
+ * yes_et                    - 1 to take evapotranspiration with t_o_ET.
+ * et_root_depth             - Meters.  The remaining et_ keys are the t_o_ET
+ * et_field_capacity           parameters of the same name.
+ * et_wilting_point
+ * et_use_feddes
+ * et_field_capacity_suction
+ * et_wilting_point_suction
+ * num_elements              - The number of elements in the profile outputs.
+ * profile_days              - Up to 16 days to write the profile on.
+ * output_interval           - Seconds between rows of the _f output.
+ * binary_output             - 1 to write the _f and _accum_depth outputs in
+ *                             the binary format of output_writer.h with a
+ *                             .bin extension.
+ * output_dir                - The directory to write the outputs in.
+ * adaptive_tolerance        - Meters of water.  If greater than zero each
+ *                             delta_time is covered by t_o_timestep_adaptive
+ *                             with steps of adaptive_min_dt up to delta_time
+ *                             chosen to keep the error of each step within
+ *                             this.  Use a delta_time like 900 so dry periods
+ *                             take few steps.  ET is taken once per
+ *                             delta_time.  Zero for fixed steps of delta_time.
+ * adaptive_min_dt           - The smallest adaptive step in seconds.
+ * adaptive_max_front_move   - Meters.  The farthest a surface front may move
+ *                             in one adaptive step.
+ * event_max_dt              - Seconds.  If greater than zero each delta_time
+ *                             is covered by t_o_timestep_events with steps
+ *                             that end at the next predicted collision of
+ *                             fronts and slugs, but no longer than this.  Use
+ *                             the forcing interval as delta_time.  ET is taken
+ *                             once per delta_time.  Zero for fixed steps.
+ * event_max_wet_dt          - Seconds.  The largest event driven step while
+ *                             there is rain or surface water.  Infiltration
+ *                             depends on the step so set this to the fixed
+ *                             delta_time the results should agree with.
+ * event_min_dt              - The smallest event driven step in seconds.
+ * multirate_substeps        - If greater than zero each delta_time is one
+ *                             outer step of t_o_timestep_multirate with this
+ *                             many infiltration and falling slug sub-steps.
+ *                             Groundwater and redistribution run once per
+ *                             delta_time.  Zero for t_o_timestep.  Use
+ *                             this for long delta_time with rain.  Sub-steps
+ *                             as long as a fixed delta_time give the same
+ *                             infiltration.
+ * integrator                - How fronts advance in a step.  0 for forward
+ *                             Euler, 1 for fourth order Runge-Kutta, 2 for
+ *                             semi-analytic Green-Ampt.  Event driven steps
+ *                             always use Green-Ampt.
+ * redistribution            - How water is moved sideways after a step.  0
+ *                             for slugs, 1 for the staircase.  Both give the
+ *                             same results.
+ *
+ * Each scenario writes these files in output_dir:
+ *
+ * NAME_f.out                - Time, rainfall, infiltration, recharge, and ET
+ *                             like test_panama's f.out.
+ * NAME_accum_depth.out      - Time and runoff like accum_depth.out.
+ * NAME_profile_day_DAY.txt  - Depth, water content, and pressure head.
+ * NAME_summary.txt          - The mass balance.
+ *
+ * A table of the mass balance of every scenario is printed at the end.  Where
+ * test_panama.c asserts that the mass balance of each timestep is epsilon
+ * equal this reports the largest error instead so that one scenario can not
+ * stop the others.
+ */
+
+// All of the settings of a scenario.
+typedef struct
+{
+  char   name[SCENARIO_MAX_NAME];                   // From the section header.  Output file names start with it.
+  int    num_bins;                                  // The number of bins.
+  double conductivity_cm_per_hour;                  // Centimeters per hour.
+  double porosity;                                  // Unitless fraction.
+  double residual_saturation;                       // Unitless fraction.
+  int    van_genutchen;                             // Whether to use Van Genuchten.
+  double vg_alpha;                                  // One over meters.
+  double vg_n;                                      // Unitless.
+  double bc_lambda;                                 // Unitless.
+  double bc_psib;                                   // Meters.
+  double layer_top_depth;                           // Meters.
+  double layer_bottom_depth;                        // Meters.
+  int    yes_groundwater;                           // Whether to simulate groundwater.
+  int    yes_runoff;                                // Whether to remove excess surface water after each timestep.
+  double initial_water_content;                     // Unitless fraction.
+  double water_table;                               // Meters or NAN to use layer_bottom_depth.
+  double delta_time;                                // The duration of the timestep in seconds.
+  double max_time_hours;                            // How long to run the simulation in hours.
+  char   forcing_file[SCENARIO_MAX_PATH];           // The rainfall and PET file or empty for none.
+  double rainfall_scale;                            // Factor to multiply the forcing file rainfall by.
+  int    num_rain_pulses;                           // The number of rain pulses.
+  double rain_pulse[SCENARIO_MAX_PULSES][3];        // Start in hours, end in hours, and rate in cm/hr of each rain pulse.
+  int    yes_et;                                    // Whether to take evapotranspiration.
+  double et_root_depth;                             // Meters.
+  double et_field_capacity;                         // Unitless fraction.
+  double et_wilting_point;                          // Unitless fraction.
+  int    et_use_feddes;                             // Whether to use the Feddes function.
+  double et_field_capacity_suction;                 // Meters.
+  double et_wilting_point_suction;                  // Meters.
+  int    num_elements;                              // The number of elements in the profile outputs.
+  int    num_profile_days;                          // The number of profile days.
+  double profile_day[SCENARIO_MAX_PROFILES];        // The days to write the profile on.
+  double output_interval;                           // Seconds between rows of the _f output.
+  int    binary_output;                             // Whether to write binary _f and _accum_depth outputs.
+  char   output_dir[SCENARIO_MAX_PATH];             // The directory to write the outputs in.
+  double adaptive_tolerance;                        // Meters of water or zero for fixed steps.
+  double adaptive_min_dt;                           // Seconds.
+  double adaptive_max_front_move;                   // Meters.
+  double event_max_dt;                              // Seconds or zero for fixed steps.
+  double event_max_wet_dt;                          // Seconds.
+  double event_min_dt;                              // Seconds.
+  int    multirate_substeps;                        // Sub-steps per delta_time or zero for t_o_timestep.
+  int    integrator;                                // One of the T_O_INTEGRATOR_ constants.
+  int    redistribution;                            // One of the T_O_REDISTRIBUTE_ constants.
+} scenario;
+
+// The results of running a scenario.
+typedef struct
+{
+  int       error;                // Whether the scenario failed.
+  double    seconds;              // Wall clock time.
+  double    initial_water;        // Meters of water.
+  double    accu_rain;            // Meters of water.
+  double    accu_PET;             // Meters of water.
+  double    evaporated_water;     // Meters of water.
+  double    accum_infil;          // Meters of water.
+  double    groundwater_recharge; // Meters of water.
+  double    final_water;          // Meters of water.
+  double    surfacewater_depth;   // Meters of water.
+  double    runoff;               // Meters of water.
+  double    max_drift;            // The largest mass balance error of any timestep that was not epsilon equal in meters of water.
+  long long num_steps;            // The number of steps accepted.
+  long long num_rejected;         // The number of adaptive steps rejected.
+} scenario_result;
+
+// The kinds of values a manifest key can have.
+#define KEY_INT    (0)
+#define KEY_DOUBLE (1)
+#define KEY_STRING (2)
+#define KEY_PULSE  (3) // Three doubles appended to rain_pulse.
+#define KEY_DAYS   (4) // A list of doubles in profile_day.
+
+// A manifest key and where its value goes in a scenario struct.
+typedef struct
+{
+  const char* name;
+  int         type;
+  size_t      offset;
+} manifest_key;
+
+static const manifest_key manifest_keys[] =
+{
+  {"num_bins",                  KEY_INT,    offsetof(scenario, num_bins)},
+  {"conductivity_cm_per_hour",  KEY_DOUBLE, offsetof(scenario, conductivity_cm_per_hour)},
+  {"porosity",                  KEY_DOUBLE, offsetof(scenario, porosity)},
+  {"residual_saturation",       KEY_DOUBLE, offsetof(scenario, residual_saturation)},
+  {"van_genutchen",             KEY_INT,    offsetof(scenario, van_genutchen)},
+  {"vg_alpha",                  KEY_DOUBLE, offsetof(scenario, vg_alpha)},
+  {"vg_n",                      KEY_DOUBLE, offsetof(scenario, vg_n)},
+  {"bc_lambda",                 KEY_DOUBLE, offsetof(scenario, bc_lambda)},
+  {"bc_psib",                   KEY_DOUBLE, offsetof(scenario, bc_psib)},
+  {"layer_top_depth",           KEY_DOUBLE, offsetof(scenario, layer_top_depth)},
+  {"layer_bottom_depth",        KEY_DOUBLE, offsetof(scenario, layer_bottom_depth)},
+  {"yes_groundwater",           KEY_INT,    offsetof(scenario, yes_groundwater)},
+  {"yes_runoff",                KEY_INT,    offsetof(scenario, yes_runoff)},
+  {"initial_water_content",     KEY_DOUBLE, offsetof(scenario, initial_water_content)},
+  {"water_table",               KEY_DOUBLE, offsetof(scenario, water_table)},
+  {"delta_time",                KEY_DOUBLE, offsetof(scenario, delta_time)},
+  {"max_time_hours",            KEY_DOUBLE, offsetof(scenario, max_time_hours)},
+  {"forcing_file",              KEY_STRING, offsetof(scenario, forcing_file)},
+  {"rainfall_scale",            KEY_DOUBLE, offsetof(scenario, rainfall_scale)},
+  {"rain_pulse",                KEY_PULSE,  offsetof(scenario, rain_pulse)},
+  {"yes_et",                    KEY_INT,    offsetof(scenario, yes_et)},
+  {"et_root_depth",             KEY_DOUBLE, offsetof(scenario, et_root_depth)},
+  {"et_field_capacity",         KEY_DOUBLE, offsetof(scenario, et_field_capacity)},
+  {"et_wilting_point",          KEY_DOUBLE, offsetof(scenario, et_wilting_point)},
+  {"et_use_feddes",             KEY_INT,    offsetof(scenario, et_use_feddes)},
+  {"et_field_capacity_suction", KEY_DOUBLE, offsetof(scenario, et_field_capacity_suction)},
+  {"et_wilting_point_suction",  KEY_DOUBLE, offsetof(scenario, et_wilting_point_suction)},
+  {"num_elements",              KEY_INT,    offsetof(scenario, num_elements)},
+  {"profile_days",              KEY_DAYS,   offsetof(scenario, profile_day)},
+  {"output_interval",           KEY_DOUBLE, offsetof(scenario, output_interval)},
+  {"binary_output",             KEY_INT,    offsetof(scenario, binary_output)},
+  {"output_dir",                KEY_STRING, offsetof(scenario, output_dir)},
+  {"adaptive_tolerance",        KEY_DOUBLE, offsetof(scenario, adaptive_tolerance)},
+  {"adaptive_min_dt",           KEY_DOUBLE, offsetof(scenario, adaptive_min_dt)},
+  {"adaptive_max_front_move",   KEY_DOUBLE, offsetof(scenario, adaptive_max_front_move)},
+  {"event_max_dt",              KEY_DOUBLE, offsetof(scenario, event_max_dt)},
+  {"event_max_wet_dt",          KEY_DOUBLE, offsetof(scenario, event_max_wet_dt)},
+  {"event_min_dt",              KEY_DOUBLE, offsetof(scenario, event_min_dt)},
+  {"multirate_substeps",        KEY_INT,    offsetof(scenario, multirate_substeps)},
+  {"integrator",                KEY_INT,    offsetof(scenario, integrator)},
+  {"redistribution",            KEY_INT,    offsetof(scenario, redistribution)},
+};
+
+#define NUM_MANIFEST_KEYS ((int)(sizeof(manifest_keys) / sizeof(manifest_keys[0])))
+
+// The work shared by the worker threads.
+typedef struct
+{
+  const scenario*  scenarios;     // 1D array of the scenarios with zero based indexing.
+  forcing_file**   forcing;       // 1D array of the forcing file of each scenario or NULL for none with zero based indexing.
+                                  // Scenarios with the same forcing_file share one forcing_file struct.
+  scenario_result* results;       // 1D array of the result of each scenario with zero based indexing.
+  int              num_scenarios; // The number of scenarios.
+  atomic_int       next;          // The index of the next scenario to start.
+} scenario_queue;
+
+// Return the wall clock time in seconds.
+double wall_time(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return now.tv_sec + now.tv_nsec * 1.0e-9;
+}
+
+/* Set a scenario struct to the values test_panama.c uses for test_id 1 so
+ * that a manifest only has to give what is different.
+ *
+ * Parameters:
+ *
+ * the_scenario - A pointer to the scenario struct.
+ */
+void scenario_defaults(scenario* the_scenario)
+{
+  memset(the_scenario, 0, sizeof(scenario));
+
+  the_scenario->num_bins                  = 300;
+  the_scenario->conductivity_cm_per_hour  = 1.0;
+  the_scenario->porosity                  = 0.4;
+  the_scenario->residual_saturation       = 0.027;
+  the_scenario->van_genutchen             = TRUE;
+  the_scenario->vg_alpha                  = 3.6;
+  the_scenario->vg_n                      = 1.56;
+  the_scenario->bc_lambda                 = 5.5;
+  the_scenario->bc_psib                   = 0.37;
+  the_scenario->layer_top_depth           = 0.0;
+  the_scenario->layer_bottom_depth        = 1.0;
+  the_scenario->yes_groundwater           = TRUE;
+  the_scenario->yes_runoff                = TRUE;
+  the_scenario->initial_water_content     = 0.08;
+  the_scenario->water_table               = NAN;
+  the_scenario->delta_time                = 10.0;
+  the_scenario->max_time_hours            = 5750.0;
+  the_scenario->rainfall_scale            = 1.0;
+  the_scenario->yes_et                    = FALSE;
+  the_scenario->et_root_depth             = 0.5;
+  the_scenario->et_field_capacity         = 0.32;
+  the_scenario->et_wilting_point          = 0.03;
+  the_scenario->et_use_feddes             = TRUE;
+  the_scenario->et_field_capacity_suction = 0.27;
+  the_scenario->et_wilting_point_suction  = 1527.68;
+  the_scenario->num_elements              = 300;
+  the_scenario->output_interval           = 60.0;
+  the_scenario->binary_output             = FALSE;
+  strcpy(the_scenario->output_dir, ".");
+  the_scenario->adaptive_tolerance        = 0.0;
+  the_scenario->adaptive_min_dt           = 1.0;
+  the_scenario->adaptive_max_front_move   = 0.01;
+  the_scenario->event_max_dt              = 0.0;
+  the_scenario->event_max_wet_dt          = 10.0;
+  the_scenario->event_min_dt              = 1.0;
+  the_scenario->multirate_substeps        = 0;
+  the_scenario->integrator                = T_O_INTEGRATOR_EULER;
+  the_scenario->redistribution            = T_O_REDISTRIBUTE_SLUGS;
+}
+
+/* Return a pointer to the first non-whitespace character of string after
+ * removing trailing whitespace from it.
+ *
+ * Parameters:
+ *
+ * string - The string to trim.  Modified in place.
+ */
+char* trim(char* string)
+{
+  char* end = string + strlen(string);
+
+  while (isspace((unsigned char)*string))
+    {
+      string++;
+    }
+
+  while (end > string && isspace((unsigned char)end[-1]))
+    {
+      *--end = '\0';
+    }
+
+  return string;
+}
+
+/* Set one key of a scenario from its manifest value.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * the_scenario - A pointer to the scenario struct.
+ * key          - The name of the key.
+ * value        - The value of the key with whitespace trimmed.
+ */
+int scenario_set(scenario* the_scenario, const char* key, char* value)
+{
+  int    error = FALSE; // Error flag.
+  int    ii;            // Loop counter.
+  char*  end;           // The end of the number that was parsed.
+  double number;
+  long   integer;
+
+  for (ii = 0; ii < NUM_MANIFEST_KEYS && 0 != strcmp(key, manifest_keys[ii].name); ii++)
+    {
+      // Find the key.
+    }
+
+  if (NUM_MANIFEST_KEYS == ii)
+    {
+      fprintf(stderr, "ERROR: Unknown key %s\n", key);
+      error = TRUE;
+    }
+  else
+    {
+      void* field = (char*)the_scenario + manifest_keys[ii].offset;
+
+      switch (manifest_keys[ii].type)
+        {
+        case KEY_INT:
+          integer = strtol(value, &end, 10);
+          error   = (end == value || '\0' != *end);
+
+          if (!error)
+            {
+              *(int*)field = integer;
+            }
+          break;
+        case KEY_DOUBLE:
+          number = strtod(value, &end);
+          error  = (end == value || '\0' != *end);
+
+          if (!error)
+            {
+              *(double*)field = number;
+            }
+          break;
+        case KEY_STRING:
+          error = (SCENARIO_MAX_PATH <= strlen(value));
+
+          if (!error)
+            {
+              strcpy((char*)field, value);
+            }
+          break;
+        case KEY_PULSE:
+          if ('\0' == *value)
+            {
+              the_scenario->num_rain_pulses = 0;
+            }
+          else if (SCENARIO_MAX_PULSES <= the_scenario->num_rain_pulses)
+            {
+              error = TRUE;
+            }
+          else
+            {
+              double* pulse = the_scenario->rain_pulse[the_scenario->num_rain_pulses];
+
+              error = (3 != sscanf(value, "%lf %lf %lf", &pulse[0], &pulse[1], &pulse[2]) || pulse[0] > pulse[1] || 0.0 > pulse[2]);
+
+              if (!error)
+                {
+                  the_scenario->num_rain_pulses++;
+                }
+            }
+          break;
+        default: // KEY_DAYS.
+          the_scenario->num_profile_days = 0;
+
+          while (!error && '\0' != *value)
+            {
+              number = strtod(value, &end);
+              error  = (end == value || SCENARIO_MAX_PROFILES <= the_scenario->num_profile_days);
+
+              if (!error)
+                {
+                  the_scenario->profile_day[the_scenario->num_profile_days++] = number;
+                  value = trim(end);
+                }
+            }
+          break;
+        }
+
+      if (error)
+        {
+          fprintf(stderr, "ERROR: Bad value for %s: %s\n", key, value);
+        }
+    }
+
+  return error;
+}
+
+/* Read the scenarios from a manifest file.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * path          - The name of the manifest file.
+ * scenarios     - A pointer passed by reference which will be assigned to
+ *                 point to a newly allocated 1D array of scenario structs
+ *                 with zero based indexing or NULL if there is an error.
+ *                 Free it with free.
+ * num_scenarios - Scalar passed by reference.  Will be set to the number of
+ *                 scenarios.
+ */
+int read_manifest(const char* path, scenario** scenarios, int* num_scenarios)
+{
+  int       error      = FALSE; // Error flag.
+  int       line       = 0;     // The current line number.
+  int       capacity   = 0;     // The number of scenario structs allocated.
+  int       ii;                 // Loop counter.
+  FILE*     fptr;
+  char      buffer[MANIFEST_MAX_LINE];
+  char*     text;
+  char*     equals;
+  scenario  defaults;           // The values from the defaults section.
+  scenario* current    = NULL;  // The section being read.
+  scenario* new_scenarios;
+
+  *scenarios     = NULL;
+  *num_scenarios = 0;
+  scenario_defaults(&defaults);
+
+  if (NULL == (fptr = fopen(path, "r")))
+    {
+      fprintf(stderr, "ERROR: Could not open manifest %s\n", path);
+      error = TRUE;
+    }
+
+  while (!error && NULL != fgets(buffer, sizeof(buffer), fptr))
+    {
+      line++;
+
+      if (NULL != (text = strchr(buffer, '#')))
+        {
+          *text = '\0';
+        }
+
+      text = trim(buffer);
+
+      if ('\0' == *text)
+        {
+          // Blank line.
+        }
+      else if ('[' == *text)
+        {
+          // Section header.
+          if (']' != text[strlen(text) - 1] || 2 == strlen(text) || SCENARIO_MAX_NAME < strlen(text) - 1)
+            {
+              error = TRUE;
+            }
+          else
+            {
+              text[strlen(text) - 1] = '\0';
+              text                   = trim(text + 1);
+
+              for (ii = 0; ii < *num_scenarios; ii++)
+                {
+                  error = error || 0 == strcmp(text, (*scenarios)[ii].name);
+                }
+
+              if (error)
+                {
+                  fprintf(stderr, "ERROR: Scenario %s is listed twice\n", text);
+                }
+              else if (0 == strcmp(text, "defaults"))
+                {
+                  current = &defaults;
+                }
+              else
+                {
+                  if (*num_scenarios == capacity)
+                    {
+                      capacity      = (0 == capacity) ? 16 : 2 * capacity;
+                      new_scenarios = (scenario*)realloc(*scenarios, capacity * sizeof(scenario));
+
+                      if (NULL == new_scenarios)
+                        {
+                          fprintf(stderr, "ERROR: Could not allocate scenarios\n");
+                          error = TRUE;
+                        }
+                      else
+                        {
+                          *scenarios = new_scenarios;
+                        }
+                    }
+
+                  if (!error)
+                    {
+                      current = &(*scenarios)[(*num_scenarios)++];
+                      *current = defaults;
+                      strcpy(current->name, text);
+                    }
+                }
+            }
+        }
+      else if (NULL == current || NULL == (equals = strchr(text, '=')))
+        {
+          error = TRUE;
+        }
+      else
+        {
+          // key = value.
+          *equals = '\0';
+          error   = scenario_set(current, trim(text), trim(equals + 1));
+        }
+
+      if (error)
+        {
+          fprintf(stderr, "ERROR: %s line %d is not valid\n", path, line);
+        }
+    }
+
+  if (NULL != fptr)
+    {
+      fclose(fptr);
+    }
+
+  if (!error && 0 == *num_scenarios)
+    {
+      fprintf(stderr, "ERROR: Manifest %s has no scenarios\n", path);
+      error = TRUE;
+    }
+
+  if (error)
+    {
+      free(*scenarios);
+      *scenarios     = NULL;
+      *num_scenarios = 0;
+    }
+
+  return error;
+}
+
+/* Open an output file named output_dir/name_suffix.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * the_scenario - A pointer to the scenario struct.
+ * suffix       - The end of the file name.
+ * fptr         - A pointer passed by reference which will be assigned to point
+ *                to the opened file or NULL if there is an error.
+ */
+int open_output(const scenario* the_scenario, const char* suffix, FILE** fptr)
+{
+  char path[2 * SCENARIO_MAX_PATH];
+
+  snprintf(path, sizeof(path), "%s/%s_%s", the_scenario->output_dir, the_scenario->name, suffix);
+
+  if (NULL == (*fptr = fopen(path, "w")))
+    {
+      fprintf(stderr, "ERROR: Could not open output file %s\n", path);
+    }
+
+  return NULL == *fptr;
+}
+
+/* Run one scenario the same way test_panama.c runs a test_id.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * the_scenario - A pointer to the scenario struct.
+ * rain_file    - The opened forcing_file of the scenario or NULL for none.
+ *                Only read, so it can be shared with other scenarios.
+ * result       - A pointer to the scenario_result struct to fill in.
+ */
+int run_scenario(const scenario* the_scenario, const forcing_file* rain_file, scenario_result* result)
+{
+  int             error                    = FALSE; // Error flag.
+  int             ii, jj;                           // Loop counters.
+  double          conductivity             = the_scenario->conductivity_cm_per_hour / 360000.0; // Meters per second.
+  double          water_table              = isnan(the_scenario->water_table) ? the_scenario->layer_bottom_depth : the_scenario->water_table;
+  double          delta_time               = the_scenario->delta_time;              // Seconds.
+  double          max_time                 = the_scenario->max_time_hours * ONE_HOUR; // Seconds.
+  double          current_time             = 0.0;                                   // Seconds.
+  double          surfacewater_depth       = 0.0;                                   // Meters.
+  double          groundwater_recharge     = 0.0;                                   // The total amount supplied to groundwater in meters of water.
+  double          evaporated_water         = 0.0;                                   // Meters of water.
+  double          accum_infil              = 0.0;                                   // Meters of water.
+  double          accu_rain                = 0.0;                                   // Meters of water.
+  double          accu_PET                 = 0.0;                                   // Meters of water.
+  double          runoff                   = 0.0;                                   // Meters of water.
+  double          total_water;                                                      // The should be value for total water in meters of water.
+  double          surfacewater_depth_old;
+  double          drift;                                                            // Mass balance error in meters of water.
+  double          groundwater_recharge_old;
+  double          runoff_old;
+  double          infiltration;                                                     // Meters of water infiltrated in a timestep.
+  double          rainfall_rate;                                                    // Meters per second.
+  double          PET;                                                              // Meters per second.
+  double          rain_mean[FORCING_MAX_VALUES];                                    // Rainfall and PET averaged over a timestep in mm / 15 min.
+  double          start_time               = wall_time();
+  int             profile_taken[SCENARIO_MAX_PROFILES] = {FALSE};
+  t_o_parameters* parameters               = NULL;
+  t_o_domain*     domain                   = NULL;
+  t_o_adaptive*   adaptive                 = NULL;
+  t_o_events*     events                   = NULL;
+  forcing_cursor  rain_cursor;
+  output_writer*  f_writer                 = NULL;
+  output_writer*  acc_depth_writer         = NULL;
+  FILE*           profile_fptr[SCENARIO_MAX_PROFILES] = {NULL};
+  FILE*           summary_fptr             = NULL;
+  double*         soil_depth_z             = NULL;
+  double*         water_content            = NULL;
+  double*         pressure_head            = NULL;
+  char            path[2 * SCENARIO_MAX_PATH];
+  char            suffix[64];
+
+  memset(result, 0, sizeof(scenario_result));
+
+  if (t_o_parameters_alloc(&parameters, the_scenario->num_bins, conductivity, the_scenario->porosity, the_scenario->residual_saturation,
+                           the_scenario->van_genutchen, the_scenario->vg_alpha, the_scenario->vg_n, the_scenario->bc_lambda, the_scenario->bc_psib) ||
+      t_o_domain_alloc(&domain, parameters, the_scenario->layer_top_depth, the_scenario->layer_bottom_depth, the_scenario->yes_groundwater,
+                       the_scenario->initial_water_content, the_scenario->yes_groundwater, water_table))
+    {
+      fprintf(stderr, "ERROR: Could not create the domain for scenario %s\n", the_scenario->name);
+      error = TRUE;
+    }
+  else if (t_o_set_integrator(domain, the_scenario->integrator))
+    {
+      fprintf(stderr, "ERROR: Invalid integrator %d for scenario %s\n", the_scenario->integrator, the_scenario->name);
+      error = TRUE;
+    }
+  else if (t_o_set_redistribution(domain, the_scenario->redistribution))
+    {
+      fprintf(stderr, "ERROR: Invalid redistribution %d for scenario %s\n", the_scenario->redistribution, the_scenario->name);
+      error = TRUE;
+    }
+
+  if (!error && 0.0 < the_scenario->adaptive_tolerance)
+    {
+      if (t_o_adaptive_alloc(&adaptive, domain, the_scenario->adaptive_min_dt, delta_time, the_scenario->adaptive_tolerance,
+                             the_scenario->adaptive_max_front_move))
+        {
+          fprintf(stderr, "ERROR: Could not set up adaptive timestepping for scenario %s\n", the_scenario->name);
+          error = TRUE;
+        }
+    }
+  else if (!error && 0.0 < the_scenario->event_max_dt)
+    {
+      if (t_o_events_alloc(&events, domain, the_scenario->event_min_dt, the_scenario->event_max_wet_dt, the_scenario->event_max_dt))
+        {
+          fprintf(stderr, "ERROR: Could not set up event driven stepping for scenario %s\n", the_scenario->name);
+          error = TRUE;
+        }
+    }
+
+  if (!error && NULL != rain_file)
+    {
+      // The forcing file is read a record at a time as the simulation goes.
+      if (forcing_cursor_init(&rain_cursor, rain_file, FORCING_STEP))
+        {
+          fprintf(stderr, "ERROR: Could not read forcing file %s for scenario %s\n", the_scenario->forcing_file, the_scenario->name);
+          error = TRUE;
+        }
+    }
+
+  // Open the outputs.
+  if (!error)
+    {
+      snprintf(path, sizeof(path), "%s/%s_f%s", the_scenario->output_dir, the_scenario->name, the_scenario->binary_output ? ".bin" : ".out");
+      error = output_writer_alloc(&f_writer, path, 8, "%lf %lf %lf %lf %lf %lf %lf %lf \n", the_scenario->binary_output);
+
+      snprintf(path, sizeof(path), "%s/%s_accum_depth%s", the_scenario->output_dir, the_scenario->name, the_scenario->binary_output ? ".bin" : ".out");
+      error = error || output_writer_alloc(&acc_depth_writer, path, 2, "%lf %lf\n", the_scenario->binary_output);
+
+      for (ii = 0; !error && ii < the_scenario->num_profile_days; ii++)
+        {
+          snprintf(suffix, sizeof(suffix), "profile_day_%g.txt", the_scenario->profile_day[ii]);
+          error = open_output(the_scenario, suffix, &profile_fptr[ii]);
+        }
+
+      error = error || open_output(the_scenario, "summary.txt", &summary_fptr);
+
+      if (error)
+        {
+          fprintf(stderr, "ERROR: Could not open the outputs of scenario %s\n", the_scenario->name);
+        }
+    }
+
+  if (!error && 0 < the_scenario->num_profile_days)
+    {
+      if (d_alloc(&soil_depth_z, the_scenario->num_elements) || d_alloc(&water_content, the_scenario->num_elements) ||
+          d_alloc(&pressure_head, the_scenario->num_elements))
+        {
+          error = TRUE;
+        }
+      else
+        {
+          soil_depth_z[0] = domain->layer_top_depth;
+
+          for (jj = 1; jj <= the_scenario->num_elements; jj++)
+            {
+              soil_depth_z[jj] = soil_depth_z[0] + jj * (domain->layer_bottom_depth - domain->layer_top_depth) / the_scenario->num_elements;
+            }
+        }
+    }
+
+  if (!error)
+    {
+      result->initial_water = t_o_total_water_in_domain(domain);
+      total_water           = result->initial_water;
+    }
+
+  while (!error && current_time < max_time)
+    {
+      // Rainfall.
+      rainfall_rate = 0.0;
+      PET           = 0.0;
+
+      if (NULL != rain_file)
+        {
+          // Original data in mm / 15 min.  A timestep that spans two records gets the right amount of each.
+          error = forcing_cursor_mean(&rain_cursor, current_time, current_time + delta_time, rain_mean);
+
+          if (1 < forcing_num_values(rain_file))
+            {
+              PET = rain_mean[1] / 900000.0;
+            }
+
+          rainfall_rate = rain_mean[0] / 900000.0 * the_scenario->rainfall_scale;
+        }
+
+      for (ii = 0; ii < the_scenario->num_rain_pulses; ii++)
+        {
+          if (the_scenario->rain_pulse[ii][0] * ONE_HOUR <= current_time && current_time < the_scenario->rain_pulse[ii][1] * ONE_HOUR)
+            {
+              rainfall_rate += the_scenario->rain_pulse[ii][2] * 0.01 / ONE_HOUR;
+            }
+        }
+
+      total_water += rainfall_rate * delta_time;
+      accu_rain   += rainfall_rate * delta_time;
+      accu_PET    += PET * delta_time;
+
+      surfacewater_depth_old   = surfacewater_depth + rainfall_rate * delta_time;
+      groundwater_recharge_old = groundwater_recharge;
+      runoff_old               = runoff;
+
+      if (NULL != events)
+        {
+          // Rain is added before and runoff is taken after each event driven step.
+          error = error || t_o_timestep_events(domain, events, delta_time, rainfall_rate, &surfacewater_depth, water_table, &groundwater_recharge,
+                                               the_scenario->yes_runoff ? &runoff : NULL);
+        }
+      else if (NULL == adaptive && 0 < the_scenario->multirate_substeps)
+        {
+          // Rain is added before and runoff is taken after each sub-step.
+          error = error || t_o_timestep_multirate(domain, delta_time, the_scenario->multirate_substeps, rainfall_rate, &surfacewater_depth,
+                                                  water_table, &groundwater_recharge, the_scenario->yes_runoff ? &runoff : NULL);
+          result->num_steps++;
+        }
+      else if (NULL == adaptive)
+        {
+          surfacewater_depth += rainfall_rate * delta_time;
+          error               = error || t_o_timestep(domain, delta_time, surfacewater_depth, &surfacewater_depth, water_table, &groundwater_recharge);
+          result->num_steps++;
+        }
+      else
+        {
+          // Rain is added before and runoff is taken after each adaptive step.
+          error = error || t_o_timestep_adaptive(domain, adaptive, delta_time, rainfall_rate, &surfacewater_depth, water_table, &groundwater_recharge,
+                                                 the_scenario->yes_runoff ? &runoff : NULL);
+        }
+
+      if (!error && the_scenario->yes_et)
+        {
+          error = t_o_ET(domain, delta_time, the_scenario->et_root_depth, PET, the_scenario->et_field_capacity, the_scenario->et_wilting_point,
+                         the_scenario->et_use_feddes, the_scenario->et_field_capacity_suction, the_scenario->et_wilting_point_suction,
+                         &surfacewater_depth, &evaporated_water);
+        }
+
+      if (error)
+        {
+          fprintf(stderr, "ERROR: Scenario %s failed at time %lf seconds\n", the_scenario->name, current_time);
+          break;
+        }
+
+      infiltration = surfacewater_depth_old - surfacewater_depth - (runoff - runoff_old);
+      accum_infil += infiltration;
+
+      if (delta_time > (int)current_time % (int)the_scenario->output_interval)
+        {
+          output_writer_row(f_writer, (double[]){current_time, rainfall_rate * 360000.0, accu_rain * 100,
+                                                 infiltration / delta_time * 100.0 * ONE_HOUR, accum_infil * 100.0,
+                                                 (groundwater_recharge - groundwater_recharge_old) / delta_time * 100 * ONE_HOUR,
+                                                 groundwater_recharge * 100.0, evaporated_water * 100.0});
+        }
+
+      current_time += delta_time;
+
+      if (the_scenario->yes_runoff)
+        {
+          runoff            += surfacewater_depth;
+          surfacewater_depth = 0.0;
+        }
+
+      // test_panama.c asserts this.  Here one scenario must not abort the others so the worst drift is reported instead.
+      drift = fabs(total_water - (evaporated_water + surfacewater_depth + groundwater_recharge + t_o_total_water_in_domain(domain) + runoff));
+
+      if (!epsilon_equal(total_water, evaporated_water + surfacewater_depth + groundwater_recharge + t_o_total_water_in_domain(domain) + runoff) &&
+          result->max_drift < drift)
+        {
+          result->max_drift = drift;
+        }
+
+      output_writer_row(acc_depth_writer, (double[]){current_time, runoff * 100.0}); // Time in s, runoff in cm.
+
+      // Profiles.
+      for (ii = 0; ii < the_scenario->num_profile_days; ii++)
+        {
+          if (!profile_taken[ii] && fabs(current_time - the_scenario->profile_day[ii] * ONE_DAY) < delta_time)
+            {
+              t_o_profile(domain, the_scenario->num_elements, soil_depth_z, water_content, pressure_head);
+
+              for (jj = 1; jj <= the_scenario->num_elements; jj++)
+                {
+                  fprintf(profile_fptr[ii], "%lf %lf %lf\n", soil_depth_z[jj], water_content[jj], pressure_head[jj]);
+                }
+
+              profile_taken[ii] = TRUE;
+              break;
+            }
+        }
+    } // End of time loop.
+
+  if (!error)
+    {
+      result->seconds              = wall_time() - start_time;
+      result->accu_rain            = accu_rain;
+      result->accu_PET             = accu_PET;
+      result->evaporated_water     = evaporated_water;
+      result->accum_infil          = accum_infil;
+      result->groundwater_recharge = groundwater_recharge;
+      result->final_water          = t_o_total_water_in_domain(domain);
+      result->surfacewater_depth   = surfacewater_depth;
+      result->runoff               = runoff;
+
+      if (NULL != adaptive)
+        {
+          result->num_steps    = adaptive->num_accepted;
+          result->num_rejected = adaptive->num_rejected;
+        }
+      else if (NULL != events)
+        {
+          result->num_steps = events->num_timesteps;
+        }
+
+      fprintf(summary_fptr, "Total simulation time  = %lf hours\n", max_time / ONE_HOUR);
+      fprintf(summary_fptr, "Elapsed time = %lf seconds\n", result->seconds);
+      fprintf(summary_fptr, "Steps accepted = %lld\n", result->num_steps);
+
+      if (NULL != adaptive)
+        {
+          fprintf(summary_fptr, "Steps rejected = %lld\n", result->num_rejected);
+          fprintf(summary_fptr, "Calls to t_o_timestep = %lld\n", adaptive->num_timesteps);
+        }
+
+      if (NULL != events)
+        {
+          fprintf(summary_fptr, "Steps ended by a collision = %lld\n", events->num_collisions);
+          fprintf(summary_fptr, "Steps ended by forcing = %lld\n", events->num_forcing_ends);
+          fprintf(summary_fptr, "Steps limited by event_max_dt = %lld\n", events->num_max_steps);
+        }
+
+      if (0 < domain->statistics.num_multirate_steps)
+        {
+          fprintf(summary_fptr, "Multirate sub-steps = %lld\n", domain->statistics.num_multirate_substeps);
+        }
+
+      fprintf(summary_fptr, "Quiescent timesteps = %lld\n", domain->statistics.num_quiescent_timesteps);
+      fprintf(summary_fptr, "Redistributions skipped = %lld, fronts only = %lld, slugs right of first bin = %lld, slugs from first bin = %lld\n",
+              domain->statistics.num_redistribute_skipped, domain->statistics.num_redistribute_fronts_only, domain->statistics.num_redistribute_local,
+              domain->statistics.num_redistribute_full);
+      fprintf(summary_fptr, "Fast forwards = %lld covering %lf hours\n", domain->statistics.num_fast_forwards,
+              domain->statistics.fast_forward_time / ONE_HOUR);
+
+      fprintf(summary_fptr, "Mass balance info: \n");
+      fprintf(summary_fptr, "Initial water in domain  = %lf mm \n", result->initial_water * 1000);
+      fprintf(summary_fptr, "Accumulated rainfall     = %lf mm \n", accu_rain * 1000);
+      fprintf(summary_fptr, "Accumulated PET          = %lf mm \n", accu_PET * 1000);
+      fprintf(summary_fptr, "Accumulated AET          = %lf mm \n", evaporated_water * 1000);
+      fprintf(summary_fptr, "Accumulated infiltration = %lf mm \n", accum_infil * 1000);
+      fprintf(summary_fptr, "Groundwater recharge     = %lf mm \n", groundwater_recharge * 1000);
+      fprintf(summary_fptr, "Final water in domain    = %lf mm \n", result->final_water * 1000);
+      fprintf(summary_fptr, "Final surface water      = %lf mm \n", surfacewater_depth);
+      fprintf(summary_fptr, "Total surface runoff     = %lf mm \n", runoff * 1000.0);
+      fprintf(summary_fptr, "Mass error               = %8.5e mm \n", (result->initial_water + accu_rain - evaporated_water - groundwater_recharge -
+                                                                        result->final_water - surfacewater_depth - runoff) * 1000);
+    }
+
+  if (!error && 0.0 < result->max_drift)
+    {
+      fprintf(summary_fptr, "Largest timestep mass balance error = %8.5e mm \n", result->max_drift * 1000);
+    }
+
+  // Clean up.
+  for (ii = 0; ii < the_scenario->num_profile_days; ii++)
+    {
+      if (NULL != profile_fptr[ii] && fclose(profile_fptr[ii]))
+        {
+          error = TRUE;
+        }
+    }
+
+  if (NULL != summary_fptr && fclose(summary_fptr))
+    {
+      error = TRUE;
+    }
+
+  if (NULL != f_writer && output_writer_dealloc(&f_writer))
+    {
+      error = TRUE;
+    }
+
+  if (NULL != acc_depth_writer && output_writer_dealloc(&acc_depth_writer))
+    {
+      error = TRUE;
+    }
+
+  if (NULL != soil_depth_z)
+    {
+      d_dealloc(&soil_depth_z, the_scenario->num_elements);
+    }
+
+  if (NULL != water_content)
+    {
+      d_dealloc(&water_content, the_scenario->num_elements);
+    }
+
+  if (NULL != pressure_head)
+    {
+      d_dealloc(&pressure_head, the_scenario->num_elements);
+    }
+
+  if (NULL != adaptive)
+    {
+      t_o_adaptive_dealloc(&adaptive);
+    }
+
+  if (NULL != events)
+    {
+      t_o_events_dealloc(&events);
+    }
+
+  if (NULL != domain)
+    {
+      t_o_domain_dealloc(&domain);
+    }
+
+  if (NULL != parameters)
+    {
+      t_o_parameters_dealloc(&parameters);
+    }
+
+  result->error = error;
+
+  return error;
+}
+
+/* The function run by each worker thread.  Takes scenarios from the queue
+ * until there are none left.
+ *
+ * Parameters:
+ *
+ * arg - A pointer to the scenario_queue struct.
+ */
+void* scenario_worker(void* arg)
+{
+  scenario_queue* queue = (scenario_queue*)arg;
+  int             index;
+
+  while ((index = atomic_fetch_add(&queue->next, 1)) < queue->num_scenarios)
+    {
+      run_scenario(&queue->scenarios[index], queue->forcing[index], &queue->results[index]);
+    }
+
+  return NULL;
+}
+
+/* Open the forcing file of each scenario.  A file named by more than one
+ * scenario is opened once and the scenarios share it.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * scenarios     - A 1D array of scenario structs with zero based indexing.
+ * num_scenarios - The number of scenarios.
+ * forcing       - A 1D array of num_scenarios pointers with zero based
+ *                 indexing.  Each will be set to the opened forcing file of
+ *                 its scenario or NULL for none.  Close them with
+ *                 close_forcing even if there is an error.
+ */
+int open_forcing(const scenario* scenarios, int num_scenarios, forcing_file** forcing)
+{
+  int error = FALSE; // Error flag.
+  int ii, jj;        // Loop counters.
+
+  for (ii = 0; ii < num_scenarios; ii++)
+    {
+      forcing[ii] = NULL;
+    }
+
+  for (ii = 0; !error && ii < num_scenarios; ii++)
+    {
+      if ('\0' != scenarios[ii].forcing_file[0])
+        {
+          for (jj = 0; jj < ii && NULL == forcing[ii]; jj++)
+            {
+              if (0 == strcmp(scenarios[ii].forcing_file, scenarios[jj].forcing_file))
+                {
+                  forcing[ii] = forcing[jj];
+                }
+            }
+
+          if (NULL == forcing[ii] && forcing_open(&forcing[ii], scenarios[ii].forcing_file))
+            {
+              fprintf(stderr, "ERROR: Could not read forcing file %s for scenario %s\n", scenarios[ii].forcing_file, scenarios[ii].name);
+              error = TRUE;
+            }
+        }
+    }
+
+  return error;
+}
+
+/* Close the forcing files opened by open_forcing.
+ *
+ * Parameters:
+ *
+ * num_scenarios - The number of scenarios.
+ * forcing       - The 1D array of pointers filled in by open_forcing.  Each
+ *                 will be set to NULL.
+ */
+void close_forcing(int num_scenarios, forcing_file** forcing)
+{
+  int ii, jj; // Loop counters.
+
+  for (ii = 0; ii < num_scenarios; ii++)
+    {
+      if (NULL != forcing[ii])
+        {
+          // Clear the scenarios that share this file so it is only closed once.
+          for (jj = ii + 1; jj < num_scenarios; jj++)
+            {
+              if (forcing[jj] == forcing[ii])
+                {
+                  forcing[jj] = NULL;
+                }
+            }
+
+          forcing_close(&forcing[ii]);
+        }
+    }
+}
+
+/* Run every scenario in a queue on a number of threads.
+ * Return the wall clock time it took in seconds.
+ *
+ * Parameters:
+ *
+ * queue       - A pointer to the scenario_queue struct.  Its next is reset to
+ *               zero.
+ * num_threads - The number of threads.  The calling thread is one of them.
+ */
+double run_queue(scenario_queue* queue, int num_threads)
+{
+  int        ii;                                                          // Loop counter.
+  int        num_started = 1;                                             // The number of threads running scenarios including the calling thread.
+  double     start_time  = wall_time();
+  pthread_t* threads     = (pthread_t*)malloc(num_threads * sizeof(pthread_t));
+
+  atomic_store(&queue->next, 0);
+
+  if (NULL == threads)
+    {
+      fprintf(stderr, "WARNING: Could not allocate threads.  Running on one thread.\n");
+    }
+
+  for (ii = 1; NULL != threads && ii < num_threads; ii++)
+    {
+      if (pthread_create(&threads[ii], NULL, scenario_worker, queue))
+        {
+          fprintf(stderr, "WARNING: Could not create worker thread.  Running on %d threads.\n", num_started);
+          break;
+        }
+
+      num_started++;
+    }
+
+  scenario_worker(queue);
+
+  for (ii = 1; ii < num_started; ii++)
+    {
+      pthread_join(threads[ii], NULL);
+    }
+
+  free(threads);
+
+  return wall_time() - start_time;
+}
+
+/* Print the table of results.
+ * Return the number of scenarios that failed.
+ *
+ * Parameters:
+ *
+ * fptr          - The file to print to.
+ * scenarios     - A 1D array of scenario structs with zero based indexing.
+ * results       - A 1D array of the result of each scenario with zero based
+ *                 indexing.
+ * num_scenarios - The number of scenarios.
+ */
+int print_results(FILE* fptr, const scenario* scenarios, const scenario_result* results, int num_scenarios)
+{
+  int ii;             // Loop counter.
+  int num_failed = 0;
+
+  fprintf(fptr, "%-24s %8s %11s %11s %11s %11s %11s %11s %12s %12s %10s %10s %9s\n", "scenario", "status", "rain mm", "infil mm", "recharge mm",
+          "AET mm", "runoff mm", "final mm", "mass err mm", "max drift mm", "seconds", "steps", "rejected");
+
+  for (ii = 0; ii < num_scenarios; ii++)
+    {
+      if (results[ii].error)
+        {
+          fprintf(fptr, "%-24s %8s\n", scenarios[ii].name, "FAILED");
+          num_failed++;
+        }
+      else
+        {
+          fprintf(fptr, "%-24s %8s %11.3lf %11.3lf %11.3lf %11.3lf %11.3lf %11.3lf %12.3e %12.3e %10.2lf %10lld %9lld\n", scenarios[ii].name, "ok",
+                  results[ii].accu_rain * 1000.0, results[ii].accum_infil * 1000.0, results[ii].groundwater_recharge * 1000.0,
+                  results[ii].evaporated_water * 1000.0, results[ii].runoff * 1000.0, results[ii].final_water * 1000.0,
+                  (results[ii].initial_water + results[ii].accu_rain - results[ii].evaporated_water - results[ii].groundwater_recharge -
+                   results[ii].final_water - results[ii].surfacewater_depth - results[ii].runoff) * 1000.0, results[ii].max_drift * 1000.0,
+                  results[ii].seconds, results[ii].num_steps, results[ii].num_rejected);
+        }
+    }
+
+  return num_failed;
+}
+
+/* Return TRUE if two results have the same water totals, FALSE otherwise.
+ * The wall clock times are not compared.  Each scenario steps its own
+ * domain so running concurrently must not change its results at all.
+ */
+int results_equal(const scenario_result* result1, const scenario_result* result2)
+{
+  return result1->error                == result2->error                &&
+         result1->initial_water        == result2->initial_water        &&
+         result1->accu_rain            == result2->accu_rain            &&
+         result1->accu_PET             == result2->accu_PET             &&
+         result1->evaporated_water     == result2->evaporated_water     &&
+         result1->accum_infil          == result2->accum_infil          &&
+         result1->groundwater_recharge == result2->groundwater_recharge &&
+         result1->final_water          == result2->final_water          &&
+         result1->surfacewater_depth   == result2->surfacewater_depth   &&
+         result1->runoff               == result2->runoff               &&
+         result1->max_drift            == result2->max_drift            &&
+         result1->num_steps            == result2->num_steps            &&
+         result1->num_rejected         == result2->num_rejected;
+}
+
+int main(int argc, char** argv)
+{
+  int              error            = FALSE; // Error flag.
+  int              ii, jj;                   // Loop counters.
+  int              option;
+  int              yes_baseline     = FALSE; // Whether to run a serial baseline first.
+  const char*      prefix           = NULL;  // Only run scenarios whose names start with this or NULL for all.
+  const char*      table_path       = NULL;  // The file to also write the table of results to or NULL for none.
+  FILE*            table_fptr;
+  int              num_threads;
+  int              num_scenarios;
+  int              num_failed;
+  int              num_different    = 0;     // The number of scenarios whose results differ from the serial baseline.
+  double           serial_seconds   = 0.0;   // Wall clock time of the serial baseline.
+  double           parallel_seconds;         // Wall clock time of the concurrent run.
+  scenario*        scenarios;
+  scenario_result* results          = NULL;
+  scenario_result* serial_results   = NULL;
+  forcing_file**   forcing          = NULL;
+  scenario_queue   queue;
+
+  while (-1 != (option = getopt(argc, argv, "bs:t:")))
+    {
+      switch (option)
+        {
+        case 'b':
+          yes_baseline = TRUE;
+          break;
+        case 's':
+          prefix = optarg;
+          break;
+        case 't':
+          table_path = optarg;
+          break;
+        default:
+          error = TRUE;
+          break;
+        }
+    }
+
+  if (error || 1 > argc - optind || 2 < argc - optind)
+    {
+      fprintf(stderr, "Usage: %s [-b] [-s prefix] [-t table] manifest [num_threads]\n", argv[0]);
+      exit(1);
+    }
+
+  if (read_manifest(argv[optind], &scenarios, &num_scenarios))
+    {
+      exit(1);
+    }
+
+  if (NULL != prefix)
+    {
+      // Keep the selected scenarios in manifest order.
+      for (ii = 0, jj = 0; ii < num_scenarios; ii++)
+        {
+          if (0 == strncmp(scenarios[ii].name, prefix, strlen(prefix)))
+            {
+              scenarios[jj++] = scenarios[ii];
+            }
+        }
+
+      num_scenarios = jj;
+
+      if (0 == num_scenarios)
+        {
+          fprintf(stderr, "ERROR: No scenario in %s starts with %s\n", argv[optind], prefix);
+          exit(1);
+        }
+    }
+
+  num_threads = (2 == argc - optind) ? atoi(argv[optind + 1]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+  if (1 > num_threads)
+    {
+      num_threads = 1;
+    }
+
+  if (num_threads > num_scenarios)
+    {
+      num_threads = num_scenarios;
+    }
+
+  if (NULL == (results = (scenario_result*)calloc(num_scenarios, sizeof(scenario_result))) ||
+      NULL == (serial_results = (scenario_result*)calloc(num_scenarios, sizeof(scenario_result))) ||
+      NULL == (forcing = (forcing_file**)calloc(num_scenarios, sizeof(forcing_file*))))
+    {
+      fprintf(stderr, "ERROR: Could not allocate results\n");
+      exit(1);
+    }
+
+  if (open_forcing(scenarios, num_scenarios, forcing))
+    {
+      close_forcing(num_scenarios, forcing);
+      exit(1);
+    }
+
+  queue.scenarios     = scenarios;
+  queue.forcing       = forcing;
+  queue.num_scenarios = num_scenarios;
+  atomic_init(&queue.next, 0);
+
+  if (yes_baseline)
+    {
+      printf("Running %d scenarios from %s on 1 thread for the serial baseline.\n", num_scenarios, argv[optind]);
+
+      queue.results  = serial_results;
+      serial_seconds = run_queue(&queue, 1);
+    }
+
+  printf("Running %d scenarios from %s on %d threads.\n", num_scenarios, argv[optind], num_threads);
+
+  queue.results    = results;
+  parallel_seconds = run_queue(&queue, num_threads);
+
+  num_failed = print_results(stdout, scenarios, results, num_scenarios);
+
+  if (NULL != table_path)
+    {
+      if (NULL == (table_fptr = fopen(table_path, "w")))
+        {
+          fprintf(stderr, "ERROR: Could not open table file %s\n", table_path);
+          error = TRUE;
+        }
+      else
+        {
+          print_results(table_fptr, scenarios, results, num_scenarios);
+
+          if (fclose(table_fptr))
+            {
+              fprintf(stderr, "ERROR: Could not write table file %s\n", table_path);
+              error = TRUE;
+            }
+        }
+    }
+
+  printf("Wall clock time %.2lf seconds.  %d of %d scenarios failed.\n", parallel_seconds, num_failed, num_scenarios);
+
+  if (yes_baseline)
+    {
+      for (ii = 0; ii < num_scenarios; ii++)
+        {
+          if (!results_equal(&serial_results[ii], &results[ii]))
+            {
+              fprintf(stderr, "ERROR: Scenario %s has different results on 1 thread and on %d threads.\n", scenarios[ii].name, num_threads);
+              num_different++;
+            }
+        }
+
+      printf("Serial baseline %.2lf seconds on 1 thread.  Concurrent %.2lf seconds on %d threads.  Speedup %.2lf.\n", serial_seconds, parallel_seconds,
+             num_threads, serial_seconds / parallel_seconds);
+      printf("%d of %d scenarios have different results than the serial baseline.\n", num_different, num_scenarios);
+    }
+
+  error = error || (0 < num_failed) || (0 < num_different);
+
+  close_forcing(num_scenarios, forcing);
+  free(forcing);
+  free(scenarios);
+  free(results);
+  free(serial_results);
+
+  return error;
+}
@@ -2,7 +2,15 @@
 #include <stdio.h>
 #include <math.h>
 #include <assert.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "t_o.h"
+#include "t_o_internal.h"
 #include "doubly_linked_list.h"
 #include "epsilon.h"
 #include "memfunc.h"
@@ -10,8 +18,26 @@
 
 #define SLIVER_SLUG_SIZE (0.001) // Meters.
 
+#define DRY_DEPTH_TABLE_MIN_DT            (1.0e-2) // Seconds.  Smallest timestep in the dry depth table grid.
+#define DRY_DEPTH_TABLE_MAX_DT            (1.0e5)  // Seconds.  Largest  timestep in the dry depth table grid.
+#define DRY_DEPTH_TABLE_POINTS_PER_DECADE (16)     // Number of grid timesteps per factor of ten.
+
+#define CHECKPOINT_MAGIC      "TOCHKPT1"   // The first eight bytes of a checkpoint file.
+#define CHECKPOINT_VERSION    (1)          // Increment when the checkpoint format changes.
+#define CHECKPOINT_BYTE_ORDER (0x01020304) // Written as a uint32_t to detect files written on a machine with a different byte order.
+
 #define THREAD_SAFE // Leave this defined to have the code use mutexes to be thread safe.
 
+#if defined(__GNUC__) && defined(__x86_64__)
+#define SIMD_KERNELS // Leave this defined to have infiltrate_distance and groundwater_distances use AVX2 or AVX-512 when the CPU supports them.
+#endif // defined(__GNUC__) && defined(__x86_64__)
+
+#ifdef SIMD_KERNELS
+#include <immintrin.h>
+#endif // SIMD_KERNELS
+
+#define MINIMUM_DRY_DEPTH (1.0e-4) // Meters.  Dry depths are never less than this whether they are calculated or interpolated from the table.
+
 #ifdef THREAD_SAFE
 static pthread_mutex_t slug_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
 #endif // THREAD_SAFE
@@ -19,6 +45,64 @@ static pthread_mutex_t slug_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
 static slug* slug_pool = NULL; // A linked list of unused slug structs so that we don't have to allocate and deallocate every time.
                                // The list is singly linked.  Only the next pointers are used.
 
+#ifdef THREAD_SAFE
+#define THREAD_SLUG_POOL_LIMIT (1024) // When a thread's slug pool grows past this size half of it is given back to slug_pool.
+
+// Each thread keeps its own pool of unused slug structs in front of slug_pool so that threads stepping different domains do not contend for
+// slug_pool_mutex on every slug allocation.  slug_pool is only touched when a thread's pool is empty or too big.
+static __thread slug* thread_slug_pool      = NULL; // Singly linked like slug_pool.
+static __thread int   thread_slug_pool_size = 0;    // The number of slug structs in thread_slug_pool.
+
+/* Give all of the slug structs in the calling thread's pool back to the
+ * shared slug pool.  Threads that step domains call this before they exit
+ * so that slug_pool_dealloc can free those slug structs.
+ */
+void slug_pool_flush_thread(void)
+{
+  if (NULL != thread_slug_pool)
+    {
+      slug* last_slug = thread_slug_pool; // The last slug struct in this thread's pool.
+
+      while (NULL != last_slug->next)
+        {
+          last_slug = last_slug->next;
+        }
+
+      pthread_mutex_lock(&slug_pool_mutex);
+      last_slug->next = slug_pool;
+      slug_pool       = thread_slug_pool;
+      pthread_mutex_unlock(&slug_pool_mutex);
+
+      thread_slug_pool      = NULL;
+      thread_slug_pool_size = 0;
+    }
+}
+#endif // THREAD_SAFE
+
+/* Free all of the unused slug structs in the calling thread's pool and the
+ * shared slug pool.  Slug structs in the pools of other threads are freed
+ * the next time this is called after those threads give them back.
+ */
+void slug_pool_dealloc(void)
+{
+#ifdef THREAD_SAFE
+  slug_pool_flush_thread();
+  pthread_mutex_lock(&slug_pool_mutex);
+#endif // THREAD_SAFE
+  
+  while (NULL != slug_pool)
+    {
+      slug* temp_slug = slug_pool;
+
+      slug_pool = slug_pool->next;
+      v_dealloc((void**)&temp_slug, sizeof(slug));
+    }
+  
+#ifdef THREAD_SAFE
+  pthread_mutex_unlock(&slug_pool_mutex);
+#endif // THREAD_SAFE
+}
+
 /* Documented assumptions:
  *
  * This code implements a single layer Talbot-Ogden domain. At the top of the
@@ -57,6 +141,24 @@ static slug* slug_pool = NULL; // A linked list of unused slug structs so that w
 
 // FIXLATER possible optimization eliminate tiny slugs.
 
+// Defined below with the other dry depth functions.
+int build_dry_depth_table(t_o_parameters* parameters);
+
+// Defined below with the quiescent domain functions.
+int has_slugs(t_o_domain* domain);
+
+// Defined below with the other slug functions.
+#ifdef SLUG_SPANS
+void slug_span_release(slug_span* span);
+#endif // SLUG_SPANS
+int  slug_span_rebuild(t_o_domain* domain, int bin);
+
+// Defined below with the other slug functions.
+void mark_all_dirty(t_o_domain* domain);
+
+// Defined below with the other staircase functions.
+int redistribute_staircase(t_o_domain* domain);
+
 /* Comment in .h file. */
 int t_o_parameters_alloc(t_o_parameters** parameters, int num_bins, double conductivity, double porosity, double residual_saturation,
                          int van_genutchen, double vg_alpha, double vg_n, double bc_lambda, double bc_psib)
@@ -161,8 +263,10 @@ int t_o_parameters_alloc(t_o_parameters** parameters, int num_bins, double condu
         }
 
       (*parameters)->bin_capillary_suction       = NULL;
-      (*parameters)->dry_depth_dt                = 0.0;
-      (*parameters)->bin_dry_depth               = NULL;
+      (*parameters)->dry_depth_table_dt          = NULL;
+      (*parameters)->dry_depth_table_green_ampt  = NULL;
+      (*parameters)->dry_depth_table             = NULL;
+      (*parameters)->dry_depth_cache             = NULL;
       (*parameters)->dry_depth_mutex_initialized = FALSE;
     }
 
@@ -255,18 +359,41 @@ int t_o_parameters_alloc(t_o_parameters** parameters, int num_bins, double condu
       assert(0.0 < (*parameters)->bin_capillary_suction[num_bins]);
     }
 
-  // Allocate bin_dry_depth.
+  // Allocate and fill in the dry depth table.
   if (!error)
     {
-      error = d_alloc(&(*parameters)->bin_dry_depth, num_bins);
+      (*parameters)->dry_depth_table_size = (int)(log10(DRY_DEPTH_TABLE_MAX_DT / DRY_DEPTH_TABLE_MIN_DT) * DRY_DEPTH_TABLE_POINTS_PER_DECADE + 0.5) + 1;
+      error                               = d_alloc(&(*parameters)->dry_depth_table_dt, (*parameters)->dry_depth_table_size);
     }
 
-  // Initialize bin_dry_depth.
   if (!error)
     {
-      for (ii = 1; ii <= num_bins; ii++)
+      error = d_alloc(&(*parameters)->dry_depth_table_green_ampt, (*parameters)->dry_depth_table_size);
+    }
+
+  if (!error)
+    {
+      error = dtwo_alloc(&(*parameters)->dry_depth_table, (*parameters)->dry_depth_table_size, num_bins);
+    }
+
+  if (!error)
+    {
+      error = build_dry_depth_table(*parameters);
+    }
+
+  // Allocate an empty dry depth snapshot for a timestep of zero so that readers never see NULL.  d_alloc initializes the dry depths to zero.
+  if (!error)
+    {
+      t_o_dry_depth_cache* cache; // The new snapshot.
+
+      error = v_alloc((void**)&cache, sizeof(t_o_dry_depth_cache));
+
+      if (!error)
         {
-          (*parameters)->bin_dry_depth[ii] = 0.0;
+          cache->dt    = 0.0;
+          cache->older = NULL;
+          atomic_init(&(*parameters)->dry_depth_cache, cache);
+          error        = d_alloc(&cache->bin_dry_depth, num_bins);
         }
     }
 
@@ -316,10 +443,36 @@ void t_o_parameters_dealloc(t_o_parameters** parameters)
           d_dealloc(&(*parameters)->bin_capillary_suction, (*parameters)->num_bins);
         }
 
-      // Deallocate bin_dry_depth.
-      if (NULL != (*parameters)->bin_dry_depth)
+      // Deallocate the dry depth table.
+      if (NULL != (*parameters)->dry_depth_table_dt)
+        {
+          d_dealloc(&(*parameters)->dry_depth_table_dt, (*parameters)->dry_depth_table_size);
+        }
+
+      if (NULL != (*parameters)->dry_depth_table_green_ampt)
         {
-          d_dealloc(&(*parameters)->bin_dry_depth, (*parameters)->num_bins);
+          d_dealloc(&(*parameters)->dry_depth_table_green_ampt, (*parameters)->dry_depth_table_size);
+        }
+
+      if (NULL != (*parameters)->dry_depth_table)
+        {
+          dtwo_dealloc(&(*parameters)->dry_depth_table, (*parameters)->dry_depth_table_size, (*parameters)->num_bins);
+        }
+
+      // Deallocate the current and all older dry depth snapshots.
+      t_o_dry_depth_cache* cache = atomic_load(&(*parameters)->dry_depth_cache);
+
+      while (NULL != cache)
+        {
+          t_o_dry_depth_cache* older = cache->older;
+
+          if (NULL != cache->bin_dry_depth)
+            {
+              d_dealloc(&cache->bin_dry_depth, (*parameters)->num_bins);
+            }
+
+          v_dealloc((void**)&cache, sizeof(t_o_dry_depth_cache));
+          cache = older;
         }
 
 #ifdef THREAD_SAFE
@@ -396,8 +549,15 @@ int t_o_domain_alloc(t_o_domain** domain, t_o_parameters* parameters,double laye
       (*domain)->surface_front = NULL;
       (*domain)->top_slug = NULL;
       (*domain)->bot_slug = NULL;
+#ifdef SLUG_SPANS
+      (*domain)->slug_spans = NULL;
+#endif // SLUG_SPANS
       (*domain)->yes_groundwater = yes_groundwater;
       (*domain)->groundwater_front = NULL;
+      (*domain)->integrator = T_O_INTEGRATOR_EULER;
+      (*domain)->redistribution = T_O_REDISTRIBUTE_SLUGS;
+      (*domain)->scratch = NULL;
+      t_o_reset_statistics(*domain);
       if (!yes_groundwater)
         {
           if (initial_water_content >= parameters->bin_water_content[1])
@@ -458,6 +618,32 @@ int t_o_domain_alloc(t_o_domain** domain, t_o_parameters* parameters,double laye
         }
     }
 
+#ifdef SLUG_SPANS
+  // Allocate slug_spans.
+  if (!error)
+    {
+      error = v_alloc((void**)&(*domain)->slug_spans, (parameters->num_bins + 1) * sizeof(slug_span));
+    }
+
+  // Initialize slug_spans.
+  if (!error)
+    {
+      for (ii = 1; ii <= parameters->num_bins; ii++)
+        {
+          (*domain)->slug_spans[ii].num_slugs = 0;
+          (*domain)->slug_spans[ii].capacity  = SLUG_SPAN_INLINE_CAPACITY;
+          (*domain)->slug_spans[ii].top       = (*domain)->slug_spans[ii].inline_top;
+          (*domain)->slug_spans[ii].bot       = (*domain)->slug_spans[ii].inline_bot;
+        }
+    }
+#endif // SLUG_SPANS
+
+  // Allocate scratch.  Redistribution needs about two doubles and a few slug pointers per bin.
+  if (!error)
+    {
+      error = arena_alloc(&(*domain)->scratch, 8 * (parameters->num_bins + 1) * sizeof(double));
+    }
+
   if (yes_groundwater)
     {
       // Allocate groundwater_front.
@@ -495,6 +681,12 @@ int t_o_domain_alloc(t_o_domain** domain, t_o_parameters* parameters,double laye
         }
     }
 
+  // The first call to t_o_redistribute looks at every bin.
+  if (!error)
+    {
+      mark_all_dirty(*domain);
+    }
+
   if (error)
     {
       t_o_domain_dealloc(domain);
@@ -544,32 +736,109 @@ void t_o_domain_dealloc(t_o_domain** domain)
           v_dealloc((void**)&(*domain)->bot_slug, ((*domain)->parameters->num_bins + 1) * sizeof(slug*));
         }
 
+#ifdef SLUG_SPANS
+      // Deallocate slug_spans including the arrays of spans that spilled.
+      if (NULL != (*domain)->slug_spans)
+        {
+          for (ii = 1; ii <= (*domain)->parameters->num_bins; ii++)
+            {
+              slug_span_release(&(*domain)->slug_spans[ii]);
+            }
+
+          v_dealloc((void**)&(*domain)->slug_spans, ((*domain)->parameters->num_bins + 1) * sizeof(slug_span));
+        }
+#endif // SLUG_SPANS
+
       // Deallocate groundwater_front.
       if (NULL != (*domain)->groundwater_front)
         {
           d_dealloc(&(*domain)->groundwater_front, (*domain)->parameters->num_bins);
         }
 
+      // Deallocate scratch.
+      if (NULL != (*domain)->scratch)
+        {
+          arena_dealloc(&(*domain)->scratch);
+        }
+
       // Deallocate the t_o_domain struct.
       v_dealloc((void**)domain, sizeof(t_o_domain));
     }
 
   // When you call this function deallocate all unused slug structs in the slug pool.
-#ifdef THREAD_SAFE
-  pthread_mutex_lock(&slug_pool_mutex);
-#endif // THREAD_SAFE
-  
-  while (NULL != slug_pool)
+  // Slug structs in the pools of thread pool workers are freed by t_o_thread_pool_dealloc.
+  slug_pool_dealloc();
+}
+
+/* Comment in .h file. */
+void t_o_reset_statistics(t_o_domain* domain)
+{
+  assert(NULL != domain);
+
+  domain->statistics.num_front_sorts              = 0;
+  domain->statistics.surface_front_moved          = 0;
+  domain->statistics.groundwater_front_moved      = 0;
+  domain->statistics.last_surface_front_moved     = 0;
+  domain->statistics.last_groundwater_front_moved = 0;
+  domain->statistics.num_quiescent_timesteps      = 0;
+  domain->statistics.num_fast_forwards            = 0;
+  domain->statistics.fast_forward_time            = 0.0;
+  domain->statistics.num_multirate_steps          = 0;
+  domain->statistics.num_multirate_substeps       = 0;
+  domain->statistics.num_redistribute_skipped     = 0;
+  domain->statistics.num_redistribute_fronts_only = 0;
+  domain->statistics.num_redistribute_local       = 0;
+  domain->statistics.num_redistribute_full        = 0;
+}
+
+/* Comment in .h file. */
+int t_o_set_integrator(t_o_domain* domain, int integrator)
+{
+  int error = FALSE; // Error flag.
+
+  if (NULL == domain)
     {
-      slug* temp_slug = slug_pool;
+      fprintf(stderr, "ERROR: domain must not be NULL\n");
+      error = TRUE;
+    }
 
-      slug_pool = slug_pool->next;
-      v_dealloc((void**)&temp_slug, sizeof(slug));
+  if (T_O_INTEGRATOR_EULER != integrator && T_O_INTEGRATOR_RK4 != integrator && T_O_INTEGRATOR_GREEN_AMPT != integrator)
+    {
+      fprintf(stderr, "ERROR: integrator must be T_O_INTEGRATOR_EULER, T_O_INTEGRATOR_RK4, or T_O_INTEGRATOR_GREEN_AMPT\n");
+      error = TRUE;
     }
-  
-#ifdef THREAD_SAFE
-  pthread_mutex_unlock(&slug_pool_mutex);
-#endif // THREAD_SAFE
+
+  if (!error)
+    {
+      domain->integrator = integrator;
+    }
+
+  return error;
+}
+
+/* Comment in .h file. */
+int t_o_set_redistribution(t_o_domain* domain, int redistribution)
+{
+  int error = FALSE; // Error flag.
+
+  if (NULL == domain)
+    {
+      fprintf(stderr, "ERROR: domain must not be NULL\n");
+      error = TRUE;
+    }
+
+  if (T_O_REDISTRIBUTE_SLUGS != redistribution && T_O_REDISTRIBUTE_STAIRCASE != redistribution)
+    {
+      fprintf(stderr, "ERROR: redistribution must be T_O_REDISTRIBUTE_SLUGS or T_O_REDISTRIBUTE_STAIRCASE\n");
+      error = TRUE;
+    }
+
+  if (!error)
+    {
+      domain->redistribution = redistribution;
+    }
+
+  return error;
 }
 
 /* Return TRUE if the given bin is completely wet from top to bot,
@@ -605,6 +874,21 @@ int has_water_at_depth(t_o_domain* domain, int bin, double top, double bot)
     }
   else
     {
+#ifdef SLUG_SPANS
+      slug_span* span = &domain->slug_spans[bin];
+      int        ii   = 0; // The first slug whose bottom is not above top.
+
+      while (ii < span->num_slugs && span->bot[ii] < top)
+        {
+          ii++;
+        }
+
+      if (ii < span->num_slugs && span->top[ii] <= top && span->bot[ii] >= bot)
+        {
+          // There is water in a slug from top to bot.
+          has_water = TRUE;
+        }
+#else // SLUG_SPANS
       slug* temp_slug = domain->top_slug[bin];
 
       while (NULL != temp_slug && temp_slug->bot < top)
@@ -617,6 +901,7 @@ int has_water_at_depth(t_o_domain* domain, int bin, double top, double bot)
           // There is water in a slug from top to bot.
           has_water = TRUE;
         }
+#endif // SLUG_SPANS
     }
 
   return has_water;
@@ -632,6 +917,11 @@ void t_o_check_invariant(t_o_domain* domain)
 
   if (NULL != domain)
     {
+#ifdef SLUG_SPANS
+      // The spans hold the same slugs as the lists.  has_water_at_depth uses the spans.
+      assert(slug_spans_match_lists(domain));
+#endif // SLUG_SPANS
+
       // Process all bins.
       for (ii = 1; ii <= domain->parameters->num_bins; ii++)
         {
@@ -740,6 +1030,9 @@ void t_o_check_invariant(t_o_domain* domain)
 double t_o_total_water_in_domain(t_o_domain* domain)
 {
   int    ii;          // Loop counter.
+#ifdef SLUG_SPANS
+  int    jj;          // Loop counter.
+#endif // SLUG_SPANS
   double water = 0.0; // Accumulator for water in meters of bin depth.
 
   assert(NULL != domain);
@@ -760,6 +1053,14 @@ double t_o_total_water_in_domain(t_o_domain* domain)
               water += domain->surface_front[ii] - domain->layer_top_depth;
 
               // Add slugs.
+#ifdef SLUG_SPANS
+              slug_span* span = &domain->slug_spans[ii];
+
+              for (jj = 0; jj < span->num_slugs; jj++)
+                {
+                  water += span->bot[jj] - span->top[jj];
+                }
+#else // SLUG_SPANS
               slug* temp_slug = domain->top_slug[ii];
 
               while (NULL != temp_slug)
@@ -767,6 +1068,7 @@ double t_o_total_water_in_domain(t_o_domain* domain)
                   water += temp_slug->bot - temp_slug->top;
                   temp_slug = temp_slug->next;
                 }
+#endif // SLUG_SPANS
 
               // Add groundwater.
               if (domain->yes_groundwater)
@@ -782,3118 +1084,9266 @@ double t_o_total_water_in_domain(t_o_domain* domain)
       ((domain->layer_bottom_depth - domain->layer_top_depth) * (domain->parameters->bin_water_content[1] - domain->parameters->delta_water_content));
 }
 
-/* Create a slug struct and initialize it.
- * Return TRUE if there is an error, FALSE otherwise.
- * top and bot are initialized to the passed parameters.  prev and next are
- * initialized to NULL.  Rather than allocating a slug struct each time it is
- * called, this function might get it from a pool of unused slug structs.
+// A depth where the water content of a t_o_domain profile changes.  The water content and pressure head hold from the
+// previous profile_point down to this depth.
+typedef struct
+{
+  double depth;    // Meters.
+  double theta;    // Water content above depth, unitless.
+  double pressure; // Pressure head above depth in meters.
+  int    order;    // Breaks ties between equal depths.  Four times the bin plus 0 for a surface front, 1 for a slug top,
+                   // 2 for a slug bottom, and 3 for a groundwater front.
+} profile_point;
+
+// Return whether profile_point a comes before profile_point b in depth order.
+static inline int profile_point_before(const profile_point* a, const profile_point* b)
+{
+  return a->depth < b->depth || (a->depth == b->depth && a->order < b->order);
+}
+
+/* Sort profile_points by depth with a bottom up merge sort.  Points at the
+ * same depth are sorted by order.  Adjacent runs that are already in order
+ * are copied without comparing every element.  Surface fronts, slugs, and
+ * groundwater fronts are each gathered in depth order so the runs are long.
  *
  * Parameters:
  *
- * new_slug - A pointer passed by reference which will be assigned to point to
- *            the newly allocated struct or NULL if there is an error.
- * top      - The depth in meters of the top    of the new slug.
- * bot      - The depth in meters of the bottom of the new slug.
+ * points     - A 1D array of num_points profile_points with zero based
+ *              indexing.
+ * scratch    - A 1D array of at least num_points profile_points used as
+ *              temporary storage.
+ * num_points - The number of points to sort.
  */
-int slug_alloc(slug** new_slug, double top, double bot)
+void merge_sort_profile(profile_point* points, profile_point* scratch, int num_points)
 {
-  int error = FALSE; // Error flag.
+  int            width;            // The length of the runs being merged.
+  int            left;             // The start of the left  run.
+  int            middle;           // The start of the right run.
+  int            right;            // One past the end of the right run.
+  int            ii, jj, kk;       // Loop counters.
+  profile_point* from = points;    // The array being merged from.
+  profile_point* to   = scratch;   // The array being merged into.
+  profile_point* temp;
+
+  for (width = 1; width < num_points; width *= 2)
+    {
+      for (left = 0; left < num_points; left += 2 * width)
+        {
+          middle = min(left + width, num_points);
+          right  = min(left + 2 * width, num_points);
+          ii     = left;
+          jj     = middle;
+          kk     = left;
+
+          // If the runs are already in order skip straight to copying them.
+          if (middle < right && !profile_point_before(&from[middle], &from[middle - 1]))
+            {
+              jj = right;
+            }
 
-  //assert(NULL != new_slug && 0.0 <= top && top < bot);
-    assert(NULL != new_slug && 0.0 <= top && top <= bot); // FIXME, WENCONG, change top < bot to <=, so that it can create an empty slug.
-#ifdef THREAD_SAFE
-  pthread_mutex_lock(&slug_pool_mutex);
-#endif // THREAD_SAFE
+          while (ii < middle && jj < right)
+            {
+              if (profile_point_before(&from[jj], &from[ii]))
+                {
+                  to[kk++] = from[jj++];
+                }
+              else
+                {
+                  to[kk++] = from[ii++];
+                }
+            }
 
-  if (NULL != slug_pool)
+          while (ii < middle)
+            {
+              to[kk++] = from[ii++];
+            }
+
+          // If the runs were already in order the right run has not been copied.
+          for (jj = kk; jj < right; jj++)
+            {
+              to[jj] = from[jj];
+            }
+        }
+
+      temp = from;
+      from = to;
+      to   = temp;
+    }
+
+  if (from != points)
     {
-      // Instead of allocating, get a slug struct from the slug pool.
-      *new_slug = slug_pool;
-      slug_pool = slug_pool->next;
-      
-#ifdef THREAD_SAFE
-      pthread_mutex_unlock(&slug_pool_mutex);
-#endif // THREAD_SAFE
+      for (ii = 0; ii < num_points; ii++)
+        {
+          points[ii] = from[ii];
+        }
     }
-  else
+}
+
+/* Comment in .h file. */
+int t_o_profile(t_o_domain* domain, int num_elements, const double* element_depth, double* water_content, double* pressure_head)
+{
+  int            error      = FALSE; // Error flag.
+  int            ii, jj;             // Loop counters.
+  int            num_points = 0;     // The number of points found.
+  int            num_kept;           // The number of points kept after merging points at the same depth.
+  int            max_points;         // The most points there can be.
+  int            first_bin;          // The leftmost bin that is not completely full of water.
+  profile_point* points     = NULL;  // 1D array of the depths where the water content changes.
+  profile_point* scratch    = NULL;  // 1D array of temporary storage for sorting points.
+  slug*          temp_slug;
+
+#if (DEBUG_LEVEL & DEBUG_LEVEL_PUBLIC_FUNCTIONS_SIMPLE)
+  if (NULL == domain)
     {
-#ifdef THREAD_SAFE
-      pthread_mutex_unlock(&slug_pool_mutex); // Unlock before allocating to reduce contention.
-#endif // THREAD_SAFE
+      fprintf(stderr, "ERROR: domain must not be NULL.\n");
+      error = TRUE;
+    }
 
-      // Allocate a new slug struct.
-      error = v_alloc((void**)new_slug, sizeof(slug));
+  if (1 > num_elements)
+    {
+      fprintf(stderr, "ERROR: num_elements must be greater than or equal to one.\n");
+      error = TRUE;
     }
 
-  if (!error)
+  if (NULL == element_depth || NULL == water_content || NULL == pressure_head)
     {
-      (*new_slug)->prev = NULL;
-      (*new_slug)->next = NULL;
-      (*new_slug)->top  = top;
-      (*new_slug)->bot  = bot;
+      fprintf(stderr, "ERROR: element_depth, water_content, and pressure_head must not be NULL.\n");
+      error = TRUE;
     }
+#endif // (DEBUG_LEVEL & DEBUG_LEVEL_PUBLIC_FUNCTIONS_SIMPLE)
 
-  return error;
-}
+  if (!error)
+    {
+      // Count the points.  Each bin has a surface front, a groundwater front, and two points per slug.
+      max_points = 2 * domain->parameters->num_bins + 2;
 
-/* Free memory allocated by slug_alloc.
- * Rather than freeing a slug struct each time it is called, this function
- * puts it back in a pool of unused slug structs.
- * 
- * Parameters:
- *
- * slug_to_kill - A pointer to the slug struct passed by reference.
- *                Will be set to NULL after the memory is deallocated.
- */
-void slug_dealloc(slug** slug_to_kill)
-{
-  assert(NULL != slug_to_kill && NULL != *slug_to_kill);
-  
-  // Instead of deallocating, add the slug struct to the slug pool.
-  // v_dealloc((void**)slug_to_kill, sizeof(slug));
-#ifdef THREAD_SAFE
-  pthread_mutex_lock(&slug_pool_mutex);
-#endif // THREAD_SAFE
-  
-  (*slug_to_kill)->next = slug_pool;
-	  slug_pool = *slug_to_kill;
-  
-#ifdef THREAD_SAFE
-  pthread_mutex_unlock(&slug_pool_mutex);
-#endif // THREAD_SAFE
-  
-  *slug_to_kill = NULL;
-}
-
-/* Create a new slug in domain in the given bin number.
- * Return TRUE if there is an error, FALSE otherwise.
- * If there is an error no slug is created.
- * The slug is placed after prev_slug in the linked list or at the top of the
- * linked list if prev_slug is NULL.  This function assumes prev_slug is in the
- * given bin number and the linked list position is correct for the given
- * values of top and bot.
- *
- * Parameters:
- *
- * domain    - A pointer to the t_o_domain struct.
- * bin       - Which bin to add the slug to.  One based indexing is used.
- * prev_slug - The new slug will be placed after this slug in the linked list.
- *             Pass in NULL to place the new slug at the top of the linked list
- *             or if the slug list for the bin is empty.
- * top       - The depth in meters of the top    of the new slug.
- * bot       - The depth in meters of the bottom of the new slug.
- */
-int create_slug_after(t_o_domain* domain, int bin, slug* prev_slug, double top, double bot)
-{
-  int   error = FALSE; // Error flag.
-  slug* new_slug;      // To point to the created slug.
+      for (ii = 2; ii <= domain->parameters->num_bins; ii++)
+        {
+          for (temp_slug = domain->top_slug[ii]; NULL != temp_slug; temp_slug = temp_slug->next)
+            {
+              max_points += 2;
+            }
+        }
 
-  // FIXME, wencong.
-//assert(NULL != domain && 0 < bin && bin <= domain->parameters->num_bins && domain->layer_top_depth <= top && top < bot && bot <= domain->layer_bottom_depth);
-  assert(NULL != domain && 0 < bin && bin <= domain->parameters->num_bins && domain->layer_top_depth <= top && top <=bot && bot <= domain->layer_bottom_depth); 
-  // FIXME, WENCONG, top <bot
+      error = arena_v_alloc(domain->scratch, (void**)&points, max_points * sizeof(profile_point));
 
-  // Allocate the new slug.
-  error = slug_alloc(&new_slug, top, bot);
+      if (!error)
+        {
+          error = arena_v_alloc(domain->scratch, (void**)&scratch, max_points * sizeof(profile_point));
+        }
+    }
 
-  // Place it in the linked list.
   if (!error)
     {
-      doubly_linked_list_insert_after((doubly_linked_list_element**)&domain->top_slug[bin], (doubly_linked_list_element**)&domain->bot_slug[bin],
-                                      (doubly_linked_list_element*)prev_slug, (doubly_linked_list_element*)new_slug);
-    }
+      // The top of the domain is always at effective porosity.
+      points[num_points].depth    = domain->layer_top_depth;
+      points[num_points].theta    = domain->parameters->bin_water_content[domain->parameters->num_bins];
+      points[num_points].pressure = 0.0;
+      points[num_points].order    = 0;
+      num_points++;
 
-  return error;
-}
+      // Surface fronts.  Start from bin 2 since bin 1 is always saturated.  Going from right to left finds them in depth order.
+      for (ii = domain->parameters->num_bins; ii >= 2; ii--)
+        {
+          if (domain->surface_front[ii] > domain->layer_top_depth && domain->surface_front[ii] <= domain->layer_bottom_depth)
+            {
+              points[num_points].depth    = domain->surface_front[ii];
+              points[num_points].theta    = domain->parameters->bin_water_content[ii];
+              points[num_points].pressure = -domain->parameters->bin_capillary_suction[ii];
+              points[num_points].order    = 4 * ii;
+              num_points++;
+            }
+        }
 
-/* Remove a slug from its linked list and deallocate its memory.
- *
- * Parameters:
- *
- * domain       - A pointer to the t_o_domain struct.
- * bin          - Which bin to remove the slug from.
- *                One based indexing is used.
- * slug_to_kill - The slug to remove.
- */
-void kill_slug(t_o_domain* domain, int bin, slug* slug_to_kill)
-{
-  assert(NULL != domain && 0 < bin && bin <= domain->parameters->num_bins && NULL != slug_to_kill);
+      // Slugs.  The top of a slug ends the drier water above it and the bottom of a slug ends the slug.
+      for (ii = 2; ii <= domain->parameters->num_bins; ii++)
+        {
+          for (temp_slug = domain->top_slug[ii]; NULL != temp_slug; temp_slug = temp_slug->next)
+            {
+              points[num_points].depth    = temp_slug->top;
+              points[num_points].theta    = domain->parameters->bin_water_content[ii - 1];
+              points[num_points].pressure = -domain->parameters->bin_capillary_suction[ii - 1];
+              points[num_points].order    = 4 * ii + 1;
+              num_points++;
+
+              points[num_points].depth    = temp_slug->bot;
+              points[num_points].theta    = domain->parameters->bin_water_content[ii];
+              points[num_points].pressure = -domain->parameters->bin_capillary_suction[ii];
+              points[num_points].order    = 4 * ii + 2;
+              num_points++;
+            }
+        }
 
-  // Remove from the list.
-  doubly_linked_list_remove_element((doubly_linked_list_element**)&domain->top_slug[bin], (doubly_linked_list_element**)&domain->bot_slug[bin],
-                                    (doubly_linked_list_element*)slug_to_kill);
+      // Groundwater fronts.  Going from left to right finds them in depth order.
+      if (domain->yes_groundwater)
+        {
+          for (ii = 2; ii <= domain->parameters->num_bins; ii++)
+            {
+              if (domain->groundwater_front[ii] > domain->layer_top_depth)
+                {
+                  points[num_points].depth    = domain->groundwater_front[ii];
+                  points[num_points].theta    = domain->parameters->bin_water_content[ii - 1];
+                  points[num_points].pressure = -domain->parameters->bin_capillary_suction[ii - 1];
+                  points[num_points].order    = 4 * ii + 3;
+                  num_points++;
+                }
+            }
+        }
 
-  // Deallocate.
-  slug_dealloc(&slug_to_kill);
-}
+      // The bottom of the domain.
+      if (domain->yes_groundwater)
+        {
+          // Saturated by groundwater.
+          points[num_points].theta    = domain->parameters->bin_water_content[domain->parameters->num_bins];
+          points[num_points].pressure = 0.0;
+        }
+      else
+        {
+          // At the water content of the bins in contact with groundwater.
+          for (first_bin = 2; first_bin <= domain->parameters->num_bins &&
+                              domain->parameters->bin_water_content[first_bin] <= domain->initial_water_content; first_bin++)
+            {
+              // Find first_bin.
+            }
 
-/* Change surface water in one bin into a slug.
- * Return TRUE if there is an error, FALSE otherwise.
- * If there is an error the slug is not detached.
- * The water is removed from the surface front and placed in a new slug with
- * its top at zero and bottom at the location of the surface front.
- * There is no vertical movement of the water.  No slug will be created
- * if the surface front is at zero and thus has no water.
- *
- * Parameters:
- *
- * domain - A pointer to the t_o_domain struct.
- * bin    - Which bin to detach.  One based indexing is used.
- */
-int detach_slug(t_o_domain* domain, int bin)
-{
-  int error = FALSE; // Error flag.
+          points[num_points].theta    = domain->parameters->bin_water_content[first_bin - 1];
+          points[num_points].pressure = -domain->parameters->bin_capillary_suction[first_bin - 1];
+        }
 
-  assert(NULL != domain && 0 < bin && bin <= domain->parameters->num_bins);
+      points[num_points].depth = domain->layer_bottom_depth;
+      points[num_points].order = 4 * (domain->parameters->num_bins + 1);
+      num_points++;
 
-  if (domain->layer_top_depth < domain->surface_front[bin])
-    {
-      error = create_slug_after(domain, bin, NULL, domain->layer_top_depth, domain->surface_front[bin]);
+      // The top of the domain must stay first so only sort the rest.
+      merge_sort_profile(points + 1, scratch, num_points - 1);
 
-      if (!error)
+      // Merge points at the same depth.  The first one at a depth is kept except without groundwater the wettest one's
+      // water content is kept.
+      num_kept = 1;
+
+      for (ii = 1; ii < num_points; ii++)
+        {
+          if (epsilon_greater(points[ii].depth, points[num_kept - 1].depth))
+            {
+              points[num_kept++] = points[ii];
+            }
+          else if (!domain->yes_groundwater && points[num_kept - 1].theta < points[ii].theta)
+            {
+              points[num_kept - 1].theta    = points[ii].theta;
+              points[num_kept - 1].pressure = points[ii].pressure;
+            }
+        }
+
+      // Sweep down the elements and the points together.  Each element gets the values of the first point at or below
+      // its depth.  Elements below the bottom of the domain get the values at the bottom.
+      ii = 0;
+
+      for (jj = 1; jj <= num_elements; jj++)
         {
-          domain->surface_front[bin] = domain->layer_top_depth;
+          assert(1 == jj || element_depth[jj - 1] <= element_depth[jj]);
+
+          while (ii < num_kept - 1 && points[ii].depth < element_depth[jj])
+            {
+              ii++;
+            }
+
+          water_content[jj] = points[ii].theta;
+          pressure_head[jj] = points[ii].pressure;
         }
     }
 
+  if (NULL != domain && NULL != domain->scratch)
+    {
+      arena_reset(domain->scratch);
+    }
+
   return error;
 }
 
-/* Change surface water in all bins into slugs.
+/* Create a slug struct and initialize it.
  * Return TRUE if there is an error, FALSE otherwise.
- * If there is an error some but not all of the slugs might be detached.
- * The water is removed from the surface front and placed in new slugs with
- * their top at zero and bottom at the location of the surface front.
- * There is no vertical movement of the water.  No slug will be created
- * for a bin if the surface front is at zero and thus has no water.
+ * top and bot are initialized to the passed parameters.  prev and next are
+ * initialized to NULL.  Rather than allocating a slug struct each time it is
+ * called, this function might get it from a pool of unused slug structs.
  *
  * Parameters:
  *
- * domain - A pointer to the t_o_domain struct.
+ * new_slug - A pointer passed by reference which will be assigned to point to
+ *            the newly allocated struct or NULL if there is an error.
+ * top      - The depth in meters of the top    of the new slug.
+ * bot      - The depth in meters of the bottom of the new slug.
  */
-int detach_all_slugs(t_o_domain* domain)
+int slug_alloc(slug** new_slug, double top, double bot)
 {
   int error = FALSE; // Error flag.
-  int ii;            // Loop counter.
 
-  assert(NULL != domain);
+  //assert(NULL != new_slug && 0.0 <= top && top < bot);
+    assert(NULL != new_slug && 0.0 <= top && top <= bot); // FIXME, WENCONG, change top < bot to <=, so that it can create an empty slug.
+#ifdef THREAD_SAFE
+  if (NULL != thread_slug_pool)
+    {
+      // Get a slug struct from this thread's pool without locking.
+      *new_slug        = thread_slug_pool;
+      thread_slug_pool = thread_slug_pool->next;
+      thread_slug_pool_size--;
+    }
+  else
+    {
+      pthread_mutex_lock(&slug_pool_mutex);
 
-  // Process all bins.
-  for (ii = 1; !error && ii <= domain->parameters->num_bins; ii++)
+      if (NULL != slug_pool)
+        {
+          // Instead of allocating, get a slug struct from the slug pool.
+          *new_slug = slug_pool;
+          slug_pool = slug_pool->next;
+
+          pthread_mutex_unlock(&slug_pool_mutex);
+        }
+      else
+        {
+          pthread_mutex_unlock(&slug_pool_mutex); // Unlock before allocating to reduce contention.
+
+          // Allocate a new slug struct.
+          error = v_alloc((void**)new_slug, sizeof(slug));
+        }
+    }
+#else // THREAD_SAFE
+  if (NULL != slug_pool)
     {
-      error = detach_slug(domain, ii);
+      // Instead of allocating, get a slug struct from the slug pool.
+      *new_slug = slug_pool;
+      slug_pool = slug_pool->next;
+    }
+  else
+    {
+      // Allocate a new slug struct.
+      error = v_alloc((void**)new_slug, sizeof(slug));
+    }
+#endif // THREAD_SAFE
+
+  if (!error)
+    {
+      (*new_slug)->prev = NULL;
+      (*new_slug)->next = NULL;
+      (*new_slug)->top  = top;
+      (*new_slug)->bot  = bot;
+#ifdef SLUG_SPANS
+      (*new_slug)->span_index = -1;
+#endif // SLUG_SPANS
     }
 
   return error;
 }
 
-// FIXLATER possible optimization: Calculate first_bin and last_bin once
-// and pass the values around and update them only if they change.
-// FIXLATER possible optimization binary search instead of linear.
-
-/* Return the leftmost bin that is not completely full of water or num_bins + 1
- * if all bins are completely full of water.  If yes_groundwater is FALSE then
- * bins to the right of initial_water_content are not considered completely
- * full of water even if surface_front reaches to layer_depth because they are
- * not in contact with groundwater.  first_bin is forced to be at least 2
- * because bin 1 should always be completely full of water, and we often use
- * first_bin - 1 as an array index.  If bin 1 is ever not completely full of
- * water then residual_saturation is set too high, and the simulation will be
- * innacurate because it needs more bins to the left.
- *
+/* Free memory allocated by slug_alloc.
+ * Rather than freeing a slug struct each time it is called, this function
+ * puts it back in a pool of unused slug structs.
+ * 
  * Parameters:
  *
- * domain       - A pointer to the t_o_domain struct.
- * start_search - Only search from this bin to the right.  Certain situations
- *                have a lower bound for first_bin.  Passing in this lower
- *                bound can speed things up.  If you don't know a lower bound
- *                pass in 2.
+ * slug_to_kill - A pointer to the slug struct passed by reference.
+ *                Will be set to NULL after the memory is deallocated.
  */
-int find_first_bin(t_o_domain* domain, int start_search)
+void slug_dealloc(slug** slug_to_kill)
 {
-  assert(NULL != domain && 2 <= start_search && start_search <= domain->parameters->num_bins + 1);
-
-  int first_bin = start_search; // The leftmost bin that is not completely full of water.
+  assert(NULL != slug_to_kill && NULL != *slug_to_kill);
+  
+  // Instead of deallocating, add the slug struct to the slug pool.
+  // v_dealloc((void**)slug_to_kill, sizeof(slug));
+#ifdef THREAD_SAFE
+  (*slug_to_kill)->next = thread_slug_pool;
+  thread_slug_pool      = *slug_to_kill;
+  thread_slug_pool_size++;
 
-  // We cannot use has_water_at_depth(0.0 to domain->layer_depth) because if yes_groundwater is FALSE and surface_front reaches to layer_depth then
-  // has_water_at_depth will return TRUE even though that bin should not be considered in contact with groundwater.
-  while(first_bin <= domain->parameters->num_bins &&
-        ((domain->yes_groundwater && domain->layer_top_depth == domain->groundwater_front[first_bin]) ||
-         (!domain->yes_groundwater && domain->parameters->bin_water_content[first_bin] <= domain->initial_water_content)))
+  if (THREAD_SLUG_POOL_LIMIT < thread_slug_pool_size)
     {
-      first_bin++;
-    }
+      // Give half of this thread's pool back to slug_pool so that slug structs freed by this thread can be used by other threads.
+      int   ii;                           // Loop counter.
+      slug* first_slug = thread_slug_pool; // The first slug struct to give back.
+      slug* last_slug  = thread_slug_pool; // The last  slug struct to give back.
 
-  return first_bin;
+      for (ii = 1; ii < THREAD_SLUG_POOL_LIMIT / 2; ii++)
+        {
+          last_slug = last_slug->next;
+        }
+
+      thread_slug_pool       = last_slug->next;
+      thread_slug_pool_size -= THREAD_SLUG_POOL_LIMIT / 2;
+
+      pthread_mutex_lock(&slug_pool_mutex);
+      last_slug->next = slug_pool;
+      slug_pool       = first_slug;
+      pthread_mutex_unlock(&slug_pool_mutex);
+    }
+#else // THREAD_SAFE
+  (*slug_to_kill)->next = slug_pool;
+  slug_pool             = *slug_to_kill;
+#endif // THREAD_SAFE
+  
+  *slug_to_kill = NULL;
 }
 
-/* Return the rightmost bin that has surface front water or 1 if no bins have
- * surface front water.  last_bin is forced to be at least 1 because bin 1
- * should always be completely full of water.  See the comment of
- * find_first_bin for why.
+/* Create num_slugs slug structs at once for building whole slug lists such as
+ * when restoring a checkpoint.  The slug pools are drained with one lock
+ * instead of one per slug.
+ * Return TRUE if there is an error, FALSE otherwise.
+ * The slug structs are returned linked through next in a singly linked list.
+ * prev, top, and bot are not initialized.  Each one can be freed with
+ * slug_dealloc.
  *
  * Parameters:
  *
- * domain - A pointer to the t_o_domain struct.
+ * first_slug - A pointer passed by reference which will be assigned to point
+ *              to the first slug struct in the list or NULL if num_slugs is
+ *              zero or there is an error.
+ * num_slugs  - The number of slug structs to create.
  */
-int find_last_bin(t_o_domain* domain)
+int slug_alloc_chain(slug** first_slug, int num_slugs)
 {
-  assert(NULL != domain);
+  int   error     = FALSE; // Error flag.
+  int   num_found = 0;     // The number of slug structs in the list so far.
+  slug* last_slug = NULL;  // The last slug struct in the list.
+  slug* new_slug;
 
-  int last_bin = domain->parameters->num_bins; // The rightmost bin that has surface front water.
-  
-  while (1 < last_bin && !has_water_at_depth(domain, last_bin, domain->layer_top_depth, domain->layer_top_depth))
-    {
-      last_bin--;
-    }
+  assert(NULL != first_slug && 0 <= num_slugs);
 
-  return last_bin;
-}
+  *first_slug = NULL;
 
-/* Process infiltration into the completely saturated bins.
- * Return TRUE if there is an error, FALSE otherwise.
- * If there is an error some but not all of the surface front water
- * might be detached as slugs, and not all of the demand might be
- * satisfied even if there is still surface front water and/or slugs.
- * This function takes water from the surface first.  If there is not enough
- * water on the surface, it detaches all surface front water into slugs and
- * then takes water from slugs.
- *
- * Parameters:
- *
- * domain               - A pointer to the t_o_domain struct.
- * dt                   - The duration of the timestep in seconds.
- * first_bin            - The leftmost bin that is not completely full of
- *                        water.
- * surfacewater_depth   - A scalar passed by reference containing the depth
- *                        in meters of the surface water.  Will be updated for
- *                        the amount of infiltration.
- * ponded_water         - A scalar passed by reference.  Will be set to whether
- *                        the demand of the fully saturated bins was completely
- *                        satisfied from surface water.
- * groundwater_recharge - A scalar passed by reference containing any
- *                        previously accumulated groundwater recharge in meters
- *                        of water.  Will be updated for the amount of water
- *                        that flowed between the Talbot-Ogden domain and
- *                        groundwater.  Positive means water flowed down out of
- *                        the Talbot-Ogden domain.  Negative means water flowed
- *                        up in to the Talbot-Ogden domain.
- * water_table          - The depth in meters of the water table. (add 06/17/14)
- */
-int t_o_satisfy_saturated_bins(t_o_domain* domain, double dt, int first_bin, double* surfacewater_depth, int* ponded_water, double* groundwater_recharge,
-                               double water_table)
-{
-  assert(NULL != domain && 0.0 < dt && NULL != surfacewater_depth && 0.0 <= *surfacewater_depth && NULL != ponded_water && NULL != groundwater_recharge);
+#ifdef THREAD_SAFE
+  // Take slug structs from this thread's pool without locking.
+  while (num_found < num_slugs && NULL != thread_slug_pool)
+    {
+      new_slug         = thread_slug_pool;
+      thread_slug_pool = thread_slug_pool->next;
+      thread_slug_pool_size--;
 
-  int    error = FALSE; // Error flag.
-  int    ii, jj;        // Loop counters.
-  double demand;        // Total water in meters of water that can infiltrate this timestep.
-  double demand2;       // Demand of firstbin - 2.  We want the groundwater in saturated bins to fall only if they cannot be satisfied from surface water.
-                        // However, if it is raining less than the saturated conductivity it may be able to satisfy only part of the last saturated bin.
-                        // This can lead to an oscilation where it can't satisfy all of the saturated bins so the groundwater in all of the saturated bins
-                        // falls including those bins that are being satisfied from surface water.  The rainfall can no longer infiltrate through the saturated
-                        // bins and it becomes surface front water, which collides with the groundwater front increasing the number of saturated bins until the
-                        // bin that can only be partially satisfied with rainfall becomes saturated and the cycle repeats.  To avoid this oscilation we allow
-                        // the groundwater to fall only if the next to last saturated bin cannot be satisfied from surface water.  demand2 is the demand of the
-                        // next to last saturated bin.
-  
-  // Calculate the demand of all the bins up to but not including first_bin, if not saturated.
-  // FIXME do we want to vary the demand with surface water pressure head boundary condition?
-  
-   if (domain->yes_groundwater && domain->groundwater_front[domain->parameters->num_bins] <= domain->layer_top_depth)
-    { // FIXME, wecnong, add 06/17/14, if fully saturated, calculated demand using Darcy's law.
-      assert(water_table >= domain->layer_top_depth);
-      demand = dt * domain->parameters->cumulative_conductivity[domain->parameters->num_bins] * (water_table - domain->layer_top_depth) / 
-               (domain->layer_bottom_depth - domain->layer_top_depth);
-      if (*surfacewater_depth   >= dt * domain->parameters->cumulative_conductivity[domain->parameters->num_bins])
+      if (NULL == last_slug)
         {
-          *ponded_water          = TRUE;
+          *first_slug = new_slug;
         }
       else
         {
-          *ponded_water          = FALSE;
-          error = detach_all_slugs(domain);
-        }
-        
-      if (*surfacewater_depth >= demand)
-        {
-          *surfacewater_depth   -= demand;
-          *groundwater_recharge += demand;
+          last_slug->next = new_slug;
         }
-      else
+
+      last_slug = new_slug;
+      num_found++;
+    }
+
+  if (num_found < num_slugs)
+    {
+      pthread_mutex_lock(&slug_pool_mutex);
+#endif // THREAD_SAFE
+
+      // Take slug structs from the slug pool.
+      while (num_found < num_slugs && NULL != slug_pool)
         {
-          *groundwater_recharge += *surfacewater_depth;
-          *surfacewater_depth    = 0.0; 
+          new_slug  = slug_pool;
+          slug_pool = slug_pool->next;
+
+          if (NULL == last_slug)
+            {
+              *first_slug = new_slug;
+            }
+          else
+            {
+              last_slug->next = new_slug;
+            }
+
+          last_slug = new_slug;
+          num_found++;
         }
-     
-      return error;
+
+#ifdef THREAD_SAFE
+      pthread_mutex_unlock(&slug_pool_mutex);
     }
-   else
+#endif // THREAD_SAFE
+
+  // Allocate the rest.
+  while (!error && num_found < num_slugs)
     {
-      demand = domain->parameters->cumulative_conductivity[first_bin - 1] * dt;
-      if (first_bin > 2)
+      error = v_alloc((void**)&new_slug, sizeof(slug));
+
+      if (!error)
         {
-          demand2 = domain->parameters->cumulative_conductivity[first_bin - 2] * dt;
+          if (NULL == last_slug)
+            {
+              *first_slug = new_slug;
+            }
+          else
+            {
+              last_slug->next = new_slug;
+            }
+
+          last_slug = new_slug;
+          num_found++;
         }
-      else
+    }
+
+  if (NULL != last_slug)
+    {
+      last_slug->next = NULL;
+    }
+
+  if (error)
+    {
+      // Give back the slug structs already found.
+      while (NULL != *first_slug)
         {
-          demand2 = 0.95 * demand;
+          new_slug    = *first_slug;
+          *first_slug = (*first_slug)->next;
+
+          slug_dealloc(&new_slug);
         }
-    }// End of calculated demand of saturated bins.
+    }
 
-  // Satisfy as much of the demand as possible from surface water.
-  if (*surfacewater_depth   >= demand)
+  return error;
+}
+
+
+/* A checkpoint file is a checkpoint_header followed by num_domains int64_t
+ * byte offsets from the start of the file, one for each domain, followed by
+ * the domains.  Each domain is a checkpoint_domain_header followed by these
+ * arrays with one element per bin from bin 1 to num_bins:
+ *
+ * double  surface_front[num_bins]
+ * double  groundwater_front[num_bins]  Only if yes_groundwater is TRUE.
+ * int64_t bin_num_slugs[num_bins]      The number of slugs in each bin.
+ *
+ * followed by a double top and bot for each slug from the top slug of bin 1 to
+ * the bottom slug of bin num_bins.  There are no pointers so the file can be
+ * memory mapped at any address.  Everything is eight byte aligned and in the
+ * byte order of the machine that wrote the file.
+ */
+typedef struct
+{
+  char     magic[8];    // CHECKPOINT_MAGIC, not NUL terminated.
+  int32_t  version;     // CHECKPOINT_VERSION.
+  uint32_t byte_order;  // CHECKPOINT_BYTE_ORDER.
+  int64_t  num_domains; // The number of domains in the file.
+} checkpoint_header;
+
+typedef struct
+{
+  int64_t  num_bins;              // The number of bins.
+  int64_t  yes_groundwater;       // Whether the domain simulates groundwater.
+  int64_t  num_slugs;             // The total number of slugs in all bins.
+  uint64_t parameters_hash;       // checkpoint_parameters_hash of the domain's parameters.
+  double   layer_top_depth;       // Meters.
+  double   layer_bottom_depth;    // Meters.
+  double   initial_water_content; // Only used if yes_groundwater is FALSE.
+  int64_t  integrator;            // The integrator of the domain.  Files from before integrators could be chosen have zero, which is Euler.
+} checkpoint_domain_header;
+
+/* Return a hash of the bin properties in parameters so that restoring a
+ * domain with different parameters than it was checkpointed with can be
+ * detected.  This is the 64 bit FNV-1a hash of the bytes of num_bins and of
+ * bin_water_content, cumulative_conductivity, and bin_capillary_suction.
+ *
+ * Parameters:
+ *
+ * parameters - A pointer to the t_o_parameters struct.
+ */
+uint64_t checkpoint_parameters_hash(const t_o_parameters* parameters)
+{
+  uint64_t             hash = 14695981039346656037ULL; // FNV-1a offset basis.
+  int                  ii, jj;                         // Loop counters.
+  size_t               kk;                             // Loop counter.
+  const unsigned char* bytes;
+  const double*        arrays[3] = {parameters->bin_water_content, parameters->cumulative_conductivity, parameters->bin_capillary_suction};
+
+  bytes = (const unsigned char*)&parameters->num_bins;
+
+  for (kk = 0; kk < sizeof(int); kk++)
     {
-      *ponded_water          = TRUE;
-      *surfacewater_depth   -= demand;
-      *groundwater_recharge += demand;
-      demand                 = 0.0;
+      hash = (hash ^ bytes[kk]) * 1099511628211ULL; // FNV-1a prime.
     }
-  else
+
+  for (jj = 0; jj < 3; jj++)
     {
-      if (*surfacewater_depth >= demand2)
+      bytes = (const unsigned char*)&arrays[jj][1];
+
+      for (ii = 0; ii < parameters->num_bins; ii++)
         {
-          *ponded_water = TRUE;
+          for (kk = 0; kk < sizeof(double); kk++)
+            {
+              hash = (hash ^ bytes[ii * sizeof(double) + kk]) * 1099511628211ULL;
+            }
         }
-      else
+    }
+
+  return hash;
+}
+
+/* Return the number of bytes a domain takes up in a checkpoint file.
+ *
+ * Parameters:
+ *
+ * num_bins        - The number of bins.
+ * yes_groundwater - Whether the domain simulates groundwater.
+ * num_slugs       - The total number of slugs in all bins.
+ */
+size_t checkpoint_domain_size(int64_t num_bins, int64_t yes_groundwater, int64_t num_slugs)
+{
+  return sizeof(checkpoint_domain_header) + (yes_groundwater ? 3 : 2) * num_bins * sizeof(double) + 2 * num_slugs * sizeof(double);
+}
+
+/* Comment in .h file. */
+int t_o_domain_checkpoint(t_o_domain** domains, int num_domains, const char* path)
+{
+  int                      error          = FALSE; // Error flag.
+  int                      ii, kk;                 // Loop counters.
+  FILE*                    fptr           = NULL;
+  char*                    temp_path      = NULL;  // The file is written here and then renamed to path so a crash never leaves half a checkpoint.
+  size_t                   temp_path_size = 0;
+  int64_t*                 num_slugs      = NULL;  // 1D array of the number of slugs in each domain with zero based indexing.
+  int64_t                  offset;                 // Byte offset of the next domain.
+  int64_t                  bin_num_slugs;          // The number of slugs in one bin.
+  checkpoint_header        header;
+  checkpoint_domain_header domain_header;
+  slug*                    temp_slug;
+
+  if (NULL == domains || 1 > num_domains)
+    {
+      fprintf(stderr, "ERROR: domains must not be NULL and num_domains must be greater than or equal to one\n");
+      error = TRUE;
+    }
+
+  for (kk = 0; !error && kk < num_domains; kk++)
+    {
+      if (NULL == domains[kk])
         {
-          *ponded_water = FALSE;
+          fprintf(stderr, "ERROR: domains[%d] must not be NULL\n", kk);
+          error = TRUE;
+        }
+    }
 
-          // If the demand wasn't entirely satisfied from surface water, all surface front water will detach as slugs.
-          error = detach_all_slugs(domain);
+  if (NULL == path)
+    {
+      fprintf(stderr, "ERROR: path must not be NULL\n");
+      error = TRUE;
+    }
+
+  if (!error)
+    {
+      temp_path_size = strlen(path) + sizeof(".tmp");
+      error          = v_alloc((void**)&temp_path, temp_path_size) || v_alloc((void**)&num_slugs, num_domains * sizeof(int64_t));
+    }
+
+  if (!error)
+    {
+      snprintf(temp_path, temp_path_size, "%s.tmp", path);
+
+      if (NULL == (fptr = fopen(temp_path, "wb")))
+        {
+          fprintf(stderr, "ERROR: Could not open %s for writing\n", temp_path);
+          error = TRUE;
         }
-      
-      if (0.0 < *surfacewater_depth)
+      else
         {
-          *groundwater_recharge += *surfacewater_depth;
-          demand                -= *surfacewater_depth;
-          *surfacewater_depth    = 0.0;
+          setvbuf(fptr, NULL, _IOFBF, 1 << 20);
         }
     }
-  
+
+  // Write the header and the offset of each domain.
   if (!error)
     {
-      // Satisfy the rest of the demand from slugs.
-      int has_slugs = TRUE;
+      memset(&header, 0, sizeof(checkpoint_header));
+      memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
 
-      while (epsilon_less(0.0, demand) && has_slugs)
+      header.version     = CHECKPOINT_VERSION;
+      header.byte_order  = CHECKPOINT_BYTE_ORDER;
+      header.num_domains = num_domains;
+
+      error  = (1 != fwrite(&header, sizeof(checkpoint_header), 1, fptr));
+      offset = sizeof(checkpoint_header) + num_domains * sizeof(int64_t);
+
+      for (kk = 0; !error && kk < num_domains; kk++)
         {
-          // Get the rightmost slug.
-          ii = domain->parameters->num_bins;
+          num_slugs[kk] = 0;
 
-          while (ii > first_bin && NULL == domain->top_slug[ii])
+          for (ii = 1; ii <= domains[kk]->parameters->num_bins; ii++)
             {
-              ii--;
+              for (temp_slug = domains[kk]->top_slug[ii]; NULL != temp_slug; temp_slug = temp_slug->next)
+                {
+                  num_slugs[kk]++;
+                }
             }
 
-          if (ii <= first_bin)
+          error   = (1 != fwrite(&offset, sizeof(int64_t), 1, fptr));
+          offset += checkpoint_domain_size(domains[kk]->parameters->num_bins, domains[kk]->yes_groundwater, num_slugs[kk]);
+        }
+    }
+
+  // Write the domains.
+  for (kk = 0; !error && kk < num_domains; kk++)
+    {
+      memset(&domain_header, 0, sizeof(checkpoint_domain_header));
+
+      domain_header.num_bins              = domains[kk]->parameters->num_bins;
+      domain_header.yes_groundwater       = domains[kk]->yes_groundwater;
+      domain_header.num_slugs             = num_slugs[kk];
+      domain_header.parameters_hash       = checkpoint_parameters_hash(domains[kk]->parameters);
+      domain_header.layer_top_depth       = domains[kk]->layer_top_depth;
+      domain_header.layer_bottom_depth    = domains[kk]->layer_bottom_depth;
+      domain_header.initial_water_content = domains[kk]->initial_water_content;
+      domain_header.integrator            = domains[kk]->integrator;
+
+      error = (1 != fwrite(&domain_header, sizeof(checkpoint_domain_header), 1, fptr)) ||
+          (size_t)domain_header.num_bins != fwrite(&domains[kk]->surface_front[1], sizeof(double), domain_header.num_bins, fptr);
+
+      if (!error && domains[kk]->yes_groundwater)
+        {
+          error = (size_t)domain_header.num_bins != fwrite(&domains[kk]->groundwater_front[1], sizeof(double), domain_header.num_bins, fptr);
+        }
+
+      for (ii = 1; !error && ii <= domain_header.num_bins; ii++)
+        {
+          for (bin_num_slugs = 0, temp_slug = domains[kk]->top_slug[ii]; NULL != temp_slug; temp_slug = temp_slug->next)
             {
-              has_slugs = FALSE;
+              bin_num_slugs++;
             }
-          else
-            {
-              // Get the water from all slugs connected to domain->top_slug[ii].
-              // FIXME get water from all slugs?
 
-              double demand_save = demand; // We need to remember the value of the demand at the beginning of the loop iteration.
-              slug*  get_slugs[ii + 1];    // Pointers to the slug in each bin that we will get water from.
-              // Some elements might be NULL if we will not get water from a slug in that bin.
-              double weight[ii + 1];       // Take from each slug a fraction of the demand equal to its normalized weight.
-              double total_weight = 0.0;   // For normalizing weights.
+          error = (1 != fwrite(&bin_num_slugs, sizeof(int64_t), 1, fptr));
+        }
 
-              // Determine the weights.
-              for (jj = ii; jj >= first_bin; jj--)
-                {
-                  // Find the slug.
-                  get_slugs[jj] = domain->top_slug[jj];
+      for (ii = 1; !error && ii <= domain_header.num_bins; ii++)
+        {
+          for (temp_slug = domains[kk]->top_slug[ii]; !error && NULL != temp_slug; temp_slug = temp_slug->next)
+            {
+              error = (1 != fwrite(&temp_slug->top, sizeof(double), 1, fptr)) || (1 != fwrite(&temp_slug->bot, sizeof(double), 1, fptr));
+            }
+        }
+    }
 
-                  while (NULL != get_slugs[jj] && domain->top_slug[ii]->top >= get_slugs[jj]->bot)
-                    {
-                      get_slugs[jj] = get_slugs[jj]->next;
-                    }
+  if (NULL != fptr && fclose(fptr))
+    {
+      error = TRUE;
+    }
 
-                  if (NULL != get_slugs[jj] && !(domain->top_slug[ii]->top >= get_slugs[jj]->top && domain->top_slug[ii]->bot <= get_slugs[jj]->bot))
-                    {
-                      get_slugs[jj] = NULL;
-                    }
+  if (!error && rename(temp_path, path))
+    {
+      error = TRUE;
+    }
 
-                  // At this point in the code if get_slugs[jj] is NULL then there is no slug in that bin at that height.
-                  // If it is not NULL, get water from it.
+  if (error && NULL != fptr)
+    {
+      fprintf(stderr, "ERROR: Could not write checkpoint file %s\n", path);
+      remove(temp_path);
+    }
 
-                  // Determine the weight of this slug.
-                  if (NULL != get_slugs[jj])
-                    {
-                      weight[jj]    = (domain->parameters->bin_capillary_suction[first_bin - 1] - domain->parameters->bin_capillary_suction[jj]);
-                      total_weight += weight[jj];
-                    }
-                }
-
-              // Get the water.
-              for (jj = ii; jj >= first_bin; jj--)
-                {
-                  if (NULL != get_slugs[jj])
-                    {
-                      double water = demand_save * weight[jj] / total_weight;         // Water to take from this bin in meters of water.
-                      double depth = water / domain->parameters->delta_water_content; // Water to take from this bin in meters of bin depth.
+  if (NULL != temp_path)
+    {
+      v_dealloc((void**)&temp_path, temp_path_size);
+    }
 
-                      if (depth >= get_slugs[jj]->bot - get_slugs[jj]->top)
-                        {
-                          // Get the entire slug.
-                          water = (get_slugs[jj]->bot - get_slugs[jj]->top) * domain->parameters->delta_water_content;
-                          kill_slug(domain, jj, get_slugs[jj]);
-                        }
-                      else
-                        {
-                          // FIXLATER implement complicated function to allocate water gotten to top and bottom?
-                          // Get the water evenly from the top and bottom of the slug.
-                          get_slugs[jj]->top += depth / 2.0;
-                          get_slugs[jj]->bot -= depth / 2.0;
-                        }
+  if (NULL != num_slugs)
+    {
+      v_dealloc((void**)&num_slugs, num_domains * sizeof(int64_t));
+    }
 
-                      *groundwater_recharge += water;
-                      demand                -= water;
-                    }
-                }
-            } // End get the water from all slugs connected to domain->top_slug[ii].
-        } // End while (epsilon_less(0.0, demand) && has_slugs)
-    } // End if (!error)
-   
   return error;
 }
 
-/*  Find dry depth for Green-Ampt equaiton.
- *   The funciton use to define dry depth is:
- *         Z * porosity = Ks * t + Hc * porosity * ln(1 + Z  / Hc) 
- *   Parameters:
- *   Z        - dry depth to be found in meter [m];
- *   Ks       - saturated conductiviey in meter/second [m/s];
- *   Hc       - effecitve capillary drive(Geff) in meter [m];
- *   dt       - time step in second [s];
- *   porosity - porosity [-].
+/* Map a checkpoint file into memory and check its header.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * path        - The name of the checkpoint file.
+ * data        - A pointer passed by reference which will be assigned to point
+ *               to the memory mapping of the file or MAP_FAILED if there is
+ *               an error.
+ * size        - Scalar passed by reference.  Will be set to the size of the
+ *               file in bytes.
+ * num_domains - Scalar passed by reference.  Will be set to the number of
+ *               domains in the file.
  */
-double GA_drydepth(double Ks, double porosity, double Geff, double dt)
+int checkpoint_map(const char* path, const unsigned char** data, size_t* size, int* num_domains)
 {
-  double minimum_dry_depth     = 1.0e-4; // Meters.
-  double convergence_tolerance = 1.0e-6; // Meters.
-  double iteration_difference;           // Meters.
-  double z_old;                          // Meters.
-  double z_new;                          // Meters.
-  double f;
-  double f_prime;
-  int    iteration_count = 0;
-  int    iteration_limit = 10000;        // maximum number of iterations before giving up.
-  
-  assert(0 < Ks && 0 < porosity && 0 < Geff && 0.0 < dt);
-  
-  z_old = Geff;
-  
-  do
+  int               error = FALSE; // Error flag.
+  int               fd    = -1;    // File descriptor.
+  struct stat       file_stat;
+  checkpoint_header header;
+
+  *data = MAP_FAILED;
+
+  if (NULL == path)
     {
-      f       = Ks * dt + Geff * porosity * log(1.0 + z_old / Geff) - z_old * porosity;
-      f_prime = Geff * porosity / (Geff + z_old) - porosity;
-      if (0.0 == f_prime)
+      fprintf(stderr, "ERROR: path must not be NULL\n");
+      error = TRUE;
+    }
+
+  if (!error)
+    {
+      fd = open(path, O_RDONLY);
+
+      if (-1 == fd || -1 == fstat(fd, &file_stat))
         {
-          // Prevent divide by zero.
-          z_new = Ks * dt / porosity + Geff * log(1.0 + Ks * dt / (porosity * Geff));
-          iteration_difference = 0.0;
+          fprintf(stderr, "ERROR: Could not open checkpoint file %s\n", path);
+          error = TRUE;
         }
-      else
+      else if ((off_t)sizeof(checkpoint_header) > file_stat.st_size)
         {
-          z_new = z_old - (f / f_prime);
-          iteration_difference = z_new - z_old;
+          fprintf(stderr, "ERROR: Checkpoint file %s is too short\n", path);
+          error = TRUE;
         }
-      
-      z_old = z_new;
-      iteration_count++;
     }
-  while (fabs(iteration_difference) > convergence_tolerance && iteration_count < iteration_limit);
 
-  if (iteration_count >= iteration_limit)
+  if (!error)
     {
-      fprintf(stderr, "WARNING: No convergence in GA_drydepth.\n");
-      z_new = Ks * dt / porosity + Geff * log(1.0 + Ks * dt / (porosity * Geff));
+      *size = file_stat.st_size;
+      *data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+      if (MAP_FAILED == *data)
+        {
+          fprintf(stderr, "ERROR: Could not memory map checkpoint file %s\n", path);
+          error = TRUE;
+        }
+      else
+        {
+          madvise((void*)*data, *size, MADV_SEQUENTIAL);
+        }
     }
-  else if (z_new < minimum_dry_depth)
+
+  if (-1 != fd)
     {
-      z_new = minimum_dry_depth;
+      close(fd);
     }
 
-  return z_new;
-}
-
-/* There are numerical problems calculating the distance that water will
- * infiltrate into a bin that has little or no surface front water.
- * This function is used instead in that case.
- * Dry depth of each bin is calculated according to Han's method.
- * Dry depth is the solution z of following equation:
- * K * dt + psi * delth * ln (1 + z / psi ) - z * delth = 0
- * K     = conductivity [m/s]
- * dt    = time step    [second]
- * delth = delta water content [-]
- * psi   = bin capillary suction [m]
- * z     = dry depth [m]
- * Netwon-Raphson iteration is used for the solution.
- * F(z)_prime = delth / (1 + z / psi) - delth
- */
-double t_o_find_dry_depth(t_o_parameters* parameters, int bin, double dt)
-{
-  double dry_depth;                      // Meters
-  double minimum_dry_depth = 1.0e-4;     // Meters.
-  double maximum_dry_depth;              // Meters.
-  double convergence_tolerance = 1.0e-6; // Meters.
-  double iteration_difference;           // Meters.
-  double z_old;                          // Meters.
-  double z_new;                          // Meters.
-  double f;
-  double f_prime;
-  int    iteration_count = 0;
-  int    iteration_limit = 10000;        // maximum number of iterations before giving up.
-
-  assert(NULL != parameters && 0 < bin && bin <= parameters->num_bins && 0.0 < dt);
-
-  z_old = parameters->cumulative_conductivity[bin] * dt;
-
-  do
+  if (!error)
     {
-      f       = (parameters->cumulative_conductivity[bin] * dt) + (parameters->bin_capillary_suction[bin] * parameters->delta_water_content *
-          log(1.0 + (z_old / parameters->bin_capillary_suction[bin]))) - (z_old * parameters->delta_water_content);
-      f_prime = (parameters->delta_water_content / (1.0 + (z_old / parameters->bin_capillary_suction[bin]))) - parameters->delta_water_content;
+      memcpy(&header, *data, sizeof(checkpoint_header));
 
-      if (0.0 == f_prime)
+      if (0 != memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)))
         {
-          // Prevent divide by zero.
-          z_new = minimum_dry_depth;
-          iteration_difference = 0.0;
+          fprintf(stderr, "ERROR: %s is not a checkpoint file\n", path);
+          error = TRUE;
+        }
+      else if (CHECKPOINT_VERSION != header.version)
+        {
+          fprintf(stderr, "ERROR: Checkpoint file %s is version %d.  Only version %d is supported\n", path, header.version, CHECKPOINT_VERSION);
+          error = TRUE;
+        }
+      else if (CHECKPOINT_BYTE_ORDER != header.byte_order)
+        {
+          fprintf(stderr, "ERROR: Checkpoint file %s was written on a machine with a different byte order\n", path);
+          error = TRUE;
+        }
+      else if (1 > header.num_domains || INT32_MAX < header.num_domains ||
+               *size < sizeof(checkpoint_header) + header.num_domains * sizeof(int64_t))
+        {
+          fprintf(stderr, "ERROR: Checkpoint file %s is corrupt\n", path);
+          error = TRUE;
         }
       else
         {
-          z_new = z_old - (f / f_prime);
-          iteration_difference = z_new - z_old;
+          *num_domains = header.num_domains;
         }
-
-      z_old = z_new;
-      iteration_count++;
     }
-  while (fabs(iteration_difference) > convergence_tolerance && iteration_count < iteration_limit);
-
-  // FIXME, later. If Brooks_Corey,maximum_dry_depth = GA_dry_depth is fine, but if using van_Genutchen, maximum_dry_depth = 10 * GA_dry_depth.
-  // Since there is no Flag to indicate what parameters is used, just time 10.
-  maximum_dry_depth = 10 * GA_drydepth(parameters->cumulative_conductivity[parameters->num_bins], 
-                                  parameters->bin_water_content[parameters->num_bins],
-                                  parameters->effective_capillary_suction, dt);
 
-  if (iteration_count >= iteration_limit)
-    {
-      fprintf(stderr, "WARNING: No convergence in t_o_find_dry_depth in bin %d.  Using a value of %le meters\n", bin, minimum_dry_depth);
-      dry_depth = minimum_dry_depth;
-    }
-  else if (z_new < minimum_dry_depth)
-    {
-      dry_depth = minimum_dry_depth;
-    }
-  else if (z_new > maximum_dry_depth)
-    {
-      dry_depth = maximum_dry_depth;
-    }
-  else
+  if (error && MAP_FAILED != *data)
     {
-      dry_depth = z_new;
+      munmap((void*)*data, *size);
+      *data = MAP_FAILED;
     }
-  
-  return dry_depth;
+
+  return error;
 }
 
-/* Calculate the distance in meters that water will infiltrate into all of the
- * bins in one timestep.
- *
- * Parameters:
- *
- * domain            - A pointer to the t_o_domain struct.
- * dt                - The duration of the timestep in seconds.
- * first_bin         - The leftmost bin that is not completely full of water.
- * surfacewater_head - The pressure head in meters of the surface water.
- * distance          - A 1D array sized to hold domain->parameters->num_bins
- *                     elements with one based indexing.  distance[ii] is
- *                     filled in with the distance that water will infiltrate
- *                     into bin ii this timestep.
- */
-void infiltrate_distance(t_o_domain* domain, double dt, int first_bin, double surfacewater_head, double* distance)
+/* Comment in .h file. */
+int t_o_checkpoint_num_domains(const char* path, int* num_domains)
 {
-  assert(NULL != domain && 0.0 < dt && NULL != distance);
+  int                  error; // Error flag.
+  const unsigned char* data;
+  size_t               size;
 
-  int ii;                               // Loop counter.
-  int last_bin = find_last_bin(domain); // The rightmost bin that has surface front water.
-  
-  while (last_bin >= first_bin && 0 >= domain->parameters->bin_capillary_suction[last_bin] + surfacewater_head)
+  assert(NULL != num_domains);
+
+  error = checkpoint_map(path, &data, &size, num_domains);
+
+  if (!error)
     {
-      last_bin--;
+      munmap((void*)data, size);
     }
 
-  // There are numerical problems calculating the distance that water will
-  // infiltrate into a bin that has little or no surface front water.
-  // In this case a different calculation called dry depth is used to
-  // figure out the infiltration distance. The dry depth should be used
-  // any time the surface front is less than the dry depth.  So you need
-  // to know the dry depth to know if you need to use the dry depth.
-  // Calculating dry depths is somewhat expensive so we have developed
-  // a caching scheme to improve performance.
-  //
-  // Inside the t_o_parameters structure we cache the dry depth of every bin
-  // for a particular timestep duration.  If the current timestep is equal to
-  // the cached timestep we just use those values.  If the current timestep is
-  // greater than the cached timestep we update the cached dry depths at the
-  // larger timestep and then use those values.  If the current timestep is
-  // less than the cached timestep we do not update the cached values.
-  // Instead, we use the cached values as upper bounds to exclude some bins
-  // that don't need to use dry depth and calculate the exact dry depth for
-  // bins that we cannot exclude with the upper bound.  This will result in
-  // values being cached for the largest timestep ever used in the simulation,
-  // which is an upper bound for all other timesteps.
-#ifdef THREAD_SAFE
-  pthread_mutex_lock(&domain->parameters->dry_depth_mutex);
-#endif // THREAD_SAFE
-  
-  if (domain->parameters->dry_depth_dt < dt)
-    {
-      domain->parameters->dry_depth_dt = dt;
+  return error;
+}
 
-      for (ii = 1; ii <= domain->parameters->num_bins; ii++)
+/* Comment in .h file. */
+int t_o_domain_restore(t_o_domain** domains, int num_domains, t_o_parameters** parameters, const char* path)
+{
+  int                      error = FALSE;      // Error flag.
+  int                      ii, jj, kk;         // Loop counters.
+  const unsigned char*     data  = MAP_FAILED; // The memory mapping of the file.
+  size_t                   size  = 0;          // The number of bytes in data.
+  int                      file_num_domains;   // The number of domains in the file.
+  int64_t                  offset;             // Byte offset of a domain.
+  int64_t                  slug_index;         // Index in slug_depth of the next slug.
+  int64_t                  total_slugs;        // The sum of bin_num_slugs.
+  checkpoint_domain_header domain_header;
+  const double*            surface_front;
+  const double*            groundwater_front;
+  const int64_t*           bin_num_slugs;
+  const double*            slug_depth;         // The top and bot of each slug.
+  slug*                    new_slugs;          // The slug structs still to be linked in to the domain.
+  slug*                    temp_slug;
+  slug*                    prev_slug;
+
+  if (NULL == domains || NULL == parameters || 1 > num_domains)
+    {
+      fprintf(stderr, "ERROR: domains and parameters must not be NULL and num_domains must be greater than or equal to one\n");
+      error = TRUE;
+    }
+  else
+    {
+      for (kk = 0; kk < num_domains; kk++)
         {
-          domain->parameters->bin_dry_depth[ii] = t_o_find_dry_depth(domain->parameters, ii, dt);
+          domains[kk] = NULL; // Prevent deallocating a random pointer.
+
+          if (NULL == parameters[kk])
+            {
+              fprintf(stderr, "ERROR: parameters[%d] must not be NULL\n", kk);
+              error = TRUE;
+            }
         }
     }
 
-  assert(domain->parameters->dry_depth_dt >= dt);
+  if (!error)
+    {
+      error = checkpoint_map(path, &data, &size, &file_num_domains);
+    }
 
-#ifdef THREAD_SAFE
-  pthread_mutex_unlock(&domain->parameters->dry_depth_mutex);
-#endif // THREAD_SAFE
-  
-  for (ii = first_bin; ii <= domain->parameters->num_bins; ii++)
+  if (!error && num_domains != file_num_domains)
+    {
+      fprintf(stderr, "ERROR: Checkpoint file %s has %d domains, not %d\n", path, file_num_domains, num_domains);
+      error = TRUE;
+    }
+
+  for (kk = 0; !error && kk < num_domains; kk++)
     {
-      double dry_depth;
+      // Find the domain and check that it fits in the file.
+      memcpy(&offset, data + sizeof(checkpoint_header) + kk * sizeof(int64_t), sizeof(int64_t));
 
-#ifdef THREAD_SAFE
-      pthread_mutex_lock(&domain->parameters->dry_depth_mutex);
-#endif // THREAD_SAFE
-  
-      if (domain->parameters->dry_depth_dt > dt && domain->parameters->bin_dry_depth[ii] + domain->layer_top_depth >= domain->surface_front[ii])
+      if (0 > offset || 0 != offset % sizeof(int64_t) || size < (size_t)offset + sizeof(checkpoint_domain_header))
         {
-#ifdef THREAD_SAFE
-          pthread_mutex_unlock(&domain->parameters->dry_depth_mutex); // Unlock before calling to reduce contention.
-#endif // THREAD_SAFE
-          
-          // Cannot exclude bin based on upper bound.  Must calculate exact dry depth.
-          dry_depth = t_o_find_dry_depth(domain->parameters, ii, dt);
+          error = TRUE;
         }
       else
         {
-          dry_depth = domain->parameters->bin_dry_depth[ii];
+          memcpy(&domain_header, data + offset, sizeof(checkpoint_domain_header));
 
-#ifdef THREAD_SAFE
-  pthread_mutex_unlock(&domain->parameters->dry_depth_mutex);
-#endif // THREAD_SAFE
+          error = 1 > domain_header.num_bins || INT32_MAX < domain_header.num_bins || 0 > domain_header.num_slugs ||
+              T_O_INTEGRATOR_EULER > domain_header.integrator || T_O_INTEGRATOR_GREEN_AMPT < domain_header.integrator ||
+              (size - offset - sizeof(checkpoint_domain_header)) / (2 * sizeof(double)) < (size_t)(domain_header.num_bins + domain_header.num_slugs) ||
+              size - offset < checkpoint_domain_size(domain_header.num_bins, domain_header.yes_groundwater, domain_header.num_slugs);
         }
 
-      if (0 >= domain->parameters->bin_capillary_suction[ii] + surfacewater_head)
+      if (error)
         {
-          // If the surfacewater head has more suction than the bin capillarity set the distance to zero.
-          distance[ii] = 0.0;
+          fprintf(stderr, "ERROR: Checkpoint file %s is corrupt\n", path);
         }
-      else if (dry_depth + domain->layer_top_depth >= domain->surface_front[ii])
+      else if (domain_header.num_bins != parameters[kk]->num_bins || domain_header.parameters_hash != checkpoint_parameters_hash(parameters[kk]))
         {
-          // If there is downward infiltration and surface_front is less than dry_depth set distance to dry_depth.
-          distance[ii] = dry_depth;
+          fprintf(stderr, "ERROR: Domain %d in checkpoint file %s was saved with different parameters than parameters[%d]\n", kk, path, kk);
+          error = TRUE;
         }
-      else
+
+      if (!error)
         {
-          // Clip capillary suction with effective capillary suction.
-          double last_bin_capillary_suction = domain->parameters->bin_capillary_suction[last_bin];
+          // The arrays are eight byte aligned in the file and the mapping is page aligned so they can be used in place.
+          surface_front     = (const double*)(data + offset + sizeof(checkpoint_domain_header));
+          groundwater_front = domain_header.yes_groundwater ? surface_front + domain_header.num_bins : NULL;
+          bin_num_slugs     = (const int64_t*)(surface_front + (domain_header.yes_groundwater ? 2 : 1) * domain_header.num_bins);
+          slug_depth        = (const double*)(bin_num_slugs + domain_header.num_bins);
 
-          if (last_bin_capillary_suction < domain->parameters->effective_capillary_suction)
+          for (total_slugs = 0, ii = 0; !error && ii < domain_header.num_bins; ii++)
             {
-              last_bin_capillary_suction = domain->parameters->effective_capillary_suction;
+              error        = 0 > bin_num_slugs[ii] || domain_header.num_slugs - total_slugs < bin_num_slugs[ii];
+              total_slugs += bin_num_slugs[ii];
             }
 
-          // If last_bin is equal to first_bin - 1 then all bins will be set to zero or dry_depth and this equation will not be evaluated.
-          distance[ii] = ((domain->parameters->cumulative_conductivity[last_bin] - domain->parameters->cumulative_conductivity[first_bin - 1]) /
-              (domain->parameters->bin_water_content[last_bin] - domain->parameters->bin_water_content[first_bin - 1])) *
-              ((last_bin_capillary_suction + surfacewater_head) / domain->surface_front[ii] + 1) * dt;
-          
-          // Runge-Kutta 4 implementation.
-          /*
-          double k1, k2, k3, k4, k0;
-          k0 = ((domain->parameters->cumulative_conductivity[last_bin] - domain->parameters->cumulative_conductivity[first_bin - 1]) /
-              (domain->parameters->bin_water_content[last_bin] - domain->parameters->bin_water_content[first_bin - 1]));
-          k1 = k0 * ((last_bin_capillary_suction + surfacewater_head) /  domain->surface_front[ii] + 1.0) * dt;
-          k2 = k0 * ((last_bin_capillary_suction + surfacewater_head) / (domain->surface_front[ii] + 0.5 * k1) + 1.0) * dt;
-          k3 = k0 * ((last_bin_capillary_suction + surfacewater_head) / (domain->surface_front[ii] + 0.5 * k2) + 1.0) * dt;
-          k4 = k0 * ((last_bin_capillary_suction + surfacewater_head) / (domain->surface_front[ii] + k3) + 1.0) * dt;
-          distance[ii] = (k1 + 2.0 * k2 + 2.0 * k3 + k4) / 6.0;
-          */
-          
-          // 1-GARTO type.
-          /*distance[ii] = (domain->parameters->cumulative_conductivity[ii] - domain->parameters->cumulative_conductivity[ii - 1]) /
-              (domain->parameters->delta_water_content) *
-              ((last_bin_capillary_suction + surfacewater_head) / domain->surface_front[ii] + 1) * dt;
-          */
-          /*
-          // 2-exact k'
-          double saturation  = (domain->parameters->bin_water_content[ii] - 
-                                  (domain->parameters->bin_water_content[1] - domain->parameters->delta_water_content)) /
-                                (domain->parameters->bin_water_content[domain->parameters->num_bins] - 
-                                  (domain->parameters->bin_water_content[1] - domain->parameters->delta_water_content)); 
-              
-          distance[ii] = domain->parameters->cumulative_conductivity[domain->parameters->num_bins] * (3.0 + 2.0 / domain->parameters->bc_lambda) * 
-                         pow(saturation, 2.0 + 2.0 / domain->parameters->bc_lambda) / (domain->parameters->bin_water_content[domain->parameters->num_bins] - 
-                                  (domain->parameters->bin_water_content[1] - domain->parameters->delta_water_content)) * 
-                           ((last_bin_capillary_suction + surfacewater_head) / domain->surface_front[ii] + 1) * dt;
-            */  
-        } // End if (dry_depth >= domain->surface_front[ii]).
-    } // End for (ii = first_bin; ii <= domain->parameters->num_bins; ii++).
-}
+          if (error || total_slugs != domain_header.num_slugs)
+            {
+              fprintf(stderr, "ERROR: Checkpoint file %s is corrupt\n", path);
+              error = TRUE;
+            }
+        }
 
-/* Process infiltration into not completely saturated bins.
- * Return TRUE if there is an error, FALSE otherwise.
- * Actually always returns FALSE.  No conditions generate an error.
- * This function takes water from the surface and then from surface front
- * water in bins to the right if there is not enough surface water.
- * If domain->yes_groundwater is FALSE then surface front water might
- * fall out the bottom of the domain.  This water is accounted for in
- * groundwater_recharge
- *
- * Parameters:
- *
- * domain               - A pointer to the t_o_domain struct.
- * dt                   - The duration of the timestep in seconds.
- * first_bin            - A scalar passed by reference containing the leftmost
- *                        bin that is not completely full of water.  Will be
- *                        updated to the new value after infiltration.
- * surfacewater_head    - The pressure head in meters of the surface water.
- *                        Normally, you will pass the same value as
- *                        surfacewater_depth, but this can be used to simulate
- *                        various laboratory test conditions.
- * surfacewater_depth   - A scalar passed by reference containing the depth
- *                        in meters of the surface water.  Will be updated for
- *                        the amount of infiltration.
- * groundwater_recharge - A scalar passed by reference containing any
- *                        previously accumulated groundwater recharge in meters
- *                        of water.  Will be updated for the amount of water
- *                        that flowed between the Talbot-Ogden domain and
- *                        groundwater.  Positive means water flowed down out of
- *                        the Talbot-Ogden domain.  Negative means water flowed
- *                        up in to the Talbot-Ogden domain.
- * ponded_water         - If ponded water is TRUE infiltrate even if
- *                        surfacewater_depth is zero.
- */
-int t_o_infiltrate(t_o_domain* domain, double dt, int* first_bin, double surfacewater_head, double* surfacewater_depth, double* groundwater_recharge, 
-                   int ponded_water)
-{
-  int error = FALSE; // Error flag.
-  int ii;            // Loop counter.
+      if (!error)
+        {
+          error = t_o_domain_alloc(&domains[kk], parameters[kk], domain_header.layer_top_depth, domain_header.layer_bottom_depth,
+                                   domain_header.yes_groundwater, domain_header.initial_water_content, FALSE, 0.0);
+        }
 
-  assert(NULL != domain && 0.0 < dt && NULL != surfacewater_depth && 0.0 <= *surfacewater_depth && NULL != groundwater_recharge);
+      if (!error)
+        {
+          domains[kk]->initial_water_content = domain_header.initial_water_content;
+          domains[kk]->integrator            = (int)domain_header.integrator;
 
-  if (0.0 < *surfacewater_depth || ponded_water)
-    {
-      double delta_z[domain->parameters->num_bins + 1]; // The distance that water can infiltrate into each bin this timestep.
+          memcpy(&domains[kk]->surface_front[1], surface_front, domain_header.num_bins * sizeof(double));
 
-      // Calculate the depth that water can infiltrate into each bin.
-      infiltrate_distance(domain, dt, *first_bin, surfacewater_head, delta_z);
+          if (domain_header.yes_groundwater)
+            {
+              memcpy(&domains[kk]->groundwater_front[1], groundwater_front, domain_header.num_bins * sizeof(double));
+            }
 
-      // All bins to the left of firstbin have already had their demand satisfied by satisfy_saturated_bins so start processing at first_bin.
-      for (ii = *first_bin; ii <= domain->parameters->num_bins; ii++)
-        {
-          double supplied_z = 0.0; // Depth actually infiltrated.
+          // Get all of the slug structs at once and link them into the bins in order.
+          error = slug_alloc_chain(&new_slugs, domain_header.num_slugs);
+        }
 
-          // Infiltration might be limited by the surface water hitting a slug or groundwater.
-          int hit_slug        = FALSE;
-          int hit_groundwater = FALSE;
+      if (!error)
+        {
+          slug_index = 0;
 
-          if (NULL != domain->top_slug[ii])
+          for (ii = 1; ii <= domain_header.num_bins; ii++)
             {
-              double gap = (domain->top_slug[ii]->top - domain->surface_front[ii]);
+              prev_slug = NULL;
 
-              if (delta_z[ii] >= gap)
+              for (jj = 0; jj < bin_num_slugs[ii - 1]; jj++)
                 {
-                  delta_z[ii]  = gap;
-                  hit_slug     = TRUE;
-                }
-            }
-          else if (domain->yes_groundwater)
-            {
-              double gap = (domain->groundwater_front[ii] - domain->surface_front[ii]);
+                  temp_slug       = new_slugs;
+                  new_slugs       = new_slugs->next;
+                  temp_slug->prev = prev_slug;
+                  temp_slug->next = NULL;
+                  temp_slug->top  = slug_depth[slug_index++];
+                  temp_slug->bot  = slug_depth[slug_index++];
+
+                  if (NULL == prev_slug)
+                    {
+                      domains[kk]->top_slug[ii] = temp_slug;
+                    }
+                  else
+                    {
+                      prev_slug->next = temp_slug;
+                    }
 
-              if (delta_z[ii] >= gap)
-                {
-                  delta_z[ii]  = gap;
-                  hit_groundwater = TRUE;
+                  prev_slug = temp_slug;
                 }
-            }
 
-          // Satisfy as much of the demand as possible from surface water.
-          if (*surfacewater_depth >= delta_z[ii] * domain->parameters->delta_water_content)
-            {
-              *surfacewater_depth -= delta_z[ii] * domain->parameters->delta_water_content;
-              supplied_z          += delta_z[ii];
-              delta_z[ii]          = 0.0;
-            }
-          else if (0.0 < *surfacewater_depth)
-            {
-              supplied_z          += *surfacewater_depth / domain->parameters->delta_water_content;
-              delta_z[ii]         -= *surfacewater_depth / domain->parameters->delta_water_content;
-              *surfacewater_depth  = 0.0;
+              domains[kk]->bot_slug[ii] = prev_slug;
             }
 
-          // Satisfy the rest of the demand from the rightmost bin that has surface front water.
-
-          int get_bin = domain->parameters->num_bins; // The bin to get water from.
+          assert(NULL == new_slugs);
 
-          while (0.0 < delta_z[ii] && get_bin > ii)
+          for (ii = 1; !error && ii <= domain_header.num_bins; ii++)
             {
-              if (domain->surface_front[get_bin] - domain->layer_top_depth >= delta_z[ii])
-                {
-                  // The bin has enough to completely satisfy remaining demand.
-                  domain->surface_front[get_bin] -= delta_z[ii];
-                  supplied_z                     += delta_z[ii];
-                  delta_z[ii]                     = 0.0;
-                }
-              else
-                {
-                  // Get everything the bin has, if any, and go on to the next bin.
-                  if (0.0 < domain->surface_front[get_bin] - domain->layer_top_depth)
-                    {   
-                      supplied_z                     += domain->surface_front[get_bin] - domain->layer_top_depth;
-                      delta_z[ii]                    -= domain->surface_front[get_bin] - domain->layer_top_depth;
-                      domain->surface_front[get_bin]  = domain->layer_top_depth;
-                    }
-                 
-                  get_bin--;
-                }
+              error = slug_span_rebuild(domains[kk], ii);
             }
+        }
 
-          // Add the water to the surface front water in this bin.
-          if (hit_slug && 0.0 == delta_z[ii])
-            {
-              // Surface water reaches the top slug.
-              domain->surface_front[ii] = domain->top_slug[ii]->bot;
-              kill_slug(domain, ii, domain->top_slug[ii]);
-            }
-          else if (hit_groundwater && 0.0 == delta_z[ii])
-            {
-              // Surface water reaches groundwater.
-              domain->surface_front[ii]     = domain->layer_top_depth;
-              domain->groundwater_front[ii] = domain->layer_top_depth;
-            }
-          else if (domain->surface_front[ii] + supplied_z > domain->layer_bottom_depth)
-            {
-              // Surface water reaches the bottom of the domain.
-              *groundwater_recharge += (domain->surface_front[ii] + supplied_z - domain->layer_bottom_depth) * domain->parameters->delta_water_content;
-              domain->surface_front[ii] = domain->layer_bottom_depth;
-            }
-          else
+      if (!error)
+        {
+          mark_all_dirty(domains[kk]);
+          t_o_check_invariant(domains[kk]);
+        }
+    }
+
+  if (MAP_FAILED != data)
+    {
+      munmap((void*)data, size);
+    }
+
+  if (error && NULL != domains && NULL != parameters)
+    {
+      for (kk = 0; kk < num_domains; kk++)
+        {
+          if (NULL != domains[kk])
             {
-              // Advance surface_front.
-              domain->surface_front[ii] += supplied_z;
+              t_o_domain_dealloc(&domains[kk]);
             }
-        } // End loop over all bins starting at first_bin
-      
-      // first_bin can only change if there was infiltration, and it can only move to the right.
-      *first_bin = find_first_bin(domain, *first_bin);
-    } // End if (0.0 < *surfacewater_depth)
+        }
+    }
 
   return error;
 }
 
-/* Calculate the distance in meters that a slug will move in one timestep.
- * This distance can be different for the top and bottom of the slug.
- * Rather than returning one value it uses two output parameters.
+#ifdef SLUG_SPANS
+/* Free the arrays of a slug_span if it spilled and set it back to its inline
+ * arrays with no slugs.
  *
  * Parameters:
  *
- * domain       - A pointer to the t_o_domain struct.
- * bin          - Which bin falling_slug is in.
- * first_bin    - The leftmost bin that is not completely full of water.
- * dt           - The duration of the timestep in seconds.
- * falling_slug - Which slug to determine the distance for.
- * top_distance - A scalar passed by reference that gets set to the distance
- *                in meters that the top of the slug will move.
- *                Positive means down toward the bottom of the domain.
- * bot_distance - A scalar passed by reference that gets set to the distance
- *                in meters that the bottom of the slug will move.
- *                Positive means down toward the bottom of the domain.
+ * span - A pointer to the slug_span struct.
  */
-void slug_fall_distance(t_o_domain* domain, int bin, int first_bin, double dt, slug* falling_slug, double* top_distance, double* bot_distance)
+void slug_span_release(slug_span* span)
 {
-  int   ii;        // Loop counter.
-  slug* temp_slug; // Used to search for connected slugs.
+  if (span->inline_top != span->top)
+    {
+      v_dealloc((void**)&span->top, span->capacity * sizeof(double));
+      v_dealloc((void**)&span->bot, span->capacity * sizeof(double));
+    }
 
-  assert(NULL != domain && 0 < bin && bin <= domain->parameters->num_bins && 0 < first_bin && first_bin <= domain->parameters->num_bins &&
-      0.0 < dt && NULL != falling_slug && NULL != top_distance && NULL != bot_distance);
+  span->num_slugs = 0;
+  span->capacity  = SLUG_SPAN_INLINE_CAPACITY;
+  span->top       = span->inline_top;
+  span->bot       = span->inline_bot;
+}
 
-  // find the capillary suction of the rightmost bin with a connected slug that this slug can steal water from.
-  ii = domain->parameters->num_bins;
+/* Make room in a slug_span for at least num_slugs slugs.  A span that
+ * outgrows its arrays spills to allocated arrays of at least twice the size.
+ * Return TRUE if there is an error, FALSE otherwise.
+ * If there is an error the span is unchanged.
+ *
+ * Parameters:
+ *
+ * span      - A pointer to the slug_span struct.
+ * num_slugs - The number of slugs the span must be able to hold.
+ */
+int slug_span_reserve(slug_span* span, int num_slugs)
+{
+  int     error    = FALSE;          // Error flag.
+  int     capacity = span->capacity; // The new number of elements of top and bot.
+  double* new_top;
+  double* new_bot;
 
-  do
+  if (capacity < num_slugs)
     {
-      temp_slug = domain->top_slug[ii];
+      while (capacity < num_slugs)
+        {
+          capacity *= 2;
+        }
 
-      while (NULL != temp_slug && !(falling_slug->top <= temp_slug->bot && falling_slug->bot >= temp_slug->top))
+      error = v_alloc((void**)&new_top, capacity * sizeof(double));
+
+      if (!error)
         {
-          if (falling_slug->bot < temp_slug->top)
-            {
-              temp_slug = NULL;
-            }
-          else
+          error = v_alloc((void**)&new_bot, capacity * sizeof(double));
+
+          if (error)
             {
-              temp_slug = temp_slug->next;
+              v_dealloc((void**)&new_top, capacity * sizeof(double));
             }
         }
 
-      if (NULL == temp_slug)
+      if (!error)
         {
-          ii--;
-        }
-    }
-  while (ii > bin && NULL == temp_slug);
+          memcpy(new_top, span->top, span->num_slugs * sizeof(double));
+          memcpy(new_bot, span->bot, span->num_slugs * sizeof(double));
 
-  double distance = ((domain->parameters->cumulative_conductivity[bin] - domain->parameters->cumulative_conductivity[bin - 1]) /
-      domain->parameters->delta_water_content) * dt;
-
-  double growth;
+          if (span->inline_top != span->top)
+            {
+              v_dealloc((void**)&span->top, span->capacity * sizeof(double));
+              v_dealloc((void**)&span->bot, span->capacity * sizeof(double));
+            }
 
-  if (ii <= bin)
-    {
-      growth = 0.0;
-    }
-  else
-    {
-      growth = ((domain->parameters->cumulative_conductivity[bin] - domain->parameters->cumulative_conductivity[first_bin - 1]) /
-          (domain->parameters->bin_water_content[bin] - domain->parameters->bin_water_content[first_bin - 1])) *
-              ((domain->parameters->bin_capillary_suction[bin] - domain->parameters->bin_capillary_suction[ii]) /
-                  ((falling_slug->bot - falling_slug->top) / 2.0)) * dt;
+          span->capacity = capacity;
+          span->top      = new_top;
+          span->bot      = new_bot;
+        }
     }
 
-  *top_distance = distance - growth;
-  *bot_distance = distance + growth;
+  return error;
 }
 
-/* Process the falling slugs step of the simulation.
+/* Add a slug that was just linked into the list of a bin to the span of the
+ * bin at the same position.
  * Return TRUE if there is an error, FALSE otherwise.
- * Actually always return FALSE.  No conditions generate an error.
- * If domain->groundwater_yes is FALSE then slugs might fall out the bottom of
- * the domain.  This water is accounted for in groundwater_recharge
+ * If there is an error the span is unchanged.
  *
  * Parameters:
  *
- * domain               - A pointer to the t_o_domain struct.
- * dt                   - The duration of the timestep in seconds.
- * first_bin            - The leftmost bin that is not completely full of
- *                        water.
- * groundwater_recharge - A scalar passed by reference containing any
- *                        previously accumulated groundwater recharge in meters
- *                        of water.  Will be updated for the amount of water
- *                        that flowed between the Talbot-Ogden domain and
- *                        groundwater.  Positive means water flowed down out of
- *                        the Talbot-Ogden domain.  Negative means water flowed
- *                        up in to the Talbot-Ogden domain.
+ * domain   - A pointer to the t_o_domain struct.
+ * bin      - Which bin the slug was linked into.  One based indexing is used.
+ * new_slug - The slug that was linked.
  */
-int t_o_falling_slugs(t_o_domain* domain, double dt, int first_bin, double* groundwater_recharge)
+int slug_span_insert(t_o_domain* domain, int bin, slug* new_slug)
 {
-  assert(NULL != domain && 0.0 < dt && NULL != groundwater_recharge);
+  int        error = FALSE;                                                          // Error flag.
+  slug_span* span  = &domain->slug_spans[bin];
+  int        index = (NULL == new_slug->prev) ? 0 : new_slug->prev->span_index + 1; // Where the slug goes in the span.
+  slug*      temp_slug;
 
-  int error = FALSE; // Error flag.
-  int ii;            // Loop counter.
+  error = slug_span_reserve(span, span->num_slugs + 1);
 
-  // Process all bins except bin 1, which is guaranteed to be completely full of water and thus have no slugs.
-  for (ii = 2; ii <= domain->parameters->num_bins; ii++)
+  if (!error)
     {
-      // Process the slugs from bottom up.
-      slug* temp_slug = domain->bot_slug[ii];
+      memmove(&span->top[index + 1], &span->top[index], (span->num_slugs - index) * sizeof(double));
+      memmove(&span->bot[index + 1], &span->bot[index], (span->num_slugs - index) * sizeof(double));
 
-      while (NULL != temp_slug)
+      span->top[index]     = new_slug->top;
+      span->bot[index]     = new_slug->bot;
+      new_slug->span_index = index;
+      span->num_slugs++;
+
+      for (temp_slug = new_slug->next; NULL != temp_slug; temp_slug = temp_slug->next)
         {
-          double top_delta_z; // The distance the top    of the slug will move.
-          double bot_delta_z; // The distance the bottom of the slug will move.
+          temp_slug->span_index++;
+        }
+    }
 
-          // Calculate the distance the slug will move this timestep.
-          slug_fall_distance(domain, ii, first_bin, dt, temp_slug, &top_delta_z, &bot_delta_z);
+  return error;
+}
 
-          // FIXME deal with this
-          // Prevent the slug from moving upward.
-          if (0.0 >= top_delta_z)
-            {
-              top_delta_z = 0.000001;
-            }
+/* Remove a slug that is about to be unlinked from the list of a bin from the
+ * span of the bin.
+ *
+ * Parameters:
+ *
+ * domain   - A pointer to the t_o_domain struct.
+ * bin      - Which bin the slug is in.  One based indexing is used.
+ * old_slug - The slug to remove.
+ */
+void slug_span_remove(t_o_domain* domain, int bin, slug* old_slug)
+{
+  slug_span* span  = &domain->slug_spans[bin];
+  int        index = old_slug->span_index; // Where the slug is in the span.
+  slug*      temp_slug;
 
-          if (0.0 >= bot_delta_z)
-            {
-              bot_delta_z = 0.000001;
-            }
-
-          // Stop the slug if it hits a lower slug or groundwater.
-          if (NULL != temp_slug->next)
-            {
-              if (bot_delta_z > temp_slug->next->top - temp_slug->bot)
-                {
-                  bot_delta_z = temp_slug->next->top - temp_slug->bot;
-                }
-            }
-          else if (domain->yes_groundwater)
-            {
-              if (bot_delta_z > domain->groundwater_front[ii] - temp_slug->bot)
-                {
-                  bot_delta_z = domain->groundwater_front[ii] - temp_slug->bot;
-                }
-            }
-
-          // Prevent the slug from shrinking.
-          if (top_delta_z > bot_delta_z)
-            {
-              top_delta_z = bot_delta_z;
-            }
-
-          // If the slug grows, steal the water from the rightmost overlapping slug, and the topmost if there are multiple rightmost.
-          // FIXME steal from all connected slugs to the right with weights.
-          double demand   = bot_delta_z - top_delta_z;    // Needed water in meters of bin depth.
-          int    get_bin  = domain->parameters->num_bins; // Which bin  to try to get from.
-          slug*  get_slug = domain->top_slug[get_bin];    // Which slug to try to get from.
-
-          while (0.0 < demand && ii < get_bin)
-            {
-              while (0.0 < demand && NULL != get_slug && temp_slug->bot >= get_slug->top)
-                {
-                  // Save a pointer to the slug below get_slug in case we need to kill get_slug.
-                  slug* next_slug = get_slug->next;
-
-                  if (temp_slug->top <= get_slug->bot && temp_slug->bot >= get_slug->top)
-                    {
-                      // We can get water from get_slug.
-                      if (get_slug->bot - get_slug->top >= demand)
-                        {
-                          // FIXLATER more complicated than taking equally from top and bot?
-                          get_slug->top += demand / 2.0;
-                          get_slug->bot -= demand / 2.0;
-                          demand = 0.0;
-                        }
-                      else
-                        {
-                          demand -= get_slug->bot - get_slug->top;
-                          kill_slug(domain, get_bin, get_slug);
-                        }
-                    }
+  assert(0 <= index && index < span->num_slugs && span->top[index] == old_slug->top && span->bot[index] == old_slug->bot);
 
-                  get_slug = next_slug;
-                }
+  memmove(&span->top[index], &span->top[index + 1], (span->num_slugs - index - 1) * sizeof(double));
+  memmove(&span->bot[index], &span->bot[index + 1], (span->num_slugs - index - 1) * sizeof(double));
 
-              get_bin--;
-              get_slug = domain->top_slug[get_bin];
-            }
+  old_slug->span_index = -1;
+  span->num_slugs--;
 
-          // If we couldn't get all of the desired water take the deficit equally from the top and bottom of where the slug wants to be.
-          // FIXLATER more complicated than taking equally from top and bot?
-          if (0.0 < demand)
-            {
-              top_delta_z += demand / 2.0;
-              bot_delta_z -= demand / 2.0;
-            }
+  for (temp_slug = old_slug->next; NULL != temp_slug; temp_slug = temp_slug->next)
+    {
+      temp_slug->span_index--;
+    }
+}
 
-          // Save a pointer to the slug above temp_slug in case we need to kill temp_slug.
-          slug* prev_slug = temp_slug->prev;
+/* Return TRUE if the span of every bin has the same slugs in the same order
+ * as its linked list, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * domain - A pointer to the t_o_domain struct.
+ */
+int slug_spans_match_lists(t_o_domain* domain)
+{
+  int   match = TRUE; // The return value.
+  int   ii, jj;       // Loop counters.
+  slug* temp_slug;
 
-          if (NULL == temp_slug->next)
-            {
-              // The bottom slug might hit the groundwater or fall beyond layer_depth.
-              if (domain->yes_groundwater)
-                {
-                  if (temp_slug->bot + bot_delta_z >= domain->groundwater_front[ii])
-                    {
-                      // The slug hits groundwater.
-                      domain->groundwater_front[ii] -= (temp_slug->bot + bot_delta_z) - (temp_slug->top + top_delta_z);
-                      kill_slug(domain, ii, temp_slug);
-                    }
-                  else
-                    {
-                      // Advance the slug.
-                      temp_slug->top += top_delta_z;
-                      temp_slug->bot += bot_delta_z;
-                    }
-                }
-              else
-                {
-                  if (temp_slug->top + top_delta_z >= domain->layer_bottom_depth)
-                    {
-                      // The slug falls entirely past layer_depth.
-                      *groundwater_recharge += ((temp_slug->bot + bot_delta_z) - (temp_slug->top + top_delta_z)) * domain->parameters->delta_water_content;
-                      kill_slug(domain, ii, temp_slug);
-                    }
-                  else if (temp_slug->bot + bot_delta_z > domain->layer_bottom_depth)
-                    {
-                      // The slug falls partially past layer depth.
-                      *groundwater_recharge += (temp_slug->bot + bot_delta_z - domain->layer_bottom_depth) * domain->parameters->delta_water_content;
-                      temp_slug->top        += top_delta_z;
-                      temp_slug->bot         = domain->layer_bottom_depth;
-                    }
-                  else
-                    {
-                      // Advance the slug.
-                      temp_slug->top += top_delta_z;
-                      temp_slug->bot += bot_delta_z;
-                    }
-                }
-            }
-          else
-            {
-              // A middle slug might hit the slug below it.
-              if (temp_slug->bot + bot_delta_z >= temp_slug->next->top)
-                {
-                  // The slug hits the slug below it.
-                  temp_slug->next->top -= (temp_slug->bot + bot_delta_z) - (temp_slug->top + top_delta_z);
-                  kill_slug(domain, ii, temp_slug);
-                }
-              else
-                {
-                  // Advance the slug.
-                  temp_slug->top += top_delta_z;
-                  temp_slug->bot += bot_delta_z;
-                }
-            }
+  for (ii = 1; match && ii <= domain->parameters->num_bins; ii++)
+    {
+      for (jj = 0, temp_slug = domain->top_slug[ii]; match && NULL != temp_slug; jj++, temp_slug = temp_slug->next)
+        {
+          match = jj < domain->slug_spans[ii].num_slugs && jj == temp_slug->span_index && domain->slug_spans[ii].top[jj] == temp_slug->top &&
+              domain->slug_spans[ii].bot[jj] == temp_slug->bot;
+        }
 
-          temp_slug = prev_slug;
-        } // End while (NULL != temp_slug).
-    } // End for (ii = 2; ii <= domain->parameters->num_bins; ii++).
+      match = match && jj == domain->slug_spans[ii].num_slugs;
+    }
 
-  return error;
+  return match;
 }
+#endif // SLUG_SPANS
 
-/* Return the distance in meters that groundwater in a bin will move in one
- * timestep.  Positive means down toward the bottom of the domain.
+/* Rebuild the span of a bin from its linked list.  Code that links a whole
+ * list at once, such as t_o_domain_restore, calls this afterward instead of
+ * adding the slugs to the span one at a time.  Does nothing unless SLUG_SPANS
+ * is defined.
+ * Return TRUE if there is an error, FALSE otherwise.
  *
  * Parameters:
  *
- * domain      - A pointer to the t_o_domain struct.
- * bin         - Which bin to calculate distance for.
- * first_bin   - The leftmost bin that is not completely full of water.
- * dt          - The duration of the timestep in seconds.
- * water_table - The depth in meters of the water table.
- * inflow_rate - Flow rate through fully saturated bins in meters per second.
+ * domain - A pointer to the t_o_domain struct.
+ * bin    - Which bin to rebuild.  One based indexing is used.
  */
-double groundwater_distance(t_o_domain* domain, int bin, int first_bin, double dt, double water_table, double inflow_rate)
+int slug_span_rebuild(t_o_domain* domain, int bin)
 {
-  double distance = 0.0;
+  int error = FALSE; // Error flag.
 
-  assert(NULL != domain && 0 < bin && bin <= domain->parameters->num_bins && 0 < first_bin && first_bin <= domain->parameters->num_bins &&
-      0.0 < dt && 0.0 <= water_table);
+#ifdef SLUG_SPANS
+  slug_span* span      = &domain->slug_spans[bin];
+  int        num_slugs = 0; // The number of slugs in the bin.
+  slug*      temp_slug;
 
-  if (domain->yes_groundwater)
-    {  
-      // Original code;
-      /*
-      if (0.0 >= water_table && 0.0 == domain->groundwater_front[bin])
-        {
-          distance = 0.0;
-        }
-      else if (water_table <= domain->groundwater_front[bin])
-        {
-          // If groundwater falls below the water table there are numerical problems.  Move the groundwater to 10% of its capillary head above the water table.
-          fprintf(stderr, "WARNING: Groundwater below water table moved up to 10 percent of capillary head above water table.\n");
-          distance = (water_table - 0.1 * domain->parameters->bin_capillary_suction[bin]) - domain->groundwater_front[bin];
-        }
-      else
-        {
-          distance = ((domain->parameters->cumulative_conductivity[bin] - domain->parameters->cumulative_conductivity[first_bin - 1]) /
-              (domain->parameters->bin_water_content[bin] - domain->parameters->bin_water_content[first_bin - 1])) *
-                  ((-domain->parameters->bin_capillary_suction[bin] / (water_table - domain->groundwater_front[bin])) + 1) * dt;
+  for (temp_slug = domain->top_slug[bin]; NULL != temp_slug; temp_slug = temp_slug->next)
+    {
+      num_slugs++;
+    }
 
-          // Do not allow the groundwater to travel beyond hydrostatic.
-          double distance_to_hydrostatic = (water_table - domain->parameters->bin_capillary_suction[bin]) - domain->groundwater_front[bin];
+  error = slug_span_reserve(span, num_slugs);
 
-          if ((0.0 >= distance_to_hydrostatic && distance < distance_to_hydrostatic) || (0.0 <= distance_to_hydrostatic && distance > distance_to_hydrostatic))
-            {
-              distance = distance_to_hydrostatic;
-            }
-        }
-      */
-      
-      // Hydrostatic suction considering steady rainfall rate. Add 06/02/14.
-      if (domain->layer_top_depth >= water_table && domain->layer_top_depth == domain->groundwater_front[bin])
-        {
-          distance = 0.0;
-        }
-      else if (water_table <= domain->groundwater_front[bin])
+  if (!error)
+    {
+      span->num_slugs = 0;
+
+      for (temp_slug = domain->top_slug[bin]; NULL != temp_slug; temp_slug = temp_slug->next)
         {
-          // If groundwater falls below the water table there are numerical problems.  Move the groundwater to 10% of its capillary head above the water table.
-          fprintf(stderr, "WARNING: Groundwater below water table moved up to 10 percent of capillary head above water table.\n");
-          distance = (water_table - 0.1 * domain->parameters->bin_capillary_suction[bin]) - domain->groundwater_front[bin];
-          printf("bin = %d water_table = %lf, domain->groundwater_front[bin] = %lf \n", bin, water_table, domain->groundwater_front[bin]); getchar();
-          // FIXME, remove me, Feb, 09, 2015.
+          temp_slug->span_index      = span->num_slugs;
+          span->top[span->num_slugs] = temp_slug->top;
+          span->bot[span->num_slugs] = temp_slug->bot;
+          span->num_slugs++;
         }
-      else
-        {
-          double suction = domain->parameters->bin_capillary_suction[bin];
-          if (domain->parameters->cumulative_conductivity[1] < inflow_rate && inflow_rate < domain->parameters->cumulative_conductivity[bin]) 
-            { // Calculate hydrostatic suction considering steady rainfall. 
-              double suction_new = domain->parameters->bc_psib / (1.0 - inflow_rate / domain->parameters->cumulative_conductivity[domain->parameters->num_bins]) 
-                                   + (domain->parameters->bin_capillary_suction[bin] - domain->parameters->bc_psib) / 
-                                     (1.0 - 0.5 * inflow_rate / domain->parameters->cumulative_conductivity[bin]
-                                          - 0.5 * inflow_rate / domain->parameters->cumulative_conductivity[domain->parameters->num_bins]);
+    }
+#endif // SLUG_SPANS
 
-              if (water_table - domain->layer_top_depth > suction_new || 
-                  water_table - domain->layer_top_depth < domain->parameters->bin_capillary_suction[domain->parameters->num_bins])
-                {
-                  suction = suction_new;
-                }
-              else if (water_table > domain->layer_top_depth)
-                {
-                  suction = 0.99 * water_table;
-                }
-            }
-          
-          distance = ((domain->parameters->cumulative_conductivity[bin] - domain->parameters->cumulative_conductivity[first_bin - 1]) /
-              (domain->parameters->bin_water_content[bin] - domain->parameters->bin_water_content[first_bin - 1])) *
-                  ((-suction / (water_table - domain->groundwater_front[bin])) + 1) * dt;
+  return error;
+}
 
-          // Do not allow the groundwater to travel beyond hydrostatic.
-          //double distance_to_hydrostatic = (water_table - domain->parameters->bin_capillary_suction[bin]) - domain->groundwater_front[bin];
-          double distance_to_hydrostatic = (water_table - suction) - domain->groundwater_front[bin];
+/* Empty the list of a bin without deallocating its slugs.  The caller takes
+ * over the slugs, for example to redistribute them.
+ *
+ * Parameters:
+ *
+ * domain - A pointer to the t_o_domain struct.
+ * bin    - Which bin to empty.  One based indexing is used.
+ */
+void clear_bin_slugs(t_o_domain* domain, int bin)
+{
+#ifdef SLUG_SPANS
+  slug* temp_slug;
 
-          if ((0.0 >= distance_to_hydrostatic && distance < distance_to_hydrostatic) || (0.0 <= distance_to_hydrostatic && distance > distance_to_hydrostatic))
-            {
-              distance = distance_to_hydrostatic;
-            }
-        }
+  for (temp_slug = domain->top_slug[bin]; NULL != temp_slug; temp_slug = temp_slug->next)
+    {
+      temp_slug->span_index = -1;
     }
 
-  return distance;
+  domain->slug_spans[bin].num_slugs = 0;
+#endif // SLUG_SPANS
+
+  domain->top_slug[bin] = NULL;
+  domain->bot_slug[bin] = NULL;
 }
 
-/* Process the groundwater step of the simulation.
- * Return TRUE if there is an error, FALSE otherwise.
- * Actually always returns FALSE.  No conditions generate an error.
+/* Add the depths from top to bot of a bin to the dirty range of a domain.
+ * Everything that adds or removes water in a bin between redistributions
+ * must call it, either directly or through set_surface_front,
+ * set_groundwater_front, set_slug_top, set_slug_bot, link_slug_after, or
+ * kill_slug, or t_o_redistribute can miss water that is out of order.
  *
  * Parameters:
  *
- * domain               - A pointer to the t_o_domain struct.
- * dt                   - The duration of the timestep in seconds.
- * first_bin            - A scalar passed by reference containing the leftmost
- *                        bin that is not completely full of water.  Will be
- *                        updated to the new value after infiltration.
- * water_table          - The depth in meters of the water table.
- * ponded_water         - Whether the demand of the fully saturated bins was
- *                        completely satisfied from surface water.
- *                        Pass in the value set by satisfy_saturated_bins.
- *                        If this is TRUE then bins less than first_bin are
- *                        left pinned to the surface.  Otherwise, their
- *                        groundwater front is simulated the same as other
- *                        bins.
- * groundwater_recharge - A scalar passed by reference containing any
- *                        previously accumulated groundwater recharge in meters
- *                        of water.  Will be updated for the amount of water
- *                        that flowed between the Talbot-Ogden domain and
- *                        groundwater.  Positive means water flowed down out of
- *                        the Talbot-Ogden domain.  Negative means water flowed
- *                        up in to the Talbot-Ogden domain.
- * inflow_rate          - Flow rate through fully saturated bins in meters per second.
+ * domain - A pointer to the t_o_domain struct.
+ * bin    - Which bin changed.  One based indexing is used.
+ * top    - One end of the depths in meters that changed.
+ * bot    - The other end of the depths in meters that changed.  top and bot
+ *          can be in either order.
  */
-int t_o_groundwater(t_o_domain* domain, double dt, int* first_bin, double water_table, int ponded_water, double* groundwater_recharge, double inflow_rate)
+static inline void mark_dirty(t_o_domain* domain, int bin, double top, double bot)
 {
-  int error = FALSE; // Error flag.
-  int ii;            // Loop counter.
+  if (domain->dirty.first_bin > bin)
+    {
+      domain->dirty.first_bin = bin;
+    }
 
-  assert(NULL != domain && 0.0 < dt && 0.0 <= water_table && NULL != groundwater_recharge);
+  if (domain->dirty.last_bin < bin)
+    {
+      domain->dirty.last_bin = bin;
+    }
 
-  if (domain->yes_groundwater)
+  if (domain->dirty.top > min(top, bot))
     {
-      // If the demand of the fully saturated bins was completely satisfied from surface water then bins less than first_bin are pinned to the surface.
-      // Otherwise, reduce first_bin until you reach a bin whoose hydrostatic equlibrium is at or above the surface.
-      if (!ponded_water)
-        {
-          while (2 < *first_bin && domain->layer_top_depth < water_table - domain->parameters->bin_capillary_suction[*first_bin - 1])
-            {
-              (*first_bin)--;
-            }
-        }
+      domain->dirty.top = min(top, bot);
+    }
 
-      for (ii = *first_bin; ii <= domain->parameters->num_bins; ii++)
+  if (domain->dirty.bot < max(top, bot))
+    {
+      domain->dirty.bot = max(top, bot);
+    }
+}
+
+/* Make the dirty range of a domain cover every bin and depth.  Use this
+ * after changing the water of a domain without marking the changes.
+ *
+ * Parameters:
+ *
+ * domain - A pointer to the t_o_domain struct.
+ */
+void mark_all_dirty(t_o_domain* domain)
+{
+  domain->dirty.first_bin = 1;
+  domain->dirty.last_bin  = domain->parameters->num_bins;
+  domain->dirty.top       = domain->layer_top_depth;
+  domain->dirty.bot       = domain->layer_bottom_depth;
+}
+
+/* Empty the dirty range of a domain.
+ *
+ * Parameters:
+ *
+ * domain - A pointer to the t_o_domain struct.
+ */
+static inline void clear_dirty(t_o_domain* domain)
+{
+  domain->dirty.first_bin = domain->parameters->num_bins + 1;
+  domain->dirty.last_bin  = 0;
+  domain->dirty.top       = domain->layer_bottom_depth;
+  domain->dirty.bot       = domain->layer_top_depth;
+}
+
+/* Link a slug that is not in any bin into the list of a bin.
+ * Return TRUE if there is an error, FALSE otherwise.
+ * If there is an error the slug is not linked.
+ *
+ * Parameters:
+ *
+ * domain    - A pointer to the t_o_domain struct.
+ * bin       - Which bin to add the slug to.  One based indexing is used.
+ * prev_slug - The slug will be placed after this slug in the linked list.
+ *             Pass in NULL to place the slug at the top of the linked list
+ *             or if the slug list for the bin is empty.
+ * new_slug  - The slug to link.
+ */
+int link_slug_after(t_o_domain* domain, int bin, slug* prev_slug, slug* new_slug)
+{
+  int error = FALSE; // Error flag.
+
+  mark_dirty(domain, bin, new_slug->top, new_slug->bot);
+
+  doubly_linked_list_insert_after((doubly_linked_list_element**)&domain->top_slug[bin], (doubly_linked_list_element**)&domain->bot_slug[bin],
+                                  (doubly_linked_list_element*)prev_slug, (doubly_linked_list_element*)new_slug);
+
+#ifdef SLUG_SPANS
+  error = slug_span_insert(domain, bin, new_slug);
+
+  if (error)
+    {
+      doubly_linked_list_remove_element((doubly_linked_list_element**)&domain->top_slug[bin], (doubly_linked_list_element**)&domain->bot_slug[bin],
+                                        (doubly_linked_list_element*)new_slug);
+    }
+#endif // SLUG_SPANS
+
+  return error;
+}
+
+/* Set the depth of the top of a slug.  Every change to the depths of a slug
+ * that is in a bin goes through set_slug_top or set_slug_bot so that the span
+ * of the bin stays in step with its list if SLUG_SPANS is defined and the
+ * change is added to the dirty range.
+ *
+ * Parameters:
+ *
+ * domain   - A pointer to the t_o_domain struct.
+ * bin      - Which bin the slug is in.  One based indexing is used.
+ * the_slug - The slug to change.
+ * top      - The new depth in meters of the top of the slug.
+ */
+void set_slug_top(t_o_domain* domain, int bin, slug* the_slug, double top)
+{
+  mark_dirty(domain, bin, the_slug->top, top);
+
+  the_slug->top = top;
+
+#ifdef SLUG_SPANS
+  assert(0 <= the_slug->span_index && the_slug->span_index < domain->slug_spans[bin].num_slugs);
+
+  domain->slug_spans[bin].top[the_slug->span_index] = top;
+#endif // SLUG_SPANS
+}
+
+/* Set the depth of the bottom of a slug.  See set_slug_top.
+ *
+ * Parameters:
+ *
+ * domain   - A pointer to the t_o_domain struct.
+ * bin      - Which bin the slug is in.  One based indexing is used.
+ * the_slug - The slug to change.
+ * bot      - The new depth in meters of the bottom of the slug.
+ */
+void set_slug_bot(t_o_domain* domain, int bin, slug* the_slug, double bot)
+{
+  mark_dirty(domain, bin, the_slug->bot, bot);
+
+  the_slug->bot = bot;
+
+#ifdef SLUG_SPANS
+  assert(0 <= the_slug->span_index && the_slug->span_index < domain->slug_spans[bin].num_slugs);
+
+  domain->slug_spans[bin].bot[the_slug->span_index] = bot;
+#endif // SLUG_SPANS
+}
+
+/* Set the depth of the surface front of a bin.  Every change to the fronts
+ * between redistributions goes through set_surface_front or
+ * set_groundwater_front so that the change is added to the dirty range.
+ *
+ * Parameters:
+ *
+ * domain - A pointer to the t_o_domain struct.
+ * bin    - Which bin.  One based indexing is used.
+ * depth  - The new depth in meters of the surface front.
+ */
+void set_surface_front(t_o_domain* domain, int bin, double depth)
+{
+  mark_dirty(domain, bin, domain->surface_front[bin], depth);
+
+  domain->surface_front[bin] = depth;
+}
+
+/* Set the depth of the groundwater front of a bin.  See set_surface_front.
+ *
+ * Parameters:
+ *
+ * domain - A pointer to the t_o_domain struct.
+ * bin    - Which bin.  One based indexing is used.
+ * depth  - The new depth in meters of the groundwater front.
+ */
+void set_groundwater_front(t_o_domain* domain, int bin, double depth)
+{
+  mark_dirty(domain, bin, domain->groundwater_front[bin], depth);
+
+  domain->groundwater_front[bin] = depth;
+}
+
+/* Create a new slug in domain in the given bin number.
+ * Return TRUE if there is an error, FALSE otherwise.
+ * If there is an error no slug is created.
+ * The slug is placed after prev_slug in the linked list or at the top of the
+ * linked list if prev_slug is NULL.  This function assumes prev_slug is in the
+ * given bin number and the linked list position is correct for the given
+ * values of top and bot.
+ *
+ * Parameters:
+ *
+ * domain    - A pointer to the t_o_domain struct.
+ * bin       - Which bin to add the slug to.  One based indexing is used.
+ * prev_slug - The new slug will be placed after this slug in the linked list.
+ *             Pass in NULL to place the new slug at the top of the linked list
+ *             or if the slug list for the bin is empty.
+ * top       - The depth in meters of the top    of the new slug.
+ * bot       - The depth in meters of the bottom of the new slug.
+ */
+int create_slug_after(t_o_domain* domain, int bin, slug* prev_slug, double top, double bot)
+{
+  int   error = FALSE; // Error flag.
+  slug* new_slug;      // To point to the created slug.
+
+  // FIXME, wencong.
+//assert(NULL != domain && 0 < bin && bin <= domain->parameters->num_bins && domain->layer_top_depth <= top && top < bot && bot <= domain->layer_bottom_depth);
+  assert(NULL != domain && 0 < bin && bin <= domain->parameters->num_bins && domain->layer_top_depth <= top && top <=bot && bot <= domain->layer_bottom_depth); 
+  // FIXME, WENCONG, top <bot
+
+  // Allocate the new slug.
+  error = slug_alloc(&new_slug, top, bot);
+
+  // Place it in the linked list.
+  if (!error)
+    {
+      error = link_slug_after(domain, bin, prev_slug, new_slug);
+
+      if (error)
+        {
+          slug_dealloc(&new_slug);
+        }
+    }
+
+  return error;
+}
+
+/* Remove a slug from its linked list and deallocate its memory.
+ *
+ * Parameters:
+ *
+ * domain       - A pointer to the t_o_domain struct.
+ * bin          - Which bin to remove the slug from.
+ *                One based indexing is used.
+ * slug_to_kill - The slug to remove.
+ */
+void kill_slug(t_o_domain* domain, int bin, slug* slug_to_kill)
+{
+  assert(NULL != domain && 0 < bin && bin <= domain->parameters->num_bins && NULL != slug_to_kill);
+
+  mark_dirty(domain, bin, slug_to_kill->top, slug_to_kill->bot);
+
+#ifdef SLUG_SPANS
+  slug_span_remove(domain, bin, slug_to_kill);
+#endif // SLUG_SPANS
+
+  // Remove from the list.
+  doubly_linked_list_remove_element((doubly_linked_list_element**)&domain->top_slug[bin], (doubly_linked_list_element**)&domain->bot_slug[bin],
+                                    (doubly_linked_list_element*)slug_to_kill);
+
+  // Deallocate.
+  slug_dealloc(&slug_to_kill);
+}
+
+/* Change surface water in one bin into a slug.
+ * Return TRUE if there is an error, FALSE otherwise.
+ * If there is an error the slug is not detached.
+ * The water is removed from the surface front and placed in a new slug with
+ * its top at zero and bottom at the location of the surface front.
+ * There is no vertical movement of the water.  No slug will be created
+ * if the surface front is at zero and thus has no water.
+ *
+ * Parameters:
+ *
+ * domain - A pointer to the t_o_domain struct.
+ * bin    - Which bin to detach.  One based indexing is used.
+ */
+int detach_slug(t_o_domain* domain, int bin)
+{
+  int error = FALSE; // Error flag.
+
+  assert(NULL != domain && 0 < bin && bin <= domain->parameters->num_bins);
+
+  if (domain->layer_top_depth < domain->surface_front[bin])
+    {
+      error = create_slug_after(domain, bin, NULL, domain->layer_top_depth, domain->surface_front[bin]);
+
+      if (!error)
+        {
+          set_surface_front(domain, bin, domain->layer_top_depth);
+        }
+    }
+
+  return error;
+}
+
+/* Change surface water in all bins into slugs.
+ * Return TRUE if there is an error, FALSE otherwise.
+ * If there is an error some but not all of the slugs might be detached.
+ * The water is removed from the surface front and placed in new slugs with
+ * their top at zero and bottom at the location of the surface front.
+ * There is no vertical movement of the water.  No slug will be created
+ * for a bin if the surface front is at zero and thus has no water.
+ *
+ * Parameters:
+ *
+ * domain - A pointer to the t_o_domain struct.
+ */
+int detach_all_slugs(t_o_domain* domain)
+{
+  int error = FALSE; // Error flag.
+  int ii;            // Loop counter.
+
+  assert(NULL != domain);
+
+  // Process all bins.
+  for (ii = 1; !error && ii <= domain->parameters->num_bins; ii++)
+    {
+      error = detach_slug(domain, ii);
+    }
+
+  return error;
+}
+
+// FIXLATER possible optimization: Calculate first_bin and last_bin once
+// and pass the values around and update them only if they change.
+// FIXLATER possible optimization binary search instead of linear.
+
+/* Return the leftmost bin that is not completely full of water or num_bins + 1
+ * if all bins are completely full of water.  If yes_groundwater is FALSE then
+ * bins to the right of initial_water_content are not considered completely
+ * full of water even if surface_front reaches to layer_depth because they are
+ * not in contact with groundwater.  first_bin is forced to be at least 2
+ * because bin 1 should always be completely full of water, and we often use
+ * first_bin - 1 as an array index.  If bin 1 is ever not completely full of
+ * water then residual_saturation is set too high, and the simulation will be
+ * innacurate because it needs more bins to the left.
+ *
+ * Parameters:
+ *
+ * domain       - A pointer to the t_o_domain struct.
+ * start_search - Only search from this bin to the right.  Certain situations
+ *                have a lower bound for first_bin.  Passing in this lower
+ *                bound can speed things up.  If you don't know a lower bound
+ *                pass in 2.
+ */
+int find_first_bin(t_o_domain* domain, int start_search)
+{
+  assert(NULL != domain && 2 <= start_search && start_search <= domain->parameters->num_bins + 1);
+
+  int first_bin = start_search; // The leftmost bin that is not completely full of water.
+
+  // We cannot use has_water_at_depth(0.0 to domain->layer_depth) because if yes_groundwater is FALSE and surface_front reaches to layer_depth then
+  // has_water_at_depth will return TRUE even though that bin should not be considered in contact with groundwater.
+  while(first_bin <= domain->parameters->num_bins &&
+        ((domain->yes_groundwater && domain->layer_top_depth == domain->groundwater_front[first_bin]) ||
+         (!domain->yes_groundwater && domain->parameters->bin_water_content[first_bin] <= domain->initial_water_content)))
+    {
+      first_bin++;
+    }
+
+  return first_bin;
+}
+
+/* Return the rightmost bin that has surface front water or 1 if no bins have
+ * surface front water.  last_bin is forced to be at least 1 because bin 1
+ * should always be completely full of water.  See the comment of
+ * find_first_bin for why.
+ *
+ * Parameters:
+ *
+ * domain - A pointer to the t_o_domain struct.
+ */
+int find_last_bin(t_o_domain* domain)
+{
+  assert(NULL != domain);
+
+  int last_bin = domain->parameters->num_bins; // The rightmost bin that has surface front water.
+  
+  while (1 < last_bin && !has_water_at_depth(domain, last_bin, domain->layer_top_depth, domain->layer_top_depth))
+    {
+      last_bin--;
+    }
+
+  return last_bin;
+}
+
+/* Process infiltration into the completely saturated bins.
+ * Return TRUE if there is an error, FALSE otherwise.
+ * If there is an error some but not all of the surface front water
+ * might be detached as slugs, and not all of the demand might be
+ * satisfied even if there is still surface front water and/or slugs.
+ * This function takes water from the surface first.  If there is not enough
+ * water on the surface, it detaches all surface front water into slugs and
+ * then takes water from slugs.
+ *
+ * Parameters:
+ *
+ * domain               - A pointer to the t_o_domain struct.
+ * dt                   - The duration of the timestep in seconds.
+ * first_bin            - The leftmost bin that is not completely full of
+ *                        water.
+ * surfacewater_depth   - A scalar passed by reference containing the depth
+ *                        in meters of the surface water.  Will be updated for
+ *                        the amount of infiltration.
+ * ponded_water         - A scalar passed by reference.  Will be set to whether
+ *                        the demand of the fully saturated bins was completely
+ *                        satisfied from surface water.
+ * groundwater_recharge - A scalar passed by reference containing any
+ *                        previously accumulated groundwater recharge in meters
+ *                        of water.  Will be updated for the amount of water
+ *                        that flowed between the Talbot-Ogden domain and
+ *                        groundwater.  Positive means water flowed down out of
+ *                        the Talbot-Ogden domain.  Negative means water flowed
+ *                        up in to the Talbot-Ogden domain.
+ * water_table          - The depth in meters of the water table. (add 06/17/14)
+ */
+int t_o_satisfy_saturated_bins(t_o_domain* domain, double dt, int first_bin, double* surfacewater_depth, int* ponded_water, double* groundwater_recharge,
+                               double water_table)
+{
+  assert(NULL != domain && 0.0 < dt && NULL != surfacewater_depth && 0.0 <= *surfacewater_depth && NULL != ponded_water && NULL != groundwater_recharge);
+
+  int    error = FALSE; // Error flag.
+  int    ii, jj;        // Loop counters.
+  double demand;        // Total water in meters of water that can infiltrate this timestep.
+  double demand2;       // Demand of firstbin - 2.  We want the groundwater in saturated bins to fall only if they cannot be satisfied from surface water.
+                        // However, if it is raining less than the saturated conductivity it may be able to satisfy only part of the last saturated bin.
+                        // This can lead to an oscilation where it can't satisfy all of the saturated bins so the groundwater in all of the saturated bins
+                        // falls including those bins that are being satisfied from surface water.  The rainfall can no longer infiltrate through the saturated
+                        // bins and it becomes surface front water, which collides with the groundwater front increasing the number of saturated bins until the
+                        // bin that can only be partially satisfied with rainfall becomes saturated and the cycle repeats.  To avoid this oscilation we allow
+                        // the groundwater to fall only if the next to last saturated bin cannot be satisfied from surface water.  demand2 is the demand of the
+                        // next to last saturated bin.
+  
+  // Calculate the demand of all the bins up to but not including first_bin, if not saturated.
+  // FIXME do we want to vary the demand with surface water pressure head boundary condition?
+  
+   if (domain->yes_groundwater && domain->groundwater_front[domain->parameters->num_bins] <= domain->layer_top_depth)
+    { // FIXME, wecnong, add 06/17/14, if fully saturated, calculated demand using Darcy's law.
+      assert(water_table >= domain->layer_top_depth);
+      demand = dt * domain->parameters->cumulative_conductivity[domain->parameters->num_bins] * (water_table - domain->layer_top_depth) / 
+               (domain->layer_bottom_depth - domain->layer_top_depth);
+      if (*surfacewater_depth   >= dt * domain->parameters->cumulative_conductivity[domain->parameters->num_bins])
+        {
+          *ponded_water          = TRUE;
+        }
+      else
+        {
+          *ponded_water          = FALSE;
+          error = detach_all_slugs(domain);
+        }
+        
+      if (*surfacewater_depth >= demand)
+        {
+          *surfacewater_depth   -= demand;
+          *groundwater_recharge += demand;
+        }
+      else
+        {
+          *groundwater_recharge += *surfacewater_depth;
+          *surfacewater_depth    = 0.0; 
+        }
+     
+      return error;
+    }
+   else
+    {
+      demand = domain->parameters->cumulative_conductivity[first_bin - 1] * dt;
+      if (first_bin > 2)
+        {
+          demand2 = domain->parameters->cumulative_conductivity[first_bin - 2] * dt;
+        }
+      else
+        {
+          demand2 = 0.95 * demand;
+        }
+    }// End of calculated demand of saturated bins.
+
+  // Satisfy as much of the demand as possible from surface water.
+  if (*surfacewater_depth   >= demand)
+    {
+      *ponded_water          = TRUE;
+      *surfacewater_depth   -= demand;
+      *groundwater_recharge += demand;
+      demand                 = 0.0;
+    }
+  else
+    {
+      if (*surfacewater_depth >= demand2)
+        {
+          *ponded_water = TRUE;
+        }
+      else
+        {
+          *ponded_water = FALSE;
+
+          // If the demand wasn't entirely satisfied from surface water, all surface front water will detach as slugs.
+          error = detach_all_slugs(domain);
+        }
+      
+      if (0.0 < *surfacewater_depth)
+        {
+          *groundwater_recharge += *surfacewater_depth;
+          demand                -= *surfacewater_depth;
+          *surfacewater_depth    = 0.0;
+        }
+    }
+  
+  if (!error)
+    {
+      // Satisfy the rest of the demand from slugs.
+      int has_slugs = TRUE;
+
+      while (epsilon_less(0.0, demand) && has_slugs)
+        {
+          // Get the rightmost slug.
+          ii = domain->parameters->num_bins;
+
+          while (ii > first_bin && NULL == domain->top_slug[ii])
+            {
+              ii--;
+            }
+
+          if (ii <= first_bin)
+            {
+              has_slugs = FALSE;
+            }
+          else
+            {
+              // Get the water from all slugs connected to domain->top_slug[ii].
+              // FIXME get water from all slugs?
+
+              double demand_save = demand; // We need to remember the value of the demand at the beginning of the loop iteration.
+              slug*  get_slugs[ii + 1];    // Pointers to the slug in each bin that we will get water from.
+              // Some elements might be NULL if we will not get water from a slug in that bin.
+              double weight[ii + 1];       // Take from each slug a fraction of the demand equal to its normalized weight.
+              double total_weight = 0.0;   // For normalizing weights.
+
+              // Determine the weights.
+              for (jj = ii; jj >= first_bin; jj--)
+                {
+                  // Find the slug.
+                  get_slugs[jj] = domain->top_slug[jj];
+
+                  while (NULL != get_slugs[jj] && domain->top_slug[ii]->top >= get_slugs[jj]->bot)
+                    {
+                      get_slugs[jj] = get_slugs[jj]->next;
+                    }
+
+                  if (NULL != get_slugs[jj] && !(domain->top_slug[ii]->top >= get_slugs[jj]->top && domain->top_slug[ii]->bot <= get_slugs[jj]->bot))
+                    {
+                      get_slugs[jj] = NULL;
+                    }
+
+                  // At this point in the code if get_slugs[jj] is NULL then there is no slug in that bin at that height.
+                  // If it is not NULL, get water from it.
+
+                  // Determine the weight of this slug.
+                  if (NULL != get_slugs[jj])
+                    {
+                      weight[jj]    = (domain->parameters->bin_capillary_suction[first_bin - 1] - domain->parameters->bin_capillary_suction[jj]);
+                      total_weight += weight[jj];
+                    }
+                }
+
+              // Get the water.
+              for (jj = ii; jj >= first_bin; jj--)
+                {
+                  if (NULL != get_slugs[jj])
+                    {
+                      double water = demand_save * weight[jj] / total_weight;         // Water to take from this bin in meters of water.
+                      double depth = water / domain->parameters->delta_water_content; // Water to take from this bin in meters of bin depth.
+
+                      if (depth >= get_slugs[jj]->bot - get_slugs[jj]->top)
+                        {
+                          // Get the entire slug.
+                          water = (get_slugs[jj]->bot - get_slugs[jj]->top) * domain->parameters->delta_water_content;
+                          kill_slug(domain, jj, get_slugs[jj]);
+                        }
+                      else
+                        {
+                          // FIXLATER implement complicated function to allocate water gotten to top and bottom?
+                          // Get the water evenly from the top and bottom of the slug.
+                          set_slug_top(domain, jj, get_slugs[jj], get_slugs[jj]->top + depth / 2.0);
+                          set_slug_bot(domain, jj, get_slugs[jj], get_slugs[jj]->bot - depth / 2.0);
+                        }
+
+                      *groundwater_recharge += water;
+                      demand                -= water;
+                    }
+                }
+            } // End get the water from all slugs connected to domain->top_slug[ii].
+        } // End while (epsilon_less(0.0, demand) && has_slugs)
+    } // End if (!error)
+   
+  return error;
+}
+
+/*  Find dry depth for Green-Ampt equaiton.
+ *   The funciton use to define dry depth is:
+ *         Z * porosity = Ks * t + Hc * porosity * ln(1 + Z  / Hc) 
+ *   Parameters:
+ *   Z        - dry depth to be found in meter [m];
+ *   Ks       - saturated conductiviey in meter/second [m/s];
+ *   Hc       - effecitve capillary drive(Geff) in meter [m];
+ *   dt       - time step in second [s];
+ *   porosity - porosity [-].
+ */
+double GA_drydepth(double Ks, double porosity, double Geff, double dt)
+{
+  double convergence_tolerance = 1.0e-6; // Meters.
+  double iteration_difference;           // Meters.
+  double z_old;                          // Meters.
+  double z_new;                          // Meters.
+  double f;
+  double f_prime;
+  int    iteration_count = 0;
+  int    iteration_limit = 10000;        // maximum number of iterations before giving up.
+  
+  assert(0 < Ks && 0 < porosity && 0 < Geff && 0.0 < dt);
+  
+  z_old = Geff;
+  
+  do
+    {
+      f       = Ks * dt + Geff * porosity * log(1.0 + z_old / Geff) - z_old * porosity;
+      f_prime = Geff * porosity / (Geff + z_old) - porosity;
+      if (0.0 == f_prime)
+        {
+          // Prevent divide by zero.
+          z_new = Ks * dt / porosity + Geff * log(1.0 + Ks * dt / (porosity * Geff));
+          iteration_difference = 0.0;
+        }
+      else
+        {
+          z_new = z_old - (f / f_prime);
+          iteration_difference = z_new - z_old;
+        }
+      
+      z_old = z_new;
+      iteration_count++;
+    }
+  while (fabs(iteration_difference) > convergence_tolerance && iteration_count < iteration_limit);
+
+  if (iteration_count >= iteration_limit)
+    {
+      fprintf(stderr, "WARNING: No convergence in GA_drydepth.\n");
+      z_new = Ks * dt / porosity + Geff * log(1.0 + Ks * dt / (porosity * Geff));
+    }
+  else if (z_new < MINIMUM_DRY_DEPTH)
+    {
+      z_new = MINIMUM_DRY_DEPTH;
+    }
+
+  return z_new;
+}
+
+/* There are numerical problems calculating the distance that water will
+ * infiltrate into a bin that has little or no surface front water.
+ * This function is used instead in that case.
+ * Dry depth of each bin is calculated according to Han's method.
+ * Dry depth is the solution z of following equation:
+ * K * dt + psi * delth * ln (1 + z / psi ) - z * delth = 0
+ * K     = conductivity [m/s]
+ * dt    = time step    [second]
+ * delth = delta water content [-]
+ * psi   = bin capillary suction [m]
+ * z     = dry depth [m]
+ * Netwon-Raphson iteration is used for the solution.
+ * F(z)_prime = delth / (1 + z / psi) - delth
+ */
+double t_o_find_dry_depth(t_o_parameters* parameters, int bin, double dt)
+{
+  double dry_depth;                      // Meters
+  double maximum_dry_depth;              // Meters.
+  double convergence_tolerance = 1.0e-6; // Meters.
+  double iteration_difference;           // Meters.
+  double z_old;                          // Meters.
+  double z_new;                          // Meters.
+  double f;
+  double f_prime;
+  int    iteration_count = 0;
+  int    iteration_limit = 10000;        // maximum number of iterations before giving up.
+
+  assert(NULL != parameters && 0 < bin && bin <= parameters->num_bins && 0.0 < dt);
+
+  z_old = parameters->cumulative_conductivity[bin] * dt;
+
+  do
+    {
+      f       = (parameters->cumulative_conductivity[bin] * dt) + (parameters->bin_capillary_suction[bin] * parameters->delta_water_content *
+          log(1.0 + (z_old / parameters->bin_capillary_suction[bin]))) - (z_old * parameters->delta_water_content);
+      f_prime = (parameters->delta_water_content / (1.0 + (z_old / parameters->bin_capillary_suction[bin]))) - parameters->delta_water_content;
+
+      if (0.0 == f_prime)
+        {
+          // Prevent divide by zero.
+          z_new = MINIMUM_DRY_DEPTH;
+          iteration_difference = 0.0;
+        }
+      else
+        {
+          z_new = z_old - (f / f_prime);
+          iteration_difference = z_new - z_old;
+        }
+
+      z_old = z_new;
+      iteration_count++;
+    }
+  while (fabs(iteration_difference) > convergence_tolerance && iteration_count < iteration_limit);
+
+  // FIXME, later. If Brooks_Corey,maximum_dry_depth = GA_dry_depth is fine, but if using van_Genutchen, maximum_dry_depth = 10 * GA_dry_depth.
+  // Since there is no Flag to indicate what parameters is used, just time 10.
+  maximum_dry_depth = 10 * GA_drydepth(parameters->cumulative_conductivity[parameters->num_bins], 
+                                  parameters->bin_water_content[parameters->num_bins],
+                                  parameters->effective_capillary_suction, dt);
+
+  if (iteration_count >= iteration_limit)
+    {
+      fprintf(stderr, "WARNING: No convergence in t_o_find_dry_depth in bin %d.  Using a value of %le meters\n", bin, MINIMUM_DRY_DEPTH);
+      dry_depth = MINIMUM_DRY_DEPTH;
+    }
+  else if (z_new < MINIMUM_DRY_DEPTH)
+    {
+      dry_depth = MINIMUM_DRY_DEPTH;
+    }
+  else if (z_new > maximum_dry_depth)
+    {
+      dry_depth = maximum_dry_depth;
+    }
+  else
+    {
+      dry_depth = z_new;
+    }
+  
+  return dry_depth;
+}
+
+/* Return the unclamped dry depth in meters.  This solves the same equation as
+ * t_o_find_dry_depth and GA_drydepth:
+ * K * dt + psi * delth * ln (1 + z / psi ) - z * delth = 0
+ * Substituting u = z / psi gives u - ln(1 + u) = K * dt / (psi * delth),
+ * whose left side is convex and increasing.  u = a + sqrt(2 * a) is always
+ * at or above the root so Newton-Raphson iteration from there converges
+ * monotonically from above.  For small u the left side is evaluated with its
+ * Taylor series to avoid cancellation.  This is used to build the dry depth
+ * table where accuracy matters more than speed.
+ *
+ * Parameters:
+ *
+ * conductivity        - K in meters per second.
+ * capillary_suction   - psi in meters.
+ * delta_water_content - delth, unitless.
+ * dt                  - The duration of the timestep in seconds.
+ */
+double dry_depth_root(double conductivity, double capillary_suction, double delta_water_content, double dt)
+{
+  assert(0.0 <= conductivity && 0.0 < capillary_suction && 0.0 < delta_water_content && 0.0 < dt);
+
+  double a               = conductivity * dt / (capillary_suction * delta_water_content); // Right hand side.
+  double u               = a + sqrt(2.0 * a);                                               // Current iterate.
+  double u_new;                                                                             // Next iterate.
+  double g;                                                                                 // u - ln(1 + u) - a.
+  int    iteration_count = 0;
+  int    iteration_limit = 100;
+  int    done            = (0.0 == a);                                                      // The root is zero if there is no conductivity.
+
+  while (!done && iteration_count < iteration_limit)
+    {
+      if (1.0e-3 > u)
+        {
+          g = u * u * (0.5 - u * (1.0 / 3.0 - u * (0.25 - u * 0.2))) - a;
+        }
+      else
+        {
+          g = u - log1p(u) - a;
+        }
+
+      u_new = u - g * (1.0 + u) / u;
+      done  = !(u_new < u) || u - u_new <= 1.0e-14 * u; // Stop when the iterates stop decreasing.
+
+      if (u_new < u)
+        {
+          u = u_new;
+        }
+
+      iteration_count++;
+    }
+
+  return u * capillary_suction;
+}
+
+/* Return a guaranteed bound on the error in meters of linearly interpolating
+ * an increasing concave function between two grid timesteps.  The function
+ * lies above the chord between the grid values and below the tangent lines at
+ * both ends.  The largest gap between the chord and the lower of the two
+ * tangents is the bound.
+ *
+ * Parameters:
+ *
+ * dt1, dt2       - The grid timesteps in seconds at the ends of the interval.
+ * depth1, depth2 - The function values in meters at dt1 and dt2.
+ * slope1, slope2 - The derivatives of the function at dt1 and dt2 in meters
+ *                  per second.
+ */
+double dry_depth_interpolation_error(double dt1, double dt2, double depth1, double depth2, double slope1, double slope2)
+{
+  double error_bound = depth2 - depth1; // Meters.  The function is increasing so this is always a bound.
+
+  assert(dt1 < dt2 && depth1 <= depth2);
+
+  if (slope1 > slope2)
+    {
+      // The tangent lines intersect at dt_star.
+      double dt_star = (depth2 - depth1 + slope1 * dt1 - slope2 * dt2) / (slope1 - slope2);
+
+      if (dt_star < dt1)
+        {
+          dt_star = dt1;
+        }
+      else if (dt_star > dt2)
+        {
+          dt_star = dt2;
+        }
+
+      double tangent = min(depth1 + slope1 * (dt_star - dt1), depth2 + slope2 * (dt_star - dt2));
+      double chord   = depth1 + (depth2 - depth1) * (dt_star - dt1) / (dt2 - dt1);
+
+      error_bound = min(error_bound, tangent - chord);
+    }
+
+  return max(error_bound, 0.0);
+}
+
+/* Fill in the dry depth table of a t_o_parameters struct and calculate its
+ * error bound.  The table has the unclamped dry depth of every bin and the
+ * unclamped Green-Ampt dry depth used for the maximum dry depth clamp at
+ * DRY_DEPTH_TABLE_POINTS_PER_DECADE log spaced timesteps per factor of ten
+ * from DRY_DEPTH_TABLE_MIN_DT to DRY_DEPTH_TABLE_MAX_DT.
+ *
+ * Between grid timesteps both are linearly interpolated and then the same
+ * clamps as t_o_find_dry_depth are applied.  Linear interpolation preserves
+ * monotonicity.  The unclamped dry depth z(t) is increasing and concave in t
+ * because dz/dt = K * (psi + z) / (delth * z) decreases as z grows, and so is
+ * the Green-Ampt clamp.  That gives the bound computed by
+ * dry_depth_interpolation_error for each.  The relative error of the
+ * clamped value is bounded by the larger of the dry depth error divided by
+ * the clamped value at the start of the interval and the clamp error
+ * divided by the clamp at the start of the interval.  The largest such
+ * bound over all bins and intervals is stored in dry_depth_table_error_bound.
+ * Return TRUE if there is an error, FALSE otherwise.
+ * Actually always returns FALSE.  No conditions generate an error.
+ *
+ * Parameters:
+ *
+ * parameters - A pointer to the t_o_parameters struct.  dry_depth_table_size,
+ *              dry_depth_table_dt, dry_depth_table_green_ampt, and
+ *              dry_depth_table must already be allocated, and all other
+ *              members used by t_o_find_dry_depth must be initialized.
+ */
+int build_dry_depth_table(t_o_parameters* parameters)
+{
+  assert(NULL != parameters && 1 < parameters->dry_depth_table_size && NULL != parameters->dry_depth_table_dt &&
+         NULL != parameters->dry_depth_table_green_ampt && NULL != parameters->dry_depth_table);
+
+  int    ii, jj;                                                  // Loop counters.
+  double ga_conductivity   = parameters->cumulative_conductivity[parameters->num_bins];
+  double ga_porosity       = parameters->bin_water_content[parameters->num_bins];
+  double ga_suction        = parameters->effective_capillary_suction;
+  double previous_slope[parameters->num_bins + 1];               // The slope of each bin's dry depth at the previous grid timestep.
+  double previous_ga_slope = 0.0;                                 // The slope of the Green-Ampt dry depth at the previous grid timestep.
+
+  parameters->dry_depth_table_error_bound = 0.0;
+
+  for (jj = 1; jj <= parameters->dry_depth_table_size; jj++)
+    {
+      double dt            = DRY_DEPTH_TABLE_MIN_DT * pow(10.0, (jj - 1) / (double)DRY_DEPTH_TABLE_POINTS_PER_DECADE);
+      double ga_depth      = dry_depth_root(ga_conductivity, ga_suction, ga_porosity, dt);
+      double ga_slope      = ga_conductivity * (ga_suction + ga_depth) / (ga_porosity * ga_depth);
+      double maximum_error = 0.0; // Interpolation error bound of the maximum dry depth clamp over the previous interval in meters.
+      double previous_maximum;    // The maximum dry depth clamp at the previous grid timestep in meters.
+
+      parameters->dry_depth_table_dt[jj]         = dt;
+      parameters->dry_depth_table_green_ampt[jj] = ga_depth;
+
+      if (1 < jj)
+        {
+          previous_maximum = 10.0 * max(MINIMUM_DRY_DEPTH, parameters->dry_depth_table_green_ampt[jj - 1]);
+          maximum_error    = 10.0 * dry_depth_interpolation_error(parameters->dry_depth_table_dt[jj - 1], dt,
+                                                                  parameters->dry_depth_table_green_ampt[jj - 1], ga_depth, previous_ga_slope, ga_slope);
+        }
+
+      for (ii = 1; ii <= parameters->num_bins; ii++)
+        {
+          double depth = dry_depth_root(parameters->cumulative_conductivity[ii], parameters->bin_capillary_suction[ii], parameters->delta_water_content, dt);
+          double slope = 0.0;
+
+          if (0.0 < depth)
+            {
+              slope = parameters->cumulative_conductivity[ii] * (parameters->bin_capillary_suction[ii] + depth) / (parameters->delta_water_content * depth);
+            }
+
+          parameters->dry_depth_table[jj][ii] = depth;
+
+          if (1 < jj)
+            {
+              double previous_depth   = parameters->dry_depth_table[jj - 1][ii];
+              double depth_error      = dry_depth_interpolation_error(parameters->dry_depth_table_dt[jj - 1], dt, previous_depth, depth,
+                                                                      previous_slope[ii], slope);
+              double previous_clamped = max(MINIMUM_DRY_DEPTH, min(previous_depth, previous_maximum));
+
+              parameters->dry_depth_table_error_bound = max(parameters->dry_depth_table_error_bound,
+                                                            max(depth_error / previous_clamped, maximum_error / previous_maximum));
+            }
+
+          previous_slope[ii] = slope;
+        }
+
+      previous_ga_slope = ga_slope;
+    }
+
+  return FALSE;
+}
+
+/* Look up the position of a timestep in the dry depth table grid.
+ * Return TRUE if dt is within the grid, FALSE otherwise.
+ * The interpolated dry depth of bin ii is
+ * (1.0 - weight) * dry_depth_table[index][ii] + weight * dry_depth_table[index + 1][ii].
+ *
+ * Parameters:
+ *
+ * parameters - A pointer to the t_o_parameters struct.
+ * dt         - The duration of the timestep in seconds.
+ * index      - A scalar passed by reference.  Will be set to the grid index
+ *              at or below dt.
+ * weight     - A scalar passed by reference.  Will be set to the linear
+ *              interpolation weight of grid index + 1.
+ */
+int dry_depth_table_position(t_o_parameters* parameters, double dt, int* index, double* weight)
+{
+  assert(NULL != parameters && 0.0 < dt && NULL != index && NULL != weight);
+
+  int    in_grid = FALSE; // Whether dt is within the grid.
+  double* grid   = parameters->dry_depth_table_dt;
+
+  if (grid[1] <= dt && dt <= grid[parameters->dry_depth_table_size])
+    {
+      *index = (int)(log10(dt / DRY_DEPTH_TABLE_MIN_DT) * DRY_DEPTH_TABLE_POINTS_PER_DECADE) + 1;
+
+      // Correct for roundoff in the logarithm.
+      if (*index >= parameters->dry_depth_table_size)
+        {
+          *index = parameters->dry_depth_table_size - 1;
+        }
+
+      while (1 < *index && dt < grid[*index])
+        {
+          (*index)--;
+        }
+
+      while (*index < parameters->dry_depth_table_size - 1 && dt > grid[*index + 1])
+        {
+          (*index)++;
+        }
+
+      *weight = (dt - grid[*index]) / (grid[*index + 1] - grid[*index]);
+      in_grid = TRUE;
+    }
+
+  return in_grid;
+}
+
+/* There are numerical problems calculating the distance that water will
+ * infiltrate into a bin that has little or no surface front water.
+ * In this case a different calculation called dry depth is used to
+ * figure out the infiltration distance. The dry depth should be used
+ * any time the surface front is less than the dry depth.  So you need
+ * to know the dry depth to know if you need to use the dry depth.
+ * Calculating dry depths is somewhat expensive so we have developed
+ * a caching scheme to improve performance.
+ *
+ * Inside the t_o_parameters structure we cache the dry depth of every bin
+ * for a particular timestep duration.  If the current timestep is equal to
+ * the cached timestep we just use those values.  If the current timestep is
+ * greater than the cached timestep we update the cached dry depths at the
+ * larger timestep and then use those values.  If the current timestep is
+ * less than the cached timestep we do not update the cached values.
+ * Instead, we use the cached values as upper bounds to exclude some bins
+ * that don't need to use dry depth and interpolate the dry depth of bins
+ * that we cannot exclude with the upper bound from the dry depth table
+ * precomputed in t_o_parameters_alloc.  The table is accurate to within
+ * dry_depth_table_error_bound and needs no Newton-Raphson iterations.  Only
+ * timesteps outside the table grid calculate the dry depth with
+ * t_o_find_dry_depth.  This will result in
+ * values being cached for the largest timestep ever used in the simulation,
+ * which is an upper bound for all other timesteps.
+ *
+ * The cached values are stored in an immutable t_o_dry_depth_cache snapshot.
+ * Readers load the current snapshot atomically and use it without locking.
+ * When the cache needs to grow, a new snapshot is filled in and published
+ * atomically.  dry_depth_mutex only serializes threads publishing snapshots.
+ * The cached timestep only ever increases so a snapshot a reader has loaded
+ * is always valid for the timestep it loaded it for.
+ *
+ * This function makes sure that the cached values are valid for timesteps of
+ * duration dt.  It only needs to be called once for any number of domains
+ * sharing the same t_o_parameters struct that are stepped with the same dt.
+ * Return TRUE if there is an error, FALSE otherwise.
+ * If there is an error the cache is not updated.
+ *
+ * Parameters:
+ *
+ * parameters - A pointer to the t_o_parameters struct.
+ * dt         - The duration of the timestep in seconds.
+ */
+int update_dry_depth_cache(t_o_parameters* parameters, double dt)
+{
+  assert(NULL != parameters && 0.0 < dt);
+
+  int                  error = FALSE;                                                                       // Error flag.
+  int                  ii;                                                                                  // Loop counter.
+  t_o_dry_depth_cache* cache = atomic_load_explicit(&parameters->dry_depth_cache, memory_order_acquire); // The current snapshot.
+
+  if (cache->dt < dt)
+    {
+#ifdef THREAD_SAFE
+      pthread_mutex_lock(&parameters->dry_depth_mutex);
+
+      // Another thread might have published a big enough snapshot while this one waited for the lock.
+      cache = atomic_load_explicit(&parameters->dry_depth_cache, memory_order_acquire);
+#endif // THREAD_SAFE
+
+      if (cache->dt < dt)
+        {
+          t_o_dry_depth_cache* new_cache; // The new snapshot.
+
+          error = v_alloc((void**)&new_cache, sizeof(t_o_dry_depth_cache));
+
+          if (!error)
+            {
+              error = d_alloc(&new_cache->bin_dry_depth, parameters->num_bins);
+
+              if (error)
+                {
+                  v_dealloc((void**)&new_cache, sizeof(t_o_dry_depth_cache));
+                }
+            }
+
+          if (!error)
+            {
+              new_cache->dt    = dt;
+              new_cache->older = cache;
+
+              for (ii = 1; ii <= parameters->num_bins; ii++)
+                {
+                  new_cache->bin_dry_depth[ii] = t_o_find_dry_depth(parameters, ii, dt);
+                }
+
+              atomic_store_explicit(&parameters->dry_depth_cache, new_cache, memory_order_release);
+            }
+        }
+
+#ifdef THREAD_SAFE
+      pthread_mutex_unlock(&parameters->dry_depth_mutex);
+#endif // THREAD_SAFE
+    }
+
+  return error;
+}
+
+/* Return the fastest kernel the CPU supports.  One of SIMD_KERNEL_SCALAR,
+ * SIMD_KERNEL_AVX2, or SIMD_KERNEL_AVX512.
+ */
+int best_simd_kernel(void)
+{
+  int kernel = SIMD_KERNEL_SCALAR;
+
+#ifdef SIMD_KERNELS
+  if (__builtin_cpu_supports("avx512f"))
+    {
+      kernel = SIMD_KERNEL_AVX512;
+    }
+  else if (__builtin_cpu_supports("avx2"))
+    {
+      kernel = SIMD_KERNEL_AVX2;
+    }
+#endif // SIMD_KERNELS
+
+  return kernel;
+}
+
+// The inputs to the infiltrate_distance kernels that are the same for every bin.
+typedef struct
+{
+  t_o_parameters* parameters;            // For calling t_o_find_dry_depth.
+  int             first_bin;             // The leftmost bin that is not completely full of water.
+  double          dt;                    // The duration of the timestep in seconds.
+  double          layer_top_depth;       // Meters.
+  double          surfacewater_head;     // Meters.
+  double*         surface_front;         // 1D array of the surface front of each bin in meters.
+  double*         bin_capillary_suction; // 1D array of the capillary suction head of each bin in meters.
+  double*         cached_dry_depth;      // 1D array of the dry depth of each bin in meters from the dry depth cache.
+  int             calculate_dry_depth;   // Whether the cached dry depth is only an upper bound because the cache is for a larger timestep.
+  double*         table_lower;           // The dry depth table rows to interpolate between or NULL if dt is not within the table grid.
+  double*         table_upper;
+  double          table_weight;          // Interpolation weight of table_upper.
+  double          maximum_dry_depth;     // Meters.
+  double          rate;                  // Meters per second.  The Green-Ampt conductivity over water content of the wetted bins.
+  double          suction;               // Meters.  Clipped capillary suction of last_bin plus surfacewater_head.
+  int             integrator;            // T_O_INTEGRATOR_EULER, T_O_INTEGRATOR_RK4, or T_O_INTEGRATOR_GREEN_AMPT.
+} infiltrate_kernel_inputs;
+
+/* Return the distance in meters a surface front moving at
+ * rate * (suction / depth + 1) goes in dt seconds.  That integrates to the
+ * Green-Ampt equation D - suction * ln(1 + D / (front + suction)) = rate * dt
+ * for the distance D.  The left side is increasing and convex in D, and the
+ * Euler distance is at or beyond the root because the front slows as it goes
+ * deeper, so Newton's method started there converges monotonically.
+ *
+ * Parameters:
+ *
+ * front   - The depth in meters of the surface front.  Must be positive.
+ * suction - The capillary suction plus surface water head in meters.
+ * rate    - The rate in meters per second.
+ * dt      - The time in seconds.
+ */
+double green_ampt_distance(double front, double suction, double rate, double dt)
+{
+  assert(0.0 < front && 0.0 < suction && 0.0 <= rate && 0.0 < dt);
+
+  double distance          = rate * (suction / front + 1) * dt; // The Euler distance.
+  double delta_distance;                                         // Newton step.
+  int    iteration_count   = 0;
+  int    maximum_iteration = 100;
+
+  do
+    {
+      delta_distance = -(distance - suction * log1p(distance / (front + suction)) - rate * dt) * (front + suction + distance) / (front + distance);
+      distance      += delta_distance;
+      iteration_count++;
+    }
+  while (fabs(delta_distance) > 1.0e-12 * distance && iteration_count < maximum_iteration);
+
+  return distance;
+}
+
+/* Return the distance in meters a wet surface front moves in one timestep
+ * with an integrator.
+ *
+ * Parameters:
+ *
+ * integrator - One of the T_O_INTEGRATOR constants.
+ * front      - The depth in meters of the surface front.
+ * suction    - The capillary suction plus surface water head in meters.
+ * rate       - The rate in meters per second.
+ * dt         - The duration of the timestep in seconds.
+ */
+static inline double infiltrate_step(int integrator, double front, double suction, double rate, double dt)
+{
+  double distance;
+
+  if (T_O_INTEGRATOR_RK4 == integrator)
+    {
+      double k1, k2, k3, k4;
+
+      k1       = rate * (suction /  front              + 1.0) * dt;
+      k2       = rate * (suction / (front + 0.5 * k1) + 1.0) * dt;
+      k3       = rate * (suction / (front + 0.5 * k2) + 1.0) * dt;
+      k4       = rate * (suction / (front + k3)       + 1.0) * dt;
+      distance = (k1 + 2.0 * k2 + 2.0 * k3 + k4) / 6.0;
+    }
+  else if (T_O_INTEGRATOR_GREEN_AMPT == integrator && 0.0 < suction && 0.0 < front)
+    {
+      distance = green_ampt_distance(front, suction, rate, dt);
+    }
+  else
+    {
+      distance = rate * (suction / front + 1) * dt;
+    }
+
+  return distance;
+}
+
+/* Return the distance in meters that water will infiltrate into one bin in
+ * one timestep.
+ *
+ * Parameters:
+ *
+ * inputs - The inputs that are the same for every bin.
+ * ii     - Which bin.
+ */
+static inline double infiltrate_distance_bin(const infiltrate_kernel_inputs* inputs, int ii)
+{
+  double distance;
+  double dry_depth;
+
+  if (inputs->calculate_dry_depth && inputs->cached_dry_depth[ii] + inputs->layer_top_depth >= inputs->surface_front[ii])
+    {
+      // Cannot exclude bin based on upper bound.  Must calculate dry depth.
+      if (NULL != inputs->table_lower)
+        {
+          dry_depth = (1.0 - inputs->table_weight) * inputs->table_lower[ii] + inputs->table_weight * inputs->table_upper[ii];
+
+          if (dry_depth < MINIMUM_DRY_DEPTH)
+            {
+              dry_depth = MINIMUM_DRY_DEPTH;
+            }
+          else if (dry_depth > inputs->maximum_dry_depth)
+            {
+              dry_depth = inputs->maximum_dry_depth;
+            }
+        }
+      else
+        {
+          dry_depth = t_o_find_dry_depth(inputs->parameters, ii, inputs->dt);
+        }
+    }
+  else
+    {
+      dry_depth = inputs->cached_dry_depth[ii];
+    }
+
+  if (0 >= inputs->bin_capillary_suction[ii] + inputs->surfacewater_head)
+    {
+      // If the surfacewater head has more suction than the bin capillarity set the distance to zero.
+      distance = 0.0;
+    }
+  else if (dry_depth + inputs->layer_top_depth >= inputs->surface_front[ii])
+    {
+      // If there is downward infiltration and surface_front is less than dry_depth set distance to dry_depth.
+      distance = dry_depth;
+    }
+  else
+    {
+      // If last_bin is equal to first_bin - 1 then all bins will be set to zero or dry_depth and this equation will not be evaluated.
+      distance = infiltrate_step(inputs->integrator, inputs->surface_front[ii], inputs->suction, inputs->rate, inputs->dt);
+
+      // 1-GARTO type.
+      /*distance = (domain->parameters->cumulative_conductivity[ii] - domain->parameters->cumulative_conductivity[ii - 1]) /
+          (domain->parameters->delta_water_content) *
+          ((last_bin_capillary_suction + surfacewater_head) / domain->surface_front[ii] + 1) * dt;
+      */
+      /*
+      // 2-exact k'
+      double saturation  = (domain->parameters->bin_water_content[ii] - 
+                              (domain->parameters->bin_water_content[1] - domain->parameters->delta_water_content)) /
+                            (domain->parameters->bin_water_content[domain->parameters->num_bins] - 
+                              (domain->parameters->bin_water_content[1] - domain->parameters->delta_water_content)); 
+          
+      distance = domain->parameters->cumulative_conductivity[domain->parameters->num_bins] * (3.0 + 2.0 / domain->parameters->bc_lambda) * 
+                     pow(saturation, 2.0 + 2.0 / domain->parameters->bc_lambda) / (domain->parameters->bin_water_content[domain->parameters->num_bins] - 
+                              (domain->parameters->bin_water_content[1] - domain->parameters->delta_water_content)) * 
+                       ((last_bin_capillary_suction + surfacewater_head) / domain->surface_front[ii] + 1) * dt;
+      */
+    }
+
+  return distance;
+}
+
+/* The portable infiltrate_distance kernel.  Fill in distance[ii] for every
+ * bin from inputs->first_bin to num_bins.
+ *
+ * Parameters:
+ *
+ * inputs   - The inputs that are the same for every bin.
+ * num_bins - The number of bins.
+ * distance - A 1D array with one based indexing to fill in.
+ */
+void infiltrate_distance_scalar(const infiltrate_kernel_inputs* inputs, int num_bins, double* distance)
+{
+  int ii; // Loop counter.
+
+  for (ii = inputs->first_bin; ii <= num_bins; ii++)
+    {
+      distance[ii] = infiltrate_distance_bin(inputs, ii);
+    }
+}
+
+#ifdef SIMD_KERNELS
+/* The AVX2 infiltrate_distance kernel.  Four bins are done at a time with the
+ * branches of infiltrate_distance_bin replaced by masked selects.  Every
+ * value is calculated with the same operations in the same order as
+ * infiltrate_distance_bin so the results are bit for bit identical.  Must
+ * not be called if the dry depth would need t_o_find_dry_depth, that is if
+ * inputs->calculate_dry_depth is TRUE and inputs->table_lower is NULL.
+ * The parameters are the same as infiltrate_distance_scalar.
+ */
+__attribute__((target("avx2"))) void infiltrate_distance_avx2(const infiltrate_kernel_inputs* inputs, int num_bins, double* distance)
+{
+  int     ii           = inputs->first_bin; // Loop counter.
+  __m256d zero         = _mm256_setzero_pd();
+  __m256d one          = _mm256_set1_pd(1.0);
+  __m256d top          = _mm256_set1_pd(inputs->layer_top_depth);
+  __m256d head         = _mm256_set1_pd(inputs->surfacewater_head);
+  __m256d lower_weight = _mm256_set1_pd(1.0 - inputs->table_weight);
+  __m256d upper_weight = _mm256_set1_pd(inputs->table_weight);
+  __m256d minimum      = _mm256_set1_pd(MINIMUM_DRY_DEPTH);
+  __m256d maximum      = _mm256_set1_pd(inputs->maximum_dry_depth);
+  __m256d rate         = _mm256_set1_pd(inputs->rate);
+  __m256d suction      = _mm256_set1_pd(inputs->suction);
+  __m256d dt           = _mm256_set1_pd(inputs->dt);
+
+  assert(!inputs->calculate_dry_depth || NULL != inputs->table_lower);
+
+  for (; ii + 3 <= num_bins; ii += 4)
+    {
+      __m256d surface_front = _mm256_loadu_pd(&inputs->surface_front[ii]);
+      __m256d dry_depth     = _mm256_loadu_pd(&inputs->cached_dry_depth[ii]);
+      __m256d green_ampt;
+
+      if (inputs->calculate_dry_depth)
+        {
+          __m256d interpolated = _mm256_add_pd(_mm256_mul_pd(lower_weight, _mm256_loadu_pd(&inputs->table_lower[ii])),
+                                               _mm256_mul_pd(upper_weight, _mm256_loadu_pd(&inputs->table_upper[ii])));
+
+          interpolated = _mm256_blendv_pd(interpolated, minimum, _mm256_cmp_pd(interpolated, minimum, _CMP_LT_OQ));
+          interpolated = _mm256_blendv_pd(interpolated, maximum, _mm256_cmp_pd(interpolated, maximum, _CMP_GT_OQ));
+          dry_depth    = _mm256_blendv_pd(dry_depth, interpolated, _mm256_cmp_pd(_mm256_add_pd(dry_depth, top), surface_front, _CMP_GE_OQ));
+        }
+
+      green_ampt = _mm256_mul_pd(_mm256_mul_pd(rate, _mm256_add_pd(_mm256_div_pd(suction, surface_front), one)), dt);
+      green_ampt = _mm256_blendv_pd(green_ampt, dry_depth, _mm256_cmp_pd(_mm256_add_pd(dry_depth, top), surface_front, _CMP_GE_OQ));
+      green_ampt = _mm256_blendv_pd(green_ampt, zero,
+                                    _mm256_cmp_pd(_mm256_add_pd(_mm256_loadu_pd(&inputs->bin_capillary_suction[ii]), head), zero, _CMP_LE_OQ));
+
+      _mm256_storeu_pd(&distance[ii], green_ampt);
+    }
+
+  for (; ii <= num_bins; ii++)
+    {
+      distance[ii] = infiltrate_distance_bin(inputs, ii);
+    }
+}
+
+/* The AVX-512 infiltrate_distance kernel.  The same as
+ * infiltrate_distance_avx2 except eight bins are done at a time.
+ * Floating point contraction is turned off because AVX-512 has fused
+ * multiply add, which would round differently from the scalar code.
+ */
+__attribute__((target("avx512f"), optimize("fp-contract=off"))) void infiltrate_distance_avx512(const infiltrate_kernel_inputs* inputs, int num_bins,
+                                                                                              double* distance)
+{
+  int     ii           = inputs->first_bin; // Loop counter.
+  __m512d zero         = _mm512_setzero_pd();
+  __m512d one          = _mm512_set1_pd(1.0);
+  __m512d top          = _mm512_set1_pd(inputs->layer_top_depth);
+  __m512d head         = _mm512_set1_pd(inputs->surfacewater_head);
+  __m512d lower_weight = _mm512_set1_pd(1.0 - inputs->table_weight);
+  __m512d upper_weight = _mm512_set1_pd(inputs->table_weight);
+  __m512d minimum      = _mm512_set1_pd(MINIMUM_DRY_DEPTH);
+  __m512d maximum      = _mm512_set1_pd(inputs->maximum_dry_depth);
+  __m512d rate         = _mm512_set1_pd(inputs->rate);
+  __m512d suction      = _mm512_set1_pd(inputs->suction);
+  __m512d dt           = _mm512_set1_pd(inputs->dt);
+
+  assert(!inputs->calculate_dry_depth || NULL != inputs->table_lower);
+
+  for (; ii + 7 <= num_bins; ii += 8)
+    {
+      __m512d surface_front = _mm512_loadu_pd(&inputs->surface_front[ii]);
+      __m512d dry_depth     = _mm512_loadu_pd(&inputs->cached_dry_depth[ii]);
+      __m512d green_ampt;
+
+      if (inputs->calculate_dry_depth)
+        {
+          __m512d interpolated = _mm512_add_pd(_mm512_mul_pd(lower_weight, _mm512_loadu_pd(&inputs->table_lower[ii])),
+                                               _mm512_mul_pd(upper_weight, _mm512_loadu_pd(&inputs->table_upper[ii])));
+
+          interpolated = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(interpolated, minimum, _CMP_LT_OQ), interpolated, minimum);
+          interpolated = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(interpolated, maximum, _CMP_GT_OQ), interpolated, maximum);
+          dry_depth    = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(_mm512_add_pd(dry_depth, top), surface_front, _CMP_GE_OQ), dry_depth, interpolated);
+        }
+
+      green_ampt = _mm512_mul_pd(_mm512_mul_pd(rate, _mm512_add_pd(_mm512_div_pd(suction, surface_front), one)), dt);
+      green_ampt = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(_mm512_add_pd(dry_depth, top), surface_front, _CMP_GE_OQ), green_ampt, dry_depth);
+      green_ampt = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(_mm512_add_pd(_mm512_loadu_pd(&inputs->bin_capillary_suction[ii]), head), zero,
+                                                           _CMP_LE_OQ), green_ampt, zero);
+
+      _mm512_storeu_pd(&distance[ii], green_ampt);
+    }
+
+  for (; ii <= num_bins; ii++)
+    {
+      distance[ii] = infiltrate_distance_bin(inputs, ii);
+    }
+}
+#endif // SIMD_KERNELS
+
+/* Get the Green-Ampt rate and suction that move the wet surface fronts.
+ * They come from the rightmost bin with surface front water, and if all of
+ * the wet bins are left of first_bin they are not used.
+ *
+ * Parameters:
+ *
+ * domain            - A pointer to the t_o_domain struct.
+ * first_bin         - The leftmost bin that is not completely full of water.
+ * surfacewater_head - The pressure head in meters of the surface water.
+ * rate              - A scalar passed by reference that gets set to the rate
+ *                     in meters per second.
+ * suction           - A scalar passed by reference that gets set to the
+ *                     clipped capillary suction plus surfacewater_head in
+ *                     meters.
+ */
+void infiltrate_rate_and_suction(t_o_domain* domain, int first_bin, double surfacewater_head, double* rate, double* suction)
+{
+  int last_bin = find_last_bin(domain); // The rightmost bin that has surface front water.
+
+  while (last_bin >= first_bin && 0 >= domain->parameters->bin_capillary_suction[last_bin] + surfacewater_head)
+    {
+      last_bin--;
+    }
+
+  // Clip capillary suction with effective capillary suction.
+  double last_bin_capillary_suction = domain->parameters->bin_capillary_suction[last_bin];
+
+  if (last_bin_capillary_suction < domain->parameters->effective_capillary_suction)
+    {
+      last_bin_capillary_suction = domain->parameters->effective_capillary_suction;
+    }
+
+  // If last_bin is equal to first_bin - 1 these are not used.
+  *rate    = (domain->parameters->cumulative_conductivity[last_bin] - domain->parameters->cumulative_conductivity[first_bin - 1]) /
+      (domain->parameters->bin_water_content[last_bin] - domain->parameters->bin_water_content[first_bin - 1]);
+  *suction = last_bin_capillary_suction + surfacewater_head;
+}
+
+/* Calculate the distance in meters that water will infiltrate into all of the
+ * bins in one timestep.
+ * Return TRUE if there is an error, FALSE otherwise.
+ * The only error is failing to update the dry depth cache.
+ *
+ * Parameters:
+ *
+ * domain            - A pointer to the t_o_domain struct.
+ * dt                - The duration of the timestep in seconds.
+ * first_bin         - The leftmost bin that is not completely full of water.
+ * surfacewater_head - The pressure head in meters of the surface water.
+ * distance          - A 1D array sized to hold domain->parameters->num_bins
+ *                     elements with one based indexing.  distance[ii] is
+ *                     filled in with the distance that water will infiltrate
+ *                     into bin ii this timestep.
+ * update_dry_depth  - Whether to call update_dry_depth_cache.  Pass FALSE
+ *                     only if the caller has already called it for dt.
+ * kernel            - Which kernel to use.  One of SIMD_KERNEL_SCALAR,
+ *                     SIMD_KERNEL_AVX2, or SIMD_KERNEL_AVX512.  Must not be
+ *                     more than best_simd_kernel.  If dt is below the dry
+ *                     depth table grid the scalar kernel is used anyway.
+ */
+int infiltrate_distance_with_kernel(t_o_domain* domain, double dt, int first_bin, double surfacewater_head, double* distance, int update_dry_depth,
+                                    int kernel)
+{
+  assert(NULL != domain && 0.0 < dt && NULL != distance && kernel <= best_simd_kernel());
+
+  int                      error = FALSE; // Error flag.
+  t_o_dry_depth_cache*     cache;         // The dry depth snapshot used for the whole calculation.
+  infiltrate_kernel_inputs inputs;        // The inputs that are the same for every bin.
+
+  if (update_dry_depth)
+    {
+      error = update_dry_depth_cache(domain->parameters, dt);
+    }
+
+  // Load the snapshot once.  It can be read without locking because published snapshots are never modified.
+  cache = atomic_load_explicit(&domain->parameters->dry_depth_cache, memory_order_acquire);
+
+  assert(error || cache->dt >= dt);
+
+  inputs.parameters            = domain->parameters;
+  inputs.first_bin             = first_bin;
+  inputs.dt                    = dt;
+  inputs.layer_top_depth       = domain->layer_top_depth;
+  inputs.surfacewater_head     = surfacewater_head;
+  inputs.surface_front         = domain->surface_front;
+  inputs.bin_capillary_suction = domain->parameters->bin_capillary_suction;
+  inputs.cached_dry_depth      = cache->bin_dry_depth;
+  inputs.calculate_dry_depth   = cache->dt > dt;
+  inputs.table_lower           = NULL;
+  inputs.table_upper           = NULL;
+  inputs.table_weight          = 0.0;
+  inputs.maximum_dry_depth     = 0.0;    // Meters.  Interpolated maximum dry depth clamp.
+  inputs.integrator            = domain->integrator;
+
+  // For timesteps smaller than the cached timestep, interpolate in the dry depth table if dt is within its grid.
+  if (!error && inputs.calculate_dry_depth)
+    {
+      int table_index = 0; // Grid index at or below dt.
+
+      if (dry_depth_table_position(domain->parameters, dt, &table_index, &inputs.table_weight))
+        {
+          inputs.table_lower       = domain->parameters->dry_depth_table[table_index];
+          inputs.table_upper       = domain->parameters->dry_depth_table[table_index + 1];
+          inputs.maximum_dry_depth = 10.0 * max(MINIMUM_DRY_DEPTH, (1.0 - inputs.table_weight) *
+                                                domain->parameters->dry_depth_table_green_ampt[table_index] +
+                                                inputs.table_weight * domain->parameters->dry_depth_table_green_ampt[table_index + 1]);
+        }
+    }
+
+  infiltrate_rate_and_suction(domain, first_bin, surfacewater_head, &inputs.rate, &inputs.suction);
+
+  if (!error)
+    {
+#ifdef SIMD_KERNELS
+      if ((inputs.calculate_dry_depth && NULL == inputs.table_lower) || T_O_INTEGRATOR_EULER != inputs.integrator)
+        {
+          // t_o_find_dry_depth can only be called one bin at a time, and the vector kernels only do Euler.
+          kernel = SIMD_KERNEL_SCALAR;
+        }
+
+      if (SIMD_KERNEL_AVX512 == kernel)
+        {
+          infiltrate_distance_avx512(&inputs, domain->parameters->num_bins, distance);
+        }
+      else if (SIMD_KERNEL_AVX2 == kernel)
+        {
+          infiltrate_distance_avx2(&inputs, domain->parameters->num_bins, distance);
+        }
+      else
+#endif // SIMD_KERNELS
+        {
+          infiltrate_distance_scalar(&inputs, domain->parameters->num_bins, distance);
+        }
+    }
+
+  return error;
+}
+
+/* Calculate the distance in meters that water will infiltrate into all of the
+ * bins in one timestep with the fastest kernel the CPU supports.  See
+ * infiltrate_distance_with_kernel for the return value and parameters.
+ */
+int infiltrate_distance(t_o_domain* domain, double dt, int first_bin, double surfacewater_head, double* distance, int update_dry_depth)
+{
+  return infiltrate_distance_with_kernel(domain, dt, first_bin, surfacewater_head, distance, update_dry_depth, best_simd_kernel());
+}
+
+/* Process infiltration into not completely saturated bins.
+ * Return TRUE if there is an error, FALSE otherwise.
+ * The only error is failing to allocate memory for the dry depth cache.
+ * This function takes water from the surface and then from surface front
+ * water in bins to the right if there is not enough surface water.
+ * If domain->yes_groundwater is FALSE then surface front water might
+ * fall out the bottom of the domain.  This water is accounted for in
+ * groundwater_recharge
+ *
+ * Parameters:
+ *
+ * domain               - A pointer to the t_o_domain struct.
+ * dt                   - The duration of the timestep in seconds.
+ * first_bin            - A scalar passed by reference containing the leftmost
+ *                        bin that is not completely full of water.  Will be
+ *                        updated to the new value after infiltration.
+ * surfacewater_head    - The pressure head in meters of the surface water.
+ *                        Normally, you will pass the same value as
+ *                        surfacewater_depth, but this can be used to simulate
+ *                        various laboratory test conditions.
+ * surfacewater_depth   - A scalar passed by reference containing the depth
+ *                        in meters of the surface water.  Will be updated for
+ *                        the amount of infiltration.
+ * groundwater_recharge - A scalar passed by reference containing any
+ *                        previously accumulated groundwater recharge in meters
+ *                        of water.  Will be updated for the amount of water
+ *                        that flowed between the Talbot-Ogden domain and
+ *                        groundwater.  Positive means water flowed down out of
+ *                        the Talbot-Ogden domain.  Negative means water flowed
+ *                        up in to the Talbot-Ogden domain.
+ * ponded_water         - If ponded water is TRUE infiltrate even if
+ *                        surfacewater_depth is zero.
+ * update_dry_depth     - Whether infiltrate_distance needs to update the dry
+ *                        depth cache.  See update_dry_depth_cache.
+ */
+int t_o_infiltrate(t_o_domain* domain, double dt, int* first_bin, double surfacewater_head, double* surfacewater_depth, double* groundwater_recharge, 
+                   int ponded_water, int update_dry_depth)
+{
+  int error = FALSE; // Error flag.
+  int ii;            // Loop counter.
+
+  assert(NULL != domain && 0.0 < dt && NULL != surfacewater_depth && 0.0 <= *surfacewater_depth && NULL != groundwater_recharge);
+
+  if (0.0 < *surfacewater_depth || ponded_water)
+    {
+      double delta_z[domain->parameters->num_bins + 1]; // The distance that water can infiltrate into each bin this timestep.
+
+      // Calculate the depth that water can infiltrate into each bin.
+      error = infiltrate_distance(domain, dt, *first_bin, surfacewater_head, delta_z, update_dry_depth);
+
+      // All bins to the left of firstbin have already had their demand satisfied by satisfy_saturated_bins so start processing at first_bin.
+      for (ii = *first_bin; !error && ii <= domain->parameters->num_bins; ii++)
+        {
+          double supplied_z = 0.0; // Depth actually infiltrated.
+
+          // Infiltration might be limited by the surface water hitting a slug or groundwater.
+          int hit_slug        = FALSE;
+          int hit_groundwater = FALSE;
+
+          if (NULL != domain->top_slug[ii])
+            {
+              double gap = (domain->top_slug[ii]->top - domain->surface_front[ii]);
+
+              if (delta_z[ii] >= gap)
+                {
+                  delta_z[ii]  = gap;
+                  hit_slug     = TRUE;
+                }
+            }
+          else if (domain->yes_groundwater)
+            {
+              double gap = (domain->groundwater_front[ii] - domain->surface_front[ii]);
+
+              if (delta_z[ii] >= gap)
+                {
+                  delta_z[ii]  = gap;
+                  hit_groundwater = TRUE;
+                }
+            }
+
+          // Satisfy as much of the demand as possible from surface water.
+          if (*surfacewater_depth >= delta_z[ii] * domain->parameters->delta_water_content)
+            {
+              *surfacewater_depth -= delta_z[ii] * domain->parameters->delta_water_content;
+              supplied_z          += delta_z[ii];
+              delta_z[ii]          = 0.0;
+            }
+          else if (0.0 < *surfacewater_depth)
+            {
+              supplied_z          += *surfacewater_depth / domain->parameters->delta_water_content;
+              delta_z[ii]         -= *surfacewater_depth / domain->parameters->delta_water_content;
+              *surfacewater_depth  = 0.0;
+            }
+
+          // Satisfy the rest of the demand from the rightmost bin that has surface front water.
+
+          int get_bin = domain->parameters->num_bins; // The bin to get water from.
+
+          while (0.0 < delta_z[ii] && get_bin > ii)
+            {
+              if (domain->surface_front[get_bin] - domain->layer_top_depth >= delta_z[ii])
+                {
+                  // The bin has enough to completely satisfy remaining demand.
+                  set_surface_front(domain, get_bin, domain->surface_front[get_bin] - delta_z[ii]);
+                  supplied_z                     += delta_z[ii];
+                  delta_z[ii]                     = 0.0;
+                }
+              else
+                {
+                  // Get everything the bin has, if any, and go on to the next bin.
+                  if (0.0 < domain->surface_front[get_bin] - domain->layer_top_depth)
+                    {   
+                      supplied_z                     += domain->surface_front[get_bin] - domain->layer_top_depth;
+                      delta_z[ii]                    -= domain->surface_front[get_bin] - domain->layer_top_depth;
+                      set_surface_front(domain, get_bin, domain->layer_top_depth);
+                    }
+                 
+                  get_bin--;
+                }
+            }
+
+          // Add the water to the surface front water in this bin.
+          if (hit_slug && 0.0 == delta_z[ii])
+            {
+              // Surface water reaches the top slug.
+              set_surface_front(domain, ii, domain->top_slug[ii]->bot);
+              kill_slug(domain, ii, domain->top_slug[ii]);
+            }
+          else if (hit_groundwater && 0.0 == delta_z[ii])
+            {
+              // Surface water reaches groundwater.
+              set_surface_front(domain, ii, domain->layer_top_depth);
+              set_groundwater_front(domain, ii, domain->layer_top_depth);
+            }
+          else if (domain->surface_front[ii] + supplied_z > domain->layer_bottom_depth)
+            {
+              // Surface water reaches the bottom of the domain.
+              *groundwater_recharge += (domain->surface_front[ii] + supplied_z - domain->layer_bottom_depth) * domain->parameters->delta_water_content;
+              set_surface_front(domain, ii, domain->layer_bottom_depth);
+            }
+          else
+            {
+              // Advance surface_front.
+              set_surface_front(domain, ii, domain->surface_front[ii] + supplied_z);
+            }
+        } // End loop over all bins starting at first_bin
+      
+      // first_bin can only change if there was infiltration, and it can only move to the right.
+      *first_bin = find_first_bin(domain, *first_bin);
+    } // End if (0.0 < *surfacewater_depth)
+
+  return error;
+}
+
+#define SLUG_INDEX_CELLS (64) // The number of depth cells in a slug_index occupancy mask.  One per bit of an unsigned long long.
+
+/* A slug_index is a segment tree over the bins of a t_o_domain used to find
+ * the rightmost bin with a slug overlapping a range of depths without
+ * walking the slug lists of every bin.  Node 1 is the root.  Node nn has
+ * children 2 * nn and 2 * nn + 1.  Bin ii is leaf size + ii - 1.
+ *
+ * The depth of the domain is divided into SLUG_INDEX_CELLS cells.  Each node
+ * stores a mask with a bit set for every cell that has a slug in any of the
+ * bins it covers.  A node whose mask has no bits in common with the cells of
+ * the search range cannot contain an overlapping slug and is skipped, so a
+ * search only walks the slug lists of bins that might have an overlapping
+ * slug.
+ *
+ * The masks only need to contain the slugs, not match them exactly, so
+ * shrinking or killing a slug never makes the index wrong.  Anything that
+ * moves a slug outside of its bin's mask must call slug_index_update.
+ */
+typedef struct
+{
+  int                 size;      // The number of leaves.  A power of two greater than or equal to num_bins.
+  double              cell_size; // The depth of each cell in meters.
+  unsigned long long* mask;      // 1D array of 2 * size elements with the occupied cell mask of each node.
+} slug_index;
+
+/* Return the mask of the cells of a slug_index from top to bot.  top and bot
+ * are swapped if they are out of order so that the mask of a slug that has
+ * been squeezed upside down still contains every depth it can overlap.
+ *
+ * Parameters:
+ *
+ * domain - A pointer to the t_o_domain struct.
+ * index  - A pointer to the slug_index struct.
+ * top    - The depth in meters of the top    of the range.
+ * bot    - The depth in meters of the bottom of the range.
+ */
+unsigned long long slug_index_cells(t_o_domain* domain, slug_index* index, double top, double bot)
+{
+  int top_cell = (int)((min(top, bot) - domain->layer_top_depth) / index->cell_size);
+  int bot_cell = (int)((max(top, bot) - domain->layer_top_depth) / index->cell_size);
+
+  // Depths outside of the domain go in the end cells.
+  top_cell = max(0, min(top_cell, SLUG_INDEX_CELLS - 1));
+  bot_cell = max(0, min(bot_cell, SLUG_INDEX_CELLS - 1));
+
+  return (~0ULL >> (SLUG_INDEX_CELLS - 1 - bot_cell)) & (~0ULL << top_cell);
+}
+
+/* Set the mask of a bin in a slug_index to the cells of its current slugs
+ * and update the masks of all nodes above it.
+ *
+ * Parameters:
+ *
+ * domain - A pointer to the t_o_domain struct.
+ * index  - A pointer to the slug_index struct.
+ * bin    - Which bin to update.
+ */
+void slug_index_update(t_o_domain* domain, slug_index* index, int bin)
+{
+  assert(NULL != domain && NULL != index && 0 < bin && bin <= domain->parameters->num_bins);
+
+  int   node      = index->size + bin - 1; // The leaf for bin.
+  slug* temp_slug = domain->top_slug[bin];
+
+  index->mask[node] = 0ULL;
+
+  while (NULL != temp_slug)
+    {
+      index->mask[node] |= slug_index_cells(domain, index, temp_slug->top, temp_slug->bot);
+      temp_slug          = temp_slug->next;
+    }
+
+  for (node /= 2; 0 < node; node /= 2)
+    {
+      index->mask[node] = index->mask[2 * node] | index->mask[2 * node + 1];
+    }
+}
+
+/* Fill in the masks of every node of a slug_index from the current slugs of
+ * a domain.  size and mask must already be set.
+ *
+ * Parameters:
+ *
+ * domain - A pointer to the t_o_domain struct.
+ * index  - A pointer to the slug_index struct.
+ */
+void slug_index_build(t_o_domain* domain, slug_index* index)
+{
+  assert(NULL != domain && NULL != index && domain->parameters->num_bins <= index->size);
+
+  int ii;   // Loop counter.
+  int node; // Loop counter.
+
+  index->cell_size = (domain->layer_bottom_depth - domain->layer_top_depth) / SLUG_INDEX_CELLS;
+
+  for (ii = 1; ii <= index->size; ii++)
+    {
+      slug* temp_slug = (ii <= domain->parameters->num_bins) ? domain->top_slug[ii] : NULL;
+
+      node              = index->size + ii - 1;
+      index->mask[node] = 0ULL;
+
+      while (NULL != temp_slug)
+        {
+          index->mask[node] |= slug_index_cells(domain, index, temp_slug->top, temp_slug->bot);
+          temp_slug          = temp_slug->next;
+        }
+    }
+
+  for (node = index->size - 1; 0 < node; node--)
+    {
+      index->mask[node] = index->mask[2 * node] | index->mask[2 * node + 1];
+    }
+}
+
+/* Return the rightmost bin from first_bin to last_bin under node that has a
+ * slug overlapping top to bot or zero if there is none.  Overlapping
+ * includes touching.
+ *
+ * Parameters:
+ *
+ * domain     - A pointer to the t_o_domain struct.
+ * index      - A pointer to the slug_index struct.
+ * node       - Which node of index to search under.
+ * node_first - The leftmost  bin under node.
+ * node_last  - The rightmost bin under node.
+ * first_bin  - The leftmost  bin to search.
+ * last_bin   - The rightmost bin to search.
+ * cells      - The mask of the cells from top to bot.
+ * top        - The depth in meters of the top    of the range to search for.
+ * bot        - The depth in meters of the bottom of the range to search for.
+ */
+int slug_index_search(t_o_domain* domain, slug_index* index, int node, int node_first, int node_last, int first_bin, int last_bin,
+                      unsigned long long cells, double top, double bot)
+{
+  int found_bin = 0; // The rightmost bin found.
+
+  if (node_first <= last_bin && node_last >= first_bin && 0ULL != (index->mask[node] & cells))
+    {
+      if (node >= index->size)
+        {
+          // Leaf.  Check the slugs of the bin.
+          slug* temp_slug = domain->top_slug[node_first];
+
+          while (NULL != temp_slug && temp_slug->bot < top)
+            {
+              temp_slug = temp_slug->next;
+            }
+
+          if (NULL != temp_slug && temp_slug->top <= bot)
+            {
+              found_bin = node_first;
+            }
+        }
+      else
+        {
+          int node_middle = node_first + (node_last - node_first) / 2; // The rightmost bin under the left child.
+
+          found_bin = slug_index_search(domain, index, 2 * node + 1, node_middle + 1, node_last, first_bin, last_bin, cells, top, bot);
+
+          if (0 == found_bin)
+            {
+              found_bin = slug_index_search(domain, index, 2 * node, node_first, node_middle, first_bin, last_bin, cells, top, bot);
+            }
+        }
+    }
+
+  return found_bin;
+}
+
+/* Return the rightmost bin from first_bin to last_bin that has a slug
+ * overlapping top to bot or zero if there is none.  Overlapping includes
+ * touching.
+ *
+ * Parameters:
+ *
+ * domain    - A pointer to the t_o_domain struct.
+ * index     - A pointer to the slug_index struct.
+ * first_bin - The leftmost  bin to search.
+ * last_bin  - The rightmost bin to search.
+ * top       - The depth in meters of the top    of the range to search for.
+ * bot       - The depth in meters of the bottom of the range to search for.
+ */
+int find_overlapping_bin(t_o_domain* domain, slug_index* index, int first_bin, int last_bin, double top, double bot)
+{
+  assert(NULL != domain && NULL != index);
+
+  return slug_index_search(domain, index, 1, 1, index->size, first_bin, last_bin, slug_index_cells(domain, index, top, bot), top, bot);
+}
+
+/* Calculate the distance in meters that a slug will move in one timestep.
+ * This distance can be different for the top and bottom of the slug.
+ * Rather than returning one value it uses two output parameters.
+ *
+ * Parameters:
+ *
+ * domain       - A pointer to the t_o_domain struct.
+ * bin          - Which bin falling_slug is in.
+ * first_bin    - The leftmost bin that is not completely full of water.
+ * dt           - The duration of the timestep in seconds.
+ * falling_slug - Which slug to determine the distance for.
+ * index        - A slug_index of domain used to find connected slugs.
+ * top_distance - A scalar passed by reference that gets set to the distance
+ *                in meters that the top of the slug will move.
+ *                Positive means down toward the bottom of the domain.
+ * bot_distance - A scalar passed by reference that gets set to the distance
+ *                in meters that the bottom of the slug will move.
+ *                Positive means down toward the bottom of the domain.
+ */
+void slug_fall_distance(t_o_domain* domain, int bin, int first_bin, double dt, slug* falling_slug, slug_index* index, double* top_distance,
+                        double* bot_distance)
+{
+  int ii; // The rightmost bin with a connected slug or zero if there is none.
+
+  assert(NULL != domain && 0 < bin && bin <= domain->parameters->num_bins && 0 < first_bin && first_bin <= domain->parameters->num_bins &&
+      0.0 < dt && NULL != falling_slug && NULL != index && NULL != top_distance && NULL != bot_distance);
+
+  // find the capillary suction of the rightmost bin with a connected slug that this slug can steal water from.
+  ii = find_overlapping_bin(domain, index, bin + 1, domain->parameters->num_bins, falling_slug->top, falling_slug->bot);
+
+  double distance = ((domain->parameters->cumulative_conductivity[bin] - domain->parameters->cumulative_conductivity[bin - 1]) /
+      domain->parameters->delta_water_content) * dt;
+
+  double growth;
+
+  if (0 == ii)
+    {
+      growth = 0.0;
+    }
+  else
+    {
+      growth = ((domain->parameters->cumulative_conductivity[bin] - domain->parameters->cumulative_conductivity[first_bin - 1]) /
+          (domain->parameters->bin_water_content[bin] - domain->parameters->bin_water_content[first_bin - 1])) *
+              ((domain->parameters->bin_capillary_suction[bin] - domain->parameters->bin_capillary_suction[ii]) /
+                  ((falling_slug->bot - falling_slug->top) / 2.0)) * dt;
+    }
+
+  *top_distance = distance - growth;
+  *bot_distance = distance + growth;
+}
+
+/* Process the falling slugs step of the simulation.
+ * Return TRUE if there is an error, FALSE otherwise.
+ * Actually always return FALSE.  No conditions generate an error.
+ * If domain->groundwater_yes is FALSE then slugs might fall out the bottom of
+ * the domain.  This water is accounted for in groundwater_recharge
+ *
+ * Parameters:
+ *
+ * domain               - A pointer to the t_o_domain struct.
+ * dt                   - The duration of the timestep in seconds.
+ * first_bin            - The leftmost bin that is not completely full of
+ *                        water.
+ * groundwater_recharge - A scalar passed by reference containing any
+ *                        previously accumulated groundwater recharge in meters
+ *                        of water.  Will be updated for the amount of water
+ *                        that flowed between the Talbot-Ogden domain and
+ *                        groundwater.  Positive means water flowed down out of
+ *                        the Talbot-Ogden domain.  Negative means water flowed
+ *                        up in to the Talbot-Ogden domain.
+ */
+int t_o_falling_slugs(t_o_domain* domain, double dt, int first_bin, double* groundwater_recharge)
+{
+  assert(NULL != domain && 0.0 < dt && NULL != groundwater_recharge);
+
+  int        error = FALSE; // Error flag.
+  int        ii;            // Loop counter.
+  slug_index index;         // Used to find connected slugs without searching every bin.
+
+  // The number of leaves is the smallest power of two that is at least num_bins.
+  index.size = 1;
+
+  while (index.size < domain->parameters->num_bins)
+    {
+      index.size *= 2;
+    }
+
+  unsigned long long index_mask[2 * index.size];
+
+  index.mask = index_mask;
+
+  slug_index_build(domain, &index);
+
+  // Process all bins except bin 1, which is guaranteed to be completely full of water and thus have no slugs.
+  for (ii = 2; ii <= domain->parameters->num_bins; ii++)
+    {
+      // Process the slugs from bottom up.
+      slug* temp_slug = domain->bot_slug[ii];
+
+      while (NULL != temp_slug)
+        {
+          double top_delta_z; // The distance the top    of the slug will move.
+          double bot_delta_z; // The distance the bottom of the slug will move.
+
+          // Calculate the distance the slug will move this timestep.
+          slug_fall_distance(domain, ii, first_bin, dt, temp_slug, &index, &top_delta_z, &bot_delta_z);
+
+          // FIXME deal with this
+          // Prevent the slug from moving upward.
+          if (0.0 >= top_delta_z)
+            {
+              top_delta_z = 0.000001;
+            }
+
+          if (0.0 >= bot_delta_z)
+            {
+              bot_delta_z = 0.000001;
+            }
+
+          // Stop the slug if it hits a lower slug or groundwater.
+          if (NULL != temp_slug->next)
+            {
+              if (bot_delta_z > temp_slug->next->top - temp_slug->bot)
+                {
+                  bot_delta_z = temp_slug->next->top - temp_slug->bot;
+                }
+            }
+          else if (domain->yes_groundwater)
+            {
+              if (bot_delta_z > domain->groundwater_front[ii] - temp_slug->bot)
+                {
+                  bot_delta_z = domain->groundwater_front[ii] - temp_slug->bot;
+                }
+            }
+
+          // Prevent the slug from shrinking.
+          if (top_delta_z > bot_delta_z)
+            {
+              top_delta_z = bot_delta_z;
+            }
+
+          // If the slug grows, steal the water from the rightmost overlapping slug, and the topmost if there are multiple rightmost.
+          // FIXME steal from all connected slugs to the right with weights.
+          double demand  = bot_delta_z - top_delta_z; // Needed water in meters of bin depth.
+          int    get_bin = 0;                         // Which bin to try to get from.
+
+          if (0.0 < demand)
+            {
+              get_bin = find_overlapping_bin(domain, &index, ii + 1, domain->parameters->num_bins, temp_slug->top, temp_slug->bot);
+            }
+
+          while (0.0 < demand && 0 != get_bin)
+            {
+              slug* get_slug = domain->top_slug[get_bin]; // Which slug to try to get from.
+
+              while (0.0 < demand && NULL != get_slug && temp_slug->bot >= get_slug->top)
+                {
+                  // Save a pointer to the slug below get_slug in case we need to kill get_slug.
+                  slug* next_slug = get_slug->next;
+
+                  if (temp_slug->top <= get_slug->bot && temp_slug->bot >= get_slug->top)
+                    {
+                      // We can get water from get_slug.
+                      if (get_slug->bot - get_slug->top >= demand)
+                        {
+                          // FIXLATER more complicated than taking equally from top and bot?
+                          set_slug_top(domain, get_bin, get_slug, get_slug->top + demand / 2.0);
+                          set_slug_bot(domain, get_bin, get_slug, get_slug->bot - demand / 2.0);
+                          demand = 0.0;
+                        }
+                      else
+                        {
+                          demand -= get_slug->bot - get_slug->top;
+                          kill_slug(domain, get_bin, get_slug);
+                        }
+                    }
+
+                  get_slug = next_slug;
+                }
+
+              slug_index_update(domain, &index, get_bin);
+
+              if (0.0 < demand)
+                {
+                  get_bin = find_overlapping_bin(domain, &index, ii + 1, get_bin - 1, temp_slug->top, temp_slug->bot);
+                }
+            }
+
+          // If we couldn't get all of the desired water take the deficit equally from the top and bottom of where the slug wants to be.
+          // FIXLATER more complicated than taking equally from top and bot?
+          if (0.0 < demand)
+            {
+              top_delta_z += demand / 2.0;
+              bot_delta_z -= demand / 2.0;
+            }
+
+          // Save a pointer to the slug above temp_slug in case we need to kill temp_slug.
+          slug* prev_slug = temp_slug->prev;
+
+          if (NULL == temp_slug->next)
+            {
+              // The bottom slug might hit the groundwater or fall beyond layer_depth.
+              if (domain->yes_groundwater)
+                {
+                  if (temp_slug->bot + bot_delta_z >= domain->groundwater_front[ii])
+                    {
+                      // The slug hits groundwater.
+                      set_groundwater_front(domain, ii, domain->groundwater_front[ii] - ((temp_slug->bot + bot_delta_z) - (temp_slug->top + top_delta_z)));
+                      kill_slug(domain, ii, temp_slug);
+                    }
+                  else
+                    {
+                      // Advance the slug.
+                      set_slug_top(domain, ii, temp_slug, temp_slug->top + top_delta_z);
+                      set_slug_bot(domain, ii, temp_slug, temp_slug->bot + bot_delta_z);
+                    }
+                }
+              else
+                {
+                  if (temp_slug->top + top_delta_z >= domain->layer_bottom_depth)
+                    {
+                      // The slug falls entirely past layer_depth.
+                      *groundwater_recharge += ((temp_slug->bot + bot_delta_z) - (temp_slug->top + top_delta_z)) * domain->parameters->delta_water_content;
+                      kill_slug(domain, ii, temp_slug);
+                    }
+                  else if (temp_slug->bot + bot_delta_z > domain->layer_bottom_depth)
+                    {
+                      // The slug falls partially past layer depth.
+                      *groundwater_recharge += (temp_slug->bot + bot_delta_z - domain->layer_bottom_depth) * domain->parameters->delta_water_content;
+                      set_slug_top(domain, ii, temp_slug, temp_slug->top + top_delta_z);
+                      set_slug_bot(domain, ii, temp_slug, domain->layer_bottom_depth);
+                    }
+                  else
+                    {
+                      // Advance the slug.
+                      set_slug_top(domain, ii, temp_slug, temp_slug->top + top_delta_z);
+                      set_slug_bot(domain, ii, temp_slug, temp_slug->bot + bot_delta_z);
+                    }
+                }
+            }
+          else
+            {
+              // A middle slug might hit the slug below it.
+              if (temp_slug->bot + bot_delta_z >= temp_slug->next->top)
+                {
+                  // The slug hits the slug below it.
+                  set_slug_top(domain, ii, temp_slug->next, temp_slug->next->top - ((temp_slug->bot + bot_delta_z) - (temp_slug->top + top_delta_z)));
+                  kill_slug(domain, ii, temp_slug);
+                }
+              else
+                {
+                  // Advance the slug.
+                  set_slug_top(domain, ii, temp_slug, temp_slug->top + top_delta_z);
+                  set_slug_bot(domain, ii, temp_slug, temp_slug->bot + bot_delta_z);
+                }
+            }
+
+          temp_slug = prev_slug;
+        } // End while (NULL != temp_slug).
+
+      // The slugs in this bin moved down.
+      slug_index_update(domain, &index, ii);
+    } // End for (ii = 2; ii <= domain->parameters->num_bins; ii++).
+
+  return error;
+}
+
+/* Return the depth in meters of a groundwater front after dt seconds of
+ * moving at rate * (1 - suction / u) where u is the distance from the front
+ * to the water table.  With e = u - suction that integrates to
+ * e + suction * ln(e) = e0 + suction * ln(e0) - rate * t.  Writing
+ * e = e0 * exp(x) gives e0 * (exp(x) - 1) + suction * x + rate * dt = 0,
+ * which is increasing in x and convex or concave depending on the sign of
+ * e0, so Newton's method started on the correct side of the root converges
+ * monotonically.
+ *
+ * Parameters:
+ *
+ * front       - The depth in meters of the groundwater front.  Must be above
+ *               the water table.
+ * water_table - The depth in meters of the water table.
+ * suction     - The hydrostatic capillary suction in meters.
+ * rate        - The rate in meters per second.
+ * dt          - The time in seconds.
+ */
+double green_ampt_groundwater_depth(double front, double water_table, double suction, double rate, double dt)
+{
+  assert(front < water_table && 0.0 < suction && 0.0 <= rate && 0.0 < dt);
+
+  double e0                = (water_table - front) - suction; // Distance in meters above hydrostatic at the start.
+  double x                 = 0.0;                             // Log of the fraction of e0 left.
+  double delta_x;                                             // Newton step.
+  int    iteration_count   = 0;
+  int    maximum_iteration = 100;
+
+  if (0.0 > e0)
+    {
+      // Concave.  Start to the left of the root.
+      x = -rate * dt / (suction + e0);
+    }
+
+  if (0.0 != e0)
+    {
+      do
+        {
+          delta_x = -(e0 * (exp(x) - 1.0) + suction * x + rate * dt) / (e0 * exp(x) + suction);
+          x      += delta_x;
+          iteration_count++;
+        }
+      while (fabs(delta_x) > 1.0e-12 * (1.0 + fabs(x)) && iteration_count < maximum_iteration);
+    }
+
+  return water_table - (suction + e0 * exp(x));
+}
+
+/* Return the distance in meters a groundwater front moves in one timestep
+ * with an integrator.  Positive means down toward the bottom of the domain.
+ * The distance is not limited to the hydrostatic depth, but the Runge-Kutta
+ * stages are because the speed is singular at the water table on the far
+ * side of it.
+ *
+ * Parameters:
+ *
+ * integrator  - One of the T_O_INTEGRATOR constants.
+ * front       - The depth in meters of the groundwater front.  Must be above
+ *               the water table.
+ * water_table - The depth in meters of the water table.
+ * suction     - The hydrostatic capillary suction in meters.
+ * rate        - The rate in meters per second.
+ * dt          - The duration of the timestep in seconds.
+ */
+double groundwater_step(int integrator, double front, double water_table, double suction, double rate, double dt)
+{
+  double distance;
+  double hydrostatic = water_table - suction; // The depth the front relaxes toward.
+
+  if (T_O_INTEGRATOR_RK4 == integrator)
+    {
+      double k1, k2, k3, k4, stage;
+
+      k1       = rate * ((-suction / (water_table - front)) + 1) * dt;
+      stage    = (0.0 < k1) ? min(front + 0.5 * k1, max(front, hydrostatic)) : max(front + 0.5 * k1, min(front, hydrostatic));
+      k2       = rate * ((-suction / (water_table - stage)) + 1) * dt;
+      stage    = (0.0 < k2) ? min(front + 0.5 * k2, max(front, hydrostatic)) : max(front + 0.5 * k2, min(front, hydrostatic));
+      k3       = rate * ((-suction / (water_table - stage)) + 1) * dt;
+      stage    = (0.0 < k3) ? min(front + k3, max(front, hydrostatic)) : max(front + k3, min(front, hydrostatic));
+      k4       = rate * ((-suction / (water_table - stage)) + 1) * dt;
+      distance = (k1 + 2.0 * k2 + 2.0 * k3 + k4) / 6.0;
+    }
+  else if (T_O_INTEGRATOR_GREEN_AMPT == integrator && 0.0 < suction)
+    {
+      distance = green_ampt_groundwater_depth(front, water_table, suction, rate, dt) - front;
+    }
+  else
+    {
+      distance = rate * ((-suction / (water_table - front)) + 1) * dt;
+    }
+
+  return distance;
+}
+
+/* Get the Green-Ampt rate and suction that move the groundwater front in a
+ * bin toward hydrostatic.
+ *
+ * Parameters:
+ *
+ * domain      - A pointer to the t_o_domain struct.
+ * bin         - Which bin.
+ * first_bin   - The leftmost bin that is not completely full of water.
+ * water_table - The depth in meters of the water table.
+ * inflow_rate - Flow rate through fully saturated bins in meters per second.
+ * rate        - A scalar passed by reference that gets set to the rate in
+ *               meters per second.
+ * suction     - A scalar passed by reference that gets set to the
+ *               hydrostatic capillary suction in meters.
+ */
+void groundwater_rate_and_suction(t_o_domain* domain, int bin, int first_bin, double water_table, double inflow_rate, double* rate, double* suction)
+{
+  *suction = domain->parameters->bin_capillary_suction[bin];
+  if (domain->parameters->cumulative_conductivity[1] < inflow_rate && inflow_rate < domain->parameters->cumulative_conductivity[bin]) 
+    { // Calculate hydrostatic suction considering steady rainfall. 
+      double suction_new = domain->parameters->bc_psib / (1.0 - inflow_rate / domain->parameters->cumulative_conductivity[domain->parameters->num_bins]) 
+                           + (domain->parameters->bin_capillary_suction[bin] - domain->parameters->bc_psib) / 
+                             (1.0 - 0.5 * inflow_rate / domain->parameters->cumulative_conductivity[bin]
+                                  - 0.5 * inflow_rate / domain->parameters->cumulative_conductivity[domain->parameters->num_bins]);
+
+      if (water_table - domain->layer_top_depth > suction_new || 
+          water_table - domain->layer_top_depth < domain->parameters->bin_capillary_suction[domain->parameters->num_bins])
+        {
+          *suction = suction_new;
+        }
+      else if (water_table > domain->layer_top_depth)
+        {
+          *suction = 0.99 * water_table;
+        }
+    }
+
+  *rate = (domain->parameters->cumulative_conductivity[bin] - domain->parameters->cumulative_conductivity[first_bin - 1]) /
+      (domain->parameters->bin_water_content[bin] - domain->parameters->bin_water_content[first_bin - 1]);
+}
+
+/* Calculate the distance in meters that groundwater in a bin will move in
+ * one timestep.  Positive means down toward the bottom of the domain.
+ * Return TRUE if there is an error, FALSE otherwise.  It is an error for
+ * groundwater to be at or below the water table.
+ *
+ * Parameters:
+ *
+ * domain      - A pointer to the t_o_domain struct.
+ * bin         - Which bin to calculate distance for.
+ * first_bin   - The leftmost bin that is not completely full of water.
+ * dt          - The duration of the timestep in seconds.
+ * water_table - The depth in meters of the water table.
+ * inflow_rate - Flow rate through fully saturated bins in meters per second.
+ * distance    - Scalar passed by reference will be filled in with the
+ *               distance groundwater will move.
+ */
+int groundwater_distance(t_o_domain* domain, int bin, int first_bin, double dt, double water_table, double inflow_rate, double* distance)
+{
+  int error = FALSE; // Error flag.
+
+  assert(NULL != domain && 0 < bin && bin <= domain->parameters->num_bins && 0 < first_bin && first_bin <= domain->parameters->num_bins &&
+      0.0 < dt && 0.0 <= water_table && NULL != distance);
+
+  *distance = 0.0;
+
+  if (domain->yes_groundwater)
+    {  
+      // Original code;
+      /*
+      if (0.0 >= water_table && 0.0 == domain->groundwater_front[bin])
+        {
+          distance = 0.0;
+        }
+      else if (water_table <= domain->groundwater_front[bin])
+        {
+          // If groundwater falls below the water table there are numerical problems.  Move the groundwater to 10% of its capillary head above the water table.
+          fprintf(stderr, "WARNING: Groundwater below water table moved up to 10 percent of capillary head above water table.\n");
+          distance = (water_table - 0.1 * domain->parameters->bin_capillary_suction[bin]) - domain->groundwater_front[bin];
+        }
+      else
+        {
+          distance = ((domain->parameters->cumulative_conductivity[bin] - domain->parameters->cumulative_conductivity[first_bin - 1]) /
+              (domain->parameters->bin_water_content[bin] - domain->parameters->bin_water_content[first_bin - 1])) *
+                  ((-domain->parameters->bin_capillary_suction[bin] / (water_table - domain->groundwater_front[bin])) + 1) * dt;
+
+          // Do not allow the groundwater to travel beyond hydrostatic.
+          double distance_to_hydrostatic = (water_table - domain->parameters->bin_capillary_suction[bin]) - domain->groundwater_front[bin];
+
+          if ((0.0 >= distance_to_hydrostatic && distance < distance_to_hydrostatic) || (0.0 <= distance_to_hydrostatic && distance > distance_to_hydrostatic))
+            {
+              distance = distance_to_hydrostatic;
+            }
+        }
+      */
+      
+      // Hydrostatic suction considering steady rainfall rate. Add 06/02/14.
+      if (domain->layer_top_depth >= water_table && domain->layer_top_depth == domain->groundwater_front[bin])
+        {
+          *distance = 0.0;
+        }
+      else if (water_table <= domain->groundwater_front[bin])
+        {
+          // If groundwater falls below the water table there are numerical problems.
+          fprintf(stderr, "ERROR: Groundwater front at depth %lf in bin %d is at or below the water table at depth %lf.\n",
+                  domain->groundwater_front[bin], bin, water_table);
+          error = TRUE;
+        }
+      else
+        {
+          double rate;    // Meters per second.
+          double suction; // Meters.
+
+          groundwater_rate_and_suction(domain, bin, first_bin, water_table, inflow_rate, &rate, &suction);
+
+          *distance = groundwater_step(domain->integrator, domain->groundwater_front[bin], water_table, suction, rate, dt);
+
+          // Do not allow the groundwater to travel beyond hydrostatic.
+          //double distance_to_hydrostatic = (water_table - domain->parameters->bin_capillary_suction[bin]) - domain->groundwater_front[bin];
+          double distance_to_hydrostatic = (water_table - suction) - domain->groundwater_front[bin];
+
+          if ((0.0 >= distance_to_hydrostatic && *distance < distance_to_hydrostatic) || (0.0 <= distance_to_hydrostatic && *distance > distance_to_hydrostatic))
+            {
+              *distance = distance_to_hydrostatic;
+            }
+        }
+    }
+
+  return error;
+}
+
+#ifdef SIMD_KERNELS
+/* The AVX2 groundwater_distances kernel.  Four bins are done at a time with
+ * the branches of groundwater_distance replaced by masked selects.  Every
+ * value is calculated with the same operations in the same order as
+ * groundwater_distance so the results are bit for bit identical.  Bins where
+ * groundwater is at or below the water table are redone with
+ * groundwater_distance so that it can report the error.
+ * The parameters and return value are the same as groundwater_distances.
+ */
+__attribute__((target("avx2"))) int groundwater_distances_avx2(t_o_domain* domain, int first_bin, double dt, double water_table,
+                                                                double inflow_rate, double* distance)
+{
+  int             error        = FALSE; // Error flag.
+  t_o_parameters* parameters   = domain->parameters;
+  int             ii           = first_bin; // Loop counter.
+  int             jj;                       // Loop counter.
+  int             in_band      = parameters->cumulative_conductivity[1] < inflow_rate; // First half of the steady rainfall condition.
+  double          half_inflow  = 0.5 * inflow_rate;
+  __m256d         zero         = _mm256_setzero_pd();
+  __m256d         one          = _mm256_set1_pd(1.0);
+  __m256d         negative     = _mm256_set1_pd(-0.0);
+  __m256d         top          = _mm256_set1_pd(domain->layer_top_depth);
+  __m256d         table        = _mm256_set1_pd(water_table);
+  __m256d         above_top    = _mm256_set1_pd(water_table - domain->layer_top_depth);
+  __m256d         inflow       = _mm256_set1_pd(inflow_rate);
+  __m256d         half         = _mm256_set1_pd(half_inflow);
+  __m256d         half_last    = _mm256_set1_pd(half_inflow / parameters->cumulative_conductivity[parameters->num_bins]);
+  __m256d         psib         = _mm256_set1_pd(parameters->bc_psib);
+  __m256d         psib_term    = _mm256_set1_pd(parameters->bc_psib / (1.0 - inflow_rate / parameters->cumulative_conductivity[parameters->num_bins]));
+  __m256d         last_suction = _mm256_set1_pd(parameters->bin_capillary_suction[parameters->num_bins]);
+  __m256d         wet_suction  = _mm256_set1_pd(0.99 * water_table);
+  __m256d         conductivity = _mm256_set1_pd(parameters->cumulative_conductivity[first_bin - 1]);
+  __m256d         content      = _mm256_set1_pd(parameters->bin_water_content[first_bin - 1]);
+  __m256d         time         = _mm256_set1_pd(dt);
+  __m256d         pinned       = (domain->layer_top_depth >= water_table) ? _mm256_castsi256_pd(_mm256_set1_epi64x(-1)) : zero;
+  __m256d         above_table  = (water_table > domain->layer_top_depth) ? _mm256_castsi256_pd(_mm256_set1_epi64x(-1)) : zero;
+
+  for (; !error && ii + 3 <= parameters->num_bins; ii += 4)
+    {
+      __m256d groundwater_front = _mm256_loadu_pd(&domain->groundwater_front[ii]);
+      __m256d bin_suction       = _mm256_loadu_pd(&parameters->bin_capillary_suction[ii]);
+      __m256d bin_conductivity  = _mm256_loadu_pd(&parameters->cumulative_conductivity[ii]);
+      __m256d suction           = bin_suction;
+      __m256d result;
+      __m256d to_hydrostatic;
+      __m256d clamp;
+      int     below_table;
+
+      if (in_band)
+        {
+          // Calculate hydrostatic suction considering steady rainfall.
+          __m256d band        = _mm256_cmp_pd(inflow, bin_conductivity, _CMP_LT_OQ);
+          __m256d suction_new = _mm256_add_pd(psib_term, _mm256_div_pd(_mm256_sub_pd(bin_suction, psib),
+                                                                       _mm256_sub_pd(_mm256_sub_pd(one, _mm256_div_pd(half, bin_conductivity)),
+                                                                                     half_last)));
+          __m256d use_new     = _mm256_or_pd(_mm256_cmp_pd(above_top, suction_new, _CMP_GT_OQ), _mm256_cmp_pd(above_top, last_suction, _CMP_LT_OQ));
+
+          suction = _mm256_blendv_pd(suction, _mm256_blendv_pd(_mm256_and_pd(above_table, wet_suction), suction_new, use_new),
+                                     _mm256_and_pd(band, _mm256_or_pd(use_new, above_table)));
+        }
+
+      result = _mm256_mul_pd(_mm256_mul_pd(_mm256_div_pd(_mm256_sub_pd(bin_conductivity, conductivity),
+                                                         _mm256_sub_pd(_mm256_loadu_pd(&parameters->bin_water_content[ii]), content)),
+                                           _mm256_add_pd(_mm256_div_pd(_mm256_xor_pd(suction, negative), _mm256_sub_pd(table, groundwater_front)), one)),
+                             time);
+
+      // Do not allow the groundwater to travel beyond hydrostatic.
+      to_hydrostatic = _mm256_sub_pd(_mm256_sub_pd(table, suction), groundwater_front);
+      clamp          = _mm256_or_pd(_mm256_and_pd(_mm256_cmp_pd(zero, to_hydrostatic, _CMP_GE_OQ), _mm256_cmp_pd(result, to_hydrostatic, _CMP_LT_OQ)),
+                                    _mm256_and_pd(_mm256_cmp_pd(zero, to_hydrostatic, _CMP_LE_OQ), _mm256_cmp_pd(result, to_hydrostatic, _CMP_GT_OQ)));
+      result         = _mm256_blendv_pd(result, to_hydrostatic, clamp);
+      result         = _mm256_blendv_pd(result, zero, _mm256_and_pd(pinned, _mm256_cmp_pd(top, groundwater_front, _CMP_EQ_OQ)));
+      below_table    = _mm256_movemask_pd(_mm256_andnot_pd(_mm256_and_pd(pinned, _mm256_cmp_pd(top, groundwater_front, _CMP_EQ_OQ)),
+                                                           _mm256_cmp_pd(table, groundwater_front, _CMP_LE_OQ)));
+
+      _mm256_storeu_pd(&distance[ii], result);
+
+      for (jj = 0; !error && 0 != below_table; jj++, below_table >>= 1)
+        {
+          if (below_table & 1)
+            {
+              error = groundwater_distance(domain, ii + jj, first_bin, dt, water_table, inflow_rate, &distance[ii + jj]);
+            }
+        }
+    }
+
+  for (; !error && ii <= parameters->num_bins; ii++)
+    {
+      error = groundwater_distance(domain, ii, first_bin, dt, water_table, inflow_rate, &distance[ii]);
+    }
+
+  return error;
+}
+
+/* The AVX-512 groundwater_distances kernel.  The same as
+ * groundwater_distances_avx2 except eight bins are done at a time.
+ * Floating point contraction is turned off because AVX-512 has fused
+ * multiply add, which would round differently from the scalar code.
+ */
+__attribute__((target("avx512f"), optimize("fp-contract=off"))) int groundwater_distances_avx512(t_o_domain* domain, int first_bin, double dt,
+                                                                                               double water_table, double inflow_rate,
+                                                                                               double* distance)
+{
+  int             error        = FALSE; // Error flag.
+  t_o_parameters* parameters   = domain->parameters;
+  int             ii           = first_bin; // Loop counter.
+  int             jj;                       // Loop counter.
+  int             in_band      = parameters->cumulative_conductivity[1] < inflow_rate; // First half of the steady rainfall condition.
+  double          half_inflow  = 0.5 * inflow_rate;
+  __m512d         zero         = _mm512_setzero_pd();
+  __m512d         one          = _mm512_set1_pd(1.0);
+  __m512d         top          = _mm512_set1_pd(domain->layer_top_depth);
+  __m512d         table        = _mm512_set1_pd(water_table);
+  __m512d         above_top    = _mm512_set1_pd(water_table - domain->layer_top_depth);
+  __m512d         inflow       = _mm512_set1_pd(inflow_rate);
+  __m512d         half         = _mm512_set1_pd(half_inflow);
+  __m512d         half_last    = _mm512_set1_pd(half_inflow / parameters->cumulative_conductivity[parameters->num_bins]);
+  __m512d         psib         = _mm512_set1_pd(parameters->bc_psib);
+  __m512d         psib_term    = _mm512_set1_pd(parameters->bc_psib / (1.0 - inflow_rate / parameters->cumulative_conductivity[parameters->num_bins]));
+  __m512d         last_suction = _mm512_set1_pd(parameters->bin_capillary_suction[parameters->num_bins]);
+  __m512d         wet_suction  = _mm512_set1_pd(0.99 * water_table);
+  __m512d         conductivity = _mm512_set1_pd(parameters->cumulative_conductivity[first_bin - 1]);
+  __m512d         content      = _mm512_set1_pd(parameters->bin_water_content[first_bin - 1]);
+  __m512d         time         = _mm512_set1_pd(dt);
+  __mmask8        pinned       = (domain->layer_top_depth >= water_table) ? 0xFF : 0x00;
+  __mmask8        above_table  = (water_table > domain->layer_top_depth) ? 0xFF : 0x00;
+
+  for (; !error && ii + 7 <= parameters->num_bins; ii += 8)
+    {
+      __m512d  groundwater_front = _mm512_loadu_pd(&domain->groundwater_front[ii]);
+      __m512d  bin_suction       = _mm512_loadu_pd(&parameters->bin_capillary_suction[ii]);
+      __m512d  bin_conductivity  = _mm512_loadu_pd(&parameters->cumulative_conductivity[ii]);
+      __m512d  suction           = bin_suction;
+      __m512d  result;
+      __m512d  to_hydrostatic;
+      __mmask8 clamp;
+      __mmask8 at_top;
+      __mmask8 below_table;
+
+      if (in_band)
+        {
+          // Calculate hydrostatic suction considering steady rainfall.
+          __mmask8 band        = _mm512_cmp_pd_mask(inflow, bin_conductivity, _CMP_LT_OQ);
+          __m512d  suction_new = _mm512_add_pd(psib_term, _mm512_div_pd(_mm512_sub_pd(bin_suction, psib),
+                                                                        _mm512_sub_pd(_mm512_sub_pd(one, _mm512_div_pd(half, bin_conductivity)),
+                                                                                      half_last)));
+          __mmask8 use_new     = _mm512_cmp_pd_mask(above_top, suction_new, _CMP_GT_OQ) | _mm512_cmp_pd_mask(above_top, last_suction, _CMP_LT_OQ);
+
+          suction = _mm512_mask_blend_pd(band & above_table & ~use_new, suction, wet_suction);
+          suction = _mm512_mask_blend_pd(band & use_new, suction, suction_new);
+        }
+
+      // AVX-512F has no xor for doubles.  Subtracting from negative zero is also an exact negation including the sign of zero.
+      result = _mm512_mul_pd(_mm512_mul_pd(_mm512_div_pd(_mm512_sub_pd(bin_conductivity, conductivity),
+                                                         _mm512_sub_pd(_mm512_loadu_pd(&parameters->bin_water_content[ii]), content)),
+                                           _mm512_add_pd(_mm512_div_pd(_mm512_sub_pd(_mm512_set1_pd(-0.0), suction),
+                                                                       _mm512_sub_pd(table, groundwater_front)), one)),
+                             time);
+
+      // Do not allow the groundwater to travel beyond hydrostatic.
+      to_hydrostatic = _mm512_sub_pd(_mm512_sub_pd(table, suction), groundwater_front);
+      clamp          = (_mm512_cmp_pd_mask(zero, to_hydrostatic, _CMP_GE_OQ) & _mm512_cmp_pd_mask(result, to_hydrostatic, _CMP_LT_OQ)) |
+          (_mm512_cmp_pd_mask(zero, to_hydrostatic, _CMP_LE_OQ) & _mm512_cmp_pd_mask(result, to_hydrostatic, _CMP_GT_OQ));
+      result         = _mm512_mask_blend_pd(clamp, result, to_hydrostatic);
+      at_top         = pinned & _mm512_cmp_pd_mask(top, groundwater_front, _CMP_EQ_OQ);
+      result         = _mm512_mask_blend_pd(at_top, result, zero);
+      below_table    = ~at_top & _mm512_cmp_pd_mask(table, groundwater_front, _CMP_LE_OQ);
+
+      _mm512_storeu_pd(&distance[ii], result);
+
+      for (jj = 0; !error && 0 != below_table; jj++, below_table >>= 1)
+        {
+          if (below_table & 1)
+            {
+              error = groundwater_distance(domain, ii + jj, first_bin, dt, water_table, inflow_rate, &distance[ii + jj]);
+            }
+        }
+    }
+
+  for (; !error && ii <= parameters->num_bins; ii++)
+    {
+      error = groundwater_distance(domain, ii, first_bin, dt, water_table, inflow_rate, &distance[ii]);
+    }
+
+  return error;
+}
+#endif // SIMD_KERNELS
+
+/* Calculate the distance in meters that groundwater will move in one
+ * timestep in all of the bins from first_bin on.  distance[ii] is the same as
+ * groundwater_distance for bin ii.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * domain      - A pointer to the t_o_domain struct.
+ * first_bin   - The leftmost bin that is not completely full of water.
+ * dt          - The duration of the timestep in seconds.
+ * water_table - The depth in meters of the water table.
+ * inflow_rate - Flow rate through fully saturated bins in meters per second.
+ * distance    - A 1D array sized to hold domain->parameters->num_bins
+ *               elements with one based indexing.  distance[ii] is filled
+ *               in for each bin from first_bin on.
+ * kernel      - Which kernel to use.  One of SIMD_KERNEL_SCALAR,
+ *               SIMD_KERNEL_AVX2, or SIMD_KERNEL_AVX512.  Must not be more
+ *               than best_simd_kernel.
+ */
+int groundwater_distances(t_o_domain* domain, int first_bin, double dt, double water_table, double inflow_rate, double* distance, int kernel)
+{
+  int error = FALSE; // Error flag.
+  int ii;            // Loop counter.
+
+  assert(NULL != domain && domain->yes_groundwater && NULL != distance && kernel <= best_simd_kernel());
+
+#ifdef SIMD_KERNELS
+  // The vector kernels only do Euler.
+  if (T_O_INTEGRATOR_EULER != domain->integrator)
+    {
+      kernel = SIMD_KERNEL_SCALAR;
+    }
+
+  if (SIMD_KERNEL_AVX512 == kernel)
+    {
+      error = groundwater_distances_avx512(domain, first_bin, dt, water_table, inflow_rate, distance);
+    }
+  else if (SIMD_KERNEL_AVX2 == kernel)
+    {
+      error = groundwater_distances_avx2(domain, first_bin, dt, water_table, inflow_rate, distance);
+    }
+  else
+#endif // SIMD_KERNELS
+    {
+      for (ii = first_bin; !error && ii <= domain->parameters->num_bins; ii++)
+        {
+          error = groundwater_distance(domain, ii, first_bin, dt, water_table, inflow_rate, &distance[ii]);
+        }
+    }
+
+  return error;
+}
+
+/* Return distance limited so that groundwater does not travel beyond
+ * hydrostatic the same way groundwater_distance limits it.
+ *
+ * Parameters:
+ *
+ * distance                - The distance in meters groundwater wants to move.
+ * distance_to_hydrostatic - The distance in meters to the hydrostatic depth.
+ */
+double hydrostatic_limit(double distance, double distance_to_hydrostatic)
+{
+  if ((0.0 >= distance_to_hydrostatic && distance < distance_to_hydrostatic) || (0.0 <= distance_to_hydrostatic && distance > distance_to_hydrostatic))
+    {
+      distance = distance_to_hydrostatic;
+    }
+
+  return distance;
+}
+
+/* Comment in .h file. */
+int t_o_integrator_error(t_o_domain* domain, double dt, double surfacewater_head, double water_table, double* infiltration, double* groundwater)
+{
+  int error = FALSE; // Error flag.
+  int first_bin;     // The leftmost bin that is not completely full of water.
+  int ii;            // Loop counter.
+
+  if (NULL == domain)
+    {
+      fprintf(stderr, "ERROR: domain must not be NULL\n");
+      error = TRUE;
+    }
+
+  if (0.0 >= dt)
+    {
+      fprintf(stderr, "ERROR: dt must be greater than zero\n");
+      error = TRUE;
+    }
+
+  if (0.0 > water_table)
+    {
+      fprintf(stderr, "ERROR: water_table must be greater than or equal to zero\n");
+      error = TRUE;
+    }
+
+  if (NULL == infiltration)
+    {
+      fprintf(stderr, "ERROR: infiltration must not be NULL\n");
+      error = TRUE;
+    }
+
+  if (NULL == groundwater)
+    {
+      fprintf(stderr, "ERROR: groundwater must not be NULL\n");
+      error = TRUE;
+    }
+
+  if (!error)
+    {
+      double               rate;                                                                               // Meters per second.
+      double               suction;                                                                            // Meters.
+      double               one_step;                                                                           // Distance in meters.
+      double               two_steps;                                                                          // Distance in meters.
+      t_o_dry_depth_cache* cache = atomic_load_explicit(&domain->parameters->dry_depth_cache, memory_order_acquire); // Upper bounds of the dry depths.
+
+      first_bin     = find_first_bin(domain, 2);
+      *infiltration = 0.0;
+      *groundwater  = 0.0;
+
+      if (first_bin <= domain->parameters->num_bins)
+        {
+          infiltrate_rate_and_suction(domain, first_bin, surfacewater_head, &rate, &suction);
+
+          for (ii = first_bin; ii <= domain->parameters->num_bins; ii++)
+            {
+              // Only the bins past their dry depth use the integrator.
+              if (0.0 < domain->parameters->bin_capillary_suction[ii] + surfacewater_head &&
+                  cache->bin_dry_depth[ii] + domain->layer_top_depth < domain->surface_front[ii])
+                {
+                  one_step  = infiltrate_step(domain->integrator, domain->surface_front[ii], suction, rate, dt);
+                  two_steps = infiltrate_step(domain->integrator, domain->surface_front[ii], suction, rate, 0.5 * dt);
+                  two_steps = two_steps + infiltrate_step(domain->integrator, domain->surface_front[ii] + two_steps, suction, rate, 0.5 * dt);
+
+                  if (*infiltration < fabs(one_step - two_steps))
+                    {
+                      *infiltration = fabs(one_step - two_steps);
+                    }
+                }
+
+              if (domain->yes_groundwater && domain->groundwater_front[ii] < water_table)
+                {
+                  double hydrostatic = water_table - domain->parameters->bin_capillary_suction[ii]; // Depth in meters the front relaxes toward.
+
+                  rate      = (domain->parameters->cumulative_conductivity[ii] - domain->parameters->cumulative_conductivity[first_bin - 1]) /
+                              (domain->parameters->bin_water_content[ii] - domain->parameters->bin_water_content[first_bin - 1]);
+                  one_step  = hydrostatic_limit(groundwater_step(domain->integrator, domain->groundwater_front[ii], water_table,
+                                                                 domain->parameters->bin_capillary_suction[ii], rate, dt),
+                                                hydrostatic - domain->groundwater_front[ii]);
+                  two_steps = hydrostatic_limit(groundwater_step(domain->integrator, domain->groundwater_front[ii], water_table,
+                                                                 domain->parameters->bin_capillary_suction[ii], rate, 0.5 * dt),
+                                                hydrostatic - domain->groundwater_front[ii]);
+                  two_steps = two_steps + hydrostatic_limit(groundwater_step(domain->integrator, domain->groundwater_front[ii] + two_steps, water_table,
+                                                                             domain->parameters->bin_capillary_suction[ii], rate, 0.5 * dt),
+                                                            hydrostatic - (domain->groundwater_front[ii] + two_steps));
+
+                  if (*groundwater < fabs(one_step - two_steps))
+                    {
+                      *groundwater = fabs(one_step - two_steps);
+                    }
+                }
+            }
+        }
+    }
+
+  return error;
+}
+
+/* Process the groundwater step of the simulation.
+ * Return TRUE if there is an error, FALSE otherwise.
+ * Actually always returns FALSE.  No conditions generate an error.
+ *
+ * Parameters:
+ *
+ * domain               - A pointer to the t_o_domain struct.
+ * dt                   - The duration of the timestep in seconds.
+ * first_bin            - A scalar passed by reference containing the leftmost
+ *                        bin that is not completely full of water.  Will be
+ *                        updated to the new value after infiltration.
+ * water_table          - The depth in meters of the water table.
+ * ponded_water         - Whether the demand of the fully saturated bins was
+ *                        completely satisfied from surface water.
+ *                        Pass in the value set by satisfy_saturated_bins.
+ *                        If this is TRUE then bins less than first_bin are
+ *                        left pinned to the surface.  Otherwise, their
+ *                        groundwater front is simulated the same as other
+ *                        bins.
+ * groundwater_recharge - A scalar passed by reference containing any
+ *                        previously accumulated groundwater recharge in meters
+ *                        of water.  Will be updated for the amount of water
+ *                        that flowed between the Talbot-Ogden domain and
+ *                        groundwater.  Positive means water flowed down out of
+ *                        the Talbot-Ogden domain.  Negative means water flowed
+ *                        up in to the Talbot-Ogden domain.
+ * inflow_rate          - Flow rate through fully saturated bins in meters per second.
+ */
+int t_o_groundwater(t_o_domain* domain, double dt, int* first_bin, double water_table, int ponded_water, double* groundwater_recharge, double inflow_rate)
+{
+  int error = FALSE; // Error flag.
+  int ii;            // Loop counter.
+
+  assert(NULL != domain && 0.0 < dt && 0.0 <= water_table && NULL != groundwater_recharge);
+
+  if (domain->yes_groundwater)
+    {
+      // If the demand of the fully saturated bins was completely satisfied from surface water then bins less than first_bin are pinned to the surface.
+      // Otherwise, reduce first_bin until you reach a bin whoose hydrostatic equlibrium is at or above the surface.
+      if (!ponded_water)
+        {
+          while (2 < *first_bin && domain->layer_top_depth < water_table - domain->parameters->bin_capillary_suction[*first_bin - 1])
+            {
+              (*first_bin)--;
+            }
+        }
+
+      double distance[domain->parameters->num_bins + 1]; // The distance groundwater wants to move in each bin this timestep.
+
+      // Moving the groundwater in one bin does not change the distance for any other bin so calculate them all at once.
+      // FIXME, wencong 6/2/14, add inflow_rate to calculate groundwater distance, as inflow rate affects hydrostatic capillary height.
+      error = groundwater_distances(domain, *first_bin, dt, water_table, inflow_rate, distance, best_simd_kernel());
+
+      for (ii = *first_bin; !error && ii <= domain->parameters->num_bins; ii++)
+        {
+          double delta_z = distance[ii]; // The distance groundwater wants to move this timestep.
+
+          // Move the water.
+          if (0.0 > delta_z)
+            {
+              // Groundwater moves upward.
+              
+              /* FIXME do we really want to do this?  Probably use this in real world case, but not in tests with arbitrary water table location.
+              // Don't make a positive recharge negative, if recharge is already negative, do nothing.
+              if (*groundwater_recharge <= 0.0)
+                {
+                  delta_z = 0.0;
+                }
+              else if (delta_z < -(*groundwater_recharge) / domain->parameters->delta_water_content)
+                {
+                  delta_z = -(*groundwater_recharge) / domain->parameters->delta_water_content;
+                }
+              */
+            
+              double final_depth = domain->groundwater_front[ii] + delta_z; // Depth in meters that groundwater wants to move to. 
+                 
+              // Groundwater cannot move above the surface.
+              if (final_depth < domain->layer_top_depth)
+                {
+                  final_depth = domain->layer_top_depth;
+                }
+
+              // Accumulate the amount of water actually moved in meters of bin depth.
+              delta_z = 0.0;
+
+              // We must loop because groundwater might overtake multiple slugs or slugs and the surface front in one timestep.
+              while (domain->groundwater_front[ii] > final_depth)
+                {
+                  if (NULL != domain->bot_slug[ii])
+                    {
+                      // A slug exists.
+                      if (final_depth <= domain->bot_slug[ii]->bot)
+                        {
+                          // The groundwater hits the bottom slug.
+                          delta_z += domain->bot_slug[ii]->bot - domain->groundwater_front[ii];
+                          set_groundwater_front(domain, ii, domain->bot_slug[ii]->top);
+                          kill_slug(domain, ii, domain->bot_slug[ii]);
+                        }
+                      else
+                        {
+                          // The groundwater does not hit the bottom slug.
+                          delta_z += final_depth - domain->groundwater_front[ii];
+                          set_groundwater_front(domain, ii, final_depth);
+                        }
+                    }
+                  else
+                    {
+                      // No slug exists.
+                      if (final_depth <= domain->surface_front[ii])
+                        {
+                          // The groundwater hits the surface front.
+                          delta_z += domain->surface_front[ii] - domain->groundwater_front[ii];
+                          set_surface_front(domain, ii, domain->layer_top_depth);
+                          set_groundwater_front(domain, ii, domain->layer_top_depth);
+                        }
+                      else
+                        {
+                          // The groundwater does not hit the surface front.
+                          delta_z += final_depth - domain->groundwater_front[ii];
+                          set_groundwater_front(domain, ii, final_depth);
+                        }
+                    }
+                }
+            }
+          else if (0.0 < delta_z)
+            {
+              // Groundwater moves downward.
+              if (domain->groundwater_front[ii] + delta_z >= domain->layer_bottom_depth)
+                {
+                  // The groundwater hits the bottom of the domain.
+                  delta_z = domain->layer_bottom_depth - domain->groundwater_front[ii];
+                  set_groundwater_front(domain, ii, domain->layer_bottom_depth);
+                }
+              else
+                {
+                  // The groundwater does not hit the bottom of the domain.
+                  set_groundwater_front(domain, ii, domain->groundwater_front[ii] + delta_z);
+                }
+            }
+
+          *groundwater_recharge += delta_z * domain->parameters->delta_water_content;
+        } // End loop over all bins
+
+      // Force bin 1 to be completely full of water.
+      if (!error && domain->layer_top_depth < domain->groundwater_front[1])
+        {
+          fprintf(stderr, "WARNING: Groundwater in bin 1 wants to fall below the surface.  Groundwater in bin 1 is being pinned "
+              "to the surface.  The simulation will be inaccurate unless you decrease residual_saturation.\n");
+          *groundwater_recharge += -(domain->groundwater_front[1] - domain->layer_top_depth) * domain->parameters->delta_water_content;
+          set_groundwater_front(domain, 1, domain->layer_top_depth);
+        }
+      
+      // Find the new value of first_bin.  It could move to the right or left.
+      *first_bin = find_first_bin(domain, 2);
+    } // End if (domain->yes_groundwater)
+
+  return error;
+}
+
+//Function passed to qsort() to sort the list from largest to smallest
+int
+compare_surface(const double *a, const double *b)
+{
+  double temp = *a - *b;
+  if (temp > 0)
+    return -1;
+  else if (temp < 0)
+    return 1;
+  else
+    return 0;
+}
+
+//Function passed to qsort() to sort the list from smallest to largest
+int
+compare_ground(const double *a, const double *b)
+{
+  double temp = *a - *b;
+  if (temp > 0)
+    return 1;
+  else if (temp < 0)
+    return -1;
+  else
+    return 0;
+}
+
+#define FRONT_INSERTION_SORT_MAX_DESCENTS (16) // sort_front uses insertion sort if a front has at most this many elements out of order.
+
+// Return whether a should come before b in a front sorted from largest to smallest if descending is TRUE or smallest to largest if FALSE.
+static inline int front_before(double a, double b, int descending)
+{
+  return descending ? a > b : a < b;
+}
+
+/* Sort a front with a bottom up merge sort.  Adjacent runs that are already
+ * in order are copied without comparing every element so input that is
+ * nearly sorted takes close to linear time.
+ *
+ * Parameters:
+ *
+ * front        - A 1D array of num_elements depths with zero based indexing.
+ * scratch      - A 1D array of at least num_elements doubles used as
+ *                temporary storage.
+ * num_elements - The number of elements to sort.
+ * descending   - Whether to sort from largest to smallest instead of
+ *                smallest to largest.
+ */
+void merge_sort_front(double* front, double* scratch, int num_elements, int descending)
+{
+  int     width;            // The length of the runs being merged.
+  int     left;             // The start of the left  run.
+  int     middle;           // The start of the right run.
+  int     right;            // One past the end of the right run.
+  int     ii, jj, kk;       // Loop counters.
+  double* from = front;     // The array being merged from.
+  double* to   = scratch;   // The array being merged into.
+  double* temp;
+
+  for (width = 1; width < num_elements; width *= 2)
+    {
+      for (left = 0; left < num_elements; left += 2 * width)
+        {
+          middle = min(left + width, num_elements);
+          right  = min(left + 2 * width, num_elements);
+          ii     = left;
+          jj     = middle;
+          kk     = left;
+
+          // If the runs are already in order skip straight to copying them.
+          if (middle < right && !front_before(from[middle], from[middle - 1], descending))
+            {
+              jj = right;
+            }
+
+          while (ii < middle && jj < right)
+            {
+              if (front_before(from[jj], from[ii], descending))
+                {
+                  to[kk++] = from[jj++];
+                }
+              else
+                {
+                  to[kk++] = from[ii++];
+                }
+            }
+
+          while (ii < middle)
+            {
+              to[kk++] = from[ii++];
+            }
+
+          // If the runs were already in order the right run has not been copied.
+          for (jj = kk; jj < right; jj++)
+            {
+              to[jj] = from[jj];
+            }
+        }
+
+      temp = from;
+      from = to;
+      to   = temp;
+    }
+
+  if (from != front)
+    {
+      for (ii = 0; ii < num_elements; ii++)
+        {
+          front[ii] = from[ii];
+        }
+    }
+}
+
+/* Sort a front that is usually almost sorted already.  Between timesteps
+ * only a few bins move out of order so the front is first scanned for
+ * elements that are smaller (or larger if descending) than the one before
+ * them.  If there are none nothing is done.  If there are at most
+ * FRONT_INSERTION_SORT_MAX_DESCENTS an insertion sort starting at the first
+ * one moves just those elements.  Otherwise merge_sort_front is used.  The
+ * result is the same as sorting with qsort and compare_surface or
+ * compare_ground.
+ *
+ * Return the number of elements whose value changed.
+ *
+ * Parameters:
+ *
+ * front        - A 1D array of num_elements depths with zero based indexing.
+ * scratch      - A 1D array of at least 2 * num_elements doubles used as
+ *                temporary storage.
+ * num_elements - The number of elements to sort.
+ * descending   - Whether to sort from largest to smallest instead of
+ *                smallest to largest.
+ */
+int sort_front(double* front, double* scratch, int num_elements, int descending)
+{
+  int    ii, jj;            // Loop counters.
+  int    first_descent = 0; // The first element that is out of order with the one before it or zero if there are none.
+  int    num_descents  = 0; // The number of elements that are out of order with the one before them.
+  int    moved         = 0; // The number of elements whose value changed.
+  double temp;
+
+  for (ii = 1; ii < num_elements; ii++)
+    {
+      if (front_before(front[ii], front[ii - 1], descending))
+        {
+          if (0 == num_descents)
+            {
+              first_descent = ii;
+            }
+
+          num_descents++;
+        }
+    }
+
+  if (0 < num_descents)
+    {
+      // Keep a copy to count how many elements changed.
+      for (ii = 0; ii < num_elements; ii++)
+        {
+          scratch[ii] = front[ii];
+        }
+
+      if (FRONT_INSERTION_SORT_MAX_DESCENTS >= num_descents)
+        {
+          for (ii = first_descent; ii < num_elements; ii++)
+            {
+              temp = front[ii];
+
+              for (jj = ii; 0 < jj && front_before(temp, front[jj - 1], descending); jj--)
+                {
+                  front[jj] = front[jj - 1];
+                }
+
+              front[jj] = temp;
+            }
+        }
+      else
+        {
+          merge_sort_front(front, scratch + num_elements, num_elements, descending);
+        }
+
+      for (ii = 0; ii < num_elements; ii++)
+        {
+          if (front[ii] != scratch[ii])
+            {
+              moved++;
+            }
+        }
+    }
+
+  return moved;
+}
+
+/*
+ * helper function for add_binned_slug to link bin_slug after prev_slug in the
+ * bin.  If linking fails bin_slug is deallocated, and TRUE is returned.
+ */
+int
+link_bin_slug(t_o_domain* domain, int bin, slug* prev_slug, slug* (*bin_slug))
+{
+  int error = link_slug_after(domain, bin, prev_slug, *bin_slug);
+
+  if (error)
+    {
+      slug_dealloc(&(*bin_slug));
+    }
+
+  return error;
+}
+
+/*
+ * helper function to add a slug to the bin, checks for equality
+ * and adds to ground/surface if necessary
+ *
+ * This function assumes that bin_slug will fit without overlapping
+ * between two fronts, or between a single slug and a front.  It does
+ * handle equality.
+ */
+int
+add_binned_slug(t_o_domain* domain, slug* (*bin_slug), int bin)
+{
+  slug* tmp_slug = domain->top_slug[bin];
+
+  if ((*bin_slug)->top == domain->surface_front[bin]
+                                                && (domain->yes_groundwater && (*bin_slug)->bot == domain->groundwater_front[bin]))
+    {
+      //not likely, but this could happen, if it does, we have filled bin
+      domain->surface_front[bin]     = domain->layer_top_depth;
+      domain->groundwater_front[bin] = domain->layer_top_depth;
+      slug_dealloc(&(*bin_slug));
+      return 0;
+    }
+  else if ((*bin_slug)->top == domain->surface_front[bin])
+    {
+      if (tmp_slug != NULL && tmp_slug->top == (*bin_slug)->bot)
+        {
+          domain->surface_front[bin] = tmp_slug->bot;
+          kill_slug(domain, bin, tmp_slug);
+        }
+      else
+        {
+          domain->surface_front[bin] = (*bin_slug)->bot;
+        }
+      slug_dealloc(&(*bin_slug));
+      return 0;
+    }
+  else if (domain->yes_groundwater && (*bin_slug)->bot == domain->groundwater_front[bin])
+    {
+      tmp_slug = domain->bot_slug[bin];
+      if (tmp_slug != NULL && tmp_slug->bot == (*bin_slug)->top)
+        {
+          domain->groundwater_front[bin] = tmp_slug->top;
+          kill_slug(domain, bin, tmp_slug);
+        }
+      else
+        {
+          domain->groundwater_front[bin] = (*bin_slug)->top;
+        }
+      slug_dealloc(&(*bin_slug));
+      return 0;
+    }
+
+  //TODO MAY BE POSSIBLE TO REFACTOR THIS PORTION INTO A MORE CONSICE
+  //BIT OF CODE
+  if (tmp_slug == NULL )
+    {
+      //this is the first slug to be added to this bin
+      return link_bin_slug(domain, bin, NULL, bin_slug);
+    }
+  //Otherwise slugs exist and we need to insert this in
+  //the correct position in the linked list
+  while (tmp_slug != NULL )
+    {
+      if ((*bin_slug)->bot < tmp_slug->top)
+        {
+          //bin_slug goes here
+          return link_bin_slug(domain, bin, tmp_slug->prev, bin_slug);
+        }
+      else if ((*bin_slug)->bot == tmp_slug->top)
+        {
+          //the two slugs merge into one slug
+          set_slug_top(domain, bin, tmp_slug, (*bin_slug)->top);
+          slug_dealloc(&(*bin_slug));
+          return 0;
+        }
+      else if ((*bin_slug)->top == tmp_slug->bot && NULL != tmp_slug->next && (*bin_slug)->bot == tmp_slug->next->top)
+        {
+          //the three slugs merge into one slug
+          set_slug_bot(domain, bin, tmp_slug, tmp_slug->next->bot);
+          slug_dealloc(&(*bin_slug));
+          kill_slug(domain, bin, tmp_slug->next);
+          return 0;
+        }
+      else if ((*bin_slug)->top == tmp_slug->bot)
+        {
+          //the two slugs merge into one slug
+          set_slug_bot(domain, bin, tmp_slug, (*bin_slug)->bot);
+          slug_dealloc(&(*bin_slug));
+          return 0;
+        }
+      tmp_slug = tmp_slug->next;
+    }
+  //if we get to here, we know that the slug is at the end
+  //of the binned list
+  return link_bin_slug(domain, bin, domain->bot_slug[bin], bin_slug);
+}
+
+int
+redistribute_top_slugs(t_o_domain* domain, slug* (*slugs_head), slug* (*slugs_end),
+    int first_bin, int start_bin)
+{
+  double surface_max = domain->surface_front[first_bin];
+  //Loop over all slugs that need to be re-arranged
+  int error = FALSE; // Error flag.
+  int i;
+  slug* tmp;
+  slug* collide;
+  while (!error && (*slugs_head) != NULL )
+    {
+      //find the first bin the bottom of the slug can contribute to
+      for(i = start_bin; i <= domain->parameters->num_bins; i++)
+        {
+          if((*slugs_head)->bot > domain->surface_front[i])
+            {
+              break;
+            }
+        }
+
+      while((*slugs_head) != NULL)
+        {
+          tmp = domain->bot_slug[i];
+          collide = NULL;
+          while(tmp != NULL)
+            {
+              //find the one, if any, slug that will potentially collide
+              if(tmp->bot <= surface_max)
+                {
+                  //this slug is the last in the top of the bin
+                  //this will be the only slug of interest;
+                  collide = tmp;
+                  break;
+                }
+              tmp = tmp->prev;
+            }
+          if(collide == NULL)
+            {
+              if((*slugs_head)->top >= domain->surface_front[i])
+                {
+                  //slug fits entirely in this bin
+                  tmp = (*slugs_head)->next;
+                  error = add_binned_slug(domain, &(*slugs_head), i);
+                  (*slugs_head) = tmp;
+                  break;
+                }
+              //otherwise it merges into surface front
+              double new_bot = domain->surface_front[i];
+              domain->surface_front[i] = (*slugs_head)->bot;
+              (*slugs_head)->bot = new_bot;
+              i++;
+              continue;
+            }
+          else if((*slugs_head)->bot <= collide->bot)
+            {
+              i++;
+              continue;
+            }
+          if((*slugs_head)->top >= collide->bot)
+            {
+              //slug fits entirely in this bin
+              tmp = (*slugs_head)->next;
+              error = add_binned_slug(domain, &(*slugs_head), i);
+              (*slugs_head) = tmp;
+              break;
+            }//otherwise it may merge with the bottom slug
+          else
+            {
+              //slug must collide
+              //merge slugs and continue
+              double new_bot = collide->bot;
+              set_slug_bot(domain, i, collide, (*slugs_head)->bot);
+              (*slugs_head)->bot = new_bot;
+              i++;
+              continue;
+            }
+        }
+    }
+  return error;
+}
+
+int
+redistribute_mid_slugs(t_o_domain* domain, slug* (*slugs_head), slug* (*slugs_end),
+    int first_bin, int start_bin)
+{
+  //Loop over all slugs that need to be re-arranged
+  int error = FALSE; // Error flag.
+  int i;
+  double ground_max = domain->yes_groundwater ? domain->groundwater_front[first_bin] : domain->layer_bottom_depth;
+  slug* tmp;
+  slug* collide;
+  while (!error && (*slugs_head) != NULL )
+    {
+      //find the first bin the bottom of the slug can contribute to
+      for(i = start_bin; i <= domain->parameters->num_bins; i++)
+        {
+          if((!domain->yes_groundwater || (*slugs_head)->bot <= domain->groundwater_front[i])
+              &&(*slugs_head)->bot > domain->surface_front[i])
+            {
+              //slug can put water in this bin under the surface front
+              //and above the groundwater front, we check for > surface_front because
+              //the bottom of the slug should contribute to next bin if there is =
+              break;
+            }
+        }
+
+      while((*slugs_head) != NULL)
+        {
+          //find the first slug in the middle cut, if one exists
+          //this is the slug that can potentially collide
+          collide = NULL;
+          tmp = domain->bot_slug[i];
+          while(tmp != NULL)
+            {
+              if(tmp->top < ground_max)
+                {
+                  collide = tmp;
+                  break;
+                }
+              tmp = tmp->prev;
+            }
+
+          //now see if slugs_head can contribute
+          if(collide == NULL)
+            {
+              if((*slugs_head)->top >= domain->surface_front[i])
+                {
+                  tmp = (*slugs_head)->next;
+                  error = add_binned_slug(domain, &(*slugs_head), i);
+                  (*slugs_head)= tmp;
+                  break;
+                }
+              else
+                {
+                  //otherwise it merges into surface front
+                  double new_bot = domain->surface_front[i];
+
+                  // surface front might merge with groundwater.
+                  if (domain->yes_groundwater && (*slugs_head)->bot == domain->groundwater_front[i])
+                    {
+                      domain->groundwater_front[i] = domain->layer_top_depth;
+                      domain->surface_front[i]     = domain->layer_top_depth;
+                    }
+                  else if (NULL != domain->top_slug[i] && (*slugs_head)->bot == domain->top_slug[i]->top)
+                    {
+                      // surface front might merge with the slug below it.
+                      domain->surface_front[i] = domain->top_slug[i]->bot;
+                      kill_slug(domain, i, domain->top_slug[i]);
+                    }
+                  else
+                    {
+                      domain->surface_front[i] = (*slugs_head)->bot;
+                    }
+                  (*slugs_head)->bot = new_bot;
+                  i++;
+                  continue;
+                }
+            }
+          if((*slugs_head)->bot <= collide->bot)
+            {
+              i++;
+              continue;
+            }
+          else if((*slugs_head)->top >= collide->bot)
+            {
+              //entire slug fits under first_mid_slug
+              tmp = (*slugs_head)->next;
+              error = add_binned_slug(domain, &(*slugs_head), i);
+              (*slugs_head)= tmp;
+              break;
+            }
+          else
+            {
+              //merge and continue
+              double new_bot = collide->bot;
+
+              // collide might merge with groundwater.
+              if (domain->yes_groundwater && (*slugs_head)->bot == domain->groundwater_front[i])
+                {
+                  domain->groundwater_front[i] = collide->top;
+                  kill_slug(domain, i, collide);
+                }
+              else if (NULL != collide->next && (*slugs_head)->bot == collide->next->top)
+                {
+                  // collide might merge with the slug below it.
+                  set_slug_bot(domain, i, collide, collide->next->bot);
+                  kill_slug(domain, i, collide->next);
+                }
+              else
+                {
+                  set_slug_bot(domain, i, collide, (*slugs_head)->bot);
+                }
+
+              (*slugs_head)->bot = new_bot;
+              i++;
+              continue;
+            }
+
+        }
+    }
+  return error;
+}
+
+int
+redistribute_bot_slugs(t_o_domain* domain, slug* (*slugs_head), slug* (*slugs_end),
+    int first_bin, int start_bin)
+{
+  double ground_max = domain->groundwater_front[first_bin];
+  //Loop over all slugs that need to be re-arranged
+  int error = FALSE; // Error flag.
+  int i;
+  slug* tmp;
+  slug* collide;
+
+  while (!error && (*slugs_head) != NULL )
+    {
+      //find the first bin the top of the slug can contribute to
+      for(i = start_bin; i <= domain->parameters->num_bins; i++)
+        {
+          if((*slugs_head)->top < domain->groundwater_front[i])
+            {
+              break;
+            }
+        }
+
+      while((*slugs_head) != NULL)
+        {
+          collide = NULL;
+          tmp = domain->top_slug[i];
+          while(tmp != NULL)
+            {
+              //find the one, if any, slug that will potentially collide
+              if(tmp->top >= ground_max)
+                {
+                  //this slug is the first in the bottom of the bin
+                  //this will be the only slug of interest;
+                  collide = tmp;
+                  break;
+                }
+              tmp = tmp->next;
+            }
+
+          if(collide == NULL)
+            {
+              if((*slugs_head)->bot <= domain->groundwater_front[i])
+                {
+                  //slug fits entirely in this bin
+                  tmp = (*slugs_head)->next;
+                  error = add_binned_slug(domain, &(*slugs_head), i);
+                  (*slugs_head) = tmp;
+                  break;
+                }
+              //otherwise it merges into groundwater front
+              double new_top = domain->groundwater_front[i];
+              domain->groundwater_front[i] = (*slugs_head)->top;
+              (*slugs_head)->top = new_top;
+              i++;
+              continue;
+            }
+          else if((*slugs_head)->top >= collide->top)
+            {
+              //water cannot go in this bin above the slug
+              i++;
+              continue;
+            }
+          if((*slugs_head)->bot <= collide->top)
+            {
+              //slug fits entirely in this bin
+              tmp = (*slugs_head)->next;
+              error = add_binned_slug(domain, &(*slugs_head), i);
+              (*slugs_head) = tmp;
+              break;
+            }
+          else
+            {
+              //slug must collide
+              //merge slugs and continue
+              double new_top = collide->top;
+              set_slug_top(domain, i, collide, (*slugs_head)->top);
+              (*slugs_head)->top = new_top;
+              i++;
+              continue;
+            }
+        }
+    }
+  return error;
+}
+
+/* Stably sort an array of slugs with a bottom up merge sort.  If by_bot is
+ * FALSE the slugs are sorted by top from shallowest to deepest.  If by_bot is
+ * TRUE they are sorted by bot from deepest to shallowest.  Adjacent runs that
+ * are already in order are copied without comparing every element so input
+ * that is nearly sorted takes close to linear time.
+ *
+ * Parameters:
+ *
+ * slugs     - A 1D array of num_slugs slug pointers with zero based indexing.
+ * scratch   - A 1D array of at least num_slugs slug pointers used as
+ *             temporary storage.
+ * num_slugs - The number of slugs to sort.
+ * by_bot    - Whether to sort by bot instead of top.
+ */
+void merge_sort_slugs(slug** slugs, slug** scratch, int num_slugs, int by_bot)
+{
+  int    width;            // The length of the runs being merged.
+  int    left;             // The start of the left  run.
+  int    middle;           // The start of the right run.
+  int    right;            // One past the end of the right run.
+  int    ii, jj, kk;       // Loop counters.
+  slug** from = slugs;     // The array being merged from.
+  slug** to   = scratch;   // The array being merged into.
+  slug** temp;
+
+  for (width = 1; width < num_slugs; width *= 2)
+    {
+      for (left = 0; left < num_slugs; left += 2 * width)
+        {
+          middle = min(left + width, num_slugs);
+          right  = min(left + 2 * width, num_slugs);
+          ii     = left;
+          jj     = middle;
+          kk     = left;
+
+          // If the runs are already in order skip straight to copying them.
+          if (middle < right && (by_bot ? from[middle - 1]->bot >= from[middle]->bot : from[middle - 1]->top <= from[middle]->top))
+            {
+              jj = right;
+            }
+
+          while (ii < middle && jj < right)
+            {
+              // Take from the left run on ties to keep the sort stable.
+              if (by_bot ? from[ii]->bot >= from[jj]->bot : from[ii]->top <= from[jj]->top)
+                {
+                  to[kk++] = from[ii++];
+                }
+              else
+                {
+                  to[kk++] = from[jj++];
+                }
+            }
+
+          while (ii < middle)
+            {
+              to[kk++] = from[ii++];
+            }
+
+          // If the runs were already in order the right run has not been copied.
+          for (jj = kk; jj < right; jj++)
+            {
+              to[jj] = from[jj];
+            }
+        }
+
+      temp = from;
+      from = to;
+      to   = temp;
+    }
+
+  if (from != slugs)
+    {
+      for (ii = 0; ii < num_slugs; ii++)
+        {
+          slugs[ii] = from[ii];
+        }
+    }
+}
+
+/* Link an array of slugs into a doubly linked list in array order and return
+ * the head of the list or NULL if the array is empty.
+ *
+ * Parameters:
+ *
+ * slugs     - A 1D array of num_slugs slug pointers with zero based indexing.
+ * num_slugs - The number of slugs to link.
+ * end       - A pointer passed by reference that will be set to the tail of
+ *             the list or NULL if the array is empty.
+ */
+slug* link_slugs(slug** slugs, int num_slugs, slug** end)
+{
+  int ii; // Loop counter.
+
+  for (ii = 0; ii < num_slugs; ii++)
+    {
+      slugs[ii]->prev = (0 < ii)             ? slugs[ii - 1] : NULL;
+      slugs[ii]->next = (ii + 1 < num_slugs) ? slugs[ii + 1] : NULL;
+    }
+
+  *end = (0 < num_slugs) ? slugs[num_slugs - 1] : NULL;
+
+  return (0 < num_slugs) ? slugs[0] : NULL;
+}
+
+/* A section_slugs struct holds the slugs going into the top, middle, or
+ * bottom section of the domain during t_o_redistribute.  The array is filled
+ * from the end toward the beginning so that it ends up in reverse order of
+ * being added.  Stably sorting it then puts slugs with equal keys in the same
+ * order as inserting them one at a time at the front of the equal keys of a
+ * sorted linked list, which is what the code did before.
+ */
+typedef struct
+{
+  slug** slugs; // 1D array with zero based indexing.  Elements first to capacity - 1 are filled in.
+  int    first; // The index of the most recently added slug.
+} section_slugs;
+
+/* Add a slug to a section_slugs struct.
+ *
+ * Parameters:
+ *
+ * section  - A pointer to the section_slugs struct.
+ * new_slug - The slug to add.
+ */
+void section_slugs_add(section_slugs* section, slug* new_slug)
+{
+  assert(NULL != section && 0 < section->first && NULL != new_slug);
+
+  section->slugs[--section->first] = new_slug;
+}
+
+/* Cut one slug at the surface front and groundwater front of first_bin and
+ * add the pieces to the top, middle, and bottom sections.
+ * Return TRUE if there is an error, FALSE otherwise.
+ * If there is an error some pieces might not have been added to any section.
+ *
+ * Parameters:
+ *
+ * domain    - A pointer to the t_o_domain struct.
+ * head      - The slug to cut.
+ * first_bin - The bin whose fronts define the sections.
+ * top       - The slugs above the surface front.
+ * mid       - The slugs between the fronts.
+ * bot       - The slugs below the groundwater front.
+ */
+int cut_slug_into_sections(t_o_domain* domain, slug* head, int first_bin, section_slugs* top, section_slugs* mid, section_slugs* bot)
+{
+  int    error          = FALSE;                             // Error flag.
+  double surface_front  = domain->surface_front[first_bin];
+  double ground_front   = domain->yes_groundwater ? domain->groundwater_front[first_bin] : domain->layer_bottom_depth;
+  slug*  new_top;                                            // A piece cut off the top    of head.
+  slug*  new_bot;                                            // A piece cut off the bottom of head.
+
+  if (head->bot <= surface_front)
+    {
+      // This entire slug goes into the top section.
+      section_slugs_add(top, head);
+    }
+  else if (domain->yes_groundwater && head->top >= ground_front)
+    {
+      // This entire slug goes into the bottom section.
+      section_slugs_add(bot, head);
+    }
+  else if ((!domain->yes_groundwater || head->bot <= ground_front) && head->top >= surface_front)
+    {
+      // This entire slug goes into the middle section.
+      section_slugs_add(mid, head);
+    }
+  else if (head->top < surface_front && (!domain->yes_groundwater || head->bot <= ground_front))
+    {
+      // The slug spans the top and middle sections.
+      error = slug_alloc(&new_bot, surface_front, head->bot);
+
+      if (!error)
+        {
+          head->bot = new_bot->top;
+          section_slugs_add(top, head);
+          section_slugs_add(mid, new_bot);
+        }
+    }
+  else if (head->top >= surface_front)
+    {
+      // The slug spans the middle and bottom sections.
+      error = slug_alloc(&new_top, head->top, ground_front);
+
+      if (!error)
+        {
+          head->top = new_top->bot;
+          section_slugs_add(bot, head);
+          section_slugs_add(mid, new_top);
+        }
+    }
+  else
+    {
+      // The slug spans all three sections.
+      error = slug_alloc(&new_top, head->top, surface_front);
+
+      if (!error)
+        {
+          error = slug_alloc(&new_bot, ground_front, head->bot);
+
+          if (error)
+            {
+              slug_dealloc(&new_top);
+            }
+        }
+
+      if (!error)
+        {
+          head->top = new_top->bot;
+          head->bot = new_bot->top;
+          section_slugs_add(top, new_top);
+          section_slugs_add(mid, head);
+          section_slugs_add(bot, new_bot);
+        }
+    }
+
+  return error;
+}
+
+/* Find the smallest range of a front that has to be sorted for the whole
+ * front to be sorted.  Sorting just that range gives the same result as
+ * sorting all of the front.
+ * Return TRUE if the front is out of order, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * front        - A 1D array of num_elements depths with zero based indexing.
+ * num_elements - The number of elements in front.
+ * descending   - Whether the front is sorted from largest to smallest instead
+ *                of smallest to largest.
+ * first        - A scalar passed by reference.  Will be set to the first
+ *                element of the range if the front is out of order.
+ * last         - A scalar passed by reference.  Will be set to the last
+ *                element of the range if the front is out of order.
+ */
+int front_disorder(double* front, int num_elements, int descending, int* first, int* last)
+{
+  int    ii;         // Loop counter.
+  int    lo = -1;    // The element before the first one that is out of order with the one before it.
+  int    hi = -1;    // The last element that is out of order with the one before it.
+  double least;      // The element of front[lo] to front[hi] that sorts first.
+  double greatest;   // The element of front[lo] to front[hi] that sorts last.
+
+  for (ii = 1; ii < num_elements; ii++)
+    {
+      if (front_before(front[ii], front[ii - 1], descending))
+        {
+          if (-1 == lo)
+            {
+              lo = ii - 1;
+            }
+
+          hi = ii;
+        }
+    }
+
+  if (-1 != lo)
+    {
+      least    = front[lo];
+      greatest = front[lo];
+
+      for (ii = lo + 1; ii <= hi; ii++)
+        {
+          if (front_before(front[ii], least, descending))
+            {
+              least = front[ii];
+            }
+
+          if (front_before(greatest, front[ii], descending))
+            {
+              greatest = front[ii];
+            }
+        }
+
+      // Elements outside of the range that the range's elements need to pass are part of it too.
+      while (0 < lo && front_before(least, front[lo - 1], descending))
+        {
+          lo--;
+        }
+
+      while (num_elements - 1 > hi && front_before(front[hi + 1], greatest, descending))
+        {
+          hi++;
+        }
+
+      *first = lo;
+      *last  = hi;
+    }
+
+  return -1 != lo;
+}
+
+/* Sort the surface_front bins from deepest to shallowest and the
+ * groundwater_front bins from shallowest to deepest starting at first_bin.
+ * Only the range of each front found by front_disorder is sorted.  The number
+ * of elements that moved is added to domain->statistics.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * domain       - A pointer to the t_o_domain struct.
+ * first_bin    - The leftmost bin that is not completely full of water.
+ * out_of_order - A scalar passed by reference.  Will be set to whether
+ *                either front was out of order.
+ */
+int redistribute_sort_fronts(t_o_domain* domain, int first_bin, int* out_of_order)
+{
+  int     error               = FALSE;                                  // Error flag.
+  int     num_elements        = domain->parameters->num_bins - first_bin + 1; // The number of bins to sort.
+  int     surface_first       = 0;                                      // The range of surface_front to sort.
+  int     surface_last        = -1;
+  int     groundwater_first   = 0;                                      // The range of groundwater_front to sort.
+  int     groundwater_last    = -1;
+  int     surface_disorder    = front_disorder(domain->surface_front + first_bin, num_elements, TRUE, &surface_first, &surface_last);
+  int     groundwater_disorder = domain->yes_groundwater &&
+                                 front_disorder(domain->groundwater_front + first_bin, num_elements, FALSE, &groundwater_first, &groundwater_last);
+  int     range               = max(surface_last - surface_first + 1, groundwater_last - groundwater_first + 1); // The largest range to sort.
+  double* front_scratch;                                                // 1D array used by sort_front.
+
+  *out_of_order                                   = surface_disorder || groundwater_disorder;
+  domain->statistics.last_surface_front_moved     = 0;
+  domain->statistics.last_groundwater_front_moved = 0;
+
+  if (*out_of_order)
+    {
+      error = arena_v_alloc(domain->scratch, (void**)&front_scratch, 2 * range * sizeof(double));
+
+      if (!error)
+        {
+          domain->statistics.num_front_sorts++;
+
+          if (surface_disorder)
+            {
+              domain->statistics.last_surface_front_moved = sort_front(domain->surface_front + first_bin + surface_first, front_scratch,
+                                                                       surface_last - surface_first + 1, TRUE);
+              domain->statistics.surface_front_moved     += domain->statistics.last_surface_front_moved;
+
+              // The sorted range runs from its deepest value in its first bin to its shallowest value in its last bin.
+              mark_dirty(domain, first_bin + surface_first, domain->surface_front[first_bin + surface_last],
+                         domain->surface_front[first_bin + surface_first]);
+              mark_dirty(domain, first_bin + surface_last, domain->surface_front[first_bin + surface_last],
+                         domain->surface_front[first_bin + surface_first]);
+            }
+
+          if (groundwater_disorder)
+            {
+              domain->statistics.last_groundwater_front_moved = sort_front(domain->groundwater_front + first_bin + groundwater_first, front_scratch,
+                                                                           groundwater_last - groundwater_first + 1, FALSE);
+              domain->statistics.groundwater_front_moved     += domain->statistics.last_groundwater_front_moved;
+
+              // The sorted range runs from its shallowest value in its first bin to its deepest value in its last bin.
+              mark_dirty(domain, first_bin + groundwater_first, domain->groundwater_front[first_bin + groundwater_first],
+                         domain->groundwater_front[first_bin + groundwater_last]);
+              mark_dirty(domain, first_bin + groundwater_last, domain->groundwater_front[first_bin + groundwater_first],
+                         domain->groundwater_front[first_bin + groundwater_last]);
+            }
+        }
+
+      arena_reset(domain->scratch);
+    }
+
+  return error;
+}
+
+/* Return TRUE if the water of bin is stored the way redistribution leaves
+ * it, FALSE otherwise.  These are the conditions on a single bin checked by
+ * t_o_check_invariant.  A full bin has no surface water and no slugs.
+ * Otherwise the surface front, the slugs, and the groundwater front are in
+ * order from the top of the layer to the bottom, none of them touch, and
+ * each slug is at least as deep as it is shallow.
+ *
+ * Parameters:
+ *
+ * domain - A pointer to the t_o_domain struct.
+ * bin    - The bin to check.
+ */
+int bin_is_settled(t_o_domain* domain, int bin)
+{
+  int    settled;                                  // Whether bin is settled.
+  double above = domain->surface_front[bin];       // The deepest water above the next slug.
+  slug*  temp_slug;
+
+  if ((domain->yes_groundwater && domain->layer_top_depth == domain->groundwater_front[bin]) ||
+      (!domain->yes_groundwater && domain->parameters->bin_water_content[bin] <= domain->initial_water_content))
+    {
+      // The bin is completely saturated.
+      settled = domain->layer_top_depth == domain->surface_front[bin] && NULL == domain->top_slug[bin];
+    }
+  else
+    {
+      settled = domain->layer_top_depth <= above &&
+          (domain->yes_groundwater ? (above < domain->groundwater_front[bin] && domain->groundwater_front[bin] <= domain->layer_bottom_depth) :
+                                     above <= domain->layer_bottom_depth);
+
+      for (temp_slug = domain->top_slug[bin]; settled && NULL != temp_slug; temp_slug = temp_slug->next)
+        {
+          settled = above < temp_slug->top && temp_slug->top < temp_slug->bot;
+          above   = temp_slug->bot;
+        }
+
+      if (settled && NULL != domain->top_slug[bin])
+        {
+          settled = domain->yes_groundwater ? above < domain->groundwater_front[bin] : above <= domain->layer_bottom_depth;
+        }
+    }
+
+  return settled;
+}
+
+/* If there is water in bin from top to bot inside the dirty depths of domain
+ * and not in the bin to its left then lower *start_bin to the leftmost bin
+ * that water can be moved into.  That is the bin to the right of the nearest
+ * bin that has water at all of those depths.
+ *
+ * Parameters:
+ *
+ * domain    - A pointer to the t_o_domain struct.
+ * first_bin - The leftmost bin that is not completely full of water.
+ * bin       - The bin that has the water.  Must be greater than first_bin.
+ * top       - The top of the water in meters.
+ * bot       - The bottom of the water in meters.
+ * start_bin - A scalar passed by reference.  Lowered to the leftmost bin
+ *             the water can be moved into.
+ */
+void find_dry_bin_to_left(t_o_domain* domain, int first_bin, int bin, double top, double bot, int* start_bin)
+{
+  int ii; // The leftmost bin found so far without water at all depths from top to bot.
+
+  top = max(top, max(domain->dirty.top, domain->layer_top_depth));
+  bot = min(bot, min(domain->dirty.bot, domain->layer_bottom_depth));
+
+  if (top < bot && !has_water_at_depth(domain, bin - 1, top, bot))
+    {
+      ii = bin - 1;
+
+      while (ii > first_bin && !has_water_at_depth(domain, ii - 1, top, bot))
+        {
+          ii--;
+        }
+
+      *start_bin = min(*start_bin, ii);
+    }
+}
+
+/* Return the leftmost bin that redistribution needs to place slugs in again
+ * or num_bins + 1 if there is no such bin.  Before the timestep every bin was
+ * settled and there was no wet bin to the right of a dry bin at any depth, so
+ * that can only have changed inside domain->dirty.  The dirty bins are checked
+ * with bin_is_settled, and the water of each bin from the leftmost dirty bin
+ * to the bin right of the rightmost dirty bin is checked against the bin to
+ * its left at the dirty depths.  Bins left of the returned bin are the same
+ * as redistributing from first_bin would leave them.
+ *
+ * Parameters:
+ *
+ * domain    - A pointer to the t_o_domain struct.
+ * first_bin - The leftmost bin that is not completely full of water.
+ */
+int redistribute_start_bin(t_o_domain* domain, int first_bin)
+{
+  int   start_bin = domain->parameters->num_bins + 1;                       // The leftmost bin found so far that needs work.
+  int   last_bin  = min(domain->parameters->num_bins, domain->dirty.last_bin + 1); // The rightmost bin to check against its left.
+  int   ii;                                                                 // Loop counter.
+  slug* temp_slug;
+
+  for (ii = max(first_bin, domain->dirty.first_bin); ii <= last_bin && first_bin < start_bin; ii++)
+    {
+      if (ii <= domain->dirty.last_bin && !bin_is_settled(domain, ii))
+        {
+          start_bin = min(start_bin, ii);
+        }
+
+      if (first_bin < ii)
+        {
+          if ((domain->yes_groundwater && domain->layer_top_depth == domain->groundwater_front[ii]) ||
+              (!domain->yes_groundwater && domain->parameters->bin_water_content[ii] <= domain->initial_water_content))
+            {
+              find_dry_bin_to_left(domain, first_bin, ii, domain->layer_top_depth, domain->layer_bottom_depth, &start_bin);
+            }
+          else
+            {
+              find_dry_bin_to_left(domain, first_bin, ii, domain->layer_top_depth, domain->surface_front[ii], &start_bin);
+
+              for (temp_slug = domain->top_slug[ii]; NULL != temp_slug; temp_slug = temp_slug->next)
+                {
+                  find_dry_bin_to_left(domain, first_bin, ii, temp_slug->top, temp_slug->bot, &start_bin);
+                }
+
+              if (domain->yes_groundwater)
+                {
+                  find_dry_bin_to_left(domain, first_bin, ii, domain->groundwater_front[ii], domain->layer_bottom_depth, &start_bin);
+                }
+            }
+        }
+    }
+
+  return start_bin;
+}
+
+/* Redistribute water within the domain sideways-tetris-style
+ * with no vertical movement of water so that at all depths
+ * there is no wet bin to the right of a dry bin.
+ * Return TRUE if there is an error, FALSE otherwise.
+ * If there is an error some but not all of the redistribution
+ * might have been done.
+ *
+ * All of the slugs are gathered into one array, sorted once by top with a
+ * merge sort, and cut into the top, middle, and bottom sections in a single
+ * sweep.  Each section is then sorted with the same merge sort and placed.
+ * The order of slugs with equal keys matches the sorted insertion into linked
+ * lists done by t_o_redistribute_list_sort so the results are bit for bit
+ * identical.  The fronts are re-sorted first with redistribute_sort_fronts,
+ * which only sorts the range of bins that are out of order after a timestep.
+ *
+ * Redistribution is lazy.  If there are no slugs and surface water does not
+ * reach groundwater in any bin then sorting the fronts restores the
+ * invariant and nothing else is done.  Otherwise only the bins from the one
+ * returned by redistribute_start_bin on are gathered and placed again, which
+ * is none of them if water only changed where it was already in order.  The
+ * timestep records where water changed in domain->dirty and this clears it.
+ * domain->statistics counts the calls that found nothing out of order, the
+ * ones that only sorted the fronts, and the ones that placed the slugs again
+ * from a bin right of first_bin or from first_bin.
+ *
+ * If domain->redistribution is T_O_REDISTRIBUTE_STAIRCASE the whole domain
+ * is converted to a t_o_staircase and back with redistribute_staircase
+ * instead, which gives the same result.  Those calls are counted as placing
+ * the slugs again from first_bin.
+ *
+ * Parameters:
+ *
+ * domain    - A pointer to the t_o_domain struct.
+ * first_bin - The leftmost bin that is not completely full of water.
+ *             t_o_redistribute can change first_bin, but we are not passing it
+ *             by reference and updating it because this is the last step and
+ *             we will call find_first_bin anew for the next timestep.
+ */
+int t_o_redistribute(t_o_domain* domain, int first_bin)
+{
+  int    error         = FALSE;     // Error flag.
+  int    ii;                        // Loop counter.
+  int    num_slugs     = 0;         // The number of slugs in the domain from start_bin on.
+  int    capacity;                  // The most slugs that can go in one section.
+  int    buffer_size   = 0;         // The number of elements of buffer.
+  slug** buffer        = NULL;      // Storage for all of the arrays below.
+  slug** all_slugs;                 // 1D array of all of the slugs in the domain from start_bin on.
+  slug** scratch;                   // 1D array used by merge_sort_slugs.
+  slug*  temp_slug;
+  section_slugs top, mid, bot;      // The slugs going into each section.
+  int    out_of_order;              // Whether the fronts were out of order.
+  int    fronts_meet;               // Whether surface water reaches groundwater.
+  int    start_bin;                 // The leftmost bin whose slugs are gathered and placed again.
+
+  //All bins are full, no redistribution necessary
+  if (first_bin > domain->parameters->num_bins)
+    {
+      clear_dirty(domain);
+      return 0;
+    }
+
+  if (T_O_REDISTRIBUTE_STAIRCASE == domain->redistribution)
+    {
+      domain->statistics.num_redistribute_full++;
+      return redistribute_staircase(domain);
+    }
+
+  error = redistribute_sort_fronts(domain, first_bin, &out_of_order);
+
+  // Once the fronts are sorted surface water can only reach groundwater in first_bin.
+  fronts_meet = domain->yes_groundwater && domain->surface_front[first_bin] != domain->layer_top_depth &&
+      domain->surface_front[first_bin] >= domain->groundwater_front[first_bin];
+
+  if (fronts_meet)
+    {
+      start_bin = first_bin;
+    }
+  else if (has_slugs(domain))
+    {
+      start_bin = redistribute_start_bin(domain, first_bin);
+    }
+  else
+    {
+      start_bin = domain->parameters->num_bins + 1;
+    }
+
+  clear_dirty(domain);
+
+  if (!error && start_bin > domain->parameters->num_bins)
+    {
+      if (out_of_order)
+        {
+          domain->statistics.num_redistribute_fronts_only++;
+        }
+      else
+        {
+          domain->statistics.num_redistribute_skipped++;
+        }
+
+      return error;
+    }
+
+  if (start_bin == first_bin)
+    {
+      domain->statistics.num_redistribute_full++;
+    }
+  else
+    {
+      domain->statistics.num_redistribute_local++;
+    }
+
+  // Allocate the arrays.  Each existing slug and each bin where the fronts collide add at most one slug to each section.
+  for (ii = start_bin; ii <= domain->parameters->num_bins; ii++)
+    {
+      for (temp_slug = domain->top_slug[ii]; NULL != temp_slug; temp_slug = temp_slug->next)
+        {
+          num_slugs++;
+        }
+    }
+
+  if (!error)
+    {
+      capacity    = num_slugs + domain->parameters->num_bins - first_bin + 1;
+      buffer_size = num_slugs + 4 * capacity;
+      error       = arena_v_alloc(domain->scratch, (void**)&buffer, buffer_size * sizeof(slug*));
+    }
+
+  if (!error)
+    {
+      all_slugs = buffer;
+      top.slugs = all_slugs + num_slugs;
+      mid.slugs = top.slugs + capacity;
+      bot.slugs = mid.slugs + capacity;
+      scratch   = bot.slugs + capacity;
+      top.first = capacity;
+      mid.first = capacity;
+      bot.first = capacity;
+    }
+
+  // Create slugs where surface water and groundwater overlap and fill those bins.
+  if (!error && domain->yes_groundwater && domain->surface_front[first_bin] != domain->layer_top_depth)
+    {
+      int new_first_bin = first_bin; // The first bin where the fronts do not overlap, which defines the sections.
+
+      for (ii = first_bin; ii <= domain->parameters->num_bins; ii++)
+        {
+          if (domain->surface_front[ii] < domain->groundwater_front[ii])
+            {
+              new_first_bin = ii;
+              break;
+            }
+        }
+
+      for (ii = first_bin; !error && ii <= domain->parameters->num_bins && domain->surface_front[ii] >= domain->groundwater_front[ii]; ii++)
+        {
+          if (domain->surface_front[ii] > domain->groundwater_front[ii])
+            {
+              error = slug_alloc(&temp_slug, domain->groundwater_front[ii], domain->surface_front[ii]);
+
+              if (!error)
+                {
+                  error = cut_slug_into_sections(domain, temp_slug, new_first_bin, &top, &mid, &bot);
+                }
+            }
+
+          domain->surface_front[ii]     = domain->layer_top_depth;
+          domain->groundwater_front[ii] = domain->layer_top_depth;
+        }
+
+      first_bin = new_first_bin;
+    }
+
+  if (!error)
+    {
+      // Gather the slugs in the reverse of the order the old code inserted them in, right to left and top to bottom, so that a stable sort puts
+      // slugs with equal tops in the same order.
+      num_slugs = 0;
+
+      for (ii = start_bin; ii <= domain->parameters->num_bins; ii++)
+        {
+          for (temp_slug = domain->bot_slug[ii]; NULL != temp_slug; temp_slug = temp_slug->prev)
+            {
+              all_slugs[num_slugs++] = temp_slug;
+            }
+
+          clear_bin_slugs(domain, ii);
+        }
+
+      merge_sort_slugs(all_slugs, scratch, num_slugs, FALSE);
+
+      // Put all the slugs in their appropriate sections.
+      for (ii = 0; !error && ii < num_slugs; ii++)
+        {
+          error = cut_slug_into_sections(domain, all_slugs[ii], first_bin, &top, &mid, &bot);
+        }
+    }
+
+  // Redistribute in this order so that we only need to check collisions for middle slugs.
+  if (!error)
+    {
+      slug* head;
+      slug* end;
+
+      merge_sort_slugs(top.slugs + top.first, scratch, capacity - top.first, FALSE);
+      head  = link_slugs(top.slugs + top.first, capacity - top.first, &end);
+      error = redistribute_top_slugs(domain, &head, &end, first_bin, max(start_bin, first_bin));
+
+      if (!error && domain->yes_groundwater)
+        {
+          merge_sort_slugs(bot.slugs + bot.first, scratch, capacity - bot.first, TRUE);
+          head  = link_slugs(bot.slugs + bot.first, capacity - bot.first, &end);
+          error = redistribute_bot_slugs(domain, &head, &end, first_bin, max(start_bin, first_bin));
+        }
+      else
+        {
+          assert(error || capacity == bot.first);
+        }
+
+      if (!error)
+        {
+          merge_sort_slugs(mid.slugs + mid.first, scratch, capacity - mid.first, FALSE);
+          head  = link_slugs(mid.slugs + mid.first, capacity - mid.first, &end);
+          error = redistribute_mid_slugs(domain, &head, &end, first_bin, max(start_bin, first_bin));
+        }
+    }
+
+  arena_reset(domain->scratch);
+
+  return error;
+}
+
+/* The operation of the code can shave slivers off of slugs creating extra slug
+ * structs that take time to process, but are tiny and shouldn't really exist.
+ * Move that water down to whatever is below it.
+ *
+ * Parameters:
+ *
+ * domain    - A pointer to the t_o_domain struct.
+ */
+void t_o_handle_sliver_slugs(t_o_domain* domain)
+{
+  int ii; // Loop counter.
+
+  for (ii = 1; ii < domain->parameters->num_bins; ii++)
+    {
+      slug* temp_slug = domain->bot_slug[ii];
+
+      while (NULL != temp_slug)
+        {
+          slug*  prev_slug = temp_slug->prev;
+          double slug_size = temp_slug->bot - temp_slug->top;
+
+          if (SLIVER_SLUG_SIZE >= slug_size)
+            {
+              if (NULL != temp_slug->next)
+                {
+                  // Put the water in the next lower slug.
+                  set_slug_top(domain, ii, temp_slug->next, temp_slug->next->top - slug_size);
+                  kill_slug(domain, ii, temp_slug);
+                }
+              else if (domain->yes_groundwater)
+                {
+                  // Put the water in the groundwater.
+                  set_groundwater_front(domain, ii, domain->groundwater_front[ii] - slug_size);
+                  kill_slug(domain, ii, temp_slug);
+                }
+              else
+                {
+                  // Put the water at the bottom of the domain.
+                  set_slug_top(domain, ii, temp_slug, domain->layer_bottom_depth - slug_size);
+                  set_slug_bot(domain, ii, temp_slug, domain->layer_bottom_depth);
+                }
+            }
+
+          temp_slug = prev_slug;
+        }
+    }
+}
+
+/* Return TRUE if any bin of the domain has a slug, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * domain - A pointer to the t_o_domain struct.
+ */
+int has_slugs(t_o_domain* domain)
+{
+  int ii = 2; // Loop counter.  Bin 1 never has slugs.
+
+  assert(NULL != domain);
+
+  while (ii <= domain->parameters->num_bins && NULL == domain->top_slug[ii])
+    {
+      ii++;
+    }
+
+  return ii <= domain->parameters->num_bins;
+}
+
+/* Comment in .h file. */
+int t_o_quiescent(t_o_domain* domain, double surfacewater_depth, double water_table)
+{
+  int quiescent = (NULL != domain && 0.0 == surfacewater_depth && !has_slugs(domain)); // The return value.
+  int first_bin;                                                                     // The leftmost bin that is not completely full of water.
+  int ii;                                                                            // Loop counter.
+
+  if (quiescent)
+    {
+      first_bin = find_first_bin(domain, 2);
+
+      // With no surface water t_o_satisfy_saturated_bins must find the saturated bins not ponded.  See demand2 there.
+      quiescent = (domain->parameters->num_bins >= first_bin && 0.0 < domain->parameters->cumulative_conductivity[(2 < first_bin) ? first_bin - 2 : 1]);
+
+      for (ii = first_bin; quiescent && ii <= domain->parameters->num_bins; ii++)
+        {
+          quiescent = (domain->layer_top_depth == domain->surface_front[ii]);
+        }
+    }
+
+  if (quiescent && domain->yes_groundwater)
+    {
+      // t_o_groundwater must not lower first_bin, and every groundwater front must relax toward a hydrostatic depth below the surface without
+      // reaching the water table so that first_bin does not change and groundwater_distance uses the same formula the whole time.
+      quiescent = (2 == first_bin || domain->layer_top_depth >= water_table - domain->parameters->bin_capillary_suction[first_bin - 1]);
+
+      for (ii = first_bin; quiescent && ii <= domain->parameters->num_bins; ii++)
+        {
+          quiescent = (domain->layer_top_depth < water_table - domain->parameters->bin_capillary_suction[ii] &&
+                       domain->groundwater_front[ii] < water_table);
+        }
+    }
+
+  return quiescent;
+}
+
+/* Return the depth in meters of the groundwater front in a bin after it has
+ * relaxed toward hydrostatic equilibrium for duration seconds with no
+ * inflow.  The rate of groundwater_distance is constant while first_bin does
+ * not change so this is exact for any duration.
+ *
+ * Parameters:
+ *
+ * domain      - A pointer to the t_o_domain struct.
+ * bin         - Which bin to relax.
+ * first_bin   - The leftmost bin that is not completely full of water.
+ * duration    - The time in seconds to relax.
+ * water_table - The depth in meters of the water table.
+ */
+double groundwater_relaxation(t_o_domain* domain, int bin, int first_bin, double duration, double water_table)
+{
+  assert(NULL != domain && first_bin <= bin && bin <= domain->parameters->num_bins && 2 <= first_bin && 0.0 < duration &&
+         domain->groundwater_front[bin] < water_table);
+
+  double rate = (domain->parameters->cumulative_conductivity[bin] - domain->parameters->cumulative_conductivity[first_bin - 1]) /
+                (domain->parameters->bin_water_content[bin] - domain->parameters->bin_water_content[first_bin - 1]);
+
+  return green_ampt_groundwater_depth(domain->groundwater_front[bin], water_table, domain->parameters->bin_capillary_suction[bin], rate, duration);
+}
+
+/* Comment in .h file. */
+int t_o_fast_forward(t_o_domain* domain, double duration, double water_table, double* groundwater_recharge)
+{
+  int error = FALSE; // Error flag.
+  int first_bin;     // The leftmost bin that is not completely full of water.
+  int ii;            // Loop counter.
+
+  if (NULL == domain)
+    {
+      fprintf(stderr, "ERROR: domain must not be NULL\n");
+      error = TRUE;
+    }
+
+  if (0.0 >= duration)
+    {
+      fprintf(stderr, "ERROR: duration must be greater than zero\n");
+      error = TRUE;
+    }
+
+  if (0.0 > water_table)
+    {
+      fprintf(stderr, "ERROR: water_table must be greater than or equal to zero\n");
+      error = TRUE;
+    }
+
+  if (NULL == groundwater_recharge)
+    {
+      fprintf(stderr, "ERROR: groundwater_recharge must not be NULL\n");
+      error = TRUE;
+    }
+
+  if (!error && !t_o_quiescent(domain, 0.0, water_table))
+    {
+      fprintf(stderr, "ERROR: domain must be quiescent\n");
+      error = TRUE;
+    }
+
+  if (!error)
+    {
+      domain->statistics.num_fast_forwards++;
+      domain->statistics.fast_forward_time += duration;
+
+      if (domain->yes_groundwater)
+        {
+          first_bin = find_first_bin(domain, 2);
+
+          for (ii = first_bin; ii <= domain->parameters->num_bins; ii++)
+            {
+              double final_depth = groundwater_relaxation(domain, ii, first_bin, duration, water_table); // Depth in meters after relaxing.
+
+              // The front moves monotonically toward hydrostatic so if that is below the domain it stops at the bottom.
+              if (final_depth > domain->layer_bottom_depth)
+                {
+                  final_depth = domain->layer_bottom_depth;
+                }
+
+              *groundwater_recharge        += (final_depth - domain->groundwater_front[ii]) * domain->parameters->delta_water_content;
+              set_groundwater_front(domain, ii, final_depth);
+            }
+
+          error = t_o_redistribute(domain, first_bin);
+        }
+    }
+
+  return error;
+}
+
+/* Step the Talbot-Ogden simulation forward one timestep after the arguments
+ * have been checked.  This does the work of t_o_timestep and
+ * t_o_timestep_batch.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * domain               - A pointer to the t_o_domain struct.
+ * dt                   - The duration of the timestep in seconds.
+ * surfacewater_head    - The pressure head in meters of the surface water.
+ * surfacewater_depth   - A scalar passed by reference containing the depth
+ *                        in meters of the surface water.  Will be updated for
+ *                        the amount of infiltration.
+ * water_table          - The depth in meters of the water table.
+ * groundwater_recharge - A scalar passed by reference containing any
+ *                        previously accumulated groundwater recharge in meters
+ *                        of water.  Will be updated for the amount of water
+ *                        that flowed between the Talbot-Ogden domain and
+ *                        groundwater.
+ * first_bin            - The leftmost bin that is not completely full of
+ *                        water at the start of the timestep.
+ * update_dry_depth     - Whether infiltration needs to update the dry depth
+ *                        cache.  See update_dry_depth_cache.
+ */
+int timestep_checked(t_o_domain* domain, double dt, double surfacewater_head, double* surfacewater_depth, double water_table, double* groundwater_recharge,
+                     int first_bin, int update_dry_depth)
+{
+  assert(NULL != domain && 0.0 < dt && NULL != surfacewater_depth && 0.0 <= *surfacewater_depth && 0.0 <= water_table && NULL != groundwater_recharge &&
+         2 <= first_bin && first_bin <= domain->parameters->num_bins + 1);
+
+  int error = FALSE;    // Error flag.
+  int ponded_water = 0; // Flag set by t_o_satisfy_saturated_bins that must be passed to t_o_groundwater.
+  int quiescent;        // Whether the only thing left to do this timestep is move groundwater.
+
+  // FIXME, wencong 6/2/14, add variable inflow_rate for t_o_groundwater.
+  double inflow_rate = 0.0;  // Flow rate through fully saturated bins in unit of meters per second.
+  int    no_flow     = FALSE;  // FIXME, add no flow lower boundary, Jan. 09, 2015. 
+  if (!no_flow)
+    {
+       double recharge_old = *groundwater_recharge;
+      // Add water_table as passing parameter in t_o_satisfy_saturated_bins() 06/17/14.
+      error               = t_o_satisfy_saturated_bins(domain, dt, first_bin, surfacewater_depth, &ponded_water, groundwater_recharge, water_table);
+      inflow_rate         = (*groundwater_recharge - recharge_old) / dt; 
+    }
+
+  // If there is no water above groundwater now that the saturated bins are satisfied then infiltration and the slug steps do nothing.
+  quiescent = (!error && !ponded_water && 0.0 == *surfacewater_depth && !has_slugs(domain));
+
+  if (quiescent)
+    {
+      domain->statistics.num_quiescent_timesteps++;
+    }
+
+  if (!error && !quiescent)
+    { // FIXME, wencong, add ponded_water flag, infiltrate when ponded_water is TRUE even surfacewater_depth is zero.
+      // error = t_o_infiltrate(domain, dt, &first_bin, surfacewater_head, surfacewater_depth, groundwater_recharge);
+         error = t_o_infiltrate(domain, dt, &first_bin, surfacewater_head, surfacewater_depth, groundwater_recharge, ponded_water, update_dry_depth);
+    }
+
+  if (!error && !quiescent)
+    {
+      error = t_o_falling_slugs(domain, dt, first_bin, groundwater_recharge);
+    }
+
+  if (!error)
+    {
+      // FIXME, wencong 6/2/14, add inflow_rate.
+      // error = t_o_groundwater(domain, dt, &first_bin, water_table, ponded_water, groundwater_recharge);
+      error = t_o_groundwater(domain, dt, &first_bin, water_table, ponded_water, groundwater_recharge, inflow_rate);
+    }
+
+  if (!error && !quiescent)
+    {
+      t_o_handle_sliver_slugs(domain);
+    }
+  
+  // Without groundwater nothing moved in a quiescent timestep.
+  if (!error && !(quiescent && !domain->yes_groundwater))
+    {
+      error = t_o_redistribute(domain, first_bin);
+    }
+
+  // FIXME Do we want to call this here?  It is also being called by adhydro_check_invariant.
+#if (DEBUG_LEVEL & DEBUG_LEVEL_INTERNAL_ASSERTIONS)
+  if (!error)
+    {
+      t_o_check_invariant(domain); 
+    }
+#endif // (DEBUG_LEVEL & DEBUG_LEVEL_INTERNAL_ASSERTIONS)
+
+  return error;
+}
+
+/* Comment in .h file */
+int t_o_timestep(t_o_domain* domain, double dt, double surfacewater_head, double* surfacewater_depth, double water_table, double* groundwater_recharge)
+{
+  int error = FALSE; // Error flag.
+
+  if (NULL == domain)
+    {
+      fprintf(stderr, "ERROR: domain must not be NULL\n");
+      error = TRUE;
+    }
+
+  if (0.0 >= dt)
+    {
+      fprintf(stderr, "ERROR: dt must be greater than zero\n");
+      error = TRUE;
+    }
+
+  if (0.0 > water_table)
+    {
+      fprintf(stderr, "ERROR: water_table must be greater than or equal to zero\n");
+      error = TRUE;
+    }
+
+  if (NULL == surfacewater_depth)
+    {
+      fprintf(stderr, "ERROR: surfacewater_depth must not be NULL\n");
+      error = TRUE;
+    }
+  else if (0.0 > *surfacewater_depth)
+    {
+      fprintf(stderr, "ERROR: surfacewater_depth must be greater than or equal to zero\n");
+      error = TRUE;
+    }
+
+  if (NULL == groundwater_recharge)
+    {
+      fprintf(stderr, "ERROR: groundwater_recharge must not be NULL\n");
+      error = TRUE;
+    }
+
+  if (!error)
+    {
+      error = timestep_checked(domain, dt, surfacewater_head, surfacewater_depth, water_table, groundwater_recharge, find_first_bin(domain, 2), TRUE);
+    }
+
+  return error;
+}
+
+/* Comment in .h file */
+int t_o_timestep_batch(t_o_domain** domains, int num_domains, double dt, double* surfacewater_head, double* surfacewater_depth, double* water_table,
+                       double* groundwater_recharge)
+{
+  int             error      = FALSE; // Error flag.
+  int             ii;                 // Loop counter.
+  t_o_parameters* parameters = NULL;  // The parameters shared by all of the domains.
+
+  if (NULL == domains)
+    {
+      fprintf(stderr, "ERROR: domains must not be NULL\n");
+      error = TRUE;
+    }
+
+  if (0 >= num_domains)
+    {
+      fprintf(stderr, "ERROR: num_domains must be greater than zero\n");
+      error = TRUE;
+    }
+
+  if (0.0 >= dt)
+    {
+      fprintf(stderr, "ERROR: dt must be greater than zero\n");
+      error = TRUE;
+    }
+
+  if (NULL == surfacewater_head)
+    {
+      fprintf(stderr, "ERROR: surfacewater_head must not be NULL\n");
+      error = TRUE;
+    }
+
+  if (NULL == surfacewater_depth)
+    {
+      fprintf(stderr, "ERROR: surfacewater_depth must not be NULL\n");
+      error = TRUE;
+    }
+
+  if (NULL == water_table)
+    {
+      fprintf(stderr, "ERROR: water_table must not be NULL\n");
+      error = TRUE;
+    }
+
+  if (NULL == groundwater_recharge)
+    {
+      fprintf(stderr, "ERROR: groundwater_recharge must not be NULL\n");
+      error = TRUE;
+    }
+
+  if (!error)
+    {
+      for (ii = 0; ii < num_domains; ii++)
+        {
+          if (NULL == domains[ii])
+            {
+              fprintf(stderr, "ERROR: domains[%d] must not be NULL\n", ii);
+              error = TRUE;
+            }
+          else if (NULL == parameters)
+            {
+              parameters = domains[ii]->parameters;
+            }
+          else if (parameters != domains[ii]->parameters)
+            {
+              fprintf(stderr, "ERROR: domains[%d] does not share the same t_o_parameters struct as the other domains\n", ii);
+              error = TRUE;
+            }
+
+          if (0.0 > water_table[ii])
+            {
+              fprintf(stderr, "ERROR: water_table[%d] must be greater than or equal to zero\n", ii);
+              error = TRUE;
+            }
+
+          if (0.0 > surfacewater_depth[ii])
+            {
+              fprintf(stderr, "ERROR: surfacewater_depth[%d] must be greater than or equal to zero\n", ii);
+              error = TRUE;
+            }
+        }
+    }
+
+  if (!error)
+    {
+      int    dry_first_bin             = 0;   // first_bin of the last domain without groundwater, or zero if there hasn't been one.
+      double dry_initial_water_content = 0.0; // initial_water_content of that domain.
+
+      // All of the domains share the same dry depth cache so it only needs to be updated once.
+      error = update_dry_depth_cache(parameters, dt);
+
+      for (ii = 0; !error && ii < num_domains; ii++)
+        {
+          int first_bin; // The leftmost bin that is not completely full of water.
+
+          // Without groundwater first_bin only depends on the parameters and initial_water_content, which are often the same for every domain in the
+          // batch.
+          if (domains[ii]->yes_groundwater)
+            {
+              first_bin = find_first_bin(domains[ii], 2);
+            }
+          else if (0 != dry_first_bin && dry_initial_water_content == domains[ii]->initial_water_content)
+            {
+              first_bin = dry_first_bin;
+            }
+          else
+            {
+              first_bin                 = find_first_bin(domains[ii], 2);
+              dry_first_bin             = first_bin;
+              dry_initial_water_content = domains[ii]->initial_water_content;
+            }
+
+          error = timestep_checked(domains[ii], dt, surfacewater_head[ii], &surfacewater_depth[ii], water_table[ii], &groundwater_recharge[ii], first_bin,
+                                   FALSE);
+
+          if (error)
+            {
+              fprintf(stderr, "ERROR: Timestep failed for domains[%d]\n", ii);
+            }
+        }
+    }
+
+  return error;
+}
+
+#ifdef THREAD_SAFE
+// A worker's unclaimed domain indices are stored as a begin and end index packed into one word so that the owner claiming from the front and
+// thieves stealing from the back can both update it with a single compare and swap.
+#define PACK_RANGE(begin, end) ((((unsigned long long)(begin)) << 32) | (unsigned long long)(unsigned int)(end))
+#define RANGE_BEGIN(range)     ((int)((range) >> 32))
+#define RANGE_END(range)       ((int)((range) & 0xFFFFFFFFULL))
+
+/* A t_o_worker struct stores the state of one thread in a t_o_thread_pool. */
+typedef struct
+{
+  t_o_thread_pool* pool;           // The pool this worker belongs to.
+  int              index;          // This worker's index in pool->workers.
+  pthread_t        thread;         // The thread running this worker.
+  int              thread_created; // Flag so that we know whether to join the thread.
+  atomic_ullong    range;          // Packed begin and end of the domain indices this worker has not yet claimed.
+} t_o_worker;
+
+struct t_o_thread_pool
+{
+  int             num_threads;          // The number of worker threads.
+  t_o_worker*     workers;              // 1D array of num_threads workers with zero based indexing.
+  pthread_mutex_t mutex;                // Protects generation, num_finished, and shutdown.
+  pthread_cond_t  start_cond;           // Signaled when there is a new job or the pool is shutting down.
+  pthread_cond_t  done_cond;            // Signaled when the last worker finishes a job.
+  int             sync_initialized;     // Flag so that we know whether to destroy mutex, start_cond, and done_cond.
+  int             generation;           // Incremented for each job so that workers can tell a new job from a spurious wakeup.
+  int             num_finished;         // The number of workers that have finished the current job.
+  int             shutdown;             // Set to tell the workers to exit.
+  t_o_domain**    domains;              // The current job.  See t_o_timestep_parallel.
+  double          dt;
+  double*         surfacewater_head;
+  double*         surfacewater_depth;
+  double*         water_table;
+  double*         groundwater_recharge;
+  atomic_int      error;                // Error flag for the current job.
+};
+
+/* Claim the next domain index from the front of a worker's own range.
+ * Return the claimed index or -1 if the range is empty.
+ *
+ * Parameters:
+ *
+ * worker - A pointer to the t_o_worker struct.
+ */
+int worker_claim_domain(t_o_worker* worker)
+{
+  unsigned long long range = atomic_load(&worker->range); // The worker's packed range.
+  int                claimed = -1;                          // The claimed index.
+
+  while (-1 == claimed && RANGE_BEGIN(range) < RANGE_END(range))
+    {
+      if (atomic_compare_exchange_weak(&worker->range, &range, PACK_RANGE(RANGE_BEGIN(range) + 1, RANGE_END(range))))
+        {
+          claimed = RANGE_BEGIN(range);
+        }
+    }
+
+  return claimed;
+}
+
+/* Steal half of the unclaimed domain indices from the back of another
+ * worker's range and make them the worker's own range.  Victims are tried in
+ * order starting with the next worker.
+ * Return TRUE if anything was stolen, FALSE if every other worker's range was
+ * empty.
+ *
+ * Parameters:
+ *
+ * worker - A pointer to the t_o_worker struct doing the stealing.  Its own
+ *          range must be empty.
+ */
+int worker_steal_domains(t_o_worker* worker)
+{
+  int ii;             // Loop counter.
+  int stolen = FALSE; // Whether anything was stolen.
+
+  for (ii = 1; !stolen && ii < worker->pool->num_threads; ii++)
+    {
+      t_o_worker*        victim = &worker->pool->workers[(worker->index + ii) % worker->pool->num_threads];
+      unsigned long long range  = atomic_load(&victim->range);
+
+      while (!stolen && RANGE_BEGIN(range) < RANGE_END(range))
+        {
+          int new_end = RANGE_END(range) - (RANGE_END(range) - RANGE_BEGIN(range) + 1) / 2; // Take the larger half.
+
+          if (atomic_compare_exchange_weak(&victim->range, &range, PACK_RANGE(RANGE_BEGIN(range), new_end)))
+            {
+              atomic_store(&worker->range, PACK_RANGE(new_end, RANGE_END(range)));
+              stolen = TRUE;
+            }
+        }
+    }
+
+  return stolen;
+}
+
+/* The main function of each worker thread.  Wait for a job, step every domain
+ * that can be claimed or stolen, and report back until the pool shuts down.
+ *
+ * Parameters:
+ *
+ * arg - A pointer to the t_o_worker struct.
+ */
+void* worker_main(void* arg)
+{
+  t_o_worker*      worker     = (t_o_worker*)arg;
+  t_o_thread_pool* pool       = worker->pool;
+  int              generation = 0;    // The generation of the last job this worker did.
+  int              done       = FALSE; // Whether the pool is shutting down.
+
+  while (!done)
+    {
+      pthread_mutex_lock(&pool->mutex);
+
+      while (!pool->shutdown && generation == pool->generation)
+        {
+          pthread_cond_wait(&pool->start_cond, &pool->mutex);
+        }
+
+      done       = pool->shutdown;
+      generation = pool->generation;
+
+      pthread_mutex_unlock(&pool->mutex);
+
+      if (!done)
+        {
+          int ii; // The domain being stepped.
+
+          do
+            {
+              while (-1 != (ii = worker_claim_domain(worker)))
+                {
+                  if (timestep_checked(pool->domains[ii], pool->dt, pool->surfacewater_head[ii], &pool->surfacewater_depth[ii], pool->water_table[ii],
+                                       &pool->groundwater_recharge[ii], find_first_bin(pool->domains[ii], 2), FALSE))
+                    {
+                      fprintf(stderr, "ERROR: Timestep failed for domains[%d]\n", ii);
+                      atomic_store(&pool->error, TRUE);
+                    }
+                }
+            }
+          while (worker_steal_domains(worker));
+
+          pthread_mutex_lock(&pool->mutex);
+
+          pool->num_finished++;
+
+          if (pool->num_finished == pool->num_threads)
+            {
+              pthread_cond_signal(&pool->done_cond);
+            }
+
+          pthread_mutex_unlock(&pool->mutex);
+        }
+    }
+
+  slug_pool_flush_thread();
+
+  return NULL;
+}
+#endif // THREAD_SAFE
+
+/* Comment in .h file */
+int t_o_thread_pool_alloc(t_o_thread_pool** pool, int num_threads)
+{
+  int error = FALSE; // Error flag.
+#ifdef THREAD_SAFE
+  int ii;            // Loop counter.
+#endif // THREAD_SAFE
+
+  if (NULL == pool)
+    {
+      fprintf(stderr, "ERROR: pool must not be NULL\n");
+      error = TRUE;
+    }
+  else
+    {
+      *pool = NULL; // Prevent deallocating a random pointer.
+    }
+
+  if (0 >= num_threads)
+    {
+      fprintf(stderr, "ERROR: num_threads must be greater than zero\n");
+      error = TRUE;
+    }
+
+#ifdef THREAD_SAFE
+  if (!error)
+    {
+      error = v_alloc((void**)pool, sizeof(t_o_thread_pool));
+    }
+
+  if (!error)
+    {
+      (*pool)->num_threads = num_threads;
+      error                = v_alloc((void**)&(*pool)->workers, num_threads * sizeof(t_o_worker));
+    }
+
+  if (!error)
+    {
+      if (0 == pthread_mutex_init(&(*pool)->mutex, NULL))
+        {
+          if (0 == pthread_cond_init(&(*pool)->start_cond, NULL))
+            {
+              if (0 == pthread_cond_init(&(*pool)->done_cond, NULL))
+                {
+                  (*pool)->sync_initialized = TRUE;
+                }
+              else
+                {
+                  pthread_cond_destroy(&(*pool)->start_cond);
+                  pthread_mutex_destroy(&(*pool)->mutex);
+                }
+            }
+          else
+            {
+              pthread_mutex_destroy(&(*pool)->mutex);
+            }
+        }
+
+      if (!(*pool)->sync_initialized)
+        {
+          fprintf(stderr, "ERROR: Could not initialize thread pool mutex or condition variables\n");
+          error = TRUE;
+        }
+    }
+
+  for (ii = 0; !error && ii < num_threads; ii++)
+    {
+      (*pool)->workers[ii].pool  = *pool;
+      (*pool)->workers[ii].index = ii;
+      atomic_init(&(*pool)->workers[ii].range, PACK_RANGE(0, 0));
+
+      if (0 == pthread_create(&(*pool)->workers[ii].thread, NULL, worker_main, &(*pool)->workers[ii]))
+        {
+          (*pool)->workers[ii].thread_created = TRUE;
+        }
+      else
+        {
+          fprintf(stderr, "ERROR: Could not create thread %d\n", ii);
+          error = TRUE;
+        }
+    }
+
+  if (error && NULL != pool)
+    {
+      t_o_thread_pool_dealloc(pool);
+    }
+#else // THREAD_SAFE
+  if (!error)
+    {
+      fprintf(stderr, "ERROR: t_o.c must be compiled with THREAD_SAFE defined to use a thread pool\n");
+      error = TRUE;
+    }
+#endif // THREAD_SAFE
+
+  return error;
+}
+
+/* Comment in .h file */
+void t_o_thread_pool_dealloc(t_o_thread_pool** pool)
+{
+#ifdef THREAD_SAFE
+  int ii; // Loop counter.
+#endif // THREAD_SAFE
+
+  assert(NULL != pool);
+
+#ifdef THREAD_SAFE
+  if (NULL != pool && NULL != *pool)
+    {
+      if (NULL != (*pool)->workers)
+        {
+          if ((*pool)->sync_initialized)
+            {
+              // Tell the workers to exit.
+              pthread_mutex_lock(&(*pool)->mutex);
+              (*pool)->shutdown = TRUE;
+              pthread_cond_broadcast(&(*pool)->start_cond);
+              pthread_mutex_unlock(&(*pool)->mutex);
+
+              for (ii = 0; ii < (*pool)->num_threads; ii++)
+                {
+                  if ((*pool)->workers[ii].thread_created)
+                    {
+                      pthread_join((*pool)->workers[ii].thread, NULL);
+                    }
+                }
+
+              // Each worker gave the slug structs in its pool back to slug_pool before it exited.  Free them here because the domains might
+              // already have been deallocated.
+              slug_pool_dealloc();
+            }
+
+          v_dealloc((void**)&(*pool)->workers, (*pool)->num_threads * sizeof(t_o_worker));
+        }
+
+      if ((*pool)->sync_initialized)
+        {
+          pthread_cond_destroy(&(*pool)->done_cond);
+          pthread_cond_destroy(&(*pool)->start_cond);
+          pthread_mutex_destroy(&(*pool)->mutex);
+        }
+
+      // Deallocate the t_o_thread_pool struct.
+      v_dealloc((void**)pool, sizeof(t_o_thread_pool));
+    }
+#endif // THREAD_SAFE
+}
+
+/* Comment in .h file */
+int t_o_timestep_parallel(t_o_thread_pool* pool, t_o_domain** domains, int num_domains, double dt, double* surfacewater_head, double* surfacewater_depth,
+                          double* water_table, double* groundwater_recharge)
+{
+  int error = FALSE; // Error flag.
+  int ii;            // Loop counter.
+
+  if (NULL == pool)
+    {
+      fprintf(stderr, "ERROR: pool must not be NULL\n");
+      error = TRUE;
+    }
+
+  if (NULL == domains)
+    {
+      fprintf(stderr, "ERROR: domains must not be NULL\n");
+      error = TRUE;
+    }
+
+  if (0 >= num_domains)
+    {
+      fprintf(stderr, "ERROR: num_domains must be greater than zero\n");
+      error = TRUE;
+    }
+
+  if (0.0 >= dt)
+    {
+      fprintf(stderr, "ERROR: dt must be greater than zero\n");
+      error = TRUE;
+    }
+
+  if (NULL == surfacewater_head)
+    {
+      fprintf(stderr, "ERROR: surfacewater_head must not be NULL\n");
+      error = TRUE;
+    }
+
+  if (NULL == surfacewater_depth)
+    {
+      fprintf(stderr, "ERROR: surfacewater_depth must not be NULL\n");
+      error = TRUE;
+    }
+
+  if (NULL == water_table)
+    {
+      fprintf(stderr, "ERROR: water_table must not be NULL\n");
+      error = TRUE;
+    }
+
+  if (NULL == groundwater_recharge)
+    {
+      fprintf(stderr, "ERROR: groundwater_recharge must not be NULL\n");
+      error = TRUE;
+    }
+
+  for (ii = 0; !error && ii < num_domains; ii++)
+    {
+      if (NULL == domains[ii])
+        {
+          fprintf(stderr, "ERROR: domains[%d] must not be NULL\n", ii);
+          error = TRUE;
+        }
+
+      if (0.0 > water_table[ii])
+        {
+          fprintf(stderr, "ERROR: water_table[%d] must be greater than or equal to zero\n", ii);
+          error = TRUE;
+        }
+
+      if (0.0 > surfacewater_depth[ii])
+        {
+          fprintf(stderr, "ERROR: surfacewater_depth[%d] must be greater than or equal to zero\n", ii);
+          error = TRUE;
+        }
+    }
+
+#ifdef THREAD_SAFE
+  if (!error)
+    {
+      // Update the dry depth caches before the workers start so that they never have to.
+      for (ii = 0; !error && ii < num_domains; ii++)
+        {
+          if (0 == ii || domains[ii]->parameters != domains[ii - 1]->parameters)
+            {
+              error = update_dry_depth_cache(domains[ii]->parameters, dt);
+            }
+        }
+    }
+
+  if (!error)
+    {
+      pool->domains              = domains;
+      pool->dt                   = dt;
+      pool->surfacewater_head    = surfacewater_head;
+      pool->surfacewater_depth   = surfacewater_depth;
+      pool->water_table          = water_table;
+      pool->groundwater_recharge = groundwater_recharge;
+      atomic_store(&pool->error, FALSE);
+
+      // Start each worker on an equal share of the domains.  Workers that finish early steal from the others.
+      for (ii = 0; ii < pool->num_threads; ii++)
+        {
+          atomic_store(&pool->workers[ii].range, PACK_RANGE((long long)num_domains * ii / pool->num_threads,
+                                                            (long long)num_domains * (ii + 1) / pool->num_threads));
+        }
+
+      pthread_mutex_lock(&pool->mutex);
+
+      pool->num_finished = 0;
+      pool->generation++;
+      pthread_cond_broadcast(&pool->start_cond);
+
+      while (pool->num_finished < pool->num_threads)
+        {
+          pthread_cond_wait(&pool->done_cond, &pool->mutex);
+        }
+
+      pthread_mutex_unlock(&pool->mutex);
+
+      error = atomic_load(&pool->error);
+    }
+#endif // THREAD_SAFE
+
+  return error;
+}
+
+/* Copy the water in one Talbot-Ogden domain to another so that the other can
+ * be stepped or restored without touching the first.  The slugs already in
+ * destination are reused so that copying a domain that changed a little
+ * allocates little or nothing.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * destination - A pointer to the t_o_domain struct to copy to.  Must have the
+ *               same parameters, layer depths, and yes_groundwater as source.
+ * source      - A pointer to the t_o_domain struct to copy from.
+ */
+int copy_domain_state(t_o_domain* destination, t_o_domain* source)
+{
+  int   error = FALSE;    // Error flag.
+  int   ii;               // Loop counter.
+  slug* source_slug;      // The slug in source being copied.
+  slug* destination_slug; // The slug in destination it is copied to.
+  slug* prev_slug;        // The last slug copied in destination.
+
+  assert(NULL != destination && NULL != source && destination->parameters == source->parameters &&
+         destination->layer_top_depth == source->layer_top_depth && destination->layer_bottom_depth == source->layer_bottom_depth &&
+         destination->yes_groundwater == source->yes_groundwater);
+
+  destination->initial_water_content = source->initial_water_content;
+  destination->integrator            = source->integrator;
+  destination->redistribution        = source->redistribution;
+  destination->dirty                 = source->dirty;
+
+  for (ii = 1; !error && ii <= source->parameters->num_bins; ii++)
+    {
+      destination->surface_front[ii] = source->surface_front[ii];
+
+      if (source->yes_groundwater)
+        {
+          destination->groundwater_front[ii] = source->groundwater_front[ii];
+        }
+
+      source_slug      = source->top_slug[ii];
+      destination_slug = destination->top_slug[ii];
+      prev_slug        = NULL;
+
+      while (!error && NULL != source_slug)
+        {
+          if (NULL != destination_slug)
+            {
+              set_slug_top(destination, ii, destination_slug, source_slug->top);
+              set_slug_bot(destination, ii, destination_slug, source_slug->bot);
+              prev_slug        = destination_slug;
+              destination_slug = destination_slug->next;
+            }
+          else
+            {
+              error = create_slug_after(destination, ii, prev_slug, source_slug->top, source_slug->bot);
+
+              if (!error)
+                {
+                  prev_slug = destination->bot_slug[ii];
+                }
+            }
+
+          source_slug = source_slug->next;
+        }
+
+      // Remove the slugs destination has beyond the ones in source.
+      while (!error && NULL != destination_slug)
+        {
+          prev_slug        = destination_slug;
+          destination_slug = destination_slug->next;
+          kill_slug(destination, ii, prev_slug);
+        }
+    }
+
+  return error;
+}
+
+/* Comment in .h file. */
+int t_o_adaptive_alloc(t_o_adaptive** adaptive, t_o_domain* domain, double min_dt, double max_dt, double tolerance, double max_front_move)
+{
+  int error = FALSE; // Error flag.
+
+  if (NULL == adaptive)
+    {
+      fprintf(stderr, "ERROR: adaptive must not be NULL\n");
+      error = TRUE;
+    }
+  else
+    {
+      *adaptive = NULL; // Prevent deallocating a random pointer.
+    }
+
+  if (NULL == domain)
+    {
+      fprintf(stderr, "ERROR: domain must not be NULL\n");
+      error = TRUE;
+    }
+
+  if (0.0 >= min_dt)
+    {
+      fprintf(stderr, "ERROR: min_dt must be greater than zero\n");
+      error = TRUE;
+    }
+
+  if (min_dt > max_dt)
+    {
+      fprintf(stderr, "ERROR: max_dt must be greater than or equal to min_dt\n");
+      error = TRUE;
+    }
+
+  if (0.0 >= tolerance)
+    {
+      fprintf(stderr, "ERROR: tolerance must be greater than zero\n");
+      error = TRUE;
+    }
+
+  if (0.0 >= max_front_move)
+    {
+      fprintf(stderr, "ERROR: max_front_move must be greater than zero\n");
+      error = TRUE;
+    }
+
+  if (!error)
+    {
+      error = v_alloc((void**)adaptive, sizeof(t_o_adaptive));
+    }
+
+  if (!error)
+    {
+      (*adaptive)->min_dt         = min_dt;
+      (*adaptive)->max_dt         = min_dt;
+      (*adaptive)->tolerance      = tolerance;
+      (*adaptive)->max_front_move = max_front_move;
+      (*adaptive)->dt             = min_dt;
+
+      // Keep every step min_dt times a power of two.
+      while (2.0 * (*adaptive)->max_dt <= max_dt)
+        {
+          (*adaptive)->max_dt *= 2.0;
+        }
+
+      // The copies only hold water copied from domain so how they are initialized does not matter.
+      error = t_o_domain_alloc(&(*adaptive)->start, domain->parameters, domain->layer_top_depth, domain->layer_bottom_depth, domain->yes_groundwater,
+                               domain->initial_water_content, FALSE, domain->layer_bottom_depth) ||
+              t_o_domain_alloc(&(*adaptive)->trial, domain->parameters, domain->layer_top_depth, domain->layer_bottom_depth, domain->yes_groundwater,
+                               domain->initial_water_content, FALSE, domain->layer_bottom_depth);
+
+      if (error)
+        {
+          t_o_adaptive_dealloc(adaptive);
+        }
+    }
+
+  return error;
+}
+
+/* Comment in .h file. */
+void t_o_adaptive_dealloc(t_o_adaptive** adaptive)
+{
+  assert(NULL != adaptive);
+
+  if (NULL != adaptive && NULL != *adaptive)
+    {
+      if (NULL != (*adaptive)->start)
+        {
+          t_o_domain_dealloc(&(*adaptive)->start);
+        }
+
+      if (NULL != (*adaptive)->trial)
+        {
+          t_o_domain_dealloc(&(*adaptive)->trial);
+        }
+
+      v_dealloc((void**)adaptive, sizeof(t_o_adaptive));
+    }
+}
+
+/* Add rainfall to the surface water, step a Talbot-Ogden domain forward one
+ * timestep, and move the surface water left to runoff.  This is what the
+ * drivers do around each call to t_o_timestep.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * domain               - A pointer to the t_o_domain struct.
+ * dt                   - The duration of the timestep in seconds.
+ * rainfall_rate        - Meters of water per second.
+ * surfacewater_depth   - A scalar passed by reference containing the depth
+ *                        in meters of the surface water.
+ * water_table          - The depth in meters of the water table.
+ * groundwater_recharge - A scalar passed by reference containing the
+ *                        accumulated groundwater recharge in meters of water.
+ * runoff               - A scalar passed by reference containing the
+ *                        accumulated runoff in meters of water or NULL to
+ *                        leave the surface water on the surface.
+ */
+int adaptive_substep(t_o_domain* domain, double dt, double rainfall_rate, double* surfacewater_depth, double water_table, double* groundwater_recharge,
+                     double* runoff)
+{
+  int error; // Error flag.
+
+  *surfacewater_depth += rainfall_rate * dt;
+
+  error = timestep_checked(domain, dt, *surfacewater_depth, surfacewater_depth, water_table, groundwater_recharge, find_first_bin(domain, 2), TRUE);
+
+  if (!error && NULL != runoff)
+    {
+      *runoff            += *surfacewater_depth;
+      *surfacewater_depth = 0.0;
+    }
+
+  return error;
+}
+
+/* Comment in .h file. */
+int t_o_timestep_adaptive(t_o_domain* domain, t_o_adaptive* adaptive, double duration, double rainfall_rate, double* surfacewater_depth,
+                          double water_table, double* groundwater_recharge, double* runoff)
+{
+  int    error     = FALSE;    // Error flag.
+  int    ii;                   // Loop counter.
+  int    accepted;             // Whether the step is accepted.
+  double remaining = duration; // Seconds left to step.
+  double dt;                   // The step being tried in seconds.
+  double start_water;          // Water in the domain at the start of the step in meters of water.
+  double start_surfacewater;   // Surface water at the start of the step in meters of water.
+  double start_recharge;       // Groundwater recharge at the start of the step in meters of water.
+  double full_surfacewater;    // Surface water after the full step in meters of water.
+  double full_recharge;        // Groundwater recharge after the full step in meters of water.
+  double full_runoff;          // Runoff of the full step in meters of water.
+  double half_runoff;          // Runoff of the two half steps in meters of water.
+  double estimate;             // The difference between the full step and the two half steps in meters of water.
+  double mass_error;           // How much water the two half steps did not conserve in meters of water.
+  double move;                 // The farthest a surface front moved in meters.
+
+  if (NULL == domain)
+    {
+      fprintf(stderr, "ERROR: domain must not be NULL\n");
+      error = TRUE;
+    }
+
+  if (NULL == adaptive)
+    {
+      fprintf(stderr, "ERROR: adaptive must not be NULL\n");
+      error = TRUE;
+    }
+  else if (NULL != domain && adaptive->start->parameters != domain->parameters)
+    {
+      fprintf(stderr, "ERROR: adaptive must be allocated for domain\n");
+      error = TRUE;
+    }
+
+  if (0.0 >= duration)
+    {
+      fprintf(stderr, "ERROR: duration must be greater than zero\n");
+      error = TRUE;
+    }
+
+  if (0.0 > rainfall_rate)
+    {
+      fprintf(stderr, "ERROR: rainfall_rate must be greater than or equal to zero\n");
+      error = TRUE;
+    }
+
+  if (0.0 > water_table)
+    {
+      fprintf(stderr, "ERROR: water_table must be greater than or equal to zero\n");
+      error = TRUE;
+    }
+
+  if (NULL == surfacewater_depth)
+    {
+      fprintf(stderr, "ERROR: surfacewater_depth must not be NULL\n");
+      error = TRUE;
+    }
+  else if (0.0 > *surfacewater_depth)
+    {
+      fprintf(stderr, "ERROR: surfacewater_depth must be greater than or equal to zero\n");
+      error = TRUE;
+    }
+
+  if (NULL == groundwater_recharge)
+    {
+      fprintf(stderr, "ERROR: groundwater_recharge must not be NULL\n");
+      error = TRUE;
+    }
+
+  while (!error && 0.0 < remaining)
+    {
+      // With no rain a quiescent domain stays quiescent so the rest of the duration can be done at once.
+      if (0.0 == rainfall_rate && t_o_quiescent(domain, *surfacewater_depth, water_table))
+        {
+          error     = t_o_fast_forward(domain, remaining, water_table, groundwater_recharge);
+          remaining = 0.0;
+          continue;
+        }
+
+      dt = (adaptive->dt < remaining) ? adaptive->dt : remaining;
+
+      error = copy_domain_state(adaptive->start, domain) || copy_domain_state(adaptive->trial, domain);
+
+      start_water        = t_o_total_water_in_domain(domain);
+      start_surfacewater = *surfacewater_depth;
+      start_recharge     = *groundwater_recharge;
+      full_surfacewater  = start_surfacewater;
+      full_recharge      = start_recharge;
+      full_runoff        = 0.0;
+      half_runoff        = 0.0;
+
+      // The full step on the copy and the two half steps on domain.
+      error = error || adaptive_substep(adaptive->trial, dt, rainfall_rate, &full_surfacewater, water_table, &full_recharge,
+                                        (NULL != runoff) ? &full_runoff : NULL);
+      error = error || adaptive_substep(domain, 0.5 * dt, rainfall_rate, surfacewater_depth, water_table, groundwater_recharge,
+                                        (NULL != runoff) ? &half_runoff : NULL);
+      error = error || adaptive_substep(domain, 0.5 * dt, rainfall_rate, surfacewater_depth, water_table, groundwater_recharge,
+                                        (NULL != runoff) ? &half_runoff : NULL);
+
+      adaptive->num_timesteps += 3;
+
+      if (!error)
+        {
+          // Infiltration is what left the surface other than runoff.
+          estimate = fabs((full_surfacewater + full_runoff) - (*surfacewater_depth + half_runoff));
+
+          if (estimate < fabs(full_recharge - *groundwater_recharge))
+            {
+              estimate = fabs(full_recharge - *groundwater_recharge);
+            }
+
+          mass_error = fabs(start_water + start_surfacewater + rainfall_rate * dt -
+                            (t_o_total_water_in_domain(domain) + *surfacewater_depth + half_runoff + *groundwater_recharge - start_recharge));
+          move       = 0.0;
+
+          for (ii = 1; ii <= domain->parameters->num_bins; ii++)
+            {
+              // A front that detached into a slug did not move.
+              if (domain->layer_top_depth < domain->surface_front[ii] && move < fabs(domain->surface_front[ii] - adaptive->start->surface_front[ii]))
+                {
+                  move = fabs(domain->surface_front[ii] - adaptive->start->surface_front[ii]);
+                }
+            }
+
+          accepted = (adaptive->min_dt >= dt) ||
+                     (adaptive->tolerance >= estimate && adaptive->tolerance >= mass_error && adaptive->max_front_move >= move);
+
+          if (accepted)
+            {
+              adaptive->num_accepted++;
+              remaining = (dt == remaining) ? 0.0 : remaining - dt;
+
+              if (NULL != runoff)
+                {
+                  *runoff += half_runoff;
+                }
+
+              // Euler's local error goes as the square of the step so double it only if a quarter of the tolerance is left.
+              if (dt == adaptive->dt && adaptive->max_dt > adaptive->dt && 0.25 * adaptive->tolerance >= estimate &&
+                  0.5 * adaptive->max_front_move >= move)
+                {
+                  adaptive->dt *= 2.0;
+                }
+            }
+          else
+            {
+              adaptive->num_rejected++;
+              error                 = copy_domain_state(domain, adaptive->start);
+              *surfacewater_depth   = start_surfacewater;
+              *groundwater_recharge = start_recharge;
+
+              while (adaptive->min_dt < adaptive->dt && adaptive->dt >= dt)
+                {
+                  adaptive->dt *= 0.5;
+                }
+            }
+        }
+    }
+
+  return error;
+}
+
+/* Comment in .h file. */
+int t_o_events_alloc(t_o_events** events, t_o_domain* domain, double min_dt, double max_wet_dt, double max_dt)
+{
+  int error = FALSE; // Error flag.
+
+  if (NULL == events)
+    {
+      fprintf(stderr, "ERROR: events must not be NULL\n");
+      error = TRUE;
+    }
+  else
+    {
+      *events = NULL; // Prevent deallocating a random pointer.
+    }
+
+  if (NULL == domain)
+    {
+      fprintf(stderr, "ERROR: domain must not be NULL\n");
+      error = TRUE;
+    }
+
+  if (0.0 >= min_dt)
+    {
+      fprintf(stderr, "ERROR: min_dt must be greater than zero\n");
+      error = TRUE;
+    }
+
+  if (min_dt > max_wet_dt)
+    {
+      fprintf(stderr, "ERROR: max_wet_dt must be greater than or equal to min_dt\n");
+      error = TRUE;
+    }
+
+  if (max_wet_dt > max_dt)
+    {
+      fprintf(stderr, "ERROR: max_dt must be greater than or equal to max_wet_dt\n");
+      error = TRUE;
+    }
+
+  if (!error)
+    {
+      // With the cache filled for max_dt no step creates another snapshot no matter where the events fall.
+      error = update_dry_depth_cache(domain->parameters, max_dt);
+    }
+
+  if (!error)
+    {
+      error = v_alloc((void**)events, sizeof(t_o_events));
+    }
+
+  if (!error)
+    {
+      (*events)->parameters = domain->parameters;
+      (*events)->min_dt     = min_dt;
+      (*events)->max_wet_dt = max_wet_dt;
+      (*events)->max_dt     = max_dt;
+    }
+
+  return error;
+}
+
+/* Comment in .h file. */
+void t_o_events_dealloc(t_o_events** events)
+{
+  assert(NULL != events);
+
+  if (NULL != events && NULL != *events)
+    {
+      v_dealloc((void**)events, sizeof(t_o_events));
+    }
+}
+
+// The ways a boundary of water moves in time_to_next_collision.
+#define BOUNDARY_LINEAR      (0) // At a constant speed.
+#define BOUNDARY_SURFACE     (1) // Along the Green-Ampt solution for a wet surface front.
+#define BOUNDARY_GROUNDWATER (2) // Along the Green-Ampt solution for a groundwater front.
+
+#define COLLISION_TIME_TOLERANCE (1.0e-6) // Seconds.  How closely collision_time finds a collision.
+#define COLLISION_TIME_SAMPLES   (16)     // How many times collision_time samples a gap it cannot solve with Newton's method.
+
+// How a boundary between water and dry soil moves from the start of an event driven step.
+typedef struct
+{
+  int    kind;        // One of the BOUNDARY constants.
+  double depth;       // The depth in meters at the start of the step.
+  double speed;       // BOUNDARY_LINEAR: Meters per second.  Positive means down toward the bottom of the domain.
+  double rate;        // BOUNDARY_SURFACE and BOUNDARY_GROUNDWATER: The Green-Ampt rate in meters per second.
+  double suction;     // BOUNDARY_SURFACE and BOUNDARY_GROUNDWATER: The suction in meters.
+  double water_table; // BOUNDARY_GROUNDWATER: The depth in meters of the water table.
+} boundary_motion;
+
+/* Set a boundary_motion to move at a constant speed.
+ *
+ * Parameters:
+ *
+ * boundary - A pointer to the boundary_motion struct to set.
+ * depth    - The depth in meters at the start of the step.
+ * speed    - Meters per second.  Positive means down.
+ */
+void boundary_linear(boundary_motion* boundary, double depth, double speed)
+{
+  boundary->kind  = BOUNDARY_LINEAR;
+  boundary->depth = depth;
+  boundary->speed = speed;
+}
+
+/* Return the depth in meters of a boundary time seconds after the start of
+ * the step.  The Green-Ampt boundaries use the same solutions as
+ * T_O_INTEGRATOR_GREEN_AMPT so they end up where a step of that length
+ * would put them.
+ *
+ * Parameters:
+ *
+ * boundary - A pointer to the boundary_motion struct.
+ * time     - Seconds since the start of the step.
+ */
+double boundary_depth(const boundary_motion* boundary, double time)
+{
+  double depth = boundary->depth;
+
+  if (BOUNDARY_LINEAR == boundary->kind)
+    {
+      depth += boundary->speed * time;
+    }
+  else if (0.0 < time && 0.0 < boundary->rate)
+    {
+      if (BOUNDARY_SURFACE == boundary->kind)
+        {
+          depth += green_ampt_distance(boundary->depth, boundary->suction, boundary->rate, time);
+        }
+      else
+        {
+          depth = green_ampt_groundwater_depth(boundary->depth, boundary->water_table, boundary->suction, boundary->rate, time);
+        }
+    }
+
+  return depth;
+}
+
+/* Return the speed in meters per second of a boundary when it is at depth.
+ * Positive means down.
+ *
+ * Parameters:
+ *
+ * boundary - A pointer to the boundary_motion struct.
+ * depth    - The depth in meters of the boundary.
+ */
+double boundary_speed(const boundary_motion* boundary, double depth)
+{
+  double speed;
+
+  if (BOUNDARY_LINEAR == boundary->kind)
+    {
+      speed = boundary->speed;
+    }
+  else if (BOUNDARY_SURFACE == boundary->kind)
+    {
+      speed = boundary->rate * (boundary->suction / depth + 1.0);
+    }
+  else
+    {
+      speed = boundary->rate * (1.0 - boundary->suction / (boundary->water_table - depth));
+    }
+
+  return speed;
+}
+
+/* Return 1 if the depth of a boundary is convex in time, -1 if it is
+ * concave, or 0 if it is linear.  A surface front slows as it goes deeper.
+ * A groundwater front slows as it approaches hydrostatic, which is concave
+ * when it falls and convex when it rises.
+ *
+ * Parameters:
+ *
+ * boundary - A pointer to the boundary_motion struct.
+ */
+int boundary_curvature(const boundary_motion* boundary)
+{
+  int curvature = 0;
+
+  if (BOUNDARY_SURFACE == boundary->kind && 0.0 < boundary->rate)
+    {
+      curvature = -1;
+    }
+  else if (BOUNDARY_GROUNDWATER == boundary->kind && 0.0 < boundary->rate)
+    {
+      if (boundary->depth < boundary->water_table - boundary->suction)
+        {
+          curvature = -1;
+        }
+      else if (boundary->depth > boundary->water_table - boundary->suction)
+        {
+          curvature = 1;
+        }
+    }
+
+  return curvature;
+}
+
+/* Return the time in seconds until the upper boundary catches up with the
+ * lower boundary or max_time if that is later or never happens.  This is the
+ * first root of the gap lower - upper.  Every boundary keeps moving in the
+ * same direction ever more slowly, so the gap cannot close faster than the
+ * starting speeds allow, and gaps too wide to close by max_time at that pace
+ * are not solved for.  If the gap is convex, as when a
+ * surface front that is slowing down falls toward a slug, Newton's method
+ * started at zero approaches the first root from below and stops as soon as
+ * the gap stops shrinking.  If the gap is concave it can only cross zero
+ * once, and Newton's method started at max_time approaches the crossing
+ * from above.  Otherwise the gap is sampled to bracket the first root, which
+ * is then found by bisection.
+ *
+ * Parameters:
+ *
+ * upper    - A pointer to the boundary_motion struct of the upper boundary.
+ * lower    - A pointer to the boundary_motion struct of the lower boundary.
+ * max_time - The longest time in seconds to return.
+ */
+double collision_time(const boundary_motion* upper, const boundary_motion* lower, double max_time)
+{
+  int    upper_curvature   = boundary_curvature(upper);
+  int    lower_curvature   = boundary_curvature(lower);
+  double time              = 0.0;                                               // The estimate of the collision time in seconds.
+  double delta_time        = max_time;                                          // Newton step.
+  double gap               = boundary_depth(lower, 0.0) - boundary_depth(upper, 0.0); // Meters.
+  double closing;                                                               // How fast the gap shrinks in meters per second.
+  int    iteration_count   = 0;
+  int    maximum_iteration = 100;
+  int    ii;                                                                    // Loop counter.
+
+  // The fastest the gap can shrink is the downward speed of upper plus the upward speed of lower at the start.
+  closing = max(boundary_speed(upper, upper->depth), 0.0) - min(boundary_speed(lower, lower->depth), 0.0);
+
+  if (0.0 >= gap)
+    {
+      time = 0.0;
+    }
+  else if (gap >= closing * max_time)
+    {
+      time = max_time;
+    }
+  else if (0 <= lower_curvature && 0 >= upper_curvature)
+    {
+      // The gap is convex.
+      while (time < max_time && COLLISION_TIME_TOLERANCE < fabs(delta_time) && iteration_count < maximum_iteration)
+        {
+          double upper_depth = boundary_depth(upper, time);
+          double lower_depth = boundary_depth(lower, time);
+
+          gap     = lower_depth - upper_depth;
+          closing = boundary_speed(upper, upper_depth) - boundary_speed(lower, lower_depth);
+
+          if (0.0 >= closing)
+            {
+              // The gap has stopped shrinking and being convex it never will again.
+              time = max_time;
+            }
+          else
+            {
+              delta_time = gap / closing;
+              time      += delta_time;
+            }
+
+          iteration_count++;
+        }
+
+      time = min(time, max_time);
+    }
+  else if (0 >= lower_curvature && 0 <= upper_curvature)
+    {
+      // The gap is concave.
+      time = max_time;
+      gap  = boundary_depth(lower, time) - boundary_depth(upper, time);
+
+      while (0.0 >= gap && COLLISION_TIME_TOLERANCE < fabs(delta_time) && iteration_count < maximum_iteration)
         {
-          // FIXLATER if we want to update first_bin in this loop we will need to modify groundwater_distance to produce an array of distances for all bins
-          // like infiltrate_distance does so that we can calculate them all before first_bin changes
-          // FIXME, wencong 6/2/14, add inflow_rate to calculate groundwater distance, as inflow rate affects hydrostatic capillary height.
-          double delta_z = groundwater_distance(domain, ii, *first_bin, dt, water_table, inflow_rate); // The distance groundwater wants to move this timestep.
+          double upper_depth = boundary_depth(upper, time);
+          double lower_depth = boundary_depth(lower, time);
 
-          // Move the water.
-          if (0.0 > delta_z)
+          gap     = lower_depth - upper_depth;
+          closing = boundary_speed(upper, upper_depth) - boundary_speed(lower, lower_depth);
+
+          // The gap is shrinking wherever it is negative after the crossing, so closing is positive unless the collision is at max_time.
+          delta_time = (0.0 < closing) ? gap / closing : 0.0;
+          time       = max(time + delta_time, 0.0);
+
+          iteration_count++;
+        }
+    }
+  else
+    {
+      double before = 0.0;      // A time in seconds before the collision.
+      double after  = max_time; // A time in seconds at or after the collision if there is one.
+
+      time = max_time;
+
+      for (ii = 1; max_time == time && ii <= COLLISION_TIME_SAMPLES; ii++)
+        {
+          after = max_time * ii / COLLISION_TIME_SAMPLES;
+
+          if (0.0 >= boundary_depth(lower, after) - boundary_depth(upper, after))
             {
-              // Groundwater moves upward.
-              
-              /* FIXME do we really want to do this?  Probably use this in real world case, but not in tests with arbitrary water table location.
-              // Don't make a positive recharge negative, if recharge is already negative, do nothing.
-              if (*groundwater_recharge <= 0.0)
+              time = after;
+            }
+          else
+            {
+              before = after;
+            }
+        }
+
+      if (0.0 >= boundary_depth(lower, time) - boundary_depth(upper, time))
+        {
+          while (COLLISION_TIME_TOLERANCE < after - before)
+            {
+              time = 0.5 * (before + after);
+
+              if (0.0 >= boundary_depth(lower, time) - boundary_depth(upper, time))
                 {
-                  delta_z = 0.0;
+                  after = time;
                 }
-              else if (delta_z < -(*groundwater_recharge) / domain->parameters->delta_water_content)
+              else
                 {
-                  delta_z = -(*groundwater_recharge) / domain->parameters->delta_water_content;
+                  before = time;
                 }
-              */
-            
-              double final_depth = domain->groundwater_front[ii] + delta_z; // Depth in meters that groundwater wants to move to. 
-                 
-              // Groundwater cannot move above the surface.
-              if (final_depth < domain->layer_top_depth)
+            }
+
+          time = after;
+        }
+    }
+
+  return time;
+}
+
+/* Find the time in seconds until the first collision in a Talbot-Ogden
+ * domain or max_time if there is none sooner.  Each boundary follows the
+ * solution of its rate equation from where it is now.  Wet surface fronts
+ * and groundwater fronts follow the Green-Ampt solutions of
+ * T_O_INTEGRATOR_GREEN_AMPT with the rate and suction they have now and the
+ * surface water head held at surfacewater_depth plus the rainfall over
+ * probe_dt.  Slugs fall at constant speeds.  The collision times are the
+ * roots of the gaps between adjacent boundaries found by collision_time.
+ * Surface fronts that the step would move to the dry depth instead, and
+ * groundwater fronts with no suction, move at the speed measured over a step
+ * of probe_dt.  A surface front only moves if there is water on the surface.
+ * The lower boundary of the bottom water in each bin is groundwater or the
+ * bottom of the domain if there is no groundwater.  Groundwater with nothing
+ * above it collides with the surface.  The dry depth cache must already be
+ * valid for probe_dt, and the domain must use T_O_INTEGRATOR_GREEN_AMPT.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * domain             - A pointer to the t_o_domain struct.
+ * probe_dt           - The time in seconds to measure speeds over.
+ * rainfall_rate      - Meters of water per second.
+ * surfacewater_depth - The depth in meters of the surface water.
+ * water_table        - The depth in meters of the water table.
+ * max_time           - The longest time in seconds to return.
+ * time               - Scalar passed by reference will be filled in with the
+ *                      time until the first collision.
+ */
+int time_to_next_collision(t_o_domain* domain, double probe_dt, double rainfall_rate, double surfacewater_depth, double water_table, double max_time,
+                           double* time)
+{
+  assert(NULL != domain && 0.0 < probe_dt && 0.0 <= rainfall_rate && 0.0 <= surfacewater_depth && 0.0 <= water_table && 0.0 < max_time &&
+      NULL != time && T_O_INTEGRATOR_GREEN_AMPT == domain->integrator);
+
+  int             error             = FALSE;                                            // Error flag.
+  int             ii;                                                                   // Loop counter.
+  int             first_bin         = find_first_bin(domain, 2);                        // The leftmost bin that is not completely full of water.
+  int             infiltrating      = (0.0 < rainfall_rate || 0.0 < surfacewater_depth); // Whether surface fronts move.
+  double          surfacewater_head = surfacewater_depth + rainfall_rate * probe_dt;    // Meters.
+  double          infiltration[domain->parameters->num_bins + 1];                       // The distance each surface front moves in probe_dt.
+  double          groundwater[domain->parameters->num_bins + 1];                        // The distance each groundwater front moves in probe_dt.
+  double          surface_rate      = 0.0;                                              // The Green-Ampt rate of the wet surface fronts.
+  double          surface_suction   = 0.0;                                              // The Green-Ampt suction of the wet surface fronts.
+  slug_index      index;                                                                // Used to find connected slugs without searching every bin.
+  boundary_motion top;                                                                  // The top of the domain.
+  boundary_motion bottom;                                                               // The bottom of the domain.
+
+  *time = max_time;
+
+  boundary_linear(&top,    domain->layer_top_depth,    0.0);
+  boundary_linear(&bottom, domain->layer_bottom_depth, 0.0);
+
+  if (first_bin <= domain->parameters->num_bins)
+    {
+      // The number of leaves is the smallest power of two that is at least num_bins.
+      index.size = 1;
+
+      while (index.size < domain->parameters->num_bins)
+        {
+          index.size *= 2;
+        }
+
+      unsigned long long index_mask[2 * index.size];
+
+      index.mask = index_mask;
+
+      slug_index_build(domain, &index);
+
+      if (infiltrating)
+        {
+          infiltrate_distance(domain, probe_dt, first_bin, surfacewater_head, infiltration, FALSE);
+          infiltrate_rate_and_suction(domain, first_bin, surfacewater_head, &surface_rate, &surface_suction);
+        }
+
+      if (domain->yes_groundwater)
+        {
+          error = groundwater_distances(domain, first_bin, probe_dt, water_table, 0.0, groundwater, best_simd_kernel());
+        }
+
+      for (ii = first_bin; !error && ii <= domain->parameters->num_bins; ii++)
+        {
+          boundary_motion upper;                                                     // The boundary above the gap being checked.
+          boundary_motion lower;                                                     // The boundary below the gap being checked.
+          boundary_motion bottom_water;                                              // The lower boundary of the bottom water in the bin.
+          int             has_upper = infiltrating || domain->layer_top_depth < domain->surface_front[ii];
+          double          top_distance;                                              // The distance the top    of a slug moves in probe_dt.
+          double          bot_distance;                                              // The distance the bottom of a slug moves in probe_dt.
+          slug*           temp_slug = domain->top_slug[ii];
+
+          boundary_linear(&upper, domain->surface_front[ii], 0.0);
+
+          if (infiltrating)
+            {
+              // The step only moves a front to the dry depth if the front is not as deep as the dry depth, and a wet front moves less than
+              // the dry depth in the same time, so a front that moves less than its own depth follows the Green-Ampt solution.
+              if (0.0 < surface_suction && 0.0 < domain->surface_front[ii] && 0.0 < infiltration[ii] &&
+                  infiltration[ii] < domain->surface_front[ii] - domain->layer_top_depth)
                 {
-                  final_depth = domain->layer_top_depth;
+                  // The front follows the Green-Ampt solution.
+                  upper.kind    = BOUNDARY_SURFACE;
+                  upper.rate    = surface_rate;
+                  upper.suction = surface_suction;
+                }
+              else
+                {
+                  // The front jumps to the dry depth or does not move.
+                  upper.speed = infiltration[ii] / probe_dt;
                 }
+            }
 
-              // Accumulate the amount of water actually moved in meters of bin depth.
-              delta_z = 0.0;
+          if (!domain->yes_groundwater)
+            {
+              bottom_water = bottom;
+            }
+          else if (domain->layer_top_depth >= water_table && domain->layer_top_depth == domain->groundwater_front[ii])
+            {
+              boundary_linear(&bottom_water, domain->groundwater_front[ii], 0.0);
+            }
+          else
+            {
+              boundary_linear(&bottom_water, domain->groundwater_front[ii], groundwater[ii] / probe_dt);
+              groundwater_rate_and_suction(domain, ii, first_bin, water_table, 0.0, &bottom_water.rate, &bottom_water.suction);
 
-              // We must loop because groundwater might overtake multiple slugs or slugs and the surface front in one timestep.
-              while (domain->groundwater_front[ii] > final_depth)
+              if (0.0 < bottom_water.suction)
                 {
-                  if (NULL != domain->bot_slug[ii])
-                    {
-                      // A slug exists.
-                      if (final_depth <= domain->bot_slug[ii]->bot)
-                        {
-                          // The groundwater hits the bottom slug.
-                          delta_z += domain->bot_slug[ii]->bot - domain->groundwater_front[ii];
-                          domain->groundwater_front[ii] = domain->bot_slug[ii]->top;
-                          kill_slug(domain, ii, domain->bot_slug[ii]);
-                        }
-                      else
-                        {
-                          // The groundwater does not hit the bottom slug.
-                          delta_z += final_depth - domain->groundwater_front[ii];
-                          domain->groundwater_front[ii] = final_depth;
-                        }
-                    }
-                  else
-                    {
-                      // No slug exists.
-                      if (final_depth <= domain->surface_front[ii])
-                        {
-                          // The groundwater hits the surface front.
-                          delta_z += domain->surface_front[ii] - domain->groundwater_front[ii];
-                          domain->surface_front[ii]     = domain->layer_top_depth;
-                          domain->groundwater_front[ii] = domain->layer_top_depth;
-                        }
-                      else
-                        {
-                          // The groundwater does not hit the surface front.
-                          delta_z += final_depth - domain->groundwater_front[ii];
-                          domain->groundwater_front[ii] = final_depth;
-                        }
-                    }
+                  bottom_water.kind        = BOUNDARY_GROUNDWATER;
+                  bottom_water.water_table = water_table;
                 }
             }
-          else if (0.0 < delta_z)
+
+          while (NULL != temp_slug)
+            {
+              slug_fall_distance(domain, ii, first_bin, probe_dt, temp_slug, &index, &top_distance, &bot_distance);
+              boundary_linear(&lower, temp_slug->top, top_distance / probe_dt);
+
+              if (has_upper)
+                {
+                  *time = collision_time(&upper, &lower, *time);
+                }
+
+              boundary_linear(&upper, temp_slug->bot, bot_distance / probe_dt);
+
+              has_upper = TRUE;
+              temp_slug = temp_slug->next;
+            }
+
+          if (has_upper)
+            {
+              *time = collision_time(&upper, &bottom_water, *time);
+            }
+          else if (domain->yes_groundwater)
+            {
+              // Groundwater reaching the surface changes first_bin.
+              *time = collision_time(&top, &bottom_water, *time);
+            }
+
+          if (domain->yes_groundwater)
+            {
+              *time = collision_time(&bottom_water, &bottom, *time);
+            }
+        }
+    }
+
+  return error;
+}
+
+/* Comment in .h file. */
+int t_o_timestep_events(t_o_domain* domain, t_o_events* events, double duration, double rainfall_rate, double* surfacewater_depth,
+                        double water_table, double* groundwater_recharge, double* runoff)
+{
+  int    error     = FALSE;    // Error flag.
+  double remaining = duration; // Seconds left to step.
+  double max_dt;               // The largest step allowed now in seconds.
+  double dt;                   // The step in seconds.
+  int    integrator;           // The integrator of domain, which is put back at the end.
+
+  if (NULL == domain)
+    {
+      fprintf(stderr, "ERROR: domain must not be NULL\n");
+      error = TRUE;
+    }
+
+  if (NULL == events)
+    {
+      fprintf(stderr, "ERROR: events must not be NULL\n");
+      error = TRUE;
+    }
+  else if (NULL != domain && events->parameters != domain->parameters)
+    {
+      fprintf(stderr, "ERROR: events must be allocated for domain\n");
+      error = TRUE;
+    }
+
+  if (0.0 >= duration)
+    {
+      fprintf(stderr, "ERROR: duration must be greater than zero\n");
+      error = TRUE;
+    }
+
+  if (0.0 > rainfall_rate)
+    {
+      fprintf(stderr, "ERROR: rainfall_rate must be greater than or equal to zero\n");
+      error = TRUE;
+    }
+
+  if (0.0 > water_table)
+    {
+      fprintf(stderr, "ERROR: water_table must be greater than or equal to zero\n");
+      error = TRUE;
+    }
+
+  if (NULL == surfacewater_depth)
+    {
+      fprintf(stderr, "ERROR: surfacewater_depth must not be NULL\n");
+      error = TRUE;
+    }
+  else if (0.0 > *surfacewater_depth)
+    {
+      fprintf(stderr, "ERROR: surfacewater_depth must be greater than or equal to zero\n");
+      error = TRUE;
+    }
+
+  if (NULL == groundwater_recharge)
+    {
+      fprintf(stderr, "ERROR: groundwater_recharge must not be NULL\n");
+      error = TRUE;
+    }
+
+  if (!error)
+    {
+      // Between events the fronts follow the Green-Ampt solution of their rate equations.
+      integrator         = domain->integrator;
+      domain->integrator = T_O_INTEGRATOR_GREEN_AMPT;
+
+      while (!error && 0.0 < remaining)
+        {
+          // With no rain a quiescent domain stays quiescent until the forcing changes.
+          if (0.0 == rainfall_rate && t_o_quiescent(domain, *surfacewater_depth, water_table))
+            {
+              error     = t_o_fast_forward(domain, remaining, water_table, groundwater_recharge);
+              remaining = 0.0;
+              continue;
+            }
+
+          // How much infiltrates depends on the step so while water is on the surface the step is kept to max_wet_dt.
+          max_dt = (0.0 < rainfall_rate || 0.0 < *surfacewater_depth) ? events->max_wet_dt : events->max_dt;
+          error  = time_to_next_collision(domain, events->min_dt, rainfall_rate, *surfacewater_depth, water_table, min(remaining, max_dt), &dt);
+
+          if (!error)
+            {
+              if (dt < events->min_dt)
+                {
+                  dt = events->min_dt;
+                }
+
+              if (dt >= remaining)
+                {
+                  dt = remaining;
+                  events->num_forcing_ends++;
+                }
+              else if (dt >= max_dt)
+                {
+                  dt = max_dt;
+                  events->num_max_steps++;
+                }
+              else
+                {
+                  events->num_collisions++;
+                }
+
+              error     = adaptive_substep(domain, dt, rainfall_rate, surfacewater_depth, water_table, groundwater_recharge, runoff);
+              remaining = (dt == remaining) ? 0.0 : remaining - dt;
+              events->num_timesteps++;
+            }
+        }
+
+      domain->integrator = integrator;
+    }
+
+  return error;
+}
+
+/* Comment in .h file. */
+int t_o_timestep_multirate(t_o_domain* domain, double dt, int num_substeps, double rainfall_rate, double* surfacewater_depth, double water_table,
+                           double* groundwater_recharge, double* runoff)
+{
+  int    error        = FALSE; // Error flag.
+  int    ponded_water = FALSE; // Whether any sub-step had ponded water.
+  double inflow       = 0.0;   // Meters of water that flowed through the saturated bins in the sub-steps.
+  double sub_dt;               // The duration of each sub-step in seconds.
+  int    first_bin;            // The leftmost bin that is not completely full of water.
+  int    ii;                   // Loop counter.
+
+  if (NULL == domain)
+    {
+      fprintf(stderr, "ERROR: domain must not be NULL\n");
+      error = TRUE;
+    }
+
+  if (0.0 >= dt)
+    {
+      fprintf(stderr, "ERROR: dt must be greater than zero\n");
+      error = TRUE;
+    }
+
+  if (1 > num_substeps)
+    {
+      fprintf(stderr, "ERROR: num_substeps must be greater than or equal to one\n");
+      error = TRUE;
+    }
+
+  if (0.0 > rainfall_rate)
+    {
+      fprintf(stderr, "ERROR: rainfall_rate must be greater than or equal to zero\n");
+      error = TRUE;
+    }
+
+  if (0.0 > water_table)
+    {
+      fprintf(stderr, "ERROR: water_table must be greater than or equal to zero\n");
+      error = TRUE;
+    }
+
+  if (NULL == surfacewater_depth)
+    {
+      fprintf(stderr, "ERROR: surfacewater_depth must not be NULL\n");
+      error = TRUE;
+    }
+  else if (0.0 > *surfacewater_depth)
+    {
+      fprintf(stderr, "ERROR: surfacewater_depth must be greater than or equal to zero\n");
+      error = TRUE;
+    }
+
+  if (NULL == groundwater_recharge)
+    {
+      fprintf(stderr, "ERROR: groundwater_recharge must not be NULL\n");
+      error = TRUE;
+    }
+
+  if (!error)
+    {
+      // Without rainfall or surface water nothing is supplied to the surface during dt, so there is nothing to resolve with sub-steps.
+      if (0.0 == rainfall_rate && 0.0 == *surfacewater_depth)
+        {
+          num_substeps = 1;
+        }
+
+      sub_dt = dt / num_substeps;
+      domain->statistics.num_multirate_steps++;
+    }
+
+  // The fast phases.  Groundwater fronts stay where they are until the slow phases.
+  for (ii = 0; !error && ii < num_substeps; ii++)
+    {
+      int    substep_ponded = FALSE;                 // Flag set by t_o_satisfy_saturated_bins for this sub-step.
+      double recharge_old   = *groundwater_recharge; // Meters of water.
+      double surfacewater_head;                      // Meters.
+
+      *surfacewater_depth += rainfall_rate * sub_dt;
+      surfacewater_head    = *surfacewater_depth;
+      first_bin            = find_first_bin(domain, 2);
+      error                = t_o_satisfy_saturated_bins(domain, sub_dt, first_bin, surfacewater_depth, &substep_ponded, groundwater_recharge, water_table);
+      inflow              += *groundwater_recharge - recharge_old;
+      ponded_water         = ponded_water || substep_ponded;
+
+      // Nothing moves above groundwater in a sub-step without water above groundwater.
+      if (!error && (substep_ponded || 0.0 < *surfacewater_depth || has_slugs(domain)))
+        {
+          error = t_o_infiltrate(domain, sub_dt, &first_bin, surfacewater_head, surfacewater_depth, groundwater_recharge, substep_ponded, TRUE);
+
+          if (!error)
             {
-              // Groundwater moves downward.
-              if (domain->groundwater_front[ii] + delta_z >= domain->layer_bottom_depth)
-                {
-                  // The groundwater hits the bottom of the domain.
-                  delta_z = domain->layer_bottom_depth - domain->groundwater_front[ii];
-                  domain->groundwater_front[ii] = domain->layer_bottom_depth;
-                }
-              else
-                {
-                  // The groundwater does not hit the bottom of the domain.
-                  domain->groundwater_front[ii] += delta_z;
-                }
+              error = t_o_falling_slugs(domain, sub_dt, first_bin, groundwater_recharge);
             }
+        }
 
-          *groundwater_recharge += delta_z * domain->parameters->delta_water_content;
-        } // End loop over all bins
-
-      // Force bin 1 to be completely full of water.
-      if (domain->layer_top_depth < domain->groundwater_front[1])
+      if (!error && NULL != runoff)
         {
-          fprintf(stderr, "WARNING: Groundwater in bin 1 wants to fall below the surface.  Groundwater in bin 1 is being pinned "
-              "to the surface.  The simulation will be inaccurate unless you decrease residual_saturation.\n");
-          *groundwater_recharge += -(domain->groundwater_front[1] - domain->layer_top_depth) * domain->parameters->delta_water_content;
-          domain->groundwater_front[1] = domain->layer_top_depth;
+          *runoff            += *surfacewater_depth;
+          *surfacewater_depth = 0.0;
         }
-      
-      // Find the new value of first_bin.  It could move to the right or left.
-      *first_bin = find_first_bin(domain, 2);
-    } // End if (domain->yes_groundwater)
+
+      domain->statistics.num_multirate_substeps++;
+    }
+
+  // The slow phases.
+  if (!error)
+    {
+      first_bin = find_first_bin(domain, 2);
+      error     = t_o_groundwater(domain, dt, &first_bin, water_table, ponded_water, groundwater_recharge, inflow / dt);
+    }
+
+  if (!error)
+    {
+      t_o_handle_sliver_slugs(domain);
+
+      error = t_o_redistribute(domain, first_bin);
+    }
+
+#if (DEBUG_LEVEL & DEBUG_LEVEL_INTERNAL_ASSERTIONS)
+  if (!error)
+    {
+      t_o_check_invariant(domain);
+    }
+#endif // (DEBUG_LEVEL & DEBUG_LEVEL_INTERNAL_ASSERTIONS)
 
   return error;
 }
 
-//Function passed to qsort() to sort the list from largest to smallest
-int
-compare_surface(const double *a, const double *b)
+/* Return a conservative estimate of the depth to fill to in order to add
+ * groundwater_recharge to groundwater.  This estimate is achieved by assuming
+ * that all of the space above groundwater is empty.  If it really is empty
+ * this will produce the exact depth to fill groundwater to.  If there are some
+ * slugs or surface front water then add_recharge will not add all of the water
+ * and you will have to loop until all of the water is added or the domain is
+ * full.
+ * 
+ * Parameters:
+ * 
+ * domain               - A pointer to the t_o_domain struct.
+ * groundwater_recharge - The amount of water to add to the domain in meters of
+ *                        water.
+ */
+double find_recharge_depth(t_o_domain* domain, double groundwater_recharge)
 {
-  double temp = *a - *b;
-  if (temp > 0)
-    return -1;
-  else if (temp < 0)
-    return 1;
-  else
-    return 0;
+  int    ii              = domain->parameters->num_bins; // Loop counter.
+  int    done            = FALSE;                        // Loop flag.
+  double space_available = 0.0;                          // Space found so far in meters of water.
+  double depth           = 0.0;                          // Meters.  Use zero if we never find enough space for the water.
+  
+  assert(NULL != domain && 0.0 <= groundwater_recharge);
+
+  while(!done && 1 < ii && domain->layer_top_depth < domain->groundwater_front[ii])
+    {
+      double new_space= (domain->groundwater_front[ii] - domain->groundwater_front[ii - 1]) * (domain->parameters->num_bins + 1 - ii) *
+                         domain->parameters->delta_water_content; // Meters of water.
+      
+      if (space_available + new_space < groundwater_recharge)
+        {
+          // Enough water to fill up to domain->groundwater_front[ii - 1].
+          space_available += new_space;
+        }
+      else
+        {
+          depth = domain->groundwater_front[ii] - (((groundwater_recharge - space_available) / domain->parameters->delta_water_content) / (domain->parameters->num_bins + 1 - ii));
+          done = TRUE;
+        }
+      
+      ii--;
+    }
+  
+  assert(domain->layer_top_depth <= depth && depth <= domain->layer_bottom_depth);
+  
+  return depth;
 }
 
-//Function passed to qsort() to sort the list from smallest to largest
-int
-compare_ground(const double *a, const double *b)
+/* Move all groundwater up to at least depth while handling collisions with
+ * slugs and surface front water.  Water required to fill the space is taken
+ * from groundwater_recharge.
+ *
+ * Parameters:
+ * 
+ * domain               - A pointer to the t_o_domain struct.
+ * depth                - The depth to fill the groundwater to.
+ * groundwater_recharge - A scalar passed by reference containing an amount of
+ *                        water in meters of water.  Water used to fill
+ *                        groundwater to depth is subtracted from this amount
+ *                        of water.  If more water is used than available
+ *                        groundwater_recharge will go negative.  It is the
+ *                        responsibility of the caller to ensure that filling
+ *                        groundwater to depth will not use more water than
+ *                        available.
+ */
+void add_recharge(t_o_domain* domain, double depth, double* groundwater_recharge)
 {
-  double temp = *a - *b;
-  if (temp > 0)
-    return 1;
-  else if (temp < 0)
-    return -1;
-  else
-    return 0;
+  int ii = domain->parameters->num_bins; // Loop counter.
+  
+  assert(NULL != domain && 0.0 <= depth && NULL != groundwater_recharge && 0.0 <= *groundwater_recharge);
+  
+  // Loop from right to left until you hit a bin where the groundwater depth is already depth or higher.
+
+  while (0 < ii && depth < domain->groundwater_front[ii])
+    {
+      // Check for collisions with slugs.
+      while (NULL != domain->bot_slug[ii] && domain->bot_slug[ii]->bot >= depth)
+        {
+          *groundwater_recharge         -= (domain->groundwater_front[ii] - domain->bot_slug[ii]->bot) * domain->parameters->delta_water_content;
+          set_groundwater_front(domain, ii, domain->bot_slug[ii]->top);
+          kill_slug(domain, ii, domain->bot_slug[ii]);
+        }
+      
+      // Check for collision with surface front water.
+      if (domain->surface_front[ii] >= depth)
+        {
+          *groundwater_recharge         -= (domain->groundwater_front[ii] - domain->surface_front[ii]) * domain->parameters->delta_water_content;
+          set_surface_front(domain, ii, domain->layer_top_depth);
+          set_groundwater_front(domain, ii, domain->layer_top_depth);
+        }
+      else if (domain->groundwater_front[ii] > depth) // Must check in case a slug moved groundater.
+        {
+          *groundwater_recharge         -= (domain->groundwater_front[ii] - depth) * domain->parameters->delta_water_content;
+          set_groundwater_front(domain, ii, depth);
+        }
+      
+      ii--;
+    }
 }
 
-int
-insert_into_list_top_sort(slug* (*list), slug* (*end), slug* (*element))
+/* Comment in .h file */
+void t_o_add_groundwater(t_o_domain* domain, double* groundwater_recharge)
 {
-  if ((*list) == NULL )
+  int done = FALSE; // Loop flag.
+  
+  assert(NULL != domain && NULL != groundwater_recharge && 0.0 <= *groundwater_recharge);
+  
+  if(domain->yes_groundwater)
     {
-      (*element)->next = NULL;
-      (*element)->prev = NULL;
-      (*list) = (*element);
-      (*end) = (*list);
+      while (!done && epsilon_less(0.0, *groundwater_recharge))
+        {
+          double depth = find_recharge_depth(domain, *groundwater_recharge);
+          
+          add_recharge(domain, depth, groundwater_recharge);
+          
+          if (0.0 == depth)
+            {
+              done = TRUE;
+            }
+        }
     }
-  else if ((*list)->top >= (*element)->top)
+  else
     {
-      (*element)->prev = NULL;
-      (*element)->next = (*list);
-      (*list)->prev = (*element);
-      (*list) = (*element);
+      fprintf(stderr, "WARNING: called t_o_add_groundwater on a t_o_domain with yes_groundwater FALSE.\n");
+    }
+}
+
+/* Comment in .h file */
+void t_o_take_groundwater(t_o_domain* domain, double water_table, double* groundwater_recharge)
+{
+  int ii; // Loop counter.
+
+  if(domain->yes_groundwater)
+    {
+      for (ii = domain->parameters->num_bins; epsilon_greater(0.0, *groundwater_recharge) && ii >= 1; ii--)
+        {
+          double maximum_bin_depth = water_table - 0.1 * domain->parameters->bin_capillary_suction[ii]; // Meters.
+
+          // If there is water to the right of the groundwater in this bin we can't orphan that water.
+          if (ii < domain->parameters->num_bins)
+            {
+              if (domain->surface_front[ii + 1] > domain->groundwater_front[ii])
+                {
+                  maximum_bin_depth = domain->layer_top_depth;
+                }
+
+              // Find the highest slug, if any, that the groundwater can't drop below.
+              slug* temp_slug = domain->bot_slug[ii + 1];
+
+              while (NULL != temp_slug && NULL != temp_slug->prev && temp_slug->prev->bot > domain->groundwater_front[ii])
+                {
+                  temp_slug = temp_slug->prev;
+                }
+
+              if (NULL != temp_slug && temp_slug->bot > domain->groundwater_front[ii] && maximum_bin_depth > temp_slug->top)
+                {
+                  maximum_bin_depth = temp_slug->top;
+                }
+              
+              if (maximum_bin_depth > domain->groundwater_front[ii + 1])
+                {
+                  maximum_bin_depth = domain->groundwater_front[ii + 1];
+                }
+            }
+          
+          // Don't let groundwater fall below the bottom of the layer.
+          if (maximum_bin_depth > domain->layer_bottom_depth)
+            {
+              maximum_bin_depth = domain->layer_bottom_depth;
+            }
+
+          if (maximum_bin_depth > domain->groundwater_front[ii])
+            {
+              double water_available = (maximum_bin_depth - domain->groundwater_front[ii]) * domain->parameters->delta_water_content; // Meters of water.
+
+              if (water_available <= -*groundwater_recharge)
+                {
+                  // There is not enough water.  Take it all.
+                  set_groundwater_front(domain, ii, maximum_bin_depth);
+                  *groundwater_recharge         += water_available;
+                }
+              else // if (water_available > -*groundwater_recharge)
+                {
+                  // There is enough water.  Take what you need.
+                  set_groundwater_front(domain, ii, domain->groundwater_front[ii] - (*groundwater_recharge / domain->parameters->delta_water_content));
+                  *groundwater_recharge          = 0.0;
+                }
+            }
+        }
     }
   else
     {
-      slug* current = (*list);
-      while (current->next != NULL && current->next->top < (*element)->top)
-        {
-          current = current->next;
-        }
-      //found correct insertion point
-      if (current->next != NULL )
-        {
-          (*element)->next = current->next;
-          current->next->prev = (*element);
-          current->next = (*element);
-          (*element)->prev = current;
-        }
-      else
-        {
-          current->next = (*element);
-          (*element)->prev = current;
-          (*element)->next = NULL;
-          (*end) = (*element);
-        }
+      fprintf(stderr, "WARNING: called t_o_take_groundwater on a t_o_domain with yes_groundwater FALSE.\n");
     }
-  return 0;
 }
 
-int
-insert_into_list_bot_sort(slug* (*list), slug* (*end), slug* (*element))
+/* Comment in .h file. */
+double t_o_specific_yield(t_o_domain* domain, double water_table)
 {
-  if ((*list) == NULL )
+  double porosity               = domain->parameters->bin_water_content[domain->parameters->num_bins];
+  double residual_saturation    = (domain->parameters->bin_water_content[1] - domain->parameters->delta_water_content);
+  // FIXME store residual saturation in bin_water_content[0] or its own struct member?
+  double specific_yield         = (porosity - residual_saturation) *
+                                  (1.0 - pow(domain->parameters->bc_psib / (domain->parameters->bc_psib + water_table + 0.01), domain->parameters->bc_lambda));
+
+  if (0.1 > specific_yield)
     {
-      (*element)->next = NULL;
-      (*element)->prev = NULL;
-      (*list) = (*element);
-      (*end) = (*list);
+      specific_yield = 0.1;
     }
-  else if ((*list)->bot <= (*element)->bot)
+  
+  if (specific_yield < residual_saturation)
     {
-      (*element)->prev = NULL;
-      (*element)->next = (*list);
-      (*list)->prev = (*element);
-      (*list) = (*element);
+      specific_yield = residual_saturation;
     }
-  else
+  
+  if (specific_yield > porosity)
     {
-      slug* current = (*list);
-      while (current->next != NULL && current->next->bot > (*element)->bot)
-        {
-          current = current->next;
-        }
-      //found correct insertion point
-      if (current->next != NULL )
-        {
-          (*element)->next = current->next;
-          current->next->prev = (*element);
-          current->next = (*element);
-          (*element)->prev = current;
-        }
-      else
-        {
-          current->next = (*element);
-          (*element)->prev = current;
-          (*element)->next = NULL;
-          (*end) = (*element);
-        }
+      specific_yield = porosity;
     }
-  return 0;
+
+  return specific_yield;
 }
 
-int
-cut_slugs(t_o_domain* domain, slug* (*all), slug* (*top_list),
-    slug* (*top_list_end), slug* (*bot_list), slug* (*bot_list_end),
-    slug* (*mid_list), slug* (*mid_list_end), int first_bin)
+// A depth where the number of wet bins in one bin of a t_o_domain changes by change.
+typedef struct
 {
-  int error = FALSE;
-  slug* head = (*all);
-  slug* next;
-  while (head != NULL )
-    {
-      next = head->next;
-      //TODO TRY TO COMBINE SOME OF THESE CASES???
-      if (head->bot <= domain->surface_front[first_bin])
-        { //this entire slug goes into the top list
-          insert_into_list_top_sort(&(*top_list), &(*top_list_end), &head);
-        }
-      else if(domain->yes_groundwater && head->top >= domain->groundwater_front[first_bin])
-        { //this entire slug goes into the bottom list
-          insert_into_list_bot_sort(&(*bot_list), &(*bot_list_end), &head);
-        }
-      else if((!domain->yes_groundwater || head->bot <= domain->groundwater_front[first_bin]) && head->top >= domain->surface_front[first_bin])
-        { //this entire slug goes into the middle list
-          insert_into_list_top_sort(&(*mid_list), &(*mid_list_end), &head);
-        }
-      else
-        {
-          //we have to split the slug up, three cases: top/mid, mid/bot, top/mid/bot
-          if(head->top < domain->surface_front[first_bin] && (!domain->yes_groundwater || head->bot <= domain->groundwater_front[first_bin]))
+  double depth;  // Meters.
+  int    change; // Plus one where the bin becomes wet, minus one where it becomes dry.
+} staircase_event;
+
+/* Sort staircase_events by depth from shallowest to deepest with a bottom up
+ * merge sort.  The events of each bin are already in order, so adjacent runs
+ * that are in order are copied without comparing every element.
+ *
+ * Parameters:
+ *
+ * events     - A 1D array of num_events staircase_events with zero based
+ *              indexing.
+ * scratch    - A 1D array of at least num_events staircase_events used as
+ *              temporary storage.
+ * num_events - The number of events to sort.
+ */
+void merge_sort_staircase_events(staircase_event* events, staircase_event* scratch, int num_events)
+{
+  int              width;            // The length of the runs being merged.
+  int              left;             // The start of the left  run.
+  int              middle;           // The start of the right run.
+  int              right;            // One past the end of the right run.
+  int              ii, jj, kk;       // Loop counters.
+  staircase_event* from = events;    // The array being merged from.
+  staircase_event* to   = scratch;   // The array being merged into.
+  staircase_event* temp;
+
+  for (width = 1; width < num_events; width *= 2)
+    {
+      for (left = 0; left < num_events; left += 2 * width)
+        {
+          middle = min(left + width, num_events);
+          right  = min(left + 2 * width, num_events);
+          ii     = left;
+          jj     = middle;
+          kk     = left;
+
+          // If the runs are already in order skip straight to copying them.
+          if (middle < right && from[middle - 1].depth <= from[middle].depth)
             {
-              //hit the top/mid case, create one new slug
-              slug* sl;
-              slug_alloc(&sl, domain->surface_front[first_bin], head->bot);
-              head->bot = sl->top;
-              //put head into top list
-              insert_into_list_top_sort(&(*top_list), &(*top_list_end), &head);
-              //put new slug, sl, into middle list
-              insert_into_list_top_sort(&(*mid_list), &(*mid_list_end), &sl);
+              jj = right;
             }
-          else if((domain->yes_groundwater && head->bot > domain->groundwater_front[first_bin]) && head->top >= domain->surface_front[first_bin])
+
+          while (ii < middle && jj < right)
             {
-              //hit the mid/bot case, create one new slug
-              slug* sl;
-              if(slug_alloc(&sl, head->top, domain->groundwater_front[first_bin]))
+              if (from[jj].depth < from[ii].depth)
                 {
-                  error = TRUE;
-                  break;
+                  to[kk++] = from[jj++];
+                }
+              else
+                {
+                  to[kk++] = from[ii++];
                 }
-              head->top = sl->bot;
-              //put head into bot list
-              insert_into_list_bot_sort(&(*bot_list), &(*bot_list_end), &head);
-              //put new slug, sl, into middle list
-              insert_into_list_top_sort(&(*mid_list), &(*mid_list_end), &sl);
             }
-          else if(head->top < domain->surface_front[first_bin] && (domain->yes_groundwater && head->bot > domain->groundwater_front[first_bin]))
-            {
-              //hit the top/mid/bot case, create two new slugs
-              slug* new_t;
-              slug* new_b;
-              slug_alloc(&new_t, head->top, domain->surface_front[first_bin]);
-              slug_alloc(&new_b, domain->groundwater_front[first_bin], head->bot);
-              head->top = new_t->bot;
-              head->bot = new_b->top;
 
-              //put new_t into top list
-              insert_into_list_top_sort(&(*top_list), &(*top_list_end), &new_t);
-              //put head into middle list
-              insert_into_list_top_sort(&(*mid_list), &(*mid_list_end), &head);
-              //put new_b into bottom list
-              insert_into_list_bot_sort(&(*bot_list), &(*bot_list_end), &new_b);
+          while (ii < middle)
+            {
+              to[kk++] = from[ii++];
             }
-          else
+
+          // If the runs were already in order the right run has not been copied.
+          for (jj = kk; jj < right; jj++)
             {
-              assert(FALSE); //should never get to this case!
+              to[jj] = from[jj];
             }
         }
-      head = next;
+
+      temp = from;
+      from = to;
+      to   = temp;
+    }
+
+  if (from != events)
+    {
+      for (ii = 0; ii < num_events; ii++)
+        {
+          events[ii] = from[ii];
+        }
     }
-  return error;
 }
 
-/* Helper function to deal with merging of ground and surface
- * fronts
+/* Return TRUE if a bin of a domain without groundwater is always full of
+ * water, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * parameters            - A pointer to the t_o_parameters struct.
+ * yes_groundwater       - Whether the domain simulates groundwater.
+ * initial_water_content - The initial water content of the domain.
+ * bin                   - Which bin.  One based indexing is used.
  */
-int
-find_collisions(t_o_domain* domain, slug* (*top_list), slug* (*top_list_end),
-    slug* (*bot_list), slug* (*bot_list_end), slug* (*mid_list),
-    slug* (*mid_list_end), int *first_bin)
+static inline int staircase_bin_always_full(t_o_parameters* parameters, int yes_groundwater, double initial_water_content, int bin)
 {
-  int error = FALSE;
-  int i;
-  int new_first_bin = *first_bin;
-  //Find the first non overlapping bin to pass to cut slugs
-  for(i = *first_bin; i <= domain->parameters->num_bins; i++)
+  return !yes_groundwater && parameters->bin_water_content[bin] <= initial_water_content;
+}
+
+/* Return TRUE if a domain can be converted to and from a staircase, FALSE
+ * otherwise and print an error.
+ *
+ * Parameters:
+ *
+ * staircase - A pointer to the t_o_staircase struct.
+ * domain    - A pointer to the t_o_domain struct.
+ */
+int staircase_matches_domain(t_o_staircase* staircase, t_o_domain* domain)
+{
+  int matches = TRUE; // The return value.
+
+  if (NULL == staircase)
     {
-      if(domain->surface_front[i] < domain->groundwater_front[i])
-        {
-          new_first_bin = i;
-          break;
-        }
+      fprintf(stderr, "ERROR: staircase must not be NULL\n");
+      matches = FALSE;
     }
 
-  for (i = *first_bin; i <= domain->parameters->num_bins; i++)
+  if (NULL == domain)
     {
-      if (domain->surface_front[i] > domain->groundwater_front[i])
-        {
-          //We have overlapping water, create slug
-          slug* sl;
-          if(slug_alloc(&sl, domain->groundwater_front[i], domain->surface_front[i]))
-            {
-              error = TRUE;
-              break;
-            }
-          cut_slugs(domain, &sl, &(*top_list),
-              &(*top_list_end), &(*bot_list), &(*bot_list_end), &(*mid_list),
-              &(*mid_list_end), new_first_bin);
+      fprintf(stderr, "ERROR: domain must not be NULL\n");
+      matches = FALSE;
+    }
 
-          //SLUGS ARE CREATED, UPDATE FRONTS TO SHOW FULL BIN
-          domain->surface_front[i]     = domain->layer_top_depth;
-          domain->groundwater_front[i] = domain->layer_top_depth;
-        }
-      else if (domain->surface_front[i] == domain->groundwater_front[i])
-        {
-          //if the ground and surface are exactly equal, no slug is created,
-          //but need to "fill" the bin
-          domain->surface_front[i]     = domain->layer_top_depth;
-          domain->groundwater_front[i] = domain->layer_top_depth;
-        }
-      else
-        {
-          break;
-        }
+  if (matches && (staircase->parameters != domain->parameters || staircase->layer_top_depth != domain->layer_top_depth ||
+                  staircase->layer_bottom_depth != domain->layer_bottom_depth || staircase->yes_groundwater != domain->yes_groundwater ||
+                  staircase->initial_water_content != domain->initial_water_content))
+    {
+      fprintf(stderr, "ERROR: staircase must be allocated for a domain like domain\n");
+      matches = FALSE;
     }
-  *first_bin = new_first_bin;
-  return error;
+
+  return matches;
 }
 
-/*
- * helper function to add a slug to the bin, checks for equality
- * and adds to ground/surface if necessary
- *
- * This function assumes that bin_slug will fit without overlapping
- * between two fronts, or between a single slug and a front.  It does
- * handle equality.
- */
-int
-add_binned_slug(t_o_domain* domain, slug* (*bin_slug), int bin)
+/* Comment in .h file. */
+int t_o_staircase_alloc(t_o_staircase** staircase, t_o_domain* domain)
 {
-  slug* tmp_slug = domain->top_slug[bin];
+  int error = FALSE; // Error flag.
 
-  if ((*bin_slug)->top == domain->surface_front[bin]
-                                                && (domain->yes_groundwater && (*bin_slug)->bot == domain->groundwater_front[bin]))
+  if (NULL == staircase)
+    {
+      fprintf(stderr, "ERROR: staircase must not be NULL\n");
+      error = TRUE;
+    }
+  else
     {
-      //not likely, but this could happen, if it does, we have filled bin
-      domain->surface_front[bin]     = domain->layer_top_depth;
-      domain->groundwater_front[bin] = domain->layer_top_depth;
-      slug_dealloc(&(*bin_slug));
-      return 0;
+      *staircase = NULL; // Prevent deallocating a random pointer.
     }
-  else if ((*bin_slug)->top == domain->surface_front[bin])
+
+  if (NULL == domain)
     {
-      if (tmp_slug != NULL && tmp_slug->top == (*bin_slug)->bot)
-        {
-          domain->surface_front[bin] = tmp_slug->bot;
-          kill_slug(domain, bin, tmp_slug);
-        }
-      else
-        {
-          domain->surface_front[bin] = (*bin_slug)->bot;
-        }
-      slug_dealloc(&(*bin_slug));
-      return 0;
+      fprintf(stderr, "ERROR: domain must not be NULL\n");
+      error = TRUE;
     }
-  else if (domain->yes_groundwater && (*bin_slug)->bot == domain->groundwater_front[bin])
+
+  if (!error)
     {
-      tmp_slug = domain->bot_slug[bin];
-      if (tmp_slug != NULL && tmp_slug->bot == (*bin_slug)->top)
-        {
-          domain->groundwater_front[bin] = tmp_slug->top;
-          kill_slug(domain, bin, tmp_slug);
-        }
-      else
-        {
-          domain->groundwater_front[bin] = (*bin_slug)->top;
-        }
-      slug_dealloc(&(*bin_slug));
-      return 0;
+      error = v_alloc((void**)staircase, sizeof(t_o_staircase));
     }
 
-  //TODO MAY BE POSSIBLE TO REFACTOR THIS PORTION INTO A MORE CONSICE
-  //BIT OF CODE
-  if (tmp_slug == NULL )
+  if (!error)
     {
-      //this is the first slug to be added to this bin
-      //Make sure the slugs pointers are NULL
-      (*bin_slug)->next = NULL;
-      (*bin_slug)->prev = NULL;
-      domain->top_slug[bin] = (*bin_slug);
-      domain->bot_slug[bin] = (*bin_slug);
-      return 0;
+      (*staircase)->parameters            = domain->parameters;
+      (*staircase)->layer_top_depth       = domain->layer_top_depth;
+      (*staircase)->layer_bottom_depth    = domain->layer_bottom_depth;
+      (*staircase)->yes_groundwater       = domain->yes_groundwater;
+      (*staircase)->initial_water_content = domain->initial_water_content;
+      (*staircase)->num_steps             = 0;
+      (*staircase)->capacity              = 0;
+      (*staircase)->depth                 = NULL;
+      (*staircase)->wet_bins              = NULL;
+
+      error = t_o_staircase_from_domain(*staircase, domain);
     }
-  //Otherwise slugs exist and we need to insert this in
-  //the correct position in the linked list
-  while (tmp_slug != NULL )
+
+  if (error && NULL != staircase)
     {
-      if ((*bin_slug)->bot < tmp_slug->top)
-        {
-          //bin_slug goes here
-          //rehook pointers
-          (*bin_slug)->prev = tmp_slug->prev;
-          tmp_slug->prev = (*bin_slug);
-          (*bin_slug)->next = tmp_slug;
-          if((*bin_slug)->prev == NULL)
-            {
-              domain->top_slug[bin] = (*bin_slug);
-            }
-          else
-            {
-              (*bin_slug)->prev->next = (*bin_slug);
-            }
-          //Slug is inserted now!
-          return 0;
-        }
-      else if ((*bin_slug)->bot == tmp_slug->top)
-        {
-          //the two slugs merge into one slug
-          tmp_slug->top = (*bin_slug)->top;
-          slug_dealloc(&(*bin_slug));
-          return 0;
-        }
-      else if ((*bin_slug)->top == tmp_slug->bot && NULL != tmp_slug->next && (*bin_slug)->bot == tmp_slug->next->top)
-        {
-          //the three slugs merge into one slug
-          tmp_slug->bot = tmp_slug->next->bot;
-          slug_dealloc(&(*bin_slug));
-          kill_slug(domain, bin, tmp_slug->next);
-          return 0;
-        }
-      else if ((*bin_slug)->top == tmp_slug->bot)
-        {
-          //the two slugs merge into one slug
-          tmp_slug->bot = (*bin_slug)->bot;
-          slug_dealloc(&(*bin_slug));
-          return 0;
-        }
-      tmp_slug = tmp_slug->next;
+      t_o_staircase_dealloc(staircase);
     }
-  //if we get to here, we know that the slug is at the end
-  //of the binned list
-  domain->bot_slug[bin]->next = (*bin_slug);
-  (*bin_slug)->prev = domain->bot_slug[bin];
-  (*bin_slug)->next = NULL;
-  domain->bot_slug[bin] = (*bin_slug);
-  return 0;
+
+  return error;
 }
 
-int
-redistribute_top_slugs(t_o_domain* domain, slug* (*slugs_head), slug* (*slugs_end),
-    int first_bin)
+/* Comment in .h file. */
+void t_o_staircase_dealloc(t_o_staircase** staircase)
 {
-  double surface_max = domain->surface_front[first_bin];
-  //Loop over all slugs that need to be re-arranged
-  int i;
-  slug* tmp;
-  slug* collide;
-  while ((*slugs_head) != NULL )
+  assert(NULL != staircase);
+
+  if (NULL != staircase && NULL != *staircase)
     {
-      //find the first bin the bottom of the slug can contribute to
-      for(i = first_bin; i <= domain->parameters->num_bins; i++)
+      if (NULL != (*staircase)->depth)
         {
-          if((*slugs_head)->bot > domain->surface_front[i])
-            {
-              break;
-            }
+          v_dealloc((void**)&(*staircase)->depth, (*staircase)->capacity * sizeof(double));
         }
 
-      while((*slugs_head) != NULL)
+      if (NULL != (*staircase)->wet_bins)
         {
-          tmp = domain->bot_slug[i];
-          collide = NULL;
-          while(tmp != NULL)
-            {
-              //find the one, if any, slug that will potentially collide
-              if(tmp->bot <= surface_max)
-                {
-                  //this slug is the last in the top of the bin
-                  //this will be the only slug of interest;
-                  collide = tmp;
-                  break;
-                }
-              tmp = tmp->prev;
-            }
-          if(collide == NULL)
-            {
-              if((*slugs_head)->top >= domain->surface_front[i])
-                {
-                  //slug fits entirely in this bin
-                  tmp = (*slugs_head)->next;
-                  add_binned_slug(domain, &(*slugs_head), i);
-                  (*slugs_head) = tmp;
-                  break;
-                }
-              //otherwise it merges into surface front
-              double new_bot = domain->surface_front[i];
-              domain->surface_front[i] = (*slugs_head)->bot;
-              (*slugs_head)->bot = new_bot;
-              i++;
-              continue;
-            }
-          else if((*slugs_head)->bot <= collide->bot)
-            {
-              i++;
-              continue;
-            }
-          if((*slugs_head)->top >= collide->bot)
-            {
-              //slug fits entirely in this bin
-              tmp = (*slugs_head)->next;
-              add_binned_slug(domain, &(*slugs_head), i);
-              (*slugs_head) = tmp;
-              break;
-            }//otherwise it may merge with the bottom slug
-          else
-            {
-              //slug must collide
-              //merge slugs and continue
-              double new_bot = collide->bot;
-              collide->bot = (*slugs_head)->bot;
-              (*slugs_head)->bot = new_bot;
-              i++;
-              continue;
-            }
+          v_dealloc((void**)&(*staircase)->wet_bins, (*staircase)->capacity * sizeof(int));
         }
+
+      v_dealloc((void**)staircase, sizeof(t_o_staircase));
     }
-  return 0;
 }
 
-int
-redistribute_mid_slugs(t_o_domain* domain, slug* (*slugs_head), slug* (*slugs_end),
-    int first_bin)
+/* Comment in .h file. */
+int t_o_staircase_from_domain(t_o_staircase* staircase, t_o_domain* domain)
 {
-  //Loop over all slugs that need to be re-arranged
-  int i;
-  double ground_max = domain->yes_groundwater ? domain->groundwater_front[first_bin] : domain->layer_bottom_depth;
-  slug* tmp;
-  slug* collide;
-  while ((*slugs_head) != NULL )
+  int              error      = !staircase_matches_domain(staircase, domain); // Error flag.
+  int              ii, jj;                                                    // Loop counters.
+  int              num_events = 0;                                            // The number of events found.
+  int              max_events;                                                // The most events there can be.
+  int              wet_bins;                                                  // The number of wet bins at the current depth.
+  staircase_event* events     = NULL;                                         // 1D array of the depths where a bin becomes wet or dry.
+  staircase_event* scratch;                                                   // 1D array used by merge_sort_staircase_events.
+  slug*            temp_slug;
+
+  if (!error)
     {
-      //find the first bin the bottom of the slug can contribute to
-      for(i = first_bin; i <= domain->parameters->num_bins; i++)
+      // Each bin has at most a surface front water interval, a groundwater interval, and its slugs.
+      max_events = 4 * domain->parameters->num_bins;
+
+      for (ii = 2; ii <= domain->parameters->num_bins; ii++)
         {
-          if((!domain->yes_groundwater || (*slugs_head)->bot <= domain->groundwater_front[i])
-              &&(*slugs_head)->bot > domain->surface_front[i])
+          for (temp_slug = domain->top_slug[ii]; NULL != temp_slug; temp_slug = temp_slug->next)
             {
-              //slug can put water in this bin under the surface front
-              //and above the groundwater front, we check for > surface_front because
-              //the bottom of the slug should contribute to next bin if there is =
-              break;
+              max_events += 2;
             }
         }
 
-      while((*slugs_head) != NULL)
-        {
-          //find the first slug in the middle cut, if one exists
-          //this is the slug that can potentially collide
-          collide = NULL;
-          tmp = domain->bot_slug[i];
-          while(tmp != NULL)
-            {
-              if(tmp->top < ground_max)
-                {
-                  collide = tmp;
-                  break;
-                }
-              tmp = tmp->prev;
-            }
+      error = arena_v_alloc(domain->scratch, (void**)&events, 2 * max_events * sizeof(staircase_event));
+    }
 
-          //now see if slugs_head can contribute
-          if(collide == NULL)
-            {
-              if((*slugs_head)->top >= domain->surface_front[i])
-                {
-                  tmp = (*slugs_head)->next;
-                  add_binned_slug(domain, &(*slugs_head), i);
-                  (*slugs_head)= tmp;
-                  break;
-                }
-              else
-                {
-                  //otherwise it merges into surface front
-                  double new_bot = domain->surface_front[i];
+  if (!error)
+    {
+      scratch = events + max_events;
+    }
 
-                  // surface front might merge with groundwater.
-                  if (domain->yes_groundwater && (*slugs_head)->bot == domain->groundwater_front[i])
-                    {
-                      domain->groundwater_front[i] = domain->layer_top_depth;
-                      domain->surface_front[i]     = domain->layer_top_depth;
-                    }
-                  else if (NULL != domain->top_slug[i] && (*slugs_head)->bot == domain->top_slug[i]->top)
-                    {
-                      // surface front might merge with the slug below it.
-                      domain->surface_front[i] = domain->top_slug[i]->bot;
-                      kill_slug(domain, i, domain->top_slug[i]);
-                    }
-                  else
-                    {
-                      domain->surface_front[i] = (*slugs_head)->bot;
-                    }
-                  (*slugs_head)->bot = new_bot;
-                  i++;
-                  continue;
-                }
-            }
-          if((*slugs_head)->bot <= collide->bot)
-            {
-              i++;
-              continue;
-            }
-          else if((*slugs_head)->top >= collide->bot)
-            {
-              //entire slug fits under first_mid_slug
-              tmp = (*slugs_head)->next;
-              add_binned_slug(domain, &(*slugs_head), i);
-              (*slugs_head)= tmp;
-              break;
-            }
-          else
-            {
-              //merge and continue
-              double new_bot = collide->bot;
+  // There is at most one step per event plus the one at the top.
+  if (!error && staircase->capacity < max_events + 1)
+    {
+      if (NULL != staircase->depth)
+        {
+          v_dealloc((void**)&staircase->depth, staircase->capacity * sizeof(double));
+        }
 
-              // collide might merge with groundwater.
-              if (domain->yes_groundwater && (*slugs_head)->bot == domain->groundwater_front[i])
-                {
-                  domain->groundwater_front[i] = collide->top;
-                  kill_slug(domain, i, collide);
-                }
-              else if (NULL != collide->next && (*slugs_head)->bot == collide->next->top)
-                {
-                  // collide might merge with the slug below it.
-                  collide->bot = collide->next->bot;
-                  kill_slug(domain, i, collide->next);
-                }
-              else
-                {
-                  collide->bot = (*slugs_head)->bot;
-                }
+      if (NULL != staircase->wet_bins)
+        {
+          v_dealloc((void**)&staircase->wet_bins, staircase->capacity * sizeof(int));
+        }
 
-              (*slugs_head)->bot = new_bot;
-              i++;
-              continue;
-            }
+      staircase->capacity = max_events + 1;
+      error               = v_alloc((void**)&staircase->depth, staircase->capacity * sizeof(double)) ||
+                            v_alloc((void**)&staircase->wet_bins, staircase->capacity * sizeof(int));
 
+      if (error)
+        {
+          staircase->capacity = 0;
         }
     }
-  return 0;
-}
-
-int
-redistribute_bot_slugs(t_o_domain* domain, slug* (*slugs_head), slug* (*slugs_end),
-    int first_bin)
-{
-  double ground_max = domain->groundwater_front[first_bin];
-  //Loop over all slugs that need to be re-arranged
-  int i;
-  slug* tmp;
-  slug* collide;
 
-  while ((*slugs_head) != NULL )
+  if (!error)
     {
-      //find the first bin the top of the slug can contribute to
-      for(i = first_bin; i <= domain->parameters->num_bins; i++)
+      for (ii = 1; ii <= domain->parameters->num_bins; ii++)
         {
-          if((*slugs_head)->top < domain->groundwater_front[i])
+          if ((domain->yes_groundwater && domain->layer_top_depth == domain->groundwater_front[ii]) ||
+              staircase_bin_always_full(domain->parameters, domain->yes_groundwater, domain->initial_water_content, ii))
             {
-              break;
+              // The bin is completely saturated.
+              events[num_events++] = (staircase_event){domain->layer_top_depth, 1};
+              continue;
             }
-        }
 
-      while((*slugs_head) != NULL)
-        {
-          collide = NULL;
-          tmp = domain->top_slug[i];
-          while(tmp != NULL)
+          // Surface front water.
+          if (domain->layer_top_depth < domain->surface_front[ii])
             {
-              //find the one, if any, slug that will potentially collide
-              if(tmp->top >= ground_max)
-                {
-                  //this slug is the first in the bottom of the bin
-                  //this will be the only slug of interest;
-                  collide = tmp;
-                  break;
-                }
-              tmp = tmp->next;
+              events[num_events++] = (staircase_event){domain->layer_top_depth, 1};
+              events[num_events++] = (staircase_event){domain->surface_front[ii], -1};
             }
 
-          if(collide == NULL)
+          for (temp_slug = domain->top_slug[ii]; NULL != temp_slug; temp_slug = temp_slug->next)
             {
-              if((*slugs_head)->bot <= domain->groundwater_front[i])
+              if (temp_slug->top < temp_slug->bot)
                 {
-                  //slug fits entirely in this bin
-                  tmp = (*slugs_head)->next;
-                  add_binned_slug(domain, &(*slugs_head), i);
-                  (*slugs_head) = tmp;
-                  break;
+                  events[num_events++] = (staircase_event){temp_slug->top, 1};
+                  events[num_events++] = (staircase_event){temp_slug->bot, -1};
                 }
-              //otherwise it merges into groundwater front
-              double new_top = domain->groundwater_front[i];
-              domain->groundwater_front[i] = (*slugs_head)->top;
-              (*slugs_head)->top = new_top;
-              i++;
-              continue;
             }
-          else if((*slugs_head)->top >= collide->top)
+
+          // Groundwater.
+          if (domain->yes_groundwater && domain->layer_bottom_depth > domain->groundwater_front[ii])
             {
-              //water cannot go in this bin above the slug
-              i++;
-              continue;
+              events[num_events++] = (staircase_event){domain->groundwater_front[ii], 1};
             }
-          if((*slugs_head)->bot <= collide->top)
+        }
+
+      merge_sort_staircase_events(events, scratch, num_events);
+
+      // Sweep down the events.  Every change at the top of the domain is in the first step, and the ends at the bottom are not steps.
+      wet_bins = 0;
+
+      for (jj = 0; jj < num_events && events[jj].depth <= domain->layer_top_depth; jj++)
+        {
+          wet_bins += events[jj].change;
+        }
+
+      staircase->depth[0]    = domain->layer_top_depth;
+      staircase->wet_bins[0] = wet_bins;
+      staircase->num_steps   = 1;
+
+      while (jj < num_events && events[jj].depth < domain->layer_bottom_depth)
+        {
+          double depth = events[jj].depth; // Meters.
+
+          for (; jj < num_events && events[jj].depth == depth; jj++)
             {
-              //slug fits entirely in this bin
-              tmp = (*slugs_head)->next;
-              add_binned_slug(domain, &(*slugs_head), i);
-              (*slugs_head) = tmp;
-              break;
+              wet_bins += events[jj].change;
             }
-          else
+
+          if (staircase->wet_bins[staircase->num_steps - 1] != wet_bins)
             {
-              //slug must collide
-              //merge slugs and continue
-              double new_top = collide->top;
-              collide->top = (*slugs_head)->top;
-              (*slugs_head)->top = new_top;
-              i++;
-              continue;
+              staircase->depth[staircase->num_steps]    = depth;
+              staircase->wet_bins[staircase->num_steps] = wet_bins;
+              staircase->num_steps++;
             }
         }
     }
-  return 0;
+
+  if (NULL != domain && NULL != domain->scratch)
+    {
+      arena_reset(domain->scratch);
+    }
+
+  return error;
 }
 
-/* Redistribute water within the domain sideways-tetris-style
- * with no vertical movement of water so that at all depths
- * there is no wet bin to the right of a dry bin.
+/* Turn the interval of a bin of a domain from top to bot where the bin is wet
+ * into surface front water, a slug, or groundwater.  Intervals must be given
+ * from top to bottom.
  * Return TRUE if there is an error, FALSE otherwise.
- * If there is an error some but not all of the redistribution
- * might have been done.
  *
  * Parameters:
  *
- * domain    - A pointer to the t_o_domain struct.
- * first_bin - The leftmost bin that is not completely full of water.
- *             t_o_redistribute can change first_bin, but we are not passing it
- *             by reference and updating it because this is the last step and
- *             we will call find_first_bin anew for the next timestep.
+ * domain - A pointer to the t_o_domain struct.
+ * bin    - Which bin.  One based indexing is used.
+ * top    - The top of the interval in meters.
+ * bot    - The bottom of the interval in meters.
  */
-int t_o_redistribute(t_o_domain* domain, int first_bin)
+int staircase_add_interval(t_o_domain* domain, int bin, double top, double bot)
 {
-  //OPTIMIZATION, ONLY SORT FROM FIRST NON-ZERO BIN ONWARDS
-  //ADDITIONALLY, ONLY NEED TO REDISTRIBUTE SLUGS FROM FIRST NON-ZERO BINS
-  //TODO IF WE KNOW LAST BIN, WE ONLY HAVE TO SORT BETWEEN FIRST AND LAST BIN.
-  int error = FALSE;
-  int i;
-  int old_first_bin = first_bin;
+  int error = FALSE; // Error flag.
 
-  //All bins are full, no redistribution necessary
-  if (first_bin > domain->parameters->num_bins)
+  if (domain->layer_top_depth == top && domain->layer_bottom_depth == bot)
     {
-      return 0;
+      // The bin is completely saturated.  Bins that are always full without groundwater are left as they are.
+      if (domain->yes_groundwater)
+        {
+          domain->groundwater_front[bin] = domain->layer_top_depth;
+        }
+      else if (!staircase_bin_always_full(domain->parameters, FALSE, domain->initial_water_content, bin))
+        {
+          domain->surface_front[bin] = bot;
+        }
     }
-  //First sort the surface_front bins
-  //TODO TRY MERGE SORT
-  qsort((domain->surface_front) + first_bin,
-      domain->parameters->num_bins - first_bin + 1,
-      sizeof(*(domain->surface_front)), (void *) compare_surface);
-  //Then sort the groundwater_front bins
-  if(domain->yes_groundwater)
+  else if (domain->layer_top_depth == top)
     {
-      qsort((domain->groundwater_front) + first_bin,
-          domain->parameters->num_bins - first_bin + 1,
-          sizeof(*(domain->groundwater_front)), (void *) compare_ground);
+      domain->surface_front[bin] = bot;
+    }
+  else if (domain->yes_groundwater && domain->layer_bottom_depth == bot)
+    {
+      domain->groundwater_front[bin] = top;
+    }
+  else
+    {
+      error = create_slug_after(domain, bin, domain->bot_slug[bin], top, bot);
     }
-  //Redistribute slugs
-  //This requires finding all slugs that exist in the domain
-  //and combining them with slugs from the collision of
-  //groundwater and surfacewater
 
-  slug* slugs_head = NULL; // The head of a doubly linked list of slugs to insert into the domain.
-  slug* slugs_end = NULL; // The tail of a doubly linked list of slugs to insert into the domain.
+  return error;
+}
 
-  slug* slugs_top = NULL;
-  slug* slugs_top_end = NULL;
-  slug* slugs_bot = NULL;
-  slug* slugs_bot_end = NULL;
-  slug* slugs_mid = NULL;
-  slug* slugs_mid_end = NULL;
+/* Comment in .h file. */
+int t_o_staircase_to_domain(t_o_staircase* staircase, t_o_domain* domain)
+{
+  int     error     = !staircase_matches_domain(staircase, domain); // Error flag.
+  int     ii, kk;                                                   // Loop counters.
+  int     wet_bins  = 0;                                            // The number of wet bins in the step above the current one.
+  int     full_bins = 0;                                            // The number of bins that are always full.
+  double* wet_top   = NULL;                                         // 1D array of the top of the interval each wet bin is wet in.
 
-  if(domain->yes_groundwater && domain->surface_front[first_bin] != domain->layer_top_depth)
+  if (!error)
     {
-      error = find_collisions(domain, &slugs_top, &slugs_top_end, &slugs_bot,
-          &slugs_bot_end, &slugs_mid, &slugs_mid_end, &first_bin);
+      while (full_bins < domain->parameters->num_bins &&
+             staircase_bin_always_full(domain->parameters, domain->yes_groundwater, domain->initial_water_content, full_bins + 1))
+        {
+          full_bins++;
+        }
+
+      for (kk = 0; !error && kk < staircase->num_steps; kk++)
+        {
+          if (full_bins > staircase->wet_bins[kk])
+            {
+              fprintf(stderr, "ERROR: bins 1 through %d must be wet at every depth of the staircase\n", full_bins);
+              error = TRUE;
+            }
+          else if (domain->parameters->num_bins < staircase->wet_bins[kk])
+            {
+              fprintf(stderr, "ERROR: the staircase has %d wet bins at depth %lf, but the domain has only %d bins\n", staircase->wet_bins[kk],
+                      staircase->depth[kk], domain->parameters->num_bins);
+              error = TRUE;
+            }
+        }
     }
-  if(!error)
+
+  if (!error)
     {
-      //need to use old first bin here in case there were slugs in a bin that was filled
-      //by find_collisions
-      for (i = domain->parameters->num_bins; i >= old_first_bin; i--)
+      error = arena_v_alloc(domain->scratch, (void**)&wet_top, (domain->parameters->num_bins + 1) * sizeof(double));
+    }
+
+  if (!error)
+    {
+      for (ii = 1; ii <= domain->parameters->num_bins; ii++)
         {
-          if (domain->top_slug[i] != NULL )
+          while (NULL != domain->top_slug[ii])
             {
-              slug* next = domain->top_slug[i];
-              slug* tmp;
-              while (next != NULL )
-                {
-                  tmp = next->next;
-                  //TODO POSSIBLE OPTIMIZATION, CALL CUT_SLUGS ON EACH SLUG
-                  //AS IT IS FOUND, AND INSERT INSIDE CUT_SLUGS
-                  //FIXME DOING THIS OPTIMIZTION RESULTS IN A BUG??? AN INFINITE LOOP SOMEWHERE
-                  insert_into_list_top_sort(&slugs_head, &slugs_end, &next);
-                  next = tmp;
-                }
-              domain->top_slug[i] = NULL;
-              domain->bot_slug[i] = NULL;
+              kill_slug(domain, ii, domain->top_slug[ii]);
             }
-        }
 
-      //put all the slugs in their appropriate "sections"
-      error = cut_slugs(domain, &slugs_head, &(slugs_top),
-          &(slugs_top_end), &(slugs_bot), &(slugs_bot_end), &(slugs_mid),
-          &(slugs_mid_end), first_bin);
+          domain->surface_front[ii] = domain->layer_top_depth;
 
-      //We can now start to redistribute the slugs
-      if(!error)
+          if (domain->yes_groundwater)
+            {
+              domain->groundwater_front[ii] = domain->layer_bottom_depth;
+            }
+        }
+
+      // Sweep down the steps.  Where the number of wet bins goes up those bins start an interval, and where it goes down those bins end
+      // one.  Everything still wet ends at the bottom of the domain.
+      for (kk = 0; !error && kk <= staircase->num_steps; kk++)
         {
-          //we redistribute in this order so that we only need to check collisions
-          //for middle slugs...
-          redistribute_top_slugs(domain, &slugs_top, &slugs_top_end, first_bin);
-          if(domain->yes_groundwater)
+          int    step_wet_bins = (kk < staircase->num_steps) ? staircase->wet_bins[kk] : 0;
+          double depth         = (kk < staircase->num_steps) ? staircase->depth[kk]    : domain->layer_bottom_depth;
+
+          for (ii = wet_bins + 1; ii <= step_wet_bins; ii++)
             {
-              redistribute_bot_slugs(domain, &slugs_bot, &slugs_bot_end, first_bin);
+              wet_top[ii] = depth;
             }
-          else
+
+          for (ii = step_wet_bins + 1; !error && ii <= wet_bins; ii++)
             {
-              assert(slugs_bot == NULL);
+              error = staircase_add_interval(domain, ii, wet_top[ii], depth);
             }
-          redistribute_mid_slugs(domain, &slugs_mid, &slugs_mid_end, first_bin);
+
+          wet_bins = step_wet_bins;
         }
+
+      mark_all_dirty(domain);
+    }
+
+  if (NULL != domain && NULL != domain->scratch)
+    {
+      arena_reset(domain->scratch);
     }
+
   return error;
 }
 
-/* The operation of the code can shave slivers off of slugs creating extra slug
- * structs that take time to process, but are tiny and shouldn't really exist.
- * Move that water down to whatever is below it.
+/* Redistribute water within a domain by converting it to a staircase and
+ * back.  This is how t_o_redistribute redistributes a domain set to
+ * T_O_REDISTRIBUTE_STAIRCASE.  Every bin is rebuilt, so the whole domain is
+ * settled afterward and its dirty range is cleared.
+ * Return TRUE if there is an error, FALSE otherwise.
+ * If there is an error the domain might be partly redistributed.
  *
  * Parameters:
  *
- * domain    - A pointer to the t_o_domain struct.
+ * domain - A pointer to the t_o_domain struct.
  */
-void t_o_handle_sliver_slugs(t_o_domain* domain)
+int redistribute_staircase(t_o_domain* domain)
+{
+  int           error;     // Error flag.
+  t_o_staircase staircase; // The state of domain.  Its arrays are allocated by t_o_staircase_from_domain.
+
+  staircase.parameters            = domain->parameters;
+  staircase.layer_top_depth       = domain->layer_top_depth;
+  staircase.layer_bottom_depth    = domain->layer_bottom_depth;
+  staircase.yes_groundwater       = domain->yes_groundwater;
+  staircase.initial_water_content = domain->initial_water_content;
+  staircase.num_steps             = 0;
+  staircase.capacity              = 0;
+  staircase.depth                 = NULL;
+  staircase.wet_bins              = NULL;
+
+  error = t_o_staircase_from_domain(&staircase, domain) || t_o_staircase_to_domain(&staircase, domain);
+
+  if (!error)
+    {
+      clear_dirty(domain);
+    }
+
+  if (NULL != staircase.depth)
+    {
+      v_dealloc((void**)&staircase.depth, staircase.capacity * sizeof(double));
+    }
+
+  if (NULL != staircase.wet_bins)
+    {
+      v_dealloc((void**)&staircase.wet_bins, staircase.capacity * sizeof(int));
+    }
+
+  return error;
+}
+
+/* Return the index of the step of a staircase that contains depth.  A depth
+ * on a breakpoint gets the step below it.
+ *
+ * Parameters:
+ *
+ * staircase - A pointer to the t_o_staircase struct.
+ * depth     - The depth in meters.
+ */
+int staircase_step(t_o_staircase* staircase, double depth)
+{
+  int lo = 0;                        // The search is narrowed to steps lo through hi.
+  int hi = staircase->num_steps - 1;
+
+  while (lo < hi)
+    {
+      int mid = (lo + hi + 1) / 2;
+
+      if (staircase->depth[mid] <= depth)
+        {
+          lo = mid;
+        }
+      else
+        {
+          hi = mid - 1;
+        }
+    }
+
+  return lo;
+}
+
+/* Comment in .h file. */
+int t_o_staircase_wet_bins(t_o_staircase* staircase, double depth)
+{
+  assert(NULL != staircase && 0 < staircase->num_steps);
+
+  return staircase->wet_bins[staircase_step(staircase, depth)];
+}
+
+/* Comment in .h file. */
+int t_o_staircase_has_water_at_depth(t_o_staircase* staircase, int bin, double top, double bot)
 {
-  int ii; // Loop counter.
+  int kk; // Loop counter.
 
-  for (ii = 1; ii < domain->parameters->num_bins; ii++)
+  assert(NULL != staircase && 0 < staircase->num_steps && 0 < bin && bin <= staircase->parameters->num_bins && top <= bot);
+
+  kk = staircase_step(staircase, top);
+
+  // Every step that overlaps top to bot must have at least bin wet bins.
+  while (bin <= staircase->wet_bins[kk] && kk + 1 < staircase->num_steps && staircase->depth[kk + 1] < bot)
     {
-      slug* temp_slug = domain->bot_slug[ii];
+      kk++;
+    }
 
-      while (NULL != temp_slug)
-        {
-          slug*  prev_slug = temp_slug->prev;
-          double slug_size = temp_slug->bot - temp_slug->top;
+  return bin <= staircase->wet_bins[kk];
+}
 
-          if (SLIVER_SLUG_SIZE >= slug_size)
-            {
-              if (NULL != temp_slug->next)
-                {
-                  // Put the water in the next lower slug.
-                  temp_slug->next->top -= slug_size;
-                  kill_slug(domain, ii, temp_slug);
-                }
-              else if (domain->yes_groundwater)
-                {
-                  // Put the water in the groundwater.
-                  domain->groundwater_front[ii] -= slug_size;
-                  kill_slug(domain, ii, temp_slug);
-                }
-              else
-                {
-                  // Put the water at the bottom of the domain.
-                  temp_slug->top = domain->layer_bottom_depth - slug_size;
-                  temp_slug->bot = domain->layer_bottom_depth;
-                }
-            }
+/* Comment in .h file. */
+double t_o_staircase_total_water(t_o_staircase* staircase)
+{
+  int    kk;          // Loop counter.
+  double water = 0.0; // Accumulator for water in meters of bin depth.
 
-          temp_slug = prev_slug;
-        }
+  assert(NULL != staircase);
+
+  for (kk = 0; kk < staircase->num_steps; kk++)
+    {
+      double bot = (kk + 1 < staircase->num_steps) ? staircase->depth[kk + 1] : staircase->layer_bottom_depth; // Meters.
+
+      water += (bot - staircase->depth[kk]) * staircase->wet_bins[kk];
     }
+
+  // Multiply by delta_water_content to convert from meters of bin depth to meters of water and add residual saturation.
+  return (water * staircase->parameters->delta_water_content) +
+      ((staircase->layer_bottom_depth - staircase->layer_top_depth) *
+       (staircase->parameters->bin_water_content[1] - staircase->parameters->delta_water_content));
 }
 
-/* Comment in .h file */
-int t_o_timestep(t_o_domain* domain, double dt, double surfacewater_head, double* surfacewater_depth, double water_table, double* groundwater_recharge)
+/* Comment in .h file. */
+int t_o_staircase_profile(t_o_staircase* staircase, int num_elements, const double* element_depth, double* water_content, double* pressure_head)
 {
-  int error = FALSE;    // Error flag.
-  int ponded_water = 0; // Flag set by t_o_satisfy_saturated_bins that must be passed to t_o_groundwater.
-  int first_bin;        // The leftmost bin that is not completely full of water.
+  int error = FALSE; // Error flag.
+  int jj;            // Loop counter.
+  int kk = 0;        // The step above the current element.
 
-  if (NULL == domain)
+#if (DEBUG_LEVEL & DEBUG_LEVEL_PUBLIC_FUNCTIONS_SIMPLE)
+  if (NULL == staircase)
     {
-      fprintf(stderr, "ERROR: domain must not be NULL\n");
+      fprintf(stderr, "ERROR: staircase must not be NULL.\n");
       error = TRUE;
     }
 
-  if (0.0 >= dt)
+  if (1 > num_elements)
     {
-      fprintf(stderr, "ERROR: dt must be greater than zero\n");
+      fprintf(stderr, "ERROR: num_elements must be greater than or equal to one.\n");
       error = TRUE;
     }
 
-  if (0.0 > water_table)
+  if (NULL == element_depth || NULL == water_content || NULL == pressure_head)
     {
-      fprintf(stderr, "ERROR: water_table must be greater than or equal to zero\n");
+      fprintf(stderr, "ERROR: element_depth, water_content, and pressure_head must not be NULL.\n");
       error = TRUE;
     }
+#endif // (DEBUG_LEVEL & DEBUG_LEVEL_PUBLIC_FUNCTIONS_SIMPLE)
 
-  if (NULL == surfacewater_depth)
+  for (jj = 1; !error && jj <= num_elements; jj++)
     {
-      fprintf(stderr, "ERROR: surfacewater_depth must not be NULL\n");
-      error = TRUE;
+      assert(1 == jj || element_depth[jj - 1] <= element_depth[jj]);
+
+      if (element_depth[jj] <= staircase->layer_top_depth)
+        {
+          // The top of the domain is always at effective porosity.
+          water_content[jj] = staircase->parameters->bin_water_content[staircase->parameters->num_bins];
+          pressure_head[jj] = 0.0;
+        }
+      else
+        {
+          while (kk + 1 < staircase->num_steps && staircase->depth[kk + 1] < element_depth[jj])
+            {
+              kk++;
+            }
+
+          water_content[jj] = staircase->parameters->bin_water_content[staircase->wet_bins[kk]];
+          pressure_head[jj] = (staircase->parameters->num_bins == staircase->wet_bins[kk]) ? 0.0 :
+              -staircase->parameters->bin_capillary_suction[staircase->wet_bins[kk]];
+        }
     }
-  else if (0.0 > *surfacewater_depth)
+
+  return error;
+}
+
+   /******************************************************************************/
+  /* The code below is for an old version of t_o_redistribute.  It is only kept */
+ /*  around to check the correctness of the new version of t_o_redistribute.   */
+/******************************************************************************/
+
+/* Return the next depth at which whether a bin has water will flip.
+ * Will return domain->layer_depth if the bin never flips below depth.
+ *
+ * Parameters:
+ *
+ * domain - A pointer to the t_o_domain struct.
+ * bin    - Which bin to check for flip depth.  One based indexing is used.
+ * depth  - Find the next flip strictly below depth.
+ */
+double next_flip(t_o_domain* domain, int bin, double depth)
+{
+  double flip;
+  // FIXME, wencong
+  assert(NULL != domain && 0 < bin && bin <= domain->parameters->num_bins && 0.0 <= depth && depth <= domain->layer_bottom_depth);
+
+  flip = domain->layer_bottom_depth;
+
+  if (depth < domain->surface_front[bin])
     {
-      fprintf(stderr, "ERROR: surfacewater_depth must be greater than or equal to zero\n");
-      error = TRUE;
+      // has_water will flip when it hits the bottom of the surface front water.
+      flip = domain->surface_front[bin];
     }
-
-  if (NULL == groundwater_recharge)
+  else
     {
-      fprintf(stderr, "ERROR: groundwater_recharge must not be NULL\n");
-      error = TRUE;
+      // Find the first slug deeper than depth, if any.
+      slug* temp_slug = domain->top_slug[bin];
+
+      while (NULL != temp_slug && depth >= temp_slug->bot)
+        {
+          temp_slug = temp_slug->next;
+        }
+
+      if (NULL != temp_slug && depth < temp_slug->top)
+        {
+          // has_water will flip when it hits the top of the slug.
+          flip = temp_slug->top;
+        }
+      else if (NULL != temp_slug && depth < temp_slug->bot)
+        {
+          // has_water will flip when it hits the bottom of the slug.
+          flip = temp_slug->bot;
+        }
+      else if (domain->yes_groundwater && depth < domain->groundwater_front[bin])
+        {
+          // has_water will flip when it hits the top of the groundwater.
+          flip = domain->groundwater_front[bin];
+        }
     }
 
-  // FIXME, wencong 6/2/14, add variable inflow_rate for t_o_groundwater.
-  double inflow_rate = 0.0;  // Flow rate through fully saturated bins in unit of meters per second.
-  int    no_flow     = FALSE;  // FIXME, add no flow lower boundary, Jan. 09, 2015. 
-  if (!error)
+  return flip;
+}
+
+/* Remove water between top and bot from bin.
+ * This function assumes that bin has water from top to bot.
+ * If yes_groundwater is FALSE, you cannot use this function to
+ * remove water from bins less than or equal to initial_water_content.
+ * Return TRUE if there is an error, FALSE otherwise.
+ * If there is an error no water is removed.
+ *
+ * Parameters:
+ *
+ * domain - A pointer to the t_o_domain struct.
+ * bin    - Which bin to remove water from.  One based indexing is used.
+ * top    - The depth of the top of the region of water to remove.
+ * bot    - The depth of the bottom of the region of water to remove.
+ */
+int remove_water(t_o_domain* domain, int bin, double top, double bot)
+{
+  int error = FALSE; // Error flag.
+  //FIXME, wencong, layer_bottom_depth.
+  assert(NULL != domain && 0 < bin && bin <= domain->parameters->num_bins && domain->layer_top_depth <= top && top < bot && bot <= domain->layer_bottom_depth);
+
+  if (top < domain->surface_front[bin])
     {
-      first_bin = find_first_bin(domain, 2);
-      if (!no_flow)
+      // The water is in the surface front water.
+      assert(bot <= domain->surface_front[bin]);
+
+      if (bot < domain->surface_front[bin])
+        {
+          // Need to create a slug from bot to surface_front.
+          error = create_slug_after(domain, bin, NULL, bot, domain->surface_front[bin]);
+        }
+
+      if (!error)
         {
-           double recharge_old = *groundwater_recharge;
-          // Add water_table as passing parameter in t_o_satisfy_saturated_bins() 06/17/14.
-          error               = t_o_satisfy_saturated_bins(domain, dt, first_bin, surfacewater_depth, &ponded_water, groundwater_recharge, water_table);
-          inflow_rate         = (*groundwater_recharge - recharge_old) / dt; 
+          // Surface front water now goes down to top.
+          set_surface_front(domain, bin, top);
         }
     }
+  else
+    {
+      // The water is not in the surface front water.
+      // Try to find it in a slug.
+      slug* temp_slug = domain->top_slug[bin];
+
+      while (NULL != temp_slug && top >= temp_slug->bot)
+        {
+          temp_slug = temp_slug->next;
+        }
+
+      if (NULL != temp_slug)
+        {
+          // The water is in temp_slug.
+          assert(top >= temp_slug->top && bot <= temp_slug->bot);
+
+          if (top == temp_slug->top && bot == temp_slug->bot)
+            {
+              // Get the whole slug.
+              kill_slug(domain, bin, temp_slug);
+            }
+          else if (top == temp_slug->top)
+            {
+              // Get water from the top of the slug.
+              set_slug_top(domain, bin, temp_slug, bot);
+            }
+          else if (bot == temp_slug->bot)
+            {
+              // Get water from the bottom of the slug.
+              set_slug_bot(domain, bin, temp_slug, top);
+            }
+          else
+            {
+              // Get water from the middle of the slug.
+              // need to create a slug from bot to temp_slug->bot.
+              error = create_slug_after(domain, bin, temp_slug, bot, temp_slug->bot);
+
+              if (!error)
+                {
+                  // The old slug now goes down to top.
+                  set_slug_bot(domain, bin, temp_slug, top);
+                }
+            }
+        } // End the water is in temp_slug.
+      else
+        {
+          // The water is in the groundwater.
+          if (!domain->yes_groundwater)
+            {
+              fprintf(stderr, "ERROR: Function remove_water attempting to remove water from a bin less than or equal to initial_water_content with "
+                  "yes_groundwater equal to FALSE.\n");
+              error = TRUE;
+            }
+
+          if (!error)
+            {
+              assert(top >= domain->groundwater_front[bin]);
+
+              if (top > domain->groundwater_front[bin])
+                {
+                  if (0.0 == domain->groundwater_front[bin])
+                    {
+                      // The water above the removed water is surface front water
+                      set_surface_front(domain, bin, top);
+                    }
+                  else
+                    {
+                      // need to create a slug from groundwater_front to top
+                      error = create_slug_after(domain, bin, domain->bot_slug[bin], domain->groundwater_front[bin], top);
+                    }
+                }
+            }
+
+          if (!error)
+            {
+              // Groundwater now starts at bot.
+              set_groundwater_front(domain, bin, bot);
+            }
+        } // End the water is in the groundwater.
+    } // End the water is not in the surface attched water.
+
+  return error;
+}
+
+/* Add water between top and bot to bin.
+ * This function assumes that the added water does not touch surface
+ * front water or groundwater and that bin is empty from top to bot.
+ * Return TRUE if there is an error, FALSE otherwise.
+ * If there is an error no water is added.
+ *
+ * Parameters:
+ *
+ * domain - A pointer to the t_o_domain struct.
+ * bin    - Which bin to put water in.  One based indexing is used.
+ * top    - The depth of the top of the region of water to add.
+ * bot    - The depth of the bottom of the region of water to add.
+ */
+int add_water_to_slug(t_o_domain* domain, int bin, double top, double bot)
+{
+  int error = FALSE; // Error flag.
 
-  if (!error)
-    { // FIXME, wencong, add ponded_water flag, infiltrate when ponded_water is TRUE even surfacewater_depth is zero.
-      // error = t_o_infiltrate(domain, dt, &first_bin, surfacewater_head, surfacewater_depth, groundwater_recharge);
-         error = t_o_infiltrate(domain, dt, &first_bin, surfacewater_head, surfacewater_depth, groundwater_recharge, ponded_water);
-    }
+  assert(NULL != domain && 0 < bin && bin <= domain->parameters->num_bins && domain->surface_front[bin] < top && top < bot);
 
-  if (!error)
+  if (domain->yes_groundwater)
     {
-      error = t_o_falling_slugs(domain, dt, first_bin, groundwater_recharge);
+      assert(bot < domain->groundwater_front[bin]);
     }
-
-  if (!error)
+  else
     {
-      // FIXME, wencong 6/2/14, add inflow_rate.
-      // error = t_o_groundwater(domain, dt, &first_bin, water_table, ponded_water, groundwater_recharge);
-      error = t_o_groundwater(domain, dt, &first_bin, water_table, ponded_water, groundwater_recharge, inflow_rate);
+      // FIXME, wencong.
+      assert(bot <= domain->layer_bottom_depth);
     }
 
-  if (!error)
+  if (NULL == domain->top_slug[bin] || bot < domain->top_slug[bin]->top)
     {
-      t_o_handle_sliver_slugs(domain);
+      // Add the first slug in the bin or a slug above the top slug.
+      error = create_slug_after(domain, bin, NULL, top, bot);
     }
-  
-  if (!error)
+  else if (bot == domain->top_slug[bin]->top)
     {
-      error = t_o_redistribute(domain, first_bin);
+      // The water is attached to the top of the top slug.
+      set_slug_top(domain, bin, domain->top_slug[bin], top);
     }
-
-  // FIXME Do we want to call this here?  It is also being called by adhydro_check_invariant.
-#if (DEBUG_LEVEL & DEBUG_LEVEL_INTERNAL_ASSERTIONS)
-  if (!error)
+  else if (top > domain->bot_slug[bin]->bot)
     {
-      t_o_check_invariant(domain); 
+      // Add a slug below the bottom slug.
+      error = create_slug_after(domain, bin, domain->bot_slug[bin], top, bot);
     }
-#endif // (DEBUG_LEVEL & DEBUG_LEVEL_INTERNAL_ASSERTIONS)
+  else if (top == domain->bot_slug[bin]->bot)
+    {
+      // The water is attached to the bottom of the bottom slug.
+      set_slug_bot(domain, bin, domain->bot_slug[bin], bot);
+    }
+  else
+    {
+      // Loop over the gaps to find the gap that the slug is in.
+      // Look at the gap between temp_slug and temp_slug->next.
+      slug* temp_slug = domain->top_slug[bin];
 
-  return error;
-}
+      while (temp_slug->next->next != NULL && top >= temp_slug->next->bot)
+        {
+          temp_slug = temp_slug->next;
+        }
 
-/* Return a conservative estimate of the depth to fill to in order to add
- * groundwater_recharge to groundwater.  This estimate is achieved by assuming
- * that all of the space above groundwater is empty.  If it really is empty
- * this will produce the exact depth to fill groundwater to.  If there are some
- * slugs or surface front water then add_recharge will not add all of the water
- * and you will have to loop until all of the water is added or the domain is
- * full.
- * 
- * Parameters:
- * 
- * domain               - A pointer to the t_o_domain struct.
- * groundwater_recharge - The amount of water to add to the domain in meters of
- *                        water.
- */
-double find_recharge_depth(t_o_domain* domain, double groundwater_recharge)
-{
-  int    ii              = domain->parameters->num_bins; // Loop counter.
-  int    done            = FALSE;                        // Loop flag.
-  double space_available = 0.0;                          // Space found so far in meters of water.
-  double depth           = 0.0;                          // Meters.  Use zero if we never find enough space for the water.
-  
-  assert(NULL != domain && 0.0 <= groundwater_recharge);
+      assert(top >= temp_slug->bot && bot <= temp_slug->next->top);
 
-  while(!done && 1 < ii && domain->layer_top_depth < domain->groundwater_front[ii])
-    {
-      double new_space= (domain->groundwater_front[ii] - domain->groundwater_front[ii - 1]) * (domain->parameters->num_bins + 1 - ii) *
-                         domain->parameters->delta_water_content; // Meters of water.
-      
-      if (space_available + new_space < groundwater_recharge)
+      if (top == temp_slug->bot && bot == temp_slug->next->top)
         {
-          // Enough water to fill up to domain->groundwater_front[ii - 1].
-          space_available += new_space;
+          // Merge the two slugs.
+          set_slug_bot(domain, bin, temp_slug, temp_slug->next->bot);
+          kill_slug(domain, bin, temp_slug->next);
+        }
+      else if (top == temp_slug->bot)
+        {
+          // Add the water to the bottom of temp_slug.
+          set_slug_bot(domain, bin, temp_slug, bot);
+        }
+      else if (bot == temp_slug->next->top)
+        {
+          // Add the water to the top of temp_slug->next.
+          set_slug_top(domain, bin, temp_slug->next, top);
         }
       else
         {
-          depth = domain->groundwater_front[ii] - (((groundwater_recharge - space_available) / domain->parameters->delta_water_content) / (domain->parameters->num_bins + 1 - ii));
-          done = TRUE;
+          // Add a new slug in between.
+          error = create_slug_after(domain, bin, temp_slug, top, bot);
         }
-      
-      ii--;
     }
-  
-  assert(domain->layer_top_depth <= depth && depth <= domain->layer_bottom_depth);
-  
-  return depth;
+
+  return error;
 }
 
-/* Move all groundwater up to at least depth while handling collisions with
- * slugs and surface front water.  Water required to fill the space is taken
- * from groundwater_recharge.
+/* Add water between top and bot to bin.
+ * This function assumes that bin is empty from top to bot.
+ * Return TRUE if there is an error, FALSE otherwise.
+ * If there is an error no water is added.
  *
  * Parameters:
- * 
- * domain               - A pointer to the t_o_domain struct.
- * depth                - The depth to fill the groundwater to.
- * groundwater_recharge - A scalar passed by reference containing an amount of
- *                        water in meters of water.  Water used to fill
- *                        groundwater to depth is subtracted from this amount
- *                        of water.  If more water is used than available
- *                        groundwater_recharge will go negative.  It is the
- *                        responsibility of the caller to ensure that filling
- *                        groundwater to depth will not use more water than
- *                        available.
+ *
+ * domain - A pointer to the t_o_domain struct.
+ * bin    - Which bin to put water in.  One based indexing is used.
+ * top    - The depth of the top of the region of water to add.
+ * bot    - The depth of the bottom of the region of water to add.
  */
-void add_recharge(t_o_domain* domain, double depth, double* groundwater_recharge)
+int add_water(t_o_domain* domain, int bin, double top, double bot)
 {
-  int ii = domain->parameters->num_bins; // Loop counter.
-  
-  assert(NULL != domain && 0.0 <= depth && NULL != groundwater_recharge && 0.0 <= *groundwater_recharge);
-  
-  // Loop from right to left until you hit a bin where the groundwater depth is already depth or higher.
+  int error = FALSE; // Error flag.
+  //FIXME, wencong.
+  assert(NULL != domain && 0 < bin && bin <= domain->parameters->num_bins && domain->surface_front[bin] <= top && top < bot && bot <= domain->layer_bottom_depth);
 
-  while (0 < ii && depth < domain->groundwater_front[ii])
+  if (top == domain->surface_front[bin])
     {
-      // Check for collisions with slugs.
-      while (NULL != domain->bot_slug[ii] && domain->bot_slug[ii]->bot >= depth)
-        {
-          *groundwater_recharge         -= (domain->groundwater_front[ii] - domain->bot_slug[ii]->bot) * domain->parameters->delta_water_content;
-          domain->groundwater_front[ii]  = domain->bot_slug[ii]->top;
-          kill_slug(domain, ii, domain->bot_slug[ii]);
-        }
-      
-      // Check for collision with surface front water.
-      if (domain->surface_front[ii] >= depth)
-        {
-          *groundwater_recharge         -= (domain->groundwater_front[ii] - domain->surface_front[ii]) * domain->parameters->delta_water_content;
-          domain->surface_front[ii]      = domain->layer_top_depth;
-          domain->groundwater_front[ii]  = domain->layer_top_depth;
-        }
-      else if (domain->groundwater_front[ii] > depth) // Must check in case a slug moved groundater.
+      // Add the water to the bottom of the surface front water.
+      if (NULL != domain->top_slug[bin])
         {
-          *groundwater_recharge         -= (domain->groundwater_front[ii] - depth) * domain->parameters->delta_water_content;
-          domain->groundwater_front[ii]  = depth;
-        }
-      
-      ii--;
-    }
-}
+          assert(bot <= domain->top_slug[bin]->top);
 
-/* Comment in .h file */
-void t_o_add_groundwater(t_o_domain* domain, double* groundwater_recharge)
-{
-  int done = FALSE; // Loop flag.
-  
-  assert(NULL != domain && NULL != groundwater_recharge && 0.0 <= *groundwater_recharge);
-  
-  if(domain->yes_groundwater)
-    {
-      while (!done && epsilon_less(0.0, *groundwater_recharge))
-        {
-          double depth = find_recharge_depth(domain, *groundwater_recharge);
-          
-          add_recharge(domain, depth, groundwater_recharge);
-          
-          if (0.0 == depth)
+          if (bot == domain->top_slug[bin]->top)
             {
-              done = TRUE;
+              // The surface front water has joined with the top slug.
+              set_surface_front(domain, bin, domain->top_slug[bin]->bot);
+              kill_slug(domain, bin, domain->top_slug[bin]);
+            }
+          else
+            {
+              set_surface_front(domain, bin, bot);
             }
         }
-    }
-  else
-    {
-      fprintf(stderr, "WARNING: called t_o_add_groundwater on a t_o_domain with yes_groundwater FALSE.\n");
-    }
-}
-
-/* Comment in .h file */
-void t_o_take_groundwater(t_o_domain* domain, double water_table, double* groundwater_recharge)
-{
-  int ii; // Loop counter.
-
-  if(domain->yes_groundwater)
-    {
-      for (ii = domain->parameters->num_bins; epsilon_greater(0.0, *groundwater_recharge) && ii >= 1; ii--)
+      else if (domain->yes_groundwater)
         {
-          double maximum_bin_depth = water_table - 0.1 * domain->parameters->bin_capillary_suction[ii]; // Meters.
+          assert(bot <= domain->groundwater_front[bin]);
 
-          // If there is water to the right of the groundwater in this bin we can't orphan that water.
-          if (ii < domain->parameters->num_bins)
+          if (bot == domain->groundwater_front[bin])
             {
-              if (domain->surface_front[ii + 1] > domain->groundwater_front[ii])
-                {
-                  maximum_bin_depth = domain->layer_top_depth;
-                }
-
-              // Find the highest slug, if any, that the groundwater can't drop below.
-              slug* temp_slug = domain->bot_slug[ii + 1];
-
-              while (NULL != temp_slug && NULL != temp_slug->prev && temp_slug->prev->bot > domain->groundwater_front[ii])
-                {
-                  temp_slug = temp_slug->prev;
-                }
-
-              if (NULL != temp_slug && temp_slug->bot > domain->groundwater_front[ii] && maximum_bin_depth > temp_slug->top)
-                {
-                  maximum_bin_depth = temp_slug->top;
-                }
-              
-              if (maximum_bin_depth > domain->groundwater_front[ii + 1])
-                {
-                  maximum_bin_depth = domain->groundwater_front[ii + 1];
-                }
+              // The surface front water has joined with the groundwater.
+              // FIXME, wencong, change two 0.0.
+              set_surface_front(domain, bin, domain->layer_top_depth);
+              set_groundwater_front(domain, bin, domain->layer_top_depth);
             }
-          
-          // Don't let groundwater fall below the bottom of the layer.
-          if (maximum_bin_depth > domain->layer_bottom_depth)
+          else
             {
-              maximum_bin_depth = domain->layer_bottom_depth;
+              set_surface_front(domain, bin, bot);
             }
+        }
+      else
+        {
+          set_surface_front(domain, bin, bot);
+        }
+    } // End add the water to the bottom of the surface front water.
+  else
+    {
+      // Add the water to the groundwater or a slug.
+      if (domain->yes_groundwater)
+        {
+          assert(bot <= domain->groundwater_front[bin]);
 
-          if (maximum_bin_depth > domain->groundwater_front[ii])
+          if (bot == domain->groundwater_front[bin])
             {
-              double water_available = (maximum_bin_depth - domain->groundwater_front[ii]) * domain->parameters->delta_water_content; // Meters of water.
-
-              if (water_available <= -*groundwater_recharge)
+              // Add the water to the top of the groundwater.
+              if (NULL != domain->bot_slug[bin])
                 {
-                  // There is not enough water.  Take it all.
-                  domain->groundwater_front[ii]  = maximum_bin_depth;
-                  *groundwater_recharge         += water_available;
+                  assert(top >= domain->bot_slug[bin]->bot);
+
+                  if (top == domain->bot_slug[bin]->bot)
+                    {
+                      // The groundwater has joined with the bottom slug.
+                      set_groundwater_front(domain, bin, domain->bot_slug[bin]->top);
+                      kill_slug(domain, bin, domain->bot_slug[bin]);
+                    }
+                  else
+                    {
+                      set_groundwater_front(domain, bin, top);
+                    }
                 }
-              else // if (water_available > -*groundwater_recharge)
+              else
                 {
-                  // There is enough water.  Take what you need.
-                  domain->groundwater_front[ii] -= *groundwater_recharge / domain->parameters->delta_water_content;
-                  *groundwater_recharge          = 0.0;
+                  set_groundwater_front(domain, bin, top);
                 }
             }
+          else // The bottom of the water we are adding is not touching groundwater.
+            {
+              // Add the water to a slug.
+              error = add_water_to_slug(domain, bin, top, bot);
+            }
         }
-    }
-  else
-    {
-      fprintf(stderr, "WARNING: called t_o_take_groundwater on a t_o_domain with yes_groundwater FALSE.\n");
-    }
-}
-
-/* Comment in .h file. */
-double t_o_specific_yield(t_o_domain* domain, double water_table)
-{
-  double porosity               = domain->parameters->bin_water_content[domain->parameters->num_bins];
-  double residual_saturation    = (domain->parameters->bin_water_content[1] - domain->parameters->delta_water_content);
-  // FIXME store residual saturation in bin_water_content[0] or its own struct member?
-  double specific_yield         = (porosity - residual_saturation) *
-                                  (1.0 - pow(domain->parameters->bc_psib / (domain->parameters->bc_psib + water_table + 0.01), domain->parameters->bc_lambda));
-
-  if (0.1 > specific_yield)
-    {
-      specific_yield = 0.1;
-    }
-  
-  if (specific_yield < residual_saturation)
-    {
-      specific_yield = residual_saturation;
-    }
-  
-  if (specific_yield > porosity)
-    {
-      specific_yield = porosity;
-    }
+      else // domain->yes_groundwater is FALSE
+        {
+          // Add the water to a slug.
+          error = add_water_to_slug(domain, bin, top, bot);
+        }
+    } // End add the water to the groundwater or a slug.
 
-  return specific_yield;
+  return error;
 }
 
-   /******************************************************************************/
-  /* The code below is for an old version of t_o_redistribute.  It is only kept */
- /*  around to check the correctness of the new version of t_o_redistribute.   */
-/******************************************************************************/
-
-/* Return the next depth at which whether a bin has water will flip.
- * Will return domain->layer_depth if the bin never flips below depth.
+/* Move the water between top and bot from from_bin to to_bin.
+ * This function assumes that from_bin has water from top to bot
+ * and that to_bin is empty from top to bot.
+ * Return TRUE if there is an error, FALSE otherwise.
+ * If there is an error it might be that no water is moved, but
+ * it is also possible that water is removed from from_bin and errors
+ * prevent it from being put either into to_bin or back into from_bin.
  *
  * Parameters:
  *
- * domain - A pointer to the t_o_domain struct.
- * bin    - Which bin to check for flip depth.  One based indexing is used.
- * depth  - Find the next flip strictly below depth.
+ * domain   - A pointer to the t_o_domain struct.
+ * from_bin - Which bin to take water from.  One based indexing is used.
+ * to_bin   - Which bin to put water in.  One based indexing is used.
+ * top      - The depth of the top of the region of water to move.
+ * bot      - The depth of the bottom of the region of water to move.
  */
-double next_flip(t_o_domain* domain, int bin, double depth)
+int move_water(t_o_domain* domain, int from_bin, int to_bin, double top, double bot)
 {
-  double flip;
-  // FIXME, wencong
-  assert(NULL != domain && 0 < bin && bin <= domain->parameters->num_bins && 0.0 <= depth && depth <= domain->layer_bottom_depth);
+  int error = FALSE; // Error flag.
+ 
+  // FIXME, wencong.
+  assert(NULL != domain && 0 < from_bin && from_bin <= domain->parameters->num_bins && 0 < to_bin && to_bin <= domain->parameters->num_bins &&
+      from_bin != to_bin && domain->layer_top_depth <= top && top < bot && bot <= domain->layer_bottom_depth && 
+      has_water_at_depth(domain, from_bin, top, bot) && !has_water_at_depth(domain, to_bin, top, bot));
 
-  flip = domain->layer_bottom_depth;
+  error = remove_water(domain, from_bin, top, bot);
 
-  if (depth < domain->surface_front[bin])
-    {
-      // has_water will flip when it hits the bottom of the surface front water.
-      flip = domain->surface_front[bin];
-    }
-  else
+  if (!error)
     {
-      // Find the first slug deeper than depth, if any.
-      slug* temp_slug = domain->top_slug[bin];
-
-      while (NULL != temp_slug && depth >= temp_slug->bot)
-        {
-          temp_slug = temp_slug->next;
-        }
+      error = add_water(domain, to_bin, top, bot);
 
-      if (NULL != temp_slug && depth < temp_slug->top)
-        {
-          // has_water will flip when it hits the top of the slug.
-          flip = temp_slug->top;
-        }
-      else if (NULL != temp_slug && depth < temp_slug->bot)
-        {
-          // has_water will flip when it hits the bottom of the slug.
-          flip = temp_slug->bot;
-        }
-      else if (domain->yes_groundwater && depth < domain->groundwater_front[bin])
+      if (error)
         {
-          // has_water will flip when it hits the top of the groundwater.
-          flip = domain->groundwater_front[bin];
+          // Put the water back.
+          if (add_water(domain, from_bin, top, bot))
+            {
+              // Can't put the water anywhere.
+              fprintf(stderr, "ERROR: Lost water in move_water.\n");
+            }
         }
     }
 
-  return flip;
+  return error;
 }
 
-/* Remove water between top and bot from bin.
- * This function assumes that bin has water from top to bot.
- * If yes_groundwater is FALSE, you cannot use this function to
- * remove water from bins less than or equal to initial_water_content.
- * Return TRUE if there is an error, FALSE otherwise.
- * If there is an error no water is removed.
+/* This is an old, slower way of doing redistribution.  It is kept around
+ * to check the correctness of the new redistribution algorithm.
+ * It should be a drop-in replacement for redistribute().
+ * See the comment of redistribute() for more details.
+ *
+ * Algorithm:
+ *
+ * top       - The top of the depth range currently being processed.
+ * bot       - The bottom of the depth range currently being processed.
+ *             top and bot will start at the surface and walk down the
+ *             entire depth of the domain.
+ * has_water - An array of flags, one per bin, representing whether that bin
+ *             has water between top and bot.
+ * flip      - An array of doubles, one per bin, representing the next depth
+ *             at which the bin will flip the value of its has_water flag.
+ *
+ * Initialize top and bot to zero.
+ * Initialize has_water to whether each bin has water at depth zero.
+ * Initialize flip to the first depth where a bin flips whether it has water.
+ *   This depth may be domain->full_depth if the bin never flips.
+ *
+ * Do
+ *   Set top = bot.
+ *   Set bot to the smallest value in flip.
+ *   All bins are either entirely wet or entirely dry between top and bot.
+ *   Do
+ *     Move the water between top and bot from the rightmost bin
+ *       that is wet to the leftmost bin that is dry.
+ *   Until there is no wet bin to the right of a dry bin.
+ *   For all bins where flip == bot:
+ *     Flip the has_water flag.
+ *     Find the next lower flip, may be domain->full_depth.
+ * until bot == domain->full_depth.
  *
  * Parameters:
  *
  * domain - A pointer to the t_o_domain struct.
- * bin    - Which bin to remove water from.  One based indexing is used.
- * top    - The depth of the top of the region of water to remove.
- * bot    - The depth of the bottom of the region of water to remove.
  */
-int remove_water(t_o_domain* domain, int bin, double top, double bot)
+int redistribute_slow(t_o_domain* domain)
 {
-  int error = FALSE; // Error flag.
-  //FIXME, wencong, layer_bottom_depth.
-  assert(NULL != domain && 0 < bin && bin <= domain->parameters->num_bins && domain->layer_top_depth <= top && top < bot && bot <= domain->layer_bottom_depth);
+  int    error = FALSE; // Error flag.
+  int    ii;            // Loop counter.
+  double top = 0.0;     // The top of the slice being processed.
+  double bot = 0.0;     // The bottom of the slice being processed.
 
-  if (top < domain->surface_front[bin])
+  if (NULL == domain)
     {
-      // The water is in the surface front water.
-      assert(bot <= domain->surface_front[bin]);
+      fprintf(stderr, "ERROR: domain must not be NULL\n");
+      error = TRUE;
+    }
 
-      if (bot < domain->surface_front[bin])
-        {
-          // Need to create a slug from bot to surface_front.
-          error = create_slug_after(domain, bin, NULL, bot, domain->surface_front[bin]);
-        }
+  // has_water[ii] is TRUE if bin ii has water between top and bot.
+  int has_water[domain->parameters->num_bins + 1];
 
-      if (!error)
+  // flip[ii] is the depth at which has_water[ii] will next change or
+  // domain->layer_depth if has_water[ii] will never change again.
+  double flip[domain->parameters->num_bins + 1];
+
+  // Fill in has_water and flip.
+  if (!error)
+    {
+      for (ii = 1; ii <= domain->parameters->num_bins; ii++)
         {
-          // Surface front water now goes down to top.
-          domain->surface_front[bin] = top;
+          // FIXME, wencong, change the following 0.0??
+          has_water[ii] = has_water_at_depth(domain, ii, 0.0, 0.0);
+          flip[ii]      = next_flip(domain, ii, 0.0);
         }
     }
-  else
+
+  // Walk down the entire depth of the domain.
+  // FIXME, wencong.
+  while (!error && bot < domain->layer_bottom_depth)
     {
-      // The water is not in the surface front water.
-      // Try to find it in a slug.
-      slug* temp_slug = domain->top_slug[bin];
+      // Set top to bot and bot to the closest flip.
+      top = bot;
+      bot = flip[1];
 
-      while (NULL != temp_slug && top >= temp_slug->bot)
+      for (ii = 2; ii <= domain->parameters->num_bins; ii++)
         {
-          temp_slug = temp_slug->next;
+          if (bot > flip[ii])
+            {
+              bot = flip[ii];
+            }
         }
 
-      if (NULL != temp_slug)
-        {
-          // The water is in temp_slug.
-          assert(top >= temp_slug->top && bot <= temp_slug->bot);
+      assert(bot > top);
 
-          if (top == temp_slug->top && bot == temp_slug->bot)
-            {
-              // Get the whole slug.
-              kill_slug(domain, bin, temp_slug);
-            }
-          else if (top == temp_slug->top)
-            {
-              // Get water from the top of the slug.
-              temp_slug->top = bot;
-            }
-          else if (bot == temp_slug->bot)
+      // At this point all bins are either entirely wet
+      // or entirely dry between top and bot.
+
+      // Find the right most wet bin and the leftmost dry bin
+      // and move the water from the wet bin to the dry bin.
+      // Repeat until there are no wet bins to the right of a dry bin.
+      int right_bin = domain->parameters->num_bins;
+      int left_bin  = 1;
+
+      while (!error && right_bin > left_bin)
+        {
+          if (!has_water[right_bin])
             {
-              // Get water from the bottom of the slug.
-              temp_slug->bot = top;
+              right_bin--;
             }
-          else
+          else if (has_water[left_bin])
             {
-              // Get water from the middle of the slug.
-              // need to create a slug from bot to temp_slug->bot.
-              error = create_slug_after(domain, bin, temp_slug, bot, temp_slug->bot);
-
-              if (!error)
-                {
-                  // The old slug now goes down to top.
-                  temp_slug->bot = top;
-                }
+              left_bin++;
             }
-        } // End the water is in temp_slug.
-      else
-        {
-          // The water is in the groundwater.
-          if (!domain->yes_groundwater)
+          else
             {
-              fprintf(stderr, "ERROR: Function remove_water attempting to remove water from a bin less than or equal to initial_water_content with "
-                  "yes_groundwater equal to FALSE.\n");
-              error = TRUE;
+              error = move_water(domain, right_bin, left_bin, top, bot);
+              right_bin--;
+              left_bin++;
             }
+        }
 
-          if (!error)
+      // Flip has_water flag for bins that flip at bot.
+      if (!error)
+        {
+          for (ii = 1; ii <= domain->parameters->num_bins; ii++)
             {
-              assert(top >= domain->groundwater_front[bin]);
-
-              if (top > domain->groundwater_front[bin])
+              if (bot == flip[ii])
                 {
-                  if (0.0 == domain->groundwater_front[bin])
-                    {
-                      // The water above the removed water is surface front water
-                      domain->surface_front[bin] = top;
-                    }
-                  else
-                    {
-                      // need to create a slug from groundwater_front to top
-                      error = create_slug_after(domain, bin, domain->bot_slug[bin], domain->groundwater_front[bin], top);
-                    }
+                  has_water[ii] = !has_water[ii];
+                  flip[ii] = next_flip(domain, ii, bot);
                 }
             }
-
-          if (!error)
-            {
-              // Groundwater now starts at bot.
-              domain->groundwater_front[bin] = bot;
-            }
-        } // End the water is in the groundwater.
-    } // End the water is not in the surface attched water.
+        }
+    }
 
   return error;
 }
 
-/* Add water between top and bot to bin.
- * This function assumes that the added water does not touch surface
- * front water or groundwater and that bin is empty from top to bot.
- * Return TRUE if there is an error, FALSE otherwise.
- * If there is an error no water is added.
- *
- * Parameters:
- *
- * domain - A pointer to the t_o_domain struct.
- * bin    - Which bin to put water in.  One based indexing is used.
- * top    - The depth of the top of the region of water to add.
- * bot    - The depth of the bottom of the region of water to add.
- */
-int add_water_to_slug(t_o_domain* domain, int bin, double top, double bot)
-{
-  int error = FALSE; // Error flag.
-
-  assert(NULL != domain && 0 < bin && bin <= domain->parameters->num_bins && domain->surface_front[bin] < top && top < bot);
+// The version of t_o_redistribute below sorts slugs by inserting them one at a time into sorted linked lists.
 
-  if (domain->yes_groundwater)
-    {
-      assert(bot < domain->groundwater_front[bin]);
-    }
-  else
+int
+insert_into_list_top_sort(slug* (*list), slug* (*end), slug* (*element))
+{
+  if ((*list) == NULL )
     {
-      // FIXME, wencong.
-      assert(bot <= domain->layer_bottom_depth);
+      (*element)->next = NULL;
+      (*element)->prev = NULL;
+      (*list) = (*element);
+      (*end) = (*list);
     }
-
-  if (NULL == domain->top_slug[bin] || bot < domain->top_slug[bin]->top)
+  else if ((*list)->top >= (*element)->top)
     {
-      // Add the first slug in the bin or a slug above the top slug.
-      error = create_slug_after(domain, bin, NULL, top, bot);
+      (*element)->prev = NULL;
+      (*element)->next = (*list);
+      (*list)->prev = (*element);
+      (*list) = (*element);
     }
-  else if (bot == domain->top_slug[bin]->top)
+  else
     {
-      // The water is attached to the top of the top slug.
-      domain->top_slug[bin]->top = top;
+      slug* current = (*list);
+      while (current->next != NULL && current->next->top < (*element)->top)
+        {
+          current = current->next;
+        }
+      //found correct insertion point
+      if (current->next != NULL )
+        {
+          (*element)->next = current->next;
+          current->next->prev = (*element);
+          current->next = (*element);
+          (*element)->prev = current;
+        }
+      else
+        {
+          current->next = (*element);
+          (*element)->prev = current;
+          (*element)->next = NULL;
+          (*end) = (*element);
+        }
     }
-  else if (top > domain->bot_slug[bin]->bot)
+  return 0;
+}
+
+int
+insert_into_list_bot_sort(slug* (*list), slug* (*end), slug* (*element))
+{
+  if ((*list) == NULL )
     {
-      // Add a slug below the bottom slug.
-      error = create_slug_after(domain, bin, domain->bot_slug[bin], top, bot);
+      (*element)->next = NULL;
+      (*element)->prev = NULL;
+      (*list) = (*element);
+      (*end) = (*list);
     }
-  else if (top == domain->bot_slug[bin]->bot)
+  else if ((*list)->bot <= (*element)->bot)
     {
-      // The water is attached to the bottom of the bottom slug.
-      domain->bot_slug[bin]->bot = bot;
+      (*element)->prev = NULL;
+      (*element)->next = (*list);
+      (*list)->prev = (*element);
+      (*list) = (*element);
     }
   else
     {
-      // Loop over the gaps to find the gap that the slug is in.
-      // Look at the gap between temp_slug and temp_slug->next.
-      slug* temp_slug = domain->top_slug[bin];
-
-      while (temp_slug->next->next != NULL && top >= temp_slug->next->bot)
-        {
-          temp_slug = temp_slug->next;
-        }
-
-      assert(top >= temp_slug->bot && bot <= temp_slug->next->top);
-
-      if (top == temp_slug->bot && bot == temp_slug->next->top)
-        {
-          // Merge the two slugs.
-          temp_slug->bot = temp_slug->next->bot;
-          kill_slug(domain, bin, temp_slug->next);
-        }
-      else if (top == temp_slug->bot)
+      slug* current = (*list);
+      while (current->next != NULL && current->next->bot > (*element)->bot)
         {
-          // Add the water to the bottom of temp_slug.
-          temp_slug->bot = bot;
+          current = current->next;
         }
-      else if (bot == temp_slug->next->top)
+      //found correct insertion point
+      if (current->next != NULL )
         {
-          // Add the water to the top of temp_slug->next.
-          temp_slug->next->top = top;
+          (*element)->next = current->next;
+          current->next->prev = (*element);
+          current->next = (*element);
+          (*element)->prev = current;
         }
       else
         {
-          // Add a new slug in between.
-          error = create_slug_after(domain, bin, temp_slug, top, bot);
+          current->next = (*element);
+          (*element)->prev = current;
+          (*element)->next = NULL;
+          (*end) = (*element);
         }
     }
-
-  return error;
+  return 0;
 }
 
-/* Add water between top and bot to bin.
- * This function assumes that bin is empty from top to bot.
- * Return TRUE if there is an error, FALSE otherwise.
- * If there is an error no water is added.
- *
- * Parameters:
- *
- * domain - A pointer to the t_o_domain struct.
- * bin    - Which bin to put water in.  One based indexing is used.
- * top    - The depth of the top of the region of water to add.
- * bot    - The depth of the bottom of the region of water to add.
- */
-int add_water(t_o_domain* domain, int bin, double top, double bot)
+int
+cut_slugs(t_o_domain* domain, slug* (*all), slug* (*top_list),
+    slug* (*top_list_end), slug* (*bot_list), slug* (*bot_list_end),
+    slug* (*mid_list), slug* (*mid_list_end), int first_bin)
 {
-  int error = FALSE; // Error flag.
-  //FIXME, wencong.
-  assert(NULL != domain && 0 < bin && bin <= domain->parameters->num_bins && domain->surface_front[bin] <= top && top < bot && bot <= domain->layer_bottom_depth);
-
-  if (top == domain->surface_front[bin])
+  int error = FALSE;
+  slug* head = (*all);
+  slug* next;
+  while (head != NULL )
     {
-      // Add the water to the bottom of the surface front water.
-      if (NULL != domain->top_slug[bin])
-        {
-          assert(bot <= domain->top_slug[bin]->top);
-
-          if (bot == domain->top_slug[bin]->top)
-            {
-              // The surface front water has joined with the top slug.
-              domain->surface_front[bin] = domain->top_slug[bin]->bot;
-              kill_slug(domain, bin, domain->top_slug[bin]);
-            }
-          else
-            {
-              domain->surface_front[bin] = bot;
-            }
+      next = head->next;
+      //TODO TRY TO COMBINE SOME OF THESE CASES???
+      if (head->bot <= domain->surface_front[first_bin])
+        { //this entire slug goes into the top list
+          insert_into_list_top_sort(&(*top_list), &(*top_list_end), &head);
         }
-      else if (domain->yes_groundwater)
-        {
-          assert(bot <= domain->groundwater_front[bin]);
-
-          if (bot == domain->groundwater_front[bin])
-            {
-              // The surface front water has joined with the groundwater.
-              // FIXME, wencong, change two 0.0.
-              domain->surface_front[bin]     = domain->layer_top_depth;
-              domain->groundwater_front[bin] = domain->layer_top_depth;
-            }
-          else
-            {
-              domain->surface_front[bin] = bot;
-            }
+      else if(domain->yes_groundwater && head->top >= domain->groundwater_front[first_bin])
+        { //this entire slug goes into the bottom list
+          insert_into_list_bot_sort(&(*bot_list), &(*bot_list_end), &head);
         }
-      else
-        {
-          domain->surface_front[bin] = bot;
+      else if((!domain->yes_groundwater || head->bot <= domain->groundwater_front[first_bin]) && head->top >= domain->surface_front[first_bin])
+        { //this entire slug goes into the middle list
+          insert_into_list_top_sort(&(*mid_list), &(*mid_list_end), &head);
         }
-    } // End add the water to the bottom of the surface front water.
-  else
-    {
-      // Add the water to the groundwater or a slug.
-      if (domain->yes_groundwater)
+      else
         {
-          assert(bot <= domain->groundwater_front[bin]);
-
-          if (bot == domain->groundwater_front[bin])
+          //we have to split the slug up, three cases: top/mid, mid/bot, top/mid/bot
+          if(head->top < domain->surface_front[first_bin] && (!domain->yes_groundwater || head->bot <= domain->groundwater_front[first_bin]))
+            {
+              //hit the top/mid case, create one new slug
+              slug* sl;
+              slug_alloc(&sl, domain->surface_front[first_bin], head->bot);
+              head->bot = sl->top;
+              //put head into top list
+              insert_into_list_top_sort(&(*top_list), &(*top_list_end), &head);
+              //put new slug, sl, into middle list
+              insert_into_list_top_sort(&(*mid_list), &(*mid_list_end), &sl);
+            }
+          else if((domain->yes_groundwater && head->bot > domain->groundwater_front[first_bin]) && head->top >= domain->surface_front[first_bin])
             {
-              // Add the water to the top of the groundwater.
-              if (NULL != domain->bot_slug[bin])
-                {
-                  assert(top >= domain->bot_slug[bin]->bot);
-
-                  if (top == domain->bot_slug[bin]->bot)
-                    {
-                      // The groundwater has joined with the bottom slug.
-                      domain->groundwater_front[bin] = domain->bot_slug[bin]->top;
-                      kill_slug(domain, bin, domain->bot_slug[bin]);
-                    }
-                  else
-                    {
-                      domain->groundwater_front[bin] = top;
-                    }
-                }
-              else
+              //hit the mid/bot case, create one new slug
+              slug* sl;
+              if(slug_alloc(&sl, head->top, domain->groundwater_front[first_bin]))
                 {
-                  domain->groundwater_front[bin] = top;
+                  error = TRUE;
+                  break;
                 }
+              head->top = sl->bot;
+              //put head into bot list
+              insert_into_list_bot_sort(&(*bot_list), &(*bot_list_end), &head);
+              //put new slug, sl, into middle list
+              insert_into_list_top_sort(&(*mid_list), &(*mid_list_end), &sl);
             }
-          else // The bottom of the water we are adding is not touching groundwater.
+          else if(head->top < domain->surface_front[first_bin] && (domain->yes_groundwater && head->bot > domain->groundwater_front[first_bin]))
             {
-              // Add the water to a slug.
-              error = add_water_to_slug(domain, bin, top, bot);
+              //hit the top/mid/bot case, create two new slugs
+              slug* new_t;
+              slug* new_b;
+              slug_alloc(&new_t, head->top, domain->surface_front[first_bin]);
+              slug_alloc(&new_b, domain->groundwater_front[first_bin], head->bot);
+              head->top = new_t->bot;
+              head->bot = new_b->top;
+
+              //put new_t into top list
+              insert_into_list_top_sort(&(*top_list), &(*top_list_end), &new_t);
+              //put head into middle list
+              insert_into_list_top_sort(&(*mid_list), &(*mid_list_end), &head);
+              //put new_b into bottom list
+              insert_into_list_bot_sort(&(*bot_list), &(*bot_list_end), &new_b);
+            }
+          else
+            {
+              assert(FALSE); //should never get to this case!
             }
         }
-      else // domain->yes_groundwater is FALSE
-        {
-          // Add the water to a slug.
-          error = add_water_to_slug(domain, bin, top, bot);
-        }
-    } // End add the water to the groundwater or a slug.
-
+      head = next;
+    }
   return error;
 }
 
-/* Move the water between top and bot from from_bin to to_bin.
- * This function assumes that from_bin has water from top to bot
- * and that to_bin is empty from top to bot.
- * Return TRUE if there is an error, FALSE otherwise.
- * If there is an error it might be that no water is moved, but
- * it is also possible that water is removed from from_bin and errors
- * prevent it from being put either into to_bin or back into from_bin.
- *
- * Parameters:
- *
- * domain   - A pointer to the t_o_domain struct.
- * from_bin - Which bin to take water from.  One based indexing is used.
- * to_bin   - Which bin to put water in.  One based indexing is used.
- * top      - The depth of the top of the region of water to move.
- * bot      - The depth of the bottom of the region of water to move.
+/* Helper function to deal with merging of ground and surface
+ * fronts
  */
-int move_water(t_o_domain* domain, int from_bin, int to_bin, double top, double bot)
+int
+find_collisions(t_o_domain* domain, slug* (*top_list), slug* (*top_list_end),
+    slug* (*bot_list), slug* (*bot_list_end), slug* (*mid_list),
+    slug* (*mid_list_end), int *first_bin)
 {
-  int error = FALSE; // Error flag.
- 
-  // FIXME, wencong.
-  assert(NULL != domain && 0 < from_bin && from_bin <= domain->parameters->num_bins && 0 < to_bin && to_bin <= domain->parameters->num_bins &&
-      from_bin != to_bin && domain->layer_top_depth <= top && top < bot && bot <= domain->layer_bottom_depth && 
-      has_water_at_depth(domain, from_bin, top, bot) && !has_water_at_depth(domain, to_bin, top, bot));
-
-  error = remove_water(domain, from_bin, top, bot);
-
-  if (!error)
+  int error = FALSE;
+  int i;
+  int new_first_bin = *first_bin;
+  //Find the first non overlapping bin to pass to cut slugs
+  for(i = *first_bin; i <= domain->parameters->num_bins; i++)
     {
-      error = add_water(domain, to_bin, top, bot);
+      if(domain->surface_front[i] < domain->groundwater_front[i])
+        {
+          new_first_bin = i;
+          break;
+        }
+    }
 
-      if (error)
+  for (i = *first_bin; i <= domain->parameters->num_bins; i++)
+    {
+      if (domain->surface_front[i] > domain->groundwater_front[i])
         {
-          // Put the water back.
-          if (add_water(domain, from_bin, top, bot))
+          //We have overlapping water, create slug
+          slug* sl;
+          if(slug_alloc(&sl, domain->groundwater_front[i], domain->surface_front[i]))
             {
-              // Can't put the water anywhere.
-              fprintf(stderr, "ERROR: Lost water in move_water.\n");
+              error = TRUE;
+              break;
             }
+          cut_slugs(domain, &sl, &(*top_list),
+              &(*top_list_end), &(*bot_list), &(*bot_list_end), &(*mid_list),
+              &(*mid_list_end), new_first_bin);
+
+          //SLUGS ARE CREATED, UPDATE FRONTS TO SHOW FULL BIN
+          domain->surface_front[i]     = domain->layer_top_depth;
+          domain->groundwater_front[i] = domain->layer_top_depth;
+        }
+      else if (domain->surface_front[i] == domain->groundwater_front[i])
+        {
+          //if the ground and surface are exactly equal, no slug is created,
+          //but need to "fill" the bin
+          domain->surface_front[i]     = domain->layer_top_depth;
+          domain->groundwater_front[i] = domain->layer_top_depth;
+        }
+      else
+        {
+          break;
         }
     }
-
+  *first_bin = new_first_bin;
   return error;
 }
 
-/* This is an old, slower way of doing redistribution.  It is kept around
- * to check the correctness of the new redistribution algorithm.
- * It should be a drop-in replacement for redistribute().
- * See the comment of redistribute() for more details.
- *
- * Algorithm:
- *
- * top       - The top of the depth range currently being processed.
- * bot       - The bottom of the depth range currently being processed.
- *             top and bot will start at the surface and walk down the
- *             entire depth of the domain.
- * has_water - An array of flags, one per bin, representing whether that bin
- *             has water between top and bot.
- * flip      - An array of doubles, one per bin, representing the next depth
- *             at which the bin will flip the value of its has_water flag.
- *
- * Initialize top and bot to zero.
- * Initialize has_water to whether each bin has water at depth zero.
- * Initialize flip to the first depth where a bin flips whether it has water.
- *   This depth may be domain->full_depth if the bin never flips.
- *
- * Do
- *   Set top = bot.
- *   Set bot to the smallest value in flip.
- *   All bins are either entirely wet or entirely dry between top and bot.
- *   Do
- *     Move the water between top and bot from the rightmost bin
- *       that is wet to the leftmost bin that is dry.
- *   Until there is no wet bin to the right of a dry bin.
- *   For all bins where flip == bot:
- *     Flip the has_water flag.
- *     Find the next lower flip, may be domain->full_depth.
- * until bot == domain->full_depth.
- *
- * Parameters:
- *
- * domain - A pointer to the t_o_domain struct.
- */
-int redistribute_slow(t_o_domain* domain)
+int t_o_redistribute_list_sort(t_o_domain* domain, int first_bin)
 {
-  int    error = FALSE; // Error flag.
-  int    ii;            // Loop counter.
-  double top = 0.0;     // The top of the slice being processed.
-  double bot = 0.0;     // The bottom of the slice being processed.
+  //OPTIMIZATION, ONLY SORT FROM FIRST NON-ZERO BIN ONWARDS
+  //ADDITIONALLY, ONLY NEED TO REDISTRIBUTE SLUGS FROM FIRST NON-ZERO BINS
+  //TODO IF WE KNOW LAST BIN, WE ONLY HAVE TO SORT BETWEEN FIRST AND LAST BIN.
+  int error = FALSE;
+  int i;
+  int old_first_bin = first_bin;
 
-  if (NULL == domain)
+  //All bins are full, no redistribution necessary
+  if (first_bin > domain->parameters->num_bins)
     {
-      fprintf(stderr, "ERROR: domain must not be NULL\n");
-      error = TRUE;
+      return 0;
+    }
+  //First sort the surface_front bins
+  //TODO TRY MERGE SORT
+  qsort((domain->surface_front) + first_bin,
+      domain->parameters->num_bins - first_bin + 1,
+      sizeof(*(domain->surface_front)), (void *) compare_surface);
+  //Then sort the groundwater_front bins
+  if(domain->yes_groundwater)
+    {
+      qsort((domain->groundwater_front) + first_bin,
+          domain->parameters->num_bins - first_bin + 1,
+          sizeof(*(domain->groundwater_front)), (void *) compare_ground);
     }
+  //Redistribute slugs
+  //This requires finding all slugs that exist in the domain
+  //and combining them with slugs from the collision of
+  //groundwater and surfacewater
 
-  // has_water[ii] is TRUE if bin ii has water between top and bot.
-  int has_water[domain->parameters->num_bins + 1];
+  slug* slugs_head = NULL; // The head of a doubly linked list of slugs to insert into the domain.
+  slug* slugs_end = NULL; // The tail of a doubly linked list of slugs to insert into the domain.
 
-  // flip[ii] is the depth at which has_water[ii] will next change or
-  // domain->layer_depth if has_water[ii] will never change again.
-  double flip[domain->parameters->num_bins + 1];
+  slug* slugs_top = NULL;
+  slug* slugs_top_end = NULL;
+  slug* slugs_bot = NULL;
+  slug* slugs_bot_end = NULL;
+  slug* slugs_mid = NULL;
+  slug* slugs_mid_end = NULL;
 
-  // Fill in has_water and flip.
-  if (!error)
+  if(domain->yes_groundwater && domain->surface_front[first_bin] != domain->layer_top_depth)
     {
-      for (ii = 1; ii <= domain->parameters->num_bins; ii++)
-        {
-          // FIXME, wencong, change the following 0.0??
-          has_water[ii] = has_water_at_depth(domain, ii, 0.0, 0.0);
-          flip[ii]      = next_flip(domain, ii, 0.0);
-        }
+      error = find_collisions(domain, &slugs_top, &slugs_top_end, &slugs_bot,
+          &slugs_bot_end, &slugs_mid, &slugs_mid_end, &first_bin);
     }
-
-  // Walk down the entire depth of the domain.
-  // FIXME, wencong.
-  while (!error && bot < domain->layer_bottom_depth)
+  if(!error)
     {
-      // Set top to bot and bot to the closest flip.
-      top = bot;
-      bot = flip[1];
-
-      for (ii = 2; ii <= domain->parameters->num_bins; ii++)
+      //need to use old first bin here in case there were slugs in a bin that was filled
+      //by find_collisions
+      for (i = domain->parameters->num_bins; i >= old_first_bin; i--)
         {
-          if (bot > flip[ii])
+          if (domain->top_slug[i] != NULL )
             {
-              bot = flip[ii];
+              slug* next = domain->top_slug[i];
+              slug* tmp;
+              while (next != NULL )
+                {
+                  tmp = next->next;
+                  //TODO POSSIBLE OPTIMIZATION, CALL CUT_SLUGS ON EACH SLUG
+                  //AS IT IS FOUND, AND INSERT INSIDE CUT_SLUGS
+                  //FIXME DOING THIS OPTIMIZTION RESULTS IN A BUG??? AN INFINITE LOOP SOMEWHERE
+                  insert_into_list_top_sort(&slugs_head, &slugs_end, &next);
+                  next = tmp;
+                }
+              clear_bin_slugs(domain, i);
             }
         }
 
-      assert(bot > top);
-
-      // At this point all bins are either entirely wet
-      // or entirely dry between top and bot.
-
-      // Find the right most wet bin and the leftmost dry bin
-      // and move the water from the wet bin to the dry bin.
-      // Repeat until there are no wet bins to the right of a dry bin.
-      int right_bin = domain->parameters->num_bins;
-      int left_bin  = 1;
+      //put all the slugs in their appropriate "sections"
+      error = cut_slugs(domain, &slugs_head, &(slugs_top),
+          &(slugs_top_end), &(slugs_bot), &(slugs_bot_end), &(slugs_mid),
+          &(slugs_mid_end), first_bin);
 
-      while (!error && right_bin > left_bin)
+      //We can now start to redistribute the slugs
+      if(!error)
         {
-          if (!has_water[right_bin])
-            {
-              right_bin--;
-            }
-          else if (has_water[left_bin])
+          //we redistribute in this order so that we only need to check collisions
+          //for middle slugs...
+          error = redistribute_top_slugs(domain, &slugs_top, &slugs_top_end, first_bin, first_bin);
+          if(!error && domain->yes_groundwater)
             {
-              left_bin++;
+              error = redistribute_bot_slugs(domain, &slugs_bot, &slugs_bot_end, first_bin, first_bin);
             }
           else
             {
-              error = move_water(domain, right_bin, left_bin, top, bot);
-              right_bin--;
-              left_bin++;
+              assert(error || slugs_bot == NULL);
             }
-        }
-
-      // Flip has_water flag for bins that flip at bot.
-      if (!error)
-        {
-          for (ii = 1; ii <= domain->parameters->num_bins; ii++)
+          if(!error)
             {
-              if (bot == flip[ii])
-                {
-                  has_water[ii] = !has_water[ii];
-                  flip[ii] = next_flip(domain, ii, bot);
-                }
+              error = redistribute_mid_slugs(domain, &slugs_mid, &slugs_mid_end, first_bin, first_bin);
             }
         }
     }
-
   return error;
 }
 
@@ -3978,18 +10428,18 @@ void t_o_add_groundwater_slow(t_o_domain* domain, double* groundwater_recharge)
                     {
                       // Groundwater hits the surface front.
                       // FIXME, wencong, change two 0.0.
-                      domain->groundwater_front[ii] = domain->layer_top_depth;
-                      domain->surface_front[ii]     = domain->layer_top_depth;
+                      set_groundwater_front(domain, ii, domain->layer_top_depth);
+                      set_surface_front(domain, ii, domain->layer_top_depth);
                     }
                   else if (NULL != domain->bot_slug[ii] && domain->bot_slug[ii]->bot == depth_to_move_to)
                     {
                       // Groundwater hits a slug.
-                      domain->groundwater_front[ii] = domain->bot_slug[ii]->top;
+                      set_groundwater_front(domain, ii, domain->bot_slug[ii]->top);
                       kill_slug(domain, ii, domain->bot_slug[ii]);
                     }
                   else
                     {
-                      domain->groundwater_front[ii] = depth_to_move_to;
+                      set_groundwater_front(domain, ii, depth_to_move_to);
                     }
                 }
             }
@@ -4001,6 +10451,234 @@ void t_o_add_groundwater_slow(t_o_domain* domain, double* groundwater_recharge)
     }
 }
 
+   /*********************************************************************************/
+  /* The code below is for an old version of t_o_falling_slugs.  It is only kept   */
+ /*  around to check the correctness of the new version of t_o_falling_slugs.     */
+/*********************************************************************************/
+
+void slug_fall_distance_slow(t_o_domain* domain, int bin, int first_bin, double dt, slug* falling_slug, double* top_distance, double* bot_distance)
+{
+  int   ii;        // Loop counter.
+  slug* temp_slug; // Used to search for connected slugs.
+
+  assert(NULL != domain && 0 < bin && bin <= domain->parameters->num_bins && 0 < first_bin && first_bin <= domain->parameters->num_bins &&
+      0.0 < dt && NULL != falling_slug && NULL != top_distance && NULL != bot_distance);
+
+  // find the capillary suction of the rightmost bin with a connected slug that this slug can steal water from.
+  ii = domain->parameters->num_bins;
+
+  do
+    {
+      temp_slug = domain->top_slug[ii];
+
+      while (NULL != temp_slug && !(falling_slug->top <= temp_slug->bot && falling_slug->bot >= temp_slug->top))
+        {
+          if (falling_slug->bot < temp_slug->top)
+            {
+              temp_slug = NULL;
+            }
+          else
+            {
+              temp_slug = temp_slug->next;
+            }
+        }
+
+      if (NULL == temp_slug)
+        {
+          ii--;
+        }
+    }
+  while (ii > bin && NULL == temp_slug);
+
+  double distance = ((domain->parameters->cumulative_conductivity[bin] - domain->parameters->cumulative_conductivity[bin - 1]) /
+      domain->parameters->delta_water_content) * dt;
+
+  double growth;
+
+  if (ii <= bin)
+    {
+      growth = 0.0;
+    }
+  else
+    {
+      growth = ((domain->parameters->cumulative_conductivity[bin] - domain->parameters->cumulative_conductivity[first_bin - 1]) /
+          (domain->parameters->bin_water_content[bin] - domain->parameters->bin_water_content[first_bin - 1])) *
+              ((domain->parameters->bin_capillary_suction[bin] - domain->parameters->bin_capillary_suction[ii]) /
+                  ((falling_slug->bot - falling_slug->top) / 2.0)) * dt;
+    }
+
+  *top_distance = distance - growth;
+  *bot_distance = distance + growth;
+}
+
+int t_o_falling_slugs_slow(t_o_domain* domain, double dt, int first_bin, double* groundwater_recharge)
+{
+  assert(NULL != domain && 0.0 < dt && NULL != groundwater_recharge);
+
+  int error = FALSE; // Error flag.
+  int ii;            // Loop counter.
+
+  // Process all bins except bin 1, which is guaranteed to be completely full of water and thus have no slugs.
+  for (ii = 2; ii <= domain->parameters->num_bins; ii++)
+    {
+      // Process the slugs from bottom up.
+      slug* temp_slug = domain->bot_slug[ii];
+
+      while (NULL != temp_slug)
+        {
+          double top_delta_z; // The distance the top    of the slug will move.
+          double bot_delta_z; // The distance the bottom of the slug will move.
+
+          // Calculate the distance the slug will move this timestep.
+          slug_fall_distance_slow(domain, ii, first_bin, dt, temp_slug, &top_delta_z, &bot_delta_z);
+
+          // FIXME deal with this
+          // Prevent the slug from moving upward.
+          if (0.0 >= top_delta_z)
+            {
+              top_delta_z = 0.000001;
+            }
+
+          if (0.0 >= bot_delta_z)
+            {
+              bot_delta_z = 0.000001;
+            }
+
+          // Stop the slug if it hits a lower slug or groundwater.
+          if (NULL != temp_slug->next)
+            {
+              if (bot_delta_z > temp_slug->next->top - temp_slug->bot)
+                {
+                  bot_delta_z = temp_slug->next->top - temp_slug->bot;
+                }
+            }
+          else if (domain->yes_groundwater)
+            {
+              if (bot_delta_z > domain->groundwater_front[ii] - temp_slug->bot)
+                {
+                  bot_delta_z = domain->groundwater_front[ii] - temp_slug->bot;
+                }
+            }
+
+          // Prevent the slug from shrinking.
+          if (top_delta_z > bot_delta_z)
+            {
+              top_delta_z = bot_delta_z;
+            }
+
+          // If the slug grows, steal the water from the rightmost overlapping slug, and the topmost if there are multiple rightmost.
+          // FIXME steal from all connected slugs to the right with weights.
+          double demand   = bot_delta_z - top_delta_z;    // Needed water in meters of bin depth.
+          int    get_bin  = domain->parameters->num_bins; // Which bin  to try to get from.
+          slug*  get_slug = domain->top_slug[get_bin];    // Which slug to try to get from.
+
+          while (0.0 < demand && ii < get_bin)
+            {
+              while (0.0 < demand && NULL != get_slug && temp_slug->bot >= get_slug->top)
+                {
+                  // Save a pointer to the slug below get_slug in case we need to kill get_slug.
+                  slug* next_slug = get_slug->next;
+
+                  if (temp_slug->top <= get_slug->bot && temp_slug->bot >= get_slug->top)
+                    {
+                      // We can get water from get_slug.
+                      if (get_slug->bot - get_slug->top >= demand)
+                        {
+                          // FIXLATER more complicated than taking equally from top and bot?
+                          set_slug_top(domain, get_bin, get_slug, get_slug->top + demand / 2.0);
+                          set_slug_bot(domain, get_bin, get_slug, get_slug->bot - demand / 2.0);
+                          demand = 0.0;
+                        }
+                      else
+                        {
+                          demand -= get_slug->bot - get_slug->top;
+                          kill_slug(domain, get_bin, get_slug);
+                        }
+                    }
+
+                  get_slug = next_slug;
+                }
+
+              get_bin--;
+              get_slug = domain->top_slug[get_bin];
+            }
+
+          // If we couldn't get all of the desired water take the deficit equally from the top and bottom of where the slug wants to be.
+          // FIXLATER more complicated than taking equally from top and bot?
+          if (0.0 < demand)
+            {
+              top_delta_z += demand / 2.0;
+              bot_delta_z -= demand / 2.0;
+            }
+
+          // Save a pointer to the slug above temp_slug in case we need to kill temp_slug.
+          slug* prev_slug = temp_slug->prev;
+
+          if (NULL == temp_slug->next)
+            {
+              // The bottom slug might hit the groundwater or fall beyond layer_depth.
+              if (domain->yes_groundwater)
+                {
+                  if (temp_slug->bot + bot_delta_z >= domain->groundwater_front[ii])
+                    {
+                      // The slug hits groundwater.
+                      set_groundwater_front(domain, ii, domain->groundwater_front[ii] - ((temp_slug->bot + bot_delta_z) - (temp_slug->top + top_delta_z)));
+                      kill_slug(domain, ii, temp_slug);
+                    }
+                  else
+                    {
+                      // Advance the slug.
+                      set_slug_top(domain, ii, temp_slug, temp_slug->top + top_delta_z);
+                      set_slug_bot(domain, ii, temp_slug, temp_slug->bot + bot_delta_z);
+                    }
+                }
+              else
+                {
+                  if (temp_slug->top + top_delta_z >= domain->layer_bottom_depth)
+                    {
+                      // The slug falls entirely past layer_depth.
+                      *groundwater_recharge += ((temp_slug->bot + bot_delta_z) - (temp_slug->top + top_delta_z)) * domain->parameters->delta_water_content;
+                      kill_slug(domain, ii, temp_slug);
+                    }
+                  else if (temp_slug->bot + bot_delta_z > domain->layer_bottom_depth)
+                    {
+                      // The slug falls partially past layer depth.
+                      *groundwater_recharge += (temp_slug->bot + bot_delta_z - domain->layer_bottom_depth) * domain->parameters->delta_water_content;
+                      set_slug_top(domain, ii, temp_slug, temp_slug->top + top_delta_z);
+                      set_slug_bot(domain, ii, temp_slug, domain->layer_bottom_depth);
+                    }
+                  else
+                    {
+                      // Advance the slug.
+                      set_slug_top(domain, ii, temp_slug, temp_slug->top + top_delta_z);
+                      set_slug_bot(domain, ii, temp_slug, temp_slug->bot + bot_delta_z);
+                    }
+                }
+            }
+          else
+            {
+              // A middle slug might hit the slug below it.
+              if (temp_slug->bot + bot_delta_z >= temp_slug->next->top)
+                {
+                  // The slug hits the slug below it.
+                  set_slug_top(domain, ii, temp_slug->next, temp_slug->next->top - ((temp_slug->bot + bot_delta_z) - (temp_slug->top + top_delta_z)));
+                  kill_slug(domain, ii, temp_slug);
+                }
+              else
+                {
+                  // Advance the slug.
+                  set_slug_top(domain, ii, temp_slug, temp_slug->top + top_delta_z);
+                  set_slug_bot(domain, ii, temp_slug, temp_slug->bot + bot_delta_z);
+                }
+            }
+
+          temp_slug = prev_slug;
+        } // End while (NULL != temp_slug).
+    } // End for (ii = 2; ii <= domain->parameters->num_bins; ii++).
+
+  return error;
+}
+
    /*******************************************************************************/
   /* The code below is for debugging only.  It compares two Talbot-Ogden domains */
  /*  to see if they are equal to test that two implementations are equivalent.  */
@@ -4023,7 +10701,7 @@ int t_o_domains_equal(t_o_domain* domain1, t_o_domain* domain2)
           domain1->parameters->bc_psib                     == domain2->parameters->bc_psib                     &&
           domain1->parameters->delta_water_content         == domain2->parameters->delta_water_content         &&
           domain1->parameters->effective_capillary_suction == domain2->parameters->effective_capillary_suction &&
-          domain1->parameters->dry_depth_dt                == domain2->parameters->dry_depth_dt;
+          domain1->parameters->dry_depth_cache->dt         == domain2->parameters->dry_depth_cache->dt;
     }
 
   for (ii = 1; equal && ii <= domain1->parameters->num_bins; ii++)
@@ -4031,7 +10709,7 @@ int t_o_domains_equal(t_o_domain* domain1, t_o_domain* domain2)
       equal = domain1->parameters->bin_water_content[ii]       == domain2->parameters->bin_water_content[ii]       &&
           domain1->parameters->cumulative_conductivity[ii] == domain2->parameters->cumulative_conductivity[ii] &&
           domain1->parameters->bin_capillary_suction[ii]   == domain2->parameters->bin_capillary_suction[ii]   &&
-          domain1->parameters->bin_dry_depth[ii]           == domain2->parameters->bin_dry_depth[ii];
+          domain1->parameters->dry_depth_cache->bin_dry_depth[ii] == domain2->parameters->dry_depth_cache->bin_dry_depth[ii];
     }
 
   // Test if scalars are equal
@@ -4204,7 +10882,7 @@ int t_o_ET(t_o_domain* domain, double dt, double root_depth, double PET, double
           if (domain->surface_front[ii] - domain->layer_top_depth <= bin_demand_ET_dz)
             { // Water in a bin is less than demand, remove all.
               *evaporated_water        += (domain->surface_front[ii] - domain->layer_top_depth) * domain->parameters->delta_water_content;
-              domain->surface_front[ii] = domain->layer_top_depth;
+              set_surface_front(domain, ii, domain->layer_top_depth);
               demand_ET_dz             -= (domain->surface_front[ii] - domain->layer_top_depth);
             }
           else
@@ -4214,9 +10892,9 @@ int t_o_ET(t_o_domain* domain, double dt, double root_depth, double PET, double
                 {
                   if (domain->top_slug[ii]->top + bin_demand_ET_dz < domain->top_slug[ii]->bot)
                     {
-                      *evaporated_water         += bin_demand_ET_dz * domain->parameters->delta_water_content;
-                      domain->top_slug[ii]->top += bin_demand_ET_dz;
-                      demand_ET_dz              -= bin_demand_ET_dz;
+                      *evaporated_water += bin_demand_ET_dz * domain->parameters->delta_water_content;
+                      demand_ET_dz      -= bin_demand_ET_dz;
+                      set_slug_top(domain, ii, domain->top_slug[ii], domain->top_slug[ii]->top + bin_demand_ET_dz);
                     }
                 }
             }
@@ -4244,8 +10922,8 @@ int t_o_ET(t_o_domain* domain, double dt, double root_depth, double PET, double
           else
             {
               *evaporated_water += bin_demand_ET_dz * domain->parameters->delta_water_content;
-              temp_slug->top    += bin_demand_ET_dz;
               demand_ET_dz      -= bin_demand_ET_dz;
+              set_slug_top(domain, ii, temp_slug, temp_slug->top + bin_demand_ET_dz);
               break;
             }
           temp_slug = next_slug;
@@ -4265,7 +10943,7 @@ int t_o_ET(t_o_domain* domain, double dt, double root_depth, double PET, double
               // Modified Feb, 09, 2015. Originaly outside the loop and it was wrong.
               demand_ET_dz                  -= bin_demand_ET_dz;
               *evaporated_water             += bin_demand_ET_dz * domain->parameters->delta_water_content;
-              domain->groundwater_front[ii] += bin_demand_ET_dz;
+              set_groundwater_front(domain, ii, domain->groundwater_front[ii] + bin_demand_ET_dz);
             }
         }
        
@@ -2,6 +2,32 @@
 #define T_O_H
 
 #include <pthread.h>
+#include <stdatomic.h>
+#include "memfunc.h"
+
+// Integrators for the rate equations of the surface and groundwater fronts.  See t_o_set_integrator.
+#define T_O_INTEGRATOR_EULER      (0) // Explicit forward Euler.  The default.
+#define T_O_INTEGRATOR_RK4        (1) // Classical fourth order Runge-Kutta.
+#define T_O_INTEGRATOR_GREEN_AMPT (2) // The Green-Ampt solution of the rate equation integrated exactly over the timestep.
+
+// Ways to redistribute water sideways at the end of each timestep.  See t_o_set_redistribution.
+#define T_O_REDISTRIBUTE_SLUGS     (0) // Sort the fronts and place again the slugs of the bins that changed.  The default.
+#define T_O_REDISTRIBUTE_STAIRCASE (1) // Convert the domain to a t_o_staircase and back.
+
+/* A t_o_dry_depth_cache struct is an immutable snapshot of the dry depth of
+ * every bin for one timestep duration.  Once a snapshot is published in a
+ * t_o_parameters struct it is never modified so threads can read it without
+ * locking.  A larger timestep publishes a new snapshot that replaces it.
+ */
+typedef struct t_o_dry_depth_cache t_o_dry_depth_cache;
+struct t_o_dry_depth_cache
+{
+  double               dt;            // The timestep in seconds used to calculate the values in bin_dry_depth.
+  double*              bin_dry_depth; // The dry depth of each bin in meters for a timestep of dt. This can be used as an exact value of the dry
+                                      // depth for that timestep and an upper bound of the dry depth for smaller timesteps.
+  t_o_dry_depth_cache* older;         // The snapshot this one replaced or NULL if this is the first one.  Old snapshots are kept until the
+                                      // t_o_parameters struct is deallocated because other threads might still be reading them.
+};
 
 /* A t_o_parameters struct stores constant soil parameters for a Talbot-Ogden
  * domain.  It is pulled out as a separate struct from t_o_domain because
@@ -9,24 +35,30 @@
  */
 typedef struct
 {
-  int             num_bins;                    // The number of bins.
-  double          vg_alpha;                    // Van Genutchen parameter in one over meters.
-  double          vg_n;                        // Van Genutchen parameter.
-  double          bc_lambda;                   // Brook-Corey parameter.
-  double          bc_psib;                     // Brook-Corey parameter in meters.
-  double          delta_water_content;         // The water content width of each bin as a unitless fraction.
-  double*         bin_water_content;           // 1D array containing the water content of each bin as a unitless fraction.
-                                               // Varies between residual saturation and porosity.
-  double*         cumulative_conductivity;     // 1D array. cumulative_conductivity[ii] contains the total conductivity of all bins up to and including bin ii
-                                               // in units of meters of water per second.
-  double          effective_capillary_suction; // The minimum value to use for bin_capilary_suction[last_bin] in the infiltrate_distance calculation.
-  double*         bin_capillary_suction;       // The capillary suction head of each bin in meters.
-  double          dry_depth_dt;                // The timestep in seconds used to calculate the values in bin_dry_depth.
-  double*         bin_dry_depth;               // The dry depth of each bin in meters for a timestep of dry_depth_dt. This can be used as an exact value of the dry
-                                               // depth for that timestep and an upper bound of the dry depth for smaller timesteps.
-  pthread_mutex_t dry_depth_mutex;             // For thread-safe access to dry depth in shared parameters structures.
-                                               // If THREAD_SAFE is not defined then this is uninitialized and unused.
-  int             dry_depth_mutex_initialized; // Flag so that we know whether to destroy the mutex.
+  int                          num_bins;                    // The number of bins.
+  double                       vg_alpha;                    // Van Genutchen parameter in one over meters.
+  double                       vg_n;                        // Van Genutchen parameter.
+  double                       bc_lambda;                   // Brook-Corey parameter.
+  double                       bc_psib;                     // Brook-Corey parameter in meters.
+  double                       delta_water_content;         // The water content width of each bin as a unitless fraction.
+  double*                      bin_water_content;           // 1D array containing the water content of each bin as a unitless fraction.
+                                                            // Varies between residual saturation and porosity.
+  double*                      cumulative_conductivity;     // 1D array. cumulative_conductivity[ii] contains the total conductivity of all bins up to and including bin ii
+                                                            // in units of meters of water per second.
+  double                       effective_capillary_suction; // The minimum value to use for bin_capilary_suction[last_bin] in the infiltrate_distance calculation.
+  double*                      bin_capillary_suction;       // The capillary suction head of each bin in meters.
+  int                          dry_depth_table_size;        // The number of timesteps in the dry depth table grid.
+  double*                      dry_depth_table_dt;          // 1D array of dry_depth_table_size log spaced timesteps in seconds with one based indexing.
+  double*                      dry_depth_table_green_ampt;  // 1D array of the unclamped Green-Ampt dry depth in meters at each grid timestep.
+                                                            // Ten times this is the maximum dry depth clamp.
+  double**                     dry_depth_table;             // 2D array. dry_depth_table[jj][ii] is the unclamped dry depth of bin ii in meters for a timestep
+                                                            // of dry_depth_table_dt[jj].  Used to interpolate dry depths for timesteps within the grid.
+  double                       dry_depth_table_error_bound; // Guaranteed bound on the relative error of the interpolated dry depths as a unitless fraction.
+  t_o_dry_depth_cache* _Atomic dry_depth_cache;             // The current dry depth snapshot.  Never NULL after t_o_parameters_alloc succeeds.
+                                                            // Readers load it atomically without locking.
+  pthread_mutex_t              dry_depth_mutex;             // Serializes threads publishing a new dry depth snapshot in shared parameters structures.
+                                                            // If THREAD_SAFE is not defined then this is uninitialized and unused.
+  int                          dry_depth_mutex_initialized; // Flag so that we know whether to destroy the mutex.
 } t_o_parameters;
 
 // FIXLATER possible optimization: Rather than searching for slugs to the left or right in contact with a given slug store pointers to them.
@@ -36,12 +68,79 @@ typedef struct
 typedef struct slug slug;
 struct slug
 {
-  slug*  prev; // The slug next closer to the surface or NULL if this is the top slug.
-  slug*  next; // The slug next closer to the bottom  or NULL if this is the bottom slug.
-  double top;  // The depth of the top of the slug in meters.
-  double bot;  // The depth of the bottom of the slug in meters.
+  slug*  prev;       // The slug next closer to the surface or NULL if this is the top slug.
+  slug*  next;       // The slug next closer to the bottom  or NULL if this is the bottom slug.
+  double top;        // The depth of the top of the slug in meters.
+  double bot;        // The depth of the bottom of the slug in meters.
+#ifdef SLUG_SPANS
+  int    span_index; // The index of the slug in the slug_span of its bin or -1 if it is not in a bin.
+#endif // SLUG_SPANS
 };
 
+#ifdef SLUG_SPANS
+#define SLUG_SPAN_INLINE_CAPACITY (4) // The number of slugs a slug_span holds before it spills to allocated arrays.
+
+/* If SLUG_SPANS is defined, for example with -DSLUG_SPANS, each bin also
+ * stores the depths of its slugs in a slug_span struct: contiguous top and bot
+ * arrays in the same order as the linked list.  t_o.c and every file that
+ * includes t_o.h must be compiled with the same setting.  The spans are kept
+ * in step with the lists by create_slug_after, kill_slug, detach_slug, and the
+ * other slug accessors in t_o.c, so walks that only read depths, such as
+ * t_o_total_water_in_domain, do not have to chase pointers.
+ */
+typedef struct
+{
+  int     num_slugs;                             // The number of slugs in the bin.
+  int     capacity;                              // The number of elements of top and bot.
+  double* top;                                   // 1D array of the depth of the top of each slug in meters with zero based indexing.
+                                                 // Points to inline_top until the span spills.
+  double* bot;                                   // 1D array of the depth of the bottom of each slug in meters with zero based indexing.
+                                                 // Points to inline_bot until the span spills.
+  double  inline_top[SLUG_SPAN_INLINE_CAPACITY]; // Storage for top in bins with few slugs.
+  double  inline_bot[SLUG_SPAN_INLINE_CAPACITY]; // Storage for bot in bins with few slugs.
+} slug_span;
+#endif // SLUG_SPANS
+
+/* A t_o_statistics struct stores counters of the work done on a single
+ * Talbot-Ogden domain.  The counters are cumulative since the domain was
+ * allocated or t_o_reset_statistics was last called except for the ones
+ * named last that only cover the most recent timestep.  They are not part
+ * of the state of the domain and are ignored when comparing domains.
+ */
+typedef struct
+{
+  long long num_front_sorts;              // The number of times the surface and groundwater fronts were re-sorted.
+  long long surface_front_moved;          // The number of surface_front elements whose value changed when re-sorting.
+  long long groundwater_front_moved;      // The number of groundwater_front elements whose value changed when re-sorting.
+  int       last_surface_front_moved;     // surface_front_moved for the most recent re-sort.
+  int       last_groundwater_front_moved; // groundwater_front_moved for the most recent re-sort.
+  long long num_quiescent_timesteps;      // The number of timesteps that found the domain quiescent and only moved groundwater.
+  long long num_fast_forwards;            // The number of calls to t_o_fast_forward.
+  double    fast_forward_time;            // The total duration of the calls to t_o_fast_forward in seconds.
+  long long num_multirate_steps;          // The number of outer steps of t_o_timestep_multirate.
+  long long num_multirate_substeps;       // The number of infiltration and falling slug sub-steps of t_o_timestep_multirate.
+  long long num_redistribute_skipped;     // The number of redistributions that found nothing out of order.
+  long long num_redistribute_fronts_only; // The number of redistributions that only had to sort the fronts.
+  long long num_redistribute_local;       // The number of redistributions that placed again only the slugs from a bin right of first_bin on
+                                          // because water was out of order only right of first_bin.
+  long long num_redistribute_full;        // The number of redistributions that placed again every slug from first_bin on because water was out
+                                          // of order in first_bin or surface water reached groundwater.
+} t_o_statistics;
+
+/* A t_o_dirty_range struct stores the bins and depths of a Talbot-Ogden
+ * domain where water was added or removed since the domain was last
+ * redistributed.  Outside of it the water is still in the order
+ * t_o_redistribute left it in, so t_o_redistribute only looks for water out
+ * of order inside it.  It is not part of the state of the domain.
+ */
+typedef struct
+{
+  int    first_bin; // The leftmost  bin where water changed or num_bins + 1 if none did.
+  int    last_bin;  // The rightmost bin where water changed or zero if none did.
+  double top;       // The shallowest depth in meters where water changed.
+  double bot;       // The deepest    depth in meters where water changed.
+} t_o_dirty_range;
+
 /* A t_o_domain struct stores all of the state of a single Talbot-Ogden domain.
  * This struct and the functions in this header should be taken together
  * like the member data and methods of a C++ object.
@@ -54,11 +153,19 @@ typedef struct
   double*         surface_front;         // 1D array containing the depth of the bottom of the surface front water in each bin in meters.
   slug**          top_slug;              // 1D array of pointers to the top    slug in each bin or NULL if the bin has no slugs.
   slug**          bot_slug;              // 1D array of pointers to the bottom slug in each bin or NULL if the bin has no slugs.
+#ifdef SLUG_SPANS
+  slug_span*      slug_spans;            // 1D array of the slug depths of each bin.  See slug_span.
+#endif // SLUG_SPANS
   int             yes_groundwater;       // Whether to simulate groundwater. If FALSE, groundwater_front is NULL.
   double*         groundwater_front;     // 1D array containing the depth of the top of the groundwater in meters in each bin.
                                          // Only used if yes_groundwater is TRUE.
   double          initial_water_content; // Bins with water content less than or equal to this are in contact with groundwater.
                                          // Only used if yes_groundwater is FALSE.
+  int             integrator;            // T_O_INTEGRATOR_EULER, T_O_INTEGRATOR_RK4, or T_O_INTEGRATOR_GREEN_AMPT.
+  int             redistribution;        // T_O_REDISTRIBUTE_SLUGS or T_O_REDISTRIBUTE_STAIRCASE.
+  t_o_statistics  statistics;            // Counters of the work done on this domain.
+  t_o_dirty_range dirty;                 // Where water changed since the last call to t_o_redistribute.
+  memory_arena*   scratch;               // Scratch memory for the duration of one call.  Reset before the call returns.
 } t_o_domain;
 
 /* Create a t_o_parameters struct and initialize it.
@@ -145,6 +252,80 @@ int t_o_domain_alloc(t_o_domain** domain, t_o_parameters* parameters, double lay
  */
 void t_o_domain_dealloc(t_o_domain** domain);
 
+/* Set all of the counters in the t_o_statistics struct of the domain to
+ * zero.
+ *
+ * Parameters:
+ *
+ * domain - A pointer to the t_o_domain struct.
+ */
+void t_o_reset_statistics(t_o_domain* domain);
+
+/* Choose how a Talbot-Ogden domain advances its fronts each timestep.  The
+ * surface front of a wet bin moves at rate * (suction / depth + 1), and a
+ * groundwater front at rate * (1 - suction / distance to the water table).
+ * T_O_INTEGRATOR_EULER multiplies the speed at the start of the timestep by
+ * dt, which is accurate only for short timesteps.  T_O_INTEGRATOR_RK4 uses
+ * four speeds across the timestep.  T_O_INTEGRATOR_GREEN_AMPT solves the
+ * integrated Green-Ampt equation for the distance, which is exact for any dt
+ * while the rate and suction are constant.  Dry bins already use the
+ * integrated dry depth with every integrator.  Domains start with
+ * T_O_INTEGRATOR_EULER, and checkpoints save the integrator.
+ *
+ * The integrator does not make long timesteps as accurate as short ones
+ * while it rains.  How much infiltrates depends mostly on how the rainfall
+ * of a timestep is shared among the bins and how much of it runs off, and
+ * that is decided once per timestep.  Use t_o_timestep_multirate to resolve
+ * the rainfall within a long timestep.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * domain     - A pointer to the t_o_domain struct.
+ * integrator - One of the T_O_INTEGRATOR constants.
+ */
+int t_o_set_integrator(t_o_domain* domain, int integrator);
+
+/* Choose how a Talbot-Ogden domain redistributes water sideways at the end of
+ * each timestep.  T_O_REDISTRIBUTE_SLUGS sorts the fronts and places again
+ * only the slugs of the bins where water changed.  T_O_REDISTRIBUTE_STAIRCASE
+ * counts the wet bins at every depth of the whole domain into a t_o_staircase
+ * and rebuilds every bin from it.  Both give bit for bit the same domain, so
+ * checkpoints do not save the choice and restored domains start with
+ * T_O_REDISTRIBUTE_SLUGS like new ones.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * domain         - A pointer to the t_o_domain struct.
+ * redistribution - One of the T_O_REDISTRIBUTE constants.
+ */
+int t_o_set_redistribution(t_o_domain* domain, int redistribution);
+
+/* Estimate the error of the integrator of a Talbot-Ogden domain for one
+ * timestep of dt from its current state.  Each front is advanced once with
+ * dt and again with two steps of dt / 2, and the largest difference is
+ * reported.  This is the local error of one step of dt / 2 times
+ * 2^order / (2^order - 1), so it over estimates the error of the step of dt
+ * by that factor, which is close to one for RK4.  Compare it with how far the
+ * fronts may be off before choosing a larger dt.  The domain is not changed.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * domain            - A pointer to the t_o_domain struct.
+ * dt                - The duration of the timestep in seconds.
+ * surfacewater_head - The pressure head in meters of the surface water.
+ * water_table       - The depth in meters of the water table.
+ * infiltration      - A scalar passed by reference that gets set to the
+ *                     largest estimated error in meters of the distance a
+ *                     wet surface front moves.
+ * groundwater       - A scalar passed by reference that gets set to the
+ *                     largest estimated error in meters of the distance a
+ *                     groundwater front moves.  Zero without groundwater.
+ */
+int t_o_integrator_error(t_o_domain* domain, double dt, double surfacewater_head, double water_table, double* infiltration, double* groundwater);
+
 /* Assert if any Talbot-Ogden domain invariant is violated.  In each bin
  * water must be non-overlapping and monotonically increasing in depth.
  * At every depth there can be no wet bin to the right of a dry bin.
@@ -165,6 +346,87 @@ void t_o_check_invariant(t_o_domain* domain);
  */
 double t_o_total_water_in_domain(t_o_domain* domain);
 
+/* Sample the water content and pressure head of the Talbot-Ogden domain on
+ * a grid of elements.  Each element gets the values at the first depth at or
+ * below its lower bound where the water content changes.  The changes are
+ * gathered from every front and slug, sorted once, and swept down the grid
+ * together with the elements, so the cost is O(n log n) in the number of
+ * fronts and slugs plus O(num_elements).  Scratch memory comes from the
+ * domain so after the first call nothing is allocated on the heap.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * domain        - A pointer to the t_o_domain struct.
+ * num_elements  - The number of elements in the grid.
+ * element_depth - 1D array of size num_elements + 1 containing the depth in
+ *                 meters of the lower bound of each element, positive
+ *                 downward.  One based indexing is used.  Depths must not
+ *                 decrease.
+ * water_content - 1D array of size num_elements + 1 that is filled in with
+ *                 the water content of each element, unitless.
+ * pressure_head - 1D array of size num_elements + 1 that is filled in with
+ *                 the pressure head of each element in meters.
+ */
+int t_o_profile(t_o_domain* domain, int num_elements, const double* element_depth, double* water_content, double* pressure_head);
+
+/* Save the state of a whole ensemble of Talbot-Ogden domains to one binary
+ * checkpoint file so that a long spin up only has to be run once.  The
+ * surface fronts, groundwater fronts, and slugs of each domain are saved.
+ * The parameters are not saved.  Instead a hash of them is saved so that
+ * t_o_domain_restore can check it is given the same parameters.  Statistics
+ * are not saved.  The format is versioned and has no pointers in it.  The
+ * file is written under a temporary name and renamed when it is complete so
+ * an existing checkpoint is never left half written.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * domains     - 1D array of num_domains pointers to t_o_domain structs with
+ *               zero based indexing.  For a single domain pass the address of
+ *               the pointer to it and 1.
+ * num_domains - The number of domains.
+ * path        - The name of the checkpoint file to write.
+ */
+int t_o_domain_checkpoint(t_o_domain** domains, int num_domains, const char* path);
+
+/* Get the number of domains in a checkpoint file written by
+ * t_o_domain_checkpoint so that arrays can be allocated for
+ * t_o_domain_restore.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * path        - The name of the checkpoint file.
+ * num_domains - Scalar passed by reference.  Will be set to the number of
+ *               domains in the file.
+ */
+int t_o_checkpoint_num_domains(const char* path, int* num_domains);
+
+/* Create Talbot-Ogden domains from a checkpoint file written by
+ * t_o_domain_checkpoint.  Each restored domain is equal to the domain that
+ * was saved and steps forward exactly the same.  The file is memory mapped
+ * and the slug structs for each domain are allocated all at once rather than
+ * one by one.
+ * Return TRUE if there is an error, FALSE otherwise.  If there is an error no
+ * domains are created.
+ *
+ * Parameters:
+ *
+ * domains     - 1D array of num_domains pointers with zero based indexing.
+ *               Each will be assigned to point to a newly allocated
+ *               t_o_domain struct or NULL if there is an error.
+ * num_domains - The number of domains.  Must equal the number of domains in
+ *               the file.
+ * parameters  - 1D array of num_domains pointers to t_o_parameters structs
+ *               with zero based indexing.  parameters[kk] must have the same
+ *               values as the parameters of domain kk when it was saved.
+ *               The same t_o_parameters struct can be used for more than one
+ *               domain.  It must not be deallocated before the domains.
+ * path        - The name of the checkpoint file to read.
+ */
+int t_o_domain_restore(t_o_domain** domains, int num_domains, t_o_parameters** parameters, const char* path);
+
 /* Step the Talbot-Ogden simulation forward one timestep.
  * Return TRUE if there is an error, FALSE otherwise.
  *
@@ -193,6 +455,380 @@ double t_o_total_water_in_domain(t_o_domain* domain);
  */
 int t_o_timestep(t_o_domain* domain, double dt, double surfacewater_head, double* surfacewater_depth, double water_table, double* groundwater_recharge);
 
+/* Step a batch of Talbot-Ogden domains forward one timestep.  All of the
+ * domains must share the same t_o_parameters struct.  The result for each
+ * domain is the same as calling t_o_timestep on it, but argument checking,
+ * the dry depth cache check, and the first_bin search for domains without
+ * groundwater are done once for the whole batch instead of once per domain.
+ * Use this when simulating many columns with the same soil.
+ * Return TRUE if there is an error, FALSE otherwise.
+ * If there is an error stepping one domain, the domains after it in the batch
+ * are not stepped.
+ *
+ * The per-domain arrays use zero based indexing and must hold num_domains
+ * elements.  Element ii of each array goes with domains[ii].  See
+ * t_o_timestep for the meaning of each value.
+ *
+ * Parameters:
+ *
+ * domains              - A 1D array of pointers to t_o_domain structs.
+ * num_domains          - The number of domains in the batch.
+ * dt                   - The duration of the timestep in seconds.
+ * surfacewater_head    - A 1D array of surface water pressure heads in
+ *                        meters.
+ * surfacewater_depth   - A 1D array of surface water depths in meters.
+ *                        Will be updated for the amount of infiltration.
+ * water_table          - A 1D array of water table depths in meters.
+ * groundwater_recharge - A 1D array of accumulated groundwater recharge in
+ *                        meters of water.  Will be updated for the amount of
+ *                        water that flowed between each domain and
+ *                        groundwater.
+ */
+int t_o_timestep_batch(t_o_domain** domains, int num_domains, double dt, double* surfacewater_head, double* surfacewater_depth, double* water_table,
+                       double* groundwater_recharge);
+
+/* A t_o_thread_pool struct stores a set of worker threads that step
+ * Talbot-Ogden domains in parallel.  Its contents are private to t_o.c.
+ */
+typedef struct t_o_thread_pool t_o_thread_pool;
+
+/* Create a t_o_thread_pool struct and start its worker threads.
+ * Return TRUE if there is an error, FALSE otherwise.
+ * t_o.c must be compiled with THREAD_SAFE defined.
+ *
+ * Parameters:
+ *
+ * pool        - A pointer passed by reference which will be assigned to point
+ *               to the newly allocated struct or NULL if there is an error.
+ * num_threads - The number of worker threads.
+ */
+int t_o_thread_pool_alloc(t_o_thread_pool** pool, int num_threads);
+
+/* Stop the worker threads and free memory allocated by t_o_thread_pool_alloc.
+ * The unused slug structs the workers kept for reuse are freed too, so the
+ * pool can be deallocated before or after the domains it stepped.
+ *
+ * Parameters:
+ *
+ * pool - A pointer to the t_o_thread_pool struct passed by reference.
+ *        Will be set to NULL after the memory is deallocated.
+ */
+void t_o_thread_pool_dealloc(t_o_thread_pool** pool);
+
+/* Step an array of Talbot-Ogden domains forward one timestep in parallel
+ * using the worker threads in pool.  The result for each domain is the same
+ * as calling t_o_timestep on it.  Each worker starts with an equal share of
+ * the domains and steals from the other workers when it runs out, so columns
+ * that take longer to step do not leave threads idle.  The domains may have
+ * different t_o_parameters structs, but each domain must appear only once.
+ * Only one call at a time may use the same pool.
+ * Return TRUE if there is an error, FALSE otherwise.
+ * If there is an error stepping one domain the other domains are still
+ * stepped.
+ *
+ * The per-domain arrays are the same as for t_o_timestep_batch.
+ *
+ * Parameters:
+ *
+ * pool                 - A pointer to the t_o_thread_pool struct.
+ * domains              - A 1D array of pointers to t_o_domain structs.
+ * num_domains          - The number of domains.
+ * dt                   - The duration of the timestep in seconds.
+ * surfacewater_head    - A 1D array of surface water pressure heads in
+ *                        meters.
+ * surfacewater_depth   - A 1D array of surface water depths in meters.
+ *                        Will be updated for the amount of infiltration.
+ * water_table          - A 1D array of water table depths in meters.
+ * groundwater_recharge - A 1D array of accumulated groundwater recharge in
+ *                        meters of water.  Will be updated for the amount of
+ *                        water that flowed between each domain and
+ *                        groundwater.
+ */
+int t_o_timestep_parallel(t_o_thread_pool* pool, t_o_domain** domains, int num_domains, double dt, double* surfacewater_head, double* surfacewater_depth,
+                          double* water_table, double* groundwater_recharge);
+
+/* A t_o_adaptive struct stores the settings, state, and step counts of
+ * adaptive timestepping for one Talbot-Ogden domain.  Set the settings with
+ * t_o_adaptive_alloc.  The rest is private to t_o.c except for the counters,
+ * which are cumulative since the struct was allocated.
+ */
+typedef struct
+{
+  double      min_dt;         // The smallest step in seconds.  Steps of min_dt are always accepted.
+  double      max_dt;         // The largest step in seconds.
+  double      tolerance;      // The largest error in meters of water of infiltration, recharge, or mass balance allowed in one step.
+  double      max_front_move; // The farthest in meters any surface front may move in one step.
+  double      dt;             // The step to try next in seconds.  Always min_dt times a power of two so few dry depth cache snapshots are made.
+  t_o_domain* start;          // The state of the domain at the start of the step being tried.  Restored if the step is rejected.
+  t_o_domain* trial;          // The domain stepped once with the full step to estimate the error.
+  long long   num_accepted;   // The number of steps accepted.
+  long long   num_rejected;   // The number of steps rejected and retried with half the step.
+  long long   num_timesteps;  // The number of calls to t_o_timestep including the ones used to estimate the error.
+} t_o_adaptive;
+
+/* Create a t_o_adaptive struct for stepping domain adaptively.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * adaptive       - A pointer passed by reference which will be assigned to
+ *                  point to the newly allocated struct or NULL if there is an
+ *                  error.
+ * domain         - A pointer to the t_o_domain struct that will be stepped.
+ * min_dt         - The smallest step in seconds.
+ * max_dt         - The largest step in seconds.  Rounded down to min_dt times
+ *                  a power of two.
+ * tolerance      - The largest error allowed in one step in meters of water.
+ * max_front_move - The farthest in meters any surface front may move in one
+ *                  step.
+ */
+int t_o_adaptive_alloc(t_o_adaptive** adaptive, t_o_domain* domain, double min_dt, double max_dt, double tolerance, double max_front_move);
+
+/* Free memory allocated by t_o_adaptive_alloc.
+ *
+ * Parameters:
+ *
+ * adaptive - A pointer to the t_o_adaptive struct passed by reference.
+ *            Will be set to NULL after the memory is deallocated.
+ */
+void t_o_adaptive_dealloc(t_o_adaptive** adaptive);
+
+/* Step a Talbot-Ogden domain forward duration seconds with as few
+ * t_o_timestep calls as the error criteria allow.  Each step is taken once
+ * with the full step and again as two half steps.  The step is accepted if
+ * the infiltration and recharge of the two differ by no more than tolerance,
+ * water is conserved to within tolerance, and no surface front moved farther
+ * than max_front_move.  The result of the two half steps is kept.  After a
+ * step is accepted with plenty of room the next step is doubled.  If a step
+ * is rejected the domain is restored and the step is halved.  So the steps
+ * are small while water is ponded or moving fast and grow to max_dt when only
+ * redistribution is happening.  The step carries over from call to call.
+ * Rainfall is added to the surface water before every step the same way the
+ * drivers add it before each call to t_o_timestep.  Evapotranspiration is not
+ * taken.  Call t_o_ET for the whole duration afterwards if needed.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * domain               - A pointer to the t_o_domain struct.
+ * adaptive             - A pointer to the t_o_adaptive struct allocated for
+ *                        domain.
+ * duration             - The time in seconds to step forward.
+ * rainfall_rate        - Meters of water per second added to the surface
+ *                        water throughout duration.
+ * surfacewater_depth   - A scalar passed by reference containing the depth
+ *                        in meters of the surface water.  Will be updated for
+ *                        rainfall, infiltration, and runoff.  It is also used
+ *                        as the surface water pressure head.
+ * water_table          - The depth in meters of the water table.
+ * groundwater_recharge - A scalar passed by reference containing any
+ *                        previously accumulated groundwater recharge in meters
+ *                        of water.  Will be updated for the amount of water
+ *                        that flowed between the Talbot-Ogden domain and
+ *                        groundwater.
+ * runoff               - A scalar passed by reference containing any
+ *                        previously accumulated runoff in meters of water.
+ *                        The surface water left after each step is moved
+ *                        here.  Pass NULL to leave it on the surface.
+ */
+int t_o_timestep_adaptive(t_o_domain* domain, t_o_adaptive* adaptive, double duration, double rainfall_rate, double* surfacewater_depth,
+                          double water_table, double* groundwater_recharge, double* runoff);
+
+/* A t_o_events struct stores the settings and step counts of event driven
+ * stepping for one Talbot-Ogden domain.  Set the settings with
+ * t_o_events_alloc.  The counters are cumulative since the struct was
+ * allocated.
+ */
+typedef struct
+{
+  t_o_parameters* parameters;       // The parameters of the domain the struct was allocated for.
+  double          min_dt;           // The smallest step in seconds.  Collisions predicted sooner than this are stepped past.
+  double          max_wet_dt;       // The largest step in seconds while there is rain or surface water.
+  double          max_dt;           // The largest step in seconds even if no collision is predicted sooner.
+  long long       num_collisions;   // The number of steps that ended at a predicted collision.
+  long long       num_forcing_ends; // The number of steps that ended at the end of a forcing interval.
+  long long       num_max_steps;    // The number of steps limited by max_dt.
+  long long       num_timesteps;    // The number of calls to t_o_timestep.
+} t_o_events;
+
+/* Create a t_o_events struct for event driven stepping of domain.  This also
+ * fills the dry depth cache of domain's parameters for max_dt so that steps
+ * of any length up to max_dt can use it.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * events     - A pointer passed by reference which will be assigned to
+ *              point to the newly allocated struct or NULL if there is an
+ *              error.
+ * domain     - A pointer to the t_o_domain struct that will be stepped.
+ * min_dt     - The smallest step in seconds.  The speeds of fronts that jump
+ *              to the dry depth are measured over a step of this length.
+ * max_wet_dt - The largest step in seconds while there is rain or surface
+ *              water.  How much water infiltrates depends on the step so use
+ *              the dt the results should agree with.
+ * max_dt     - The largest step in seconds the rest of the time.
+ */
+int t_o_events_alloc(t_o_events** events, t_o_domain* domain, double min_dt, double max_wet_dt, double max_dt);
+
+/* Free memory allocated by t_o_events_alloc.
+ *
+ * Parameters:
+ *
+ * events - A pointer to the t_o_events struct passed by reference.
+ *          Will be set to NULL after the memory is deallocated.
+ */
+void t_o_events_dealloc(t_o_events** events);
+
+/* Step a Talbot-Ogden domain forward duration seconds by jumping from event
+ * to event instead of stepping at a fixed dt.  Between events every boundary
+ * follows the solution of its rate equation from where it was at the last
+ * event.  Wet surface fronts and groundwater fronts follow the Green-Ampt
+ * solutions of T_O_INTEGRATOR_GREEN_AMPT, and slugs fall at constant
+ * speeds.  Each step ends at the first time two of these solutions meet,
+ * which is found by solving for the root of the gap between each pair of
+ * adjacent boundaries: a front with a slug, a slug with a slug or
+ * groundwater, or groundwater with the surface or the bottom of the domain.
+ * The step is then taken with T_O_INTEGRATOR_GREEN_AMPT, so the fronts
+ * advance along the same solutions, and the collision is handled by the
+ * ordinary timestep code, so water is conserved the same way.  The domain's
+ * own integrator is put back afterwards.  The solutions hold the surface
+ * water head at its value at the start of the step plus the rain over
+ * min_dt, and they hold the speed of each slug.  So a step ends close to
+ * the collision rather than exactly at it when the head or a slug changes
+ * during the step.  Fronts that jump to the dry depth move at the speed
+ * measured over min_dt.  Collisions sooner than min_dt are stepped past.
+ * Steps also end at the end of duration, where the forcing changes, and are
+ * never longer than max_wet_dt while there is water on the surface or max_dt
+ * otherwise.  So the long steps are taken while slugs fall and groundwater
+ * relaxes between rain storms.  Whenever there is no rain and the domain is
+ * quiescent the rest of duration is done at once with t_o_fast_forward.
+ * Rainfall is added to the surface water before every step the same way the
+ * drivers add it before each call to t_o_timestep.  Evapotranspiration is not
+ * taken.  Call t_o_ET for the whole duration afterwards if needed.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * domain               - A pointer to the t_o_domain struct.
+ * events               - A pointer to the t_o_events struct allocated for
+ *                        domain.
+ * duration             - The time in seconds to step forward.
+ * rainfall_rate        - Meters of water per second added to the surface
+ *                        water throughout duration.
+ * surfacewater_depth   - A scalar passed by reference containing the depth
+ *                        in meters of the surface water.  Will be updated for
+ *                        rainfall, infiltration, and runoff.  It is also used
+ *                        as the surface water pressure head.
+ * water_table          - The depth in meters of the water table.
+ * groundwater_recharge - A scalar passed by reference containing any
+ *                        previously accumulated groundwater recharge in meters
+ *                        of water.  Will be updated for the amount of water
+ *                        that flowed between the Talbot-Ogden domain and
+ *                        groundwater.
+ * runoff               - A scalar passed by reference containing any
+ *                        previously accumulated runoff in meters of water.
+ *                        The surface water left after each step is moved
+ *                        here.  Pass NULL to leave it on the surface.
+ */
+int t_o_timestep_events(t_o_domain* domain, t_o_events* events, double duration, double rainfall_rate, double* surfacewater_depth,
+                        double water_table, double* groundwater_recharge, double* runoff);
+
+/* Step a Talbot-Ogden domain forward dt seconds with two rates.  The fast
+ * phases, satisfying saturated bins, infiltration, and falling slugs, are
+ * sub-cycled num_substeps times at dt / num_substeps.  The slow phases,
+ * groundwater and redistribution, run once for all of dt afterwards.
+ *
+ * The two rates exchange water only through groundwater.  During the
+ * sub-steps the groundwater fronts do not move and are a fixed boundary that
+ * surface fronts and slugs can reach.  The water that flows through the
+ * saturated bins in the sub-steps is added to groundwater_recharge and is
+ * passed to the groundwater step as its average rate over dt, and the
+ * groundwater step treats the surface as ponded if any sub-step did.  With
+ * num_substeps equal to one this is the same as the drivers adding the
+ * rainfall and calling t_o_timestep.
+ *
+ * The surface water depth is integrated through the sub-steps.  Which bins
+ * the rainfall wets and how much of it runs off depend on how much arrives
+ * in each step, so the sub-steps should be as short as the fixed timestep
+ * the results should agree with.  If there is no rainfall and no surface
+ * water nothing is supplied to the surface during dt and one sub-step
+ * covers all of it.  On Panama without ET, 300 second steps with 30
+ * sub-steps infiltrate within 0.02 mm of 10 second fixed steps over 1500
+ * hours at a twelfth of the cost, while 300 second fixed steps infiltrate
+ * 134 mm more.
+ *
+ * Rainfall is added to the surface water before every sub-step, and if runoff
+ * is not NULL the surface water left after every sub-step is moved to it.
+ * Evapotranspiration is not taken.  Call t_o_ET for dt afterwards if needed.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * domain               - A pointer to the t_o_domain struct.
+ * dt                   - The duration of the outer step in seconds.
+ * num_substeps         - The number of infiltration and falling slug
+ *                        sub-steps in dt while there is rainfall or surface
+ *                        water.
+ * rainfall_rate        - Meters of water per second added to the surface
+ *                        water throughout dt.
+ * surfacewater_depth   - A scalar passed by reference containing the depth
+ *                        in meters of the surface water.  Will be updated for
+ *                        rainfall, infiltration, and runoff.  It is also used
+ *                        as the surface water pressure head.
+ * water_table          - The depth in meters of the water table.
+ * groundwater_recharge - A scalar passed by reference containing any
+ *                        previously accumulated groundwater recharge in meters
+ *                        of water.  Will be updated for the amount of water
+ *                        that flowed between the Talbot-Ogden domain and
+ *                        groundwater.
+ * runoff               - A scalar passed by reference containing any
+ *                        previously accumulated runoff in meters of water.
+ *                        Pass NULL to leave the surface water on the surface.
+ */
+int t_o_timestep_multirate(t_o_domain* domain, double dt, int num_substeps, double rainfall_rate, double* surfacewater_depth, double water_table,
+                           double* groundwater_recharge, double* runoff);
+
+/* Return TRUE if a Talbot-Ogden domain is quiescent, FALSE otherwise.  A
+ * domain is quiescent if there is no surface water, no surface front water,
+ * and no slugs, and every groundwater front is relaxing toward hydrostatic
+ * equilibrium with water_table without any front reaching the surface.  Then
+ * the only thing a timestep does is move the groundwater fronts, and
+ * t_o_fast_forward can do any number of timesteps at once.  t_o_timestep
+ * checks this itself and skips the infiltration, falling slug, and slug
+ * redistribution work when it is TRUE.
+ *
+ * Parameters:
+ *
+ * domain             - A pointer to the t_o_domain struct.
+ * surfacewater_depth - The depth in meters of the surface water.
+ * water_table        - The depth in meters of the water table.
+ */
+int t_o_quiescent(t_o_domain* domain, double surfacewater_depth, double water_table);
+
+/* Advance a quiescent Talbot-Ogden domain duration seconds at once with no
+ * rainfall.  Each groundwater front is moved with the closed form solution
+ * of the equation t_o_timestep integrates for it, so the cost does not
+ * depend on duration.  Domains without groundwater do not change at all.
+ * Call it for a dry period that ends exactly when rainfall resumes and step
+ * normally from there.  The result differs from stepping with t_o_timestep
+ * only by the error of its explicit groundwater steps.
+ * Return TRUE if there is an error, FALSE otherwise.  It is an error if the
+ * domain is not quiescent.
+ *
+ * Parameters:
+ *
+ * domain               - A pointer to the t_o_domain struct.
+ * duration             - The time in seconds to advance.
+ * water_table          - The depth in meters of the water table.
+ * groundwater_recharge - A scalar passed by reference containing any
+ *                        previously accumulated groundwater recharge in meters
+ *                        of water.  Will be updated for the amount of water
+ *                        that flowed between the Talbot-Ogden domain and
+ *                        groundwater.
+ */
+int t_o_fast_forward(t_o_domain* domain, double duration, double water_table, double* groundwater_recharge);
+
 /* Arbitrarily add water to the groundwater front of a Talbot-Ogden domain.
  * This function is used to couple the domain to a separate groundwater
  * simulation.  Some groundwater simulations work by assuming that the
@@ -280,6 +916,141 @@ void t_o_take_groundwater(t_o_domain* domain, double water_table, double* ground
  */
 double t_o_specific_yield(t_o_domain* domain, double water_table);
 
+/* A t_o_staircase struct stores the state of a Talbot-Ogden domain as a step
+ * function from depth to the number of wet bins.  The invariant checked by
+ * t_o_check_invariant means that at every depth the wet bins are bins 1
+ * through some number, so that number is all the state there is.  It is
+ * stored as a sorted array of breakpoints.  Step kk has wet_bins[kk] wet bins
+ * from depth[kk] down to depth[kk + 1], or down to layer_bottom_depth for the
+ * last step.  depth[0] is always layer_top_depth, the depths are strictly
+ * increasing, and no two adjacent steps have the same number of wet bins, so
+ * each state has exactly one staircase.
+ *
+ * Sideways redistribution never changes how many bins are wet at a depth.
+ * Converting a domain to a staircase and back is therefore a redistribution,
+ * which is how domains set to T_O_REDISTRIBUTE_STAIRCASE redistribute.  The
+ * total water, the profile, and whether a bin has water at a depth each
+ * take one scan or one binary search of the breakpoints.
+ */
+typedef struct
+{
+  t_o_parameters* parameters;            // The parameters of the domains this staircase can be converted to and from.  Not owned.
+  double          layer_top_depth;       // Meters.
+  double          layer_bottom_depth;    // Meters.
+  int             yes_groundwater;       // Whether the domain simulates groundwater.
+  double          initial_water_content; // Without groundwater bins with water content less than or equal to this are always full.
+  int             num_steps;             // The number of steps.
+  int             capacity;              // The number of elements allocated in depth and wet_bins.
+  double*         depth;                 // 1D array of the depth in meters of the top of each step with zero based indexing.
+  int*            wet_bins;              // 1D array of the number of wet bins in each step with zero based indexing.
+} t_o_staircase;
+
+/* Create a t_o_staircase struct for domains like domain and set it to the
+ * state of domain.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * staircase - A pointer passed by reference which will be assigned to point
+ *             to the newly allocated struct or NULL if there is an error.
+ * domain    - A pointer to the t_o_domain struct.
+ */
+int t_o_staircase_alloc(t_o_staircase** staircase, t_o_domain* domain);
+
+/* Free memory allocated by t_o_staircase_alloc.
+ *
+ * Parameters:
+ *
+ * staircase - A pointer to the t_o_staircase struct passed by reference.
+ *             Will be set to NULL after the memory is deallocated.
+ */
+void t_o_staircase_dealloc(t_o_staircase** staircase);
+
+/* Set a staircase to the state of a Talbot-Ogden domain by counting the wet
+ * bins at each depth.  The domain does not have to satisfy the invariant.
+ * Water that t_o_redistribute would move sideways is counted at the depth it
+ * is at, and where surface front water overlaps groundwater both are
+ * counted, so the staircase is the state the domain would have after
+ * redistribution.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * staircase - A pointer to the t_o_staircase struct.
+ * domain    - A pointer to the t_o_domain struct.  Must have the same
+ *             parameters, layer depths, and yes_groundwater as the domain the
+ *             staircase was allocated for.
+ */
+int t_o_staircase_from_domain(t_o_staircase* staircase, t_o_domain* domain);
+
+/* Set the surface fronts, groundwater fronts, and slugs of a Talbot-Ogden
+ * domain to the state of a staircase.  Bin ii is wet wherever at least ii
+ * bins are wet.  For a domain that satisfies the invariant converting it to a
+ * staircase and back gives an equal domain.
+ * Return TRUE if there is an error, FALSE otherwise.  It is an error if
+ * the staircase has more wet bins anywhere than the domain has bins, or if
+ * without groundwater it has fewer wet bins anywhere than the bins that are
+ * always full.  If there is an error the domain might be partly changed.
+ *
+ * Parameters:
+ *
+ * staircase - A pointer to the t_o_staircase struct.
+ * domain    - A pointer to the t_o_domain struct.  Must have the same
+ *             parameters, layer depths, and yes_groundwater as the domain the
+ *             staircase was allocated for.
+ */
+int t_o_staircase_to_domain(t_o_staircase* staircase, t_o_domain* domain);
+
+/* Return the number of wet bins at depth.  A depth on a breakpoint gets the
+ * step below it.  Depths above or below the domain get the first or last
+ * step.
+ *
+ * Parameters:
+ *
+ * staircase - A pointer to the t_o_staircase struct.
+ * depth     - The depth in meters.
+ */
+int t_o_staircase_wet_bins(t_o_staircase* staircase, double depth);
+
+/* Return TRUE if bin is wet everywhere from top to bot, FALSE otherwise.
+ * This answers the same question as has_water_at_depth for a domain.
+ *
+ * Parameters:
+ *
+ * staircase - A pointer to the t_o_staircase struct.
+ * bin       - Which bin to check for water.  One based indexing is used.
+ * top       - The top of the region to check for water in meters.
+ * bot       - The bottom of the region to check for water in meters.
+ */
+int t_o_staircase_has_water_at_depth(t_o_staircase* staircase, int bin, double top, double bot);
+
+/* Return the total water in meters of water in the state of a staircase the
+ * same way t_o_total_water_in_domain does for a domain.
+ *
+ * Parameters:
+ *
+ * staircase - A pointer to the t_o_staircase struct.
+ */
+double t_o_staircase_total_water(t_o_staircase* staircase);
+
+/* Fill in the water content and pressure head at a set of depths the same
+ * way t_o_profile does for a domain.  Each depth gets the values of the step
+ * above it.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * staircase     - A pointer to the t_o_staircase struct.
+ * num_elements  - The number of depths.
+ * element_depth - 1D array of num_elements depths in meters in increasing
+ *                 order with one based indexing.
+ * water_content - 1D array of num_elements with one based indexing.  Will be
+ *                 filled in with the unitless water content at each depth.
+ * pressure_head - 1D array of num_elements with one based indexing.  Will be
+ *                 filled in with the pressure head in meters at each depth.
+ */
+int t_o_staircase_profile(t_o_staircase* staircase, int num_elements, const double* element_depth, double* water_content, double* pressure_head);
+
 // FIXME, wencong, add ET, Dec. 10, 2014. A very simple ET function.
 /*
    domain      - A pointer to the t_o_domain struct.
@@ -3,80 +3,66 @@
 #include <assert.h>
 #include <math.h>
 #include <string.h>
-#include <X11/Xlib.h>
-#include "t_o.h"
+#include "t_o_internal.h"
 #include "epsilon.h"
 #include "all.h"
 #include "memfunc.h"
+#include "forcing.h"
+#include "output_writer.h"
+#include "renderer.h"
 
-extern int t_o_domains_equal(t_o_domain* domain1, t_o_domain* domain2);
-
-#define MARGIN        (30)
-#define FRAME_WIDTH   (600)
-#define FRAME_HEIGHT  (500)
-#define WINDOW_WIDTH  (FRAME_WIDTH  + 2 * MARGIN)
-#define WINDOW_HEIGHT (FRAME_HEIGHT + 3 * MARGIN)
-#define RED           (0xFF0066)
-#define BLUE          (0x0000FF)
-#define GREEN         (0x00CC66)
-#define GRAY          (0xB1B1B1) 
-#define BLACK         (0x000000)
 #define ONE_MINUTE    (60.0)
 #define ONE_HOUR      (60.0 * ONE_MINUTE)
 #define ONE_DAY       (24.0 * ONE_HOUR)
-//#define YES_PLOT      
-
-void display_water(Display* the_display, Pixmap the_pixmap, GC the_gc, t_o_domain* domain, int bin, double top, double bot)
-{
-  int width_factor  = FRAME_WIDTH  / domain->parameters->num_bins; // Pixels per bin.
-  int height_factor = FRAME_HEIGHT / domain->layer_bottom_depth;   // Pixels per meter.
-  int x             = MARGIN + (bin - 1) * width_factor;           // Pixels.
-  int width         = width_factor;                                // Pixels.
-  int y_top         = MARGIN + top * height_factor;                // Pixels.
-  int y_bot         = MARGIN + bot * height_factor;                // Pixels
-  int height        = y_bot - y_top + 1;                           // Pixels.  Add one to height to force the rectangles to be at least 1 pixel tall.
-
-  XFillRectangle(the_display, the_pixmap, the_gc, x, y_top, width, height);
-}
-
-
-void display_domain(double current_time, Display* the_display, int the_screen, Window the_window, Pixmap the_pixmap, t_o_domain* domain)
+//#define YES_PLOT      // Show the domain in an X window.  Drawn on the renderer thread.
+//#define FRAME_HOURS   (24.0) // Write frame_NNNNN.ppm pictures of the domain every FRAME_HOURS simulated hours.  Needs no display.
+#define MAX_FRAMES_PER_SECOND (30.0) // The most times per second to draw the window.
+//#define BINARY_OUTPUT // Write f.bin and accum_depth.bin instead of f.out and accum_depth.out.  Convert them with output_to_text.
+
+#ifdef BINARY_OUTPUT
+#define OUTPUT_SUFFIX ".bin"
+#define OUTPUT_BINARY (TRUE)
+#else // BINARY_OUTPUT
+#define OUTPUT_SUFFIX ".out"
+#define OUTPUT_BINARY (FALSE)
+#endif // BINARY_OUTPUT
+
+/* Copy the water in domain into a snapshot for the renderer if one is due.
+ * The renderer draws it on its own thread, so this never waits on drawing.
+ */
+void display_domain(double current_time, renderer* the_renderer, t_o_domain* domain)
 {
-  char the_string[60];
-  
-  int ii; // Loop counter.
-  int textlen;
-  GC the_gc = DefaultGC(the_display, the_screen);
+  int   ii; // Loop counter.
+  slug* temp_slug;
 
-  // Clear the pixmap.
-  XSetForeground(the_display, the_gc, WhitePixel(the_display, the_screen));
-  XFillRectangle(the_display, the_pixmap, the_gc, 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+  if (!renderer_snapshot_due(the_renderer, current_time) ||
+      renderer_begin_snapshot(the_renderer, current_time, domain->parameters->num_bins, domain->layer_bottom_depth))
+    {
+      return;
+    }
 
-  // Fill rectangles where water is.
+  // Add rectangles where water is.
   for (ii = 1; ii <= domain->parameters->num_bins; ii++)
     {
       if (!domain->yes_groundwater &&  domain->parameters->bin_water_content[ii] <= domain->initial_water_content)
         {
           // Display the completely saturated bin.
-          XSetForeground(the_display, the_gc, GRAY);
-          display_water(the_display, the_pixmap, the_gc, domain, ii, domain->layer_top_depth, domain->layer_bottom_depth);
+          renderer_add_water(the_renderer, ii, domain->layer_top_depth, domain->layer_bottom_depth, RENDERER_SATURATED);
         }
       else
         {
           // Display the surface attached water.
           if (0.0 < domain->surface_front[ii])
             {
-              XSetForeground(the_display, the_gc, GREEN);
-              display_water(the_display, the_pixmap, the_gc, domain, ii, domain->layer_top_depth, domain->surface_front[ii]);
+              renderer_add_water(the_renderer, ii, domain->layer_top_depth, domain->surface_front[ii], RENDERER_SURFACE);
             }
 
           // Display each slug.
-          slug* temp_slug = domain->top_slug[ii];
+          temp_slug = domain->top_slug[ii];
 
           while (NULL != temp_slug)
             {
-              XSetForeground(the_display, the_gc, RED);
-              display_water(the_display, the_pixmap, the_gc, domain, ii, temp_slug->top, temp_slug->bot);
+              renderer_add_water(the_renderer, ii, temp_slug->top, temp_slug->bot, RENDERER_SLUG);
               temp_slug = temp_slug->next;
             }
 
@@ -85,298 +71,46 @@ void display_domain(double current_time, Display* the_display, int the_screen, W
             {
             if(epsilon_equal(domain->groundwater_front[ii],domain->layer_top_depth))
               {
-              XSetForeground(the_display, the_gc, GRAY);
-              display_water(the_display, the_pixmap, the_gc, domain, ii, domain->groundwater_front[ii], domain->layer_bottom_depth);              
+              renderer_add_water(the_renderer, ii, domain->groundwater_front[ii], domain->layer_bottom_depth, RENDERER_SATURATED);
               }
             else
               {
-              XSetForeground(the_display, the_gc, BLUE);
-              display_water(the_display, the_pixmap, the_gc, domain, ii, domain->groundwater_front[ii], domain->layer_bottom_depth);
+              renderer_add_water(the_renderer, ii, domain->groundwater_front[ii], domain->layer_bottom_depth, RENDERER_GROUNDWATER);
               }
             }
         }
     }
 
-  XSetForeground(the_display, the_gc, BLACK);
-  XDrawLine(the_display,the_pixmap,the_gc,MARGIN,MARGIN,FRAME_WIDTH+1.4*MARGIN,MARGIN);
-  XDrawLine(the_display,the_pixmap,the_gc,FRAME_WIDTH+1.4*MARGIN,MARGIN,FRAME_WIDTH+1.2*MARGIN,0.9*MARGIN);
-  XDrawLine(the_display,the_pixmap,the_gc,FRAME_WIDTH+1.4*MARGIN,MARGIN,FRAME_WIDTH+1.2*MARGIN,1.1*MARGIN);
-
-  XDrawLine(the_display,the_pixmap,the_gc,MARGIN,MARGIN,MARGIN,FRAME_HEIGHT+1.4*MARGIN);
-  XDrawLine(the_display,the_pixmap,the_gc,MARGIN,FRAME_HEIGHT+1.4*MARGIN,MARGIN-0.1*MARGIN,FRAME_HEIGHT+1.2*MARGIN);
-  XDrawLine(the_display,the_pixmap,the_gc,MARGIN,FRAME_HEIGHT+1.4*MARGIN,MARGIN+0.1*MARGIN,FRAME_HEIGHT+1.2*MARGIN);
-  
-  strcpy(the_string,"z");
-  textlen=(int)strlen(the_string);
-  XDrawString(the_display,the_pixmap,the_gc, 0.5*MARGIN,FRAME_HEIGHT+MARGIN*1.4,the_string,textlen);
- 
-
-  XSetForeground(the_display, the_gc, GRAY);
-  XFillRectangle(the_display,the_pixmap,the_gc,2*MARGIN,FRAME_HEIGHT+2.2*MARGIN,MARGIN/2,MARGIN/2);
-
-  XSetForeground(the_display, the_gc, BLUE);
-  XFillRectangle(the_display,the_pixmap,the_gc,MARGIN+FRAME_WIDTH/2.0,FRAME_HEIGHT+2.2*MARGIN,MARGIN/2,MARGIN/2);
-
-  XSetForeground(the_display, the_gc, RED);
-  XFillRectangle(the_display,the_pixmap,the_gc,2*MARGIN,FRAME_HEIGHT+1.4*MARGIN,MARGIN/2,MARGIN/2);
-
-  XSetForeground(the_display, the_gc, GREEN);
-  XFillRectangle(the_display,the_pixmap,the_gc,MARGIN+FRAME_WIDTH/2.0,FRAME_HEIGHT+1.4*MARGIN,MARGIN/2,MARGIN/2);
-
-  XSetForeground(the_display, the_gc, BLACK);
-
-  strcpy(the_string,"Groundwater w/surface contact");
-  textlen=(int)strlen(the_string);
-  XDrawString(the_display,the_pixmap,the_gc, 2.7*MARGIN,FRAME_HEIGHT+2.6*MARGIN,the_string,textlen);
-
-  strcpy(the_string,"Falling slugs");
-  textlen=(int)strlen(the_string);
-  XDrawString(the_display,the_pixmap,the_gc, 2.7*MARGIN,FRAME_HEIGHT+1.8*MARGIN,the_string,textlen);
-
-  strcpy(the_string,"Capillary groundwater");
-  textlen=(int)strlen(the_string);
-  XDrawString(the_display,the_pixmap,the_gc, MARGIN+FRAME_WIDTH/2+0.7*MARGIN,FRAME_HEIGHT+2.6*MARGIN,the_string,textlen);
-
-  strcpy(the_string,"Infiltration front");
-  textlen=(int)strlen(the_string);
-  XDrawString(the_display,the_pixmap,the_gc, MARGIN+FRAME_WIDTH/2+0.7*MARGIN,FRAME_HEIGHT+1.8*MARGIN,the_string,textlen);
-
-  strcpy(the_string,"Water content");
-  textlen=(int)strlen(the_string);
-  XDrawString(the_display,the_pixmap,the_gc, MARGIN+4*FRAME_WIDTH/5+1.0*MARGIN,0.8*MARGIN,the_string,textlen);
-  
-  sprintf(the_string,"Time: %8.4lf (days)",current_time/ONE_DAY);
-  textlen=(int)strlen(the_string);
-  XDrawString(the_display,the_pixmap,the_gc, MARGIN+1.0*MARGIN,0.8*MARGIN,the_string,textlen);
-  
-  // Copy pixmap to window.
-  XCopyArea(the_display, the_pixmap, the_window, the_gc, 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, 0, 0);
-  XFlush(the_display);
-}
-
-/* A link list struct stores depth, theta with depth increasing order. */
-struct t_o_profile_link
-{
-  double depth;
-  double theta;
-  double pressure;
-  struct t_o_profile_link *next;
-};
-typedef struct t_o_profile_link t_o_profile_link;
-
-/* Insert a node with (depth, theta) into link list (head_pt), return error = TRUE if error occurs. */
-int insert_t_o_profile_link(t_o_profile_link** head_pt, double depth, double theta, double pressure, int yes_groundater)
-{
-  int error = FALSE;
-  assert(NULL != *head_pt);
-  
-  t_o_profile_link* pt_insert;
-  t_o_profile_link* pt_rear;
-  t_o_profile_link* pt_front;
-  
-  if (NULL == (pt_insert = (t_o_profile_link*)malloc(sizeof(t_o_profile_link))))
-    {
-      printf("malloc failed in creating t_o_profile_link node in function insert_t_o_profile_link(), exit.\n");
-      error = TRUE;
-      return error;
-    }
-  pt_insert->depth    = depth;
-  pt_insert->theta    = theta;
-  pt_insert->pressure = pressure;
-  pt_insert->next     = NULL;
-  
-  pt_rear  = *head_pt;
-  pt_front = (*head_pt)->next;
-  // Head pointer *head_pt is initialized with domain->top_depth, and pass in value (depth) is larger than domain->top_depth.
-  while (NULL != pt_front)
-    {
-      if (pt_insert->depth >= pt_front->depth)
-        {
-          pt_rear  = pt_front;
-          pt_front = pt_front->next;     
-        }
-      else
-        {
-          break;
-        }
-    }
-  
-  // Insert pt_insert only when depth is strictly larger than pt_rear->depth, so that depth in link is increasing without same value.
-  if (epsilon_greater(pt_insert->depth, pt_rear->depth))
-    {
-      pt_rear->next   = pt_insert;
-      pt_insert->next = pt_front;
-    }
-  else if (!yes_groundater && epsilon_equal(pt_insert->depth, pt_rear->depth) && pt_rear->theta < pt_insert->theta)
-    { // Add 10/09/14, to handle no groundwate cases,
-     //printf("theta = %lf \n", pt_insert->theta); getchar();
-      pt_rear->theta    = pt_insert->theta;
-      pt_rear->pressure = pt_insert->pressure;
-    }
-  return error;
+  renderer_end_snapshot(the_renderer);
 }
 
-/* Map t_o domain into water content in 1D space discretization, water_content[num_elements] and effective_porosity are output values.
- *
- * Parameters:
- * domain             - A pointer to the t_o_domain struct.
- * num_elements       - Number of element in 1d soil column.
- * soil_depth_z       - A pointer to 1d array of size num_elements contains depth of each element's lower bound, in unit of [meters], positive downward.
- *
- * Output:
- * water_content      - A pointer to 1d array of size num_elements contains water content of each element.
- * pressure_head      - A pointer to 1d array of size num_elements contains pressure head of each element.
- * effective_porosity - Scalar passed by reference, unitless.
- */
-int get_t_o_domain_profile(t_o_domain* domain, int num_elements, double* soil_depth_z, 
-                           double* water_content,  double* pressure_head, double* effective_porosity)
-{
-  int error = FALSE;
-  int ii, jj, jj_start;
-  t_o_profile_link *head_pt = NULL, *tmp_pt = NULL, tmp;
-  
-  // Initialize head pointer node, fake node.
-  tmp.depth    = domain->layer_top_depth;
-  tmp.theta    = domain->parameters->bin_water_content[domain->parameters->num_bins];
-  tmp.pressure = 0.0;
-  tmp.next     = NULL;
-  head_pt      = &tmp;
-  
-  assert(NULL != domain);
-  
-  // Find effective porosity.
-  *effective_porosity = domain->parameters->bin_water_content[domain->parameters->num_bins];
-  
-  // Step 1, map the to_domain water content into link list t_o_profile_link_link.
-  // Loop over bins, start from bin 2, since bin 1 is always saturated.
-  for (ii = 2; ii <= domain->parameters->num_bins; ii++)
-     {
-       // Surface front.
-       if (domain->surface_front[ii] > domain->layer_top_depth && domain->surface_front[ii] <= domain->layer_bottom_depth) // Add "<=" 10/09/14.
-         {
-           error = insert_t_o_profile_link(&head_pt, domain->surface_front[ii], domain->parameters->bin_water_content[ii], 
-                                                                               -domain->parameters->bin_capillary_suction[ii], domain->yes_groundwater);
-         }
-        
-       // Slug.
-       slug* temp_slug = domain->top_slug[ii];
-       while (NULL != temp_slug)
-         {
-           // slug top.
-           error = insert_t_o_profile_link(&head_pt, temp_slug->top, domain->parameters->bin_water_content[ii - 1], 
-                                                                    -domain->parameters->bin_capillary_suction[ii - 1], domain->yes_groundwater);
-           
-           // slug bottom.
-           error = insert_t_o_profile_link(&head_pt, temp_slug->bot, domain->parameters->bin_water_content[ii], 
-                                                                   -domain->parameters->bin_capillary_suction[ii], domain->yes_groundwater);
-           
-           temp_slug = temp_slug->next;
-         }
-        
-       // groundwater front. 
-       if (domain->yes_groundwater)
-         {
-           if (domain->groundwater_front[ii] > domain->layer_top_depth)
-             {
-              error = insert_t_o_profile_link(&head_pt, domain->groundwater_front[ii], domain->parameters->bin_water_content[ii - 1], 
-                                                                                 -domain->parameters->bin_capillary_suction[ii - 1], domain->yes_groundwater);
-             }
-         }
-     } // End of bin loop.
-  
-  // Insert fully saturated bin;
-  if (domain->yes_groundwater)
-    {
-      error = insert_t_o_profile_link(&head_pt, domain->layer_bottom_depth, domain->parameters->bin_water_content[domain->parameters->num_bins], 
-                                                          0.0, domain->yes_groundwater);
-    }
-  else
-    {
-      int first_bin = 2; // The leftmost bin that is not completely full of water.
- 
-      while (first_bin <= domain->parameters->num_bins && domain->parameters->bin_water_content[first_bin] <= domain->initial_water_content)
-       {
-         first_bin++;
-       }
-      error = insert_t_o_profile_link(&head_pt, domain->layer_bottom_depth, domain->parameters->bin_water_content[first_bin - 1], 
-                                                                         -domain->parameters->bin_capillary_suction[first_bin - 1], domain->yes_groundwater);
-    }
-
-  // Step 2, fill 1D array water content using t_o_profile_link_link.
-  tmp_pt   = head_pt;
-  jj_start = 1;
-  while (NULL != tmp_pt)
-    {
-      for (jj = jj_start; jj <= num_elements; jj++)
-         {
-           if (soil_depth_z[jj] <= tmp_pt->depth)
-             {
-               water_content[jj] = tmp_pt->theta;
-               pressure_head[jj] = tmp_pt->pressure;
-             }
-           else
-             {
-               jj_start = jj;
-               break;
-             }
-         }
-      tmp_pt = tmp_pt->next;
-    } 
-    
-  // Set head_pt to head_pt->next, as the first node is not malloc. Then free link-list.
-  head_pt = head_pt->next;
-  while (NULL != head_pt)
-    {
-       tmp_pt  = head_pt;
-       head_pt = head_pt->next;
-       free(tmp_pt);
-    }
-  
-  return error;
-} // End of get_t_o_domain_profile().
-
 // #####################################################################################################################################################
 // #####################################################################################################################################################
 int main(void)
 {
-    /*******************/
-   /* Initialize X11. */
-  /*******************/
-#ifdef YES_PLOT
-  Display* the_display = XOpenDisplay(NULL);
+    /****************************/
+   /* Initialize the renderer. */
+  /****************************/
+#if defined(YES_PLOT) || defined(FRAME_HOURS)
+  renderer* the_renderer;
+  int       yes_window   = FALSE; // Whether to show the window.
+  char*     frame_prefix = NULL;  // The start of the PPM frame file names.
+  double    frame_hours  = 0.0;   // Simulated hours between PPM frames.
 
-  if (NULL == the_display)
+#ifdef YES_PLOT
+  yes_window = TRUE;
+#endif // YES_PLOT
+#ifdef FRAME_HOURS
+  frame_prefix = "frame_";
+  frame_hours  = FRAME_HOURS;
+#endif // FRAME_HOURS
+
+  if (renderer_alloc(&the_renderer, yes_window, MAX_FRAMES_PER_SECOND, frame_prefix, frame_hours))
     {
-      fprintf(stderr, "ERROR: Could not open X display.\n");
+      fprintf(stderr, "ERROR: Could not start the renderer.\n");
       exit(1);
     }
-  int the_screen = DefaultScreen(the_display);
-
-  Font font;
- // if((font=XLoadFont(the_display,"-adobe-helvetica-bold-r-*-*-14-100-*-*-p-*-*-*"))==None)
-  if((font=XLoadFont(the_display,"-bitstream-bitstream charter-bold-i-normal--0-0-0-0-p-0-iso10646-1"))==None)
-    {
-    printf("Cannot load font: timb18\n");
-    //FIXME  should die here.
-    }
-
-  GC the_gc = DefaultGC(the_display, the_screen);
-  XSetFont(the_display,the_gc,font);
-
-
-  Window the_window = XCreateSimpleWindow(the_display, RootWindow(the_display, the_screen), 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT,
-                                        1, BlackPixel(the_display, the_screen), WhitePixel(the_display, the_screen));
-
-  XSelectInput(the_display, the_window, ExposureMask);
-  XMapWindow(the_display, the_window);
-
-  Pixmap the_pixmap = XCreatePixmap(the_display, the_window, WINDOW_WIDTH, WINDOW_HEIGHT, DefaultDepth(the_display, the_screen));
-
-  // We have to wait for at least one expose event before it will display anything.
-  XEvent the_event;
-
-  XNextEvent(the_display, &the_event);
-#endif
+#endif // defined(YES_PLOT) || defined(FRAME_HOURS)
 
     /*******************************/
    /* Create Talbot-Ogden domain. */
@@ -408,10 +142,9 @@ int main(void)
       
       double infiltration_rate     = 0.0;
       double groundwater_inf_rate = 0.0;
-      double rainfall_input_time[22973];
-      double rainfall_input_intensity[22973];
-      double potential_ET[22973];
-      char string[100];
+      forcing_file*  rain_file = NULL;              // The rainfall and PET file.
+      forcing_cursor rain_cursor;                   // The position in rain_file.
+      double         rain_mean[FORCING_MAX_VALUES]; // Rainfall and PET averaged over a timestep in mm / 15 min.
       
       double evaporated_water      = 0.0;
       double surfacewater_depth    = 0.0;                                                     // Meters.
@@ -752,8 +485,8 @@ int main(void)
 
   t_o_check_invariant(domain);
 
-#ifdef YES_PLOT
-   display_domain(current_time,the_display, the_screen, the_window, the_pixmap, domain);
+#if defined(YES_PLOT) || defined(FRAME_HOURS)
+   display_domain(current_time, the_renderer, domain);
 #endif
 
     /***********************/
@@ -761,31 +494,19 @@ int main(void)
   /***********************/
   if ( 1 == test_id || 101 <= test_id)
     {
-      // Read input rainfall file.
-      FILE*  rain_fptr      = NULL;
-  
-      if (NULL == (rain_fptr = fopen("example_rainfall_PET.txt", "r")))
+      // Open input rainfall file.  It is read a record at a time as the simulation goes.
+      if (forcing_open(&rain_file, "example_rainfall_PET.txt") || 2 > forcing_num_values(rain_file) ||
+          forcing_cursor_init(&rain_cursor, rain_file, FORCING_STEP))
         {
           printf("Error reading file example_rainfall_PET.txt \n");
           exit(1);
         }
-        
-      fgets(string, 100, rain_fptr);      // Ignore header.
-      for (ii = 1; ii <= 22972; ii++)
-         {
-           fscanf(rain_fptr, "%*d %*d %*d %*d %*d %lf %lf", &rainfall_input_intensity[ii], &potential_ET[ii]);  // Original data in mm /15 min.
-           rainfall_input_time[ii]       = (ii - 1) * 15.0 * 60.0;  // In s.
-           rainfall_input_intensity[ii] /= 900000.0;     // In m/s. 
-           rainfall_input_intensity[ii] *= 5.0;           // convert back to real values.
-           potential_ET[ii]             /= 900000.0;     // In m/s.
-         }
-      fclose(rain_fptr);
     }
   
 #define INFILTRATION_OUTPUT_FILE
 #ifdef INFILTRATION_OUTPUT_FILE
-  FILE*  f_fptr;                                                                          // File output of infiltration rate.
-  FILE*  acc_depth_fptr;
+  output_writer* f_writer;                                                                // File output of infiltration rate.
+  output_writer* acc_depth_writer;
   FILE* fptr_day_50;
   FILE* fptr_day_100;
   FILE* fptr_day_150;
@@ -820,12 +541,13 @@ int main(void)
          }
     }
          
-  if ((f_fptr = fopen("f.out", "w")) == NULL)
+  // Rows are formatted and written by a background thread.
+  if (output_writer_alloc(&f_writer, "f" OUTPUT_SUFFIX, 8, "%lf %lf %lf %lf %lf %lf %lf %lf \n", OUTPUT_BINARY))
     {
      fprintf(stderr, "ERROR: Could not open infiltration output file.\n");
      exit(1);
     }
-  if ((acc_depth_fptr = fopen("accum_depth.out", "w")) == NULL)
+  if (output_writer_alloc(&acc_depth_writer, "accum_depth" OUTPUT_SUFFIX, 2, "%lf %lf\n", OUTPUT_BINARY))
     {
      fprintf(stderr, "ERROR: Could not open accumulate depth output file.\n");
      exit(1);
@@ -837,7 +559,6 @@ int main(void)
   double** soil_depth_z;   
   double** water_content;   
   double** pressure_head;   
-  double effective_porosity;
   
   error =  dtwo_alloc(&soil_depth_z,  num_layers, num_elements);
   error =  dtwo_alloc(&water_content, num_layers, num_elements);
@@ -867,13 +588,13 @@ int main(void)
       // Rainfall.  ###########################################################
       if (1 == test_id  || 101 <= test_id)
         {
-          ii = 1;
-          while (ii < 22972 && current_time >= rainfall_input_time[ii + 1])
+          // Original data in mm /15 min.  A timestep that spans two records gets the right amount of each.
+          if (forcing_cursor_mean(&rain_cursor, current_time, current_time + delta_time, rain_mean))
             {
-             ii++;
+              exit(1);
             }
-          PET           = potential_ET[ii];                  // m/s.      ##################################### Set no PET.
-          rainfall_rate = rainfall_input_intensity[ii];      // m/s.
+          PET           = rain_mean[1] / 900000.0;           // m/s.      ##################################### Set no PET.
+          rainfall_rate = rain_mean[0] / 900000.0 * 5.0;     // m/s.  Times 5 to convert back to real values.
           rainfall      = rainfall_rate * delta_time;        // Meters of water.
         }
       else if (2 == test_id)
@@ -948,8 +669,8 @@ int main(void)
       {
         infiltration_rate    = (surfacewater_depth_old - surfacewater_depth) / delta_time * 100.0 * ONE_HOUR; // cm/hr.
         groundwater_inf_rate = (groundwater_recharge - groundwater_recharge_old) / delta_time * 100 * ONE_HOUR; // cm/hr.
-        fprintf(f_fptr, "%lf %lf %lf %lf %lf %lf %lf %lf \n", current_time, rainfall_rate * 360000.0, accu_rain * 100, infiltration_rate, accum_infil * 100.0,
-                                                            groundwater_inf_rate, groundwater_recharge * 100.0, evaporated_water * 100.0);
+        output_writer_row(f_writer, (double[]){current_time, rainfall_rate * 360000.0, accu_rain * 100, infiltration_rate, accum_infil * 100.0,
+                                               groundwater_inf_rate, groundwater_recharge * 100.0, evaporated_water * 100.0});
       }
 #else
       surfacewater_depth_old = surfacewater_depth_old; // Prevent unused variable warning.
@@ -960,8 +681,8 @@ int main(void)
       // printf("%lf %lf %lf %lf \n", current_time/86400, rainfall_rate * 360000.0, frate, rech);
   
       current_time += delta_time;
-#ifdef YES_PLOT
-      display_domain(current_time,the_display, the_screen, the_window, the_pixmap, domain);     
+#if defined(YES_PLOT) || defined(FRAME_HOURS)
+      display_domain(current_time, the_renderer, domain);
 #endif
       //usleep(1000);
        //printf("simulation time = %lf hr.\n", current_time / ONE_HOUR);
@@ -985,14 +706,14 @@ int main(void)
      
      assert(epsilon_equal(total_water, evaporated_water + surfacewater_depth + groundwater_recharge + t_o_total_water_in_domain(domain) + runoff));
       
-      fprintf(acc_depth_fptr, "%lf %lf\n", current_time, runoff * 100.0); // Time in s, runoff in cm.
+      output_writer_row(acc_depth_writer, (double[]){current_time, runoff * 100.0}); // Time in s, runoff in cm.
       //fprintf(acc_depth_fptr,"%lf %lf\n",current_time/86400.0, t_o_total_water_in_domain(domain)); 
       
       if ( 1 == test_id || 101 <= test_id)
         {
           if (abs(current_time - 50 * ONE_DAY) < delta_time && !get_1)
              {
-               get_t_o_domain_profile(domain, num_elements, soil_depth_z[1], water_content[1], pressure_head[1], &effective_porosity);
+               t_o_profile(domain, num_elements, soil_depth_z[1], water_content[1], pressure_head[1]);
                for (jj = 1; jj <= num_elements; jj++)
                   {
                     fprintf(fptr_day_50, "%lf %lf %lf\n", soil_depth_z[1][jj], water_content[1][jj], pressure_head[1][jj]);
@@ -1002,7 +723,7 @@ int main(void)
              }
            else if (abs(current_time - 100 * ONE_DAY) < delta_time && !get_2)
              {
-               get_t_o_domain_profile(domain, num_elements, soil_depth_z[1], water_content[1], pressure_head[1], &effective_porosity);
+               t_o_profile(domain, num_elements, soil_depth_z[1], water_content[1], pressure_head[1]);
                for (jj = 1; jj <= num_elements; jj++)
                   {
                     fprintf(fptr_day_100, "%lf %lf %lf\n", soil_depth_z[1][jj], water_content[1][jj], pressure_head[1][jj]);
@@ -1012,7 +733,7 @@ int main(void)
              }
            else if (abs(current_time - 150 * ONE_DAY) < delta_time && !get_3)
              {
-               get_t_o_domain_profile(domain, num_elements, soil_depth_z[1], water_content[1], pressure_head[1], &effective_porosity);
+               t_o_profile(domain, num_elements, soil_depth_z[1], water_content[1], pressure_head[1]);
                for (jj = 1; jj <= num_elements; jj++)
                   {
                     fprintf(fptr_day_150 ,"%lf %lf %lf\n", soil_depth_z[1][jj], water_content[1][jj], pressure_head[1][jj]);
@@ -1022,7 +743,7 @@ int main(void)
              }
            else if (abs(current_time - 200 * ONE_DAY) < delta_time && !get_4)
              {
-               get_t_o_domain_profile(domain, num_elements, soil_depth_z[1], water_content[1], pressure_head[1], &effective_porosity);
+               t_o_profile(domain, num_elements, soil_depth_z[1], water_content[1], pressure_head[1]);
                for (jj = 1; jj <= num_elements; jj++)
                   {
                     fprintf(fptr_day_200, "%lf %lf %lf\n", soil_depth_z[1][jj], water_content[1][jj], pressure_head[1][jj]);
@@ -1059,14 +780,24 @@ int main(void)
       fclose(fptr_day_150);
       fclose(fptr_day_200);
     }
+  if (NULL != rain_file)
+    {
+      forcing_close(&rain_file);
+    }
   t_o_domain_dealloc(&domain);
   t_o_parameters_dealloc(&parameters);
-#ifdef YES_PLOT
-   XCloseDisplay(the_display);
+#if defined(YES_PLOT) || defined(FRAME_HOURS)
+  if (renderer_dealloc(&the_renderer))
+    {
+      fprintf(stderr, "ERROR: Could not write frames.\n");
+    }
 #endif
 #ifdef INFILTRATION_OUTPUT_FILE
-  fclose(f_fptr);
-  fclose(acc_depth_fptr);
+  error = output_writer_dealloc(&f_writer);
+  if (output_writer_dealloc(&acc_depth_writer) || error)
+    {
+      fprintf(stderr, "ERROR: Could not write output files.\n");
+    }
 #endif // INFILTRATION_OUTPUT_FILE
 
   return 0;
@@ -0,0 +1,731 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "forcing.h"
+#include "memfunc.h"
+#include "all.h"
+
+#define FORCING_MAGIC       "TOFORCE1" // The first eight bytes of a binary forcing file.
+#define FORCING_MAX_TOKEN   (64)       // The longest number that is copied for strtod.
+#define FORCING_FAST_DIGITS (15)       // Numbers with at most this many significant digits are all exactly representable.
+
+/* A binary forcing file is a forcing_binary_header followed by num_records
+ * records.  Each record is the timestamp as an int64_t number of seconds since
+ * 1970-01-01 00:00 followed by num_values doubles.  Everything is in the byte
+ * order of the machine that wrote the file.
+ */
+typedef struct
+{
+  char    magic[8];        // FORCING_MAGIC, not NUL terminated.
+  int32_t num_values;      // The number of values in each record.
+  int32_t num_records;     // The number of records in the file.
+  int64_t first_timestamp; // The timestamp of the first record.
+  int64_t reserved;        // Zero.  Pads the header so that records are eight byte aligned.
+} forcing_binary_header;
+
+struct forcing_file
+{
+  const char* data;            // The memory mapping of the whole file.
+  size_t      size;            // The number of bytes in data.
+  int         binary;          // Whether this is a binary forcing file.
+  size_t      first_record;    // Byte offset in data of the first record.
+  int         num_records;     // The number of records in the file.
+  int         num_values;      // The number of values in each record.
+  int64_t     first_timestamp; // Seconds since 1970-01-01 00:00 of the first record.
+};
+
+/* Return the number of days from 1970-01-01 to year-month-day in the
+ * proleptic Gregorian calendar.  This does not depend on the time zone the
+ * way mktime does.  Algorithm from Howard Hinnant, "chrono-Compatible
+ * Low-Level Date Algorithms".
+ */
+static int64_t days_from_civil(int year, int month, int day)
+{
+  int64_t  era;               // 400 year period.
+  unsigned year_of_era;       // 0 to 399.
+  unsigned day_of_year;       // 0 to 365 counting from March 1.
+  unsigned day_of_era;        // 0 to 146096.
+
+  year       -= (2 >= month);
+  era         = ((0 <= year) ? year : year - 399) / 400;
+  year_of_era = (unsigned)(year - era * 400);
+  day_of_year = (153 * (month + ((2 < month) ? -3 : 9)) + 2) / 5 + day - 1;
+  day_of_era  = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+
+  return era * 146097 + (int64_t)day_of_era - 719468;
+}
+
+// The inverse of days_from_civil.
+static void civil_from_days(int64_t days, int* year, int* month, int* day)
+{
+  int64_t  era;         // 400 year period.
+  unsigned day_of_era;  // 0 to 146096.
+  unsigned year_of_era; // 0 to 399.
+  unsigned day_of_year; // 0 to 365 counting from March 1.
+  unsigned month_index; // 0 to 11 counting from March.
+
+  days       += 719468;
+  era         = ((0 <= days) ? days : days - 146096) / 146097;
+  day_of_era  = (unsigned)(days - era * 146097);
+  year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+  day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+  month_index = (5 * day_of_year + 2) / 153;
+  *day        = day_of_year - (153 * month_index + 2) / 5 + 1;
+  *month      = (10 > month_index) ? month_index + 3 : month_index - 9;
+  *year       = (int)(year_of_era + era * 400) + (2 >= *month);
+}
+
+// Return the timestamp of record in seconds since 1970-01-01 00:00.
+static int64_t record_timestamp(const forcing_record* record)
+{
+  return ((days_from_civil(record->year, record->month, record->day) * 24 + record->hour) * 60 + record->minute) * 60;
+}
+
+// Skip spaces, tabs, and carriage returns, but not newlines.
+static const char* skip_blanks(const char* position, const char* end)
+{
+  while (position < end && (' ' == *position || '\t' == *position || '\r' == *position))
+    {
+      position++;
+    }
+
+  return position;
+}
+
+// Return the start of the next line that has a record on it, skipping blank lines and comments, or end if there is none.
+static const char* find_record_line(const char* position, const char* end)
+{
+  while (position < end)
+    {
+      position = skip_blanks(position, end);
+
+      if (position < end && '\n' != *position && '#' != *position)
+        {
+          break;
+        }
+
+      // Skip the rest of the line.
+      position = memchr(position, '\n', end - position);
+      position = (NULL == position) ? end : position + 1;
+    }
+
+  return position;
+}
+
+/* Parse a non-negative integer.
+ * Return the position after the integer or NULL if there is no integer.
+ */
+static const char* parse_int(const char* position, const char* end, int* value)
+{
+  const char* start;
+
+  position = skip_blanks(position, end);
+  start    = position;
+  *value   = 0;
+
+  while (position < end && '0' <= *position && '9' >= *position && position - start < 9)
+    {
+      *value = *value * 10 + (*position - '0');
+      position++;
+    }
+
+  return (start == position) ? NULL : position;
+}
+
+/* Parse a double.  Numbers with at most FORCING_FAST_DIGITS significant
+ * digits and a small decimal exponent, which is every number in a typical
+ * forcing file, are converted with a single correctly rounded multiplication
+ * or division by an exact power of ten so the result is the same as strtod.
+ * Anything else is passed to strtod.
+ * Return the position after the number or NULL if there is no number.
+ */
+static const char* parse_double(const char* position, const char* end, double* value)
+{
+  static const double powers_of_ten[] = {1.0e0,  1.0e1,  1.0e2,  1.0e3,  1.0e4,  1.0e5,  1.0e6,  1.0e7,  1.0e8,  1.0e9,  1.0e10, 1.0e11,
+                                         1.0e12, 1.0e13, 1.0e14, 1.0e15, 1.0e16, 1.0e17, 1.0e18, 1.0e19, 1.0e20, 1.0e21, 1.0e22};
+  const char* start;                  // The first character of the number.
+  const char* token_end;              // The first character after the number.
+  int         negative       = FALSE; // Whether there is a minus sign.
+  int64_t     mantissa       = 0;     // The significant digits as an integer.
+  int         num_digits     = 0;     // The number of significant digits in mantissa.
+  int         exponent       = 0;     // The power of ten to multiply mantissa by.
+  int         explicit_power = 0;     // The exponent after e or E.
+  int         fast           = TRUE;  // Whether the fast path can be used.
+  int         any_digits     = FALSE; // Whether there were any digits before the exponent.
+  char        token[FORCING_MAX_TOKEN];
+  char*       strtod_end;
+
+  position  = skip_blanks(position, end);
+  start     = position;
+  token_end = position;
+
+  while (token_end < end && ' ' != *token_end && '\t' != *token_end && '\r' != *token_end && '\n' != *token_end)
+    {
+      token_end++;
+    }
+
+  if (position < token_end && ('-' == *position || '+' == *position))
+    {
+      negative = ('-' == *position);
+      position++;
+    }
+
+  for (; position < token_end && '0' <= *position && '9' >= *position; position++)
+    {
+      any_digits = TRUE;
+
+      if (0 < num_digits || '0' != *position)
+        {
+          num_digits++;
+          fast     = fast && FORCING_FAST_DIGITS >= num_digits;
+          mantissa = fast ? mantissa * 10 + (*position - '0') : mantissa;
+        }
+    }
+
+  if (position < token_end && '.' == *position)
+    {
+      for (position++; position < token_end && '0' <= *position && '9' >= *position; position++)
+        {
+          any_digits = TRUE;
+
+          if (0 < num_digits || '0' != *position)
+            {
+              num_digits++;
+              fast     = fast && FORCING_FAST_DIGITS >= num_digits;
+              mantissa = fast ? mantissa * 10 + (*position - '0') : mantissa;
+            }
+
+          exponent--;
+        }
+    }
+
+  if (position < token_end && any_digits && ('e' == *position || 'E' == *position))
+    {
+      int negative_power = FALSE;
+
+      position++;
+
+      if (position < token_end && ('-' == *position || '+' == *position))
+        {
+          negative_power = ('-' == *position);
+          position++;
+        }
+
+      fast = fast && position < token_end;
+
+      for (; position < token_end && '0' <= *position && '9' >= *position; position++)
+        {
+          fast           = fast && 1000 > explicit_power;
+          explicit_power = fast ? explicit_power * 10 + (*position - '0') : explicit_power;
+        }
+
+      exponent += negative_power ? -explicit_power : explicit_power;
+    }
+
+  fast = fast && any_digits && position == token_end && -22 <= exponent && 22 >= exponent;
+
+  if (fast)
+    {
+      *value = (0 <= exponent) ? (double)mantissa * powers_of_ten[exponent] : (double)mantissa / powers_of_ten[-exponent];
+      *value = negative ? -*value : *value;
+    }
+  else if (start < token_end && FORCING_MAX_TOKEN > token_end - start)
+    {
+      memcpy(token, start, token_end - start);
+      token[token_end - start] = '\0';
+      *value                   = strtod(token, &strtod_end);
+
+      if (token + (token_end - start) != strtod_end)
+        {
+          token_end = NULL;
+        }
+    }
+  else
+    {
+      token_end = NULL;
+    }
+
+  return token_end;
+}
+
+/* Parse the record on the line starting at position.  If num_values is
+ * zero count the values, otherwise the line must have exactly num_values.
+ * Return the start of the next line or NULL if there is an error.
+ */
+static const char* parse_record(const char* position, const char* end, forcing_record* record, int* num_values)
+{
+  int count = 0; // The number of values parsed.
+
+  position = parse_int(position, end, &record->year);
+  position = (NULL == position) ? NULL : parse_int(position, end, &record->month);
+  position = (NULL == position) ? NULL : parse_int(position, end, &record->day);
+  position = (NULL == position) ? NULL : parse_int(position, end, &record->hour);
+  position = (NULL == position) ? NULL : parse_int(position, end, &record->minute);
+
+  if (NULL != position)
+    {
+      position = skip_blanks(position, end);
+
+      while (NULL != position && position < end && '\n' != *position && (0 == *num_values || count < *num_values) && FORCING_MAX_VALUES > count)
+        {
+          position = parse_double(position, end, &record->value[count++]);
+          position = (NULL == position) ? NULL : skip_blanks(position, end);
+        }
+    }
+
+  if (NULL != position && position < end && '\n' != *position)
+    {
+      // More values than expected or FORCING_MAX_VALUES.
+      position = NULL;
+    }
+
+  if (NULL != position && 0 == *num_values)
+    {
+      *num_values = count;
+    }
+
+  if (NULL != position && (0 == count || count != *num_values))
+    {
+      position = NULL;
+    }
+
+#if (DEBUG_LEVEL & DEBUG_LEVEL_USER_INPUT_SIMPLE)
+  if (NULL != position && (1 > record->month || 12 < record->month || 1 > record->day || 31 < record->day || 23 < record->hour ||
+                           59 < record->minute))
+    {
+      position = NULL;
+    }
+#endif // (DEBUG_LEVEL & DEBUG_LEVEL_USER_INPUT_SIMPLE)
+
+  return (NULL == position || position == end) ? position : position + 1;
+}
+
+/* Comment in .h file. */
+int forcing_open(forcing_file** file, const char* path)
+{
+  int                   error     = FALSE; // Error flag.
+  int                   fd        = -1;    // File descriptor.
+  struct stat           file_stat;
+  void*                 data      = MAP_FAILED;
+  const char*           position;
+  const char*           end;
+  forcing_record        record;
+  forcing_binary_header header;
+
+  if (NULL == file)
+    {
+      fprintf(stderr, "ERROR: file must not be NULL\n");
+      error = TRUE;
+    }
+  else
+    {
+      *file = NULL;
+    }
+
+  if (NULL == path)
+    {
+      fprintf(stderr, "ERROR: path must not be NULL\n");
+      error = TRUE;
+    }
+
+  if (!error)
+    {
+      fd = open(path, O_RDONLY);
+
+      if (-1 == fd || -1 == fstat(fd, &file_stat))
+        {
+          fprintf(stderr, "ERROR: Could not open forcing file %s\n", path);
+          error = TRUE;
+        }
+      else if (0 == file_stat.st_size)
+        {
+          fprintf(stderr, "ERROR: Forcing file %s is empty\n", path);
+          error = TRUE;
+        }
+    }
+
+  if (!error)
+    {
+      // The mapping is read only and shared so every process that maps the file shares the same pages.
+      data = mmap(NULL, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+      if (MAP_FAILED == data)
+        {
+          fprintf(stderr, "ERROR: Could not memory map forcing file %s\n", path);
+          error = TRUE;
+        }
+      else
+        {
+          madvise(data, file_stat.st_size, MADV_SEQUENTIAL);
+        }
+    }
+
+  if (-1 != fd)
+    {
+      close(fd);
+    }
+
+  if (!error)
+    {
+      error = v_alloc((void**)file, sizeof(forcing_file));
+    }
+
+  if (!error)
+    {
+      (*file)->data = data;
+      (*file)->size = file_stat.st_size;
+      end           = (*file)->data + (*file)->size;
+
+      if (sizeof(forcing_binary_header) <= (*file)->size && 0 == memcmp((*file)->data, FORCING_MAGIC, sizeof(header.magic)))
+        {
+          memcpy(&header, (*file)->data, sizeof(forcing_binary_header));
+
+          (*file)->binary          = TRUE;
+          (*file)->first_record    = sizeof(forcing_binary_header);
+          (*file)->num_records     = header.num_records;
+          (*file)->num_values      = header.num_values;
+          (*file)->first_timestamp = header.first_timestamp;
+
+          if (1 > header.num_values || FORCING_MAX_VALUES < header.num_values || 0 > header.num_records ||
+              (*file)->size != sizeof(forcing_binary_header) + (size_t)header.num_records * (1 + header.num_values) * sizeof(double))
+            {
+              fprintf(stderr, "ERROR: Binary forcing file %s is corrupt\n", path);
+              error = TRUE;
+            }
+        }
+      else
+        {
+          (*file)->binary       = FALSE;
+          position              = find_record_line((*file)->data, end);
+          (*file)->first_record = position - (*file)->data;
+          (*file)->num_values   = 0;
+
+          if (position == end || NULL == parse_record(position, end, &record, &(*file)->num_values))
+            {
+              fprintf(stderr, "ERROR: The first record of forcing file %s is not YYYY MM DD HH MM followed by 1 to %d values\n", path,
+                      FORCING_MAX_VALUES);
+              error = TRUE;
+            }
+          else
+            {
+              (*file)->first_timestamp = record_timestamp(&record);
+
+              // Count the records without parsing them.
+              for ((*file)->num_records = 0; position < end; (*file)->num_records++)
+                {
+                  position = memchr(position, '\n', end - position);
+                  position = find_record_line((NULL == position) ? end : position + 1, end);
+                }
+            }
+        }
+    }
+
+  if (error)
+    {
+      if (NULL != file && NULL != *file)
+        {
+          forcing_close(file);
+        }
+      else if (MAP_FAILED != data)
+        {
+          munmap(data, file_stat.st_size);
+        }
+    }
+
+  return error;
+}
+
+/* Comment in .h file. */
+void forcing_close(forcing_file** file)
+{
+  if (NULL != file && NULL != *file)
+    {
+      munmap((void*)(*file)->data, (*file)->size);
+      v_dealloc((void**)file, sizeof(forcing_file));
+    }
+}
+
+/* Comment in .h file. */
+int forcing_num_records(const forcing_file* file)
+{
+  return file->num_records;
+}
+
+/* Comment in .h file. */
+int forcing_num_values(const forcing_file* file)
+{
+  return file->num_values;
+}
+
+/* Comment in .h file. */
+void forcing_stream_init(forcing_stream* stream, const forcing_file* file)
+{
+  stream->file     = file;
+  stream->position = file->first_record;
+  stream->index    = 1;
+}
+
+/* Comment in .h file. */
+int forcing_read(forcing_stream* stream, forcing_record* record, int* end_of_file)
+{
+  int                 error      = FALSE;               // Error flag.
+  const forcing_file* file       = stream->file;
+  const char*         end        = file->data + file->size;
+  const char*         position   = file->data + stream->position;
+  int                 num_values = file->num_values;
+  int64_t             timestamp  = 0;                    // Seconds since 1970-01-01 00:00.
+  int64_t             seconds_of_day;
+
+  *end_of_file = (stream->index > file->num_records);
+
+  if (!*end_of_file && file->binary)
+    {
+      memcpy(&timestamp, position, sizeof(int64_t));
+      memcpy(record->value, position + sizeof(int64_t), num_values * sizeof(double));
+
+      civil_from_days((timestamp >= 0) ? timestamp / 86400 : (timestamp - 86399) / 86400, &record->year, &record->month, &record->day);
+      seconds_of_day   = timestamp - days_from_civil(record->year, record->month, record->day) * 86400;
+      record->hour     = (int)(seconds_of_day / 3600);
+      record->minute   = (int)(seconds_of_day % 3600 / 60);
+      stream->position += (1 + num_values) * sizeof(double);
+    }
+  else if (!*end_of_file)
+    {
+      position = parse_record(find_record_line(position, end), end, record, &num_values);
+
+      if (NULL == position)
+        {
+          fprintf(stderr, "ERROR: Forcing record %d is not YYYY MM DD HH MM followed by %d values\n", stream->index, file->num_values);
+          error = TRUE;
+        }
+      else
+        {
+          timestamp        = record_timestamp(record);
+          stream->position = position - file->data;
+        }
+    }
+
+  if (!error && !*end_of_file)
+    {
+      record->time = (double)(timestamp - file->first_timestamp);
+      stream->index++;
+    }
+
+  return error;
+}
+
+/* Comment in .h file. */
+int forcing_cursor_init(forcing_cursor* cursor, const forcing_file* file, int interpolation)
+{
+  int error       = FALSE; // Error flag.
+  int end_of_file = FALSE;
+
+  if (FORCING_STEP != interpolation && FORCING_LINEAR != interpolation)
+    {
+      fprintf(stderr, "ERROR: interpolation must be FORCING_STEP or FORCING_LINEAR\n");
+      error = TRUE;
+    }
+
+  if (!error)
+    {
+      forcing_stream_init(&cursor->stream, file);
+
+      cursor->interpolation = interpolation;
+      cursor->num_values    = file->num_values;
+      cursor->time          = 0.0;
+      error                 = forcing_read(&cursor->stream, &cursor->current, &end_of_file);
+    }
+
+  if (!error)
+    {
+      error = forcing_read(&cursor->stream, &cursor->next, &end_of_file);
+    }
+
+  if (!error)
+    {
+      cursor->has_next = !end_of_file;
+    }
+
+  return error;
+}
+
+/* Move cursor forward so that current is the last record whose time is less
+ * than or equal to time.
+ * Return TRUE if there is an error, FALSE otherwise.
+ */
+static int forcing_cursor_advance(forcing_cursor* cursor, double time)
+{
+  int error       = FALSE; // Error flag.
+  int end_of_file = FALSE;
+
+  if (time < cursor->time)
+    {
+      fprintf(stderr, "ERROR: forcing cursor time %lf is before time %lf that it was already asked for\n", time, cursor->time);
+      error = TRUE;
+    }
+  else
+    {
+      cursor->time = time;
+    }
+
+  while (!error && cursor->has_next && time >= cursor->next.time)
+    {
+      cursor->current  = cursor->next;
+      error            = forcing_read(&cursor->stream, &cursor->next, &end_of_file);
+      cursor->has_next = !end_of_file;
+    }
+
+  return error;
+}
+
+/* Fill in value with the values of the forcing at time, which must be in
+ * the interval of cursor->current.
+ */
+static void forcing_cursor_interpolate(forcing_cursor* cursor, double time, double* value)
+{
+  int    ii;       // Loop counter.
+  double fraction; // How far time is from current to next.
+
+  if (FORCING_LINEAR == cursor->interpolation && cursor->has_next && time > cursor->current.time)
+    {
+      fraction = (time - cursor->current.time) / (cursor->next.time - cursor->current.time);
+
+      for (ii = 0; ii < cursor->num_values; ii++)
+        {
+          value[ii] = cursor->current.value[ii] + (cursor->next.value[ii] - cursor->current.value[ii]) * fraction;
+        }
+    }
+  else
+    {
+      for (ii = 0; ii < cursor->num_values; ii++)
+        {
+          value[ii] = cursor->current.value[ii];
+        }
+    }
+}
+
+/* Comment in .h file. */
+int forcing_cursor_value(forcing_cursor* cursor, double time, double* value)
+{
+  int error = forcing_cursor_advance(cursor, time); // Error flag.
+
+  if (!error)
+    {
+      forcing_cursor_interpolate(cursor, time, value);
+    }
+
+  return error;
+}
+
+/* Comment in .h file. */
+int forcing_cursor_mean(forcing_cursor* cursor, double start_time, double end_time, double* mean)
+{
+  int    error = FALSE;                   // Error flag.
+  int    ii;                              // Loop counter.
+  double piece_start;                     // Seconds.  The start of the part of the timestep in one record.
+  double piece_end   = start_time;        // Seconds.  The end   of the part of the timestep in one record.
+  double piece_mean[FORCING_MAX_VALUES];  // The average values over the piece.
+
+  error = forcing_cursor_advance(cursor, start_time);
+
+  if (!error && (end_time <= start_time || !cursor->has_next || end_time <= cursor->next.time))
+    {
+      // The whole timestep is in one record.  The average of a linear function is its value at the midpoint.
+      forcing_cursor_interpolate(cursor, (FORCING_LINEAR == cursor->interpolation && end_time > start_time) ? 0.5 * (start_time + end_time) :
+                                 start_time, mean);
+    }
+  else if (!error)
+    {
+      // Split the timestep at record boundaries and weight each piece by its duration.
+      for (ii = 0; ii < cursor->num_values; ii++)
+        {
+          mean[ii] = 0.0;
+        }
+
+      for (piece_start = start_time; !error && piece_start < end_time; piece_start = piece_end)
+        {
+          error = forcing_cursor_advance(cursor, piece_start);
+
+          if (!error)
+            {
+              piece_end = (cursor->has_next && cursor->next.time < end_time) ? cursor->next.time : end_time;
+
+              forcing_cursor_interpolate(cursor, (FORCING_LINEAR == cursor->interpolation) ? 0.5 * (piece_start + piece_end) : piece_start,
+                                         piece_mean);
+
+              for (ii = 0; ii < cursor->num_values; ii++)
+                {
+                  mean[ii] += piece_mean[ii] * (piece_end - piece_start);
+                }
+            }
+        }
+
+      for (ii = 0; ii < cursor->num_values; ii++)
+        {
+          mean[ii] /= end_time - start_time;
+        }
+    }
+
+  return error;
+}
+
+/* Comment in .h file. */
+int forcing_write_binary(const forcing_file* file, const char* path)
+{
+  int                   error       = FALSE; // Error flag.
+  int                   end_of_file = FALSE;
+  FILE*                 fptr        = NULL;
+  forcing_stream        stream;
+  forcing_record        record;
+  forcing_binary_header header;
+  int64_t               timestamp;
+
+  if (NULL == (fptr = fopen(path, "wb")))
+    {
+      fprintf(stderr, "ERROR: Could not open %s for writing\n", path);
+      error = TRUE;
+    }
+
+  if (!error)
+    {
+      memset(&header, 0, sizeof(forcing_binary_header));
+      memcpy(header.magic, FORCING_MAGIC, sizeof(header.magic));
+
+      header.num_values      = file->num_values;
+      header.num_records     = file->num_records;
+      header.first_timestamp = file->first_timestamp;
+
+      error = (1 != fwrite(&header, sizeof(forcing_binary_header), 1, fptr));
+    }
+
+  forcing_stream_init(&stream, file);
+
+  while (!error && !end_of_file)
+    {
+      error = forcing_read(&stream, &record, &end_of_file);
+
+      if (!error && !end_of_file)
+        {
+          timestamp = file->first_timestamp + (int64_t)record.time;
+          error     = (1 != fwrite(&timestamp, sizeof(int64_t), 1, fptr)) ||
+              (size_t)file->num_values != fwrite(record.value, sizeof(double), file->num_values, fptr);
+        }
+    }
+
+  if (NULL != fptr && fclose(fptr))
+    {
+      error = TRUE;
+    }
+
+  if (error)
+    {
+      fprintf(stderr, "ERROR: Could not write binary forcing file %s\n", path);
+    }
+
+  return error;
+}
@@ -0,0 +1,188 @@
+#ifndef FORCING_H
+#define FORCING_H
+
+#include <stddef.h>
+
+/* Reader for time series forcing files such as rainfall and potential
+ * evapotranspiration.  A text forcing file has one record per line like this:
+ *
+ * #YYYY MM DD HH MM P(mm) PET(mm)
+ * 2009  5  6 17  0 0.00000 0.02100
+ * 2009  5  6 17 15 0.00000 0.04200
+ *
+ * A timestamp of year, month, day, hour, and minute is followed by one or
+ * more values.  Lines starting with # are comments.  Every record must have
+ * the same number of values.  Timestamps are civil time with no time zone or
+ * daylight saving time and must not decrease.
+ *
+ * The file is memory mapped read only and records are parsed as they are
+ * streamed so the whole file is never copied into arrays.  forcing_write_binary
+ * converts a text forcing file to a compact binary forcing file that
+ * forcing_open also reads and that needs no parsing at all.  Because the
+ * mapping is read only and shared, one forcing_file can be read by any number
+ * of forcing_streams in any number of threads, and every process that opens
+ * the same file shares the same pages of memory.
+ */
+
+#define FORCING_MAX_VALUES (8) // The most values a record can have after its timestamp.
+
+// One record of a forcing file.
+typedef struct
+{
+  int    year;                      // Four digit year.
+  int    month;                     // 1 to 12.
+  int    day;                       // 1 to 31.
+  int    hour;                      // 0 to 23.
+  int    minute;                    // 0 to 59.
+  double time;                      // Seconds since the timestamp of the first record in the file.
+  double value[FORCING_MAX_VALUES]; // The values after the timestamp in the order they are in the file.
+                                    // Only the first num_values are used.
+} forcing_record;
+
+/* A forcing_file struct is a read only memory mapping of a text or binary
+ * forcing file.  It is not modified after forcing_open returns.
+ */
+typedef struct forcing_file forcing_file;
+
+/* A forcing_stream struct is a position in a forcing_file.  Give each
+ * reader its own forcing_stream.
+ */
+typedef struct
+{
+  const forcing_file* file;     // The file being read.
+  size_t              position; // Byte offset in the mapping of the next record.
+  int                 index;    // One based index of the next record.
+} forcing_stream;
+
+// How a forcing_cursor gives values between the times of records.
+#define FORCING_STEP   (0) // Each record's values hold until the time of the next record.
+#define FORCING_LINEAR (1) // Values are interpolated linearly between the times of records.
+
+/* A forcing_cursor struct gives the values of a forcing file at any time by
+ * keeping the record whose interval contains the time and the record after
+ * it.  Times must not decrease from one call to the next, so the cursor only
+ * ever moves forward and finding the record for a timestep is amortized
+ * constant time no matter how the timestep compares to the interval between
+ * records.  Before the first record the first record's values are used.
+ * After the last record its values hold forever.  Give each reader its own
+ * forcing_cursor.
+ */
+typedef struct
+{
+  forcing_stream stream;        // Reads the records after next.
+  int            interpolation; // FORCING_STEP or FORCING_LINEAR.
+  int            num_values;    // The number of values in each record.
+  int            has_next;      // Whether there is a record after current.  If FALSE next is not used.
+  forcing_record current;       // The last record whose time is less than or equal to time.
+  forcing_record next;          // The record after current.
+  double         time;          // The latest time the cursor was asked for in seconds since the first record.
+} forcing_cursor;
+
+/* Memory map a text or binary forcing file.  Binary files are recognized by
+ * their header.  Text files are scanned once to count the records.  Each
+ * record is checked when it is read.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * file - A pointer passed by reference which will be assigned to point to the
+ *        newly allocated forcing_file or NULL if there is an error.
+ * path - The name of the file to open.
+ */
+int forcing_open(forcing_file** file, const char* path);
+
+/* Unmap a forcing_file and free its memory.  Any forcing_streams reading it
+ * become invalid.
+ *
+ * Parameters:
+ *
+ * file - A pointer to the forcing_file passed by reference.
+ *        Will be set to NULL after it is deallocated.
+ */
+void forcing_close(forcing_file** file);
+
+/* Return the number of records in file. */
+int forcing_num_records(const forcing_file* file);
+
+/* Return the number of values after the timestamp in each record of file. */
+int forcing_num_values(const forcing_file* file);
+
+/* Position stream at the first record of file.
+ *
+ * Parameters:
+ *
+ * stream - A pointer to the forcing_stream to initialize.
+ * file   - A pointer to the forcing_file to read.
+ */
+void forcing_stream_init(forcing_stream* stream, const forcing_file* file);
+
+/* Read the next record from stream.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * stream      - A pointer to the forcing_stream.
+ * record      - A pointer to a forcing_record that is filled in with the next
+ *               record.  Not modified at the end of the file.
+ * end_of_file - Scalar passed by reference.  Set to TRUE if there are no
+ *               more records, FALSE otherwise.
+ */
+int forcing_read(forcing_stream* stream, forcing_record* record, int* end_of_file);
+
+/* Position cursor at the first record of file.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * cursor        - A pointer to the forcing_cursor to initialize.
+ * file          - A pointer to the forcing_file to read.
+ * interpolation - FORCING_STEP or FORCING_LINEAR.
+ */
+int forcing_cursor_init(forcing_cursor* cursor, const forcing_file* file, int interpolation);
+
+/* Get the values of the forcing at time.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * cursor - A pointer to the forcing_cursor.
+ * time   - Seconds since the first record.  Must be greater than or equal
+ *          to every time the cursor has been asked for before.
+ * value  - 1D array of at least num_values elements that is filled in with
+ *          the value of each column of the forcing at time.
+ */
+int forcing_cursor_value(forcing_cursor* cursor, double time, double* value);
+
+/* Get the average values of the forcing from start_time to end_time.  The
+ * values are treated as rates, so if a timestep spans the boundary between
+ * records each record contributes in proportion to the part of the timestep
+ * it covers.  Multiply by the duration to get the total depth of rainfall in
+ * a timestep split correctly across record boundaries.  When the timestep is
+ * within one record and interpolation is FORCING_STEP the average is exactly
+ * the record's values.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * cursor     - A pointer to the forcing_cursor.
+ * start_time - Seconds since the first record.  Must be greater than or
+ *              equal to every time the cursor has been asked for before.
+ * end_time   - Seconds since the first record.  If it is not greater than
+ *              start_time the values at start_time are returned.
+ * mean       - 1D array of at least num_values elements that is filled in
+ *              with the average value of each column of the forcing.
+ */
+int forcing_cursor_mean(forcing_cursor* cursor, double start_time, double end_time, double* mean);
+
+/* Write the records of file to a binary forcing file.  Converting a long
+ * text record once saves parsing it at the start of every run.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * file - A pointer to the forcing_file to convert.
+ * path - The name of the binary file to write.
+ */
+int forcing_write_binary(const forcing_file* file, const char* path);
+
+#endif // FORCING_H
@@ -1,34 +1,240 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
 #include <assert.h>
 #include "memfunc.h"
 #include "all.h"
 
 #define THREAD_SAFE // Leave this defined to have the code use mutexes to be thread safe.
 
+/* Leak tracking records every allocation in a hash table so that
+ * v_dealloc can check the number of bytes freed and check_all_memory_freed
+ * can report what was never freed.  It costs a hash table insert and delete
+ * under a mutex on every allocation so it is only done at debug levels that
+ * include internal assertions.  At the production debug levels v_alloc and
+ * v_dealloc are just calloc and free.
+ */
+#if (DEBUG_LEVEL & DEBUG_LEVEL_INTERNAL_ASSERTIONS)
+#define TRACK_ALLOCATIONS
+#endif // (DEBUG_LEVEL & DEBUG_LEVEL_INTERNAL_ASSERTIONS)
+
+#ifdef TRACK_ALLOCATIONS
 #ifdef THREAD_SAFE
 #include <pthread.h>
 
 static pthread_mutex_t allocated_mutex = PTHREAD_MUTEX_INITIALIZER;
 #endif // THREAD_SAFE
 
-// A singly linked list that records what memory was allocated.
-typedef struct allocation_record allocation_record;
-struct allocation_record
+#define ALLOCATED_MIN_CAPACITY (1024) // The number of slots in allocated when it is first allocated.  Must be a power of two.
+
+// A slot in the hash table that records what memory was allocated.
+typedef struct
 {
-  void*              location; // The pointer to the allocated memory.
-  int                bytes;    // The number of bytes allocated.
-  allocation_record* next;     // The next record in the list.
-};
+  void* location; // The pointer to the allocated memory or NULL if the slot is empty.
+  int   bytes;    // The number of bytes allocated.
+} allocation_record;
+
+/* allocated is an open addressing hash table with linear probing keyed by
+ * location.  It is kept at most half full so that finding, inserting, and
+ * removing a record are all expected constant time.
+ */
+static allocation_record* allocated          = NULL; // 1D array of allocated_capacity slots.
+static size_t             allocated_capacity = 0;    // The number of slots in allocated.  Zero or a power of two.
+static size_t             allocated_count    = 0;    // The number of records in allocated.
+
+// Return the slot where the search for location starts.
+static size_t allocation_hash(void* location)
+{
+  uint64_t hash = (uint64_t)(uintptr_t)location;
+
+  // The finalizer from MurmurHash3.  The low bits of pointers are mostly zero so they have to be mixed with the high bits.
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+
+  return (size_t)hash & (allocated_capacity - 1);
+}
+
+// Put a record in allocated.  There must be an empty slot.
+static void insert_allocation_record(void* location, int bytes)
+{
+  size_t slot = allocation_hash(location);
+
+  while (NULL != allocated[slot].location)
+    {
+      slot = (slot + 1) & (allocated_capacity - 1);
+    }
+
+  allocated[slot].location = location;
+  allocated[slot].bytes    = bytes;
+  allocated_count++;
+}
+
+/* Record an allocation in allocated, growing it if necessary.
+ * Return TRUE if there is an error, FALSE otherwise.
+ * Must be called with allocated_mutex locked.
+ *
+ * Parameters:
+ *
+ * location - The pointer to the allocated memory.
+ * bytes    - The number of bytes allocated.
+ */
+static int record_allocation(void* location, int bytes)
+{
+  int error = FALSE; // Error flag.
+
+  if (2 * (allocated_count + 1) > allocated_capacity)
+    {
+      allocation_record* old_allocated = allocated;
+      size_t             old_capacity  = allocated_capacity;
+      size_t             ii;            // Loop counter.
+
+      allocated_capacity = (0 == old_capacity) ? ALLOCATED_MIN_CAPACITY : 2 * old_capacity;
+      allocated          = calloc(allocated_capacity, sizeof(allocation_record));
+
+#if (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
+      if (NULL == allocated)
+        {
+          fprintf(stderr, "ERROR: Failed to allocate memory.");
+          allocated          = old_allocated;
+          allocated_capacity = old_capacity;
+          error              = TRUE;
+        }
+      else
+#endif // (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
+        {
+          allocated_count = 0;
+
+          for (ii = 0; ii < old_capacity; ii++)
+            {
+              if (NULL != old_allocated[ii].location)
+                {
+                  insert_allocation_record(old_allocated[ii].location, old_allocated[ii].bytes);
+                }
+            }
+
+          free(old_allocated);
+        }
+    }
+
+  if (!error)
+    {
+      insert_allocation_record(location, bytes);
+    }
+
+  return error;
+}
+
+/* Remove the record of an allocation from allocated.
+ * Return the number of bytes that were allocated at location or zero if
+ * there is no record of location.
+ * Must be called with allocated_mutex locked.
+ *
+ * Parameters:
+ *
+ * location - The pointer to the allocated memory.
+ */
+static int remove_allocation_record(void* location)
+{
+  int    bytes = 0; // The number of bytes allocated at location.
+  size_t slot;      // The slot of the record to remove.
+  size_t next_slot; // The slots after slot in the same run of full slots.
+  size_t home;      // The slot where the search for the record in next_slot starts.
+
+  if (0 < allocated_count)
+    {
+      slot = allocation_hash(location);
+
+      while (NULL != allocated[slot].location && location != allocated[slot].location)
+        {
+          slot = (slot + 1) & (allocated_capacity - 1);
+        }
+
+      if (NULL != allocated[slot].location)
+        {
+          bytes = allocated[slot].bytes;
+          allocated_count--;
+
+          // Shift later records in the run back into the hole if the hole is between where their search starts and where they are.  This keeps
+          // every record reachable without leaving tombstones.
+          next_slot = slot;
+
+          for (next_slot = (next_slot + 1) & (allocated_capacity - 1); NULL != allocated[next_slot].location;
+               next_slot = (next_slot + 1) & (allocated_capacity - 1))
+            {
+              home = allocation_hash(allocated[next_slot].location);
+
+              if (((next_slot - home) & (allocated_capacity - 1)) >= ((next_slot - slot) & (allocated_capacity - 1)))
+                {
+                  allocated[slot] = allocated[next_slot];
+                  slot            = next_slot;
+                }
+            }
+
+          allocated[slot].location = NULL;
+          allocated[slot].bytes    = 0;
+        }
+    }
+
+  return bytes;
+}
+
+/* Lock allocated_mutex if THREAD_SAFE is defined.
+ * Return TRUE if there is an error, FALSE otherwise.
+ */
+static int lock_allocated(void)
+{
+  int error = FALSE; // Error flag.
+
+#ifdef THREAD_SAFE
+#if (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
+  error =
+#endif // (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
+      pthread_mutex_lock(&allocated_mutex);
+
+#if (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
+  if (error)
+    {
+      fprintf(stderr, "ERROR: Failed to lock mutex.");
+      error = TRUE;
+    }
+#endif // (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
+#endif // THREAD_SAFE
+
+  return error;
+}
 
-static allocation_record* allocated = NULL;
+/* Unlock allocated_mutex if THREAD_SAFE is defined.
+ * Return TRUE if there is an error, FALSE otherwise.
+ */
+static int unlock_allocated(void)
+{
+  int error = FALSE; // Error flag.
+
+#ifdef THREAD_SAFE
+#if (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
+  error =
+#endif // (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
+      pthread_mutex_unlock(&allocated_mutex);
+
+#if (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
+  if (error)
+    {
+      fprintf(stderr, "ERROR: Failed to unlock mutex.");
+      error = TRUE;
+    }
+#endif // (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
+#endif // THREAD_SAFE
+
+  return error;
+}
+#endif // TRACK_ALLOCATIONS
 
 /* Comment in .h file. */
 int v_alloc(void** ptr, int bytes)
 {
-  int                error = FALSE; // Error flag.
-  allocation_record* record;        // For adding a record of the allocation to allocated.
+  int error = FALSE; // Error flag.
   
 #if (DEBUG_LEVEL & DEBUG_LEVEL_PUBLIC_FUNCTIONS_SIMPLE)
   if (NULL == ptr)
@@ -50,8 +256,8 @@ int v_alloc(void** ptr, int bytes)
 
   if (!error)
     {
-      // Allocate memory.
-      *ptr = malloc(bytes);
+      // Allocate memory initialized to zeros.  calloc can skip clearing memory that it gets freshly zeroed from the operating system.
+      *ptr = calloc(1, bytes);
 
 #if (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
       if (NULL == *ptr)
@@ -62,71 +268,29 @@ int v_alloc(void** ptr, int bytes)
 #endif // (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
     }
 
+#ifdef TRACK_ALLOCATIONS
   if (!error)
     {
-      // Initialize memory to zeros.
-      memset(*ptr, 0, bytes);
-      
       // Record allocation to make sure it gets freed.
-      record = malloc(sizeof(allocation_record));
+      error = lock_allocated();
 
-#if (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
-      if (NULL == record)
+      if (!error)
         {
-          free(*ptr);
-          *ptr = NULL;
-          fprintf(stderr, "ERROR: Failed to allocate memory.");
-          error = TRUE;
-        }
-#endif // (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
-    }
-  
-  if (!error)
-    {
-      record->location = *ptr;
-      record->bytes = bytes;
+          error = record_allocation(*ptr, bytes);
 
-#ifdef THREAD_SAFE
-#if (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
-      error =
-#endif // (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
-          pthread_mutex_lock(&allocated_mutex);
-      
-#if (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
-      if (error)
-        {
-          free(record);
-          free(*ptr);
-          *ptr = NULL;
-          fprintf(stderr, "ERROR: Failed to lock mutex.");
+          if (unlock_allocated())
+            {
+              error = TRUE;
+            }
         }
-#endif // (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
-#endif // THREAD_SAFE
-    }
-  
-  if (!error)
-    {
-      record->next = allocated;
-      allocated = record;
 
-#ifdef THREAD_SAFE
-#if (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
-      error =
-#endif // (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
-          pthread_mutex_unlock(&allocated_mutex);
-      
-#if (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
       if (error)
         {
-          allocated = record->next;
-          free(record);
           free(*ptr);
           *ptr = NULL;
-          fprintf(stderr, "ERROR: Failed to unlock mutex.");
         }
-#endif // (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
-#endif // THREAD_SAFE
     }
+#endif // TRACK_ALLOCATIONS
 
   return error;
 }
@@ -152,72 +316,35 @@ int v_dealloc(void** ptr, int bytes)
 
   if (NULL != ptr && NULL != *ptr)
     {
-#ifdef THREAD_SAFE
-#if (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
-      int error2 =
-#endif // (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
-          pthread_mutex_lock(&allocated_mutex);
-#if (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
-      if (error2)
+#ifdef TRACK_ALLOCATIONS
+      // Record that the allocation has been freed.
+      if (lock_allocated())
         {
           error = TRUE;
-          fprintf(stderr, "ERROR: Failed to lock mutex.");
         }
-#endif // (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
-#endif // THREAD_SAFE
-      
-      // Find the record of the allocation.
-      allocation_record** record = &allocated;
-
-      /* FIXME this search is really slow.  For now we are commenting it out.  The code will just take the first record.  It will still verify that there are
-       * the same number of deallocations as allocations, but it won't verify that the pointers and number of bytes match.
-      while (NULL != *record && (*record)->location != *ptr)
+      else
         {
-          record = &(*record)->next;
-        }
-      */
+          int recorded_bytes = remove_allocation_record(*ptr); // The number of bytes that were allocated at *ptr.
 
-      // Free memory
-      free(*ptr);
-      *ptr = NULL;
-
-      // Record that the allocation has been freed.
-      if (NULL != *record)
-        {
-          allocation_record* temp_record = *record;
+          if (unlock_allocated())
+            {
+              error = TRUE;
+            }
 
-#if (DEBUG_LEVEL & DEBUG_LEVEL_PUBLIC_FUNCTIONS_SIMPLE)
-          /* FIXME Since we don't have the correct record (see the FIXME above) don't check that bytes is correct.
-          if (bytes != (*record)->bytes)
+          if (0 == recorded_bytes)
+            {
+              fprintf(stderr, "WARNING: Deallocating memory with no record of the location having been allocated.\n");
+            }
+          else if (bytes != recorded_bytes)
             {
               fprintf(stderr, "WARNING: Deallocating memory with a different value for bytes than was used for allocation.\n");
             }
-          */
-#endif // (DEBUG_LEVEL & DEBUG_LEVEL_PUBLIC_FUNCTIONS_SIMPLE)
-          
-          *record = (*record)->next;
-          free(temp_record);
         }
-#if (DEBUG_LEVEL & DEBUG_LEVEL_PUBLIC_FUNCTIONS_SIMPLE)
-      else
-        {
-          fprintf(stderr, "WARNING: Deallocating memory with no record of the location having been allocated.\n");
-        }
-#endif // (DEBUG_LEVEL & DEBUG_LEVEL_PUBLIC_FUNCTIONS_SIMPLE)
-      
-#ifdef THREAD_SAFE
-#if (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
-      error2 =
-#endif // (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
-          pthread_mutex_unlock(&allocated_mutex);
-#if (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
-      if (error2)
-        {
-          error = TRUE;
-          fprintf(stderr, "ERROR: Failed to unlock mutex.");
-        }
-#endif // (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
-#endif // THREAD_SAFE
+#endif // TRACK_ALLOCATIONS
+
+      // Free memory
+      free(*ptr);
+      *ptr = NULL;
     }
   
   return error;
@@ -373,60 +500,256 @@ int dtwo_dealloc(double*** array, int rows, int cols)
   return vtwo_dealloc((void***)array, rows + 1, (cols + 1) * sizeof(double));
 }
 
+#define ARENA_ALIGNMENT (64) // Every block an arena hands out starts on a multiple of this many bytes.  Cache line size so SIMD loads do not split.
+
+// Round bytes up to a multiple of ARENA_ALIGNMENT.
+#define ARENA_ROUND_UP(bytes) (((bytes) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+// A chunk of memory that an arena hands out blocks from.  The memory follows the header in the same allocation.
+typedef struct arena_chunk arena_chunk;
+struct arena_chunk
+{
+  arena_chunk*   next;   // The next chunk in the arena or NULL if this is the last one.
+  int            bytes;  // The number of bytes of memory in this chunk not including the header.
+  size_t         used;   // The number of bytes of memory handed out since the arena was last reset.
+  unsigned char* memory; // The first byte of memory, aligned to ARENA_ALIGNMENT.
+};
+
+struct memory_arena
+{
+  arena_chunk* first;       // The first chunk in the arena or NULL if no memory has been handed out yet.
+  arena_chunk* current;     // The chunk that blocks are being handed out from.
+  int          chunk_bytes; // The size of chunks to allocate in bytes.  Larger requests get a chunk of their own size.
+};
+
 /* Comment in .h file. */
-int check_all_memory_freed(int cleanup)
+int arena_alloc(memory_arena** arena, int chunk_bytes)
 {
   int error = FALSE; // Error flag.
 
-#ifdef THREAD_SAFE
-#if (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
-  error =
-#endif // (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
-      pthread_mutex_lock(&allocated_mutex);
+#if (DEBUG_LEVEL & DEBUG_LEVEL_PUBLIC_FUNCTIONS_SIMPLE)
+  if (NULL == arena)
+    {
+      fprintf(stderr, "ERROR: arena must not be NULL.");
+      error = TRUE;
+    }
+  else
+    {
+      *arena = NULL;
+    }
+  
+  if (0 >= chunk_bytes)
+    {
+      fprintf(stderr, "ERROR: chunk_bytes must be greater than zero.");
+      error = TRUE;
+    }
+#endif // (DEBUG_LEVEL & DEBUG_LEVEL_PUBLIC_FUNCTIONS_SIMPLE)
 
-#if (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
-  if (error)
+  if (!error)
     {
-      fprintf(stderr, "ERROR: Failed to lock mutex.");
+      error = v_alloc((void**)arena, sizeof(memory_arena));
+    }
+
+  if (!error)
+    {
+      (*arena)->first       = NULL;
+      (*arena)->current     = NULL;
+      (*arena)->chunk_bytes = ARENA_ROUND_UP(chunk_bytes);
+    }
+
+  return error;
+}
+
+/* Comment in .h file. */
+int arena_dealloc(memory_arena** arena)
+{
+  int          error = FALSE; // Error flag.
+  arena_chunk* chunk;
+
+#if (DEBUG_LEVEL & DEBUG_LEVEL_PUBLIC_FUNCTIONS_SIMPLE)
+  if (NULL == arena || NULL == *arena)
+    {
+      fprintf(stderr, "ERROR: arena must not be NULL.");
+      error = TRUE;
+    }
+#endif // (DEBUG_LEVEL & DEBUG_LEVEL_PUBLIC_FUNCTIONS_SIMPLE)
+
+  if (NULL != arena && NULL != *arena)
+    {
+      while (NULL != (*arena)->first)
+        {
+          chunk           = (*arena)->first;
+          (*arena)->first = chunk->next;
+
+          if (v_dealloc((void**)&chunk, sizeof(arena_chunk) + ARENA_ALIGNMENT + chunk->bytes))
+            {
+              error = TRUE;
+            }
+        }
+
+      if (v_dealloc((void**)arena, sizeof(memory_arena)))
+        {
+          error = TRUE;
+        }
+    }
+
+  return error;
+}
+
+/* Comment in .h file. */
+void arena_reset(memory_arena* arena)
+{
+  arena_chunk* chunk;
+
+  assert(NULL != arena);
+
+  for (chunk = arena->first; NULL != chunk; chunk = chunk->next)
+    {
+      chunk->used = 0;
+    }
+
+  arena->current = arena->first;
+}
+
+/* Comment in .h file. */
+int arena_v_alloc(memory_arena* arena, void** ptr, int bytes)
+{
+  int          error = FALSE; // Error flag.
+  size_t       rounded_bytes; // bytes rounded up to a multiple of ARENA_ALIGNMENT.
+  arena_chunk* chunk;         // The chunk to hand out the block from.
+  arena_chunk* last  = NULL;  // The last chunk in the arena.
+  int          new_bytes;     // The size of a new chunk in bytes.
+
+#if (DEBUG_LEVEL & DEBUG_LEVEL_PUBLIC_FUNCTIONS_SIMPLE)
+  if (NULL == arena)
+    {
+      fprintf(stderr, "ERROR: arena must not be NULL.");
+      error = TRUE;
+    }
+
+  if (NULL == ptr)
+    {
+      fprintf(stderr, "ERROR: ptr must not be NULL.");
+      error = TRUE;
+    }
+  else
+    {
+      *ptr = NULL;
     }
-#endif // (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
-#endif // THREAD_SAFE
   
+  if (0 >= bytes)
+    {
+      fprintf(stderr, "ERROR: bytes must be greater than zero.");
+      error = TRUE;
+    }
+#endif // (DEBUG_LEVEL & DEBUG_LEVEL_PUBLIC_FUNCTIONS_SIMPLE)
+
   if (!error)
     {
-      allocation_record* record = allocated;
+      rounded_bytes = ARENA_ROUND_UP((size_t)bytes);
+
+      // Usually the block fits in the current chunk.  Otherwise move on to a later chunk left over from before the last reset.
+      for (chunk = arena->current; NULL != chunk && chunk->used + rounded_bytes > (size_t)chunk->bytes; chunk = chunk->next)
+        {
+          last = chunk;
+        }
 
-      while (NULL != record)
+      if (NULL == chunk)
         {
-          fprintf(stderr, "WARNING: %d bytes of unfreed memory\n", record->bytes);
-          record = record->next;
+          // Add a new chunk to the end of the arena.
+          for (; NULL != last && NULL != last->next; last = last->next)
+            {
+              // Find the last chunk.
+            }
+
+          new_bytes = max(arena->chunk_bytes, (int)rounded_bytes);
+          error     = v_alloc((void**)&chunk, sizeof(arena_chunk) + ARENA_ALIGNMENT + new_bytes);
+
+          if (!error)
+            {
+              chunk->next   = NULL;
+              chunk->bytes  = new_bytes;
+              chunk->used   = 0;
+              chunk->memory = (unsigned char*)ARENA_ROUND_UP((uintptr_t)(chunk + 1));
+
+              if (NULL == last)
+                {
+                  arena->first = chunk;
+                }
+              else
+                {
+                  last->next = chunk;
+                }
+            }
+        }
+    }
+
+  if (!error)
+    {
+      arena->current = chunk;
+      *ptr           = chunk->memory + chunk->used;
+      chunk->used   += rounded_bytes;
+
+      // Memory is reused after a reset so it must be cleared here to match v_alloc.
+      memset(*ptr, 0, bytes);
+    }
+
+  return error;
+}
+
+/* Comment in .h file. */
+int arena_i_alloc(memory_arena* arena, int** array, int size)
+{
+  return arena_v_alloc(arena, (void**)array, (size + 1) * sizeof(int));
+}
+
+/* Comment in .h file. */
+int arena_d_alloc(memory_arena* arena, double** array, int size)
+{
+  return arena_v_alloc(arena, (void**)array, (size + 1) * sizeof(double));
+}
+
+/* Comment in .h file. */
+int check_all_memory_freed(int cleanup)
+{
+  int error = FALSE; // Error flag.
+
+#ifdef TRACK_ALLOCATIONS
+  size_t ii; // Loop counter.
 
-          if (cleanup)
+  error = lock_allocated();
+  
+  if (!error)
+    {
+      for (ii = 0; ii < allocated_capacity; ii++)
+        {
+          if (NULL != allocated[ii].location)
             {
-              free(allocated->location);
-              free(allocated);
-              allocated = record;
+              fprintf(stderr, "WARNING: %d bytes of unfreed memory\n", allocated[ii].bytes);
+
+              if (cleanup)
+                {
+                  free(allocated[ii].location);
+                  allocated[ii].location = NULL;
+                  allocated_count--;
+                }
             }
         }
 
 #if (DEBUG_LEVEL & DEBUG_LEVEL_INTERNAL_ASSERTIONS)
-      assert(!cleanup || NULL == allocated); // Cleanup implies allocated is NULL.
+      assert(!cleanup || 0 == allocated_count); // Cleanup implies allocated is empty.
 #endif // (DEBUG_LEVEL & DEBUG_LEVEL_INTERNAL_ASSERTIONS)
 
-#ifdef THREAD_SAFE
-#if (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
-      error =
-#endif // (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
-          pthread_mutex_unlock(&allocated_mutex);
-
-#if (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
-      if (error)
+      if (0 == allocated_count)
         {
-          fprintf(stderr, "ERROR: Failed to unlock mutex.");
+          free(allocated);
+          allocated          = NULL;
+          allocated_capacity = 0;
         }
-#endif // (DEBUG_LEVEL & DEBUG_LEVEL_LIBRARY_ERRORS)
-#endif // THREAD_SAFE
+
+      error = unlock_allocated();
     }
+#endif // TRACK_ALLOCATIONS
   
   return error;
 }
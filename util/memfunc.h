@@ -165,12 +165,101 @@ int dtwo_alloc(double*** array, int rows, int cols);
  */
 int dtwo_dealloc(double*** array, int rows, int cols);
 
+/* A memory_arena hands out blocks of memory from large chunks by bumping a
+ * pointer.  Blocks are never freed one at a time.  Instead arena_reset makes
+ * all of the memory handed out available again, keeping the chunks for
+ * reuse, and arena_dealloc frees all of the chunks at once.  Use an arena for
+ * scratch memory that is allocated over and over with the same lifetime, for
+ * example once per timestep, so that there is no call to malloc or free once
+ * the arena has grown to its working size.  An arena is not thread safe.
+ * Give each thread its own arena.
+ */
+typedef struct memory_arena memory_arena;
+
+/* Allocate an empty memory_arena.  No chunks are allocated until the first
+ * block is requested.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * arena       - A pointer passed by reference which will be assigned to point
+ *               to the newly allocated arena or NULL if there is an error.
+ * chunk_bytes - The number of bytes to allocate in each chunk.  A request
+ *               for more than this gets a chunk of its own size.
+ */
+int arena_alloc(memory_arena** arena, int chunk_bytes);
+
+/* Free a memory_arena allocated by arena_alloc and all of its chunks.  Every
+ * block handed out by the arena becomes invalid.
+ * Return TRUE if there is an error, FALSE otherwise.
+ * Even if there is an error make every effort to free as much as possible.
+ *
+ * Parameters:
+ *
+ * arena - A pointer to the arena to deallocate passed by reference.
+ *         Will be set to NULL after the arena is deallocated.
+ */
+int arena_dealloc(memory_arena** arena);
+
+/* Make all of the memory handed out by arena available again without freeing
+ * any chunks.  Every block handed out by the arena becomes invalid.
+ *
+ * Parameters:
+ *
+ * arena - A pointer to the memory_arena.
+ */
+void arena_reset(memory_arena* arena);
+
+/* Hand out a block of memory from arena and initialize all of its bytes to
+ * zero.  The block is valid until the next call to arena_reset or
+ * arena_dealloc.  Do not pass it to v_dealloc.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * arena - A pointer to the memory_arena.
+ * ptr   - A pointer passed by reference which will be assigned to point
+ *         to the block of memory or NULL if there is an error.
+ * bytes - The number of bytes to hand out.
+ */
+int arena_v_alloc(memory_arena* arena, void** ptr, int bytes);
+
+/* Hand out a 1D array of integers from arena and initialize all elements to
+ * zero.  See arena_v_alloc.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * arena - A pointer to the memory_arena.
+ * array - A pointer passed by reference which will be assigned to point
+ *         to the array or NULL if there is an error.
+ * size  - The number of elements in the array.
+ *         One extra element will be allocated to support one based indexing.
+ */
+int arena_i_alloc(memory_arena* arena, int** array, int size);
+
+/* Hand out a 1D array of doubles from arena and initialize all elements to
+ * zero.  See arena_v_alloc.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * arena - A pointer to the memory_arena.
+ * array - A pointer passed by reference which will be assigned to point
+ *         to the array or NULL if there is an error.
+ * size  - The number of elements in the array.
+ *         One extra element will be allocated to support one based indexing.
+ */
+int arena_d_alloc(memory_arena* arena, double** array, int size);
+
 /* Print a warning if any allocated memory has not been freed and optionally
  * free all allocated memory.
  * Return TRUE if there is an error, FALSE otherwise.
  * If there is an error before freeing memory do not free memory.
  * Call this at the end of your program after you think you have deallocated
  * everything.  Do not use this as a substitute for properly freeing memory.
+ * Allocations are only recorded when DEBUG_LEVEL includes
+ * DEBUG_LEVEL_INTERNAL_ASSERTIONS.  Otherwise this does nothing.
  *
  * Parameters:
  *
@@ -0,0 +1,524 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "output_writer.h"
+#include "memfunc.h"
+#include "all.h"
+
+#define OUTPUT_MAGIC       "TOSERIES"    // The first eight bytes of a binary output file.
+#define OUTPUT_RING_ROWS   (8192)        // The number of rows in the ring buffer.  Must be a power of two.
+#define OUTPUT_BLOCK_ROWS  (4096)        // The most rows in one block of a binary output file.
+#define OUTPUT_BUFFER_SIZE (1 << 20)     // The size of the stdio buffer of the file in bytes.
+#define OUTPUT_MAX_SPEC    (32)          // The longest conversion specification in a format.
+#define OUTPUT_MAX_COLUMNS (64)          // The most doubles in a row.
+#define OUTPUT_IDLE_NANOSECONDS (1000000) // How long the writer thread sleeps when the ring is empty.
+
+/* A binary output file is an output_binary_header, then the format padded with
+ * NUL characters to a multiple of eight bytes, then blocks.  Each block is the
+ * number of rows in it as an int64_t followed by num_columns arrays of that
+ * many doubles, one array per column.  Everything is in the byte order of the
+ * machine that wrote the file.
+ */
+typedef struct
+{
+  char    magic[8];      // OUTPUT_MAGIC, not NUL terminated.
+  int32_t num_columns;   // The number of doubles in each row.
+  int32_t format_bytes;  // The number of bytes of format and padding after the header.
+} output_binary_header;
+
+struct output_writer
+{
+  FILE*         fptr;        // The file being written.
+  char*         format;      // The printf style format of a row.
+  int           num_columns; // The number of doubles in each row.
+  int           binary;      // Whether to write the columnar binary format.
+  double*       ring;        // OUTPUT_RING_ROWS rows of num_columns doubles.
+  double*       block;       // num_columns arrays of OUTPUT_BLOCK_ROWS doubles.  Only used if binary is TRUE.
+  int           block_rows;  // The number of rows in block.
+  atomic_size_t head;        // The number of rows ever put in ring.  Only written by the simulation thread.
+  atomic_size_t tail;        // The number of rows ever taken out of ring.  Only written by the writer thread.
+  atomic_int    done;        // Set when no more rows will be put in ring.
+  atomic_int    error;       // Set if the writer thread had an error.
+  pthread_t     thread;      // The writer thread.
+  int           thread_started;
+};
+
+/* Copy the conversion specification starting at the % at format into spec.
+ * Return the number of characters in it or zero if it is not a floating point
+ * conversion that output_writer supports.
+ */
+static int parse_spec(const char* format, char* spec)
+{
+  int length = 1; // The number of characters in the specification.
+
+  while ('\0' != format[length] && NULL != strchr("-+ #0", format[length]))
+    {
+      length++;
+    }
+
+  while ('0' <= format[length] && '9' >= format[length])
+    {
+      length++;
+    }
+
+  if ('.' == format[length])
+    {
+      length++;
+
+      while ('0' <= format[length] && '9' >= format[length])
+        {
+          length++;
+        }
+    }
+
+  if ('l' == format[length])
+    {
+      length++;
+    }
+
+  if ('\0' == format[length] || NULL == strchr("eEfFgGaA", format[length]) || OUTPUT_MAX_SPEC <= length + 1)
+    {
+      length = 0;
+    }
+  else
+    {
+      length++;
+      memcpy(spec, format, length);
+      spec[length] = '\0';
+    }
+
+  return length;
+}
+
+/* Return the number of conversions in format or -1 if it has a conversion
+ * that output_writer does not support.
+ */
+static int count_conversions(const char* format)
+{
+  int  count = 0; // The number of conversions.
+  int  length;    // The length of a conversion specification.
+  char spec[OUTPUT_MAX_SPEC];
+
+  while (0 <= count && '\0' != *format)
+    {
+      if ('%' == format[0] && '%' == format[1])
+        {
+          format += 2;
+        }
+      else if ('%' == format[0])
+        {
+          length  = parse_spec(format, spec);
+          count   = (0 == length) ? -1 : count + 1;
+          format += length;
+        }
+      else
+        {
+          format++;
+        }
+    }
+
+  return count;
+}
+
+/* Write one row as text with format.  This gives the same characters as
+ * calling fprintf with format and the values of row.
+ * Return TRUE if there is an error, FALSE otherwise.
+ */
+static int format_row(FILE* fptr, const char* format, const double* row)
+{
+  int  error  = FALSE; // Error flag.
+  int  column = 0;     // The next column to write.
+  int  length;         // The length of a conversion specification.
+  char spec[OUTPUT_MAX_SPEC];
+
+  while (!error && '\0' != *format)
+    {
+      if ('%' == format[0] && '%' == format[1])
+        {
+          error   = (EOF == putc('%', fptr));
+          format += 2;
+        }
+      else if ('%' == format[0])
+        {
+          length  = parse_spec(format, spec);
+          error   = (0 > fprintf(fptr, spec, row[column++]));
+          format += length;
+        }
+      else
+        {
+          error = (EOF == putc(*format, fptr));
+          format++;
+        }
+    }
+
+  return error;
+}
+
+// Write the rows in writer->block to the file.  Return TRUE if there is an error, FALSE otherwise.
+static int write_block(output_writer* writer)
+{
+  int     error    = FALSE; // Error flag.
+  int     ii;               // Loop counter.
+  int64_t num_rows = writer->block_rows;
+
+  if (0 < num_rows)
+    {
+      error = (1 != fwrite(&num_rows, sizeof(int64_t), 1, writer->fptr));
+
+      for (ii = 0; !error && ii < writer->num_columns; ii++)
+        {
+          error = ((size_t)num_rows != fwrite(writer->block + (size_t)ii * OUTPUT_BLOCK_ROWS, sizeof(double), num_rows, writer->fptr));
+        }
+
+      writer->block_rows = 0;
+    }
+
+  return error;
+}
+
+// The writer thread.  Take rows out of the ring and write them until done is set and the ring is empty.
+static void* output_writer_thread(void* argument)
+{
+  output_writer*  writer = (output_writer*)argument;
+  int             error  = FALSE; // Error flag.
+  int             ii;             // Loop counter.
+  size_t          head;           // writer->head when it was last read.
+  size_t          tail   = atomic_load_explicit(&writer->tail, memory_order_relaxed);
+  const double*   row;
+  struct timespec idle   = {0, OUTPUT_IDLE_NANOSECONDS};
+
+  for (;;)
+    {
+      // Read done before head so that if done is set the rows before it are seen.
+      int done = atomic_load_explicit(&writer->done, memory_order_acquire);
+
+      head = atomic_load_explicit(&writer->head, memory_order_acquire);
+
+      if (head == tail)
+        {
+          if (done)
+            {
+              break;
+            }
+
+          nanosleep(&idle, NULL);
+          continue;
+        }
+
+      for (; tail != head; tail++)
+        {
+          row = writer->ring + (tail & (OUTPUT_RING_ROWS - 1)) * (size_t)writer->num_columns;
+
+          if (error)
+            {
+              // Keep draining the ring so the simulation thread does not wait forever.
+            }
+          else if (writer->binary)
+            {
+              for (ii = 0; ii < writer->num_columns; ii++)
+                {
+                  writer->block[(size_t)ii * OUTPUT_BLOCK_ROWS + writer->block_rows] = row[ii];
+                }
+
+              if (OUTPUT_BLOCK_ROWS == ++writer->block_rows)
+                {
+                  error = write_block(writer);
+                }
+            }
+          else
+            {
+              error = format_row(writer->fptr, writer->format, row);
+            }
+        }
+
+      atomic_store_explicit(&writer->tail, tail, memory_order_release);
+
+      if (error)
+        {
+          atomic_store_explicit(&writer->error, TRUE, memory_order_relaxed);
+        }
+    }
+
+  if (!error && writer->binary)
+    {
+      error = write_block(writer);
+    }
+
+  if (error || fflush(writer->fptr))
+    {
+      atomic_store_explicit(&writer->error, TRUE, memory_order_relaxed);
+    }
+
+  return NULL;
+}
+
+/* Comment in .h file. */
+int output_writer_alloc(output_writer** writer, const char* path, int num_columns, const char* format, int binary)
+{
+  int                  error = FALSE; // Error flag.
+  output_binary_header header;
+
+  if (NULL == writer)
+    {
+      fprintf(stderr, "ERROR: writer must not be NULL\n");
+      error = TRUE;
+    }
+  else
+    {
+      *writer = NULL;
+    }
+
+  if (NULL == path)
+    {
+      fprintf(stderr, "ERROR: path must not be NULL\n");
+      error = TRUE;
+    }
+
+  if (0 >= num_columns || OUTPUT_MAX_COLUMNS < num_columns)
+    {
+      fprintf(stderr, "ERROR: num_columns must be greater than zero and at most %d\n", OUTPUT_MAX_COLUMNS);
+      error = TRUE;
+    }
+
+  if (NULL == format || num_columns != count_conversions(format))
+    {
+      fprintf(stderr, "ERROR: format must have num_columns floating point conversions\n");
+      error = TRUE;
+    }
+
+  if (!error)
+    {
+      error = v_alloc((void**)writer, sizeof(output_writer));
+    }
+
+  if (!error)
+    {
+      (*writer)->num_columns = num_columns;
+      (*writer)->binary      = binary;
+      atomic_init(&(*writer)->head, 0);
+      atomic_init(&(*writer)->tail, 0);
+      atomic_init(&(*writer)->done, FALSE);
+      atomic_init(&(*writer)->error, FALSE);
+
+      header.format_bytes = (strlen(format) + 8) & ~7;
+      error               = v_alloc((void**)&(*writer)->format, header.format_bytes) ||
+          v_alloc((void**)&(*writer)->ring, OUTPUT_RING_ROWS * num_columns * sizeof(double)) ||
+          (binary && v_alloc((void**)&(*writer)->block, OUTPUT_BLOCK_ROWS * num_columns * sizeof(double)));
+    }
+
+  if (!error)
+    {
+      strcpy((*writer)->format, format);
+
+      if (NULL == ((*writer)->fptr = fopen(path, binary ? "wb" : "w")))
+        {
+          fprintf(stderr, "ERROR: Could not open %s for writing\n", path);
+          error = TRUE;
+        }
+      else
+        {
+          setvbuf((*writer)->fptr, NULL, _IOFBF, OUTPUT_BUFFER_SIZE);
+        }
+    }
+
+  if (!error && binary)
+    {
+      memcpy(header.magic, OUTPUT_MAGIC, sizeof(header.magic));
+
+      header.num_columns = num_columns;
+
+      if (1 != fwrite(&header, sizeof(output_binary_header), 1, (*writer)->fptr) ||
+          1 != fwrite((*writer)->format, header.format_bytes, 1, (*writer)->fptr))
+        {
+          fprintf(stderr, "ERROR: Could not write %s\n", path);
+          error = TRUE;
+        }
+    }
+
+  if (!error)
+    {
+      if (pthread_create(&(*writer)->thread, NULL, output_writer_thread, *writer))
+        {
+          fprintf(stderr, "ERROR: Could not create writer thread\n");
+          error = TRUE;
+        }
+      else
+        {
+          (*writer)->thread_started = TRUE;
+        }
+    }
+
+  if (error && NULL != writer && NULL != *writer)
+    {
+      output_writer_dealloc(writer);
+    }
+
+  return error;
+}
+
+/* Comment in .h file. */
+int output_writer_dealloc(output_writer** writer)
+{
+  int error = FALSE; // Error flag.
+
+  if (NULL == writer || NULL == *writer)
+    {
+      fprintf(stderr, "ERROR: writer must not be NULL\n");
+      error = TRUE;
+    }
+  else
+    {
+      if ((*writer)->thread_started)
+        {
+          atomic_store_explicit(&(*writer)->done, TRUE, memory_order_release);
+
+          if (pthread_join((*writer)->thread, NULL))
+            {
+              fprintf(stderr, "ERROR: Could not join writer thread\n");
+              error = TRUE;
+            }
+        }
+
+      if (atomic_load(&(*writer)->error))
+        {
+          fprintf(stderr, "ERROR: Could not write output\n");
+          error = TRUE;
+        }
+
+      if (NULL != (*writer)->fptr && fclose((*writer)->fptr))
+        {
+          error = TRUE;
+        }
+
+      if (NULL != (*writer)->block)
+        {
+          v_dealloc((void**)&(*writer)->block, OUTPUT_BLOCK_ROWS * (*writer)->num_columns * sizeof(double));
+        }
+
+      if (NULL != (*writer)->ring)
+        {
+          v_dealloc((void**)&(*writer)->ring, OUTPUT_RING_ROWS * (*writer)->num_columns * sizeof(double));
+        }
+
+      if (NULL != (*writer)->format)
+        {
+          v_dealloc((void**)&(*writer)->format, (strlen((*writer)->format) + 8) & ~7);
+        }
+
+      v_dealloc((void**)writer, sizeof(output_writer));
+    }
+
+  return error;
+}
+
+/* Comment in .h file. */
+int output_writer_row(output_writer* writer, const double* row)
+{
+  size_t head = atomic_load_explicit(&writer->head, memory_order_relaxed);
+
+  // Wait only if the writer thread is a whole ring behind.
+  while (OUTPUT_RING_ROWS == head - atomic_load_explicit(&writer->tail, memory_order_acquire))
+    {
+      sched_yield();
+    }
+
+  memcpy(writer->ring + (head & (OUTPUT_RING_ROWS - 1)) * (size_t)writer->num_columns, row, writer->num_columns * sizeof(double));
+  atomic_store_explicit(&writer->head, head + 1, memory_order_release);
+
+  return atomic_load_explicit(&writer->error, memory_order_relaxed);
+}
+
+/* Comment in .h file. */
+int output_convert_to_text(const char* binary_path, const char* text_path)
+{
+  int                  error   = FALSE; // Error flag.
+  int                  ii, jj;          // Loop counters.
+  FILE*                in_fptr = NULL;
+  FILE*                out_fptr = NULL;
+  char*                format  = NULL;
+  double*              block   = NULL;
+  double               row[OUTPUT_MAX_COLUMNS];
+  int64_t              num_rows;
+  output_binary_header header;
+
+  if (NULL == (in_fptr = fopen(binary_path, "rb")))
+    {
+      fprintf(stderr, "ERROR: Could not open %s\n", binary_path);
+      error = TRUE;
+    }
+  else if (1 != fread(&header, sizeof(output_binary_header), 1, in_fptr) || 0 != memcmp(header.magic, OUTPUT_MAGIC, sizeof(header.magic)) ||
+           0 >= header.num_columns || OUTPUT_MAX_COLUMNS < header.num_columns || 0 >= header.format_bytes)
+    {
+      fprintf(stderr, "ERROR: %s is not a binary output file\n", binary_path);
+      error = TRUE;
+    }
+
+  if (!error)
+    {
+      error = v_alloc((void**)&format, header.format_bytes + 1) ||
+          v_alloc((void**)&block, OUTPUT_BLOCK_ROWS * header.num_columns * sizeof(double));
+    }
+
+  if (!error && (1 != fread(format, header.format_bytes, 1, in_fptr) || header.num_columns != count_conversions(format)))
+    {
+      fprintf(stderr, "ERROR: %s has a bad format\n", binary_path);
+      error = TRUE;
+    }
+
+  if (!error && NULL == (out_fptr = fopen(text_path, "w")))
+    {
+      fprintf(stderr, "ERROR: Could not open %s for writing\n", text_path);
+      error = TRUE;
+    }
+
+  while (!error && 1 == fread(&num_rows, sizeof(int64_t), 1, in_fptr))
+    {
+      if (0 >= num_rows || OUTPUT_BLOCK_ROWS < num_rows)
+        {
+          fprintf(stderr, "ERROR: %s is corrupt\n", binary_path);
+          error = TRUE;
+        }
+
+      for (ii = 0; !error && ii < header.num_columns; ii++)
+        {
+          error = ((size_t)num_rows != fread(block + (size_t)ii * num_rows, sizeof(double), num_rows, in_fptr));
+        }
+
+      for (jj = 0; !error && jj < num_rows; jj++)
+        {
+          for (ii = 0; ii < header.num_columns; ii++)
+            {
+              row[ii] = block[(size_t)ii * num_rows + jj];
+            }
+
+          error = format_row(out_fptr, format, row);
+        }
+    }
+
+  if (NULL != out_fptr && fclose(out_fptr))
+    {
+      error = TRUE;
+    }
+
+  if (NULL != in_fptr)
+    {
+      fclose(in_fptr);
+    }
+
+  if (NULL != block)
+    {
+      v_dealloc((void**)&block, OUTPUT_BLOCK_ROWS * header.num_columns * sizeof(double));
+    }
+
+  if (NULL != format)
+    {
+      v_dealloc((void**)&format, header.format_bytes + 1);
+    }
+
+  return error;
+}
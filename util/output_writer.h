@@ -0,0 +1,75 @@
+#ifndef OUTPUT_WRITER_H
+#define OUTPUT_WRITER_H
+
+/* An output_writer takes rows of doubles from a simulation thread and writes
+ * them to a file from a background thread, so the simulation never waits on
+ * text formatting or the disk.  Rows are passed through a single producer
+ * single consumer lock free ring buffer.  The simulation thread only copies
+ * a row into the ring.  It waits only if the writer thread has fallen a whole
+ * ring behind.
+ *
+ * Each row is described by a printf style format with one floating point
+ * conversion per column, for example "%lf %lf\n".  A text writer formats each
+ * row with it exactly as fprintf would.  A binary writer stores the rows in a
+ * compact columnar format instead: a header holding the number of columns and
+ * the format, then blocks of rows with each column stored contiguously.
+ * output_convert_to_text turns a binary file into the same text a text
+ * writer would have written.
+ *
+ * One output_writer must only be written to by one thread.
+ */
+typedef struct output_writer output_writer;
+
+/* Open a file and start its writer thread.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * writer      - A pointer passed by reference which will be assigned to point
+ *               to the newly allocated output_writer or NULL if there is an
+ *               error.
+ * path        - The name of the file to write.
+ * num_columns - The number of doubles in each row.  At most 64.
+ * format      - The printf style format of a row.  It must have exactly
+ *               num_columns conversions, each one of e, E, f, F, g, G, a, or
+ *               A with an optional l.  Use %% for a literal percent sign.
+ * binary      - If TRUE write the columnar binary format, otherwise text.
+ */
+int output_writer_alloc(output_writer** writer, const char* path, int num_columns, const char* format, int binary);
+
+/* Finish writing all rows, stop the writer thread, close the file, and free
+ * the output_writer.
+ * Return TRUE if there is an error now or if there was an error writing any
+ * row, FALSE otherwise.
+ * Even if there is an error make every effort to free as much as possible.
+ *
+ * Parameters:
+ *
+ * writer - A pointer to the output_writer passed by reference.
+ *          Will be set to NULL after it is deallocated.
+ */
+int output_writer_dealloc(output_writer** writer);
+
+/* Queue one row to be written.
+ * Return TRUE if the writer thread has had an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * writer - A pointer to the output_writer.
+ * row    - 1D array of num_columns doubles.  It is copied so it can be reused
+ *          as soon as this returns.
+ */
+int output_writer_row(output_writer* writer, const double* row);
+
+/* Convert a binary file written by an output_writer to text in the format
+ * it was written with.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * binary_path - The name of the binary file to read.
+ * text_path   - The name of the text file to write.
+ */
+int output_convert_to_text(const char* binary_path, const char* text_path);
+
+#endif // OUTPUT_WRITER_H
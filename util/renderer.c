@@ -0,0 +1,733 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <math.h>
+#ifndef NO_X11
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#endif // NO_X11
+#include "renderer.h"
+#include "memfunc.h"
+#include "all.h"
+
+#define MARGIN                    (30)
+#define FRAME_WIDTH               (600)
+#define FRAME_HEIGHT              (500)
+#define WINDOW_WIDTH              (FRAME_WIDTH  + 2 * MARGIN)
+#define WINDOW_HEIGHT             (FRAME_HEIGHT + 3 * MARGIN)
+#define RED                       (0xFF0066)
+#define BLUE                      (0x0000FF)
+#define GREEN                     (0x00CC66)
+#define GRAY                      (0xB1B1B1)
+#define BLACK                     (0x000000)
+#define WHITE                     (0xFFFFFF)
+#define ONE_DAY                   (24.0 * 60.0 * 60.0)
+#define RENDERER_QUEUE_SNAPSHOTS  (4)       // The number of snapshots in the queue.
+#define RENDERER_MIN_WATER        (1024)    // The number of rectangles first allocated for a snapshot.
+#define RENDERER_IDLE_NANOSECONDS (5000000) // How long the renderer thread sleeps when the queue is empty.
+
+// The colors of the kinds of water.  Indexed by the RENDERER_ kinds.
+static const uint32_t water_color[] = {GRAY, GREEN, RED, BLUE};
+
+// A rectangle of water.
+typedef struct
+{
+  int    bin;  // One based.
+  int    kind; // One of the RENDERER_ kinds.
+  double top;  // Meters.
+  double bot;  // Meters.
+} renderer_water;
+
+// A copy of the water in a domain at one time.
+typedef struct
+{
+  double          current_time;       // Seconds.
+  int             num_bins;           // The number of bins.
+  double          layer_bottom_depth; // Meters.
+  int             show;               // Whether to draw it in the window.
+  int             frame;              // The number of the PPM frame to write or -1 for none.
+  int             num_water;          // The number of rectangles in water.
+  int             capacity;           // The number of rectangles allocated in water.
+  renderer_water* water;              // 1D array of rectangles with zero based indexing.
+} renderer_snapshot;
+
+struct renderer
+{
+  atomic_int         window;         // Whether to show a window.  Cleared by the renderer thread if the display can not be opened.
+  double             show_interval;  // The fewest seconds of wall clock time between snapshots for the window.
+  double             last_show;      // The wall clock time of the last snapshot for the window.  Only used by the simulation thread.
+  char*              frame_prefix;   // The start of the PPM file names or NULL for no frames.
+  double             frame_seconds;  // Simulated seconds between PPM frames.
+  int                next_frame;     // The number of the next PPM frame.  Only used by the simulation thread.
+  int                dropped_frames; // The number of PPM frames not written because the queue was full.  Only used by the simulation thread.
+  int                pending_show;   // Whether the snapshot found due by renderer_snapshot_due is for the window.
+  int                pending_frame;  // The PPM frame number of the snapshot found due by renderer_snapshot_due or -1.
+  renderer_snapshot  queue[RENDERER_QUEUE_SNAPSHOTS];
+  renderer_snapshot* current;        // The snapshot being filled in or NULL.
+  atomic_size_t      head;           // The number of snapshots ever put in queue.  Only written by the simulation thread.
+  atomic_size_t      tail;           // The number of snapshots ever taken out of queue.  Only written by the renderer thread.
+  atomic_int         done;           // Set when no more snapshots will be put in queue.
+  atomic_int         error;          // Set if the renderer thread had an error.
+  uint32_t*          pixels;         // WINDOW_WIDTH * WINDOW_HEIGHT pixels of 0xRRGGBB.  Only used by the renderer thread.
+  pthread_t          thread;         // The renderer thread.
+  int                thread_started;
+};
+
+#ifndef NO_X11
+// The X11 state.  Only used by the renderer thread.
+typedef struct
+{
+  Display*     display;
+  int          screen;
+  GC           gc;
+  XFontStruct* font;
+  Window       window;
+  Pixmap       pixmap;
+  XImage*      image;  // Wraps the pixels of the renderer.
+} renderer_x11;
+#endif // NO_X11
+
+// Return the wall clock time in seconds.
+static double wall_time(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return now.tv_sec + now.tv_nsec * 1.0e-9;
+}
+
+// Fill a rectangle of pixels, clipped to the picture.
+static void fill_rectangle(uint32_t* pixels, int x, int y, int width, int height, uint32_t color)
+{
+  int ii, jj; // Loop counters.
+  int x_end = x + width;
+  int y_end = y + height;
+
+  x     = (0 > x) ? 0 : x;
+  y     = (0 > y) ? 0 : y;
+  x_end = (WINDOW_WIDTH  < x_end) ? WINDOW_WIDTH  : x_end;
+  y_end = (WINDOW_HEIGHT < y_end) ? WINDOW_HEIGHT : y_end;
+
+  for (jj = y; jj < y_end; jj++)
+    {
+      for (ii = x; ii < x_end; ii++)
+        {
+          pixels[jj * WINDOW_WIDTH + ii] = color;
+        }
+    }
+}
+
+// Draw a one pixel wide line including both end points, clipped to the picture.
+static void draw_line(uint32_t* pixels, int x0, int y0, int x1, int y1, uint32_t color)
+{
+  int dx     = abs(x1 - x0);
+  int dy     = -abs(y1 - y0);
+  int step_x = (x0 < x1) ? 1 : -1;
+  int step_y = (y0 < y1) ? 1 : -1;
+  int error  = dx + dy;
+  int twice_error;
+
+  for (;;)
+    {
+      if (0 <= x0 && WINDOW_WIDTH > x0 && 0 <= y0 && WINDOW_HEIGHT > y0)
+        {
+          pixels[y0 * WINDOW_WIDTH + x0] = color;
+        }
+
+      if (x0 == x1 && y0 == y1)
+        {
+          break;
+        }
+
+      twice_error = 2 * error;
+
+      if (twice_error >= dy)
+        {
+          error += dy;
+          x0    += step_x;
+        }
+
+      if (twice_error <= dx)
+        {
+          error += dx;
+          y0    += step_y;
+        }
+    }
+}
+
+/* Draw a snapshot into pixels.  The water, axes, and legend are drawn the
+ * same way test_panama.c drew them with X11.  The text is not drawn here
+ * because it needs an X font.  See draw_text.
+ */
+static void draw_snapshot(uint32_t* pixels, const renderer_snapshot* snapshot)
+{
+  int ii;                                                                // Loop counter.
+  int width_factor  = FRAME_WIDTH  / snapshot->num_bins;                 // Pixels per bin.
+  int height_factor = FRAME_HEIGHT / snapshot->layer_bottom_depth;       // Pixels per meter.
+  int x, y_top, y_bot;                                                   // Pixels.
+
+  fill_rectangle(pixels, 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, WHITE);
+
+  // Fill rectangles where water is.
+  for (ii = 0; ii < snapshot->num_water; ii++)
+    {
+      x     = MARGIN + (snapshot->water[ii].bin - 1) * width_factor;
+      y_top = MARGIN + snapshot->water[ii].top * height_factor;
+      y_bot = MARGIN + snapshot->water[ii].bot * height_factor;
+
+      // Add one to height to force the rectangles to be at least 1 pixel tall.
+      fill_rectangle(pixels, x, y_top, width_factor, y_bot - y_top + 1, water_color[snapshot->water[ii].kind]);
+    }
+
+  // Axes.
+  draw_line(pixels, MARGIN, MARGIN, FRAME_WIDTH + 1.4 * MARGIN, MARGIN, BLACK);
+  draw_line(pixels, FRAME_WIDTH + 1.4 * MARGIN, MARGIN, FRAME_WIDTH + 1.2 * MARGIN, 0.9 * MARGIN, BLACK);
+  draw_line(pixels, FRAME_WIDTH + 1.4 * MARGIN, MARGIN, FRAME_WIDTH + 1.2 * MARGIN, 1.1 * MARGIN, BLACK);
+
+  draw_line(pixels, MARGIN, MARGIN, MARGIN, FRAME_HEIGHT + 1.4 * MARGIN, BLACK);
+  draw_line(pixels, MARGIN, FRAME_HEIGHT + 1.4 * MARGIN, MARGIN - 0.1 * MARGIN, FRAME_HEIGHT + 1.2 * MARGIN, BLACK);
+  draw_line(pixels, MARGIN, FRAME_HEIGHT + 1.4 * MARGIN, MARGIN + 0.1 * MARGIN, FRAME_HEIGHT + 1.2 * MARGIN, BLACK);
+
+  // Legend.
+  fill_rectangle(pixels, 2 * MARGIN, FRAME_HEIGHT + 2.2 * MARGIN, MARGIN / 2, MARGIN / 2, GRAY);
+  fill_rectangle(pixels, MARGIN + FRAME_WIDTH / 2.0, FRAME_HEIGHT + 2.2 * MARGIN, MARGIN / 2, MARGIN / 2, BLUE);
+  fill_rectangle(pixels, 2 * MARGIN, FRAME_HEIGHT + 1.4 * MARGIN, MARGIN / 2, MARGIN / 2, RED);
+  fill_rectangle(pixels, MARGIN + FRAME_WIDTH / 2.0, FRAME_HEIGHT + 1.4 * MARGIN, MARGIN / 2, MARGIN / 2, GREEN);
+}
+
+/* Write pixels to a binary PPM file with the time of the snapshot in a comment.
+ * Return TRUE if there is an error, FALSE otherwise.
+ */
+static int write_ppm(const renderer* the_renderer, const uint32_t* pixels, const renderer_snapshot* snapshot)
+{
+  int           error = FALSE; // Error flag.
+  int           ii, jj;        // Loop counters.
+  FILE*         fptr;
+  char          path[FILENAME_MAX];
+  unsigned char row[3 * WINDOW_WIDTH];
+
+  snprintf(path, sizeof(path), "%s%05d.ppm", the_renderer->frame_prefix, snapshot->frame);
+
+  if (NULL == (fptr = fopen(path, "wb")))
+    {
+      fprintf(stderr, "ERROR: Could not open %s for writing\n", path);
+      error = TRUE;
+    }
+  else
+    {
+      error = (0 > fprintf(fptr, "P6\n# Time: %lf days\n%d %d\n255\n", snapshot->current_time / ONE_DAY, WINDOW_WIDTH, WINDOW_HEIGHT));
+
+      for (jj = 0; !error && jj < WINDOW_HEIGHT; jj++)
+        {
+          for (ii = 0; ii < WINDOW_WIDTH; ii++)
+            {
+              row[3 * ii]     = pixels[jj * WINDOW_WIDTH + ii] >> 16;
+              row[3 * ii + 1] = pixels[jj * WINDOW_WIDTH + ii] >> 8;
+              row[3 * ii + 2] = pixels[jj * WINDOW_WIDTH + ii];
+            }
+
+          error = (1 != fwrite(row, sizeof(row), 1, fptr));
+        }
+
+      if (fclose(fptr) || error)
+        {
+          fprintf(stderr, "ERROR: Could not write %s\n", path);
+          error = TRUE;
+        }
+    }
+
+  return error;
+}
+
+#ifndef NO_X11
+/* Open the display and create the window.
+ * Return TRUE if there is an error, FALSE otherwise.
+ */
+static int x11_open(renderer_x11* x11, uint32_t* pixels)
+{
+  int error = FALSE; // Error flag.
+
+  memset(x11, 0, sizeof(renderer_x11));
+
+  if (NULL == (x11->display = XOpenDisplay(NULL)))
+    {
+      error = TRUE;
+    }
+  else if (24 > DefaultDepth(x11->display, DefaultScreen(x11->display)))
+    {
+      // Pixels are 0xRRGGBB like the colors test_panama.c used.
+      XCloseDisplay(x11->display);
+      x11->display = NULL;
+      error        = TRUE;
+    }
+  else
+    {
+      x11->screen = DefaultScreen(x11->display);
+      x11->gc     = DefaultGC(x11->display, x11->screen);
+
+      if (NULL == (x11->font = XLoadQueryFont(x11->display, "-bitstream-bitstream charter-bold-i-normal--0-0-0-0-p-0-iso10646-1")))
+        {
+          printf("Cannot load font: timb18\n");
+        }
+      else
+        {
+          XSetFont(x11->display, x11->gc, x11->font->fid);
+        }
+
+      x11->window = XCreateSimpleWindow(x11->display, RootWindow(x11->display, x11->screen), 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT,
+                                        1, BlackPixel(x11->display, x11->screen), WhitePixel(x11->display, x11->screen));
+
+      XSelectInput(x11->display, x11->window, ExposureMask);
+      XMapWindow(x11->display, x11->window);
+
+      x11->pixmap = XCreatePixmap(x11->display, x11->window, WINDOW_WIDTH, WINDOW_HEIGHT, DefaultDepth(x11->display, x11->screen));
+      x11->image  = XCreateImage(x11->display, DefaultVisual(x11->display, x11->screen), DefaultDepth(x11->display, x11->screen), ZPixmap, 0,
+                                 (char*)pixels, WINDOW_WIDTH, WINDOW_HEIGHT, 32, 0);
+
+      // Start with a blank window.
+      XSetForeground(x11->display, x11->gc, WhitePixel(x11->display, x11->screen));
+      XFillRectangle(x11->display, x11->pixmap, x11->gc, 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+      XFlush(x11->display);
+    }
+
+  return error;
+}
+
+// Draw a string at a place in the pixmap.
+static void draw_text(renderer_x11* x11, double x, double y, const char* the_string)
+{
+  XDrawString(x11->display, x11->pixmap, x11->gc, x, y, the_string, (int)strlen(the_string));
+}
+
+// Copy the pixels and the text of a snapshot to the window.
+static void x11_show(renderer_x11* x11, const renderer_snapshot* snapshot)
+{
+  char the_string[60];
+
+  XPutImage(x11->display, x11->pixmap, x11->gc, x11->image, 0, 0, 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+
+  XSetForeground(x11->display, x11->gc, BLACK);
+  draw_text(x11, 0.5 * MARGIN, FRAME_HEIGHT + MARGIN * 1.4, "z");
+  draw_text(x11, 2.7 * MARGIN, FRAME_HEIGHT + 2.6 * MARGIN, "Groundwater w/surface contact");
+  draw_text(x11, 2.7 * MARGIN, FRAME_HEIGHT + 1.8 * MARGIN, "Falling slugs");
+  draw_text(x11, MARGIN + FRAME_WIDTH / 2 + 0.7 * MARGIN, FRAME_HEIGHT + 2.6 * MARGIN, "Capillary groundwater");
+  draw_text(x11, MARGIN + FRAME_WIDTH / 2 + 0.7 * MARGIN, FRAME_HEIGHT + 1.8 * MARGIN, "Infiltration front");
+  draw_text(x11, MARGIN + 4 * FRAME_WIDTH / 5 + 1.0 * MARGIN, 0.8 * MARGIN, "Water content");
+
+  sprintf(the_string, "Time: %8.4lf (days)", snapshot->current_time / ONE_DAY);
+  draw_text(x11, MARGIN + 1.0 * MARGIN, 0.8 * MARGIN, the_string);
+
+  // Copy pixmap to window.
+  XCopyArea(x11->display, x11->pixmap, x11->window, x11->gc, 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, 0, 0);
+  XFlush(x11->display);
+}
+
+// Redraw the window from the pixmap for any expose events.
+static void x11_events(renderer_x11* x11)
+{
+  XEvent the_event;
+
+  while (XPending(x11->display))
+    {
+      XNextEvent(x11->display, &the_event);
+
+      if (Expose == the_event.type)
+        {
+          XCopyArea(x11->display, x11->pixmap, x11->window, x11->gc, 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, 0, 0);
+          XFlush(x11->display);
+        }
+    }
+}
+
+// Close the window and the display.
+static void x11_close(renderer_x11* x11)
+{
+  // The pixels belong to the renderer so do not let XDestroyImage free them.
+  x11->image->data = NULL;
+  XDestroyImage(x11->image);
+  XFreePixmap(x11->display, x11->pixmap);
+  XDestroyWindow(x11->display, x11->window);
+
+  if (NULL != x11->font)
+    {
+      XFreeFont(x11->display, x11->font);
+    }
+
+  XCloseDisplay(x11->display);
+}
+#endif // NO_X11
+
+// The renderer thread.  Take snapshots out of the queue and draw them until done is set and the queue is empty.
+static void* renderer_thread(void* argument)
+{
+  renderer*          the_renderer = (renderer*)argument;
+  int                error        = FALSE; // Error flag.
+  int                window       = atomic_load(&the_renderer->window);
+  size_t             head;                 // the_renderer->head when it was last read.
+  size_t             tail         = atomic_load_explicit(&the_renderer->tail, memory_order_relaxed);
+  renderer_snapshot* snapshot;
+  struct timespec    idle         = {0, RENDERER_IDLE_NANOSECONDS};
+#ifndef NO_X11
+  renderer_x11       x11;
+
+  if (window && x11_open(&x11, the_renderer->pixels))
+    {
+      fprintf(stderr, "WARNING: Could not open a 24 bit X display.  Not showing the window.\n");
+      window = FALSE;
+      atomic_store(&the_renderer->window, FALSE);
+    }
+#else // NO_X11
+  if (window)
+    {
+      fprintf(stderr, "WARNING: renderer.c was compiled with NO_X11.  Not showing the window.\n");
+      window = FALSE;
+      atomic_store(&the_renderer->window, FALSE);
+    }
+#endif // NO_X11
+
+  for (;;)
+    {
+      // Read done before head so that if done is set the snapshots before it are seen.
+      int done = atomic_load_explicit(&the_renderer->done, memory_order_acquire);
+
+      head = atomic_load_explicit(&the_renderer->head, memory_order_acquire);
+
+      if (head == tail)
+        {
+          if (done)
+            {
+              break;
+            }
+
+#ifndef NO_X11
+          if (window)
+            {
+              x11_events(&x11);
+            }
+#endif // NO_X11
+
+          nanosleep(&idle, NULL);
+          continue;
+        }
+
+      snapshot = &the_renderer->queue[tail % RENDERER_QUEUE_SNAPSHOTS];
+
+      draw_snapshot(the_renderer->pixels, snapshot);
+
+      if (0 <= snapshot->frame && !error)
+        {
+          error = write_ppm(the_renderer, the_renderer->pixels, snapshot);
+
+          if (error)
+            {
+              atomic_store_explicit(&the_renderer->error, TRUE, memory_order_relaxed);
+            }
+        }
+
+#ifndef NO_X11
+      if (window && snapshot->show)
+        {
+          x11_show(&x11, snapshot);
+        }
+#endif // NO_X11
+
+      atomic_store_explicit(&the_renderer->tail, ++tail, memory_order_release);
+    }
+
+#ifndef NO_X11
+  if (window)
+    {
+      x11_close(&x11);
+    }
+#endif // NO_X11
+
+  return NULL;
+}
+
+/* Comment in .h file. */
+int renderer_alloc(renderer** the_renderer, int window, double max_frames_per_second, const char* frame_prefix, double frame_hours)
+{
+  int error = FALSE; // Error flag.
+
+  if (NULL == the_renderer)
+    {
+      fprintf(stderr, "ERROR: the_renderer must not be NULL\n");
+      error = TRUE;
+    }
+  else
+    {
+      *the_renderer = NULL;
+    }
+
+  if (window && !(0.0 < max_frames_per_second))
+    {
+      fprintf(stderr, "ERROR: max_frames_per_second must be greater than zero\n");
+      error = TRUE;
+    }
+
+  if (NULL != frame_prefix && !(0.0 < frame_hours))
+    {
+      fprintf(stderr, "ERROR: frame_hours must be greater than zero\n");
+      error = TRUE;
+    }
+
+  if (!error)
+    {
+      error = v_alloc((void**)the_renderer, sizeof(renderer));
+    }
+
+  if (!error)
+    {
+      (*the_renderer)->show_interval = window ? 1.0 / max_frames_per_second : 0.0;
+      (*the_renderer)->last_show     = -INFINITY;
+      (*the_renderer)->frame_seconds = frame_hours * 60.0 * 60.0;
+      atomic_init(&(*the_renderer)->window, window);
+      atomic_init(&(*the_renderer)->head, 0);
+      atomic_init(&(*the_renderer)->tail, 0);
+      atomic_init(&(*the_renderer)->done, FALSE);
+      atomic_init(&(*the_renderer)->error, FALSE);
+
+      error = v_alloc((void**)&(*the_renderer)->pixels, WINDOW_WIDTH * WINDOW_HEIGHT * sizeof(uint32_t));
+    }
+
+  if (!error && NULL != frame_prefix)
+    {
+      error = v_alloc((void**)&(*the_renderer)->frame_prefix, strlen(frame_prefix) + 1);
+
+      if (!error)
+        {
+          strcpy((*the_renderer)->frame_prefix, frame_prefix);
+        }
+    }
+
+  if (!error)
+    {
+      if (pthread_create(&(*the_renderer)->thread, NULL, renderer_thread, *the_renderer))
+        {
+          fprintf(stderr, "ERROR: Could not create renderer thread\n");
+          error = TRUE;
+        }
+      else
+        {
+          (*the_renderer)->thread_started = TRUE;
+        }
+    }
+
+  if (error && NULL != the_renderer && NULL != *the_renderer)
+    {
+      renderer_dealloc(the_renderer);
+    }
+
+  return error;
+}
+
+/* Comment in .h file. */
+int renderer_dealloc(renderer** the_renderer)
+{
+  int error = FALSE; // Error flag.
+  int ii;            // Loop counter.
+
+  if (NULL == the_renderer || NULL == *the_renderer)
+    {
+      fprintf(stderr, "ERROR: the_renderer must not be NULL\n");
+      error = TRUE;
+    }
+  else
+    {
+      if ((*the_renderer)->thread_started)
+        {
+          atomic_store_explicit(&(*the_renderer)->done, TRUE, memory_order_release);
+
+          if (pthread_join((*the_renderer)->thread, NULL))
+            {
+              fprintf(stderr, "ERROR: Could not join renderer thread\n");
+              error = TRUE;
+            }
+        }
+
+      if (atomic_load(&(*the_renderer)->error))
+        {
+          fprintf(stderr, "ERROR: Could not write frames\n");
+          error = TRUE;
+        }
+
+      if (0 < (*the_renderer)->dropped_frames)
+        {
+          fprintf(stderr, "WARNING: %d frames were not written because the renderer fell behind.\n", (*the_renderer)->dropped_frames);
+        }
+
+      for (ii = 0; ii < RENDERER_QUEUE_SNAPSHOTS; ii++)
+        {
+          if (NULL != (*the_renderer)->queue[ii].water)
+            {
+              v_dealloc((void**)&(*the_renderer)->queue[ii].water, (*the_renderer)->queue[ii].capacity * sizeof(renderer_water));
+            }
+        }
+
+      if (NULL != (*the_renderer)->frame_prefix)
+        {
+          v_dealloc((void**)&(*the_renderer)->frame_prefix, strlen((*the_renderer)->frame_prefix) + 1);
+        }
+
+      if (NULL != (*the_renderer)->pixels)
+        {
+          v_dealloc((void**)&(*the_renderer)->pixels, WINDOW_WIDTH * WINDOW_HEIGHT * sizeof(uint32_t));
+        }
+
+      v_dealloc((void**)the_renderer, sizeof(renderer));
+    }
+
+  return error;
+}
+
+/* Comment in .h file. */
+int renderer_snapshot_due(renderer* the_renderer, double current_time)
+{
+  int    frame_due = FALSE; // Whether a PPM frame is due.
+  int    show_due  = FALSE; // Whether the window is due to be drawn.
+  int    queue_full;
+  double now       = 0.0;   // Wall clock time.
+
+  if (NULL != the_renderer->frame_prefix && current_time >= the_renderer->next_frame * the_renderer->frame_seconds)
+    {
+      frame_due = TRUE;
+    }
+
+  if (atomic_load_explicit(&the_renderer->window, memory_order_relaxed))
+    {
+      now      = wall_time();
+      show_due = (now - the_renderer->last_show >= the_renderer->show_interval);
+    }
+
+  if (frame_due || show_due)
+    {
+      queue_full = (RENDERER_QUEUE_SNAPSHOTS <= atomic_load_explicit(&the_renderer->head, memory_order_relaxed) -
+                                                atomic_load_explicit(&the_renderer->tail, memory_order_acquire));
+
+      // The frame number is the number of frame_hours intervals since time zero so skipped frames leave a gap.
+      the_renderer->pending_frame = frame_due ? (int)floor(current_time / the_renderer->frame_seconds) : -1;
+      the_renderer->pending_show  = show_due;
+
+      if (frame_due)
+        {
+          the_renderer->next_frame = the_renderer->pending_frame + 1;
+        }
+
+      if (queue_full)
+        {
+          // Never wait for the renderer thread.  A late window draw is simply skipped.
+          if (frame_due)
+            {
+              the_renderer->dropped_frames++;
+            }
+
+          frame_due = FALSE;
+          show_due  = FALSE;
+        }
+      else if (show_due)
+        {
+          the_renderer->last_show = now;
+        }
+    }
+
+  return frame_due || show_due;
+}
+
+/* Comment in .h file. */
+int renderer_begin_snapshot(renderer* the_renderer, double current_time, int num_bins, double layer_bottom_depth)
+{
+  int                error = FALSE; // Error flag.
+  renderer_snapshot* snapshot;
+
+  if (0 >= num_bins || !(0.0 < layer_bottom_depth))
+    {
+      fprintf(stderr, "ERROR: num_bins and layer_bottom_depth must be greater than zero\n");
+      error = TRUE;
+    }
+  else if (RENDERER_QUEUE_SNAPSHOTS <= atomic_load_explicit(&the_renderer->head, memory_order_relaxed) -
+                                       atomic_load_explicit(&the_renderer->tail, memory_order_acquire))
+    {
+      fprintf(stderr, "ERROR: renderer_begin_snapshot called when renderer_snapshot_due did not return TRUE\n");
+      error = TRUE;
+    }
+  else
+    {
+      snapshot = &the_renderer->queue[atomic_load_explicit(&the_renderer->head, memory_order_relaxed) % RENDERER_QUEUE_SNAPSHOTS];
+
+      snapshot->current_time       = current_time;
+      snapshot->num_bins           = num_bins;
+      snapshot->layer_bottom_depth = layer_bottom_depth;
+      snapshot->show               = the_renderer->pending_show;
+      snapshot->frame              = the_renderer->pending_frame;
+      snapshot->num_water          = 0;
+      the_renderer->current        = snapshot;
+    }
+
+  return error;
+}
+
+/* Comment in .h file. */
+int renderer_add_water(renderer* the_renderer, int bin, double top, double bot, int kind)
+{
+  int                error    = FALSE; // Error flag.
+  int                capacity;         // The new number of rectangles allocated.
+  renderer_water*    water;            // The new array of rectangles.
+  renderer_snapshot* snapshot = the_renderer->current;
+
+  if (NULL == snapshot)
+    {
+      fprintf(stderr, "ERROR: renderer_add_water called without renderer_begin_snapshot\n");
+      error = TRUE;
+    }
+  else if (RENDERER_SATURATED > kind || RENDERER_GROUNDWATER < kind)
+    {
+      fprintf(stderr, "ERROR: kind must be one of the RENDERER_ kinds of water\n");
+      error = TRUE;
+    }
+  else
+    {
+      if (snapshot->num_water == snapshot->capacity)
+        {
+          capacity = (0 == snapshot->capacity) ? RENDERER_MIN_WATER : 2 * snapshot->capacity;
+          error    = v_alloc((void**)&water, capacity * sizeof(renderer_water));
+
+          if (!error && NULL != snapshot->water)
+            {
+              memcpy(water, snapshot->water, snapshot->num_water * sizeof(renderer_water));
+              v_dealloc((void**)&snapshot->water, snapshot->capacity * sizeof(renderer_water));
+            }
+
+          if (!error)
+            {
+              snapshot->water    = water;
+              snapshot->capacity = capacity;
+            }
+        }
+
+      if (!error)
+        {
+          snapshot->water[snapshot->num_water].bin  = bin;
+          snapshot->water[snapshot->num_water].kind = kind;
+          snapshot->water[snapshot->num_water].top  = top;
+          snapshot->water[snapshot->num_water].bot  = bot;
+          snapshot->num_water++;
+        }
+    }
+
+  return error;
+}
+
+/* Comment in .h file. */
+void renderer_end_snapshot(renderer* the_renderer)
+{
+  if (NULL != the_renderer->current)
+    {
+      the_renderer->current = NULL;
+      atomic_store_explicit(&the_renderer->head, atomic_load_explicit(&the_renderer->head, memory_order_relaxed) + 1, memory_order_release);
+    }
+}
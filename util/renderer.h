@@ -0,0 +1,112 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+/* A renderer draws pictures of a Talbot-Ogden domain from a background thread
+ * so the simulation never waits on drawing.  The simulation thread copies the
+ * water in the domain into a snapshot and puts it in a small bounded queue.
+ * The renderer thread takes snapshots out of the queue and draws them.  If the
+ * queue is full the snapshot is not taken, so the simulation never blocks.
+ *
+ * A renderer can show the domain in an X window at no more than a maximum
+ * frame rate, and it can write a PPM picture of the domain every so many
+ * simulated hours.  Both can be used at once.  The X display is only opened
+ * by the renderer thread and only if a window is asked for.  If it can not be
+ * opened the renderer keeps writing frames without the window, so a renderer
+ * runs on machines with no display.  Compile renderer.c with NO_X11 defined
+ * to build without the X11 headers and library.  Then only PPM frames work.
+ *
+ * Each snapshot is a list of rectangles of water, each one a part of a bin
+ * from a top depth to a bottom depth drawn in the color of its kind.
+ *
+ * One renderer must only be given snapshots by one thread.
+ */
+typedef struct renderer renderer;
+
+// The kinds of water in a snapshot.
+#define RENDERER_SATURATED   (0) // A completely saturated bin or groundwater in contact with the surface.  Gray.
+#define RENDERER_SURFACE     (1) // Water attached to the surface behind the infiltration front.  Green.
+#define RENDERER_SLUG        (2) // A falling slug.  Red.
+#define RENDERER_GROUNDWATER (3) // Capillary groundwater.  Blue.
+
+/* Start a renderer thread.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * the_renderer          - A pointer passed by reference which will be
+ *                         assigned to point to the newly allocated renderer or
+ *                         NULL if there is an error.
+ * window                - If TRUE show the domain in an X window.
+ * max_frames_per_second - The most times per second of wall clock time to
+ *                         draw the window.  Must be greater than zero if
+ *                         window is TRUE.
+ * frame_prefix          - If not NULL write PPM frames named
+ *                         frame_prefix followed by the frame number and .ppm.
+ * frame_hours           - Write a PPM frame every frame_hours simulated hours
+ *                         starting at time zero.  Must be greater than zero if
+ *                         frame_prefix is not NULL.
+ */
+int renderer_alloc(renderer** the_renderer, int window, double max_frames_per_second, const char* frame_prefix, double frame_hours);
+
+/* Draw all snapshots in the queue, stop the renderer thread, close the
+ * window, and free the renderer.  If a window is shown the last snapshot
+ * stays on the screen until this is called.
+ * Return TRUE if there is an error now or if there was an error writing any
+ * frame, FALSE otherwise.
+ * Even if there is an error make every effort to free as much as possible.
+ *
+ * Parameters:
+ *
+ * the_renderer - A pointer to the renderer passed by reference.
+ *                Will be set to NULL after it is deallocated.
+ */
+int renderer_dealloc(renderer** the_renderer);
+
+/* Return TRUE if a snapshot should be taken at current_time, FALSE otherwise.
+ * A snapshot is due if a PPM frame is due or if the window is due to be drawn
+ * again and there is room for it in the queue.  This is cheap enough to call
+ * every timestep.  If it returns TRUE call renderer_begin_snapshot,
+ * renderer_add_water for each rectangle of water, and then
+ * renderer_end_snapshot.
+ *
+ * Parameters:
+ *
+ * the_renderer - A pointer to the renderer.
+ * current_time - The simulated time in seconds.
+ */
+int renderer_snapshot_due(renderer* the_renderer, double current_time);
+
+/* Start a snapshot.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * the_renderer       - A pointer to the renderer.
+ * current_time       - The simulated time in seconds.
+ * num_bins           - The number of bins in the domain.
+ * layer_bottom_depth - The depth of the bottom of the domain in meters.
+ */
+int renderer_begin_snapshot(renderer* the_renderer, double current_time, int num_bins, double layer_bottom_depth);
+
+/* Add a rectangle of water to the current snapshot.
+ * Return TRUE if there is an error, FALSE otherwise.
+ *
+ * Parameters:
+ *
+ * the_renderer - A pointer to the renderer.
+ * bin          - The bin the water is in.  One based.
+ * top          - The depth of the top of the water in meters.
+ * bot          - The depth of the bottom of the water in meters.
+ * kind         - One of the RENDERER_ kinds of water.
+ */
+int renderer_add_water(renderer* the_renderer, int bin, double top, double bot, int kind);
+
+/* Put the current snapshot in the queue to be drawn.
+ *
+ * Parameters:
+ *
+ * the_renderer - A pointer to the renderer.
+ */
+void renderer_end_snapshot(renderer* the_renderer);
+
+#endif // RENDERER_H